@@ -5,8 +5,12 @@
 #include "bullet/configuration.hpp"
 #include "ogre/bsa_archive_factory.hpp"
 #include "ogre/fnt_loader.hpp"
+#include "ogre/occlusion_culler.hpp"
+#include "ogre/sun_shadows.hpp"
+#include "ogre/terrain_texture_array.hpp"
 #include "ogre/tex_image_codec.hpp"
 #include "ogre/text_resource_manager.hpp"
+#include "ogre/texture_streamer.hpp"
 #include "ogre/window.hpp"
 #include "ogrebullet/collision_shape_manager.hpp"
 #include "ogrebullet/rigid_body.hpp"
@@ -37,11 +41,14 @@ class ConsoleEngine;
 class MeshLoader;
 class CollisionObjectLoader;
 class ScriptEngine;
+class ScriptScheduler;
 class SkeletonLoader;
 class CellCache;
 class MeshManager;
 class MusicManager;
 class EntityFactory;
+class StaticBatchFactory;
+class InstancedGeometryFactory;
 class DeferredLightFactory;
 class DeferredLightPass;
 class DeferredSceneManager;
@@ -62,10 +69,15 @@ class ApplicationContext {
   std::unique_ptr<Ogre::BsaArchiveFactory> bsaArchiveFactory{};
   std::unique_ptr<Ogre::RigidBodyFactory> rigidBodyFactory{};
   std::unique_ptr<oo::EntityFactory> entityFactory;
+  std::unique_ptr<oo::StaticBatchFactory> staticBatchFactory;
+  std::unique_ptr<oo::InstancedGeometryFactory> instancedGeometryFactory;
   std::unique_ptr<oo::DeferredLightFactory> lightFactory;
   std::unique_ptr<oo::DeferredSceneManagerFactory> scnMgrFactory;
 
   std::unique_ptr<Ogre::TexImageCodec> texImageCodec{};
+  std::unique_ptr<oo::TextureStreamer> textureStreamer{};
+  std::unique_ptr<oo::OcclusionCuller> occlusionCuller{};
+  std::unique_ptr<oo::SunShadows> sunShadows{};
 
   std::shared_ptr<spdlog::logger> logger{};
 
@@ -90,9 +102,14 @@ class ApplicationContext {
 
   std::unique_ptr<Ogre::OverlaySystem> overlaySys{};
   std::unique_ptr<Ogre::TerrainGlobalOptions> terrainOptions{};
+  std::unique_ptr<oo::TerrainTextureArray> terrainTextureArray{};
 
   std::unique_ptr<oo::ConsoleEngine> consoleEngine;
   std::unique_ptr<oo::ScriptEngine> scriptEngine;
+  /// Runs the scripts of the references in visible cells. Declared after the
+  /// `scriptEngine` and before the `cellCache`, so that it is destroyed after
+  /// every cell and before the engine that its scripts come from.
+  std::unique_ptr<oo::ScriptScheduler> scriptScheduler;
 
   oo::PersistentReferenceLocator persistentRefLocator{};
 
@@ -143,6 +160,7 @@ class ApplicationContext {
 
   oo::ConsoleEngine &getConsoleEngine();
   oo::ScriptEngine &getScriptEngine();
+  oo::ScriptScheduler &getScriptScheduler();
 
   oo::MusicManager &getMusicManager();
 
@@ -0,0 +1,82 @@
+#ifndef OPENOBL_BULLET_ASYNC_STEPPER_HPP
+#define OPENOBL_BULLET_ASYNC_STEPPER_HPP
+
+#include "bullet/collision.hpp"
+#include "ogrebullet/motion_state.hpp"
+#include <btBulletDynamicsCommon.h>
+#include <gsl/gsl>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bullet {
+
+/// Steps a physics world on a dedicated thread, so that the simulation can run
+/// at the same time as the render thread does other work.
+///
+/// A step is started with `beginStep()` and finished with `wait()`, and the
+/// world must not be read or modified by any other thread between the two; in
+/// particular, no objects may be added to or removed from the world, and no
+/// `Ogre::MotionState` belonging to the world may be used. Bodies moved by the
+/// simulation do not move their `Ogre::Node`s until `wait()` is called, which
+/// publishes their new transforms on the calling thread.
+///
+/// Collisions found during the step are recorded in a `CollisionEventBuffer`
+/// as the step finishes, and are available from `getCollisionEvents()` once
+/// `wait()` has returned.
+class AsyncStepper {
+ public:
+  AsyncStepper();
+  ~AsyncStepper();
+  AsyncStepper(const AsyncStepper &) = delete;
+  AsyncStepper &operator=(const AsyncStepper &) = delete;
+  AsyncStepper(AsyncStepper &&) = delete;
+  AsyncStepper &operator=(AsyncStepper &&) = delete;
+
+  /// Start stepping the `world` forward by `delta` seconds, using at most
+  /// `maxSubSteps` fixed substeps, then return immediately.
+  /// \pre No step is in progress.
+  /// \pre The dispatcher of the `world` is a `btCollisionDispatcher`.
+  void beginStep(gsl::not_null<btDiscreteDynamicsWorld *> world,
+                 float delta, int maxSubSteps);
+
+  /// Block until the current step is finished, then update the `Ogre::Node`s of
+  /// every body that moved during the step.
+  /// Does nothing if no step is in progress.
+  void wait();
+
+  /// Return whether a step has been started but not yet waited for.
+  bool isStepping() const noexcept;
+
+  /// Return the collision events recorded during the last step.
+  /// \remark Should only be used by the thread calling `wait()`.
+  CollisionEventBuffer &getCollisionEvents() noexcept;
+
+  /// Return the time taken by the simulation during the last step, in seconds.
+  float getLastStepTime() const noexcept;
+
+ private:
+  std::thread mThread{};
+  mutable std::mutex mMutex{};
+  std::condition_variable mCv{};
+
+  btDiscreteDynamicsWorld *mWorld{};
+  float mDelta{0.0f};
+  int mMaxSubSteps{1};
+  bool mPending{false};
+  bool mStepping{false};
+  bool mQuit{false};
+  float mLastStepTime{0.0f};
+
+  CollisionEventBuffer mEvents{};
+  /// Motion states given new transforms during the last step.
+  std::vector<Ogre::MotionState *> mMoved{};
+
+  void run();
+  void step();
+};
+
+} // namespace bullet
+
+#endif // OPENOBL_BULLET_ASYNC_STEPPER_HPP
@@ -1,6 +1,7 @@
 #ifndef OPENOBL_BULLET_COLLISION_HPP
 #define OPENOBL_BULLET_COLLISION_HPP
 
+#include "job/spsc_queue.hpp"
 #include "nif/enum.hpp"
 #include "ogrebullet/collision_shape.hpp"
 #include "ogrebullet/rigid_body.hpp"
@@ -13,10 +14,36 @@ namespace bullet {
 gsl::span<const btPersistentManifold *const>
 getManifolds(gsl::not_null<btCollisionDispatcher *> dispatcher);
 
+/// A collision between two `btCollisionObject`s, recorded during a simulation
+/// step so that it can be acted upon later.
+struct CollisionEvent {
+  const btCollisionObject *a{};
+  const btCollisionObject *b{};
+  btManifoldPoint contact{};
+};
+
+/// Maximum number of collision events that can be recorded in a single step.
+constexpr std::size_t COLLISION_EVENT_CAPACITY{1024u};
+
+/// Buffer that collision events are written to by the thread stepping the
+/// simulation, and read from by the thread running gameplay code.
+using CollisionEventBuffer = oo::SpscQueue<CollisionEvent,
+                                           COLLISION_EVENT_CAPACITY>;
+
+/// Record the collisions in the `dispatcher` that `CollisionCaller` would
+/// dispatch, without dispatching them.
+/// \remark Must be called by the producer of the `buffer`, and must not be
+///         called while the simulation is being stepped by another thread.
+/// \returns The number of collisions that did not fit in the `buffer` and were
+///          discarded.
+std::size_t
+collectCollisionEvents(gsl::not_null<btCollisionDispatcher *> dispatcher,
+                       CollisionEventBuffer &buffer);
+
 /// Use this to be notified of collisions involving a target
 /// `btCollisionObject`.
 /// Register one or more callbacks to a (pointer to a) `btCollisionObject` and
-/// call `runCallbacks1 once each frame to have the callbacks called whenever
+/// call `runCallbacks` once each frame to have the callbacks called whenever
 /// the registered `btCollisionObject`s are involved in a collision.
 /// The callback should receive as arguments a pointer to the other
 /// `btCollisionObject` involved in the collision, and the point at which the
@@ -36,6 +63,9 @@ class CollisionCaller {
  public:
 
   void runCallbacks(gsl::not_null<btCollisionDispatcher *> dispatcher);
+  /// Dispatch every collision event in the `buffer`, emptying it.
+  /// \remark Must be called by the consumer of the `buffer`.
+  void runCallbacks(CollisionEventBuffer &buffer);
   void addCallback(const btCollisionObject *target, const callback_t &callback);
 };
 
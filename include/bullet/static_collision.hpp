@@ -0,0 +1,147 @@
+#ifndef OPENOBL_BULLET_STATIC_COLLISION_HPP
+#define OPENOBL_BULLET_STATIC_COLLISION_HPP
+
+#include "ogrebullet/rigid_body.hpp"
+#include <btBulletDynamicsCommon.h>
+#include <gsl/gsl>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace bullet {
+
+/// Static collision geometry of many rigid bodies merged into a small number of
+/// collision objects.
+///
+/// Adding every static reference in a cell to the physics world individually
+/// means thousands of broadphase insertions when the cell is loaded, and
+/// thousands of tiny proxies for the broadphase to track afterwards. Instead,
+/// the collision shapes of static `Ogre::RigidBody`s can be added to a
+/// `StaticCollision`, which merges them into one collision object for each
+/// distinct collision filter. The triangle meshes of the bodies are transformed
+/// into world space and concatenated into a single `btBvhTriangleMeshShape`,
+/// with each body given its own part of the mesh, and the convex shapes are
+/// placed in a `btCompoundShape` alongside the merged mesh.
+///
+/// As in `oo::StaticBatch`, every shape belongs to an *owner*, which in
+/// practice is the `oo::RefId` of the reference that the shape belongs to.
+/// Owners can be disabled and re-enabled, which marks the merged objects to be
+/// rebuilt the next time `update()` is called, so that toggling many owners in
+/// one frame only rebuilds them once.
+/// The owner of the shape hit by a ray test can be found with `getOwner()`.
+///
+/// The rigid bodies must outlive the `StaticCollision`, since their shapes are
+/// not copied, and should not be added to the physics world themselves while
+/// they are part of it.
+class StaticCollision {
+ public:
+  using OwnerId = uint32_t;
+
+  /// Collision object of a merged group of shapes, which knows which owner each
+  /// part of its shape belongs to.
+  class Object : public btCollisionObject {
+   public:
+    /// Return the owner of the part of the shape identified by a
+    /// `btCollisionWorld::LocalShapeInfo`, or zero if there is no such part.
+    OwnerId getOwner(int shapePart, int triangleIndex) const noexcept;
+
+   private:
+    friend StaticCollision;
+
+    /// Owner of each part of the merged triangle mesh, if any.
+    std::vector<OwnerId> mMeshOwners{};
+    /// Owner of each child of the compound shape. The merged triangle mesh, if
+    /// any, is the first child and has no owner.
+    std::vector<OwnerId> mChildOwners{};
+    std::unique_ptr<btTriangleIndexVertexArray> mMeshInterface{};
+    std::unique_ptr<btBvhTriangleMeshShape> mMeshShape{};
+    std::unique_ptr<btCompoundShape> mCompoundShape{};
+    std::vector<float> mVertices{};
+    std::vector<int> mIndices{};
+    int mCollisionGroup{};
+    int mCollisionMask{};
+  };
+
+  explicit StaticCollision(gsl::not_null<btCollisionWorld *> world);
+  ~StaticCollision();
+  StaticCollision(const StaticCollision &) = delete;
+  StaticCollision &operator=(const StaticCollision &) = delete;
+  StaticCollision(StaticCollision &&) = delete;
+  StaticCollision &operator=(StaticCollision &&) = delete;
+
+  /// Add the collision shape of `body` to the merged collision, at the body's
+  /// current world transform.
+  /// \returns `false`, and does not modify the merged collision, if `body` is
+  ///          not static or has a shape that cannot be merged.
+  bool addRigidBody(const Ogre::RigidBody &body, OwnerId owner);
+
+  /// Include or exclude all shapes belonging to the given owner.
+  /// If the merged objects have been built then they are rebuilt by the next
+  /// call to `update()`.
+  void setOwnerEnabled(OwnerId owner, bool enabled);
+  bool isOwnerEnabled(OwnerId owner) const;
+
+  /// Add the merged objects to the physics world, or remove them from it.
+  void setEnabled(bool enabled);
+  bool isEnabled() const noexcept;
+
+  /// Rebuild the merged objects from the shapes of the enabled owners.
+  void build();
+
+  /// Rebuild the merged objects if any owner has been enabled or disabled since
+  /// they were last built. This should be called once per frame, before the
+  /// physics world is stepped.
+  void update();
+
+  /// Return the number of collision objects that the shapes are merged into.
+  std::size_t getNumObjects() const noexcept;
+
+  /// Return the number of rigid bodies that have been merged.
+  std::size_t getNumBodies() const noexcept;
+
+ private:
+  /// A single shape added to the merged collision.
+  struct Part {
+    btCollisionShape *mShape{};
+    /// Transformation from the shape's local space to world space.
+    btTransform mTransform{};
+    OwnerId mOwner{};
+    int mCollisionGroup{};
+    int mCollisionMask{};
+  };
+
+  gsl::not_null<btCollisionWorld *> mWorld;
+  /// Every part added, including disabled ones.
+  std::vector<Part> mParts{};
+  std::set<OwnerId> mDisabledOwners{};
+  std::vector<std::unique_ptr<Object>> mObjects{};
+  std::size_t mNumBodies{0u};
+  bool mIsEnabled{false};
+  bool mIsBuilt{false};
+  /// Whether an owner has been enabled or disabled since the merged objects
+  /// were last built.
+  bool mIsDirty{false};
+
+  /// Append the parts of `shape`, with the given transformation to world space,
+  /// to `parts`, returning false if any part cannot be merged.
+  static bool addShape(btCollisionShape *shape,
+                       const btTransform &transform,
+                       std::vector<Part> &parts);
+
+  /// Merge the given parts, which must share a collision filter, into a single
+  /// object.
+  static std::unique_ptr<Object>
+  buildObject(const std::vector<const Part *> &parts);
+
+  /// Return whether any of the shapes belong to the given owner.
+  bool hasOwner(OwnerId owner) const;
+
+  void addObjectsToWorld();
+  void removeObjectsFromWorld();
+};
+
+} // namespace bullet
+
+#endif // OPENOBL_BULLET_STATIC_COLLISION_HPP
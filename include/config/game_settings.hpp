@@ -79,6 +79,10 @@ namespace oo {
 ///           `oo::APPLICATION_NAME` is the value of the compile-time constant
 ///           of the same name. If `$XDG_DATA_HOME` is not set, then it is
 ///           treated as being set to the value `$HOME/.local/share`.</td></tr>
+/// <tr><td>General.bCompressSaves</td>
+///     <td>Whether to compress save games when writing them. Compressed save
+///         games are smaller and faster to write, but cannot be loaded by the
+///         original game.</td></tr>
 /// <tr><td>General.uGridsToLoad</td>
 ///     <td>The diameter of cells to load at full detail around the player.
 ///         Defines the size of the player's *near neighbourhood*.
@@ -104,6 +108,40 @@ namespace oo {
 ///         the *contents* of the worldspace are kept loaded, only that all the
 ///         intrinsic information of the worldspace---such as the list of cells
 ///         that it owns---is.</td></tr>
+/// <tr><td>General.bPrepareModelsInBackground</td>
+///     <td>If true, the models in a cell are parsed on worker threads before
+///         the cell is reified, and their meshes uploaded by the render thread
+///         a few at a time. If false, models are parsed on the render thread
+///         when they are first inserted into the scene.</td></tr>
+/// <tr><td>General.fUploadBudget</td>
+///     <td>The maximum time in milliseconds that the render thread should
+///         spend each frame uploading meshes of models prepared in the
+///         background. At least one mesh is uploaded each frame regardless.
+///         </td></tr>
+/// <tr><td>General.bMergeStaticCollision</td>
+///     <td>Whether the collision shapes of the static references in each cell
+///         should be merged into a few large collision objects when the cell is
+///         loaded, instead of adding a rigid body to the physics world for
+///         every reference. The merged objects are rebuilt whenever one of the
+///         references is enabled or disabled.</td></tr>
+/// <tr><td>General.sCollisionCachePath</td>
+///     <td>The directory to store the precomputed BVHs of static collision
+///         meshes in, relative to the location of the executable. Each mesh's
+///         BVH is built the first time the mesh is loaded and read back from
+///         this directory afterwards. If blank, no BVHs are cached and they are
+///         rebuilt every time a mesh is loaded.</td></tr>
+/// <tr><td>General.sScriptCachePath</td>
+///     <td>The directory to store the native code of compiled scripts in,
+///         relative to the location of the executable. Each script is compiled
+///         the first time it is used and read back from this directory
+///         afterwards, until the script or the functions it can call change.
+///         If blank, scripts are compiled every time they are used.</td></tr>
+/// <tr><td>General.uScriptJitThreshold</td>
+///     <td>The number of times a block of a script must be run before the
+///         script is compiled to native code. Until then, and while it is
+///         being compiled in the background, the script is interpreted. If
+///         zero, every script is compiled to native code when it is
+///         loaded.</td></tr>
 /// <tr><td>General.fDefaultFOV</td>
 ///     <td>The horizontal field of view of the camera in degrees.</td></tr>
 /// <tr><td>General.sMainMenuMusicTrack</td></tr>
@@ -146,6 +184,86 @@ namespace oo {
 ///     <td>The height of the game window in pixels. Must be positive.</td></tr>
 /// <tr><td>Display.bFull Screen</td>
 ///     <td>Whether the game should be displayed in full-screen mode.</td></tr>
+/// <tr><td>Display.bBatchStaticGeometry</td>
+///     <td>Whether the geometry of the static references in each exterior
+///         cell should be merged into a small number of large batches when the
+///         cell is loaded, drastically reducing the number of draw calls
+///         required to render it. Disable to render every reference
+///         individually, which may help when debugging.</td></tr>
+/// <tr><td>Display.bUseInstancing</td>
+///     <td>Whether static geometry that is repeated many times should be drawn
+///         using hardware instancing, which shares the geometry between every
+///         copy instead of duplicating it in a static batch.</td></tr>
+/// <tr><td>Display.uInstancingThreshold</td>
+///     <td>The number of times that a mesh must be used by the static
+///         references in a cell for it to be instanced. Meshes already
+///         instanced by another loaded cell are always instanced.</td></tr>
+/// <tr><td>Display.bClusteredLighting</td>
+///     <td>Whether point lights should be assigned to a grid of clusters
+///         dividing the view frustum and drawn together in a single
+///         full-screen pass, instead of drawing each point light separately.
+///         This is much faster in scenes with many lights.</td></tr>
+/// <tr><td>Display.bTextureStreaming</td>
+///     <td>Whether the DDS textures of entities should have their higher mip
+///         levels streamed in as they are seen up close, and out again when
+///         video memory runs short. Other textures, and every texture if this
+///         is false, are loaded at full resolution.</td></tr>
+/// <tr><td>Display.uTextureBudget</td>
+///     <td>The amount of video memory in MiB that streamed textures may use.
+///         Textures stop being upgraded once the budget is reached, and the
+///         least recently seen textures are downgraded if it is exceeded.
+///         </td></tr>
+/// <tr><td>Display.uTextureMinSize</td>
+///     <td>The size in pixels along their longest side below which textures
+///         are never streamed out.</td></tr>
+/// <tr><td>Display.bTerrainTextureArrays</td>
+///     <td>Whether the textures of every terrain layer should be stored in a
+///         pair of texture arrays so that all terrain can be drawn with a
+///         single material and shader, instead of each terrain quadrant having
+///         its own material and blend maps.</td></tr>
+/// <tr><td>Display.uTerrainLayerSize</td>
+///     <td>The size in pixels that terrain layer textures are resized to when
+///         they are copied into the terrain texture arrays.</td></tr>
+/// <tr><td>Display.uTerrainMaxLayers</td>
+///     <td>The number of different terrain layers that the terrain texture
+///         arrays can hold. At most 256.</td></tr>
+/// <tr><td>Display.bOcclusionCulling</td>
+///     <td>Whether objects hidden behind large opaque objects should be culled
+///         on the CPU using a low resolution software-rasterized depth buffer,
+///         instead of only culling objects outside of the view frustum.
+///         </td></tr>
+/// <tr><td>Display.uOcclusionBufferWidth</td>
+///     <td>The width in pixels of the occlusion culling depth buffer.</td></tr>
+/// <tr><td>Display.uOcclusionBufferHeight</td>
+///     <td>The height in pixels of the occlusion culling depth buffer.
+///         </td></tr>
+/// <tr><td>Display.uMaxOccluders</td>
+///     <td>The maximum number of objects drawn into the occlusion culling depth
+///         buffer each frame. The objects covering the most of the screen are
+///         chosen.</td></tr>
+/// <tr><td>Display.bSunShadows</td>
+///     <td>Whether the sun should cast shadows, using cascaded shadow maps.
+///         </td></tr>
+/// <tr><td>Display.uShadowCascades</td>
+///     <td>The number of cascades that the view is split into, each with its
+///         own shadow map. Between 1 and 4.</td></tr>
+/// <tr><td>Display.uShadowMapSize</td>
+///     <td>The width and height in pixels of the shadow map of each cascade.
+///         </td></tr>
+/// <tr><td>Display.fShadowDistance</td>
+///     <td>The distance from the camera in meters beyond which nothing is
+///         shadowed.</td></tr>
+/// <tr><td>Display.fShadowSplitLambda</td>
+///     <td>How the cascades are split, between 0 for cascades of equal depth
+///         and 1 for cascades whose depth grows in proportion to their
+///         distance from the camera.</td></tr>
+/// <tr><td>Display.bShadowBudget</td>
+///     <td>Whether the shadow maps of all but the nearest cascade should be
+///         reused until the camera or sun moves too far or the shadow casters
+///         change, instead of redrawing every cascade every frame.</td></tr>
+/// <tr><td>Display.uShadowCascadeUpdates</td>
+///     <td>If Display.bShadowBudget is true, the maximum number of cascades
+///         besides the nearest that are redrawn each frame.</td></tr>
 /// <tr><td>Audio.fDefaultMasterVolume</td>
 ///     <td>The volume of the master audio bus. Should be between 0 and 1.
 ///         </td></tr>
@@ -174,6 +292,21 @@ namespace oo {
 ///         memory intensive, since each cell has four of them; one for each
 ///         quadrant. It is recommended that this value is kept low---say below
 ///         10---unless `General.uGridDistantCount` is small.</td></tr>
+/// <tr><td>LOD.bDisplayLODBuildings</td>
+///     <td>Whether the distant objects of the chunks around the player should
+///         be drawn beyond the near neighbourhood. Distant objects are the
+///         references flagged as visible when distant, and must first be built
+///         with the `BuildDistantObjects` console command.</td></tr>
+/// <tr><td>LOD.uDistantObjectRange</td>
+///     <td>The number of chunks either side of the player's chunk whose
+///         distant objects are drawn. Each chunk is 32 cells square.</td></tr>
+/// <tr><td>LOD.fDistantObjectReduction</td>
+///     <td>The fraction of the triangles of a model to keep when building its
+///         distant object, if it does not have a `_far.nif` variant. Should be
+///         between 0 and 1.</td></tr>
+/// <tr><td>LOD.sDistantObjectCachePath</td>
+///     <td>The directory to store the built distant objects of each chunk in,
+///         relative to the location of the executable.</td></tr>
 /// <tr><td>bLightAttenuation.fLinearRadiusMult</td>
 ///     <td>Multiplier to apply to the light radius in the linear part of the
 ///         point light attenuation equation.</td></tr>
@@ -63,6 +63,38 @@ extern "C" int ShowRaceMenu();
 /// Open the SpellMakingMenu, closing the current console window.
 extern "C" int ShowSpellmaking();
 
+/// Place `count` copies of the object under the crosshair in front of the
+/// player and periodically log the average frame time, in order to compare
+/// the cost of drawing repeated meshes with and without hardware instancing.
+/// Any previous test is removed, and no new test is started if `count` is zero.
+/// \see oo::InstancingStressTest
+extern "C" int InstancingStressTest(int count, int instanced);
+
+/// Place `count` point lights around the player and periodically log the
+/// average frame time, in order to compare the cost of lighting with and
+/// without clustered lighting.
+/// Any previous test is removed, and no new test is started if `count` is zero.
+/// \see oo::LightingStressTest
+extern "C" int LightingStressTest(int count, int clustered);
+
+/// Build the distant objects of the current worldspace, writing them to the
+/// distant object cache. This is slow and only needs to be done once for each
+/// worldspace, or after the worldspace is modified.
+/// \see oo::buildDistantObjects
+extern "C" int BuildDistantObjects();
+
+/// Print the execution statistics of the `count` scripts that have taken the
+/// longest to run since the statistics were last reset.
+/// \see oo::ScriptScheduler
+extern "C" int ShowScriptProfile(int count);
+
+/// Shorthand for ShowScriptProfile()
+/// \see console::ShowScriptProfile()
+extern "C" int ssp(int count);
+
+/// Reset the execution statistics of every script.
+extern "C" int ResetScriptProfile();
+
 /// Print a `float` to the console.
 /// \todo Implement name mangling to support overloaded functions.
 extern "C" int print(float value);
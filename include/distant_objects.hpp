@@ -0,0 +1,120 @@
+#ifndef OPENOBL_DISTANT_OBJECTS_HPP
+#define OPENOBL_DISTANT_OBJECTS_HPP
+
+#include "record/formid.hpp"
+#include "wrld.hpp"
+#include <gsl/gsl>
+#include <OgreMaterial.h>
+#include <OgrePrerequisites.h>
+#include <OgreVector.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+class ApplicationContext;
+class World;
+
+/// Merged geometry of the distant objects in a chunk that share a texture.
+///
+/// Each vertex is `FLOATS_PER_VERTEX` floats: the position relative to the
+/// origin of the chunk, the normal, and the texture coordinates, all in Ogre's
+/// coordinate system, followed by the coordinates of the cell that the
+/// vertex's reference is in.
+struct DistantObjectBatch {
+  constexpr static std::size_t FLOATS_PER_VERTEX{10u};
+
+  std::string diffuseName{};
+  std::vector<float> vertices{};
+  std::vector<uint16_t> indices{};
+};
+
+/// Build the distant object cache of every chunk in the given world.
+///
+/// The *distant objects* of a world are the references flagged as
+/// `record::RecordFlag::VisibleWhenDistant`, which are drawn beyond the near
+/// neighbourhood so that large landmarks can be seen from far away. For each
+/// chunk, the models of its distant objects are placed and merged into one
+/// `oo::DistantObjectBatch` per texture, which is written to a file in the
+/// directory given by `LOD.sDistantObjectCachePath` to be read back by an
+/// `oo::DistantObjectManager`.
+///
+/// If a model has a `_far.nif` variant, such as `foo_far.nif` for `foo.nif`,
+/// then that is used instead, otherwise the model's geometry is simplified by
+/// the fraction given by `LOD.fDistantObjectReduction`. Only opaque, unskinned
+/// geometry with a diffuse texture is kept.
+///
+/// Building is slow, since every reference of every cell in the world must be
+/// read, and is intended to be done once ahead of time.
+/// \remark Must be called on the render thread.
+void buildDistantObjects(const oo::World &wrld, ApplicationContext &ctx);
+
+/// Streams the distant objects of the chunks around the player in and out of a
+/// world, from the cache written by `oo::buildDistantObjects()`.
+///
+/// Each loaded chunk is drawn as a single `Ogre::ManualObject` with a section
+/// for each `oo::DistantObjectBatch`. The distant objects of the cells in the
+/// near neighbourhood are not drawn, since those cells have their references
+/// loaded in full; instead of rebuilding the geometry when the neighbourhood
+/// changes, the vertex shader collapses every triangle whose reference is in a
+/// near cell.
+class DistantObjectManager {
+ public:
+  DistantObjectManager(oo::BaseId wrldId,
+                       gsl::not_null<Ogre::SceneManager *> scnMgr);
+  /// \remark Must be called on the render thread.
+  ~DistantObjectManager();
+  DistantObjectManager(const DistantObjectManager &) = delete;
+  DistantObjectManager &operator=(const DistantObjectManager &) = delete;
+  DistantObjectManager(DistantObjectManager &&) = delete;
+  DistantObjectManager &operator=(DistantObjectManager &&) = delete;
+
+  /// Load the chunks within `LOD.uDistantObjectRange` chunks of the chunk
+  /// containing `centerCell` and unload all others, then hide the distant
+  /// objects of the cells in the near neighbourhood of `centerCell`.
+  /// Returns once every chunk has been loaded.
+  /// \remark Must be called on a worker thread, and not concurrently with
+  ///         itself.
+  void update(oo::CellIndex centerCell);
+
+ private:
+  constexpr static const char *BASE_MATERIAL{"__DistantObjectMaterial"};
+
+  using ChunkKey = std::pair<int32_t, int32_t>;
+
+  struct Chunk {
+    Ogre::SceneNode *node{};
+    Ogre::ManualObject *object{};
+  };
+
+  oo::BaseId mWrldId;
+  gsl::not_null<Ogre::SceneManager *> mScnMgr;
+  /// Every loaded chunk, including those without any distant objects. Only
+  /// modified on the render thread.
+  std::map<ChunkKey, Chunk> mChunks{};
+  /// Material of each texture used by a loaded chunk.
+  std::map<std::string, Ogre::MaterialPtr> mMaterials{};
+  /// Bounds of the near neighbourhood, as given to the vertex shader.
+  Ogre::Vector4 mNearBounds{1.0f, 1.0f, 0.0f, 0.0f};
+
+  /// Return the material drawing distant objects with the given texture,
+  /// creating it if necessary.
+  /// \remark Must be called on the render thread.
+  const Ogre::MaterialPtr &getMaterial(const std::string &diffuseName);
+
+  /// Create the renderable of a chunk from its batches.
+  /// \remark Must be called on the render thread.
+  void createChunk(ChunkKey key,
+                   const std::vector<DistantObjectBatch> &batches);
+
+  /// Destroy the renderable of a chunk.
+  /// \remark Must be called on the render thread.
+  void destroyChunk(ChunkKey key);
+};
+
+} // namespace oo
+
+#endif // OPENOBL_DISTANT_OBJECTS_HPP
@@ -1,6 +1,7 @@
 #ifndef OPENOBL_EXTERIOR_MANAGER_HPP
 #define OPENOBL_EXTERIOR_MANAGER_HPP
 
+#include "distant_objects.hpp"
 #include "record/formid.hpp"
 #include "resolvers/cell_resolver.hpp"
 #include "resolvers/wrld_resolver.hpp"
@@ -77,6 +78,9 @@ struct CellPacket;
 class ExteriorManager {
   std::shared_ptr<oo::World> mWrld{};
   std::vector<std::shared_ptr<oo::ExteriorCell>> mNearCells{};
+  /// Draws the distant objects around the center cell, if enabled. Declared
+  /// after `mWrld` so that it is destroyed before the world's scene manager.
+  std::unique_ptr<oo::DistantObjectManager> mDistantObjects{};
   /// Lock this during `reifyNeighbourhood` so that only one reify can occur
   /// at a time.
   boost::fibers::mutex mReifyMutex{};
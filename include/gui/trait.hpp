@@ -159,8 +159,9 @@ TraitTypeId userTraitType(int index) const override { \
   return (interface).userTraitType((index)); \
 } \
 void set_user(int index, gui::UiElement::UserValue value) override { \
-  return std::visit([this, index](auto v) { \
+  std::visit([this, index](auto v) { \
     (interface).set_user(index, v); }, value); \
+  notifyTraitsChanged(); \
 } \
 gui::UiElement::UserValue get_user(int index) override { \
   return (interface).get_user(index); \
@@ -172,12 +173,19 @@ void setOutputUserTraitSources(std::vector<TraitVariant *> traits) const overrid
       t.setSource(getUserOutputTraitInterface()); \
     }, *p); \
   } \
+  notifyTraitsChanged(); \
 }
 
 /// Represents a function used to set/compute the value of the dynamic
 /// representative of a trait. This needs to keep track of the names of its
 /// immediate dependencies, as edges in the dependency graph cannot be drawn
 /// until all traits have been constructed.
+///
+/// A function is *pure* if its value depends only on the values of its
+/// dependencies, so that it need only be reevaluated when one of them changes.
+/// Functions are assumed to be impure unless marked otherwise with
+/// `setPure()`, because they may read state from outside of the dependency
+/// graph, such as the user trait interface of a ui element.
 template<class T>
 class TraitFun {
  public:
@@ -187,12 +195,28 @@ class TraitFun {
  private:
   function_type mFun{};
   std::vector<std::string> mDependencies{};
+  bool mIsPure{false};
 
  public:
   TraitFun() noexcept = default;
   explicit TraitFun(const function_type &f) : mFun(f) {}
   explicit TraitFun(function_type &&f) noexcept : mFun(std::move(f)) {}
 
+  /// Return a pure `TraitFun` without dependencies that returns `value`.
+  static TraitFun constant(T value) {
+    TraitFun fun{[value = std::move(value)]() -> T { return value; }};
+    fun.setPure(true);
+    return fun;
+  }
+
+  void setPure(bool isPure) noexcept {
+    mIsPure = isPure;
+  }
+
+  [[nodiscard]] bool isPure() const noexcept {
+    return mIsPure;
+  }
+
   void addDependency(std::string dep) {
     mDependencies.push_back(std::move(dep));
   }
@@ -251,10 +275,10 @@ class Trait {
   }
 
  public:
-  explicit Trait(std::string name, T &&t) : mName(std::move(name)),
-                                            mValue([t]() { return t; }) {}
-  explicit Trait(std::string name, const T &t) : mName(std::move(name)),
-                                                 mValue([t]() { return t; }) {}
+  explicit Trait(std::string name, T &&t)
+      : mName(std::move(name)), mValue(TraitFun<T>::constant(std::move(t))) {}
+  explicit Trait(std::string name, const T &t)
+      : mName(std::move(name)), mValue(TraitFun<T>::constant(t)) {}
 
   explicit Trait(std::string name, TraitFun<T> t) : mName(std::move(name)),
                                                     mValue(t) {}
@@ -306,6 +330,12 @@ class Trait {
     return mValue.getDependencies();
   }
 
+  /// Whether the value of this trait depends only on its dependencies.
+  /// \see TraitFun
+  [[nodiscard]] bool isPure() const noexcept {
+    return mValue.isPure();
+  }
+
   [[nodiscard]] std::string getName() const {
     return mName;
   }
@@ -3,6 +3,7 @@
 
 #include "gui/trait.hpp"
 #include <OgreOverlayElement.h>
+#include <functional>
 #include <optional>
 #include <string>
 #include <variant>
@@ -13,10 +14,27 @@ class UiElement {
  private:
   int mChildCount{};
 
+  /// Called whenever state read by this element's user or provided traits
+  /// changes. \see setTraitListener()
+  std::function<void()> mTraitListener{};
+
  protected:
   std::string mName{};
 
+  /// Notify the trait listener, if any, that the state read by this element's
+  /// user or provided traits may have changed. Elements must call this whenever
+  /// they modify such state, otherwise the traits will not be reevaluated.
+  void notifyTraitsChanged() const {
+    if (mTraitListener) mTraitListener();
+  }
+
  public:
+  /// Set the function to call whenever the state read by this element's user or
+  /// provided traits may have changed, so that they need not be polled.
+  void setTraitListener(std::function<void()> listener) {
+    mTraitListener = std::move(listener);
+  }
+
   /// Notify this element about the number of child uiElements it has.
   void setChildCount(int childCount) {
     mChildCount = childCount;
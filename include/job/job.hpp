@@ -2,10 +2,13 @@
 #define OPENOBL_JOB_JOB_HPP
 
 #include <boost/fiber/all.hpp>
+#include <algorithm>
 #include <atomic>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 
 namespace oo {
@@ -146,6 +149,11 @@ class JobManager {
     getQueue().push(Job(std::forward<F>(f), counter));
   }
 
+  /// Return the number of worker threads that jobs are run on.
+  static constexpr unsigned long getNumWorkers() noexcept {
+    return NUM_WORKER_THREADS;
+  }
+
   /// Wait on a job counter.
   static void waitOn(JobCounter *counter) noexcept { counter->wait(); }
 };
@@ -167,6 +175,8 @@ class RenderJobManager {
   static constexpr std::size_t BUFFER_CAPACITY{4096u};
   static constexpr std::size_t POOL_SIZE{1024u};
   using JobQueue = boost::fibers::buffered_channel<Job>;
+  /// Id of the thread that called `start()`.
+  static inline std::thread::id mRenderThread{};
 
   /// Get a reference to the job queue.
   /// \see JobManager::getJobQueue()
@@ -191,6 +201,7 @@ class RenderJobManager {
   /// Start the job system on the calling thread.
   template<class F> static void start(F &&f) noexcept {
     static constexpr auto CLOSED{boost::fibers::channel_op_status::closed};
+    mRenderThread = std::this_thread::get_id();
 
     // Create pool of fibers that can be pulling jobs.
     for (std::size_t i = 0; i < POOL_SIZE; ++i) {
@@ -209,10 +220,54 @@ class RenderJobManager {
     getQueue().close();
   }
 
+  /// Return whether the calling thread is the one that the jobs are run on.
+  static bool isRenderThread() noexcept {
+    return std::this_thread::get_id() == mRenderThread;
+  }
+
   /// Wait on a job counter.
   static void waitOn(JobCounter *counter) noexcept { counter->wait(); }
 };
 
+/// Call `fn(i)` for every `i` in `[0, n)`, sharing the calls between the
+/// calling thread and helper jobs on the worker threads, and return once every
+/// call has finished.
+/// \remark `fn` may be called concurrently with itself.
+inline void parallelFor(std::size_t n, std::function<void(std::size_t)> fn) {
+  if (n == 0u) return;
+
+  // As in GameMode::runPoseJobs(), the worker threads may all be busy loading
+  // cells, so the caller only waits for the calls that the helpers have
+  // claimed. Helpers that start late find nothing left to do, but might still
+  // touch the shared state after we have returned.
+  struct SharedState {
+    std::function<void(std::size_t)> fn;
+    std::size_t n;
+    std::atomic<std::size_t> next{0u};
+    oo::JobCounter done;
+
+    SharedState(std::function<void(std::size_t)> fn, std::size_t n)
+        : fn(std::move(fn)), n(n), done(static_cast<int>(n)) {}
+
+    void work() {
+      for (std::size_t i{next++}; i < n; i = next++) {
+        fn(i);
+        done.decrement();
+      }
+    }
+  };
+
+  auto state{std::make_shared<SharedState>(std::move(fn), n)};
+  const auto numHelpers{std::min<std::size_t>(n - 1u,
+                                              JobManager::getNumWorkers())};
+  for (std::size_t i = 0; i < numHelpers; ++i) {
+    JobManager::runJob([state]() { state->work(); });
+  }
+
+  state->work();
+  state->done.wait();
+}
+
 } // namespace oo
 
 #endif // OPENOBL_JOB_JOB_HPP
@@ -0,0 +1,75 @@
+#ifndef OPENOBL_JOB_SPSC_QUEUE_HPP
+#define OPENOBL_JOB_SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace oo {
+
+/// Fixed-capacity queue for passing values from a single producer thread to a
+/// single consumer thread without locking.
+///
+/// The queue is a ring buffer of `Capacity` elements indexed by two counters,
+/// one written only by the producer and one written only by the consumer.
+/// Neither `push()` nor `pop()` ever block; `push()` fails if the queue is
+/// full, and `pop()` fails if it is empty. At most one thread may call
+/// `push()` and at most one thread may call `pop()` at any time, though they
+/// need not be the same two threads throughout the lifetime of the queue
+/// provided that the handover is otherwise synchronized.
+template<class T, std::size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity > 0u && (Capacity & (Capacity - 1u)) == 0u,
+                "Capacity must be a power of two");
+  static_assert(std::is_copy_assignable_v<T>);
+
+ public:
+  SpscQueue() = default;
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+  SpscQueue(SpscQueue &&) = delete;
+  SpscQueue &operator=(SpscQueue &&) = delete;
+
+  /// Add a value to the back of the queue, returning false if the queue is
+  /// full. Must only be called by the producer.
+  bool push(const T &value) {
+    const auto tail{mTail.load(std::memory_order_relaxed)};
+    if (tail - mHead.load(std::memory_order_acquire) == Capacity) return false;
+    mBuffer[tail & (Capacity - 1u)] = value;
+    mTail.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  /// Remove the value at the front of the queue, returning false if the queue
+  /// is empty. Must only be called by the consumer.
+  bool pop(T &value) {
+    const auto head{mHead.load(std::memory_order_relaxed)};
+    if (head == mTail.load(std::memory_order_acquire)) return false;
+    value = mBuffer[head & (Capacity - 1u)];
+    mHead.store(head + 1u, std::memory_order_release);
+    return true;
+  }
+
+  /// Return whether the queue is empty. If called by a thread other than the
+  /// consumer, the result may be out of date as soon as it is returned.
+  bool empty() const noexcept {
+    return mHead.load(std::memory_order_acquire)
+        == mTail.load(std::memory_order_acquire);
+  }
+
+  constexpr static std::size_t capacity() noexcept {
+    return Capacity;
+  }
+
+ private:
+  std::array<T, Capacity> mBuffer{};
+  /// Index of the next element to pop, only written by the consumer.
+  alignas(64) std::atomic<std::size_t> mHead{0u};
+  /// Index of the next element to push, only written by the producer.
+  alignas(64) std::atomic<std::size_t> mTail{0u};
+};
+
+} // namespace oo
+
+#endif // OPENOBL_JOB_SPSC_QUEUE_HPP
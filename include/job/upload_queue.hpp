@@ -0,0 +1,178 @@
+#ifndef OPENOBL_JOB_UPLOAD_QUEUE_HPP
+#define OPENOBL_JOB_UPLOAD_QUEUE_HPP
+
+#include "job/job.hpp"
+#include <boost/fiber/all.hpp>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+/// List of commands to be run in order on the render thread, such as texture
+/// blits, buffer creation, and attaching scene nodes.
+///
+/// Commands are recorded on any thread then handed to the render thread as a
+/// whole with `oo::UploadQueue::submit()`. Since a buffer is run as a single
+/// task, each command can depend on the ones recorded before it.
+class RenderCommandBuffer {
+ public:
+  RenderCommandBuffer() = default;
+  ~RenderCommandBuffer() = default;
+  RenderCommandBuffer(const RenderCommandBuffer &) = delete;
+  RenderCommandBuffer &operator=(const RenderCommandBuffer &) = delete;
+  RenderCommandBuffer(RenderCommandBuffer &&) noexcept = default;
+  RenderCommandBuffer &operator=(RenderCommandBuffer &&) noexcept = default;
+
+  /// Add a command to the end of the buffer.
+  template<class F> void record(F &&f) {
+    mCommands.emplace_back(std::forward<F>(f));
+  }
+
+  bool empty() const noexcept { return mCommands.empty(); }
+  std::size_t size() const noexcept { return mCommands.size(); }
+
+  /// Run every command in order, stopping at the first that throws.
+  /// \remark Must be called on the render thread.
+  void run() {
+    for (auto &command : mCommands) command();
+  }
+
+ private:
+  std::vector<std::function<void()>> mCommands{};
+};
+
+/// Queue of short tasks that must be run on the render thread, such as copying
+/// data prepared by a worker thread into GPU buffers.
+///
+/// Jobs given to the `oo::RenderJobManager` run as soon as the render thread
+/// yields to them, and a large number of them becoming ready at once---when a
+/// new cell is loaded, for instance---can cause a noticeable stutter. Tasks in
+/// this queue are instead run by the render thread a few at a time, by calling
+/// `drain()` once per frame with a time budget. Like `oo::JobManager`, all the
+/// methods are `static`.
+///
+/// Tasks should be small compared to the budget, since a task is never
+/// interrupted once it has started. Tasks that the caller needs to wait on can
+/// be recorded into an `oo::RenderCommandBuffer` and given to `submit()`, which
+/// returns a future that becomes ready once the whole buffer has been run.
+class UploadQueue {
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static std::deque<Job> &getQueue() {
+    static std::deque<Job> queue{};
+    return queue;
+  }
+
+  static std::mutex &getMutex() {
+    static std::mutex mutex{};
+    return mutex;
+  }
+
+  /// Remove the first task from the queue, returning false if it is empty.
+  static bool pop(Job &job) {
+    std::scoped_lock lock{getMutex()};
+    auto &queue{getQueue()};
+    if (queue.empty()) return false;
+    job = std::move(queue.front());
+    queue.pop_front();
+    return true;
+  }
+
+  /// A submitted buffer and the promise to fulfil once it has been run.
+  struct Submission {
+    RenderCommandBuffer buffer{};
+    boost::fibers::promise<void> done{};
+
+    /// Run the commands, passing any exception to the future.
+    void run() noexcept {
+      try {
+        buffer.run();
+        done.set_value();
+      } catch (...) {
+        done.set_exception(std::current_exception());
+      }
+    }
+  };
+
+ public:
+  UploadQueue() = delete;
+  UploadQueue(const UploadQueue &) = delete;
+  UploadQueue &operator=(const UploadQueue &) = delete;
+  UploadQueue(UploadQueue &&) = delete;
+  UploadQueue &operator=(UploadQueue &&) = delete;
+
+  /// Add a new task to the back of the queue.
+  /// This can be called from any thread.
+  template<class F> static void push(F &&f, JobCounter *counter = nullptr) {
+    std::scoped_lock lock{getMutex()};
+    getQueue().emplace_back(std::forward<F>(f), counter);
+  }
+
+  /// Add `buffer` to the back of the queue as a single task, returning a future
+  /// that is made ready once every command in it has been run, or that holds
+  /// the exception thrown by the first command that failed.
+  ///
+  /// Buffers submitted from the render thread itself are run immediately,
+  /// since waiting for the next drain would deadlock if the caller is the fiber
+  /// that drains the queue.
+  /// This can be called from any thread.
+  static boost::fibers::future<void> submit(RenderCommandBuffer buffer) {
+    // Jobs must be copyable but promises are not, so share the submission.
+    auto submission{std::make_shared<Submission>()};
+    submission->buffer = std::move(buffer);
+    auto future{submission->done.get_future()};
+
+    if (submission->buffer.empty() || RenderJobManager::isRenderThread()) {
+      submission->run();
+      return future;
+    }
+
+    push([submission]() { submission->run(); });
+    return future;
+  }
+
+  /// Record a single command into a new buffer and submit it.
+  /// This can be called from any thread.
+  template<class F> static boost::fibers::future<void> submit(F &&f) {
+    RenderCommandBuffer buffer{};
+    buffer.record(std::forward<F>(f));
+    return submit(std::move(buffer));
+  }
+
+  /// Run tasks from the front of the queue until it is empty or `budget` has
+  /// elapsed, returning the number of tasks that were run.
+  /// At least one task is run if the queue is not empty, so that the queue
+  /// always makes progress.
+  /// \remark Must be called on the render thread.
+  template<class Rep, class Period>
+  static std::size_t drain(std::chrono::duration<Rep, Period> budget) {
+    const auto deadline{Clock::now() + budget};
+    std::size_t numRun{0u};
+
+    Job job;
+    do {
+      if (!pop(job)) break;
+      job();
+      ++numRun;
+    } while (Clock::now() < deadline);
+
+    return numRun;
+  }
+
+  /// Return the number of tasks waiting to be run.
+  static std::size_t size() {
+    std::scoped_lock lock{getMutex()};
+    return getQueue().size();
+  }
+};
+
+} // namespace oo
+
+#endif // OPENOBL_JOB_UPLOAD_QUEUE_HPP
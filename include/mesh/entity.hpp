@@ -2,7 +2,10 @@
 #define OPENOBL_ENTITY_HPP
 
 #include "mesh/mesh.hpp"
+#include "mesh/skeletal_animation.hpp"
 #include <OgreMovableObject.h>
+#include <limits>
+#include <optional>
 
 namespace oo {
 
@@ -11,10 +14,30 @@ namespace oo {
 
 using Affine3Allocator = Ogre::AlignedAllocator<Ogre::Affine3,
                                                 OGRE_SIMD_ALIGNMENT>;
+class Entity;
 class EntityFactory;
 class SubEntity;
 class SkeletonState;
 
+/// Snapshot of the animation state of an `oo::Entity`'s skeleton, taken on the
+/// render thread so that the pose of the skeleton can be evaluated on another
+/// thread. See `oo::Entity::_createPoseJob()`.
+class PoseJob {
+ public:
+  /// Evaluate the pose of the skeleton, updating the bone matrices that the
+  /// entity passes to the vertex shader. This can be run on any thread, but
+  /// two jobs of entities sharing a skeleton must not be run concurrently.
+  void run();
+
+ private:
+  friend class oo::Entity;
+
+  std::shared_ptr<oo::SkeletonState> mState{};
+  std::vector<oo::AnimationLayer> mLayers{};
+  /// Dirty frame number of the animation states when the snapshot was taken.
+  unsigned long mFrameNumber{};
+};
+
 class Entity : public Ogre::MovableObject {
  public:
   using ChildObjectList = std::map<std::string, Ogre::MovableObject *>;
@@ -51,12 +74,31 @@ class Entity : public Ogre::MovableObject {
   /// Needed because `getBoundingBox()` wants to return by const reference, and
   /// must be mutable because `getBoundingBox()` wants to be const.
   mutable Ogre::AxisAlignedBox mFullAABB{};
+  /// Level of detail to render with, chosen when the camera is notified.
+  std::size_t mLodIndex{0u};
+  /// Whether the entity is hidden from the current camera by an occluder,
+  /// decided when the camera is notified.
+  bool mIsOccluded{false};
+  /// Frame number at which the occluder was last added to the
+  /// `oo::OcclusionCuller`.
+  unsigned long mOccluderFrameNumber{std::numeric_limits<unsigned long>::max()};
 
   void buildSubEntityList(const oo::MeshPtr &mesh, SubEntityList &list);
 
   void updateAnimation();
   void setSkeletonImpl();
 
+  /// Return the fraction of the height of the viewport of `camera` covered by
+  /// the bounding sphere of the mesh, scaled by the LOD bias of the camera.
+  /// Returns infinity if the size cannot be determined, or if the camera is
+  /// inside the bounding sphere, so that full detail is used.
+  float getScreenSize(const Ogre::Camera &camera) const;
+
+  /// Offer the occluder geometry of the mesh to the `oo::OcclusionCuller`, if
+  /// there is one, then ask it whether this entity and each of its subentities
+  /// are hidden from `camera`.
+  void updateOcclusion(const Ogre::Camera &camera);
+
   /// \pre `movable` is not attached to this entity
   /// \pre Nothing is attached to the `tagPoint`.
   void attachObjectImpl(Ogre::MovableObject *movable, Ogre::TagPoint *tagPoint);
@@ -75,6 +117,11 @@ class Entity : public Ogre::MovableObject {
 
   Entity *clone(const std::string &name);
 
+  /// Return the level of detail that this entity is currently rendered with,
+  /// where 0 is full detail. This is chosen based on the screen-space size of
+  /// the entity whenever it is notified of the current camera.
+  std::size_t getCurrentLodIndex() const noexcept;
+
   /// \name MovableObject overrides
   /// @{
 
@@ -105,6 +152,15 @@ class Entity : public Ogre::MovableObject {
   Ogre::AnimationStateSet *getAllAnimationStates() const;
   void refreshAvailableAnimationState();
   void _updateAnimation();
+
+  /// Take a snapshot of the animation state of this entity's skeleton, so
+  /// that its pose can be evaluated by `oo::PoseJob::run()` off the render
+  /// thread instead of when the entity is next rendered.
+  /// Returns an empty optional if the pose is already up to date, or if it
+  /// can only be evaluated by OGRE; for example if the skeleton has manually
+  /// controlled bones or an animation uses a blend mask.
+  /// \remark Must be run on the render thread.
+  std::optional<oo::PoseJob> _createPoseJob();
   bool _isAnimated() const;
   bool _isSkeletonAnimated() const;
 
@@ -0,0 +1,252 @@
+#ifndef OPENOBL_INSTANCED_GEOMETRY_HPP
+#define OPENOBL_INSTANCED_GEOMETRY_HPP
+
+#include "mesh/entity.hpp"
+#include <gsl/gsl>
+#include <OgreHardwareVertexBuffer.h>
+#include <OgreMovableObject.h>
+#include <OgreRenderable.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace oo {
+
+/// \addtogroup OpenOBLMesh
+/// @{
+
+class InstancedGeometryFactory;
+
+/// Collection of repeated static geometry drawn with hardware instancing.
+/// Every `oo::SubMesh` of every `oo::Entity` added to the collection is drawn
+/// with its (instanced) material as part of a *batch*, which holds a hardware
+/// buffer of per-instance transformations and is drawn with a single instanced
+/// draw call. Unlike an `oo::StaticBatch`, the vertex data of the submesh is
+/// shared by all instances and is not duplicated.
+///
+/// Instances of the same submesh and material are split spatially into
+/// batches by dividing the horizontal plane into square buckets, and each
+/// batch is frustum culled separately. The bucket size therefore trades off
+/// the number of draw calls against the effectiveness of the culling.
+///
+/// As in `oo::StaticBatch`, geometry is grouped by an opaque *owner*, which in
+/// practice is the `oo::RefId` of the reference that the geometry belongs to.
+/// Owners can be disabled and re-enabled, and removed entirely when the
+/// reference is unloaded, so a single `InstancedGeometry` can be shared by all
+/// the loaded cells in a scene.
+///
+/// Only unskinned, opaque, triangle geometry drawn with the generic static
+/// material shaders can be instanced; entities that do not satisfy this are
+/// rejected by `addEntity()` and should be rendered normally.
+///
+/// \remark Because the per-instance transformations are supplied to the vertex
+///         shader as a 3x4 matrix, and normals are transformed with the same
+///         matrix, instances may only be scaled uniformly.
+class InstancedGeometry : public Ogre::MovableObject {
+ public:
+  using OwnerId = uint32_t;
+
+  class Batch;
+
+  /// Default side length of the buckets used to split instances into batches,
+  /// in metres.
+  constexpr static float DEFAULT_BUCKET_SIZE{64.0f};
+
+ private:
+  friend class oo::InstancedGeometryFactory;
+
+  explicit InstancedGeometry(const std::string &name);
+
+  /// Identifies the batch that an instance belongs to by its submesh,
+  /// instanced material, and bucket. Batches are ordered by submesh first so
+  /// that batches of the same submesh are drawn consecutively.
+  using BatchKey = std::tuple<const oo::SubMesh *, const Ogre::Material *,
+                              int, int>;
+  using BatchMap = std::map<BatchKey, std::unique_ptr<Batch>>;
+
+  BatchMap mBatches{};
+  /// Owners that should not currently be drawn.
+  std::set<OwnerId> mDisabledOwners{};
+  /// Side length of the buckets, in metres.
+  float mBucketSize{DEFAULT_BUCKET_SIZE};
+  /// Bounds of all instances in the local space of the parent node, including
+  /// disabled ones.
+  Ogre::AxisAlignedBox mAABB{};
+  float mBoundRadius{};
+  /// Camera that the next call to `_updateRenderQueue()` should cull against.
+  const Ogre::Camera *mCullCamera{};
+  /// Number of batches that passed the frustum test when last rendered.
+  std::size_t mNumVisibleBatches{};
+
+  /// Return the key of the batch that an instance of the given submesh with
+  /// the given material and transformation belongs to.
+  BatchKey getBatchKey(const oo::SubMesh *subMesh,
+                       const Ogre::Material *material,
+                       const Ogre::Affine3 &transform) const;
+
+  /// Recompute the bounds from all the batches, after some instances have been
+  /// removed.
+  void updateBounds();
+
+ public:
+  ~InstancedGeometry() override;
+
+  /// Return whether the geometry of `entity` can be instanced.
+  static bool isInstanceable(const oo::Entity &entity);
+
+  /// Return the material used to draw instances of geometry with the given
+  /// material, creating it if necessary. Returns an empty pointer if the
+  /// material cannot be converted to use instancing.
+  static Ogre::MaterialPtr getInstancedMaterial(const Ogre::MaterialPtr &mat);
+
+  /// Add the geometry of `entity` to the collection, with the given
+  /// transformation into the local space of this object's parent node.
+  /// \returns `false`, and does not modify the collection, if `entity` is not
+  ///          instanceable.
+  bool addEntity(const oo::Entity &entity, const Ogre::Affine3 &transform,
+                 OwnerId owner);
+
+  /// Remove all geometry belonging to the given owner.
+  void removeOwner(OwnerId owner);
+
+  /// Show or hide all geometry belonging to the given owner.
+  void setOwnerEnabled(OwnerId owner, bool enabled);
+  bool isOwnerEnabled(OwnerId owner) const;
+
+  /// Return whether the collection contains any instances of the given mesh.
+  bool hasMesh(const oo::Mesh &mesh) const;
+
+  /// Set the side length of the buckets used to split instances into batches,
+  /// in metres. Existing instances are redistributed among new batches.
+  void setBucketSize(float bucketSize);
+  float getBucketSize() const noexcept;
+
+  /// Return the number of batches, including those that were culled.
+  std::size_t getNumBatches() const noexcept;
+
+  /// Return the number of batches that were drawn when last rendered.
+  std::size_t getNumVisibleBatches() const noexcept;
+
+  /// Return the total number of instances in all batches.
+  std::size_t getNumInstances() const noexcept;
+
+  /// \name MovableObject overrides
+  /// @{
+
+  void _notifyCurrentCamera(Ogre::Camera *camera) override;
+
+  const Ogre::AxisAlignedBox &getBoundingBox() const override;
+
+  float getBoundingRadius() const override;
+
+  void _updateRenderQueue(Ogre::RenderQueue *queue) override;
+
+  const std::string &getMovableType() const override;
+
+  uint32_t getTypeFlags() const override;
+
+  void visitRenderables(Ogre::Renderable::Visitor *visitor,
+                        bool debugRenderables = false) override;
+  /// @}
+};
+
+/// Instances of a single submesh and material in one bucket of an
+/// `oo::InstancedGeometry`.
+class InstancedGeometry::Batch : public Ogre::Renderable {
+ public:
+  Batch(oo::InstancedGeometry *parent, oo::MeshPtr mesh,
+        oo::SubMesh *subMesh, Ogre::MaterialPtr material);
+  ~Batch() override;
+
+  void addInstance(const Ogre::Affine3 &transform, OwnerId owner);
+
+  /// Remove all instances belonging to the given owner.
+  /// \returns whether any instances were removed.
+  bool removeOwner(OwnerId owner);
+
+  bool hasOwner(OwnerId owner) const;
+
+  /// Mark the instance buffer as needing to be rewritten before it is next
+  /// drawn, for instance because an owner has been disabled.
+  void markDirty() noexcept;
+
+  /// Rewrite the instance buffer with the transformations of the enabled
+  /// instances, if it is out of date.
+  void update();
+
+  /// Return the number of instances in the batch, including disabled ones.
+  std::size_t getNumInstances() const noexcept;
+
+  /// Return the number of instances that will be drawn.
+  std::size_t getNumEnabledInstances() const noexcept;
+
+  /// Return the bounds of the enabled instances in the local space of the
+  /// parent's parent node.
+  const Ogre::AxisAlignedBox &getBoundingBox() const noexcept;
+
+  /// Return the bounds of all instances, including disabled ones.
+  const Ogre::AxisAlignedBox &getFullBoundingBox() const noexcept;
+
+  /// \name Renderable overrides
+  /// @{
+
+  const Ogre::MaterialPtr &getMaterial() const override;
+  Ogre::Technique *getTechnique() const override;
+  void getRenderOperation(Ogre::RenderOperation &op) override;
+  void getWorldTransforms(Ogre::Matrix4 *xform) const override;
+  float getSquaredViewDepth(const Ogre::Camera *camera) const override;
+  const Ogre::LightList &getLights() const override;
+  bool getCastsShadows() const override;
+
+  /// @}
+
+ private:
+  friend class oo::InstancedGeometry;
+
+  struct Instance {
+    Ogre::Affine3 mTransform{};
+    OwnerId mOwner{};
+  };
+
+  oo::InstancedGeometry *mParent;
+  /// Keeps the submesh alive for as long as the batch needs it.
+  oo::MeshPtr mMesh;
+  oo::SubMesh *mSubMesh;
+  Ogre::MaterialPtr mMaterial;
+  std::vector<Instance> mInstances{};
+  /// Copy of the submesh's vertex data sharing its vertex buffers, with an
+  /// additional binding for the instance buffer.
+  std::unique_ptr<Ogre::VertexData> mVertexData;
+  Ogre::HardwareVertexBufferSharedPtr mInstanceBuffer{};
+  /// Number of instances in `mInstanceBuffer`.
+  std::size_t mNumEnabledInstances{};
+  /// Bounds of the enabled instances.
+  Ogre::AxisAlignedBox mAABB{};
+  /// Bounds of all instances.
+  Ogre::AxisAlignedBox mFullAABB{};
+  bool mIsDirty{true};
+};
+
+class InstancedGeometryFactory : public Ogre::MovableObjectFactory {
+ public:
+  InstancedGeometryFactory() = default;
+  ~InstancedGeometryFactory() override = default;
+
+  void destroyInstance(gsl::owner<Ogre::MovableObject *> obj) override;
+  const std::string &getType() const override;
+
+  constexpr static const char *FACTORY_TYPE_NAME{"oo::InstancedGeometry"};
+
+ protected:
+  gsl::owner<Ogre::MovableObject *>
+  createInstanceImpl(const std::string &name,
+                     const Ogre::NameValuePairList *params) override;
+};
+
+/// @}
+
+} // namespace oo
+
+#endif // OPENOBL_INSTANCED_GEOMETRY_HPP
@@ -0,0 +1,73 @@
+#ifndef OPENOBL_LOD_GENERATOR_HPP
+#define OPENOBL_LOD_GENERATOR_HPP
+
+#include <gsl/gsl>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace oo {
+
+/// \addtogroup OpenOBLMesh
+/// @{
+
+/// Description of a level of detail of an `oo::Mesh` that is generated when
+/// the mesh is loaded, since meshes do not ship with any.
+struct LodLevel {
+  /// The level is used when the bounding sphere of an entity covers less than
+  /// this fraction of the height of the viewport. See
+  /// `oo::Mesh::getLodIndex()`.
+  float screenSize;
+  /// Fraction of the triangles of the full detail geometry to keep.
+  float reduction;
+};
+
+/// Levels of detail generated for every submesh, in order of decreasing
+/// detail. The full detail geometry is not included.
+constexpr std::array<LodLevel, 2> DEFAULT_LOD_LEVELS{{
+    {0.2f, 0.5f},
+    {0.06f, 0.2f}
+}};
+
+/// Submeshes with fewer triangles than this are not simplified, since drawing
+/// them is cheap anyway and they lose their shape quickly.
+constexpr std::size_t MIN_LOD_TRIANGLES{64u};
+
+/// Simplify a triangle list by repeatedly collapsing the edge whose removal
+/// changes the surface the least, as measured by the quadric error metric of
+/// Garland and Heckbert.
+///
+/// Edges are collapsed onto one of their endpoints instead of onto a new
+/// vertex, so the simplified triangles index into the same vertex buffer as
+/// the original ones and only a new index buffer is required. Vertices with
+/// the same position, such as those along a texture seam, are treated as a
+/// single vertex so that collapsing an edge does not tear the surface.
+///
+/// \param vertices Interleaved vertex data, `stride` floats per vertex, with
+///                 the position in the first three floats of each vertex.
+/// \param stride The number of floats per vertex.
+/// \param indices The triangle list to simplify.
+/// \param targetTriangles The number of triangles to stop at. Fewer triangles
+///                        may be returned if collapsing an edge removes more
+///                        than one, and more triangles may be returned if the
+///                        surface cannot be simplified further without
+///                        flipping any triangles.
+/// \returns The simplified triangle list, or an empty list if any of the
+///          `indices` does not refer to a vertex in `vertices`.
+std::vector<uint16_t>
+simplifyTriangleList(gsl::span<const float> vertices, std::size_t stride,
+                     gsl::span<const uint16_t> indices,
+                     std::size_t targetTriangles);
+
+/// Convert a triangle strip to a triangle list, dropping any degenerate
+/// triangles.
+std::vector<uint16_t> triangleStripToList(gsl::span<const uint16_t> indices);
+
+/// \overload triangleStripToList(gsl::span<const uint16_t>)
+std::vector<uint32_t> triangleStripToList(gsl::span<const uint32_t> indices);
+
+/// @}
+
+} // namespace oo
+
+#endif // OPENOBL_LOD_GENERATOR_HPP
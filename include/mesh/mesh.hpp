@@ -6,6 +6,9 @@
 #include <OgreAnimation.h>
 #include <OgreAxisAlignedBox.h>
 #include <OgreResource.h>
+#include <OgreVector.h>
+#include <memory>
+#include <vector>
 #include "util/windows_cleanup.hpp"
 
 /// \defgroup OpenOBLMesh OGRE Mesh Replacement Library
@@ -60,6 +63,35 @@ class Mesh : public Ogre::Resource {
 
   Ogre::HardwareBufferManagerBase *getHardwareBufferManager() const;
 
+  /// Return the number of levels of detail, including full detail.
+  std::size_t getNumLodLevels() const noexcept;
+
+  /// Return the screen-space sizes below which each level of detail after the
+  /// first is used, in decreasing order.
+  const std::vector<float> &getLodScreenSizes() const noexcept;
+
+  /// Return the level of detail to use when the bounding sphere of the mesh
+  /// covers the given fraction of the height of the viewport, where 0 is full
+  /// detail.
+  std::size_t getLodIndex(float screenSize) const noexcept;
+
+  /// Set the screen-space sizes below which each level of detail after the
+  /// first is used.
+  /// \pre `screenSizes` is in decreasing order, and each submesh has at most
+  ///      `screenSizes.size()` simplified levels of detail.
+  void _setLodScreenSizes(std::vector<float> screenSizes);
+
+  /// Return the triangles that entities of this mesh draw into the depth
+  /// buffer of the `oo::OcclusionCuller`, as a list of vertex positions with
+  /// three for each triangle, or nullptr if the mesh does not occlude anything.
+  const std::shared_ptr<const std::vector<Ogre::Vector3>> &
+  getOccluderTriangles() const noexcept;
+
+  /// Append triangles to those returned by `getOccluderTriangles()`.
+  /// \param triangles Vertex positions in the coordinate system of the mesh,
+  ///                  three for each triangle.
+  void _addOccluderTriangles(const std::vector<Ogre::Vector3> &triangles);
+
  private:
   SubMeshList mSubMeshList{};
   SubMeshNameMap mSubMeshNameMap{};
@@ -70,6 +102,14 @@ class Mesh : public Ogre::Resource {
   float mBoundRadius{};
   // mBoneBoundingRadius TODO: Move into Entity and compute for each skeleton
 
+  /// Screen-space sizes below which each level of detail after the first is
+  /// used.
+  std::vector<float> mLodScreenSizes{};
+
+  /// Occluder geometry, shared with the `oo::OcclusionCuller` so that it stays
+  /// alive until it has been drawn even if the mesh is unloaded.
+  std::shared_ptr<const std::vector<Ogre::Vector3>> mOccluderTriangles{};
+
   Ogre::HardwareBufferManagerBase *mBufMgr{};
 
  protected:
@@ -0,0 +1,174 @@
+#ifndef OPENOBL_SKELETAL_ANIMATION_HPP
+#define OPENOBL_SKELETAL_ANIMATION_HPP
+
+#include <gsl/gsl>
+#include <OgreMatrix4.h>
+#include <OgrePrerequisites.h>
+#include <OgreQuaternion.h>
+#include <OgreVector.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+/// \addtogroup OpenOBLMesh
+/// @{
+
+/// Transformations of every bone in a skeleton, stored as a structure of
+/// arrays indexed by bone handle.
+///
+/// Each component is stored in a separate array so that operations applied to
+/// every bone, such as blending two poses together, are simple loops over
+/// contiguous floats that the compiler can vectorize.
+struct Pose {
+  std::vector<float> tx{}, ty{}, tz{};
+  std::vector<float> rw{}, rx{}, ry{}, rz{};
+  std::vector<float> sx{}, sy{}, sz{};
+
+  /// Resize the pose to hold `numBones` bones and set every bone to the
+  /// identity transformation.
+  void setIdentity(std::size_t numBones);
+
+  std::size_t size() const noexcept;
+};
+
+/// Keyframes of a single bone in an `oo::AnimationClip`.
+/// Translation, rotation, and scale keys are independent, and each is stored
+/// as a structure of arrays. The keys of each kind must be sorted by time.
+struct BoneTrack {
+  uint16_t boneHandle{};
+
+  std::vector<float> translationTimes{};
+  std::vector<float> tx{}, ty{}, tz{};
+
+  std::vector<float> rotationTimes{};
+  std::vector<float> rw{}, rx{}, ry{}, rz{};
+
+  std::vector<float> scaleTimes{};
+  std::vector<float> sx{}, sy{}, sz{};
+
+  void addTranslationKey(float time, const Ogre::Vector3 &t);
+  void addRotationKey(float time, const Ogre::Quaternion &r);
+  void addScaleKey(float time, const Ogre::Vector3 &s);
+};
+
+/// Skeletal animation that can be sampled without an `Ogre::Skeleton`, and
+/// therefore on any thread.
+///
+/// The keyframes of an animation clip are identical to those of the
+/// `Ogre::Animation` of the same name, namely they are relative to the binding
+/// pose of each bone. Keys are linearly interpolated, with rotations
+/// interpolated along the shortest path, which matches OGRE's default
+/// interpolation modes.
+class AnimationClip {
+ public:
+  explicit AnimationClip(float length) noexcept : mLength(length) {}
+
+  float getLength() const noexcept;
+
+  /// Return the track of the given bone, creating it if it does not exist.
+  BoneTrack &getTrack(uint16_t boneHandle);
+
+  const std::vector<BoneTrack> &getTracks() const noexcept;
+
+  /// Set each bone of `pose` with a track to its transformation at the given
+  /// time. Times outside the keys of a track are clamped to the first or last
+  /// key. Bones without a track are not modified.
+  /// \pre `pose` has an entry for every bone with a track.
+  void sample(float time, Pose &pose) const;
+
+ private:
+  float mLength;
+  std::vector<BoneTrack> mTracks{};
+};
+
+using AnimationClipPtr = std::shared_ptr<const oo::AnimationClip>;
+
+/// Collection of all the `oo::AnimationClip`s, indexed by the name of the
+/// skeleton they belong to and the name of the `Ogre::Animation` they were
+/// created alongside. Like `oo::JobManager`, all the methods are `static`.
+///
+/// All the methods may be called from any thread.
+class AnimationClipRegistry {
+ private:
+  using Key = std::pair<std::string, std::string>;
+
+  static std::map<Key, AnimationClipPtr> &getClips() {
+    static std::map<Key, AnimationClipPtr> clips{};
+    return clips;
+  }
+
+  static std::mutex &getMutex() {
+    static std::mutex mutex{};
+    return mutex;
+  }
+
+ public:
+  AnimationClipRegistry() = delete;
+
+  /// Add a clip, replacing any existing clip with the same names.
+  static void add(const std::string &skeletonName,
+                  const std::string &animationName,
+                  AnimationClipPtr clip) {
+    std::scoped_lock lock{getMutex()};
+    getClips()[{skeletonName, animationName}] = std::move(clip);
+  }
+
+  /// Return the clip with the given names, or nullptr if there is none.
+  static AnimationClipPtr get(const std::string &skeletonName,
+                              const std::string &animationName) {
+    std::scoped_lock lock{getMutex()};
+    const auto &clips{getClips()};
+    auto it{clips.find({skeletonName, animationName})};
+    return it != clips.end() ? it->second : nullptr;
+  }
+};
+
+/// Binding pose of a skeleton, in the form needed by `oo::evaluatePose()`.
+struct BindPose {
+  /// Initial transformation of each bone relative to its parent.
+  Pose initial{};
+  /// Handle of each bone's parent, or -1 if the bone is a root bone.
+  std::vector<int> parents{};
+  /// Bone handles ordered so that every bone comes after its parent.
+  std::vector<uint16_t> order{};
+  /// Inverse of the derived binding transformation of each bone.
+  std::vector<Ogre::Vector3> inversePositions{};
+  std::vector<Ogre::Quaternion> inverseOrientations{};
+  std::vector<Ogre::Vector3> inverseScales{};
+
+  explicit BindPose(const Ogre::Skeleton &skeleton);
+};
+
+/// An `oo::AnimationClip` playing at a given time and weight.
+struct AnimationLayer {
+  AnimationClipPtr clip{};
+  float time{};
+  /// Weight of the layer, after any normalization of the total weight.
+  float weight{};
+};
+
+/// Evaluate the pose of a skeleton playing the given animation layers, writing
+/// the transformation of each bone from its binding pose into `boneMatrices`.
+/// This has the same effect as applying the corresponding
+/// `Ogre::AnimationState`s with `Ogre::Skeleton::setAnimationState()` and
+/// calling `Ogre::Skeleton::_getBoneMatrices()`, but does not modify the
+/// skeleton so can be run on any thread.
+/// \param localPose Receives the transformation of each bone relative to its
+///                  parent.
+/// \param scratch Temporary storage, to avoid allocating on every call.
+/// \param boneMatrices Receives one matrix per bone, in handle order.
+void evaluatePose(const BindPose &bindPose,
+                  gsl::span<const AnimationLayer> layers,
+                  Pose &localPose, Pose &scratch,
+                  Ogre::Affine3 *boneMatrices);
+
+/// @}
+
+} // namespace oo
+
+#endif // OPENOBL_SKELETAL_ANIMATION_HPP
@@ -0,0 +1,185 @@
+#ifndef OPENOBL_STATIC_BATCH_HPP
+#define OPENOBL_STATIC_BATCH_HPP
+
+#include "mesh/entity.hpp"
+#include <gsl/gsl>
+#include <OgreMovableObject.h>
+#include <OgreRenderable.h>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace oo {
+
+/// \addtogroup OpenOBLMesh
+/// @{
+
+class StaticBatchFactory;
+
+/// Collection of static geometry merged into a small number of renderables.
+/// Every `oo::SubMesh` of every `oo::Entity` added to the batch is transformed
+/// into the local space of the batch's parent node and appended to a shared
+/// vertex and index buffer, one for each material, so that a cell full of
+/// static references can be drawn with a handful of draw calls instead of one
+/// per `oo::SubEntity`.
+///
+/// Geometry is grouped by *owner*, an opaque identifier chosen by the caller,
+/// which in practice is the `oo::RefId` of the reference that the geometry
+/// belongs to. Owners can be disabled and re-enabled, in which case the batch
+/// is marked dirty and rebuilt the next time it is rendered.
+///
+/// Only unskinned triangle geometry with an opaque material can be batched,
+/// and only if its submeshes kept a copy of their geometry in main memory (see
+/// `oo::SubMesh::stagedVertices`); entities that do not satisfy this are
+/// rejected by `addEntity()` and should be rendered normally.
+///
+/// \remark Building the batch creates hardware buffers, so must be done on the
+///         render thread.
+class StaticBatch : public Ogre::MovableObject {
+ public:
+  using OwnerId = uint32_t;
+
+  class Batch;
+
+ private:
+  friend class oo::StaticBatchFactory;
+
+  explicit StaticBatch(const std::string &name);
+
+  /// A single submesh placed in the batch.
+  struct Instance {
+    /// Keeps the submesh alive for as long as the batch needs it.
+    oo::MeshPtr mMesh{};
+    oo::SubMesh *mSubMesh{};
+    Ogre::MaterialPtr mMaterial{};
+    /// Transformation from the submesh's local space to the batch's.
+    Ogre::Affine3 mTransform{};
+    OwnerId mOwner{};
+  };
+
+  using BatchList = std::vector<std::unique_ptr<Batch>>;
+
+  /// Every instance added to the batch, including disabled ones.
+  std::vector<Instance> mInstances{};
+  /// Owners that should not currently be drawn.
+  std::set<OwnerId> mDisabledOwners{};
+  /// The merged renderables, built from the enabled instances.
+  BatchList mBatches{};
+  /// Bounds of the geometry in the batch's local space.
+  Ogre::AxisAlignedBox mAABB{};
+  float mBoundRadius{};
+  /// Whether `mBatches` needs to be rebuilt before it is next rendered.
+  bool mIsDirty{false};
+
+  /// Merge the given instances, which must share a material, into batches and
+  /// append them to `mBatches`.
+  void buildBatches(const std::vector<const Instance *> &instances);
+
+  /// Recompute the bounds of the batch from all its instances.
+  void updateBounds();
+
+ public:
+  ~StaticBatch() override;
+
+  /// Return whether the geometry of `entity` can be added to a batch.
+  static bool isBatchable(const oo::Entity &entity);
+
+  /// Add the geometry of `entity` to the batch, with the given transformation
+  /// into the batch's local space.
+  /// \returns `false`, and does not modify the batch, if `entity` is not
+  ///          batchable.
+  bool addEntity(const oo::Entity &entity, const Ogre::Affine3 &transform,
+                 OwnerId owner);
+
+  /// Remove all geometry belonging to the given owner.
+  void removeOwner(OwnerId owner);
+
+  /// Show or hide all geometry belonging to the given owner.
+  void setOwnerEnabled(OwnerId owner, bool enabled);
+  bool isOwnerEnabled(OwnerId owner) const;
+
+  /// Return whether the batch contains any geometry of the given owner.
+  bool hasOwner(OwnerId owner) const;
+
+  /// Rebuild the merged geometry from the enabled owners.
+  /// This is called automatically when the batch is rendered after being
+  /// modified, but can be called explicitly to avoid a hitch on the first
+  /// frame.
+  void build();
+
+  /// Return the number of renderables that the batch will submit.
+  std::size_t getNumBatches() const noexcept;
+
+  /// Return the number of submeshes that have been merged into the batch.
+  std::size_t getNumInstances() const noexcept;
+
+  /// \name MovableObject overrides
+  /// @{
+
+  const Ogre::AxisAlignedBox &getBoundingBox() const override;
+
+  float getBoundingRadius() const override;
+
+  void _updateRenderQueue(Ogre::RenderQueue *queue) override;
+
+  const std::string &getMovableType() const override;
+
+  uint32_t getTypeFlags() const override;
+
+  void visitRenderables(Ogre::Renderable::Visitor *visitor,
+                        bool debugRenderables = false) override;
+  /// @}
+};
+
+/// Merged geometry of one material in an `oo::StaticBatch`.
+class StaticBatch::Batch : public Ogre::Renderable {
+ public:
+  Batch(oo::StaticBatch *parent, Ogre::MaterialPtr material,
+        std::unique_ptr<Ogre::VertexData> vertexData,
+        std::unique_ptr<Ogre::IndexData> indexData,
+        const Ogre::AxisAlignedBox &aabb);
+
+  const Ogre::AxisAlignedBox &getBoundingBox() const noexcept;
+
+  /// \name Renderable overrides
+  /// @{
+
+  const Ogre::MaterialPtr &getMaterial() const override;
+  Ogre::Technique *getTechnique() const override;
+  void getRenderOperation(Ogre::RenderOperation &op) override;
+  void getWorldTransforms(Ogre::Matrix4 *xform) const override;
+  float getSquaredViewDepth(const Ogre::Camera *camera) const override;
+  const Ogre::LightList &getLights() const override;
+  bool getCastsShadows() const override;
+
+  /// @}
+
+ private:
+  oo::StaticBatch *mParent;
+  Ogre::MaterialPtr mMaterial;
+  std::unique_ptr<Ogre::VertexData> mVertexData;
+  std::unique_ptr<Ogre::IndexData> mIndexData;
+  Ogre::AxisAlignedBox mAABB;
+};
+
+class StaticBatchFactory : public Ogre::MovableObjectFactory {
+ public:
+  StaticBatchFactory() = default;
+  ~StaticBatchFactory() override = default;
+
+  void destroyInstance(gsl::owner<Ogre::MovableObject *> obj) override;
+  const std::string &getType() const override;
+
+  constexpr static const char *FACTORY_TYPE_NAME{"oo::StaticBatch"};
+
+ protected:
+  gsl::owner<Ogre::MovableObject *>
+  createInstanceImpl(const std::string &name,
+                     const Ogre::NameValuePairList *params) override;
+};
+
+/// @}
+
+} // namespace oo
+
+#endif // OPENOBL_STATIC_BATCH_HPP
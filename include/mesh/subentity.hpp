@@ -59,6 +59,9 @@ class SubEntity : public Ogre::Renderable {
   Ogre::MaterialPtr mMaterialPtr{};
 
   bool mIsVisible : 1;
+  /// Whether the subentity is hidden from the current camera by an occluder,
+  /// see `oo::OcclusionCuller`.
+  bool mIsOccluded : 1;
   /// Whether to use `mRenderQueueId` instead of the default.
   bool mUseCustomRenderQueueId : 1;
   /// Whether to use `mRenderQueuePriority` instead of the default.
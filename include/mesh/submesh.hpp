@@ -1,11 +1,14 @@
 #ifndef OPENOBL_SUBMESH_HPP
 #define OPENOBL_SUBMESH_HPP
 
+#include <OgreAxisAlignedBox.h>
 #include <OgreIteratorWrapper.h>
 #include <OgrePrerequisites.h>
 #include <OgreRenderOperation.h>
 #include <OgreResourceGroupManager.h>
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include "util/windows_cleanup.hpp"
 
 namespace oo {
@@ -27,7 +30,11 @@ class SubMesh {
 
   /// Return an `Ogre::RenderOperation` structure required to render this mesh.
   /// \param rend Reference to an `Ogre::RenderOperation` structure to populate.
-  void _getRenderOperation(Ogre::RenderOperation &rend);
+  /// \param lodIndex The level of detail to render, where 0 is full detail. If
+  ///                 the submesh does not have that many levels of detail then
+  ///                 the least detailed one is used.
+  void _getRenderOperation(Ogre::RenderOperation &rend,
+                           std::size_t lodIndex = 0);
 
   /// Make a copy of this submesh and give it a new name.
   /// \param newName The name to give the cloned submesh.
@@ -42,6 +49,26 @@ class SubMesh {
   /// Face index data.
   std::unique_ptr<Ogre::IndexData> indexData{};
 
+  /// Simplified face index data for each level of detail after the first, in
+  /// order of decreasing detail. These index into `vertexData` and are always
+  /// triangle lists, regardless of `operationType`.
+  std::vector<std::unique_ptr<Ogre::IndexData>> lodIndexData{};
+
+  /// Copy in main memory of the vertex buffer of `vertexData`, laid out as
+  /// described by its vertex declaration.
+  /// The hardware buffers are write-only, so this is kept for the static,
+  /// opaque submeshes that may be merged with others into a batch. It is empty
+  /// for every other submesh.
+  std::vector<float> stagedVertices{};
+
+  /// Copy in main memory of the index buffer of `indexData`, empty whenever
+  /// `stagedVertices` is.
+  std::vector<uint16_t> stagedIndices{};
+
+  /// Bounding box of the vertices in the coordinate system of the parent mesh,
+  /// or null if unknown.
+  Ogre::AxisAlignedBox bounds{};
+
   /// Names of bones, used to translate bone indices to blend indices.
   std::vector<std::string> boneNames{};
 
@@ -26,6 +26,8 @@ class DebugDrawImpl {
 
   GameMode *mGameMode;
   constexpr static std::size_t NUM_FPS_SAMPLES{64u};
+  /// Number of textures listed in the texture streaming display.
+  constexpr static std::size_t NUM_TEXTURE_STATS_SHOWN{32u};
   boost::circular_buffer<float> mFrameTimes;
   bool mFpsDisplayEnabled{false};
 
@@ -35,6 +37,18 @@ class DebugDrawImpl {
                         const Ogre::Affine3 &t = Ogre::Affine3::IDENTITY)
   /*C++20: [[expects : mDebugDrawer != nullptr]]*/;
 
+  /// Draw a section of the fps window displaying the total video memory used
+  /// by textures, and the residency of the largest textures.
+  void drawTextureStreamingDisplay();
+
+  /// Draw a section of the fps window displaying how many objects were culled
+  /// by the occlusion culler, and how long building its depth buffer took.
+  void drawOcclusionCullingDisplay();
+
+  /// Draw a section of the fps window displaying how many cascades of the sun
+  /// shadows were redrawn, and how many casters each one has.
+  void drawSunShadowsDisplay();
+
   /// Use the debug drawer to draw the skeleton of the given `entity`.
   void drawSkeleton(gsl::not_null<oo::Entity *> entity)
   /*C++20: [[expects : mDebugDrawer != nullptr]]*/;
@@ -0,0 +1,38 @@
+#ifndef OPENOBL_FRAME_TIME_SAMPLER_HPP
+#define OPENOBL_FRAME_TIME_SAMPLER_HPP
+
+#include <cstddef>
+#include <optional>
+
+namespace oo {
+
+/// Averages the frame time over a fixed number of frames, for the stress tests
+/// to log periodically.
+class FrameTimeSampler {
+ public:
+  /// Number of frames to average the frame time over.
+  constexpr static std::size_t NUM_SAMPLES{300u};
+
+  /// Record the duration of the last frame, in seconds.
+  /// \returns The average frame time in milliseconds if `NUM_SAMPLES` frames
+  ///          have been recorded since it was last returned, and nothing
+  ///          otherwise.
+  std::optional<float> addFrame(float delta) noexcept {
+    mTotalTime += delta;
+    if (++mNumFrames < NUM_SAMPLES) return std::nullopt;
+
+    const float frameTime{1000.0f * mTotalTime
+                              / static_cast<float>(mNumFrames)};
+    mNumFrames = 0u;
+    mTotalTime = 0.0f;
+    return frameTime;
+  }
+
+ private:
+  std::size_t mNumFrames{0u};
+  float mTotalTime{0.0f};
+};
+
+} // namespace oo
+
+#endif // OPENOBL_FRAME_TIME_SAMPLER_HPP
@@ -2,20 +2,26 @@
 #define OPENOBL_GAME_MODE_HPP
 
 #include "application_context.hpp"
+#include "bullet/async_stepper.hpp"
 #include "bullet/collision.hpp"
 #include "cell_cache.hpp"
 #include "character_controller/character.hpp"
 #include "exterior_manager.hpp"
+#include "mesh/entity.hpp"
 #include "modes/mode.hpp"
 #include "modes/menu_mode.hpp"
 #include "record/formid.hpp"
+#include "scripting/script_scheduler.hpp"
 #include "sdl/sdl.hpp"
 #include <memory>
+#include <vector>
 
 namespace oo {
 
 class OctreeNode;
 class DebugDrawImpl;
+class InstancingStressTest;
+class LightingStressTest;
 
 class ConsoleMode;
 
@@ -44,7 +50,26 @@ class GameMode {
   friend oo::DebugDrawImpl;
   std::unique_ptr<oo::DebugDrawImpl> mDebugDrawImpl;
 
-  /// Run all registered collision callbacks with the collisions for this frame.
+  std::unique_ptr<oo::InstancingStressTest> mInstancingStressTest{};
+  std::unique_ptr<oo::LightingStressTest> mLightingStressTest{};
+
+  /// Whether `oo::buildDistantObjects()` should be run on the next update.
+  bool mBuildDistantObjects{false};
+
+  /// Runs the `GameMode` blocks of scripted references each update. Owned by
+  /// the `oo::ApplicationContext`, and populated by the cells as their
+  /// references are shown and hidden.
+  oo::ScriptScheduler *mScriptScheduler{};
+
+  /// Steps the physics world between frames. Declared last so that it is
+  /// destroyed first, since any step in progress must finish before the world
+  /// it is stepping is destroyed.
+  std::unique_ptr<bullet::AsyncStepper> mPhysicsStepper{};
+  /// Time elapsed since the physics world was last stepped, in seconds.
+  float mPhysicsDelta{0.0f};
+
+  /// Run all registered collision callbacks with the collisions recorded by
+  /// the last physics step.
   void dispatchCollisions();
 
   /// Return a reference to the object under the crosshair.
@@ -64,9 +89,14 @@ class GameMode {
   /// Print information about the reference under the cursor, if it has changed.
   void logRefUnderCursor(ApplicationContext &ctx) const;
 
-  /// Update the enabled animation states of all entities in the scene.
+  /// Update the enabled animation states of all entities in the scene, then
+  /// evaluate the poses of their skeletons on the worker threads.
   void updateAnimation(float delta);
 
+  /// Run the given pose jobs, spread across the render thread and the worker
+  /// threads, returning once they have all completed.
+  static void runPoseJobs(std::vector<oo::PoseJob> jobs);
+
   /// Update the centred cell if it has changed, loading new cells and unloading
   /// old ones as appropriate.
   /// Specifically, if the player has moved to a different cell this frame then
@@ -110,6 +140,18 @@ class GameMode {
   /// \see Mode::update()
   void update(ApplicationContext &ctx, float delta);
 
+  /// Start stepping the physics world forward by the time elapsed since it was
+  /// last stepped. The step runs on another thread until `waitForPhysics()` is
+  /// called, and the physics world must not be touched in the meantime. The
+  /// merged static collision of the loaded cells is brought up to date first.
+  /// \remark This should be called once the frame has been queued for
+  ///         rendering, so that the step overlaps with the end of the frame.
+  void beginPhysicsStep();
+
+  /// Finish the physics step begun by `beginPhysicsStep()`, if any, moving the
+  /// objects that it moved and running the collision callbacks for it.
+  void waitForPhysics();
+
   /// Toggle a wireframe display of all collision objects in the scene.
   void toggleCollisionGeometry();
 
@@ -119,6 +161,32 @@ class GameMode {
 
   /// Toggle a fps display window.
   void toggleFps();
+
+  /// Start an `oo::InstancingStressTest` using the entity under the crosshair,
+  /// placing `count` copies of it in front of the player, replacing any
+  /// existing test. Passing zero stops the current test.
+  void runInstancingStressTest(std::size_t count, bool instanced);
+
+  /// Start an `oo::LightingStressTest` placing `count` point lights around the
+  /// player, replacing any existing test. Passing zero stops the current test.
+  void runLightingStressTest(std::size_t count, bool clustered);
+
+  /// Build the distant objects of the current worldspace with
+  /// `oo::buildDistantObjects()` at the start of the next update. Does nothing
+  /// if the player is in an interior.
+  void buildDistantObjects();
+
+  /// Return the scheduler running the `GameMode` blocks of the scripts
+  /// attached to references.
+  /// \see oo::Cell::setScriptScheduler()
+  oo::ScriptScheduler &getScriptScheduler() noexcept;
+
+  /// Print the execution statistics of the `count` slowest scripts to the
+  /// console.
+  void printScriptProfile(std::size_t count) const;
+
+  /// Clear the execution statistics of every script.
+  void resetScriptProfile();
 };
 
 } // namespace oo
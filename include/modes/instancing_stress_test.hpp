@@ -0,0 +1,58 @@
+#ifndef OPENOBL_INSTANCING_STRESS_TEST_HPP
+#define OPENOBL_INSTANCING_STRESS_TEST_HPP
+
+#include "mesh/entity.hpp"
+#include "mesh/instanced_geometry.hpp"
+#include "modes/frame_time_sampler.hpp"
+#include <gsl/gsl>
+#include <OgreSceneManager.h>
+#include <OgreVector.h>
+#include <vector>
+
+namespace oo {
+
+/// Benchmark for `oo::InstancedGeometry`.
+/// Places a large square grid of identical copies of an entity in the scene,
+/// either as a single `oo::InstancedGeometry` or as separate `oo::Entity`s,
+/// and periodically logs the average frame time while the grid exists. Running
+/// the test twice with the same number of copies, once in each mode, compares
+/// the cost of drawing repeated meshes with and without instancing.
+///
+/// Everything created by the test is destroyed along with it.
+class InstancingStressTest {
+ public:
+  /// Place `count` copies of `source` in a square grid centred on `centre`.
+  /// The copies are spaced apart so that they do not overlap.
+  /// \pre If `instanced` is true then `source` must be instanceable, see
+  ///      `oo::InstancedGeometry::isInstanceable()`.
+  /// \remark Must be run on the render thread.
+  InstancingStressTest(gsl::not_null<Ogre::SceneManager *> scnMgr,
+                       const oo::Entity &source,
+                       const Ogre::Vector3 &centre,
+                       std::size_t count,
+                       bool instanced);
+  ~InstancingStressTest();
+  InstancingStressTest(const InstancingStressTest &) = delete;
+  InstancingStressTest &operator=(const InstancingStressTest &) = delete;
+  InstancingStressTest(InstancingStressTest &&) = delete;
+  InstancingStressTest &operator=(InstancingStressTest &&) = delete;
+
+  /// Record the duration of the last frame, in seconds.
+  void update(float delta);
+
+ private:
+  constexpr static const char *NODE_NAME{"__InstancingStressTest"};
+
+  gsl::not_null<Ogre::SceneManager *> mScnMgr;
+  Ogre::SceneNode *mRootNode{};
+  oo::InstancedGeometry *mGeometry{};
+  std::vector<oo::Entity *> mEntities{};
+  std::size_t mCount;
+  bool mInstanced;
+
+  oo::FrameTimeSampler mSampler{};
+};
+
+} // namespace oo
+
+#endif // OPENOBL_INSTANCING_STRESS_TEST_HPP
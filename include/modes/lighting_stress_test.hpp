@@ -0,0 +1,59 @@
+#ifndef OPENOBL_LIGHTING_STRESS_TEST_HPP
+#define OPENOBL_LIGHTING_STRESS_TEST_HPP
+
+#include "modes/frame_time_sampler.hpp"
+#include "ogre/scene_manager.hpp"
+#include <gsl/gsl>
+#include <OgreLight.h>
+#include <OgreVector.h>
+#include <vector>
+
+namespace oo {
+
+/// Benchmark for clustered lighting.
+/// Fills the area around a point with a large number of point lights arranged
+/// in a square grid, alternating between torch-like lights mounted high with a
+/// large radius and candle-like lights lower down with a small radius, and
+/// periodically logs the average frame time while the lights exist. Running the
+/// test twice with the same number of lights, once with clustered lighting and
+/// once without, compares the cost of `oo::ClusteredLights` against drawing a
+/// light volume for each point light.
+///
+/// Everything created by the test is destroyed along with it, and the lighting
+/// mode of the scene manager is restored.
+class LightingStressTest {
+ public:
+  /// Place `count` point lights in a square grid centred on `centre`, and set
+  /// whether the scene manager uses clustered lighting.
+  /// \remark Must be run on the render thread.
+  LightingStressTest(gsl::not_null<oo::DeferredSceneManager *> scnMgr,
+                     const Ogre::Vector3 &centre,
+                     std::size_t count,
+                     bool clustered);
+  ~LightingStressTest();
+  LightingStressTest(const LightingStressTest &) = delete;
+  LightingStressTest &operator=(const LightingStressTest &) = delete;
+  LightingStressTest(LightingStressTest &&) = delete;
+  LightingStressTest &operator=(LightingStressTest &&) = delete;
+
+  /// Record the duration of the last frame, in seconds.
+  void update(float delta);
+
+ private:
+  constexpr static const char *NODE_NAME{"__LightingStressTest"};
+  /// Distance between neighbouring lights in the grid, in metres.
+  constexpr static float SPACING{2.5f};
+
+  gsl::not_null<oo::DeferredSceneManager *> mScnMgr;
+  Ogre::SceneNode *mRootNode{};
+  std::vector<Ogre::Light *> mLights{};
+  std::size_t mCount;
+  bool mClustered;
+  bool mWasClustered;
+
+  oo::FrameTimeSampler mSampler{};
+};
+
+} // namespace oo
+
+#endif // OPENOBL_LIGHTING_STRESS_TEST_HPP
@@ -3,7 +3,7 @@
 
 #include "modes/menu_mode.hpp"
 #include "modes/menu_mode_base.hpp"
-#include "save_state.hpp"
+#include "save_index.hpp"
 
 namespace oo {
 
@@ -41,28 +41,26 @@ template<> class MenuMode<gui::MenuType::LoadMenu>
   /// `<id> 9 </id>`
   gui::UiElement *listPane{};
 
-  using SaveEntry = std::filesystem::directory_entry;
-
   struct SaveGame {
     gui::UiElement *element;
-    SaveState state;
-    SaveEntry entry;
-    explicit SaveGame(gui::UiElement *pElement,
-                      SaveState pState,
-                      SaveEntry pEntry)
-        : element(pElement),
-          state(std::move(pState)),
-          entry(std::move(pEntry)) {}
+    SaveHeader header;
+    explicit SaveGame(gui::UiElement *pElement, SaveHeader pHeader)
+        : element(pElement), header(std::move(pHeader)) {}
   };
 
+  /// Save game headers, which are read asynchronously and added to the list
+  /// as they become available.
+  SaveIndex mIndex{};
+
   std::vector<SaveGame> mSaveGames{};
   std::size_t mSaveIndex{};
 
-  /// Find all the save games and sort them by access time, most recent first.
-  std::vector<SaveEntry> getSaveEntries() const;
+  std::string getSaveName(const SaveHeader &header) const;
+  std::string getSaveDescription(const SaveHeader &header) const;
 
-  std::string getSaveName(const SaveState &saveState) const;
-  std::string getSaveDescription(const SaveState &saveState) const;
+  /// Add any save games whose headers have been read since this was last
+  /// called to the end of the list.
+  void appendSaveGames();
 
   void setCurrentSave(std::size_t index);
 
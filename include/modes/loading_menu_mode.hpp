@@ -147,6 +147,10 @@ template<> class MenuMode<gui::MenuType::LoadingMenu>
   /// \pre The given cell must not already be cached.
   void reifyInteriorCell(oo::BaseId cellId, ApplicationContext &ctx);
 
+  /// Prepare the models of the given loaded cell on a worker thread, waiting
+  /// until they have been uploaded. See `oo::prepareCell()`.
+  void prepareCell(const record::CELL &cellRec, ApplicationContext &ctx);
+
   /// Load the given exterior cell. This only loads the cell via the cell
   /// resolver, no reification takes place.
   void loadExteriorCell(const record::CELL &cellRec, ApplicationContext &ctx);
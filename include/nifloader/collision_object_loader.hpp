@@ -12,6 +12,9 @@ class CollisionObjectLoader : public Ogre::ManualResourceLoader {
   friend class CollisionObjectLoaderState;
 
  public:
+  /// Prepare the NIF file backing the collision object, parsing it on the
+  /// calling thread.
+  void prepareResource(Ogre::Resource *resource) override;
   void loadResource(Ogre::Resource *resource) override;
 };
 
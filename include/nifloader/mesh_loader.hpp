@@ -12,6 +12,8 @@ class MeshLoader : public Ogre::ManualResourceLoader {
   friend class MeshLoaderState;
 
  public:
+  /// Prepare the NIF file backing the mesh, parsing it on the calling thread.
+  void prepareResource(Ogre::Resource *resource) override;
   void loadResource(Ogre::Resource *resource) override;
 };
 
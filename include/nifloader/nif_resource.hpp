@@ -2,14 +2,29 @@
 #define OPENOBL_NIF_RESOURCE_HPP
 
 #include "nifloader/loader.hpp"
+#include "nifloader/staged_geometry.hpp"
 #include <OgreResource.h>
 #include <memory>
+#include <mutex>
 
 namespace Ogre {
 
 /// \addtogroup OpenOBLNifloader
 /// @{
 
+/// The block graph of a NIF file.
+///
+/// Loading a NIF file is split into two phases, following OGRE's distinction
+/// between preparing and loading a resource. Preparing the resource reads and
+/// parses the file into a block graph, builds the vertex and index data of
+/// every `nif::NiTriBasedGeom` in main memory, and creates the
+/// `Ogre::CollisionShape` of every `nif::bhk::CollisionObject`. None of this
+/// requires the render thread, so `prepare()` may be called from a worker
+/// thread. There is nothing further to do when the resource is loaded, since
+/// the GPU resources described by the file are created separately by
+/// `oo::insertNif()` and `oo::uploadNif()`, which consume the staged geometry.
+/// If the resource is loaded without first being prepared, then it is prepared
+/// on the calling thread.
 class NifResource : public Ogre::Resource {
  public:
   NifResource(ResourceManager *creator,
@@ -25,14 +40,46 @@ class NifResource : public Ogre::Resource {
 
   using BlockGraph = oo::BlockGraph;
 
+  /// Prepare the resource. Levels of detail of the staged geometry are only
+  /// generated if `backgroundThread` is true, since generating them is too
+  /// slow to do on the render thread.
+  void prepare(bool backgroundThread = false) override;
+
+  /// Load the resource, first waiting for it to finish being prepared if it
+  /// is being prepared on another thread.
+  /// \remark `Ogre::Resource::load()` returns immediately if the resource is
+  ///         being prepared, leaving it unloaded, which is not what we want
+  ///         when the resource is being prepared in the background.
+  void load(bool backgroundThread = false) override;
+
   BlockGraph getBlockGraph() const;
 
+  /// Take the geometry staged when the resource was prepared.
+  /// Subsequent calls return an empty map until the resource is prepared
+  /// again, so the staged geometry is only ever used once.
+  oo::StagedGeometryMap takeStagedGeometry();
+
  protected:
+  void prepareImpl() override;
+  void unprepareImpl() override;
   void loadImpl() override;
   void unloadImpl() override;
 
  private:
   BlockGraph mBlockGraph{};
+
+  /// Geometry staged by `prepareImpl()` that has not yet been taken.
+  oo::StagedGeometryMap mStagedGeometry{};
+  /// Lock this before accessing `mStagedGeometry`.
+  std::mutex mStagedGeometryMutex{};
+
+  /// Stage the geometry of every `nif::NiTriBasedGeom` in `mBlockGraph`,
+  /// generating their levels of detail if `generateLods` is true.
+  void stageGeometry(bool generateLods);
+
+  /// Create the `Ogre::CollisionShape` of every `nif::bhk::CollisionObject` in
+  /// `mBlockGraph` that does not already exist.
+  void createCollisionShapes();
 };
 
 using NifResourcePtr = std::shared_ptr<NifResource>;
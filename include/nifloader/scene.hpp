@@ -3,6 +3,7 @@
 
 #include "mesh/entity.hpp"
 #include "mesh/subentity.hpp"
+#include "nifloader/loader.hpp"
 #include <gsl/gsl>
 #include <OgrePrerequisites.h>
 #include <btBulletDynamicsCommon.h>
@@ -21,6 +22,20 @@ Ogre::SceneNode *insertNif(const std::string &name, const std::string &group,
                            gsl::not_null<btDiscreteDynamicsWorld *> world,
                            gsl::not_null<Ogre::SceneNode *> nifRoot);
 
+/// Create the `oo::Mesh`es of the given prepared NIF file from the geometry
+/// staged when it was prepared, so that a later `oo::insertNif()` of the same
+/// file does not have to.
+/// This is the part of inserting a NIF file that must be done on the render
+/// thread but does not depend on the scene, so it can be scheduled separately.
+/// Does nothing if the NIF file has not been prepared, or if its meshes have
+/// already been created.
+/// \param g The block graph of the NIF file. This is taken as an argument so
+///          that the caller can copy it out of the `Ogre::NifResource` on a
+///          worker thread.
+/// \remark Must be called on the render thread.
+void uploadNif(const std::string &name, const std::string &group,
+               const oo::BlockGraph &g);
+
 void attachRagdoll(const std::string &name, const std::string &group,
                    gsl::not_null<Ogre::SceneManager *> scnMgr,
                    gsl::not_null<btDiscreteDynamicsWorld *> world,
@@ -12,6 +12,9 @@ class SkeletonLoader : public Ogre::ManualResourceLoader {
   friend class SkeletonLoaderState;
 
  public:
+  /// Prepare the NIF file backing the skeleton, parsing it on the calling
+  /// thread.
+  void prepareResource(Ogre::Resource *resource) override;
   void loadResource(Ogre::Resource *resource) override;
 };
 
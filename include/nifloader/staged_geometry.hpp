@@ -0,0 +1,60 @@
+#ifndef OPENOBL_NIFLOADER_STAGED_GEOMETRY_HPP
+#define OPENOBL_NIFLOADER_STAGED_GEOMETRY_HPP
+
+#include "nifloader/loader.hpp"
+#include <OgreAxisAlignedBox.h>
+#include <OgreRenderOperation.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace oo {
+
+/// \addtogroup OpenOBLNifloader
+/// @{
+
+/// Vertex data of an `oo::SubMesh` that has been built in main memory but not
+/// yet copied into a hardware buffer.
+struct StagedVertexData {
+  /// Interleaved vertex elements, in the order given by the vertex declaration
+  /// built by `oo::uploadVertexData()`.
+  std::vector<float> buffer{};
+  std::size_t vertexCount{};
+  /// Whether each vertex has blend indices and blend weights.
+  bool hasBones{false};
+};
+
+/// Index data of an `oo::SubMesh` that has been built in main memory but not
+/// yet copied into a hardware buffer.
+struct StagedIndexData {
+  std::vector<uint16_t> buffer{};
+  Ogre::RenderOperation::OperationType operationType{
+      Ogre::RenderOperation::OperationType::OT_TRIANGLE_LIST};
+};
+
+/// Everything needed to create an `oo::SubMesh` from a `nif::NiTriBasedGeom`
+/// that does not need to be done on the render thread.
+/// Materials and textures are not included, since creating them can require
+/// GPU resources.
+struct StagedGeometry {
+  StagedVertexData vertexData{};
+  StagedIndexData indexData{};
+  /// Simplified index data of each level of detail after the first, which are
+  /// always triangle lists. See `oo::DEFAULT_LOD_LEVELS`.
+  std::vector<StagedIndexData> lodIndexData{};
+  /// Names of the bones referenced by the blend indices, if any.
+  std::vector<std::string> boneNames{};
+  Ogre::AxisAlignedBox bounds{};
+};
+
+/// Staged geometry of the `nif::NiTriBasedGeom` blocks in a NIF file, indexed
+/// by their vertex in the block graph.
+using StagedGeometryMap = std::map<oo::BlockGraph::vertex_descriptor,
+                                   oo::StagedGeometry>;
+
+/// @}
+
+} // namespace oo
+
+#endif // OPENOBL_NIFLOADER_STAGED_GEOMETRY_HPP
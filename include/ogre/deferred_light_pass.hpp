@@ -1,6 +1,7 @@
 #ifndef OPENOBL_OGRE_DEFERRED_LIGHT_PASS_HPP
 #define OPENOBL_OGRE_DEFERRED_LIGHT_PASS_HPP
 
+#include "ogre/light_clusters.hpp"
 #include <gsl/gsl>
 #include <OgreCompositorInstance.h>
 #include <OgreCustomCompositionPass.h>
@@ -107,6 +108,31 @@ class AmbientLight : public Ogre::SimpleRenderable {
   Ogre::Real mRadius{};
 };
 
+/// Full-screen quad that lights every pixel with the point lights in its
+/// cluster of an `oo::LightClusterGrid`, replacing the separate light volume
+/// drawn for each point light.
+class ClusteredLights : public Ogre::SimpleRenderable {
+ public:
+  /// Create the cluster grid and a copy of the `DeferredClusteredLights`
+  /// material using it, whose names are prefixed by `name`.
+  explicit ClusteredLights(const std::string &name);
+  ~ClusteredLights() override;
+
+  Ogre::Real getBoundingRadius() const override;
+  Ogre::Real getSquaredViewDepth(const Ogre::Camera *camera) const override;
+  void getWorldTransforms(Ogre::Matrix4 *xform) const override;
+
+  /// Rebuild the cluster grid for the point lights in `lights` as seen by
+  /// `camera`, and upload it for rendering.
+  void update(const Ogre::Camera &camera, const Ogre::LightList &lights);
+
+  const oo::LightClusterGrid &getGrid() const noexcept;
+
+ private:
+  std::unique_ptr<oo::LightClusterGrid> mGrid{};
+  Ogre::Real mRadius{};
+};
+
 class DeferredLightRenderOperation : public RenderOperation {
  public:
   DeferredLightRenderOperation(Ogre::CompositorInstance *instance,
@@ -120,8 +146,17 @@ class DeferredLightRenderOperation : public RenderOperation {
   std::array<std::string, 3u> mTexNames{};
   Ogre::Viewport *mViewport;
   std::unique_ptr<AmbientLight> mAmbientLight{};
+  /// Only created once clustered lighting is first used.
+  std::unique_ptr<ClusteredLights> mClusteredLights{};
 
   void executeAmbientLight(Ogre::SceneManager *scnMgr);
+  /// Draw the point lights in `lights` with the clustered pass.
+  /// \returns The number of lights at the start of `lights` that were handled
+  ///          by the clustered pass. Any point lights after these did not fit
+  ///          in the cluster grid.
+  std::size_t executeClusteredLights(Ogre::SceneManager *scnMgr,
+                                     const Ogre::Camera &camera,
+                                     const Ogre::LightList &lights);
 };
 
 class DeferredLightPass : public Ogre::CustomCompositionPass {
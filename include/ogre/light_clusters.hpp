@@ -0,0 +1,142 @@
+#ifndef OPENOBL_OGRE_LIGHT_CLUSTERS_HPP
+#define OPENOBL_OGRE_LIGHT_CLUSTERS_HPP
+
+#include <OgreCommon.h>
+#include <OgreMatrix4.h>
+#include <OgrePrerequisites.h>
+#include <OgreTexture.h>
+#include <OgreVector.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace oo {
+
+/// Division of the view frustum into a grid of clusters, each storing the list
+/// of point lights whose volume of influence intersects it.
+///
+/// The frustum is divided into `NUM_TILES_X` by `NUM_TILES_Y` tiles in screen
+/// space, and each tile is divided into `NUM_SLICES` clusters along the view
+/// direction. The slices are spaced exponentially so that the clusters are
+/// roughly cubical, and the last slice extends to infinity.
+///
+/// The grid is built on the CPU once per frame and uploaded to three textures,
+/// which a single full-screen pass then uses to light each pixel with only the
+/// lights in its cluster:
+/// - The light texture is `MAX_LIGHTS` texels wide and 3 texels high. Column
+///   `i` stores the world position and attenuation range of light `i` in the
+///   first row, its diffuse colour in the second, and its constant, linear,
+///   and quadratic attenuation coefficients in the third.
+/// - The cluster texture is `NUM_TILES_X * NUM_TILES_Y` texels wide and
+///   `NUM_SLICES` texels high. The texel of the cluster at tile `(x, y)` in
+///   slice `z` is at `(x + y * NUM_TILES_X, z)` and stores the offset of the
+///   cluster's first light index and the number of lights in the cluster.
+/// - The index texture is `INDEX_TEXTURE_WIDTH` texels wide and stores the
+///   light indices of every cluster in row-major order.
+///
+/// All integers are stored as floats, which is exact for every value that can
+/// occur.
+class LightClusterGrid {
+ public:
+  constexpr static std::size_t NUM_TILES_X{16u};
+  constexpr static std::size_t NUM_TILES_Y{9u};
+  constexpr static std::size_t NUM_SLICES{24u};
+  constexpr static std::size_t NUM_CLUSTERS{
+      NUM_TILES_X * NUM_TILES_Y * NUM_SLICES};
+
+  /// Maximum number of lights in the grid. Any further lights are left out of
+  /// the grid, see `getNumProcessedLights()`.
+  constexpr static std::size_t MAX_LIGHTS{1024u};
+
+  constexpr static std::size_t INDEX_TEXTURE_WIDTH{1024u};
+  /// Maximum total number of light indices across all clusters. If the grid
+  /// would contain more then the clusters at the end of the grid, namely the
+  /// distant ones, are truncated.
+  constexpr static std::size_t MAX_LIGHT_INDICES{INDEX_TEXTURE_WIDTH * 256u};
+
+  /// View depth at which the last slice ends, if the camera's far clip
+  /// distance is infinite or further than this. The last slice is extended to
+  /// contain every depth beyond it.
+  constexpr static float MAX_SLICE_DEPTH{500.0f};
+
+  /// Create the textures of the grid, whose names are prefixed by `name`.
+  /// \remark Must be called on the render thread.
+  explicit LightClusterGrid(const std::string &name);
+  ~LightClusterGrid();
+  LightClusterGrid(const LightClusterGrid &) = delete;
+  LightClusterGrid &operator=(const LightClusterGrid &) = delete;
+  LightClusterGrid(LightClusterGrid &&) = delete;
+  LightClusterGrid &operator=(LightClusterGrid &&) = delete;
+
+  /// Assign every point light in `lights` to the clusters of the view frustum
+  /// of `camera` that it intersects. Lights of any other type are ignored.
+  /// \pre `camera` uses a perspective projection.
+  void build(const Ogre::Camera &camera, const Ogre::LightList &lights);
+
+  /// Copy the result of the last call to `build()` into the textures.
+  /// \remark Must be called on the render thread.
+  void upload();
+
+  /// Bind the textures of the grid to the texture units `firstUnit`,
+  /// `firstUnit + 1`, and `firstUnit + 2` of `pass`, which must already exist,
+  /// in the order light, cluster, index.
+  void bindTextures(Ogre::Pass *pass, unsigned short firstUnit) const;
+
+  /// Set the fragment program parameters of `pass` needed to find the cluster
+  /// of a pixel. These change whenever the camera moves, so should be set
+  /// after every call to `build()`.
+  void setParameters(Ogre::Pass *pass) const;
+
+  /// Return the number of lights in the grid.
+  std::size_t getNumLights() const noexcept;
+
+  /// Return the number of lights at the start of the list passed to the last
+  /// call to `build()` that were considered for the grid. Once the grid is
+  /// full the remaining lights are not considered, so any point lights after
+  /// these must be drawn some other way.
+  std::size_t getNumProcessedLights() const noexcept;
+
+  /// Return the total number of light indices in all the clusters.
+  std::size_t getNumLightIndices() const noexcept;
+
+ private:
+  /// The range of clusters intersected by a light, inclusive at both ends.
+  struct ClusterRange {
+    std::size_t x0, x1;
+    std::size_t y0, y1;
+    std::size_t z0, z1;
+  };
+
+  std::vector<float> mLightData{};
+  std::vector<float> mClusterData{};
+  std::vector<float> mLightIndices{};
+
+  /// Cluster range of each light in the grid, reused between frames.
+  std::vector<ClusterRange> mLightRanges{};
+  /// Number of lights in each cluster, reused between frames.
+  std::vector<uint32_t> mClusterCounts{};
+
+  std::size_t mNumLightIndices{0u};
+  /// \see getNumProcessedLights()
+  std::size_t mNumProcessedLights{0u};
+
+  Ogre::Matrix4 mViewMatrix{Ogre::Matrix4::IDENTITY};
+  /// The entries of the projection matrix needed to project a view space
+  /// position into normalized device coordinates, in the order `[0][0]`,
+  /// `[1][1]`, `[0][2]`, `[1][2]`.
+  Ogre::Vector4 mProjParams{};
+  /// Scale and bias converting the logarithm of a view depth into a slice.
+  float mSliceScale{};
+  float mSliceBias{};
+
+  Ogre::TexturePtr mLightTexture{};
+  Ogre::TexturePtr mClusterTexture{};
+  Ogre::TexturePtr mIndexTexture{};
+
+  /// Return the slice containing the given view depth.
+  std::size_t getSlice(float depth) const noexcept;
+};
+
+} // namespace oo
+
+#endif // OPENOBL_OGRE_LIGHT_CLUSTERS_HPP
@@ -0,0 +1,174 @@
+#ifndef OPENOBL_OGRE_OCCLUSION_CULLER_HPP
+#define OPENOBL_OGRE_OCCLUSION_CULLER_HPP
+
+#include <OgreAxisAlignedBox.h>
+#include <OgreMatrix4.h>
+#include <OgrePrerequisites.h>
+#include <OgreSingleton.h>
+#include <OgreVector.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+/// Culls objects hidden behind other objects by testing their bounding boxes
+/// against a software-rasterized hierarchical depth buffer.
+///
+/// Each frame, objects that make good *occluders*, namely large opaque ones,
+/// submit their full detail geometry with `addOccluder()` once per frame when
+/// they pass the frustum test of the main camera. At the start of the next frame's visibility
+/// pass, `update()` keeps the occluders covering the most of the screen and
+/// rasterizes them into a low resolution depth buffer from the point of view
+/// of the camera, storing the view depth of the nearest occluder at each pixel.
+/// The rasterization is split into horizontal bands shared between the render
+/// thread and the worker threads. A mip chain is then built in which each
+/// texel stores the *furthest* depth of the four texels below it, so that a
+/// single texel bounds the depth of every occluder in a block of the screen.
+///
+/// An object is occluded if the nearest point of its bounding box is further
+/// away than the furthest occluder in every texel that the bounding box covers
+/// on screen. The test picks the mip level at which the screen-space rectangle
+/// of the box covers at most a few texels, so it is cheap regardless of the
+/// size of the object.
+///
+/// Occluders lag the camera by a frame: they are rasterized at the start of the
+/// frame after they were added, using the camera of the new frame but the
+/// transformations they had when added. Objects that have just come into view
+/// therefore do not occlude anything until the next frame, which only means
+/// that less is culled, but an occluder that moved since the last frame is
+/// drawn where it was and may hide objects for one frame. Pixels are covered by an occluder if their centre is, so
+/// objects seen through gaps in occluders narrower than a pixel of the depth
+/// buffer may be culled.
+///
+/// \remark All member functions must be called on the render thread.
+class OcclusionCuller : public Ogre::Singleton<oo::OcclusionCuller> {
+ public:
+  /// Triangles of an occluder, three vertices for each triangle, in the
+  /// coordinate system of the occluder.
+  using TriangleList = std::vector<Ogre::Vector3>;
+
+  struct Stats {
+    /// Number of occluders rasterized in the last call to `update()`.
+    std::size_t numOccluders{};
+    /// Number of triangles rasterized in the last call to `update()`, after
+    /// clipping.
+    std::size_t numTriangles{};
+    /// Number of bounding boxes tested since the last call to `update()`.
+    std::size_t numTested{};
+    /// Number of bounding boxes found to be occluded since the last call to
+    /// `update()`.
+    std::size_t numOccluded{};
+    /// Time taken by the last call to `update()`, in milliseconds.
+    float updateTime{};
+  };
+
+  /// \param width The width of the depth buffer, in pixels.
+  /// \param height The height of the depth buffer, in pixels.
+  /// \param maxOccluders The maximum number of occluders rasterized each frame.
+  OcclusionCuller(uint32_t width, uint32_t height, std::size_t maxOccluders);
+  ~OcclusionCuller() = default;
+  OcclusionCuller(const OcclusionCuller &) = delete;
+  OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+  OcclusionCuller(OcclusionCuller &&) = delete;
+  OcclusionCuller &operator=(OcclusionCuller &&) = delete;
+
+  static OcclusionCuller &getSingleton();
+  static OcclusionCuller *getSingletonPtr();
+
+  /// Rasterize the occluders added since the last call into the depth buffer
+  /// of `camera`, which is then used by `isOccluded()`.
+  ///
+  /// Only the first call for each frame does anything, so this can be called
+  /// before every visibility pass of the camera. Calling it with a different
+  /// camera throws away the occluders, which were seen by the old camera.
+  void update(const Ogre::Camera &camera);
+
+  /// Add an occluder to be rasterized by the next call to `update()`, if
+  /// `camera` is the camera of the last call to `update()`.
+  ///
+  /// Occluders are not deduplicated, so each object should add its occluder
+  /// at most once per frame even if it is notified of `camera` more than once.
+  /// \param triangles The triangles of the occluder. These are kept alive
+  ///                  until they have been rasterized.
+  /// \param xform The transformation from the coordinate system of the
+  ///              triangles to world space.
+  /// \param screenSize The fraction of the height of the viewport covered by
+  ///                   the occluder, used to choose the best occluders.
+  /// \returns Whether the occluder was added.
+  bool addOccluder(const Ogre::Camera &camera,
+                   std::shared_ptr<const TriangleList> triangles,
+                   const Ogre::Affine3 &xform, float screenSize);
+
+  /// Return whether every point of the world space `box` is hidden from
+  /// `camera` by an occluder. Always returns false if `camera` is not the
+  /// camera of the last call to `update()`.
+  bool isOccluded(const Ogre::Camera &camera,
+                  const Ogre::AxisAlignedBox &box);
+
+  Stats getStats() const noexcept;
+
+ private:
+  struct Occluder {
+    std::shared_ptr<const TriangleList> triangles{};
+    Ogre::Affine3 xform{};
+    float screenSize{};
+  };
+
+  /// Triangle in screen space, clipped to the near plane. Each vertex has its
+  /// position in pixels and the reciprocal of its view depth, which unlike
+  /// the depth itself varies linearly across the screen.
+  struct ScreenTriangle {
+    std::array<Ogre::Vector3, 3> v{};
+    int yMin{};
+    int yMax{};
+  };
+
+  /// Number of rows of the depth buffer rasterized at a time by one thread.
+  constexpr static uint32_t ROWS_PER_BAND{16u};
+  /// Number of occluders transformed at a time by one thread.
+  constexpr static std::size_t OCCLUDERS_PER_CHUNK{4u};
+
+  uint32_t mWidth;
+  uint32_t mHeight;
+  std::size_t mMaxOccluders;
+
+  /// Camera of the last call to `update()`.
+  const Ogre::Camera *mCamera{};
+  /// Frame number of the last call to `update()`.
+  unsigned long mFrameNumber{};
+  Ogre::Matrix4 mViewProj{Ogre::Matrix4::IDENTITY};
+  float mNearDist{};
+
+  /// Occluders added since the last call to `update()`.
+  std::vector<Occluder> mOccluders{};
+  /// The depth buffer and its mip chain, starting with the full resolution
+  /// level. Each level is stored row-major, and an empty texel is infinitely
+  /// far away.
+  std::vector<std::vector<float>> mLevels{};
+  /// The width and height of each level of `mLevels`.
+  std::vector<std::pair<uint32_t, uint32_t>> mLevelSizes{};
+  /// Whether anything was rasterized by the last call to `update()`.
+  bool mIsEmpty{true};
+
+  Stats mStats{};
+
+  /// Transform the triangles of `occluder` into screen space, clipping them
+  /// against the near plane, and append them to `out`.
+  void transformOccluder(const Occluder &occluder,
+                         std::vector<ScreenTriangle> &out) const;
+
+  /// Rasterize the part of every triangle in `triangles` that lies in the rows
+  /// `[y0, y1)` into the full resolution level.
+  void rasterizeBand(const std::vector<std::vector<ScreenTriangle>> &triangles,
+                     int y0, int y1);
+
+  /// Build every level after the first from the one above it.
+  void buildMipChain();
+};
+
+} // namespace oo
+
+#endif // OPENOBL_OGRE_OCCLUSION_CULLER_HPP
@@ -26,9 +26,26 @@ class DeferredSceneManager : public Ogre::SceneManager {
 
   void findLightsAffectingFrustum(const Ogre::Camera *camera) override;
 
+  /// Rebuild the depth buffer of the `oo::OcclusionCuller`, if there is one,
+  /// before finding the objects visible to a camera that is not rendering
+  /// shadows. The shadow cameras of `oo::SunShadows` instead see the casters
+  /// that were culled for them.
+  void _findVisibleObjects(Ogre::Camera *cam,
+                           Ogre::VisibleObjectsBoundsInfo *visibleBounds,
+                           bool onlyShadowCasters) override;
+
   DeferredFogListener *getFogListener() noexcept;
 
+  /// Set whether point lights should be culled into an `oo::LightClusterGrid`
+  /// and drawn together in a single full-screen pass, instead of drawing a
+  /// separate light volume for each point light. Enabled by default.
+  void setClusteredLightingEnabled(bool enabled) noexcept;
+  bool getClusteredLightingEnabled() const noexcept;
+
   DeferredFogListener mFogListener;
+
+ private:
+  bool mClusteredLightingEnabled{true};
 };
 
 class DeferredSceneManagerFactory : public Ogre::SceneManagerFactory {
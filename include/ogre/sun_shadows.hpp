@@ -0,0 +1,260 @@
+#ifndef OPENOBL_OGRE_SUN_SHADOWS_HPP
+#define OPENOBL_OGRE_SUN_SHADOWS_HPP
+
+#include <OgreAxisAlignedBox.h>
+#include <OgreCamera.h>
+#include <OgreMaterial.h>
+#include <OgreMatrix4.h>
+#include <OgrePrerequisites.h>
+#include <OgreRenderQueue.h>
+#include <OgreRenderTargetListener.h>
+#include <OgreSceneManager.h>
+#include <OgreSingleton.h>
+#include <OgreTexture.h>
+#include <OgreVector.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace oo {
+
+/// Cascaded shadow maps for the sun.
+///
+/// The part of the main camera's view frustum closer than the shadow distance
+/// is split into *cascades* of increasing size, each of which is given a shadow
+/// map of the same resolution, so that the shadow texel density falls off with
+/// distance like the screen pixel density does. The splits blend between a
+/// logarithmic and a uniform distribution according to the split lambda. Each
+/// cascade is bounded by a sphere, which unlike a tight box does not change
+/// size as the camera turns, and its shadow camera is moved in whole texels so
+/// that shadow edges do not shimmer as the camera moves.
+///
+/// The shadow maps are stored side by side in a single texture, finest cascade
+/// first, and are drawn before the main viewport each frame. Instead of letting
+/// each shadow camera walk the scene graph, the objects that can cast shadows
+/// are gathered once and tested against every cascade in parallel on the
+/// worker threads. Only objects of the types given to `addCasterType()` cast
+/// shadows, and of those only the opaque, unskinned geometry without alpha
+/// testing that is drawn by the generic static and instanced materials, which
+/// is drawn into the shadow maps with a depth-only material.
+///
+/// Redrawing every cascade every frame would roughly double the number of draw
+/// calls. In *budget mode*, only the finest cascade, which contains most of the
+/// moving objects near the camera, is redrawn every frame. The outer cascades
+/// cover a slightly larger sphere than needed and keep their shadow maps until
+/// the camera leaves that sphere, the sun moves far enough, or their list of
+/// casters changes, for instance because a cell was loaded or an object moved.
+/// Even then, at most a fixed number of outer cascades are redrawn each frame,
+/// longest waiting first. The lighting shader uses the finest cascade covering
+/// each pixel, so a cascade that has not caught up with the camera is covered
+/// by its neighbours until it is redrawn.
+///
+/// The sun is taken to be the first visible directional light in the scene of
+/// the camera passed to `setCamera()`, and shadows are disabled while it shines
+/// from below the horizon.
+///
+/// \remark All member functions must be called on the render thread.
+class SunShadows : public Ogre::Singleton<oo::SunShadows>,
+                   public Ogre::RenderTargetListener,
+                   public Ogre::RenderQueue::RenderableListener,
+                   public Ogre::SceneManager::Listener,
+                   public Ogre::Camera::Listener {
+ public:
+  /// Maximum number of cascades, which must match `MAX_CASCADES` in
+  /// `deferred_light_fs.glsl`.
+  constexpr static uint32_t MAX_CASCADES{4u};
+
+  struct Stats {
+    /// Number of cascades in use.
+    std::size_t numCascades{};
+    /// Number of cascades redrawn in the last frame.
+    std::size_t numRedrawn{};
+    /// Number of objects that could cast shadows in the last frame.
+    std::size_t numCandidates{};
+    /// Number of casters drawn into each cascade in the last frame.
+    std::array<std::size_t, MAX_CASCADES> numCasters{};
+    /// Time taken to fit the cascades and cull their casters in the last frame,
+    /// in milliseconds.
+    float cullTime{};
+  };
+
+  /// \param numCascades The number of cascades, clamped to
+  ///                    `[1, MAX_CASCADES]`.
+  /// \param mapSize The width and height of the shadow map of each cascade, in
+  ///                pixels.
+  /// \param distance The view depth beyond which nothing is shadowed.
+  /// \param splitLambda The blend between a uniform (0) and logarithmic (1)
+  ///                    distribution of cascade splits.
+  /// \param budgetMode Whether to cache the shadow maps of the outer cascades
+  ///                   instead of redrawing every cascade every frame.
+  /// \param maxCascadeUpdates In budget mode, the maximum number of outer
+  ///                          cascades redrawn each frame.
+  SunShadows(uint32_t numCascades, uint32_t mapSize, float distance,
+             float splitLambda, bool budgetMode, uint32_t maxCascadeUpdates);
+  ~SunShadows() override;
+  SunShadows(const SunShadows &) = delete;
+  SunShadows &operator=(const SunShadows &) = delete;
+  SunShadows(SunShadows &&) = delete;
+  SunShadows &operator=(SunShadows &&) = delete;
+
+  static SunShadows &getSingleton();
+  static SunShadows *getSingletonPtr();
+
+  /// Draw shadows for the scene seen by `camera`, or stop drawing shadows if
+  /// `camera` is null. Shadows are only drawn for `oo::DeferredSceneManager`s.
+  void setCamera(Ogre::Camera *camera);
+
+  /// Let objects of the given movable type cast shadows.
+  void addCasterType(std::string type);
+
+  /// Return the light that is being shadowed this frame, or null if there are
+  /// no shadows this frame.
+  const Ogre::Light *getShadowedLight() const noexcept;
+
+  /// Return the material lighting the G-buffer with the shadowed light, with
+  /// the shadow maps and cascade parameters bound. Only meaningful if
+  /// `getShadowedLight()` is not null.
+  const Ogre::MaterialPtr &getLightMaterial() const noexcept;
+
+  /// If `camera` is the shadow camera of a cascade, add that cascade's casters
+  /// to `queue` and return true, otherwise do nothing and return false.
+  bool queueCasters(Ogre::Camera &camera, Ogre::RenderQueue &queue);
+
+  Stats getStats() const noexcept;
+
+  /// \name RenderTargetListener overrides
+  /// @{
+  void preRenderTargetUpdate(const Ogre::RenderTargetEvent &evt) override;
+  void preViewportUpdate(const Ogre::RenderTargetViewportEvent &evt) override;
+  void postViewportUpdate(const Ogre::RenderTargetViewportEvent &evt) override;
+  /// @}
+
+  /// Replace the technique of every caster with a depth-only one, rejecting
+  /// those that cannot be drawn with one.
+  bool renderableQueued(Ogre::Renderable *rend, uint8_t groupId,
+                        unsigned short priority, Ogre::Technique **technique,
+                        Ogre::RenderQueue *queue) override;
+
+  void sceneManagerDestroyed(Ogre::SceneManager *scnMgr) override;
+  void cameraDestroyed(Ogre::Camera *camera) override;
+
+ private:
+  struct Caster {
+    Ogre::MovableObject *object{};
+    Ogre::AxisAlignedBox bounds{};
+  };
+
+  struct Cascade {
+    Ogre::SceneNode *node{};
+    Ogre::Camera *camera{};
+    Ogre::Viewport *viewport{};
+
+    /// Centre and radius of the sphere covered by the shadow map, and the
+    /// direction of the sun, when it was last drawn.
+    Ogre::Vector3 centre{};
+    float radius{};
+    Ogre::Vector3 sunDir{};
+    /// Hash of the casters drawn into the shadow map.
+    std::size_t casterHash{};
+    /// Transformation from world space to the clip space of the shadow
+    /// camera, as the shadow map was drawn with it.
+    Ogre::Matrix4 viewProj{Ogre::Matrix4::IDENTITY};
+    /// Frame number when the shadow map was last drawn.
+    unsigned long lastDrawn{};
+    /// Whether the shadow map has been drawn since the camera was set.
+    bool isValid{false};
+
+    /// Casters in the sphere being drawn this frame.
+    std::vector<Ogre::MovableObject *> casters{};
+  };
+
+  /// The fit of a cascade for the current frame.
+  struct Fit {
+    Ogre::Vector3 centre{};
+    float radius{};
+    /// Whether the cascade's old fit no longer covers its part of the frustum.
+    bool isRefit{};
+    std::vector<Ogre::MovableObject *> casters{};
+    std::size_t casterHash{};
+  };
+
+  constexpr static const char *ATLAS_NAME{"__SunShadowAtlas"};
+  constexpr static const char *LIGHT_MATERIAL{
+      "DeferredShadowedDirectionalLight"
+  };
+  constexpr static const char *CASTER_MATERIAL{"__SunShadowCaster"};
+  constexpr static const char *INSTANCED_CASTER_MATERIAL{
+      "__SunShadowCasterInstanced"
+  };
+
+  /// Distance behind each cascade, towards the sun, in which objects can cast
+  /// shadows into the cascade.
+  constexpr static float CASTER_DISTANCE{200.0f};
+  /// Fraction by which the spheres of the outer cascades are enlarged in budget
+  /// mode, so that the camera can move a little without redrawing them.
+  constexpr static float CASCADE_MARGIN{0.25f};
+  /// Angle in radians that the sun must move through before the outer cascades
+  /// are redrawn in budget mode.
+  constexpr static float SUN_UPDATE_ANGLE{0.005f};
+
+  uint32_t mNumCascades;
+  uint32_t mMapSize;
+  float mDistance;
+  float mSplitLambda;
+  bool mBudgetMode;
+  uint32_t mMaxCascadeUpdates;
+
+  std::vector<std::string> mCasterTypes{};
+
+  Ogre::Camera *mCamera{};
+  Ogre::SceneManager *mScnMgr{};
+  Ogre::TexturePtr mAtlas{};
+  Ogre::MaterialPtr mLightMaterial{};
+  Ogre::Technique *mCasterTechnique{};
+  Ogre::Technique *mInstancedCasterTechnique{};
+  std::array<Cascade, MAX_CASCADES> mCascades{};
+  /// Light shadowed this frame.
+  Ogre::Light *mLight{};
+
+  Stats mStats{};
+
+  /// Create the shadow map texture and the materials, if not already created.
+  void createResources();
+  /// Create the shadow cameras and viewports in `mScnMgr`.
+  void createCascades();
+  /// Destroy the shadow cameras and viewports, if any.
+  void destroyCascades();
+
+  /// Return the first visible directional light in `mScnMgr`.
+  Ogre::Light *findSunLight() const;
+
+  /// Return the view depths splitting the frustum of `mCamera` into cascades,
+  /// starting with the near plane and ending with the shadow distance.
+  std::array<float, MAX_CASCADES + 1u> getSplits() const;
+
+  /// Return the bounding sphere of the part of the frustum of `mCamera` between
+  /// the view depths `nearDepth` and `farDepth`.
+  std::pair<Ogre::Vector3, float>
+  getSliceSphere(float nearDepth, float farDepth) const;
+
+  /// Gather every object that could cast a shadow into any cascade.
+  std::vector<Caster> gatherCasters() const;
+
+  /// Move the camera of the cascade with the given index to draw the sphere
+  /// in `fit`, and remember the fit as the one it is drawn with.
+  void placeCascade(uint32_t index, Fit &fit, const Ogre::Quaternion &sunRot,
+                    const Ogre::Vector3 &sunDir);
+
+  /// Set the cascade parameters of the light material.
+  void setLightParameters();
+
+  /// Fit the cascades to the camera, cull their casters, and decide which
+  /// cascades to redraw.
+  void update();
+};
+
+} // namespace oo
+
+#endif // OPENOBL_OGRE_SUN_SHADOWS_HPP
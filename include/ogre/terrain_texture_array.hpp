@@ -0,0 +1,178 @@
+#ifndef OPENOBL_OGRE_TERRAIN_TEXTURE_ARRAY_HPP
+#define OPENOBL_OGRE_TERRAIN_TEXTURE_ARRAY_HPP
+
+#include <OgreImage.h>
+#include <OgreMaterial.h>
+#include <OgrePixelFormat.h>
+#include <OgreSingleton.h>
+#include <OgreTexture.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace oo {
+
+/// Shared textures for drawing every terrain quad with a single material.
+///
+/// The default terrain material is cloned for every quad and binds the diffuse
+/// and normal textures of each of the quad's layers to their own texture unit,
+/// along with the quad's blend maps, global normal map, and vertex colour map.
+/// This means that every quad needs its own material and a state change to
+/// draw, and that the number of layers per quad is limited by the number of
+/// texture units.
+///
+/// Instead, this class stores the diffuse and normal textures of every terrain
+/// layer in use in a pair of texture arrays, with each *layer* of the array
+/// holding one pair of textures resized to a common size. Each vertex of a quad
+/// then records the array layers of the (up to) four layers that contribute
+/// most to it, along with their weights, which the shader uses to blend the
+/// layers. These per-vertex maps, and the global normal and vertex colour maps,
+/// are stored in a set of *atlas* textures shared by every quad. Each quad
+/// owns a `VERTICES_PER_QUAD` square block of the atlases chosen by wrapping
+/// its terrain slot around the atlas, so the shader can find a quad's block
+/// from the world position alone and the quads need no parameters of their
+/// own. The atlases must therefore be at least as many quads wide as the
+/// loaded terrain, near and far, plus one; see `getAtlasQuads()`.
+///
+/// Array layers are reference counted; a layer no longer used by any quad stays
+/// resident until its place in the array is needed by another layer.
+///
+/// \remark `acquireLayer()` and `releaseLayer()` can be called from any thread,
+///         and all other functions must be called on the render thread.
+class TerrainTextureArray : public Ogre::Singleton<oo::TerrainTextureArray> {
+ public:
+  constexpr static uint32_t VERTICES_PER_QUAD{17u};
+
+  /// Index of a layer in the texture arrays.
+  using LayerIndex = uint8_t;
+
+  /// \param layerSize The width and height of each layer of the texture
+  ///                  arrays, in pixels. Layer textures are resized to fit.
+  /// \param maxLayers The number of layers in the texture arrays. At most 256.
+  /// \param atlasQuads The width and height of the atlases, in quads.
+  TerrainTextureArray(uint32_t layerSize, uint32_t maxLayers,
+                      uint32_t atlasQuads);
+  ~TerrainTextureArray();
+  TerrainTextureArray(const TerrainTextureArray &) = delete;
+  TerrainTextureArray &operator=(const TerrainTextureArray &) = delete;
+  TerrainTextureArray(TerrainTextureArray &&) = delete;
+  TerrainTextureArray &operator=(TerrainTextureArray &&) = delete;
+
+  static TerrainTextureArray &getSingleton();
+  static TerrainTextureArray *getSingletonPtr();
+
+  /// Return the width and height of the atlases, in quads, needed so that no
+  /// two loaded quads share a block.
+  ///
+  /// Near and far terrain both write their quads into the atlases, so they
+  /// must be wide enough for the larger of the two neighbourhoods. While the
+  /// player crosses a cell border the loaded terrain can briefly be an extra
+  /// cell wider on each side.
+  /// \param nearDiameter The diameter of the near neighbourhood, in cells.
+  /// \param farDiameter The diameter of the far neighbourhood, in cells.
+  static uint32_t getAtlasQuads(uint32_t nearDiameter,
+                                uint32_t farDiameter) noexcept;
+
+  /// Return the index of the block, along one axis, of an atlas `atlasQuads`
+  /// quads wide that is owned by the quad in the given terrain slot.
+  static uint32_t getAtlasBlock(long slot, uint32_t atlasQuads) noexcept;
+
+  /// Return the array layer holding the given diffuse and normal textures,
+  /// reading them into an unused layer if they are not already resident, and
+  /// increase its reference count.
+  ///
+  /// Newly read textures are not uploaded until the next call to
+  /// `uploadPendingLayers()`. If every layer is in use then the layer of the
+  /// least recently acquired textures is returned instead.
+  ///
+  /// The textures are read without holding the lock, so a concurrent call
+  /// acquiring the same textures may return their layer before they have been
+  /// read.
+  LayerIndex acquireLayer(const std::string &diffuseName,
+                          const std::string &normalName);
+
+  /// Decrease the reference count of a layer returned by `acquireLayer()`.
+  void releaseLayer(LayerIndex layer);
+
+  /// Copy layers read by `acquireLayer()` into the texture arrays.
+  void uploadPendingLayers();
+
+  /// Write the maps of the quad in the given terrain slot into its block of the
+  /// atlases. Each map is `VERTICES_PER_QUAD` pixels square.
+  /// \param layers The array layers of the four most significant layers at each
+  ///               vertex, in `Ogre::PF_BYTE_RGBA`.
+  /// \param weights The weights of the layers in `layers`, in
+  ///                `Ogre::PF_BYTE_RGBA`.
+  /// \param normals The vertex normals.
+  /// \param vertexColors The vertex colours.
+  void writeQuad(long slotX, long slotY,
+                 const Ogre::PixelBox &layers,
+                 const Ogre::PixelBox &weights,
+                 const Ogre::PixelBox &normals,
+                 const Ogre::PixelBox &vertexColors);
+
+  /// Return the material used to draw every terrain quad, creating it and the
+  /// textures that it uses if necessary.
+  Ogre::MaterialPtr getMaterial(Ogre::Real quadWorldSize);
+
+ private:
+  struct Layer {
+    std::string diffuseName{};
+    std::string normalName{};
+    uint32_t refCount{0u};
+    /// Value of `mAcquireCount` when the layer was last acquired.
+    uint64_t lastAcquired{0u};
+    bool isUsed{false};
+    /// Whether the layer's textures are being read by `acquireLayer()`.
+    bool isPending{false};
+  };
+
+  /// Textures read by `acquireLayer()` and waiting to be uploaded.
+  struct PendingLayer {
+    LayerIndex index{};
+    Ogre::Image diffuse{};
+    Ogre::Image normal{};
+  };
+
+  uint32_t mLayerSize;
+  uint32_t mMaxLayers;
+  uint32_t mAtlasQuads;
+
+  mutable std::mutex mMutex{};
+  std::vector<Layer> mLayers{};
+  std::unordered_map<std::string, LayerIndex> mLayerIndices{};
+  std::vector<PendingLayer> mPendingLayers{};
+  uint64_t mAcquireCount{0u};
+
+  Ogre::TexturePtr mDiffuseArray{};
+  Ogre::TexturePtr mNormalArray{};
+  Ogre::TexturePtr mLayerAtlas{};
+  Ogre::TexturePtr mWeightAtlas{};
+  Ogre::TexturePtr mNormalAtlas{};
+  Ogre::TexturePtr mVertexColorAtlas{};
+
+  void createTextures();
+
+  /// Return a new texture with the given format and dimensions.
+  Ogre::TexturePtr createTexture(const std::string &name,
+                                 Ogre::TextureType type,
+                                 uint32_t size, uint32_t depth,
+                                 uint32_t numMipmaps,
+                                 Ogre::PixelFormat format);
+
+  /// Find a layer for new textures, either unused or unreferenced and least
+  /// recently acquired, returning `mMaxLayers` if there is none.
+  /// \pre `mMutex` is held by the caller.
+  uint32_t findFreeLayer() const;
+
+  /// Read the texture with the given name and resize it and its mip chain to
+  /// the layer size, in `Ogre::PF_BYTE_RGBA`. Returns a black image if the
+  /// texture cannot be read.
+  Ogre::Image readLayerTexture(const std::string &name) const;
+};
+
+} // namespace oo
+
+#endif // OPENOBL_OGRE_TERRAIN_TEXTURE_ARRAY_HPP
@@ -0,0 +1,202 @@
+#ifndef OPENOBL_OGRE_TEXTURE_STREAMER_HPP
+#define OPENOBL_OGRE_TEXTURE_STREAMER_HPP
+
+#include <OgreDataStream.h>
+#include <OgreMaterial.h>
+#include <OgreResourceGroupManager.h>
+#include <OgreSingleton.h>
+#include <OgreTexture.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace oo {
+
+/// Streams the mip levels of DDS textures in and out of video memory.
+///
+/// Every DDS texture loaded through Ogre passes through this listener, which
+/// can rewrite the file on the fly so that only the mip levels from some *top
+/// level* downwards are given to Ogre's DDS codec.
+///
+/// Each frame, visible entities report how many pixels tall they appear on
+/// screen along with their material via `requestMaterial()`. Only textures that
+/// have been requested at least once are streamed; the streamer cannot tell how
+/// large anything else is drawn, so textures that are never reported, such as
+/// those of the terrain, distant objects, and sky, are always loaded in full.
+/// The requests decide how much of each texture's mip chain is actually needed,
+/// and once per frame `update()` raises the top level of textures seen close up
+/// and lowers it again under memory pressure:
+/// - Upgrades are ordered by how far the resident resolution falls short of the
+///   requested one, and only started while the total size of the resident mip
+///   levels, including those on their way in, stays within the budget.
+/// - If the budget is exceeded, the textures that have gone unseen the longest
+///   lose their highest resident mip level until it is met again. Textures
+///   that are still being seen are only downgraded if that is not enough.
+///
+/// Rewritten files are read and prepared on worker threads, and the textures
+/// reloaded a few at a time by `oo::UploadQueue`. Textures that Ogre unloads or
+/// removes are forgotten by `update()` every so often. DDS files without a mip
+/// chain, cube maps, volumes, and formats whose size cannot be computed from
+/// the header are loaded in full and only counted towards the budget. Textures
+/// in other file formats are left alone.
+///
+/// \remark All member functions except `update()` can be called from any
+///         thread.
+class TextureStreamer : public Ogre::ResourceLoadingListener,
+                        public Ogre::Singleton<oo::TextureStreamer> {
+ public:
+  /// Residency of a single streamed texture.
+  struct TextureStats {
+    std::string name{};
+    uint32_t width{};
+    uint32_t height{};
+    uint32_t numMipmaps{};
+    /// Top mip level currently in video memory.
+    uint32_t residentMip{};
+    /// Top mip level that the texture would have if there was no budget.
+    uint32_t wantedMip{};
+    std::size_t residentBytes{};
+    bool isStreamable{};
+    bool isPending{};
+  };
+
+  /// Totals across all textures, for the debug display.
+  struct Stats {
+    std::size_t numTextures{};
+    std::size_t numStreamable{};
+    std::size_t numPending{};
+    std::size_t residentBytes{};
+    std::size_t budgetBytes{};
+    /// Number of mip level changes started since the streamer was created.
+    std::size_t numUpgrades{};
+    std::size_t numDowngrades{};
+  };
+
+  /// \param budgetBytes The maximum total size of resident mip levels.
+  /// \param minSize Textures are never streamed out below this size, in
+  ///                pixels along their longest side.
+  TextureStreamer(std::size_t budgetBytes, uint32_t minSize);
+  ~TextureStreamer() override = default;
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+  TextureStreamer(TextureStreamer &&) = delete;
+  TextureStreamer &operator=(TextureStreamer &&) = delete;
+
+  static TextureStreamer &getSingleton();
+  static TextureStreamer *getSingletonPtr();
+
+  /// Record that every texture used by `material` is being drawn on something
+  /// `pixels` tall on screen.
+  void requestMaterial(const Ogre::Material &material, float pixels);
+
+  /// Record that `texture` is being drawn on something `pixels` tall.
+  void requestTexture(const Ogre::Texture &texture, float pixels);
+
+  /// Choose new top levels for every texture and start streaming any that
+  /// changed.
+  /// \remark Must be called on the render thread, once per frame.
+  void update();
+
+  Stats getStats() const;
+
+  /// Return the residency of every texture that the streamer knows about.
+  std::vector<TextureStats> getTextureStats() const;
+
+  Ogre::DataStreamPtr resourceLoading(const Ogre::String &name,
+                                      const Ogre::String &group,
+                                      Ogre::Resource *resource) override;
+
+  void resourceStreamOpened(const Ogre::String &name,
+                            const Ogre::String &group,
+                            Ogre::Resource *resource,
+                            Ogre::DataStreamPtr &dataStream) override;
+
+  bool resourceCollision(Ogre::Resource *resource,
+                         Ogre::ResourceManager *resourceManager) override;
+
+ private:
+  using DataStreamPtr = Ogre::DataStreamPtr;
+
+  /// Number of frames after the last request that a texture's request is
+  /// forgotten and it becomes a candidate for eviction.
+  constexpr static uint64_t REQUEST_LIFETIME{120u};
+  /// Maximum number of textures being read in the background at once.
+  constexpr static std::size_t MAX_IN_FLIGHT{8u};
+  /// Number of frames between looking for textures that have been unloaded or
+  /// removed.
+  constexpr static uint64_t PRUNE_INTERVAL{120u};
+
+  struct Entry {
+    std::string name{};
+    std::string group{};
+    uint32_t width{};
+    uint32_t height{};
+    /// Offset of each mip level from the start of the file, followed by the
+    /// offset of the end of the mip chain.
+    std::vector<std::size_t> mipOffsets{};
+    uint32_t residentMip{};
+    uint32_t wantedMip{};
+    std::size_t residentBytes{};
+    /// Largest request since the last update.
+    float requestedPixels{};
+    uint64_t lastRequestFrame{};
+    /// Whether anything has ever requested the texture. Textures that have not
+    /// been requested are kept at full resolution.
+    bool isRequested{false};
+    bool isStreamable{false};
+    bool isPending{false};
+    /// Top mip level of `prepared`, or of the file being prepared.
+    uint32_t preparedMip{};
+    /// Rewritten file waiting to be given to Ogre on the next reload.
+    DataStreamPtr prepared{};
+  };
+
+  mutable std::mutex mMutex{};
+  std::unordered_map<const Ogre::Texture *, Entry> mEntries{};
+  std::size_t mBudgetBytes;
+  uint32_t mMinSize;
+  uint64_t mFrame{REQUEST_LIFETIME};
+  std::size_t mNumInFlight{0u};
+  std::size_t mNumUpgrades{0u};
+  std::size_t mNumDowngrades{0u};
+
+  /// Return the number of bytes in the mip levels from `mip` downwards.
+  static std::size_t getResidentBytes(const Entry &entry, uint32_t mip);
+
+  /// Return the top mip level that is at least `pixels` in size along the
+  /// longest side, but no smaller than the minimum size.
+  uint32_t getMipForSize(const Entry &entry, float pixels) const;
+
+  /// Read a texture in full and work out its mip layout into `entry`, returning
+  /// the contents of the file, or `nullptr` if it cannot be opened.
+  static Ogre::MemoryDataStreamPtr readTexture(const Ogre::String &name,
+                                               const Ogre::String &group,
+                                               Entry &entry);
+
+  /// Return a copy of the texture `file` containing only the mip levels from
+  /// `mip` downwards.
+  /// \pre `entry` is streamable and describes the layout of `file`.
+  static DataStreamPtr rewriteTexture(Ogre::MemoryDataStream &file,
+                                      const Entry &entry, uint32_t mip);
+
+  /// Forget the textures that are no longer loaded, or that have been removed
+  /// from the texture manager.
+  /// \pre `mMutex` is not held by the caller.
+  void pruneEntries();
+
+  /// Start rewriting the texture of `entry` on a worker thread with `mip` as
+  /// its top level, then reload it on the render thread.
+  /// \pre `mMutex` is held by the caller.
+  void beginStreaming(Entry &entry, uint32_t mip);
+
+  /// Called on the render thread when a rewritten file is ready, or when
+  /// preparing it failed and `stream` is null.
+  void finishStreaming(const std::string &name, const std::string &group,
+                       uint32_t mip, DataStreamPtr stream);
+};
+
+} // namespace oo
+
+#endif // OPENOBL_OGRE_TEXTURE_STREAMER_HPP
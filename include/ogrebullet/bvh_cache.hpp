@@ -0,0 +1,62 @@
+#ifndef OPENOBL_OGREBULLET_BVH_CACHE_HPP
+#define OPENOBL_OGREBULLET_BVH_CACHE_HPP
+
+#include "ogrebullet/collision_shape.hpp"
+#include <btBulletCollisionCommon.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Ogre {
+
+/// On-disk cache of the quantized BVHs of triangle mesh collision shapes.
+///
+/// Building the BVH of a `btBvhTriangleMeshShape` is by far the most expensive
+/// part of loading a static collision mesh, and it is done every time a mesh
+/// is loaded even though the result only depends on the triangles in the mesh.
+/// Bullet can serialize a quantized `btOptimizedBvh` into a flat buffer which
+/// can later be deserialized in place with only a pointer fixup, so the built
+/// BVHs are written to disk and read back the next time the same triangles are
+/// loaded, whether in a different cell or a later session. The deserialized
+/// BVH is only a `btQuantizedBvh`, so its nodes are copied into a new
+/// `btOptimizedBvh`, which is still far cheaper than building it.
+///
+/// Entries are keyed by a checksum of the vertex and index data of the mesh,
+/// so meshes with identical triangles share an entry and a changed mesh never
+/// picks up a stale BVH. Each file records the Bullet configuration that wrote
+/// it, and files written by an incompatible configuration are ignored. Since
+/// the checksum alone is not proof that an entry belongs to a mesh, each file
+/// also records the vertex and triangle counts of its mesh and the shape of
+/// its BVH, and every node of a loaded BVH is checked to refer to a triangle
+/// of the mesh.
+///
+/// The cache is disabled until `setDirectory()` is called with a nonempty path.
+/// \remark All functions can be called from any thread.
+class BvhCache {
+ public:
+  /// Set the directory that cache entries are stored in, creating it if
+  /// necessary. An empty path disables the cache.
+  static void setDirectory(const std::string &directory);
+
+  /// Whether `setDirectory()` has been called with a usable directory.
+  static bool isEnabled();
+
+  /// Return a checksum of the vertex and index data of `mesh`, used to key
+  /// cache entries.
+  static uint64_t getChecksum(const btStridingMeshInterface &mesh);
+
+  /// Load the BVH of `mesh` with the given checksum from the cache.
+  /// \returns `nullptr` if the cache is disabled or there is no usable entry.
+  static std::unique_ptr<btOptimizedBvh>
+  load(uint64_t checksum, const btStridingMeshInterface &mesh);
+
+  /// Write `bvh`, the BVH of `mesh`, into the cache under the given checksum.
+  /// Failures are not reported, the BVH will just be rebuilt next time.
+  /// \pre `bvh` is quantized.
+  static void save(uint64_t checksum, const btStridingMeshInterface &mesh,
+                   btOptimizedBvh &bvh);
+};
+
+} // namespace Ogre
+
+#endif // OPENOBL_OGREBULLET_BVH_CACHE_HPP
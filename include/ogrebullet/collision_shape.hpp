@@ -4,7 +4,10 @@
 #include "ogrebullet/motion_state.hpp"
 #include <btBulletDynamicsCommon.h>
 #include <OgreResource.h>
+#include <array>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 
 namespace Ogre {
@@ -84,11 +87,22 @@ class CollisionShape : public Ogre::Resource {
   const RigidBodyInfo *getRigidBodyInfo() const noexcept;
   const btCollisionShape *getCollisionShape() const noexcept;
 
+  /// Return a copy of the collision shape scaled by `scale`, creating it if
+  /// this is the first time that the scale has been asked for.
+  /// Every `Ogre::RigidBody` with the same scale shares the same scaled shape,
+  /// which is owned by this `CollisionShape`. Triangle meshes share their BVH
+  /// with the unscaled shape.
+  /// \returns `nullptr` if the collision shape cannot be scaled.
+  /// \remark This can be called from any thread.
+  btCollisionShape *getScaledCollisionShape(const btVector3 &scale);
+
   void _setRigidBodyInfo(std::unique_ptr<RigidBodyInfo> info) noexcept;
   void _setCollisionShape(BulletCollisionShapePtr shape) noexcept;
   btCollisionShape *_getCollisionShape() const noexcept;
   void _storeIndirectCollisionShapes(std::vector<BulletCollisionShapePtr> shapes) noexcept;
   void _setMeshInterface(std::unique_ptr<btStridingMeshInterface> mesh) noexcept;
+  /// Take ownership of a BVH used by the collision shape but not owned by it.
+  void _setOptimizedBvh(std::unique_ptr<btOptimizedBvh> bvh) noexcept;
 
   std::vector<uint16_t> &_getIndexBuffer() noexcept;
   std::vector<float> &_getVertexBuffer() noexcept;
@@ -127,6 +141,14 @@ class CollisionShape : public Ogre::Resource {
   /// Interface to the `mIndexBuffer` and `mVertexBuffer`, needed for mesh-based
   /// collision shapes.
   std::unique_ptr<btStridingMeshInterface> mMeshInterface{};
+
+  /// BVH of a mesh-based collision shape, if it was loaded from a cache instead
+  /// of being built by the shape.
+  std::unique_ptr<btOptimizedBvh> mOptimizedBvh{};
+
+  /// Scaled copies of `mCollisionShape`, indexed by their scale.
+  std::map<std::array<btScalar, 3>, BulletCollisionShapePtr> mScaledShapes{};
+  std::mutex mScaledShapesMutex{};
 };
 
 using CollisionShapePtr = std::shared_ptr<CollisionShape>;
@@ -16,6 +16,13 @@ namespace Ogre {
 /// the sense that no two `Ogre::MotionState` objects should point to the same
 /// `Ogre::Node`, or to two different `Ogre::Node`s which share a parent that
 /// is also pointed to by an `Ogre::MotionState`.
+///
+/// Transforms given to the `Ogre::MotionState` by Bullet are not applied to
+/// the `Ogre::Node` immediately, since Bullet may be stepping the simulation
+/// on a different thread to the one that owns the scene graph. Instead, they
+/// are stored until `publish()` is called. Because Bullet steps the simulation
+/// in fixed substeps, the stored transform is interpolated between the last
+/// two substeps and so moves smoothly even if the frame rate does not.
 class MotionState : public btMotionState {
  public:
   explicit MotionState(Node *node);
@@ -46,10 +53,23 @@ class MotionState : public btMotionState {
   ///         its parent.
   void notify();
 
+  /// Apply the last transform given by Bullet to the `Ogre::Node`, if it has
+  /// not been applied already.
+  /// \remark Must be called on the thread that owns the `Ogre::Node`, and not
+  ///         while the simulation is being stepped.
+  void publish();
+
+  /// Return whether Bullet has given a transform that has not been applied to
+  /// the `Ogre::Node`.
+  bool hasUnpublishedTransform() const noexcept {
+    return mDirty;
+  }
+
  private:
   Node *mNode{};
   Vector3 mPosition{};
   Quaternion mOrientation{};
+  bool mDirty{false};
 };
 
 } // namespace Ogre
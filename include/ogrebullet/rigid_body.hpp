@@ -40,9 +40,9 @@ class RigidBody : public MovableObject, public MovableObject::Listener {
   /// Tell the physics system that the bound node has been transformed externally
   void notify();
 
-  /// Scale the rigid body by scaling the collision shape. If an override is not
-  /// already being used, this will create one and notify the rigid body of its
-  /// new collision shape.
+  /// Scale the rigid body by switching to a scaled copy of the collision shape.
+  /// Scaled copies are shared between all rigid bodies with the same collision
+  /// shape and scale; see `Ogre::CollisionShape::getScaledCollisionShape()`.
   /// \remark This operation should be avoided as much as possible, and ideally
   ///        called before the first physics update of the scene. If called
   ///        afterwards, there's no guarantee that you won't upset Bullet.
@@ -66,9 +66,9 @@ class RigidBody : public MovableObject, public MovableObject::Listener {
 
   CollisionShapePtr mCollisionShape{};
   /// `btRigidBody` cannot be scaled; in order to scale on a per-instance basis,
-  /// we use an override shape copied from the main collision shape and scaled.
-  /// This does not need to be used if the scale is unity.
-  std::unique_ptr<btCollisionShape> mCollisionShapeOverride{};
+  /// we use a scaled copy of the main collision shape, owned by the
+  /// `Ogre::CollisionShape`. This is null if the scale is unity.
+  btCollisionShape *mScaledCollisionShape{};
   std::unique_ptr<btRigidBody> mRigidBody{};
   std::unique_ptr<MotionState> mMotionState{};
   /// Needed because `getBoundingRadius()` is `const`, and demands to return by
@@ -2,7 +2,10 @@
 #define OPENOBL_CELL_RESOLVER_HPP
 
 #include "bullet/configuration.hpp"
+#include "bullet/static_collision.hpp"
 #include "esp/esp_coordinator.hpp"
+#include "mesh/instanced_geometry.hpp"
+#include "mesh/static_batch.hpp"
 #include "resolvers/acti_resolver.hpp"
 #include "resolvers/cont_resolver.hpp"
 #include "resolvers/door_resolver.hpp"
@@ -19,17 +22,35 @@
 #include <tl/optional.hpp>
 #include <OgreSceneManager.h>
 #include <Terrain/OgreTerrain.h>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include "util/windows_cleanup.hpp"
 
 namespace oo {
 
+class ScriptScheduler;
+
 using CellResolver = Resolver<record::CELL, oo::BaseId>;
 
 template<>
 class Resolver<record::CELL, oo::BaseId> {
+ public:
+  /// An entry in the change journal.
+  struct Change {
+    /// Change flags, such as `CHANGE_REFERENCES_ENABLED`. If no flags are set
+    /// then any part of the cell may have changed.
+    uint32_t flags{};
+  };
+
+  /// Change flag of a cell in which a reference has been enabled or disabled
+  /// with `setReferenceEnabled()`.
+  constexpr static inline uint32_t CHANGE_REFERENCES_ENABLED{1u << 0u};
+
  private:
   struct Metadata {
     /// Time that the player most recently left the cell, in in-game hours.
@@ -46,6 +67,11 @@ class Resolver<record::CELL, oo::BaseId> {
     /// An optional base id for a LAND record describing the terrain of this
     /// cell. Should be present if `mIsExterior` is true.
     tl::optional<oo::BaseId> mLandId{};
+    /// Whether each reference that has been enabled or disabled with
+    /// `setReferenceEnabled()` is enabled. This outlives any `oo::Cell` made
+    /// from the record, and takes precedence over the reference's
+    /// `InitiallyDisabled` flag.
+    std::unordered_map<oo::RefId, bool> mEnabledReferences{};
   };
 
   /// Holds a record with an immutable backup of the original.
@@ -57,6 +83,10 @@ class Resolver<record::CELL, oo::BaseId> {
   /// Record storage.
   std::unordered_map<oo::BaseId, WrappedRecordEntry> mRecords{};
 
+  /// Change journal of every cell changed since the game started, guarded by
+  /// `mMtx`.
+  std::unordered_map<oo::BaseId, Change> mChanges{};
+
   /// Record storage mutex.
   mutable boost::fibers::mutex mMtx{};
 
@@ -97,10 +127,13 @@ class Resolver<record::CELL, oo::BaseId> {
   tl::optional<const record::CELL &> get(oo::BaseId baseId) const;
 
   /// \overload get(oo::BaseId)
+  /// Unlike the generic `oo::Resolver`, this does not record the cell in the
+  /// change journal, since cells are looked up mutably while loading them.
+  /// Callers that modify the cell should call `markChanged()`.
   tl::optional<record::CELL &> get(oo::BaseId baseId);
 
   /// Reset the detach time for a cell to the given time, in in-game hours, from
-  /// the epoch.
+  /// the epoch, recording the cell in the change journal.
   void setDetachTime(oo::BaseId baseId, int detachTime);
 
   /// Return the detach time for the given cell in in-game hours from the epoch.
@@ -145,6 +178,26 @@ class Resolver<record::CELL, oo::BaseId> {
   ///       are not saved with the cell itself, but it seems like an inelegant
   ///       solution.
   void insertReferenceRecord(oo::BaseId cellId, oo::RefId refId);
+
+  /// Record that the reference with the given `refId` in the given cell has
+  /// been enabled or disabled, marking the cell as changed with
+  /// `CHANGE_REFERENCES_ENABLED`.
+  /// Does nothing if there is no such cell.
+  void setReferenceEnabled(oo::BaseId cellId, oo::RefId refId, bool enabled);
+
+  /// Return whether the reference with the given `refId` in the given cell was
+  /// enabled by the last call to `setReferenceEnabled()`, or an empty optional
+  /// if it has never been enabled or disabled that way.
+  tl::optional<bool> isReferenceEnabled(oo::BaseId cellId,
+                                        oo::RefId refId) const;
+
+  /// Record in the change journal that the cell with the given `baseId` has
+  /// been modified, adding the given change `flags` to any it already has.
+  /// Does nothing if there is no such cell.
+  void markChanged(oo::BaseId baseId, uint32_t flags = 0u);
+
+  /// Return the change journal.
+  std::vector<std::pair<oo::BaseId, Change>> getChanges() const;
 };
 
 class CellResolver::CellVisitor {
@@ -219,6 +272,70 @@ class Cell {
   void setVisible(bool visible);
   bool isVisible() const noexcept;
 
+  /// Enable or disable the reference with the given `oo::RefId` in this cell.
+  /// A disabled reference is hidden and its physics objects are removed from
+  /// the physics world, but it is not destroyed. If the reference is part of
+  /// the cell's static batch, the batch is rebuilt before it is next rendered,
+  /// and if it is part of the cell's merged static collision, the collision is
+  /// rebuilt by the next call to `updateStaticCollision()`.
+  /// References are enabled or disabled by `populateCell()` as last recorded
+  /// in the cell resolver, or disabled if they have never been enabled or
+  /// disabled and are flagged as initially disabled. If the cell has a
+  /// resolver set by `setResolver()` then the change is recorded there.
+  void setReferenceEnabled(oo::RefId refId, bool enabled);
+  bool isReferenceEnabled(oo::RefId refId) const noexcept;
+
+  /// Run the scripts of this cell's references with `scheduler`, or stop
+  /// running them if `scheduler` is null.
+  /// The script of a reference is attached to the scheduler whenever both the
+  /// cell is visible and the reference is enabled, and is detached otherwise.
+  /// Scripts are attached under the form id of their `SCPT` record, as given by
+  /// `oo::BaseId::string()`, so a script is only run once it has been compiled
+  /// under that name.
+  /// \remark The scheduler must outlive the cell or be replaced first, and
+  ///         must only be run on the thread that shows, hides, enables, and
+  ///         disables the cell and its references.
+  void setScriptScheduler(oo::ScriptScheduler *scheduler);
+
+  /// Record references that are enabled or disabled with
+  /// `setReferenceEnabled()` in `resolver`, so that they stay that way when the
+  /// cell is next reified and are in its change journal, or stop recording them
+  /// if `resolver` is null.
+  /// \remark The resolver must outlive the cell or be replaced first.
+  void setResolver(oo::CellResolver *resolver) noexcept;
+
+  /// Merge the geometry of the given static references into a single
+  /// `oo::StaticBatch` owned by the cell, reducing the number of draw calls
+  /// needed to render them. References whose geometry cannot be batched, such
+  /// as those with transparent materials, are left alone, as is any geometry
+  /// that has already been instanced with `instanceStaticGeometry()`.
+  /// \remark Must be run on the render thread.
+  void batchStaticGeometry(const std::vector<oo::RefId> &refIds);
+
+  /// Draw the repeated geometry of the given static references with hardware
+  /// instancing.
+  /// Every mesh used at least `threshold` times by the references, or which is
+  /// already instanced by another cell in the same scene, is added to the
+  /// `oo::InstancedGeometry` shared by all cells in the scene manager, creating
+  /// it if necessary.
+  /// \remark Must be run on the render thread.
+  void instanceStaticGeometry(const std::vector<oo::RefId> &refIds,
+                              std::size_t threshold);
+
+  /// Merge the static collision of the given references into a
+  /// `bullet::StaticCollision` owned by the cell, replacing their individual
+  /// rigid bodies in the physics world with a few large collision objects.
+  /// Rigid bodies whose shapes cannot be merged are left alone. The merged
+  /// collision is rebuilt by `updateStaticCollision()` after any of the
+  /// references are enabled or disabled.
+  /// \remark Must not be called while the physics world is being stepped.
+  void mergeStaticCollision(const std::vector<oo::RefId> &refIds);
+
+  /// Rebuild the merged static collision if any of its references have been
+  /// enabled or disabled since it was last built.
+  /// \remark Must not be called while the physics world is being stepped.
+  void updateStaticCollision();
+
   explicit Cell(oo::BaseId baseId, std::string name)
       : mBaseId(baseId), mName(std::move(name)) {}
 
@@ -242,16 +359,72 @@ class Cell {
   void showNode(gsl::not_null<Ogre::SceneNode *> node);
   void hideNode(gsl::not_null<Ogre::SceneNode *> node);
 
+  /// Show or hide `root` and all of its descendants, except for those which
+  /// belong to disabled references.
+  void setTreeVisible(gsl::not_null<Ogre::SceneNode *> root, bool visible);
+
+  /// Return the root scene node of the given reference, if it exists.
+  Ogre::SceneNode *getReferenceNode(oo::RefId refId) const;
+
+  /// Remove the geometry of this cell's references from the shared
+  /// `oo::InstancedGeometry`. Cells which share their scene manager must call
+  /// this before they are destroyed.
+  void releaseInstancedGeometry();
+
+  /// Remove the merged static collision from the physics world and destroy it.
+  /// This must be called before the physics world is destroyed.
+  void releaseStaticCollision();
+
+  /// Record that the reference is scripted, attaching its script to the
+  /// scheduler if the reference is active.
+  void addReferenceScript(oo::RefId refId, oo::BaseId scriptId);
+
  private:
   oo::BaseId mBaseId{};
   std::string mName{};
   bool mIsVisible{true};
   std::vector<std::unique_ptr<oo::Character>> mCharacters{};
+  /// References which have been disabled with `setReferenceEnabled()`.
+  std::set<oo::RefId> mDisabledReferences{};
+  /// The script of each scripted reference.
+  std::map<oo::RefId, oo::BaseId> mReferenceScripts{};
+  /// Scheduler that the scripts of active references are attached to, if any.
+  oo::ScriptScheduler *mScriptScheduler{};
+  /// Resolver that enabled and disabled references are recorded in, if any.
+  oo::CellResolver *mResolver{};
+  /// Merged geometry of the cell's static references, if any.
+  oo::StaticBatch *mStaticBatch{};
+  /// Instanced geometry shared by every cell in the scene manager, if any of
+  /// this cell's references are instanced.
+  oo::InstancedGeometry *mInstancedGeometry{};
+  /// References with geometry in `mInstancedGeometry`.
+  std::set<oo::RefId> mInstancedReferences{};
+  /// Merged static collision of the cell's references, if any.
+  std::unique_ptr<bullet::StaticCollision> mStaticCollision{};
+  /// Rigid bodies whose shapes are in `mStaticCollision`, which are never added
+  /// to the physics world themselves.
+  std::set<const Ogre::RigidBody *> mMergedRigidBodies{};
+
+  /// Attach or detach the script of a reference, if it has one.
+  void setReferenceScriptAttached(oo::RefId refId, bool attached);
+
+  /// Attach or detach the scripts of every enabled reference, if the cell is
+  /// visible.
+  void setScriptsAttached(bool attached);
+
+  /// Name of the `oo::InstancedGeometry` shared by cells in a scene manager.
+  constexpr static const char *INSTANCED_GEOMETRY_NAME{"__InstancedGeometry"};
+
+  /// Enable or disable the instanced geometry of a reference according to the
+  /// visibility of the cell and of the reference.
+  void updateInstancedReference(oo::RefId refId);
 
   virtual void setVisibleImpl(bool visible);
 };
 
-inline Cell::~Cell() = default;
+inline Cell::~Cell() {
+  setScriptScheduler(nullptr);
+}
 
 class InteriorCell : public Cell {
  public:
@@ -342,8 +515,53 @@ ReifyRecordImpl<record::CELL>::type
 populateCell(std::shared_ptr<oo::Cell> cell, const record::CELL &refRec,
              ReifyRecordImpl<record::CELL>::resolvers resolvers);
 
+/// Prepare the models of the references in a cell so that reifying the cell
+/// does not need to parse them, then upload their meshes using the
+/// `oo::UploadQueue`, returning once every upload has completed.
+/// Does nothing if `General.bPrepareModelsInBackground` is false.
+/// \remark This waits for the render thread to drain the `oo::UploadQueue`,
+///         so must be run on a worker thread.
+void prepareCell(const record::CELL &refRec,
+                 ReifyRecordImpl<record::CELL>::resolvers resolvers);
+
+namespace detail {
+
+template<class T, class = void>
+struct HasScript : std::false_type {};
+
+template<class T>
+struct HasScript<T, std::void_t<decltype(std::declval<T>().script)>>
+    : std::true_type {};
+
+template<class T, class = void>
+struct HasItemScript : std::false_type {};
+
+template<class T>
+struct HasItemScript<T, std::void_t<decltype(std::declval<T>().itemScript)>>
+    : std::true_type {};
+
+} // namespace detail
+
+/// Return the script of a base record, if it has one.
+template<class Base>
+std::optional<oo::BaseId> getBaseScript(const Base &rec) {
+  if constexpr (detail::HasScript<Base>::value) {
+    if (rec.script) return rec.script->data;
+  } else if constexpr (detail::HasItemScript<Base>::value) {
+    if (rec.itemScript) return rec.itemScript->data;
+  }
+  return std::nullopt;
+}
+
 template<class Refr, class ...Res>
 void Cell::attach(Refr ref, std::tuple<const Res &...> resolvers) {
+  // The first resolver is always that of the base record.
+  const oo::RefId refId{ref.mFormId};
+  const auto scriptId{[&]() -> std::optional<oo::BaseId> {
+    auto baseRec{std::get<0>(resolvers).get(ref.baseId.data)};
+    return baseRec ? oo::getBaseScript(*baseRec) : std::nullopt;
+  }()};
+
   // TODO: Abstract away the type difference
   if constexpr (std::is_same_v<std::decay_t<Refr>, record::REFR_NPC_>) {
     auto charPtr{reifyRecord(ref, getSceneManager(), getPhysicsWorld(),
@@ -367,6 +585,8 @@ void Cell::attach(Refr ref, std::tuple<const Res &...> resolvers) {
     setNodeTransform(gsl::make_not_null(childNode), ref);
     setNodeScale(gsl::make_not_null(childNode), ref);
   }
+
+  if (scriptId) addReferenceScript(refId, *scriptId);
 }
 
 } // namespace oo
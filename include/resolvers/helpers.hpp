@@ -1,6 +1,7 @@
 #ifndef OPENOBL_RESOLVERS_HELPERS_HPP
 #define OPENOBL_RESOLVERS_HELPERS_HPP
 
+#include "bullet/static_collision.hpp"
 #include "fs/path.hpp"
 #include "nifloader/scene.hpp"
 #include "ogrebullet/rigid_body.hpp"
@@ -11,6 +12,7 @@
 #include <OgreSceneManager.h>
 #include <OgreSceneNode.h>
 #include <gsl/gsl>
+#include <optional>
 #include <type_traits>
 #include "util/windows_cleanup.hpp"
 
@@ -23,30 +25,46 @@ void setRefId(gsl::not_null<Ogre::RigidBody *> rigidBody, RefId refId);
 /// of its children to the given `refId`.
 void setRefId(gsl::not_null<Ogre::SceneNode *> node, RefId refId);
 
+/// Return the reference owning the part of `object` identified by `shapePart`
+/// and `triangleIndex`, as given by a `btCollisionWorld::LocalShapeInfo`.
+/// This is the reference stored in the bullet user data of `object`, unless
+/// `object` is part of a `bullet::StaticCollision`, in which case it is the
+/// owner of the part.
+RefId getRefId(gsl::not_null<const btCollisionObject *> object,
+               int shapePart = -1, int triangleIndex = -1);
+
 /// Given a base record with a `modelFilename` member of type `record::MODL`,
-/// construct a child node of the given `parentNode` (or the scene root if none
-/// is given) and use insert the record's model into the scene graph.
-/// The child node will be named equal to the result of `refId.string()`.
-template<class T> Ogre::SceneNode *
-insertNif(const T &baseRec, RefId refId,
-          gsl::not_null<Ogre::SceneManager *> scnMgr,
-          gsl::not_null<btDiscreteDynamicsWorld *> world,
-          Ogre::SceneNode *parentNode = nullptr) {
+/// return the path of the record's model relative to the data folder, or an
+/// empty optional if the record does not have a model.
+template<class T> std::optional<oo::Path> getModelPath(const T &baseRec) {
   oo::Path baseName;
   using modl_t = decltype(baseRec.modelFilename);
   if constexpr (std::is_same_v<modl_t, std::optional<record::MODL>>) {
-    if (!baseRec.modelFilename) return nullptr;
+    if (!baseRec.modelFilename) return std::nullopt;
     baseName = oo::Path{baseRec.modelFilename->data};
   } else if constexpr (std::is_same_v<modl_t, record::MODL>) {
     baseName = oo::Path{baseRec.modelFilename.data};
   } else {
     static_assert(false_v<T>, "Missing MODL record");
   }
-  oo::Path name{oo::Path{"meshes"} / baseName};
+  return oo::Path{"meshes"} / baseName;
+}
+
+/// Given a base record with a `modelFilename` member of type `record::MODL`,
+/// construct a child node of the given `parentNode` (or the scene root if none
+/// is given) and use insert the record's model into the scene graph.
+/// The child node will be named equal to the result of `refId.string()`.
+template<class T> Ogre::SceneNode *
+insertNif(const T &baseRec, RefId refId,
+          gsl::not_null<Ogre::SceneManager *> scnMgr,
+          gsl::not_null<btDiscreteDynamicsWorld *> world,
+          Ogre::SceneNode *parentNode = nullptr) {
+  const auto name{oo::getModelPath(baseRec)};
+  if (!name) return nullptr;
 
   auto *parent{parentNode ? parentNode : scnMgr->getRootSceneNode()};
   auto *root{parent->createChildSceneNode(refId.string())};
-  auto *node{oo::insertNif(name.c_str(), oo::RESOURCE_GROUP, scnMgr, world,
+  auto *node{oo::insertNif(name->c_str(), oo::RESOURCE_GROUP, scnMgr, world,
                            gsl::make_not_null(root))};
   if (node) oo::setRefId(gsl::make_not_null(root), refId);
 
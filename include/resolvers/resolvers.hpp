@@ -13,6 +13,8 @@
 #include <OgreSceneManager.h>
 #include <tl/optional.hpp>
 #include <mutex>
+#include <utility>
+#include <vector>
 #include "util/windows_cleanup.hpp"
 
 namespace oo {
@@ -43,6 +45,10 @@ template<class R> inline constexpr bool is_record_v = is_record<R>::value;
 /// esp files (call these 'esp records'), and those obtained from ess files or
 /// generated on the fly (call these 'ess records).
 ///
+/// Every ess record is recorded in a *change journal* when it is created or
+/// possibly modified, so that saving the game only has to look at the records
+/// that have changed, instead of every record in the load order.
+///
 /// \remark This class does *not* support deferred loading of records or the
 ///         loading of records located in hierarchical top groups, namely
 ///         record::CELL, record::WRLD, and record::DIAL.
@@ -51,6 +57,18 @@ class Resolver {
  public:
   using IdType = Id;
 
+  /// An entry in the change journal.
+  struct Change {
+    /// Change flags in the same form as `record::ChrRecord::flags`, whose
+    /// meaning depends on the record type. These are only set by callers of
+    /// `markChanged()` that know which parts of the record they modified; if
+    /// no flags are set then any part of the record may have changed.
+    uint32_t flags{};
+    /// Whether the record is a new ess record, instead of a modified esp
+    /// record.
+    bool isCreated{false};
+  };
+
  private:
   /// Holds a record with an immutable backup of the original.
   /// Used to provide something like 'opt-out CoW access' to records.
@@ -64,6 +82,9 @@ class Resolver {
   /// Record storage.
   std::unordered_map<IdType, RecordEntry> mRecords{};
 
+  /// Change journal of every ess record, guarded by `mMtx`.
+  std::unordered_map<IdType, Change> mChanges{};
+
   /// Record storage mutex.
   mutable boost::fibers::mutex mMtx{};
 
@@ -105,6 +126,8 @@ class Resolver {
   tl::optional<const R &> get(IdType baseId) const;
 
   /// \overload get(IdType)
+  /// The returned record may be modified, so it is recorded in the change
+  /// journal.
   tl::optional<R &> get(IdType baseId);
 
   /// Checks if there is a record of type R with the baseId.
@@ -117,6 +140,25 @@ class Resolver {
   /// Insert a new ess record, doing nothing if an esp or ess record already
   /// exists with that baseId.
   bool insert(IdType baseId, const R &rec);
+
+  /// Return a copy of every ess record, including esp records that have been
+  /// modified.
+  /// This is intended for taking a snapshot of the mutable state of the
+  /// resolver, such as when saving the game, so that it can be serialized
+  /// while the resolver continues to be modified. Only records in the change
+  /// journal are visited, so this is cheap compared to the size of the
+  /// resolver.
+  std::vector<std::pair<IdType, R>> getEssRecords() const;
+
+  /// Record in the change journal that the record with the given `baseId` has
+  /// been modified, adding the given change `flags` to any it already has.
+  /// Does nothing if there is no such record.
+  /// \remark Modifying a record through `get()` already records it in the
+  ///         journal, so this is only needed to describe what was changed.
+  void markChanged(IdType baseId, uint32_t flags = 0u);
+
+  /// Return the change journal.
+  std::vector<std::pair<IdType, Change>> getChanges() const;
 };
 
 /// Used for specializing the return type of citeRecord.
@@ -341,6 +383,7 @@ template<class R, class IdType>
 Resolver<R, IdType>::Resolver(Resolver &&other) noexcept {
   std::scoped_lock lock{other.mMtx};
   mRecords = std::move(other.mRecords);
+  mChanges = std::move(other.mChanges);
 }
 
 template<class R, class IdType>
@@ -349,6 +392,7 @@ Resolver<R, IdType> &Resolver<R, IdType>::operator=(Resolver &&other) noexcept {
     std::scoped_lock lock{mMtx, other.mMtx};
     using std::swap;
     swap(mRecords, other.mRecords);
+    swap(mChanges, other.mChanges);
   }
 
   return *this;
@@ -400,6 +444,7 @@ tl::optional<R &> Resolver<R, IdType>::get(IdType baseId) {
   if (it == mRecords.end()) return tl::nullopt;
   RecordEntry &entry{it->second};
 
+  mChanges.try_emplace(baseId, Change{0u, entry.index() == 1});
   if (entry.index() == 0) {
     auto &pair{std::get<0>(entry)};
     if (!pair.second) pair.second.emplace(pair.first);
@@ -418,6 +463,7 @@ template<class R, class IdType>
 bool Resolver<R, IdType>::insertOrAssign(IdType baseId, const R &rec) {
   std::scoped_lock lock{mMtx};
   auto[it, inserted]{mRecords.try_emplace(baseId, std::in_place_index<1>, rec)};
+  mChanges.try_emplace(baseId, Change{0u, it->second.index() == 1});
   if (inserted) return true;
   return std::visit(nostdx::overloaded{
       [&rec](R &oldRec) {
@@ -435,7 +481,51 @@ bool Resolver<R, IdType>::insertOrAssign(IdType baseId, const R &rec) {
 template<class R, class IdType>
 bool Resolver<R, IdType>::insert(IdType baseId, const R &rec) {
   std::scoped_lock lock{mMtx};
-  return mRecords.try_emplace(baseId, std::in_place_index<1>, rec).second;
+  const bool inserted{mRecords.try_emplace(baseId, std::in_place_index<1>,
+                                           rec).second};
+  if (inserted) mChanges.insert_or_assign(baseId, Change{0u, true});
+  return inserted;
+}
+
+template<class R, class IdType>
+std::vector<std::pair<IdType, R>> Resolver<R, IdType>::getEssRecords() const {
+  std::scoped_lock lock{mMtx};
+  std::vector<std::pair<IdType, R>> records{};
+  records.reserve(mChanges.size());
+
+  for (const auto &[baseId, change] : mChanges) {
+    const auto it{mRecords.find(baseId)};
+    if (it == mRecords.end()) continue;
+    const RecordEntry &entry{it->second};
+
+    if (entry.index() == 0) {
+      const auto &pair{std::get<0>(entry)};
+      if (pair.second) records.emplace_back(baseId, *pair.second);
+    } else {
+      records.emplace_back(baseId, std::get<1>(entry));
+    }
+  }
+
+  return records;
+}
+
+template<class R, class IdType>
+void Resolver<R, IdType>::markChanged(IdType baseId, uint32_t flags) {
+  std::scoped_lock lock{mMtx};
+  const auto it{mRecords.find(baseId)};
+  if (it == mRecords.end()) return;
+
+  auto &change{mChanges.try_emplace(baseId,
+                                    Change{0u, it->second.index() == 1})
+                   .first->second};
+  change.flags |= flags;
+}
+
+template<class R, class IdType>
+std::vector<std::pair<IdType, typename Resolver<R, IdType>::Change>>
+Resolver<R, IdType>::getChanges() const {
+  std::scoped_lock lock{mMtx};
+  return {mChanges.begin(), mChanges.end()};
 }
 
 } // namespace oo
@@ -16,6 +16,14 @@ using WrldResolver = Resolver<record::WRLD, oo::BaseId>;
 
 template<>
 class Resolver<record::WRLD, oo::BaseId> {
+ public:
+  /// An entry in the change journal.
+  struct Change {
+    /// Change flags given to `markChanged()`. If no flags are set then any part
+    /// of the world may have changed.
+    uint32_t flags{};
+  };
+
  private:
   struct Metadata {
     /// Accessors, in load order of mods that modify the contents of the world.
@@ -41,6 +49,10 @@ class Resolver<record::WRLD, oo::BaseId> {
   /// Record storage.
   std::unordered_map<oo::BaseId, WrappedRecordEntry> mRecords{};
 
+  /// Change journal of every world changed since the game started, guarded by
+  /// `mMtx`.
+  std::unordered_map<oo::BaseId, Change> mChanges{};
+
   /// Record storage mutex.
   mutable boost::fibers::mutex mMtx{};
 
@@ -66,6 +78,8 @@ class Resolver<record::WRLD, oo::BaseId> {
   tl::optional<const record::WRLD &> get(oo::BaseId baseId) const;
 
   /// \overload get(oo::BaseId)
+  /// As with `oo::CellResolver`, this does not record the world in the change
+  /// journal. Callers that modify the world should call `markChanged()`.
   tl::optional<record::WRLD &> get(oo::BaseId baseId);
 
   /// Check if there is a world with the baseId.
@@ -108,6 +122,14 @@ class Resolver<record::WRLD, oo::BaseId> {
   /// This method should generally be avoided but is necessary when trying to
   /// find which worldspace contains a given cell.
   std::unordered_set<BaseId> getWorlds() const;
+
+  /// Record in the change journal that the world with the given `baseId` has
+  /// been modified, adding the given change `flags` to any it already has.
+  /// Does nothing if there is no such world.
+  void markChanged(oo::BaseId baseId, uint32_t flags = 0u);
+
+  /// Return the change journal.
+  std::vector<std::pair<oo::BaseId, Change>> getChanges() const;
 };
 
 class WrldResolver::WrldVisitor {
@@ -188,9 +210,12 @@ class World {
   void unloadTerrain(oo::ExteriorCell &cell);
 
   /// Load the terrain of the cell with the given id.
-  void loadTerrainOnly(oo::BaseId cellId, bool async = true);
+  /// This can be called from any thread; the work that needs the render thread
+  /// is submitted to the `oo::UploadQueue`.
+  void loadTerrainOnly(oo::BaseId cellId);
 
   /// Unload the terrain of the cell with the given id.
+  /// This can be called from any thread.
   void unloadTerrain(oo::BaseId cellId);
 
   void updateAtmosphere(const oo::chrono::minutes &time);
@@ -0,0 +1,38 @@
+#ifndef OPENOBL_SAVE_FILE_HPP
+#define OPENOBL_SAVE_FILE_HPP
+
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <string>
+
+namespace oo {
+
+/// Write the serialized save game `bytes` to the file at `path`, compressing
+/// them if `compress` is true. The bytes are written to a temporary file that
+/// is renamed over `path` once complete, so that an existing save game is never
+/// replaced by a partially written one.
+/// \remark Compressed save games can only be read with `openSaveGame()`, and
+///         cannot be loaded by the original game.
+/// \throws std::runtime_error if the file cannot be written.
+void writeSaveFile(const std::string &bytes, const std::filesystem::path &path,
+                   bool compress);
+
+/// Open a save game for reading, decompressing it if it was compressed by
+/// `writeSaveFile()`. Uncompressed save games are read as they are.
+/// \throws std::runtime_error if the save game is compressed but cannot be
+///         decompressed.
+std::unique_ptr<std::istream> openSaveGame(const std::filesystem::path &path);
+
+/// Open a save game for reading like `openSaveGame()`, but decompress it as it
+/// is read instead of all at once, so that reading just the header of a
+/// compressed save game does not decompress the rest of it.
+/// \remark The returned stream is not seekable.
+/// \throws std::runtime_error if the save game is compressed but cannot be
+///         decompressed.
+std::unique_ptr<std::istream>
+streamSaveGame(const std::filesystem::path &path);
+
+} // namespace oo
+
+#endif // OPENOBL_SAVE_FILE_HPP
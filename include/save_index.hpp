@@ -0,0 +1,131 @@
+#ifndef OPENOBL_SAVE_INDEX_HPP
+#define OPENOBL_SAVE_INDEX_HPP
+
+#include "save_state.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace oo {
+
+/// Metadata about a save game, read from the header of its file, that is
+/// needed to display the save game in the Load Game Menu.
+struct SaveHeader {
+  /// Path to the save game file.
+  std::filesystem::path path{};
+
+  /// \see SaveState::mVersion
+  uint8_t version{};
+  /// \see SaveState::mExeTime
+  SystemTime exeTime{};
+  /// \see SaveState::mHeaderVersion
+  uint32_t headerVersion{};
+  /// \see SaveState::mSaveNumber
+  uint32_t saveNumber{};
+  /// \see SaveState::mPlayerName
+  std::string playerName{};
+  /// \see SaveState::mPlayerLevel
+  uint16_t playerLevel{};
+  /// \see SaveState::mPlayerCellName
+  std::string playerCellName{};
+  /// \see SaveState::mGameDaysPassed
+  float gameDaysPassed{};
+  /// \see SaveState::mGameTicksPassed
+  uint32_t gameTicksPassed{};
+  /// \see SaveState::mSaveTime
+  SystemTime saveTime{};
+
+  /// Width in pixels of `thumbnail`.
+  uint32_t thumbnailWidth{};
+  /// Height in pixels of `thumbnail`.
+  uint32_t thumbnailHeight{};
+  /// Downscaled copy of `SaveState::mScreenshot`, in `PF_BYTE_RGB` format.
+  std::vector<uint8_t> thumbnail{};
+};
+
+/// Full size screenshot from the header of a save game.
+struct SaveScreenshot {
+  uint32_t width{};
+  uint32_t height{};
+  /// Pixels of the screenshot, in `PF_BYTE_RGB` format.
+  std::vector<uint8_t> pixels{};
+};
+
+/// Read the metadata of a save game from the header of its file.
+/// `header` only keeps a thumbnail of the screenshot, no wider than
+/// `SaveIndex::THUMBNAIL_WIDTH`. The full screenshot is read into `screenshot`
+/// if it is not null, which is how `readSaveHeader(std::istream &, SaveState &)`
+/// reads the header of a save game being loaded.
+/// \throws std::runtime_error if the file is not a save game.
+std::istream &readSaveHeader(std::istream &is, SaveHeader &header,
+                             SaveScreenshot *screenshot = nullptr);
+
+/// Write the header of a save game so that `readSaveHeader()` reads back
+/// `header` and `screenshot`. The thumbnail and path of `header` are ignored.
+std::ostream &writeSaveHeader(std::ostream &os, const SaveHeader &header,
+                              const SaveScreenshot &screenshot);
+
+/// Index of the headers of the save games in the save directory.
+///
+/// Every save game in the Load Game Menu needs some metadata from its header,
+/// but reading a header requires reading the entire uncompressed screenshot
+/// that precedes the rest of the save. Instead of reading every header before
+/// the menu can appear, the index reads them in jobs on the worker threads
+/// and hands them out as they become available.
+///
+/// Headers are cached in an index file in the save directory, keyed by the
+/// size and modification time of their save game, so that a header is only
+/// read again when its save game changes. The index file is rewritten once
+/// every header has been read, if any were not already cached.
+///
+/// This class is not thread-safe, and should only be used by the thread that
+/// calls `scan()`.
+class SaveIndex {
+ public:
+  /// Maximum width in pixels of the thumbnails in the index.
+  static constexpr uint32_t THUMBNAIL_WIDTH{128u};
+
+  /// Name of the index file in the save directory.
+  static constexpr const char *INDEX_FILENAME{"save_index.bin"};
+
+ private:
+  struct ScanState;
+
+  std::filesystem::path mSaveDir;
+  std::shared_ptr<ScanState> mState{};
+  /// Number of headers that have been returned by `poll()`.
+  std::size_t mNumPolled{};
+
+ public:
+  explicit SaveIndex(std::filesystem::path saveDir = oo::getSaveDirectory());
+  ~SaveIndex();
+
+  SaveIndex(const SaveIndex &) = delete;
+  SaveIndex &operator=(const SaveIndex &) = delete;
+  SaveIndex(SaveIndex &&) noexcept;
+  SaveIndex &operator=(SaveIndex &&) noexcept;
+
+  /// Find all the save games in the save directory and begin reading the
+  /// headers of any that are not cached. Any previous scan is abandoned.
+  void scan();
+
+  /// Return the headers that have become available since the last call,
+  /// without blocking.
+  /// Headers are returned in order of modification time, most recent first,
+  /// so a header is not returned until every more recent header has been.
+  /// Save games whose header could not be read are skipped.
+  std::vector<SaveHeader> poll();
+
+  /// Return whether every header found by the last scan has been returned by
+  /// `poll()`.
+  bool isFinished() const;
+};
+
+} // namespace oo
+
+#endif // OPENOBL_SAVE_INDEX_HPP
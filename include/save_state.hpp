@@ -7,6 +7,7 @@
 #include "record/formid.hpp"
 #include "resolvers/resolvers.hpp"
 #include "resolvers/cell_resolver.hpp"
+#include "save_file.hpp"
 #include <OgreImage.h>
 #include <cctype>
 #include <filesystem>
@@ -35,6 +36,12 @@ static_assert(sizeof(SystemTime) == 16u);
 /// directory containing save games.
 std::filesystem::path getSaveDirectory();
 
+class JobCounter;
+
+/// Copies of the ess records that are written to a save game.
+/// \see SaveState::takeSnapshot()
+struct EssSnapshot;
+
 class EssAccessor {
  private:
   friend class SaveState;
@@ -105,6 +112,13 @@ class SaveState {
   /// Construct an `oo::CellRequest` to load the cell the player is in.
   oo::CellRequest makeCellRequest() const;
 
+  /// Copy the ess records of the created records out of the base resolvers.
+  /// Writing the save state writes the copies instead of looking the records
+  /// up, so once a snapshot has been taken the save state can be written on
+  /// another thread while the game continues to modify the resolvers. If no
+  /// snapshot has been taken then no created records are written.
+  void takeSnapshot();
+
   /// \name File Header
   ///@{
 
@@ -245,10 +259,27 @@ class SaveState {
   std::vector<Region> mRegions{};
 
   ///@}
+
+  /// Snapshot of the created records taken by `takeSnapshot()`.
+  std::shared_ptr<const EssSnapshot> mSnapshot{};
 };
 
 std::istream &readSaveHeader(std::istream &is, SaveState &sv);
 
+/// Write a save game to a file without blocking the calling thread.
+///
+/// A snapshot of the save state is taken with `SaveState::takeSnapshot()`
+/// before returning. The save is then serialized in a job on the worker
+/// threads and written with `writeSaveFile()`, compressed if
+/// `General.bCompressSaves` is true.
+///
+/// \param counter If not null, decremented once the save game has been
+///                written, or has failed to be written.
+/// \remark Compressed save games can only be read with `openSaveGame()`, and
+///         cannot be loaded by the original game.
+void writeSaveGame(SaveState sv, std::filesystem::path path,
+                   oo::JobCounter *counter = nullptr);
+
 } // namespace oo
 
 #endif // OPENOBL_SAVE_STATE_HPP
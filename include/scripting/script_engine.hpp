@@ -3,26 +3,134 @@
 
 #include "scripting/script_engine_base.hpp"
 #include <nostdx/propagate_const.hpp>
+#include <memory>
 #include <optional>
+#include <string>
+#include <variant>
 
 namespace oo {
 
 /// Compilers user scripts and makes them available for running at game time.
+///
+/// Compiling a script happens in two stages. `prepare()` parses the script,
+/// lowers it to IR, and optimizes it, and can be called concurrently from any
+/// number of threads, for instance from jobs on the `oo::JobManager`; each
+/// thread builds its modules in an `llvm::LLVMContext` of its own. `add()` then
+/// hands the prepared script to the engine. Generating machine code is left
+/// until a function of the script is first called, so scripts that are never
+/// run never pay for it. `compile()` does both stages at once.
+///
+/// If a JIT threshold is set with `setJitThreshold()`, then `compile()` only
+/// compiles scripts to bytecode, which is far cheaper, and they are run by an
+/// interpreter. Once any block of a script has been called as many times as
+/// the threshold, the whole script is compiled to machine code on a background
+/// thread and later calls jump straight to it. Scripts are promoted as a whole
+/// because their blocks share the script's variables, whose values are carried
+/// over from the interpreter.
+///
+/// Functions must all be registered before anything is compiled.
 class ScriptEngine : public ScriptEngineBase {
  private:
   class Impl;
   nostdx::propagate_const<std::unique_ptr<Impl>> mImpl;
 
-  [[nodiscard]] std::optional<llvm::JITTargetAddress>
-  getFunctionAddr(const std::string &scriptName, const std::string &funName);
+  struct TieredScript;
 
  public:
+  /// A function of a script looked up by `resolve()`, which can be called any
+  /// number of times without being looked up again.
+  /// Handles keep referring to the version of the script that was current
+  /// when they were resolved, so should be resolved again if the script is
+  /// compiled again. They must not outlive the engine.
+  class Handle {
+   private:
+    friend ScriptEngine;
+    llvm::JITTargetAddress mAddr{};
+    std::shared_ptr<TieredScript> mTiered{};
+    std::size_t mBlock{};
+
+   public:
+    /// Whether the function was found.
+    explicit operator bool() const noexcept {
+      return mAddr != 0u || mTiered != nullptr;
+    }
+
+    /// Whether calls through the handle jump to machine code instead of being
+    /// interpreted. A handle to an interpreted script becomes native once the
+    /// script has been promoted and one of its blocks is called again.
+    [[nodiscard]] bool isNative() const noexcept;
+  };
+
+ private:
+  /// Return value of a function that has already been run by the interpreter.
+  struct InterpretedResult {
+    uint32_t word{};
+  };
+
+  /// How a call to a function should complete: it cannot, it should jump to
+  /// the function's machine code, or it has already been interpreted.
+  using Dispatch = std::variant<std::monostate, llvm::JITTargetAddress,
+                                InterpretedResult>;
+
+  [[nodiscard]] Dispatch
+  dispatch(const std::string &scriptName, const std::string &funName);
+  [[nodiscard]] Dispatch dispatch(const Handle &handle);
+
+  /// Complete a call to a function returning `T`.
+  template<class T> static auto complete(const Dispatch &target)
+  -> std::conditional_t<std::is_same_v<T, void>, void, std::optional<T>>;
+
+ public:
+  /// A script that has been through the first stage of compilation.
+  struct PreparedScript {
+    /// Name of the script.
+    std::string name{};
+    /// Key of the script in the cache, if the cache is enabled.
+    std::string cacheKey{};
+    /// Optimized bitcode of the script, if it was not found in the cache.
+    std::string bitcode{};
+    /// Object code of the script, if it was found in the cache.
+    std::unique_ptr<llvm::MemoryBuffer> object{};
+  };
+
   /// Compile a script into native object code, making it available for calling.
   /// If `calleeRef` is given then free function calls that do not resolve to
   /// known functions implicitly take `calleeRef` as their first argument, if
   /// the function would then resolve.
+  ///
+  /// If the cache is enabled, then the object code is looked up in the cache
+  /// first and only compiled if it is not there, in which case it is added.
+  /// Entries are keyed by a hash of the script, `calleeRef`, the prototypes of
+  /// every registered function, the LLVM version, and the host CPU, so all
+  /// functions should be registered before compiling anything.
   void compile(std::string_view script, std::optional<uint32_t> calleeRef = {});
 
+  /// Parse, lower, and optimize a script, or load its object code from the
+  /// cache, without making it available for calling.
+  /// This can be called from any thread, concurrently with any member function
+  /// except `registerFunction()` and `setCacheDirectory()`.
+  /// \returns `std::nullopt` if the script could not be parsed or has no name.
+  /// \see compile()
+  [[nodiscard]] std::optional<PreparedScript>
+  prepare(std::string_view script, std::optional<uint32_t> calleeRef = {});
+
+  /// Make a script returned by `prepare()` available for calling. Machine code
+  /// is generated the first time one of the script's functions is called.
+  /// This can be called from any thread.
+  void add(PreparedScript script);
+
+  /// Cache compiled scripts in the given directory, creating it if necessary,
+  /// or stop caching them if `directory` is empty.
+  /// \see oo::ScriptCache
+  void setCacheDirectory(const std::string &directory);
+
+  /// Interpret scripts passed to `compile()` until one of their blocks has
+  /// been called `threshold` times, then compile them to machine code.
+  /// Scripts found in the cache are always loaded as machine code. A threshold
+  /// of zero, the default, compiles every script to machine code up front.
+  /// This must be called before anything is compiled.
+  void setJitThreshold(uint32_t threshold) noexcept;
+
   ScriptEngine();
   ~ScriptEngine();
   ScriptEngine(const ScriptEngine &) = delete;
@@ -32,20 +140,47 @@ class ScriptEngine : public ScriptEngineBase {
 
   /// Call the given function from the given script.
   /// The given script must been `compile`d previously, and a function with the
-  /// given name and specified return type must exist in the script.
+  /// given name and specified return type must exist in the script. The first
+  /// call to a function of a script generates the script's machine code,
+  /// unless the script is being interpreted.
+  /// This can be called from any thread.
   /// \tparam T The return type of the function.
   // TODO: Make this take std::string_view with a conversion to llvm::StringRef
   template<class T> auto
   call(const std::string &scriptName, const std::string &funName)
   -> std::conditional_t<std::is_same_v<T, void>, void, std::optional<T>>;
 
+  /// Call a function looked up by `resolve()`.
+  /// \tparam T The return type of the function.
+  /// \see call(const std::string &, const std::string &)
+  template<class T> auto call(const Handle &handle)
+  -> std::conditional_t<std::is_same_v<T, void>, void, std::optional<T>>;
+
+  /// Look up the given function from the given script, so that it can be
+  /// called repeatedly without being looked up each time. Like `call()`, this
+  /// generates the script's machine code if it is not being interpreted.
+  /// \returns An empty handle if the script or function does not exist.
+  [[nodiscard]] Handle
+  resolve(const std::string &scriptName, const std::string &funName);
+
   template<class Fun> void registerFunction(const std::string &funName);
 };
 
 template<class T> auto
 ScriptEngine::call(const std::string &scriptName, const std::string &funName)
 -> std::conditional_t<std::is_same_v<T, void>, void, std::optional<T>> {
-  auto addr{getFunctionAddr(scriptName, funName)};
+  return complete<T>(dispatch(scriptName, funName));
+}
+
+template<class T> auto ScriptEngine::call(const Handle &handle)
+-> std::conditional_t<std::is_same_v<T, void>, void, std::optional<T>> {
+  return complete<T>(dispatch(handle));
+}
+
+template<class T> auto ScriptEngine::complete(const Dispatch &target)
+-> std::conditional_t<std::is_same_v<T, void>, void, std::optional<T>> {
+  const auto *addr{std::get_if<llvm::JITTargetAddress>(&target)};
+  const auto *result{std::get_if<InterpretedResult>(&target)};
 
   if constexpr (std::is_same_v<T, void>) {
     if (!addr) return;
@@ -54,6 +189,7 @@ ScriptEngine::call(const std::string &scriptName, const std::string &funName)
     fun();
     return;
   } else {
+    if (result) return fromScriptWord<T>(result->word);
     if (!addr) return std::nullopt;
     std::uintptr_t addrPtr{*addr};
     auto fun{reinterpret_cast<T (*)()>(addrPtr)};
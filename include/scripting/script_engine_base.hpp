@@ -6,19 +6,72 @@
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace oo {
 
 class Jit;
 class LLVMVisitor;
 
+/// Convert a value passed to or returned from an external function into a
+/// 32-bit word, as used by the interpreter. Integers are sign extended to 32
+/// bits and floats are stored bit for bit.
+template<class Type> [[nodiscard]] uint32_t toScriptWord(Type value) noexcept {
+  if constexpr (std::is_same_v<Type, float>) {
+    uint32_t word{};
+    std::memcpy(&word, &value, sizeof(word));
+    return word;
+  } else {
+    return static_cast<uint32_t>(static_cast<int32_t>(value));
+  }
+}
+
+/// Inverse of `toScriptWord()`.
+template<class Type> [[nodiscard]] Type fromScriptWord(uint32_t word) noexcept {
+  if constexpr (std::is_same_v<Type, float>) {
+    float value{};
+    std::memcpy(&value, &word, sizeof(value));
+    return value;
+  } else {
+    return static_cast<Type>(static_cast<int32_t>(word));
+  }
+}
+
 /// Common internal functionality of ScriptEngine and ConsoleEngine.
 class ScriptEngineBase {
+ public:
+  /// Function calling the external function at the given address with the
+  /// given arguments, converted with `fromScriptWord()`, and returning its
+  /// return value converted with `toScriptWord()`. Used by the interpreter,
+  /// which does not know the types of the functions it calls at compile time.
+  using Invoker = uint32_t (*)(llvm::JITTargetAddress, const uint32_t *);
+
+  /// A registered external function.
+  struct ExternalFun {
+    std::string name{};
+    llvm::FunctionType *proto{};
+    Invoker invoke{};
+    /// Address of the function in the host process, or zero if it could not
+    /// be found.
+    llvm::JITTargetAddress addr{};
+  };
+
  private:
+  /// Function creating the prototype of an external function in the given
+  /// context. Prototypes are stored this way instead of as types so that
+  /// modules can be built in any context.
+  using ProtoGetter = llvm::FunctionType *(*)(llvm::LLVMContext &);
+
   std::unique_ptr<llvm::LLVMContext> mCtx{};
   std::unique_ptr<oo::Jit> mJit;
-  llvm::StringMap<llvm::FunctionType *> mExternFuns{};
+  llvm::StringMap<ProtoGetter> mExternFuns{};
+  llvm::StringMap<Invoker> mExternInvokers{};
   llvm::StringMap<llvm::orc::VModuleKey> mModules{};
 
  private:
@@ -27,20 +80,39 @@ class ScriptEngineBase {
 
   /// Convert a type from the AST into an LLVM type.
   // TODO: Treat references correctly
-  template<class Type> [[nodiscard]] llvm::Type *typeToLLVM();
+  template<class Type> [[nodiscard]] static llvm::Type *
+  typeToLLVM(llvm::LLVMContext &ctx);
 
   /// Create a prototype for a function returning Ret and taking Args as its
   /// arguments.
-  template<class Ret, class ... Args> [[nodiscard]] llvm::FunctionType *
-  makeProto(llvm::StringRef name, std::tuple<Args...> = {Args{}...});
+  template<class Ret, class ... Args> [[nodiscard]] static llvm::FunctionType *
+  makeProto(llvm::LLVMContext &ctx);
+
+  /// Return the `ProtoGetter` of a function returning Ret and taking Args as
+  /// its arguments.
+  template<class Ret, class ... Args> [[nodiscard]] static ProtoGetter
+  getProtoGetter(std::tuple<Args...>) noexcept;
+
+  /// Return the `Invoker` of a function returning Ret and taking Args as its
+  /// arguments.
+  template<class Ret, class ... Args> [[nodiscard]] static Invoker
+  getInvoker(std::tuple<Args...>) noexcept;
+
+  /// Call the function returning Ret and taking Args as its arguments at the
+  /// given address.
+  template<class Ret, class ... Args, std::size_t ... Is> static uint32_t
+  invoke(llvm::JITTargetAddress addr, const uint32_t *args,
+         std::index_sequence<Is...>);
 
  protected:
   [[nodiscard]] llvm::LLVMContext &getContext() noexcept;
 
   /// Declare all the registered external functions in the given module.
   /// This function can be run different modules, previously registered
-  /// functions are remembered.
-  void addExternalFunsToModule(llvm::Module *module);
+  /// functions are remembered. The module can belong to any context, and this
+  /// can be called concurrently with itself as long as no functions are being
+  /// registered.
+  void addExternalFunsToModule(llvm::Module *module) const;
 
   /// Register an internal (host process) function for use in all JIT'd modules.
   /// For example, if we have a function declaration
@@ -62,10 +134,37 @@ class ScriptEngineBase {
   [[nodiscard]] std::unique_ptr<llvm::Module>
   makeModule(llvm::StringRef moduleName);
 
+  /// Create a new empty module with the given name in the given context.
+  /// This can be called concurrently with itself.
+  [[nodiscard]] std::unique_ptr<llvm::Module>
+  makeModule(llvm::StringRef moduleName, llvm::LLVMContext &ctx) const;
+
   /// Take ownership of and JIT the given module.
   llvm::orc::VModuleKey jitModule(std::unique_ptr<llvm::Module> module);
 
-  /// Create a new LLVMVisitor for the given module.
+  /// Take ownership of and JIT the given module, which has already been
+  /// optimized by `oo::Jit::optimizeModule()`.
+  llvm::orc::VModuleKey
+  jitOptimizedModule(std::unique_ptr<llvm::Module> module);
+
+  /// Take ownership of the object code of a module previously JIT'd by this
+  /// engine, and store it under the given module name without compiling
+  /// anything. Returns false, storing nothing, if the object code is invalid.
+  bool jitObject(llvm::StringRef moduleName,
+                 std::unique_ptr<llvm::MemoryBuffer> object);
+
+  /// Return a description of the prototype of every registered external
+  /// function, ordered by name, which changes whenever the set of functions
+  /// that JIT'd modules can call does. The prototypes are created in `ctx`.
+  [[nodiscard]] std::string
+  getExternalFunsSignature(llvm::LLVMContext &ctx) const;
+
+  /// Return every registered external function, with prototypes created in
+  /// `ctx`, looking up their addresses in the host process.
+  [[nodiscard]] std::vector<ExternalFun>
+  getExternalFuns(llvm::LLVMContext &ctx) const;
+
+  /// Create a new LLVMVisitor for the given module, in the module's context.
   [[nodiscard]] oo::LLVMVisitor makeVisitor(llvm::Module *module);
 
   /// \overload makeVisitor(llvm::Module *)
@@ -100,25 +199,54 @@ class ScriptEngineBase {
 template<class Fun>
 void ScriptEngineBase::addExternalFun(llvm::StringRef name) {
   using T = function_traits<Fun>;
-  mExternFuns[name] = makeProto<typename T::result_t>(name,
-                                                      typename T::args_t{});
+  mExternFuns[name] = getProtoGetter<typename T::result_t>(
+      typename T::args_t{});
+  mExternInvokers[name] = getInvoker<typename T::result_t>(
+      typename T::args_t{});
+}
+
+template<class Ret, class ... Args> ScriptEngineBase::ProtoGetter
+ScriptEngineBase::getProtoGetter(std::tuple<Args...>) noexcept {
+  return &makeProto<Ret, Args...>;
+}
+
+template<class Ret, class ... Args> ScriptEngineBase::Invoker
+ScriptEngineBase::getInvoker(std::tuple<Args...>) noexcept {
+  return [](llvm::JITTargetAddress addr, const uint32_t *args) {
+    return invoke<Ret, Args...>(addr, args, std::index_sequence_for<Args...>{});
+  };
+}
+
+template<class Ret, class ... Args, std::size_t ... Is> uint32_t
+ScriptEngineBase::invoke(llvm::JITTargetAddress addr,
+                         [[maybe_unused]] const uint32_t *args,
+                         std::index_sequence<Is...>) {
+  auto *fun{reinterpret_cast<Ret (*)(Args...)>(
+      static_cast<std::uintptr_t>(addr))};
+  if constexpr (std::is_same_v<Ret, void>) {
+    fun(fromScriptWord<Args>(args[Is])...);
+    return 0u;
+  } else {
+    return toScriptWord<Ret>(fun(fromScriptWord<Args>(args[Is])...));
+  }
 }
 
 template<class Ret, class ... Args> llvm::FunctionType *
-ScriptEngineBase::makeProto(llvm::StringRef /*name*/, std::tuple<Args...>) {
-  std::array<llvm::Type *, sizeof...(Args)> args{typeToLLVM<Args>() ...};
-  return llvm::FunctionType::get(typeToLLVM<Ret>(), args, false);
+ScriptEngineBase::makeProto(llvm::LLVMContext &ctx) {
+  std::array<llvm::Type *, sizeof...(Args)> args{typeToLLVM<Args>(ctx) ...};
+  return llvm::FunctionType::get(typeToLLVM<Ret>(ctx), args, false);
 }
 
-template<class Type> llvm::Type *ScriptEngineBase::typeToLLVM() {
+template<class Type>
+llvm::Type *ScriptEngineBase::typeToLLVM(llvm::LLVMContext &ctx) {
   if constexpr (std::is_same_v<Type, short>) {
-    return llvm::Type::getInt16Ty(*mCtx);
+    return llvm::Type::getInt16Ty(ctx);
   } else if constexpr (std::is_same_v<Type, int>) {
-    return llvm::Type::getInt32Ty(*mCtx);
+    return llvm::Type::getInt32Ty(ctx);
   } else if constexpr (std::is_same_v<Type, uint32_t>) {
-    return llvm::Type::getInt32Ty(*mCtx);
+    return llvm::Type::getInt32Ty(ctx);
   } else if constexpr (std::is_same_v<Type, float>) {
-    return llvm::Type::getFloatTy(*mCtx);
+    return llvm::Type::getFloatTy(ctx);
   } else {
     static_assert(false_v<Type>, "Type must be an AstType");
     llvm_unreachable("Type must be an AstType");
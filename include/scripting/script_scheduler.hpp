@@ -0,0 +1,93 @@
+#ifndef OPENOBL_SCRIPT_SCHEDULER_HPP
+#define OPENOBL_SCRIPT_SCHEDULER_HPP
+
+#include "scripting/script_engine.hpp"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace oo {
+
+/// Runs a block of every script that is attached to a reference once per
+/// frame, profiling how long each script takes.
+///
+/// A compiled script is bound to a single implicit callee and has a single set
+/// of variables, so references are grouped by script and each script's block
+/// is run once per frame no matter how many references it is attached to.
+/// Running it again for each reference would only run the same callee against
+/// the same variables several times over. For references to have their own
+/// state, the script must be compiled separately, under a different name, for
+/// each of them. Each script's block is looked up once when it is first run,
+/// instead of being looked up by name on every call.
+///
+/// The scheduler must be destroyed before the `oo::ScriptEngine` it runs
+/// scripts from.
+class ScriptScheduler {
+ public:
+  /// Execution statistics of a script.
+  struct Profile {
+    std::string scriptName{};
+    /// Number of references the script is currently attached to.
+    std::size_t numRefs{};
+    /// Number of frames in which the script was run, which is also the number
+    /// of times its block was called.
+    uint64_t numFrames{};
+    /// Total time spent in the script's block.
+    std::chrono::nanoseconds totalTime{};
+    /// Longest time spent in the script's block in a single frame.
+    std::chrono::nanoseconds maxFrameTime{};
+  };
+
+ private:
+  struct Group {
+    std::vector<uint32_t> refs{};
+    ScriptEngine::Handle handle{};
+    /// Whether `handle` has been looked up, even if it was not found.
+    bool isResolved{false};
+    Profile profile{};
+  };
+
+  oo::ScriptEngine &mEngine;
+  std::string mBlockName;
+  std::vector<Group> mGroups{};
+
+  [[nodiscard]] Group *findGroup(const std::string &scriptName) noexcept;
+
+ public:
+  /// \param blockName The block of each script to run, such as `GameMode`.
+  explicit ScriptScheduler(oo::ScriptEngine &engine,
+                           std::string blockName = "GameMode");
+
+  /// Run the script with the given name for the given reference each frame.
+  /// The script need not have been compiled yet, but must be compiled before
+  /// `run()` is next called, or it will not be run until `invalidate()` is
+  /// called.
+  /// \returns `false`, and does nothing, if the reference is already attached
+  ///          to the script.
+  bool attach(const std::string &scriptName, uint32_t ref);
+
+  /// Stop running the script with the given name for the given reference.
+  void detach(const std::string &scriptName, uint32_t ref);
+
+  /// Stop running every script for every reference. Profiles are kept.
+  void detachAll();
+
+  /// Look up every script's block again when it is next run. This must be
+  /// called after recompiling any script that has references attached.
+  void invalidate() noexcept;
+
+  /// Run the block of every script that is attached to any reference.
+  void run();
+
+  /// Return the profiles of every script that has been attached, slowest
+  /// first.
+  [[nodiscard]] std::vector<Profile> getProfiles() const;
+
+  /// Clear the statistics of every script.
+  void resetProfiles() noexcept;
+};
+
+} // namespace oo
+
+#endif // OPENOBL_SCRIPT_SCHEDULER_HPP
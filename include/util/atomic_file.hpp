@@ -0,0 +1,71 @@
+#ifndef OPENOBL_ATOMIC_FILE_HPP
+#define OPENOBL_ATOMIC_FILE_HPP
+
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <system_error>
+
+/// \file
+/// Replacing files without readers ever seeing them partially written.
+
+namespace oo {
+
+/// Return a path next to `path` to write to before renaming it over `path`,
+/// unique to this call so that concurrent writes of the same file do not
+/// collide.
+inline std::filesystem::path
+getTemporaryPath(const std::filesystem::path &path) {
+  thread_local static std::random_device rd{};
+  thread_local static std::mt19937_64 gen{rd()};
+
+  std::array<char, 22> suffix{};
+  std::snprintf(suffix.data(), suffix.size(), ".%016llx.tmp",
+                static_cast<unsigned long long>(gen()));
+  auto tmpPath{path};
+  tmpPath += suffix.data();
+  return tmpPath;
+}
+
+/// Replace the file at `path` with the bytes that `write` writes to the
+/// `std::ostream &` it is given.
+///
+/// The bytes are written to a temporary file from `getTemporaryPath()` which
+/// is then renamed over `path`, so that another thread or process reading
+/// `path` sees either the old file or the new one, but never part of the new
+/// one. If writing or renaming fails, including if `write` throws, then the
+/// temporary file is removed and `path` is left as it was.
+/// \returns Whether `path` was replaced.
+/// \throws Anything thrown by `write`.
+template<class F>
+bool writeFileAtomically(const std::filesystem::path &path, F &&write) {
+  const auto tmpPath{getTemporaryPath(path)};
+  std::error_code ec{};
+
+  try {
+    std::ofstream os(tmpPath, std::ios_base::binary | std::ios_base::trunc);
+    if (os) write(static_cast<std::ostream &>(os));
+    os.close();
+    if (!os) {
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+  } catch (...) {
+    std::filesystem::remove(tmpPath, ec);
+    throw;
+  }
+
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmpPath, ec);
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace oo
+
+#endif // OPENOBL_ATOMIC_FILE_HPP
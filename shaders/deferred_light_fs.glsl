@@ -3,6 +3,7 @@
 #define POINT_LIGHT 0
 #define DIRECTIONAL_LIGHT 1
 #define SPOT_LIGHT 2
+#define CLUSTERED_LIGHTS 3
 
 uniform mat4 viewProjInv;
 uniform mat4 proj;
@@ -15,12 +16,53 @@ uniform vec4 lightPosition;
 #elif LIGHT_TYPE == DIRECTIONAL_LIGHT
 uniform vec4 lightDirection;
 #endif
+
+#ifdef SUN_SHADOWS
+// Must match oo::SunShadows::MAX_CASCADES.
+#define MAX_CASCADES 4
+
+// Shadow maps of every cascade side by side, finest first, holding the depth
+// of the nearest caster. See oo::SunShadows.
+uniform sampler2D ShadowMap;
+// Transformation from world space to the clip space of each shadow camera.
+uniform mat4 shadowViewProj[MAX_CASCADES];
+// Size of a shadow map texel in world units in each cascade, or zero if the
+// cascade has not been drawn.
+uniform vec4 shadowTexelSizes;
+// Number of cascades, reciprocal of the size of one cascade's shadow map in
+// texels, view depth beyond which there are no shadows.
+uniform vec4 shadowParams;
+
+// Distance in texels that positions are moved along their normal before being
+// looked up, so that surfaces do not shadow themselves.
+const float NORMAL_OFFSET = 1.5f;
+// Constant depth bias, as a fraction of the depth range of a shadow camera.
+const float DEPTH_BIAS = 0.0002f;
+// Fraction of the shadow distance over which shadows fade out.
+const float SHADOW_FADE = 0.1f;
+#endif
+
+#if LIGHT_TYPE == CLUSTERED_LIGHTS
+// See oo::LightClusterGrid for the layout of these textures.
+uniform sampler2D LightData;
+uniform sampler2D ClusterData;
+uniform sampler2D LightIndices;
+
+uniform mat4 clusterView;
+// Entries [0][0], [1][1], [0][2], [1][2] of the projection matrix.
+uniform vec4 clusterProj;
+// Number of tiles in x and y, number of slices, width of LightIndices.
+uniform vec4 clusterDims;
+// Scale and bias converting the logarithm of a view depth into a slice.
+uniform vec4 clusterSlice;
+#else
 uniform vec4 lightDiffuseCol;
 uniform vec4 lightAttenuation;
+#endif
 
 uniform vec3 ViewPos;
 
-#if LIGHT_TYPE == DIRECTIONAL_LIGHT
+#if LIGHT_TYPE == DIRECTIONAL_LIGHT || LIGHT_TYPE == CLUSTERED_LIGHTS
 in vec2 TexCoord;
 #else
 in vec4 ScreenPos;
@@ -28,10 +70,71 @@ in vec4 ScreenPos;
 
 out vec4 FragColor;
 
-void main() {
-    float gamma = 2.2f;
+const float gamma = 2.2f;
 
-    #if LIGHT_TYPE == DIRECTIONAL_LIGHT
+vec3 shade(vec3 normal, vec3 viewDir, vec3 albedo, float specular,
+           float shininess, vec3 lightDir, vec3 lightCol, float atten) {
+    vec3 reflectDir = reflect(-lightDir, normal);
+
+    float diff = max(dot(normal, lightDir), 0.0f);
+    vec3 diffCol = diff * lightCol * albedo;
+
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0f), 8 * shininess);
+    vec3 specCol = specular * spec * lightCol;
+
+    return (specCol + diffCol) * atten;
+}
+
+#ifdef SUN_SHADOWS
+// Return the fraction of the sun's light that reaches worldPos, using the
+// finest cascade that covers it.
+float sunShadow(vec3 worldPos, vec3 normal, float viewDepth) {
+    int numCascades = int(shadowParams.x);
+    float texel = shadowParams.y;
+    for (int i = 0; i < numCascades; ++i) {
+        if (shadowTexelSizes[i] <= 0.0f) continue;
+
+        float offset = shadowTexelSizes[i] * NORMAL_OFFSET;
+        vec4 lightPos = shadowViewProj[i] * vec4(worldPos + normal * offset,
+                                                 1.0f);
+        vec3 coord = lightPos.xyz / lightPos.w * 0.5f + 0.5f;
+
+        // Leave room at the edges of the cascade for the filter.
+        float margin = 2.0f * texel;
+        if (any(lessThan(coord, vec3(margin, margin, 0.0f)))
+            || any(greaterThan(coord, vec3(1.0f - margin, 1.0f - margin,
+                                           1.0f)))) {
+            continue;
+        }
+
+        // 3x3 percentage closer filter.
+        vec2 atlasCoord = vec2((coord.x + float(i)) / float(numCascades),
+                               coord.y);
+        vec2 atlasTexel = vec2(texel / float(numCascades), texel);
+        float lit = 0.0f;
+        for (int x = -1; x <= 1; ++x) {
+            for (int y = -1; y <= 1; ++y) {
+                vec2 tap = atlasCoord + vec2(float(x), float(y)) * atlasTexel;
+                float casterDepth = texture(ShadowMap, tap).x;
+                lit += coord.z - DEPTH_BIAS <= casterDepth ? 1.0f : 0.0f;
+            }
+        }
+        lit /= 9.0f;
+
+        // Fade out towards the shadow distance instead of stopping abruptly.
+        float fadeStart = shadowParams.z * (1.0f - SHADOW_FADE);
+        float fade = clamp((viewDepth - fadeStart)
+                           / (shadowParams.z * SHADOW_FADE), 0.0f, 1.0f);
+        return mix(lit, 1.0f, fade);
+    }
+
+    return 1.0f;
+}
+#endif
+
+void main() {
+    #if LIGHT_TYPE == DIRECTIONAL_LIGHT || LIGHT_TYPE == CLUSTERED_LIGHTS
     vec2 uv = TexCoord;
     #else
     vec4 homScreenPos = (ScreenPos / ScreenPos.w);
@@ -51,7 +154,7 @@ void main() {
     // Recreate world position from depth. Thanks OpenGL wiki!
     float depth = texture(Tex0, uv).x;
     vec3 ndc;
-    #if LIGHT_TYPE == DIRECTIONAL_LIGHT
+    #if LIGHT_TYPE == DIRECTIONAL_LIGHT || LIGHT_TYPE == CLUSTERED_LIGHTS
     ndc.xy = 2.0f * uv - 1.0f;
     #else
     ndc.xy = homScreenPos.xy;
@@ -68,9 +171,55 @@ void main() {
 
     vec3 viewDir = normalize(ViewPos - worldPos);
 
+    #if LIGHT_TYPE == CLUSTERED_LIGHTS
+    // Find the cluster containing this pixel in the same way that the CPU
+    // assigned lights to clusters.
+    vec3 viewPos = (clusterView * vec4(worldPos, 1.0f)).xyz;
+    float viewDepth = -viewPos.z;
+    vec2 clusterNdc = (clusterProj.xy * viewPos.xy
+                       + clusterProj.zw * viewPos.z) / viewDepth;
+    ivec2 tile = ivec2(floor((clusterNdc * 0.5f + 0.5f) * clusterDims.xy));
+    tile = clamp(tile, ivec2(0), ivec2(clusterDims.xy) - 1);
+    int slice = int(floor(log(viewDepth) * clusterSlice.x + clusterSlice.y));
+    slice = clamp(slice, 0, int(clusterDims.z) - 1);
+
+    ivec2 clusterTexel = ivec2(tile.x + tile.y * int(clusterDims.x), slice);
+    vec2 cluster = texelFetch(ClusterData, clusterTexel, 0).xy;
+    int offset = int(cluster.x);
+    int count = int(cluster.y);
+    int indexWidth = int(clusterDims.w);
+
+    vec3 finalCol = vec3(0.0f);
+    for (int i = 0; i < count; ++i) {
+        int index = offset + i;
+        ivec2 indexTexel = ivec2(index % indexWidth, index / indexWidth);
+        int light = int(texelFetch(LightIndices, indexTexel, 0).x);
+
+        vec4 lightPosRange = texelFetch(LightData, ivec2(light, 0), 0);
+        vec3 toLight = lightPosRange.xyz - worldPos;
+        float lightDist = length(toLight);
+        if (lightDist > lightPosRange.w) continue;
+
+        vec3 lightCol = texelFetch(LightData, ivec2(light, 1), 0).rgb;
+        vec3 lightAtten = texelFetch(LightData, ivec2(light, 2), 0).xyz;
+        float atten = 1.0f / (lightAtten.x
+        + lightAtten.y * lightDist
+        + lightAtten.z * lightDist * lightDist);
+
+        finalCol += shade(normal, viewDir, albedo.rgb, specular, shininess,
+                          toLight / lightDist, pow(lightCol, vec3(gamma)),
+                          atten);
+    }
+    #else
     #if LIGHT_TYPE == DIRECTIONAL_LIGHT
     vec3 lightDir = lightDirection.xyz;
     float atten = 1.0f;
+    #ifdef SUN_SHADOWS
+    // Surfaces facing away from the sun are unlit anyway.
+    if (dot(normal, lightDir) > 0.0f) {
+        atten = sunShadow(worldPos, normal, clipPos.w);
+    }
+    #endif
     #else
     float lightDist = length(lightPosition.xyz - worldPos);
     vec3 lightDir = (lightPosition.xyz - worldPos) / lightDist;
@@ -79,17 +228,11 @@ void main() {
     + lightAttenuation.w * lightDist * lightDist);
     #endif
 
-    vec3 reflectDir = reflect(-lightDir, normal);
-
     vec3 lightCol = pow(lightDiffuseCol.rgb, vec3(gamma));
 
-    float diff = max(dot(normal, lightDir), 0.0f);
-    vec3 diffCol = diff * lightCol * albedo.rgb;
-
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0f), 8 * shininess);
-    vec3 specCol = specular * spec * lightCol;
+    vec3 finalCol = shade(normal, viewDir, albedo.rgb, specular, shininess,
+                          lightDir, lightCol, atten);
+    #endif
 
-    vec3 finalCol = (specCol + diffCol) * atten;
     FragColor = vec4(finalCol, 0.0f);
 }
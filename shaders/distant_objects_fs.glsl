@@ -0,0 +1,25 @@
+#version 330 core
+in vec2 TexCoord;
+in vec3 Normal;
+
+uniform sampler2D diffuseMap;
+
+layout (location = 0) out vec2 gDepth;
+layout (location = 1) out vec4 gNormalSpec;
+layout (location = 2) out vec4 gAlbedo;
+
+void main() {
+    float gamma = 2.2f;
+
+    // Convert texture to linear space
+    vec3 albedo = pow(texture(diffuseMap, TexCoord).rgb, vec3(gamma));
+
+    // Distant objects are too small on screen to be worth normal mapping.
+    gNormalSpec.xyz = normalize(Normal);
+    gNormalSpec.w = 0.0f;
+
+    gDepth.x = gl_FragCoord.z;
+    gDepth.y = 0.0f;
+
+    gAlbedo = vec4(albedo, 30.0f);
+}
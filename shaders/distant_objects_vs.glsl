@@ -0,0 +1,32 @@
+#version 330 core
+in vec4 vertex;
+in vec3 normal;
+in vec4 uv0;
+in vec4 uv1;
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+uniform mat4 worldViewProj;
+uniform mat4 world;
+// Inclusive bounds (x0, y0, x1, y1) of the cells in the near neighbourhood,
+// whose references are loaded in full.
+uniform vec4 nearBounds;
+
+void main() {
+    // The second texture coordinate is the index of the cell that the vertex's
+    // reference is in. Every vertex of a triangle belongs to the same reference,
+    // so moving them all to the same point collapses the triangle and nothing
+    // is drawn.
+    vec2 cell = uv1.xy;
+    if (all(greaterThanEqual(cell, nearBounds.xy))
+        && all(lessThanEqual(cell, nearBounds.zw))) {
+        gl_Position = vec4(0.0f);
+    } else {
+        gl_Position = worldViewProj * vertex;
+    }
+
+    TexCoord = uv0.xy;
+    // Chunks are only ever translated.
+    Normal = normalize(mat3(world) * normal);
+}
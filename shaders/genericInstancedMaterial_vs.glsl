@@ -0,0 +1,43 @@
+#version 330 core
+in vec4 vertex;
+in vec3 normal;
+in vec4 colour;
+in vec4 uv0;
+in vec4 uv1;// instance[0]
+in vec4 uv2;// instance[1]
+in vec4 uv3;// instance[2]
+in vec3 tangent;
+in vec3 binormal;
+
+out mat3 TBN;
+out vec2 TexCoord;
+out vec3 FragPos;
+out vec3 VertexCol;
+
+uniform mat4 viewProj;
+uniform mat4 world;
+
+void main() {
+    // Transpose of the per-instance transformation
+    mat4 instance;
+    instance[0] = uv1;
+    instance[1] = uv2;
+    instance[2] = uv3;
+    instance[3] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    mat4 model = world * transpose(instance);
+    vec4 worldPos = model * vertex;
+    gl_Position = viewProj * worldPos;
+
+    // Instances are only scaled uniformly, so the inverse transpose of the
+    // model matrix is a multiple of the model matrix, which normalization
+    // takes care of.
+    mat3 normalMatrix = mat3(model);
+    vec3 T = normalize(normalMatrix * tangent);
+    vec3 B = normalize(normalMatrix * binormal);
+    vec3 N = normalize(normalMatrix * normal);
+    TBN = mat3(T, B, N);
+    TexCoord = uv0.xy;
+    FragPos = vec3(worldPos);
+    VertexCol = colour.rgb;
+}
\ No newline at end of file
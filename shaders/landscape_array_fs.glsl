@@ -0,0 +1,132 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 ViewPos;
+
+layout (location = 0) out vec2 gDepth;
+layout (location = 1) out vec4 gNormalSpec;
+layout (location = 2) out vec4 gAlbedo;
+
+// Diffuse and normal textures of every terrain layer.
+uniform sampler2DArray diffuseArray;
+uniform sampler2DArray normalArray;
+
+// Atlases shared by every quad, see oo::TerrainTextureArray. At each vertex,
+// the layer atlas gives the array layers of up to four layers and the weight
+// atlas gives their weights.
+uniform sampler2D layerAtlas;
+uniform sampler2D weightAtlas;
+uniform sampler2D normalAtlas;
+uniform sampler2D vertexColorAtlas;
+
+uniform float quadWorldSize;
+uniform int atlasQuads;
+
+const int VERTICES_PER_QUAD = 17;
+// Maximum number of distinct layers blended at a single fragment.
+const int MAX_LAYERS = 8;
+
+void main() {
+    float gamma = 2.2f;
+
+    // Position in units of quads. The terrain group's origin is chosen so that
+    // the integer part is the terrain slot of the quad, and the fractional part
+    // is the position in the quad, equal to the flipped texCoord used by
+    // landscape_fs.glsl.
+    vec2 slot = vec2(FragPos.x, -FragPos.z) / quadWorldSize;
+    vec2 quad = floor(slot);
+    vec2 texCoord = slot - quad;
+
+    // Find the quad's block in the atlases by wrapping its slot around them.
+    ivec2 block = ((ivec2(quad) % atlasQuads) + atlasQuads) % atlasQuads;
+    block *= VERTICES_PER_QUAD;
+    vec2 vertex = texCoord * float(VERTICES_PER_QUAD - 1);
+    vec2 atlasCoord = (vec2(block) + vertex + 0.5f)
+        / float(atlasQuads * VERTICES_PER_QUAD);
+
+    // Terrain normal is given by a texture. Note that this is not the normal
+    // map, it is the physics vertex normal.
+    vec3 normal = normalize(texture(normalAtlas, atlasCoord).xyz);
+    // Construct an ONB as in landscape_fs.glsl.
+    vec3 tangent = vec3(1.0f, 0.0f, 0.0f);
+    vec3 binormal = normalize(cross(normal, tangent));
+    tangent = cross(binormal, normal);
+    mat3 TBN = mat3(tangent, binormal, normal);
+
+    vec3 vertexCol = texture(vertexColorAtlas, atlasCoord).xyz;
+
+    // Bilinearly blend the layers of the four surrounding vertices. Layer
+    // indices cannot be filtered, so fetch each vertex and merge the weights
+    // of layers they have in common.
+    ivec2 v0 = min(ivec2(vertex), ivec2(VERTICES_PER_QUAD - 2));
+    vec2 t = vertex - vec2(v0);
+
+    int layers[MAX_LAYERS];
+    float weights[MAX_LAYERS];
+    int numLayers = 0;
+    for (int c = 0; c < 4; ++c) {
+        ivec2 offset = ivec2(c & 1, c >> 1);
+        vec2 b = mix(1.0f - t, t, vec2(offset));
+        float vertexWeight = b.x * b.y;
+        if (vertexWeight <= 0.0f) continue;
+
+        ivec2 texel = block + v0 + offset;
+        ivec4 index = ivec4(texelFetch(layerAtlas, texel, 0) * 255.0f + 0.5f);
+        vec4 w = texelFetch(weightAtlas, texel, 0) * vertexWeight;
+        for (int k = 0; k < 4; ++k) {
+            if (w[k] <= 0.0f) continue;
+            int j = 0;
+            while (j < numLayers && layers[j] != index[k]) ++j;
+            if (j == numLayers) {
+                if (numLayers == MAX_LAYERS) continue;
+                layers[j] = index[k];
+                weights[j] = 0.0f;
+                ++numLayers;
+            }
+            weights[j] += w[k];
+        }
+    }
+
+    // Scale uv so textures are repeated every grid square, not every quadrant.
+    // Using the slot instead of the texCoord makes no difference to the result,
+    // since they differ by a whole number of repeats.
+    vec2 uv = slot * 17.0f;
+    // The number of layers sampled varies between fragments, so derivatives
+    // must be taken outside of the loop.
+    vec2 uvDx = dFdx(uv);
+    vec2 uvDy = dFdy(uv);
+
+    vec3 diffuseColor = vec3(0.0f);
+    vec4 n = vec4(0.0f);
+    float totalWeight = 0.0f;
+    for (int j = 0; j < numLayers; ++j) {
+        vec3 coord = vec3(uv, float(layers[j]));
+        // Undo gamma correction of textures so it is correct later
+        vec3 dc = pow(textureGrad(diffuseArray, coord, uvDx, uvDy).rgb,
+                      vec3(gamma));
+        vec4 nc = textureGrad(normalArray, coord, uvDx, uvDy);
+        nc.w = (floor(nc.w * 255.0) == 255 ? 0.0f : nc.w);
+
+        diffuseColor += weights[j] * dc;
+        n += weights[j] * nc;
+        totalWeight += weights[j];
+    }
+    totalWeight = max(totalWeight, 1e-5f);
+    diffuseColor = diffuseColor / totalWeight * vertexCol;
+    n /= totalWeight;
+
+    // Convert from dx to gl by flipping the green channel
+    n.y = 1.0f - n.y;
+    // Transform normal from [0, 1] -> [-1, 1]
+    n.xyz = normalize(n.xyz * 2.0f - 1.0f);
+    // Transform normal into world space
+    gNormalSpec.xyz = normalize(TBN * n.xyz);
+    gNormalSpec.w = n.w;
+
+    gDepth.x = gl_FragCoord.z;
+    gDepth.y = 0.0f;
+
+    // TODO: Use LTEX specular. All of them seem to use 30.0f though.
+    gAlbedo = vec4(diffuseColor, 30.0f);
+}
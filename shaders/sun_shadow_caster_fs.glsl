@@ -0,0 +1,9 @@
+#version 330 core
+
+out float Depth;
+
+void main() {
+    // Shadow cameras are orthographic, so this is linear in the distance from
+    // the sun.
+    Depth = gl_FragCoord.z;
+}
\ No newline at end of file
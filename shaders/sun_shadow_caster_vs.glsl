@@ -0,0 +1,29 @@
+#version 330 core
+in vec4 vertex;
+
+#ifdef INSTANCED
+in vec4 uv1;// instance[0]
+in vec4 uv2;// instance[1]
+in vec4 uv3;// instance[2]
+
+uniform mat4 viewProj;
+uniform mat4 world;
+#else
+uniform mat4 worldViewProj;
+#endif
+
+void main() {
+    #ifdef INSTANCED
+    // Transpose of the per-instance transformation, as in
+    // genericInstancedMaterial_vs.glsl.
+    mat4 instance;
+    instance[0] = uv1;
+    instance[1] = uv2;
+    instance[2] = uv3;
+    instance[3] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    gl_Position = viewProj * world * transpose(instance) * vertex;
+    #else
+    gl_Position = worldViewProj * vertex;
+    #endif
+}
\ No newline at end of file
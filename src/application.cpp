@@ -11,9 +11,12 @@
 #include "gui/menu.hpp"
 #include "initial_record_visitor.hpp"
 #include "job/job.hpp"
+#include "job/upload_queue.hpp"
 #include "math/conversions.hpp"
 #include "mesh/entity.hpp"
+#include "mesh/instanced_geometry.hpp"
 #include "mesh/mesh_manager.hpp"
+#include "mesh/static_batch.hpp"
 #include "mesh/subentity.hpp"
 #include "nifloader/collision_object_loader.hpp"
 #include "nifloader/logging.hpp"
@@ -26,6 +29,7 @@
 #include "ogre/spdlog_listener.hpp"
 #include "ogre/terrain_material_generator.hpp"
 #include "ogre/window.hpp"
+#include "ogrebullet/bvh_cache.hpp"
 #include "ogrebullet/conversions.hpp"
 #include "ogreimgui/imgui_manager.hpp"
 #include "resolvers/acti_resolver.hpp"
@@ -41,6 +45,7 @@
 #include "script_functions.hpp"
 #include "scripting/console_engine.hpp"
 #include "scripting/script_engine.hpp"
+#include "scripting/script_scheduler.hpp"
 #include "sdl/sdl.hpp"
 #include "util/meta.hpp"
 #include "util/settings.hpp"
@@ -101,6 +106,11 @@ Application::Application(std::string windowName) : FrameListener() {
     ctx.bulletConf = std::make_unique<bullet::Configuration>();
   });
 
+  // Enable the collision BVH cache before anything loads a collision shape
+  const std::string collisionCachePath{
+      gameSettings.get("General.sCollisionCachePath", "cache/collision")};
+  Ogre::BvhCache::setDirectory(collisionCachePath);
+
   // Set up the deferred rendering
   auto &compMgr{Ogre::CompositorManager::getSingleton()};
   compMgr.registerCustomCompositionPass("DeferredLight",
@@ -124,9 +134,19 @@ Application::Application(std::string windowName) : FrameListener() {
   });
 
   // Star the scripting backend
-  oo::JobManager::runJob([this]() {
+  oo::JobManager::runJob([this, &gameSettings]() {
     ctx.scriptEngine = std::make_unique<oo::ScriptEngine>();
     registerScriptFunctions();
+
+    // Script cache entries depend on the registered functions, so only enable
+    // the cache once they are all registered.
+    ctx.scriptEngine->setCacheDirectory(
+        gameSettings.get("General.sScriptCachePath", "cache/scripts"));
+    ctx.scriptEngine->setJitThreshold(
+        gameSettings.get("General.uScriptJitThreshold", 8u));
+
+    ctx.scriptScheduler = std::make_unique<oo::ScriptScheduler>(
+        *ctx.scriptEngine);
   });
 
   // Add the resource managers
@@ -147,6 +167,13 @@ Application::Application(std::string windowName) : FrameListener() {
     ctx.entityFactory = std::make_unique<oo::EntityFactory>();
     ctx.ogreRoot->addMovableObjectFactory(ctx.entityFactory.get());
 
+    ctx.staticBatchFactory = std::make_unique<oo::StaticBatchFactory>();
+    ctx.ogreRoot->addMovableObjectFactory(ctx.staticBatchFactory.get());
+
+    ctx.instancedGeometryFactory
+        = std::make_unique<oo::InstancedGeometryFactory>();
+    ctx.ogreRoot->addMovableObjectFactory(ctx.instancedGeometryFactory.get());
+
     ctx.lightFactory = std::make_unique<oo::DeferredLightFactory>();
     ctx.ogreRoot->addMovableObjectFactory(ctx.lightFactory.get());
 
@@ -207,6 +234,25 @@ Application::Application(std::string windowName) : FrameListener() {
   // Shaders are not stored in the data folder (mostly for vcs reasons)
   resGrpMgr.addResourceLocation("./shaders", "FileSystem", oo::SHADER_GROUP);
 
+  // Stream the mip levels of textures according to how much of them is visible
+  if (gameSettings.get("Display.bTextureStreaming", true)) {
+    const std::size_t budgetMiB{
+        gameSettings.get("Display.uTextureBudget", 512u)};
+    ctx.textureStreamer = std::make_unique<oo::TextureStreamer>(
+        budgetMiB * 1024u * 1024u,
+        gameSettings.get("Display.uTextureMinSize", 64u));
+    Ogre::ResourceGroupManager::getSingleton()
+        .setLoadingListener(ctx.textureStreamer.get());
+  }
+
+  // Cull objects hidden behind large static geometry on the CPU
+  if (gameSettings.get("Display.bOcclusionCulling", true)) {
+    ctx.occlusionCuller = std::make_unique<oo::OcclusionCuller>(
+        gameSettings.get("Display.uOcclusionBufferWidth", 256u),
+        gameSettings.get("Display.uOcclusionBufferHeight", 128u),
+        gameSettings.get("Display.uMaxOccluders", 64u));
+  }
+
   // Register the BSA archive format
   auto &archiveMgr = Ogre::ArchiveManager::getSingleton();
   ctx.bsaArchiveFactory = std::make_unique<Ogre::BsaArchiveFactory>();
@@ -234,6 +280,20 @@ Application::Application(std::string windowName) : FrameListener() {
   // Need managers before adding resources
   oo::JobManager::waitOn(&managersAndFactoriesCounter);
 
+  // Shadow the sun with cascaded shadow maps
+  if (gameSettings.get("Display.bSunShadows", true)) {
+    ctx.sunShadows = std::make_unique<oo::SunShadows>(
+        gameSettings.get("Display.uShadowCascades", 3u),
+        gameSettings.get("Display.uShadowMapSize", 1024u),
+        gameSettings.get("Display.fShadowDistance", 150.0f),
+        gameSettings.get("Display.fShadowSplitLambda", 0.8f),
+        gameSettings.get("Display.bShadowBudget", true),
+        gameSettings.get("Display.uShadowCascadeUpdates", 1u));
+    ctx.sunShadows->addCasterType(ctx.entityFactory->getType());
+    ctx.sunShadows->addCasterType(ctx.staticBatchFactory->getType());
+    ctx.sunShadows->addCasterType(ctx.instancedGeometryFactory->getType());
+  }
+
   // The bsa files need to be explicitly loaded before being added as resource
   // locations in order to guarantee thread safety.
   for (const auto &bsa : bsaFilenames) {
@@ -480,6 +540,18 @@ void Application::setTerrainOptions() {
   options->setDefaultMaterialGenerator(
       std::make_shared<oo::TerrainMaterialGenerator>());
   options->setLayerBlendMapSize(oo::verticesPerQuad<uint16_t>);
+
+  // Draw every terrain quad with a single material using texture arrays. Far
+  // terrain shares the atlases with near terrain, so they need to be wider
+  // than whichever neighbourhood is larger.
+  if (gameSettings.get("Display.bTerrainTextureArrays", false)) {
+    const auto farDiameter{gameSettings.get<unsigned int>(
+        "General.uGridDistantCount", 5)};
+    ctx.terrainTextureArray = std::make_unique<oo::TerrainTextureArray>(
+        gameSettings.get("Display.uTerrainLayerSize", 512u),
+        gameSettings.get("Display.uTerrainMaxLayers", 64u),
+        oo::TerrainTextureArray::getAtlasQuads(nearDiameter, farDiameter));
+  }
 }
 
 std::vector<oo::Path>
@@ -646,6 +718,12 @@ void Application::registerConsoleFunctions() {
   rcf("ShowMap", &console::ShowMap);
   rcf("ShowRaceMenu", &console::ShowRaceMenu);
   rcf("ShowSpellmaking", &console::ShowSpellmaking);
+  rcf("InstancingStressTest", &console::InstancingStressTest);
+  rcf("LightingStressTest", &console::LightingStressTest);
+  rcf("BuildDistantObjects", &console::BuildDistantObjects);
+  rcf("ShowScriptProfile", &console::ShowScriptProfile);
+  rcf("ssp", &console::ssp);
+  rcf("ResetScriptProfile", &console::ResetScriptProfile);
   rcf("print", &console::print);
   rcf("GetCurrentTime", &script::GetCurrentTime);
 }
@@ -739,6 +817,10 @@ bool Application::frameStarted(const Ogre::FrameEvent &event) {
 
   ctx.getMusicManager().update(event.timeSinceLastFrame);
 
+  // Finish the physics step begun at the end of the last frame before anything
+  // gets a chance to look at the physics world.
+  if (isGameModeInStack()) getGameModeInStack().waitForPhysics();
+
   pollEvents();
   if (modeStack.empty()) {
     quit();
@@ -757,6 +839,17 @@ bool Application::frameStarted(const Ogre::FrameEvent &event) {
     deferredMode.reset();
   }
 
+  // Choose which texture mip levels should be resident given what was visible
+  // last frame, starting to stream in or out any that changed.
+  if (ctx.textureStreamer) ctx.textureStreamer->update();
+
+  // Upload resources and run render commands prepared by the worker threads,
+  // without spending so long doing so that the frame rate drops noticeably.
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  using fMillisecond = chrono::duration<float, chrono::milliseconds::period>;
+  oo::UploadQueue::drain(fMillisecond(
+      gameSettings.get("General.fUploadBudget", 2.0f)));
+
   // Keep yielding to other render fibers until we run out of time or exceed
   // some number of yields. This allows jobs that yield multiple times during
   // their execution to complete within a single frame, instead of having only
@@ -773,6 +866,13 @@ bool Application::frameStarted(const Ogre::FrameEvent &event) {
 }
 
 bool Application::frameRenderingQueued(const Ogre::FrameEvent &/*event*/) {
+  // Step the physics world while the GPU is busy and the buffers are swapped;
+  // the step is finished at the start of the next frame.
+  if (!modeStack.empty()) {
+    if (auto *gameMode{std::get_if<oo::GameMode>(&modeStack.back())}) {
+      gameMode->beginPhysicsStep();
+    }
+  }
   return true;
 }
 
@@ -5,7 +5,9 @@
 #include "controls.hpp"
 #include "esp/esp_coordinator.hpp"
 #include "mesh/entity.hpp"
+#include "mesh/instanced_geometry.hpp"
 #include "mesh/mesh_manager.hpp"
+#include "mesh/static_batch.hpp"
 #include "mesh/subentity.hpp"
 #include "nifloader/mesh_loader.hpp"
 #include "nifloader/nif_resource_manager.hpp"
@@ -25,6 +27,7 @@
 #include "resolvers/wrld_resolver.hpp"
 #include "scripting/console_engine.hpp"
 #include "scripting/script_engine.hpp"
+#include "scripting/script_scheduler.hpp"
 #include <OgreCamera.h>
 #include <OgreCompositorInstance.h>
 #include <OgreCompositorManager.h>
@@ -33,12 +36,15 @@ namespace oo {
 
 ApplicationContext::ApplicationContext()
     : entityFactory{},
+      staticBatchFactory{},
+      instancedGeometryFactory{},
       lightFactory{},
       scnMgrFactory{},
       deferredLightPass{std::make_unique<oo::DeferredLightPass>()},
       musicMgr{},
       consoleEngine{},
       scriptEngine{},
+      scriptScheduler{},
       nifLoader{std::make_unique<oo::MeshLoader>()},
       nifCollisionLoader{std::make_unique<oo::CollisionObjectLoader>()},
       skeletonLoader{std::make_unique<oo::SkeletonLoader>()},
@@ -115,6 +121,10 @@ oo::ScriptEngine &ApplicationContext::getScriptEngine() {
   return *scriptEngine;
 }
 
+oo::ScriptScheduler &ApplicationContext::getScriptScheduler() {
+  return *scriptScheduler;
+}
+
 oo::MusicManager &ApplicationContext::getMusicManager() {
   return *musicMgr;
 }
@@ -149,8 +159,13 @@ void ApplicationContext::setCamera(gsl::not_null<Ogre::Camera *> camera) {
   auto *scnMgr{camera->getSceneManager()};
   if (auto *dScnMgr{dynamic_cast<oo::DeferredSceneManager *>(scnMgr)}) {
     deferred->addListener(dScnMgr->getFogListener());
+    const auto &gameSettings{oo::GameSettings::getSingleton()};
+    dScnMgr->setClusteredLightingEnabled(
+        gameSettings.get("Display.bClusteredLighting", true));
   }
   deferred->setEnabled(true);
+
+  if (sunShadows) sunShadows->setCamera(camera.get());
 }
 
 } // namespace oo
\ No newline at end of file
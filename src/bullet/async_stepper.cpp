@@ -0,0 +1,110 @@
+#include "bullet/async_stepper.hpp"
+#include "util/settings.hpp"
+#include <spdlog/spdlog.h>
+#include <chrono>
+
+namespace bullet {
+
+AsyncStepper::AsyncStepper() : mThread([this]() { run(); }) {}
+
+AsyncStepper::~AsyncStepper() {
+  {
+    std::unique_lock lock{mMutex};
+    mCv.wait(lock, [this]() { return !mPending; });
+    mQuit = true;
+  }
+  mCv.notify_all();
+  mThread.join();
+}
+
+void AsyncStepper::beginStep(gsl::not_null<btDiscreteDynamicsWorld *> world,
+                             float delta, int maxSubSteps) {
+  {
+    std::scoped_lock lock{mMutex};
+    mWorld = world;
+    mDelta = delta;
+    mMaxSubSteps = maxSubSteps;
+    mPending = true;
+    mStepping = true;
+  }
+  mCv.notify_all();
+}
+
+void AsyncStepper::wait() {
+  {
+    std::unique_lock lock{mMutex};
+    if (!mStepping) return;
+    mCv.wait(lock, [this]() { return !mPending; });
+    mStepping = false;
+  }
+
+  for (auto *motionState : mMoved) motionState->publish();
+  mMoved.clear();
+}
+
+bool AsyncStepper::isStepping() const noexcept {
+  std::scoped_lock lock{mMutex};
+  return mStepping;
+}
+
+CollisionEventBuffer &AsyncStepper::getCollisionEvents() noexcept {
+  return mEvents;
+}
+
+float AsyncStepper::getLastStepTime() const noexcept {
+  std::scoped_lock lock{mMutex};
+  return mLastStepTime;
+}
+
+void AsyncStepper::run() {
+  std::unique_lock lock{mMutex};
+  while (true) {
+    mCv.wait(lock, [this]() { return mPending || mQuit; });
+    if (mQuit) return;
+
+    // The world is owned by this thread until mPending is cleared, so the
+    // lock does not need to be held while stepping.
+    lock.unlock();
+    step();
+    lock.lock();
+
+    mPending = false;
+    mCv.notify_all();
+  }
+}
+
+void AsyncStepper::step() {
+  using Clock = std::chrono::steady_clock;
+  using fSecond = std::chrono::duration<float>;
+  const auto startTime{Clock::now()};
+
+  mWorld->stepSimulation(mDelta, mMaxSubSteps);
+
+  // Gather the motion states that were moved, so that wait() does not need to
+  // look at every object in the world.
+  const auto &objects{mWorld->getCollisionObjectArray()};
+  for (int i = 0; i < objects.size(); ++i) {
+    auto *body{btRigidBody::upcast(objects[i])};
+    if (!body || body->isStaticObject()) continue;
+    auto *motionState{dynamic_cast<Ogre::MotionState *>(
+                          body->getMotionState())};
+    if (motionState && motionState->hasUnpublishedTransform()) {
+      mMoved.push_back(motionState);
+    }
+  }
+
+  auto *dispatcher{static_cast<btCollisionDispatcher *>(
+                       mWorld->getDispatcher())};
+  if (const auto numDropped{bullet::collectCollisionEvents(dispatcher,
+                                                           mEvents)}) {
+    spdlog::get(oo::LOG)->warn("AsyncStepper: Dropped {} collision events",
+                               numDropped);
+  }
+
+  const auto stepTime{std::chrono::duration_cast<fSecond>(Clock::now()
+                                                              - startTime)};
+  std::scoped_lock lock{mMutex};
+  mLastStepTime = stepTime.count();
+}
+
+} // namespace bullet
@@ -14,6 +14,24 @@ getManifolds(gsl::not_null<btCollisionDispatcher *> dispatcher) {
   return gsl::make_span(manifolds, numManifolds);
 }
 
+std::size_t
+collectCollisionEvents(gsl::not_null<btCollisionDispatcher *> dispatcher,
+                       CollisionEventBuffer &buffer) {
+  std::size_t numDropped{0u};
+  for (const auto *manifold : bullet::getManifolds(dispatcher)) {
+    // Same filter as CollisionCaller::runCallbacks.
+    if (manifold->getNumContacts() > 0) {
+      const auto &contact{manifold->getContactPoint(0)};
+      if (contact.getLifeTime() < 2) {
+        const CollisionEvent event{manifold->getBody0(), manifold->getBody1(),
+                                   contact};
+        if (!buffer.push(event)) ++numDropped;
+      }
+    }
+  }
+  return numDropped;
+}
+
 void CollisionCaller::dispatch(const btCollisionObject *a,
                                const btCollisionObject *b,
                                const btManifoldPoint &contact) {
@@ -36,6 +54,11 @@ void CollisionCaller::runCallbacks(gsl::not_null<btCollisionDispatcher *> dispat
   }
 }
 
+void CollisionCaller::runCallbacks(CollisionEventBuffer &buffer) {
+  CollisionEvent event{};
+  while (buffer.pop(event)) dispatch(event.a, event.b, event.contact);
+}
+
 void CollisionCaller::addCallback(const btCollisionObject *target,
                                   const callback_t &callback) {
   mMap[target].push_back(callback);
@@ -0,0 +1,270 @@
+#include "bullet/static_collision.hpp"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace bullet {
+
+namespace {
+
+/// Collects the triangles of a concave shape, transformed into world space.
+/// Triangles are only passed their corners' positions, so vertices are shared
+/// between triangles whose corners have the same position in the shape.
+class TriangleCollector : public btTriangleCallback {
+ public:
+  TriangleCollector(const btTransform &transform,
+                    std::vector<float> &vertices,
+                    std::vector<int> &indices)
+      : mTransform(transform), mVertices(vertices), mIndices(indices),
+        mFirstVertex(static_cast<int>(vertices.size() / 3u)) {}
+
+  void processTriangle(btVector3 *triangle, int /*partId*/,
+                       int /*triangleIndex*/) override {
+    for (int i = 0; i < 3; ++i) {
+      const btVector3 &p{triangle[i]};
+      const auto nextIndex{static_cast<int>(mVertices.size() / 3u)
+                               - mFirstVertex};
+      auto[it, inserted]{mVertexIndices.try_emplace(
+          std::make_tuple(p.x(), p.y(), p.z()), nextIndex)};
+      mIndices.push_back(it->second);
+      if (!inserted) continue;
+
+      const btVector3 v{mTransform * p};
+      mVertices.push_back(v.x());
+      mVertices.push_back(v.y());
+      mVertices.push_back(v.z());
+    }
+  }
+
+ private:
+  const btTransform &mTransform;
+  std::vector<float> &mVertices;
+  std::vector<int> &mIndices;
+  int mFirstVertex;
+  /// Index of the vertex with each position in the shape's space.
+  std::map<std::tuple<btScalar, btScalar, btScalar>, int> mVertexIndices{};
+};
+
+} // namespace
+
+StaticCollision::OwnerId
+StaticCollision::Object::getOwner(int shapePart,
+                                  int triangleIndex) const noexcept {
+  // Parts of a triangle mesh report the index of the part, but convex children
+  // of a compound shape have no parts so report their index in the compound.
+  if (shapePart >= 0) {
+    const auto i{static_cast<std::size_t>(shapePart)};
+    return i < mMeshOwners.size() ? mMeshOwners[i] : OwnerId{};
+  }
+  const auto i{static_cast<std::size_t>(triangleIndex)};
+  return triangleIndex >= 0 && i < mChildOwners.size() ? mChildOwners[i]
+                                                       : OwnerId{};
+}
+
+StaticCollision::StaticCollision(gsl::not_null<btCollisionWorld *> world)
+    : mWorld(world) {}
+
+StaticCollision::~StaticCollision() {
+  removeObjectsFromWorld();
+}
+
+bool StaticCollision::addShape(btCollisionShape *shape,
+                               const btTransform &transform,
+                               std::vector<Part> &parts) {
+  if (shape->isCompound()) {
+    auto *compound{static_cast<btCompoundShape *>(shape)};
+    for (int i = 0; i < compound->getNumChildShapes(); ++i) {
+      const btTransform childTransform{transform
+                                           * compound->getChildTransform(i)};
+      if (!addShape(compound->getChildShape(i), childTransform, parts)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if (!shape->isConvex() && !shape->isConcave()) return false;
+
+  Part part{};
+  part.mShape = shape;
+  part.mTransform = transform;
+  parts.push_back(part);
+  return true;
+}
+
+bool StaticCollision::addRigidBody(const Ogre::RigidBody &body,
+                                   OwnerId owner) {
+  btRigidBody *rigidBody{body.getRigidBody()};
+  if (!rigidBody || !rigidBody->isStaticObject()) return false;
+
+  std::vector<Part> parts{};
+  if (!addShape(rigidBody->getCollisionShape(), rigidBody->getWorldTransform(),
+                parts)) {
+    return false;
+  }
+
+  for (auto &part : parts) {
+    part.mOwner = owner;
+    part.mCollisionGroup = body.getCollisionGroup();
+    part.mCollisionMask = body.getCollisionMask();
+    mParts.push_back(part);
+  }
+  ++mNumBodies;
+
+  return true;
+}
+
+void StaticCollision::setOwnerEnabled(OwnerId owner, bool enabled) {
+  if (enabled == isOwnerEnabled(owner)) return;
+
+  if (enabled) mDisabledOwners.erase(owner);
+  else mDisabledOwners.insert(owner);
+
+  if (mIsBuilt && hasOwner(owner)) mIsDirty = true;
+}
+
+bool StaticCollision::isOwnerEnabled(OwnerId owner) const {
+  //C++20: return !mDisabledOwners.contains(owner);
+  return mDisabledOwners.find(owner) == mDisabledOwners.end();
+}
+
+bool StaticCollision::hasOwner(OwnerId owner) const {
+  return std::any_of(mParts.begin(), mParts.end(), [owner](const Part &part) {
+    return part.mOwner == owner;
+  });
+}
+
+void StaticCollision::setEnabled(bool enabled) {
+  if (enabled == mIsEnabled) return;
+
+  if (enabled) addObjectsToWorld();
+  else removeObjectsFromWorld();
+  mIsEnabled = enabled;
+}
+
+bool StaticCollision::isEnabled() const noexcept {
+  return mIsEnabled;
+}
+
+std::unique_ptr<StaticCollision::Object>
+StaticCollision::buildObject(const std::vector<const Part *> &parts) {
+  auto object{std::make_unique<Object>()};
+
+  // Copy the triangles of every concave part first, since the mesh interface
+  // keeps pointers into the buffers.
+  std::vector<std::pair<std::size_t, std::size_t>> vertexRanges{};
+  std::vector<std::pair<std::size_t, std::size_t>> indexRanges{};
+  std::vector<const Part *> convexParts{};
+  for (const Part *part : parts) {
+    if (part->mShape->isConvex()) {
+      convexParts.push_back(part);
+      continue;
+    }
+
+    const std::size_t firstVertex{object->mVertices.size()};
+    const std::size_t firstIndex{object->mIndices.size()};
+    TriangleCollector collector(part->mTransform, object->mVertices,
+                                object->mIndices);
+    const btVector3 aabbMax{BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT};
+    static_cast<const btConcaveShape *>(part->mShape)
+        ->processAllTriangles(&collector, -aabbMax, aabbMax);
+
+    if (object->mIndices.size() == firstIndex) continue;
+    vertexRanges.emplace_back(firstVertex, object->mVertices.size());
+    indexRanges.emplace_back(firstIndex, object->mIndices.size());
+    object->mMeshOwners.push_back(part->mOwner);
+  }
+
+  object->mCompoundShape = std::make_unique<btCompoundShape>(
+      true, static_cast<int>(convexParts.size() + 1u));
+
+  if (!object->mMeshOwners.empty()) {
+    object->mMeshInterface = std::make_unique<btTriangleIndexVertexArray>();
+    for (std::size_t i = 0; i < vertexRanges.size(); ++i) {
+      const auto[v0, v1]{vertexRanges[i]};
+      const auto[i0, i1]{indexRanges[i]};
+      btIndexedMesh mesh{};
+      mesh.m_numTriangles = static_cast<int>((i1 - i0) / 3u);
+      mesh.m_triangleIndexBase = reinterpret_cast<const unsigned char *>(
+          &object->mIndices[i0]);
+      mesh.m_triangleIndexStride = 3 * sizeof(int);
+      mesh.m_numVertices = static_cast<int>((v1 - v0) / 3u);
+      mesh.m_vertexBase = reinterpret_cast<const unsigned char *>(
+          &object->mVertices[v0]);
+      mesh.m_vertexStride = 3 * sizeof(float);
+      mesh.m_indexType = PHY_INTEGER;
+      mesh.m_vertexType = PHY_FLOAT;
+      object->mMeshInterface->addIndexedMesh(mesh, PHY_INTEGER);
+    }
+
+    object->mMeshShape = std::make_unique<btBvhTriangleMeshShape>(
+        object->mMeshInterface.get(), /*useQuantizedAabbCompression=*/true);
+    object->mCompoundShape->addChildShape(btTransform::getIdentity(),
+                                          object->mMeshShape.get());
+    object->mChildOwners.push_back(OwnerId{});
+  }
+
+  for (const Part *part : convexParts) {
+    object->mCompoundShape->addChildShape(part->mTransform, part->mShape);
+    object->mChildOwners.push_back(part->mOwner);
+  }
+
+  object->setCollisionShape(object->mCompoundShape.get());
+  object->setWorldTransform(btTransform::getIdentity());
+  object->setCollisionFlags(object->getCollisionFlags()
+                                | btCollisionObject::CF_STATIC_OBJECT);
+  object->mCollisionGroup = parts.front()->mCollisionGroup;
+  object->mCollisionMask = parts.front()->mCollisionMask;
+
+  return object;
+}
+
+void StaticCollision::build() {
+  if (mIsEnabled) removeObjectsFromWorld();
+  mObjects.clear();
+
+  // Bodies with different collision filters cannot share a collision object.
+  std::map<std::pair<int, int>, std::vector<const Part *>> groups{};
+  for (const auto &part : mParts) {
+    if (!isOwnerEnabled(part.mOwner)) continue;
+    groups[{part.mCollisionGroup, part.mCollisionMask}].push_back(&part);
+  }
+
+  for (const auto &[filter, parts] : groups) {
+    auto object{buildObject(parts)};
+    if (object->mCompoundShape->getNumChildShapes() == 0) continue;
+    mObjects.push_back(std::move(object));
+  }
+
+  mIsBuilt = true;
+  mIsDirty = false;
+  if (mIsEnabled) addObjectsToWorld();
+}
+
+void StaticCollision::update() {
+  if (mIsDirty) build();
+}
+
+std::size_t StaticCollision::getNumObjects() const noexcept {
+  return mObjects.size();
+}
+
+std::size_t StaticCollision::getNumBodies() const noexcept {
+  return mNumBodies;
+}
+
+void StaticCollision::addObjectsToWorld() {
+  for (const auto &object : mObjects) {
+    mWorld->addCollisionObject(object.get(), object->mCollisionGroup,
+                               object->mCollisionMask);
+  }
+}
+
+void StaticCollision::removeObjectsFromWorld() {
+  if (!mIsEnabled) return;
+  for (const auto &object : mObjects) {
+    mWorld->removeCollisionObject(object.get());
+  }
+}
+
+} // namespace bullet
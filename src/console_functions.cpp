@@ -76,6 +76,59 @@ int console::ShowSpellmaking() {
   return 0;
 }
 
+int console::InstancingStressTest(int count, int instanced) {
+  if (count < 0) return 1;
+
+  if (oo::getApplication()->isGameModeInStack()) {
+    oo::getApplication()->getGameModeInStack().runInstancingStressTest(
+        static_cast<std::size_t>(count), instanced != 0);
+  }
+
+  return 0;
+}
+
+int console::LightingStressTest(int count, int clustered) {
+  if (count < 0) return 1;
+
+  if (oo::getApplication()->isGameModeInStack()) {
+    oo::getApplication()->getGameModeInStack().runLightingStressTest(
+        static_cast<std::size_t>(count), clustered != 0);
+  }
+
+  return 0;
+}
+
+int console::BuildDistantObjects() {
+  if (oo::getApplication()->isGameModeInStack()) {
+    oo::getApplication()->getGameModeInStack().buildDistantObjects();
+  }
+
+  return 0;
+}
+
+int console::ShowScriptProfile(int count) {
+  if (count < 0) return 1;
+
+  if (oo::getApplication()->isGameModeInStack()) {
+    oo::getApplication()->getGameModeInStack().printScriptProfile(
+        static_cast<std::size_t>(count));
+  }
+
+  return 0;
+}
+
+int console::ssp(int count) {
+  return console::ShowScriptProfile(count);
+}
+
+int console::ResetScriptProfile() {
+  if (oo::getApplication()->isGameModeInStack()) {
+    oo::getApplication()->getGameModeInStack().resetScriptProfile();
+  }
+
+  return 0;
+}
+
 int console::print(float value) {
   oo::ConsoleMode::print(std::to_string(value));
   return 0;
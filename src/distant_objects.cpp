@@ -0,0 +1,799 @@
+#include "application_context.hpp"
+#include "config/game_settings.hpp"
+#include "distant_objects.hpp"
+#include "job/job.hpp"
+#include "mesh/entity.hpp"
+#include "mesh/lod_generator.hpp"
+#include "mesh/subentity.hpp"
+#include "mesh/submesh.hpp"
+#include "resolvers/cell_resolver.hpp"
+#include "resolvers/helpers.hpp"
+#include "resolvers/wrld_resolver.hpp"
+#include "util/atomic_file.hpp"
+#include "util/settings.hpp"
+#include <OgreManualObject.h>
+#include <OgreMaterialManager.h>
+#include <OgrePass.h>
+#include <OgreResourceGroupManager.h>
+#include <OgreRoot.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <OgreTechnique.h>
+#include <spdlog/fmt/ostr.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <system_error>
+#include <unordered_map>
+
+namespace oo {
+
+namespace {
+
+/// Number of floats per vertex of a `ModelPart`; the position, normal, and
+/// texture coordinates.
+constexpr std::size_t FLOATS_PER_MODEL_VERTEX{8u};
+
+/// Maximum number of vertices in a single batch, so that 16-bit indices can
+/// always be used.
+constexpr std::size_t MAX_BATCH_VERTICES{std::numeric_limits<uint16_t>::max()};
+
+/// Maximum length of the diffuse texture name of a batch in a cache file.
+constexpr std::size_t MAX_DIFFUSE_NAME_SIZE{1024u};
+
+/// Header at the start of every cache file, followed by `numBatches` batches.
+/// Each batch is stored as the length of its diffuse texture name, the name,
+/// the number of vertices, the number of indices, the vertices, and finally
+/// the indices.
+struct DistantObjectHeader {
+  std::array<char, 4> magic{'O', 'D', 'O', 'B'};
+  uint32_t version{1u};
+  uint32_t floatsPerVertex{DistantObjectBatch::FLOATS_PER_VERTEX};
+  uint32_t numBatches{0u};
+
+  bool isCompatibleWith(const DistantObjectHeader &other) const noexcept {
+    return magic == other.magic && version == other.version
+        && floatsPerVertex == other.floatsPerVertex;
+  }
+};
+
+/// Geometry of one submesh of a model, in the model's space.
+struct ModelPart {
+  std::string diffuseName{};
+  std::vector<float> vertices{};
+  std::vector<uint16_t> indices{};
+};
+
+/// Return the path of the cache file of the given chunk, or an empty path if
+/// the cache is disabled.
+std::filesystem::path getCachePath(oo::BaseId wrldId,
+                                   oo::ChunkIndex chunkIndex) {
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  const std::filesystem::path directory{
+      gameSettings.get("LOD.sDistantObjectCachePath", "cache/distant")};
+  if (directory.empty()) return {};
+
+  return directory / oo::getChunkBaseName(wrldId, chunkIndex).append(".dob");
+}
+
+/// Return the position in Ogre coordinates of the corner of the given chunk,
+/// which is the origin of the geometry of its distant objects.
+Ogre::Vector3 getChunkOrigin(oo::ChunkIndex chunkIndex) {
+  return oo::fromBSCoordinates(Ogre::Vector3{
+      qvm::X(chunkIndex) * oo::unitsPerChunk<float>,
+      qvm::Y(chunkIndex) * oo::unitsPerChunk<float>,
+      0.0f});
+}
+
+/// Return the path of the `_far.nif` variant of the model with the given path.
+std::string makeFarPath(const std::string &modelPath) {
+  const auto dotIndex{modelPath.rfind('.')};
+  if (dotIndex == std::string::npos) return modelPath + "_far";
+
+  std::string farPath{modelPath};
+  farPath.insert(dotIndex, "_far");
+  return farPath;
+}
+
+bool writeBatches(const std::filesystem::path &path,
+                  const std::vector<DistantObjectBatch> &batches) {
+  DistantObjectHeader header{};
+  header.numBatches = static_cast<uint32_t>(batches.size());
+
+  // The streamer must never see a partially written chunk.
+  return oo::writeFileAtomically(path, [&](std::ostream &os) {
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const auto &batch : batches) {
+      const std::array<uint32_t, 3> sizes{
+          static_cast<uint32_t>(batch.diffuseName.size()),
+          static_cast<uint32_t>(batch.vertices.size()
+                                    / DistantObjectBatch::FLOATS_PER_VERTEX),
+          static_cast<uint32_t>(batch.indices.size())};
+      os.write(reinterpret_cast<const char *>(&sizes[0]), sizeof(uint32_t));
+      os.write(batch.diffuseName.data(), sizes[0]);
+      os.write(reinterpret_cast<const char *>(&sizes[1]),
+               2u * sizeof(uint32_t));
+      os.write(reinterpret_cast<const char *>(batch.vertices.data()),
+               batch.vertices.size() * sizeof(float));
+      os.write(reinterpret_cast<const char *>(batch.indices.data()),
+               batch.indices.size() * sizeof(uint16_t));
+    }
+  });
+}
+
+/// Read the batches of a chunk written by `writeBatches()`. Returns no batches
+/// if the file does not exist or cannot be read, or if it is malformed in a way
+/// that would make the batches unsafe to draw, such as an index that is out of
+/// range.
+std::vector<DistantObjectBatch> readBatches(const std::filesystem::path &path) {
+  std::error_code ec{};
+  const auto fileSize{std::filesystem::file_size(path, ec)};
+  if (ec) return {};
+
+  std::ifstream is{path, std::ios::binary};
+  if (!is) return {};
+
+  DistantObjectHeader header{};
+  is.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!is || !header.isCompatibleWith(DistantObjectHeader{})) return {};
+
+  // Whether the next `bytes` bytes are all in the file, checked before sizing
+  // anything by a count read from the file.
+  auto isInFile = [&](std::size_t bytes) {
+    const auto pos{is.tellg()};
+    return pos >= 0 && bytes <= fileSize - static_cast<uintmax_t>(pos);
+  };
+
+  std::vector<DistantObjectBatch> batches{};
+  for (uint32_t b = 0; b < header.numBatches; ++b) {
+    auto &batch{batches.emplace_back()};
+
+    uint32_t nameSize{};
+    is.read(reinterpret_cast<char *>(&nameSize), sizeof(nameSize));
+    if (!is || nameSize > MAX_DIFFUSE_NAME_SIZE || !isInFile(nameSize)) {
+      return {};
+    }
+    batch.diffuseName.resize(nameSize);
+    is.read(batch.diffuseName.data(), nameSize);
+
+    std::array<uint32_t, 2> sizes{};
+    is.read(reinterpret_cast<char *>(sizes.data()), 2u * sizeof(uint32_t));
+    if (!is || sizes[0] > MAX_BATCH_VERTICES || sizes[1] % 3u != 0u) return {};
+
+    const std::size_t numFloats{
+        sizes[0] * DistantObjectBatch::FLOATS_PER_VERTEX};
+    if (!isInFile(numFloats * sizeof(float) + sizes[1] * sizeof(uint16_t))) {
+      return {};
+    }
+
+    batch.vertices.resize(numFloats);
+    batch.indices.resize(sizes[1]);
+    is.read(reinterpret_cast<char *>(batch.vertices.data()),
+            batch.vertices.size() * sizeof(float));
+    is.read(reinterpret_cast<char *>(batch.indices.data()),
+            batch.indices.size() * sizeof(uint16_t));
+    if (!is) return {};
+
+    const auto isInRange = [&](uint16_t i) { return i < sizes[0]; };
+    if (!std::all_of(batch.indices.begin(), batch.indices.end(), isInRange)) {
+      return {};
+    }
+  }
+
+  return batches;
+}
+
+/// Remove the vertices of `part` that are not referenced by any index, such
+/// as those removed by simplification.
+void compactVertices(ModelPart &part) {
+  const std::size_t numVertices{part.vertices.size() / FLOATS_PER_MODEL_VERTEX};
+  constexpr auto unused{std::numeric_limits<uint16_t>::max()};
+  std::vector<uint16_t> remap(numVertices, unused);
+
+  std::vector<float> vertices{};
+  vertices.reserve(part.vertices.size());
+  uint16_t next{0u};
+  for (auto &index : part.indices) {
+    if (remap[index] == unused) {
+      remap[index] = next++;
+      const auto it{part.vertices.begin() + index * FLOATS_PER_MODEL_VERTEX};
+      vertices.insert(vertices.end(), it, it + FLOATS_PER_MODEL_VERTEX);
+    }
+    index = remap[index];
+  }
+
+  part.vertices = std::move(vertices);
+}
+
+/// Copy the geometry of `subMesh` into a `ModelPart`, transforming it by
+/// `transform`. Returns `false` if the geometry is not suitable.
+/// The hardware buffers are write-only, so the geometry is taken from the copy
+/// kept in main memory; submeshes without one are not suitable.
+bool readSubMesh(const oo::SubMesh &subMesh, const Ogre::Affine3 &transform,
+                 ModelPart &part) {
+  const auto op{subMesh.operationType};
+  if (!subMesh.vertexData || subMesh.stagedVertices.empty()
+      || subMesh.stagedIndices.empty()
+      || subMesh.vertexData->vertexBufferBinding->getBufferCount() != 1
+      || (op != Ogre::RenderOperation::OT_TRIANGLE_LIST
+          && op != Ogre::RenderOperation::OT_TRIANGLE_STRIP)) {
+    return false;
+  }
+
+  const Ogre::VertexData &vertexData{*subMesh.vertexData};
+  const Ogre::VertexDeclaration &decl{*vertexData.vertexDeclaration};
+  const auto *posElem{decl.findElementBySemantic(Ogre::VES_POSITION)};
+  const auto *normElem{decl.findElementBySemantic(Ogre::VES_NORMAL)};
+  const auto *uvElem{
+      decl.findElementBySemantic(Ogre::VES_TEXTURE_COORDINATES, 0)};
+  if (!posElem || posElem->getType() != Ogre::VET_FLOAT3) return false;
+  if (normElem && normElem->getType() != Ogre::VET_FLOAT3) normElem = nullptr;
+  if (uvElem && uvElem->getType() != Ogre::VET_FLOAT2) uvElem = nullptr;
+
+  const std::size_t vertexCount{vertexData.vertexCount};
+  const std::size_t vertexSize{decl.getVertexSize(0)};
+  if (subMesh.stagedVertices.size() * sizeof(float)
+      < vertexCount * vertexSize) {
+    return false;
+  }
+  const auto *raw{
+      reinterpret_cast<const uint8_t *>(subMesh.stagedVertices.data())};
+
+  Ogre::Matrix3 linear{};
+  transform.extract3x3Matrix(linear);
+  const Ogre::Matrix3 normalTransform{linear.Inverse().Transpose()};
+
+  part.vertices.resize(vertexCount * FLOATS_PER_MODEL_VERTEX);
+  for (std::size_t i = 0; i < vertexCount; ++i) {
+    const uint8_t *vertex{raw + i * vertexSize};
+    float *dst{part.vertices.data() + i * FLOATS_PER_MODEL_VERTEX};
+    // The copy is const, so find the elements from their offsets directly.
+    auto element = [vertex](const Ogre::VertexElement *elem) {
+      return reinterpret_cast<const float *>(vertex + elem->getOffset());
+    };
+
+    const float *ptr{element(posElem)};
+    const Ogre::Vector3 pos{transform * Ogre::Vector3{ptr[0], ptr[1], ptr[2]}};
+
+    Ogre::Vector3 normal{Ogre::Vector3::UNIT_Y};
+    if (normElem) {
+      ptr = element(normElem);
+      normal = (normalTransform * Ogre::Vector3{ptr[0], ptr[1], ptr[2]})
+          .normalisedCopy();
+    }
+
+    std::array<float, 2> uv{};
+    if (uvElem) {
+      ptr = element(uvElem);
+      uv = {ptr[0], ptr[1]};
+    }
+
+    std::copy(pos.ptr(), pos.ptr() + 3, dst);
+    std::copy(normal.ptr(), normal.ptr() + 3, dst + 3);
+    std::copy(uv.begin(), uv.end(), dst + 6);
+  }
+
+  const auto &indices{subMesh.stagedIndices};
+  part.indices = op == Ogre::RenderOperation::OT_TRIANGLE_LIST
+                 ? indices : oo::triangleStripToList(indices);
+
+  return !part.indices.empty();
+}
+
+/// Append the parts of every entity attached to `node` or its children.
+void readNode(const Ogre::SceneNode *node, std::vector<ModelPart> &parts) {
+  for (const Ogre::MovableObject *obj : node->getAttachedObjects()) {
+    if (obj->getMovableType() != oo::EntityFactory::FACTORY_TYPE_NAME) continue;
+    const auto *entity{static_cast<const oo::Entity *>(obj)};
+    if (entity->hasSkeleton()) continue;
+
+    const Ogre::Affine3 &transform{node->_getFullTransform()};
+    for (const auto &subEntity : entity->getSubEntities()) {
+      if (!subEntity->isVisible()) continue;
+
+      const auto &mat{subEntity->getMaterial()};
+      if (!mat || mat->isTransparent()) continue;
+      auto *pass{mat->getTechnique(0)->getPass(0)};
+      const auto *diffuse{pass->getTextureUnitState("diffuse")};
+      if (!diffuse) continue;
+
+      ModelPart part{diffuse->getTextureName()};
+      if (oo::readSubMesh(*subEntity->getSubMesh(), transform, part)) {
+        parts.push_back(std::move(part));
+      }
+    }
+  }
+
+  for (const Ogre::Node *child : node->getChildren()) {
+    if (auto *sceneChild{dynamic_cast<const Ogre::SceneNode *>(child)}) {
+      oo::readNode(sceneChild, parts);
+    }
+  }
+}
+
+/// Collects the geometry of distant objects and merges it into batches.
+class DistantObjectBuilder {
+ public:
+  explicit DistantObjectBuilder(ApplicationContext &ctx);
+  ~DistantObjectBuilder();
+  DistantObjectBuilder(const DistantObjectBuilder &) = delete;
+  DistantObjectBuilder &operator=(const DistantObjectBuilder &) = delete;
+
+  /// Return the merged distant objects of the given cells.
+  std::vector<DistantObjectBatch>
+  buildChunk(oo::BaseId wrldId, oo::ChunkIndex chunkIndex,
+             const std::vector<oo::BaseId> &cellIds);
+
+ private:
+  ApplicationContext &mCtx;
+  /// Scratch scene that models are inserted into to read their geometry.
+  Ogre::SceneManager *mScnMgr;
+  /// Scratch physics world that the models' rigid bodies are added to.
+  std::unique_ptr<btDiscreteDynamicsWorld> mPhysicsWorld;
+  /// Fraction of the triangles of models without a `_far.nif` to keep.
+  float mReduction;
+  /// Geometry of every model read so far, in model space.
+  std::unordered_map<std::string, std::vector<ModelPart>> mModels{};
+  /// Batches of the chunk being built, grouped by texture.
+  std::map<std::string, std::vector<DistantObjectBatch>> mBatches{};
+
+  /// Return the geometry of the model with the given path, reading it if
+  /// necessary.
+  const std::vector<ModelPart> &getModel(const std::string &modelPath);
+
+  /// Append a reference to the model with the given path in the given cell to
+  /// the batches of the chunk.
+  void addReference(const std::string &modelPath,
+                    const Ogre::Affine3 &transform,
+                    oo::CellIndex cellIndex);
+
+  /// Append every distant reference in the given cell to the batches of the
+  /// chunk.
+  void addCell(oo::BaseId wrldId, oo::BaseId cellId,
+               const Ogre::Vector3 &chunkOrigin);
+};
+
+DistantObjectBuilder::DistantObjectBuilder(ApplicationContext &ctx)
+    : mCtx(ctx),
+      mScnMgr(Ogre::Root::getSingleton().createSceneManager(
+          "DefaultSceneManager")),
+      mPhysicsWorld(oo::getResolver<record::CELL>(ctx.getBaseResolvers())
+                        .getBulletConfiguration().makeDynamicsWorld()) {
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  mReduction = std::clamp(
+      gameSettings.get("LOD.fDistantObjectReduction", 0.25f), 0.0f, 1.0f);
+}
+
+DistantObjectBuilder::~DistantObjectBuilder() {
+  // Destruct the physics world before the rigid bodies, as in
+  // `oo::InteriorCell`.
+  mPhysicsWorld.reset();
+  Ogre::Root::getSingleton().destroySceneManager(mScnMgr);
+}
+
+const std::vector<ModelPart> &
+DistantObjectBuilder::getModel(const std::string &modelPath) {
+  if (auto it{mModels.find(modelPath)}; it != mModels.end()) return it->second;
+
+  auto &parts{mModels[modelPath]};
+
+  const std::string farPath{oo::makeFarPath(modelPath)};
+  const auto &resGrpMgr{Ogre::ResourceGroupManager::getSingleton()};
+  const bool hasFar{resGrpMgr.resourceExists(oo::RESOURCE_GROUP, farPath)};
+
+  auto *root{mScnMgr->getRootSceneNode()->createChildSceneNode()};
+  try {
+    const auto *node{oo::insertNif(hasFar ? farPath : modelPath,
+                                   oo::RESOURCE_GROUP,
+                                   gsl::make_not_null(mScnMgr),
+                                   gsl::make_not_null(mPhysicsWorld.get()),
+                                   gsl::make_not_null(root))};
+    if (!node) return parts;
+  } catch (const std::exception &e) {
+    mCtx.getLogger()->warn("Failed to read distant object {}: {}",
+                           modelPath, e.what());
+    return parts;
+  }
+
+  root->_update(true, false);
+  oo::readNode(root, parts);
+  if (hasFar) return parts;
+
+  for (auto &part : parts) {
+    const std::size_t numTris{part.indices.size() / 3u};
+    if (numTris < oo::MIN_LOD_TRIANGLES) continue;
+    const auto target{static_cast<std::size_t>(numTris * mReduction)};
+    part.indices = oo::simplifyTriangleList(part.vertices,
+                                            FLOATS_PER_MODEL_VERTEX,
+                                            part.indices,
+                                            std::max(target, std::size_t{1}));
+    oo::compactVertices(part);
+  }
+
+  return parts;
+}
+
+void DistantObjectBuilder::addReference(const std::string &modelPath,
+                                        const Ogre::Affine3 &transform,
+                                        oo::CellIndex cellIndex) {
+  Ogre::Matrix3 linear{};
+  transform.extract3x3Matrix(linear);
+  const Ogre::Matrix3 normalTransform{linear.Inverse().Transpose()};
+
+  const auto cellX{static_cast<float>(qvm::X(cellIndex))};
+  const auto cellY{static_cast<float>(qvm::Y(cellIndex))};
+
+  const auto numBatchVertices = [](const DistantObjectBatch &batch) {
+    return batch.vertices.size() / DistantObjectBatch::FLOATS_PER_VERTEX;
+  };
+  const auto appendVertex = [&](DistantObjectBatch &batch, const float *src) {
+    const Ogre::Vector3 pos{transform * Ogre::Vector3{src}};
+    const Ogre::Vector3 normal{
+        (normalTransform * Ogre::Vector3{src + 3}).normalisedCopy()};
+    batch.vertices.insert(batch.vertices.end(), {
+        pos.x, pos.y, pos.z, normal.x, normal.y, normal.z,
+        src[6], src[7], cellX, cellY});
+  };
+
+  for (const auto &part : getModel(modelPath)) {
+    const std::size_t numVertices{
+        part.vertices.size() / FLOATS_PER_MODEL_VERTEX};
+    if (numVertices == 0u) continue;
+
+    auto &batches{mBatches[part.diffuseName]};
+
+    if (numVertices > MAX_BATCH_VERTICES) {
+      // Too large to be copied whole, so split the part by triangle, copying
+      // only the vertices used by the triangles in each batch.
+      constexpr auto unused{std::numeric_limits<uint32_t>::max()};
+      std::vector<uint32_t> remap(numVertices, unused);
+      batches.emplace_back().diffuseName = part.diffuseName;
+      for (std::size_t i = 0; i + 2u < part.indices.size(); i += 3u) {
+        if (numBatchVertices(batches.back()) + 3u > MAX_BATCH_VERTICES) {
+          batches.emplace_back().diffuseName = part.diffuseName;
+          std::fill(remap.begin(), remap.end(), unused);
+        }
+
+        auto &batch{batches.back()};
+        for (std::size_t j = i; j < i + 3u; ++j) {
+          const uint16_t index{part.indices[j]};
+          if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(numBatchVertices(batch));
+            appendVertex(batch, part.vertices.data()
+                + index * FLOATS_PER_MODEL_VERTEX);
+          }
+          batch.indices.push_back(static_cast<uint16_t>(remap[index]));
+        }
+      }
+      continue;
+    }
+
+    if (batches.empty()
+        || numBatchVertices(batches.back()) + numVertices
+            > MAX_BATCH_VERTICES) {
+      batches.emplace_back().diffuseName = part.diffuseName;
+    }
+
+    auto &batch{batches.back()};
+    const auto offset{static_cast<uint16_t>(numBatchVertices(batch))};
+    for (std::size_t i = 0; i < numVertices; ++i) {
+      appendVertex(batch, part.vertices.data() + i * FLOATS_PER_MODEL_VERTEX);
+    }
+    for (uint16_t index : part.indices) {
+      batch.indices.push_back(static_cast<uint16_t>(offset + index));
+    }
+  }
+}
+
+void DistantObjectBuilder::addCell(oo::BaseId wrldId, oo::BaseId cellId,
+                                   const Ogre::Vector3 &chunkOrigin) {
+  auto &cellRes{oo::getResolver<record::CELL>(mCtx.getBaseResolvers())};
+  const auto cellRec{cellRes.get(cellId)};
+  if (!cellRec || !cellRec->grid) return;
+  const oo::CellIndex cellIndex{cellRec->grid->data.x, cellRec->grid->data.y};
+
+  const auto &baseResolvers{mCtx.getBaseResolvers()};
+  const auto &refrResolvers{mCtx.getRefrResolvers()};
+  cellRes.load(cellId,
+               oo::getRefrResolvers<
+                   record::REFR_ACTI, record::REFR_CONT, record::REFR_DOOR,
+                   record::REFR_LIGH, record::REFR_MISC, record::REFR_STAT,
+                   record::REFR_FLOR, record::REFR_FURN,
+                   record::REFR_NPC_>(refrResolvers),
+               oo::getResolvers<
+                   record::RACE, record::ACTI, record::CONT, record::DOOR,
+                   record::LIGH, record::MISC, record::STAT, record::FLOR,
+                   record::FURN, record::NPC_>(baseResolvers));
+  const auto &refLocator{mCtx.getPersistentReferenceLocator()};
+  for (auto persistentRef : refLocator.getRecordsInCell(wrldId, cellIndex)) {
+    cellRes.insertReferenceRecord(cellId, persistentRef);
+  }
+
+  const auto refs{cellRes.getReferences(cellId)};
+  if (!refs) return;
+
+  // Add the reference refId if it is a distant reference to a base record in
+  // baseRes, returning whether it is a reference to a base record in baseRes.
+  auto addRef = [&](const auto &refrRes, const auto &baseRes,
+                    oo::RefId refId) -> bool {
+    const auto ref{refrRes.get(refId)};
+    if (!ref) return false;
+    if ((ref->mRecordFlags & record::RecordFlag::VisibleWhenDistant)
+        == record::RecordFlag::None) {
+      return true;
+    }
+
+    const auto baseRec{baseRes.get(ref->baseId.data)};
+    if (!baseRec) return true;
+    const auto modelPath{oo::getModelPath(*baseRec)};
+    if (!modelPath) return true;
+
+    const auto &data{ref->positionRotation.data};
+    const Ogre::Vector3 position{
+        oo::fromBSCoordinates(Ogre::Vector3{data.x, data.y, data.z})};
+    const auto rotation{oo::fromBSTaitBryan(Ogre::Radian(data.aX),
+                                            Ogre::Radian(data.aY),
+                                            Ogre::Radian(data.aZ))};
+    const float scale{ref->scale ? ref->scale->data : 1.0f};
+
+    addReference(modelPath->c_str(),
+                 Ogre::Affine3{position - chunkOrigin, rotation,
+                               Ogre::Vector3{scale}},
+                 cellIndex);
+    return true;
+  };
+
+  const auto &statRes{oo::getResolver<record::STAT>(baseResolvers)};
+  const auto &actiRes{oo::getResolver<record::ACTI>(baseResolvers)};
+  const auto &doorRes{oo::getResolver<record::DOOR>(baseResolvers)};
+  const auto &refrStatRes{
+      oo::getRefrResolver<record::REFR_STAT>(refrResolvers)};
+  const auto &refrActiRes{
+      oo::getRefrResolver<record::REFR_ACTI>(refrResolvers)};
+  const auto &refrDoorRes{
+      oo::getRefrResolver<record::REFR_DOOR>(refrResolvers)};
+
+  // Only the reference types that can be given a distant LOD in the
+  // construction set are considered.
+  for (auto refId : *refs) {
+    addRef(refrStatRes, statRes, refId)
+        || addRef(refrActiRes, actiRes, refId)
+        || addRef(refrDoorRes, doorRes, refId);
+  }
+}
+
+std::vector<DistantObjectBatch>
+DistantObjectBuilder::buildChunk(oo::BaseId wrldId, oo::ChunkIndex chunkIndex,
+                                 const std::vector<oo::BaseId> &cellIds) {
+  mBatches.clear();
+  const auto chunkOrigin{oo::getChunkOrigin(chunkIndex)};
+  for (auto cellId : cellIds) addCell(wrldId, cellId, chunkOrigin);
+
+  std::vector<DistantObjectBatch> batches{};
+  for (auto &[_, textureBatches] : mBatches) {
+    std::move(textureBatches.begin(), textureBatches.end(),
+              std::back_inserter(batches));
+  }
+  mBatches.clear();
+
+  return batches;
+}
+
+} // namespace
+
+void buildDistantObjects(const oo::World &wrld, ApplicationContext &ctx) {
+  const auto wrldId{wrld.getBaseId()};
+  auto logger{ctx.getLogger()};
+
+  const auto &wrldRes{oo::getResolver<record::WRLD>(ctx.getBaseResolvers())};
+  const auto &cellRes{oo::getResolver<record::CELL>(ctx.getBaseResolvers())};
+  const auto cells{wrldRes.getCells(wrldId)};
+  if (!cells) return;
+
+  // Group the cells of the world by chunk.
+  std::map<std::pair<int32_t, int32_t>, std::vector<oo::BaseId>> chunks{};
+  for (auto cellId : *cells) {
+    const auto cellRec{cellRes.get(cellId)};
+    if (!cellRec || !cellRec->grid) continue;
+    const auto &grid{cellRec->grid->data};
+    const auto chunkIndex{oo::getChunkIndex(grid.x * oo::unitsPerCell<float>,
+                                            grid.y * oo::unitsPerCell<float>)};
+    chunks[{qvm::X(chunkIndex), qvm::Y(chunkIndex)}].push_back(cellId);
+  }
+
+  const auto cachePath{oo::getCachePath(wrldId, oo::ChunkIndex{0, 0})};
+  if (cachePath.empty()) {
+    logger->warn("Cannot build distant objects, "
+                 "LOD.sDistantObjectCachePath is not set");
+    return;
+  }
+  std::error_code ec{};
+  std::filesystem::create_directories(cachePath.parent_path(), ec);
+
+  logger->info("Building distant objects of {} chunks in WRLD {}",
+               chunks.size(), wrldId);
+  DistantObjectBuilder builder(ctx);
+
+  for (const auto &[key, cellIds] : chunks) {
+    const oo::ChunkIndex chunkIndex{key.first, key.second};
+    const auto path{oo::getCachePath(wrldId, chunkIndex)};
+    const auto batches{builder.buildChunk(wrldId, chunkIndex, cellIds)};
+
+    if (batches.empty()) {
+      std::filesystem::remove(path, ec);
+      continue;
+    }
+
+    if (!oo::writeBatches(path, batches)) {
+      logger->warn("Failed to write distant objects to {}", path.string());
+      continue;
+    }
+
+    std::size_t numTris{0u};
+    for (const auto &batch : batches) numTris += batch.indices.size() / 3u;
+    logger->info("Built distant objects of chunk ({}, {}): {} batches, "
+                 "{} triangles", key.first, key.second, batches.size(),
+                 numTris);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// DistantObjectManager definitions
+//===----------------------------------------------------------------------===//
+
+DistantObjectManager::DistantObjectManager(
+    oo::BaseId wrldId, gsl::not_null<Ogre::SceneManager *> scnMgr)
+    : mWrldId(wrldId), mScnMgr(scnMgr) {}
+
+DistantObjectManager::~DistantObjectManager() {
+  while (!mChunks.empty()) destroyChunk(mChunks.begin()->first);
+}
+
+const Ogre::MaterialPtr &
+DistantObjectManager::getMaterial(const std::string &diffuseName) {
+  if (auto it{mMaterials.find(diffuseName)}; it != mMaterials.end()) {
+    return it->second;
+  }
+
+  auto &matMgr{Ogre::MaterialManager::getSingleton()};
+  const std::string matName{BASE_MATERIAL + diffuseName};
+
+  auto matPtr{matMgr.getByName(matName, oo::RESOURCE_GROUP)};
+  if (!matPtr) {
+    auto baseMatPtr{matMgr.getByName(BASE_MATERIAL, oo::SHADER_GROUP)};
+    matPtr = baseMatPtr->clone(matName, /*changeGroup=*/true,
+                               oo::RESOURCE_GROUP);
+
+    auto *pass{matPtr->getTechnique(0)->getPass(0)};
+    pass->removeAllTextureUnitStates();
+    pass->createTextureUnitState(diffuseName);
+  }
+
+  auto *pass{matPtr->getTechnique(0)->getPass(0)};
+  pass->getVertexProgramParameters()->setNamedConstant("nearBounds",
+                                                       mNearBounds);
+
+  return mMaterials.emplace(diffuseName, std::move(matPtr)).first->second;
+}
+
+void DistantObjectManager::createChunk(
+    ChunkKey key, const std::vector<DistantObjectBatch> &batches) {
+  Chunk &chunk{mChunks[key]};
+  if (batches.empty()) return;
+
+  const oo::ChunkIndex chunkIndex{key.first, key.second};
+  auto *object{mScnMgr->createManualObject()};
+  object->setCastShadows(false);
+
+  for (const auto &batch : batches) {
+    const auto &matPtr{getMaterial(batch.diffuseName)};
+    const std::size_t numVertices{
+        batch.vertices.size() / DistantObjectBatch::FLOATS_PER_VERTEX};
+
+    object->estimateVertexCount(numVertices);
+    object->estimateIndexCount(batch.indices.size());
+    object->begin(matPtr->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST,
+                  oo::RESOURCE_GROUP);
+    for (std::size_t i = 0; i < numVertices; ++i) {
+      const float *v{batch.vertices.data()
+                         + i * DistantObjectBatch::FLOATS_PER_VERTEX};
+      object->position(v[0], v[1], v[2]);
+      object->normal(v[3], v[4], v[5]);
+      object->textureCoord(v[6], v[7]);
+      object->textureCoord(v[8], v[9]);
+    }
+    for (uint16_t index : batch.indices) object->index(index);
+    object->end();
+  }
+
+  chunk.object = object;
+  chunk.node = mScnMgr->getRootSceneNode()->createChildSceneNode(
+      oo::getChunkOrigin(chunkIndex));
+  chunk.node->attachObject(object);
+}
+
+void DistantObjectManager::destroyChunk(ChunkKey key) {
+  auto it{mChunks.find(key)};
+  if (it == mChunks.end()) return;
+
+  if (it->second.node) {
+    it->second.node->detachAllObjects();
+    mScnMgr->destroySceneNode(it->second.node);
+  }
+  if (it->second.object) mScnMgr->destroyManualObject(it->second.object);
+  mChunks.erase(it);
+}
+
+void DistantObjectManager::update(oo::CellIndex centerCell) {
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  const auto range{static_cast<int32_t>(
+      gameSettings.get<unsigned>("LOD.uDistantObjectRange", 1))};
+  const auto nearDiam{
+      gameSettings.get<unsigned>("General.uGridsToLoad", 3) / 2.0f};
+
+  const auto centerChunk{oo::getChunkIndex(
+      qvm::X(centerCell) * oo::unitsPerCell<float>,
+      qvm::Y(centerCell) * oo::unitsPerCell<float>)};
+
+  std::set<ChunkKey> wanted{};
+  for (int32_t x = -range; x <= range; ++x) {
+    for (int32_t y = -range; y <= range; ++y) {
+      wanted.emplace(qvm::X(centerChunk) + x, qvm::Y(centerChunk) + y);
+    }
+  }
+
+  // No render jobs of a previous update are running, so reading mChunks here
+  // is safe.
+  std::vector<ChunkKey> toLoad{};
+  std::vector<ChunkKey> toUnload{};
+  for (const auto &key : wanted) {
+    if (mChunks.find(key) == mChunks.end()) toLoad.push_back(key);
+  }
+  for (const auto &[key, _] : mChunks) {
+    if (wanted.find(key) == wanted.end()) toUnload.push_back(key);
+  }
+
+  // The same cells as `oo::WrldResolver::getNeighbourhood()`.
+  const auto cx{static_cast<float>(qvm::X(centerCell))};
+  const auto cy{static_cast<float>(qvm::Y(centerCell))};
+  const Ogre::Vector4 nearBounds{std::floor(cx - nearDiam) + 1.0f,
+                                 std::floor(cy - nearDiam) + 1.0f,
+                                 std::floor(cx + nearDiam),
+                                 std::floor(cy + nearDiam)};
+
+  oo::JobCounter loadJc{static_cast<int>(toLoad.size())};
+  for (const auto &key : toLoad) {
+    oo::JobManager::runJob([this, key]() {
+      const auto batches{oo::readBatches(oo::getCachePath(
+          mWrldId, oo::ChunkIndex{key.first, key.second}))};
+
+      oo::JobCounter createJc{1};
+      oo::RenderJobManager::runJob([this, key, &batches]() {
+        createChunk(key, batches);
+      }, &createJc);
+      createJc.wait();
+    }, &loadJc);
+  }
+
+  oo::JobCounter unloadJc{1};
+  oo::RenderJobManager::runJob([this, toUnload, nearBounds]() {
+    for (const auto &key : toUnload) destroyChunk(key);
+
+    mNearBounds = nearBounds;
+    for (const auto &[_, matPtr] : mMaterials) {
+      auto *pass{matPtr->getTechnique(0)->getPass(0)};
+      pass->getVertexProgramParameters()->setNamedConstant("nearBounds",
+                                                           mNearBounds);
+    }
+  }, &unloadJc);
+
+  loadJc.wait();
+  unloadJc.wait();
+}
+
+} // namespace oo
@@ -13,12 +13,19 @@ ExteriorManager::ExteriorManager(oo::CellPacket cellPacket) noexcept {
   for (const auto &cell : mNearCells) {
     mNearLoaded.emplace(cell->getBaseId());
   }
+
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  if (mWrld && gameSettings.get("LOD.bDisplayLODBuildings", true)) {
+    mDistantObjects = std::make_unique<oo::DistantObjectManager>(
+        mWrld->getBaseId(), mWrld->getSceneManager());
+  }
 }
 
 ExteriorManager::ExteriorManager(ExteriorManager &&other) noexcept {
   std::scoped_lock lock{other.mNearMutex, other.mFarMutex, other.mReifyMutex};
   mWrld = std::exchange(other.mWrld, {});
   mNearCells = std::exchange(other.mNearCells, {});
+  mDistantObjects = std::exchange(other.mDistantObjects, {});
   mNearLoaded = std::exchange(other.mNearLoaded, {});
   mFarLoaded = std::exchange(other.mFarLoaded, {});
 
@@ -34,6 +41,8 @@ ExteriorManager::operator=(ExteriorManager &&other) noexcept {
   if (this != &other) {
     std::scoped_lock lock{mNearMutex, mFarMutex, mReifyMutex,
                           other.mNearMutex, other.mFarMutex, other.mReifyMutex};
+    // The distant objects must be replaced before the world they are in.
+    mDistantObjects = std::exchange(other.mDistantObjects, {});
     mWrld = std::exchange(other.mWrld, {});
     mNearCells = std::exchange(other.mNearCells, {});
     mNearLoaded = std::exchange(other.mNearLoaded, {});
@@ -94,6 +103,8 @@ ExteriorManager::reifyExteriorCell(const record::CELL &cellRec,
   auto extPtr{std::static_pointer_cast<oo::ExteriorCell>(
       reifyRecord(cellRec, mWrld->getSceneManager().get(),
                   mWrld->getPhysicsWorld().get(), getCellResolvers(ctx)))};
+  extPtr->setScriptScheduler(&ctx.getScriptScheduler());
+  extPtr->setResolver(&oo::getResolver<record::CELL>(ctx.getBaseResolvers()));
   ctx.getCellCache()->push_back(extPtr);
   return extPtr;
 }
@@ -116,12 +127,10 @@ void ExteriorManager::reifyFarExteriorCell(oo::BaseId cellId,
     return;
   }
 
-  oo::JobCounter jc{1};
-  oo::RenderJobManager::runJob([this, cellId]() {
-    std::unique_lock lock{mFarMutex};
-    mWrld->loadTerrainOnly(cellId, /*async=*/true);
-  }, &jc);
-  jc.wait();
+  // Everything that touches the terrain group is run on the render thread, so
+  // far cells can be loaded concurrently, building their blend maps on the
+  // worker threads and sharing trips to the render thread.
+  mWrld->loadTerrainOnly(cellId);
 }
 
 void ExteriorManager::unloadFarExteriorCell(oo::BaseId cellId,
@@ -142,12 +151,7 @@ void ExteriorManager::unloadFarExteriorCell(oo::BaseId cellId,
     return;
   }
 
-  oo::JobCounter jc{1};
-  oo::RenderJobManager::runJob([this, cellId]() {
-    std::unique_lock lock{mFarMutex};
-    mWrld->unloadTerrain(cellId);
-  }, &jc);
-  jc.wait();
+  mWrld->unloadTerrain(cellId);
 }
 
 void ExteriorManager::reifyNearExteriorCell(oo::BaseId cellId,
@@ -180,6 +184,9 @@ void ExteriorManager::reifyNearExteriorCell(oo::BaseId cellId,
   loadExteriorCell(cellRec, ctx);
   boost::this_fiber::yield();
 
+  ctx.getLogger()->info("Preparing models of exterior CELL {}", cellId);
+  oo::prepareCell(cellRec, getCellResolvers(ctx));
+
   ctx.getLogger()->info("Reifying exterior CELL {}", cellId);
   oo::JobCounter reifyDone{1};
   oo::RenderJobManager::runJob([this, &cellRec, &ctx]() {
@@ -187,8 +194,8 @@ void ExteriorManager::reifyNearExteriorCell(oo::BaseId cellId,
     std::unique_lock nearLock{mNearMutex};
     mNearCells.emplace_back(std::move(extPtr));
 
-    // Take the far lock to avoid concurrent terrain loads from the far cells.
-    std::unique_lock farLock{mFarMutex};
+    // Terrain loads are serialized on the render thread by the world, so there
+    // is no need to exclude the far cells here.
     mWrld->loadTerrain(*mNearCells.back());
   }, &reifyDone);
   reifyDone.wait();
@@ -319,6 +326,7 @@ void ExteriorManager::reifyNeighborhood(oo::CellIndex centerCell,
                         boost::this_fiber::get_id());
   reifyNearNeighborhood(centerCell, ctx);
   reifyFarNeighborhood(centerCell, ctx);
+  if (mDistantObjects) mDistantObjects->update(centerCell);
 }
 
 void ExteriorManager::setVisible(bool visible) {
@@ -79,6 +79,7 @@ void gui::Image::set_filename(std::string filename) {
   mTexWidth = static_cast<float>(texPtr->getWidth());
   mTexHeight = static_cast<float>(texPtr->getHeight());
   updateUVs(gui::getNormalizedDimensions());
+  notifyTraitsChanged();
 }
 
 void gui::Image::set_zoom(float zoom) {
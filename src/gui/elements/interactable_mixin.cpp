@@ -57,21 +57,28 @@ gui::InteractableMixin::make_mouseover() const {
 }
 
 void gui::InteractableMixin::clearEvents() {
+  // This is called every frame, so avoid dirtying the traits unless an event
+  // actually occurred.
+  if (!mIsClicked && !mIsShiftclicked && !mIsMouseover) return;
   mIsClicked = false;
   mIsShiftclicked = false;
   mIsMouseover = false;
+  notifyTraitsChanged();
 }
 
 void gui::InteractableMixin::notify_clicked() {
   mIsClicked = true;
+  notifyTraitsChanged();
 }
 
 void gui::InteractableMixin::notify_shiftclicked() {
   mIsShiftclicked = true;
+  notifyTraitsChanged();
 }
 
 void gui::InteractableMixin::notify_mouseover() {
   mIsMouseover = true;
+  notifyTraitsChanged();
 }
 
 bool gui::InteractableMixin::is_clicked() const {
@@ -171,6 +171,7 @@ void gui::Text::set_visible(bool visible) {
 void gui::Text::set_string(std::string str) {
   if (!mOverlay) return;
   mOverlay->setCaption(str);
+  notifyTraitsChanged();
 }
 
 void gui::Text::set_font(float font) {
@@ -178,6 +179,7 @@ void gui::Text::set_font(float font) {
   const auto index{static_cast<int>(font)};
   oo::Path fontName{oo::GameSettings::getSingleton().getFont(index)};
   updateFont(fontName.c_str());
+  notifyTraitsChanged();
 }
 
 void gui::Text::set_justify(float justify) {
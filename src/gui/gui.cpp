@@ -6,9 +6,8 @@ namespace gui {
 
 std::optional<MenuContext> loadMenu(const std::string &filename,
                                     const std::string &stringsFilename) {
-  auto doc{gui::readXmlDocument(filename)};
-  auto stringsDoc{gui::readXmlDocument(stringsFilename)};
-  doc.save_file("out.xml", "  ");
+  auto doc{gui::readCachedXmlDocument(filename)};
+  auto stringsDoc{gui::readCachedXmlDocument(stringsFilename)};
   return gui::loadMenu(std::move(doc), std::move(stringsDoc));
 }
 
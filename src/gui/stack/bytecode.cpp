@@ -0,0 +1,446 @@
+#include "gui/stack/bytecode.hpp"
+#include "gui/traits.hpp"
+#include <nostdx/functional.hpp>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+
+namespace gui::stack {
+
+namespace {
+
+using Handler = TypedInstruction::Handler;
+
+template<class T, std::size_t I = 0> constexpr std::size_t getTypeIndex() {
+  if constexpr (std::is_same_v<T, std::variant_alternative_t<I, ValueType>>) {
+    return I;
+  } else {
+    return getTypeIndex<T, I + 1>();
+  }
+}
+
+constexpr std::size_t boolIndex{getTypeIndex<bool>()};
+constexpr auto typeIndices{std::make_index_sequence<
+    std::variant_size_v<ValueType>>{}};
+
+/// Return a value-initialized value of the type with the given index.
+template<std::size_t ...Is>
+ValueType makeDefault(std::size_t type, std::index_sequence<Is...>) {
+  ValueType value{};
+  ((type == Is ? (void) value.emplace<Is>() : void()), ...);
+  return value;
+}
+
+/// Return `Op::fn`, or `nullptr` if `Op` is not valid.
+template<class Op> constexpr Handler getHandler() {
+  if constexpr (Op::isValid) return &Op::fn;
+  else return nullptr;
+}
+
+/// Return the `Op<T>::fn` handler where `T` is the type with the given index,
+/// or `nullptr` if `Op<T>` is not valid.
+template<template<class> class Op, std::size_t ...Is>
+Handler getHandler(std::size_t type, std::index_sequence<Is...>) {
+  Handler fn{};
+  ((type == Is ? (void) (fn = getHandler<Op<
+      std::variant_alternative_t<Is, ValueType>>>()) : void()), ...);
+  return fn;
+}
+
+template<class T> T load(const Bytecode &bc, int32_t slot) {
+  if constexpr (std::is_same_v<T, int>) return bc.stack[slot].i;
+  else if constexpr (std::is_same_v<T, float>) return bc.stack[slot].f;
+  else if constexpr (std::is_same_v<T, bool>) return bc.stack[slot].b;
+  else return bc.stringStack[slot];
+}
+
+template<class T> void store(Bytecode &bc, int32_t slot, const T &value) {
+  if constexpr (std::is_same_v<T, int>) bc.stack[slot].i = value;
+  else if constexpr (std::is_same_v<T, float>) bc.stack[slot].f = value;
+  else if constexpr (std::is_same_v<T, bool>) bc.stack[slot].b = value;
+  else bc.stringStack[slot].assign(value);
+}
+
+template<std::size_t ...Is>
+ValueType loadValue(const Bytecode &bc, std::size_t type, int32_t slot,
+                    std::index_sequence<Is...>) {
+  ValueType value{};
+  ((type == Is ? (void) value.emplace<Is>(
+      load<std::variant_alternative_t<Is, ValueType>>(bc, slot)) : void()),
+      ...);
+  return value;
+}
+
+//===----------------------------------------------------------------------===//
+// Instruction handlers
+//===----------------------------------------------------------------------===//
+
+template<class T> struct PushConstant {
+  static constexpr bool isValid{true};
+  static bool fn(Bytecode &bc, const TypedInstruction &instr) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      store(bc, instr.slot, bc.strings[instr.arg]);
+    } else {
+      bc.stack[instr.slot] = bc.constants[instr.arg];
+    }
+    return true;
+  }
+};
+
+template<class T> struct PushTrait {
+  static constexpr bool isValid{std::is_same_v<T, float>
+                                    || std::is_same_v<T, bool>
+                                    || std::is_same_v<T, std::string>};
+  static bool fn(Bytecode &bc, const TypedInstruction &instr) {
+    if constexpr (isValid) {
+      const auto &name{bc.traits[instr.arg]};
+      const auto *trait{std::get_if<Trait<T>>(
+          &name.traits->getTraitVariant(name.str))};
+      if (!trait) return false;
+
+      if constexpr (std::is_same_v<T, std::string>) {
+        bc.stringStack[instr.slot] = trait->invoke();
+      } else {
+        store<T>(bc, instr.slot, trait->invoke());
+      }
+    }
+    return true;
+  }
+};
+
+template<class T> struct Copy {
+  static constexpr bool isValid{true};
+  static bool fn(Bytecode &bc, const TypedInstruction &instr) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      bc.stringStack[instr.slot] = bc.stringStack[instr.arg];
+    } else {
+      bc.stack[instr.slot] = bc.stack[instr.arg];
+    }
+    return true;
+  }
+};
+
+template<class T> struct Not {
+  static constexpr bool isValid{std::is_same_v<T, bool>};
+  static bool fn(Bytecode &bc, const TypedInstruction &instr) {
+    bc.stack[instr.slot].b = !bc.stack[instr.slot].b;
+    return true;
+  }
+};
+
+template<class T> struct Rand {
+  static constexpr bool isValid{std::is_same_v<T, int>
+                                    || std::is_same_v<T, float>};
+  static bool fn(Bytecode &bc, const TypedInstruction &instr) {
+    thread_local static std::random_device rd{};
+    thread_local static std::mt19937 gen{rd()};
+
+    if constexpr (std::is_same_v<T, int>) {
+      std::uniform_int_distribution<int> dist(0, load<int>(bc, instr.slot));
+      store(bc, instr.slot, dist(gen));
+    } else if constexpr (std::is_same_v<T, float>) {
+      std::uniform_real_distribution<float> dist(0.0f,
+                                                 load<float>(bc, instr.slot));
+      store(bc, instr.slot, dist(gen));
+    }
+    return true;
+  }
+};
+
+template<class F> constexpr bool isPredicate{
+    std::is_same_v<F, gt_t> || std::is_same_v<F, gte_t>
+        || std::is_same_v<F, lt_t> || std::is_same_v<F, lte_t>
+        || std::is_same_v<F, eq_t> || std::is_same_v<F, neq_t>};
+
+/// Binary operators and predicates, see `invokeBinaryOperator()` and
+/// `invokeBinaryPredicate()`.
+template<class F> struct Binary {
+  template<class T> struct Op {
+    static constexpr bool isValid{
+        std::is_invocable_v<const F &, const T &, const T &>};
+    using result_type = std::conditional_t<isPredicate<F>, bool, T>;
+
+    static bool fn(Bytecode &bc, const TypedInstruction &instr) {
+      if constexpr (!isValid) {
+        return true;
+      } else if constexpr (std::is_same_v<T, std::string>) {
+        auto &lhs{bc.stringStack[instr.slot]};
+        const auto &rhs{bc.stringStack[instr.slot + 1]};
+        // Append in place to reuse the capacity of the buffer.
+        if constexpr (std::is_same_v<F, add_t>) lhs += rhs;
+        else store<result_type>(bc, instr.slot, F{}(lhs, rhs));
+      } else {
+        const auto result{F{}(load<T>(bc, instr.slot),
+                              load<T>(bc, instr.slot + 1))};
+        store<result_type>(bc, instr.slot, static_cast<result_type>(result));
+      }
+      return true;
+    }
+  };
+};
+
+//===----------------------------------------------------------------------===//
+// Compiler
+//===----------------------------------------------------------------------===//
+
+class Compiler {
+ private:
+  /// A value on the stack at compile time.
+  struct Slot {
+    /// Index of the type of the value in `ValueType`.
+    std::size_t type{};
+    /// The value, if it is constant and has not yet been pushed.
+    std::optional<ValueType> constant{};
+  };
+
+  std::unique_ptr<Bytecode> mBytecode{std::make_unique<Bytecode>()};
+  std::vector<Slot> mStack{};
+  std::size_t mMaxSize{};
+
+  int32_t top() const noexcept {
+    return static_cast<int32_t>(mStack.size()) - 1;
+  }
+
+  void push(Slot slot) {
+    mStack.push_back(std::move(slot));
+    mMaxSize = std::max(mMaxSize, mStack.size());
+  }
+
+  void emit(Handler fn, int32_t slot, int32_t arg = 0) {
+    mBytecode->code.push_back(TypedInstruction{fn, slot, arg});
+  }
+
+  /// Emit an instruction to push the value in the slot, if it is constant.
+  void materialize(int32_t slot);
+
+  /// Evaluate the `instr` on constant operands, returning its result, or
+  /// `std::nullopt` if doing so throws.
+  std::optional<ValueType> fold(const Instruction &instr,
+                                std::vector<ValueType> operands);
+
+  bool visitPush(const push_t &instr);
+  bool visitNot(const Instruction &instr);
+  bool visitRand();
+  bool visitOnlyIf(bool keepIf);
+  template<class F> bool visitBinary(const Instruction &instr);
+
+ public:
+  explicit Compiler(std::size_t entryType);
+
+  bool visit(const Instruction &instr);
+
+  std::unique_ptr<Bytecode> finish();
+};
+
+Compiler::Compiler(std::size_t entryType) {
+  mBytecode->entryType = entryType;
+  if (entryType != std::variant_npos) push(Slot{entryType});
+}
+
+void Compiler::materialize(int32_t slot) {
+  auto &constant{mStack[slot].constant};
+  if (!constant) return;
+
+  auto &bc{*mBytecode};
+  const auto index{std::visit(nostdx::overloaded{
+      [&bc](const std::string &str) {
+        auto it{std::find(bc.strings.begin(), bc.strings.end(), str)};
+        if (it == bc.strings.end()) it = bc.strings.insert(it, str);
+        return it - bc.strings.begin();
+      },
+      [&bc](auto value) {
+        Word word{};
+        using T = decltype(value);
+        if constexpr (std::is_same_v<T, int>) word.i = value;
+        else if constexpr (std::is_same_v<T, float>) word.f = value;
+        else word.b = value;
+        bc.constants.push_back(word);
+        return static_cast<std::ptrdiff_t>(bc.constants.size() - 1);
+      }
+  }, *constant)};
+
+  emit(getHandler<PushConstant>(mStack[slot].type, typeIndices), slot,
+       static_cast<int32_t>(index));
+  constant.reset();
+}
+
+std::optional<ValueType> Compiler::fold(const Instruction &instr,
+                                        std::vector<ValueType> operands) {
+  try {
+    std::visit([&operands](const auto &op) { op(operands); }, instr);
+  } catch (const std::exception &) {
+    return std::nullopt;
+  }
+  if (operands.empty()) return std::nullopt;
+  return operands.back();
+}
+
+bool Compiler::visit(const Instruction &instr) {
+  return std::visit([&](const auto &op) -> bool {
+    using Op = std::decay_t<decltype(op)>;
+    if constexpr (std::is_same_v<Op, push_t>) return visitPush(op);
+    else if constexpr (std::is_same_v<Op, nop_t>) return true;
+    else if constexpr (std::is_same_v<Op, ref_t>) return true;
+    else if constexpr (std::is_same_v<Op, not_t>) return visitNot(instr);
+    else if constexpr (std::is_same_v<Op, rand_t>) return visitRand();
+    else if constexpr (std::is_same_v<Op, onlyif_t>) return visitOnlyIf(true);
+    else if constexpr (std::is_same_v<Op, onlyifnot_t>) {
+      return visitOnlyIf(false);
+    } else {
+      return visitBinary<Op>(instr);
+    }
+  }, instr);
+}
+
+bool Compiler::visitPush(const push_t &instr) {
+  return std::visit(nostdx::overloaded{
+      [this](const TraitName &name) {
+        // Switch statements select a trait using the working value, so the
+        // type of the trait is not known.
+        if (!name.traits || name.str.empty() || name.str.back() == '_') {
+          return false;
+        }
+
+        std::size_t type{};
+        try {
+          type = std::visit([](const auto &trait) {
+            return getTypeIndex<decltype(trait.invoke())>();
+          }, name.traits->getTraitVariant(name.str));
+        } catch (const std::runtime_error &) {
+          return false;
+        }
+
+        mBytecode->traits.push_back(name);
+        const auto index{mBytecode->traits.size() - 1u};
+        emit(getHandler<PushTrait>(type, typeIndices), top() + 1,
+             static_cast<int32_t>(index));
+        push(Slot{type});
+        return true;
+      },
+      [this](const auto &value) {
+        ValueType constant{value};
+        push(Slot{constant.index(), std::move(constant)});
+        return true;
+      }
+  }, instr.arg_t);
+}
+
+bool Compiler::visitNot(const Instruction &instr) {
+  if (mStack.empty() || mStack.back().type != boolIndex) return false;
+
+  if (auto &constant{mStack.back().constant}) {
+    auto result{fold(instr, {*constant})};
+    if (!result) return false;
+    constant = std::move(result);
+    return true;
+  }
+
+  emit(getHandler<Not>(boolIndex, typeIndices), top());
+  return true;
+}
+
+bool Compiler::visitRand() {
+  if (mStack.empty()) return false;
+  const auto fn{getHandler<Rand>(mStack.back().type, typeIndices)};
+  if (!fn) return false;
+
+  materialize(top());
+  emit(fn, top());
+  return true;
+}
+
+bool Compiler::visitOnlyIf(bool keepIf) {
+  // The height of the stack afterwards depends on the predicate, so it must be
+  // known now.
+  if (mStack.size() < 2u) return false;
+  const auto &pred{mStack.back().constant};
+  if (!pred || !std::holds_alternative<bool>(*pred)) return false;
+
+  const bool keep{std::get<bool>(*pred) == keepIf};
+  mStack.pop_back();
+  if (!keep) mStack.pop_back();
+  return true;
+}
+
+template<class F> bool Compiler::visitBinary(const Instruction &instr) {
+  if (mStack.empty()) return false;
+
+  // The left operand defaults to a value-initialized value of the type of the
+  // right operand.
+  if (mStack.size() == 1u) {
+    const auto type{mStack.back().type};
+    push(mStack.back());
+    mStack.front().constant = makeDefault(type, typeIndices);
+    if (!mStack.back().constant) {
+      emit(getHandler<Copy>(type, typeIndices), 1, 0);
+    }
+  }
+
+  const int32_t lhs{top() - 1};
+  const int32_t rhs{top()};
+  const auto type{mStack[lhs].type};
+  if (mStack[rhs].type != type) return false;
+
+  if (mStack[lhs].constant && mStack[rhs].constant) {
+    auto result{fold(instr, {*mStack[lhs].constant, *mStack[rhs].constant})};
+    if (!result) return false;
+    mStack.pop_back();
+    mStack.back() = Slot{result->index(), std::move(result)};
+    return true;
+  }
+
+  const auto fn{getHandler<Binary<F>::template Op>(type, typeIndices)};
+  if (!fn) return false;
+
+  materialize(lhs);
+  materialize(rhs);
+  emit(fn, lhs);
+  mStack.pop_back();
+  mStack.back() = Slot{isPredicate<F> ? boolIndex : type};
+  return true;
+}
+
+std::unique_ptr<Bytecode> Compiler::finish() {
+  if (mStack.empty()) return nullptr;
+  materialize(top());
+
+  auto &bc{*mBytecode};
+  bc.resultType = mStack.back().type;
+  bc.resultSlot = top();
+  bc.stack.resize(mMaxSize);
+  bc.stringStack.resize(mMaxSize);
+
+  return std::move(mBytecode);
+}
+
+} // namespace
+
+std::unique_ptr<Bytecode>
+compileBytecode(const std::vector<Instruction> &instructions,
+                std::size_t entryType) {
+  Compiler compiler{entryType};
+  for (const auto &instr : instructions) {
+    if (!compiler.visit(instr)) return nullptr;
+  }
+
+  return compiler.finish();
+}
+
+std::optional<ValueType> execute(Bytecode &bytecode,
+                                 const std::optional<ValueType> &working) {
+  if (working) {
+    std::visit([&bytecode](const auto &value) {
+      store(bytecode, 0, value);
+    }, *working);
+  }
+
+  for (const auto &instr : bytecode.code) {
+    if (!instr.fn(bytecode, instr)) return std::nullopt;
+  }
+
+  return loadValue(bytecode, bytecode.resultType, bytecode.resultSlot,
+                   typeIndices);
+}
+
+} // namespace gui::stack
@@ -0,0 +1,107 @@
+#ifndef OPENOBL_GUI_STACK_BYTECODE_HPP
+#define OPENOBL_GUI_STACK_BYTECODE_HPP
+
+#include "gui/stack/instructions.hpp"
+#include "gui/stack/types.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace gui {
+
+/// \addtogroup OpenOBLGuiStack
+namespace stack {
+
+/// A non-string value on the stack of a `Bytecode` program. The type of the
+/// value is known when the program is compiled, so is not stored.
+union Word {
+  int i;
+  float f;
+  bool b;
+};
+
+struct Bytecode;
+
+/// An instruction of a `Bytecode` program.
+/// Each value on the stack is at a position known when the program is
+/// compiled, so instructions address their operands directly instead of
+/// through a stack pointer.
+struct TypedInstruction {
+  /// Execute the instruction, returning `false` if the program must be
+  /// recompiled.
+  using Handler = bool (*)(Bytecode &, const TypedInstruction &);
+
+  Handler fn{};
+  /// Position on the stack of the first operand of the instruction, which is
+  /// also where the result is stored.
+  int32_t slot{};
+  /// Index of the constant, trait, or stack position used by the instruction,
+  /// if any.
+  int32_t arg{};
+};
+
+/// A stack program compiled to typed bytecode.
+///
+/// Compilation checks the types of every instruction once, instead of on
+/// every invocation, and folds any operations whose operands are constant.
+/// The resulting instructions are specialized to the types of their operands,
+/// and act on a stack that is allocated once, at its maximum size. String
+/// constants are interned, and string values are stored in buffers whose
+/// capacity is reused, so that after the first invocation evaluating a
+/// program does not allocate unless it invokes a trait returning a string.
+struct Bytecode {
+  std::vector<TypedInstruction> code{};
+  /// Non-string constants, indexed by the `arg` of the instruction that pushes
+  /// them.
+  std::vector<Word> constants{};
+  /// Interned string constants, indexed by the `arg` of the instruction that
+  /// pushes them.
+  std::vector<std::string> strings{};
+  /// Traits used by the program, indexed by the `arg` of the instruction that
+  /// pushes them.
+  std::vector<TraitName> traits{};
+
+  /// The stack. Strings are stored in `stringStack` in the same position.
+  std::vector<Word> stack{};
+  std::vector<std::string> stringStack{};
+
+  /// Index in `ValueType` of the type of the working value on entry, or
+  /// `std::variant_npos` if there is no working value.
+  std::size_t entryType{std::variant_npos};
+  /// Index in `ValueType` of the type of the result.
+  std::size_t resultType{};
+  /// Position on the stack of the result.
+  int32_t resultSlot{};
+};
+
+/// Compile a stack program to bytecode.
+/// \param entryType Index in `ValueType` of the type of the working value that
+///                  is on the stack when the program starts, or
+///                  `std::variant_npos` if the stack starts empty.
+/// \returns `nullptr` if the types of the values on the stack cannot be deduced
+///          when the program is compiled, such as if the program branches on
+///          a value that is not constant or selects a trait using a switch
+///          statement, or if executing the program would throw. Such programs
+///          must be interpreted instead.
+std::unique_ptr<Bytecode>
+compileBytecode(const std::vector<Instruction> &instructions,
+                std::size_t entryType);
+
+/// Execute compiled bytecode.
+/// \param working The working value that is on the stack when the program
+///                starts, which must have the type `bytecode.entryType`.
+/// \returns the result of the program, or `std::nullopt` if a trait used by
+///          the program no longer has the type it had when the program was
+///          compiled. In that case the program must be recompiled.
+std::optional<ValueType> execute(Bytecode &bytecode,
+                                 const std::optional<ValueType> &working);
+
+} // namespace stack
+
+} // namespace gui
+
+#endif // OPENOBL_GUI_STACK_BYTECODE_HPP
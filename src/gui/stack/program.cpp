@@ -2,16 +2,49 @@
 #include "gui/stack/program.hpp"
 #include "gui/trait_selector.hpp"
 #include "gui/traits.hpp"
+#include <nostdx/functional.hpp>
 #include <mutex>
 #include <string_view>
 
 namespace gui::stack {
 
+namespace {
+
+/// The number of values an instruction pops off the stack, and the number it
+/// is guaranteed to push.
+struct StackEffect {
+  int pops{};
+  int pushes{};
+  bool isPure{true};
+};
+
+StackEffect getStackEffect(const Instruction &instr) {
+  return std::visit(nostdx::overloaded{
+      [](const push_t &op) {
+        // Switch statements select a trait using the working value.
+        const auto *trait{std::get_if<TraitName>(&op.arg_t)};
+        const bool isSwitch{trait && !trait->str.empty()
+                                && trait->str.back() == '_'};
+        return StackEffect{0, 1, !isSwitch};
+      },
+      [](nop_t) { return StackEffect{0, 0}; },
+      [](ref_t) { return StackEffect{0, 0}; },
+      [](not_t) { return StackEffect{1, 1}; },
+      [](rand_t) { return StackEffect{1, 1, false}; },
+      [](onlyif_t) { return StackEffect{2, 0}; },
+      [](onlyifnot_t) { return StackEffect{2, 0}; },
+      [](const auto &) { return StackEffect{2, 1}; }
+  }, instr);
+}
+
+} // namespace
+
 Program::Program(const Program &other) {
   std::unique_lock lock{other.lastReturnMutex};
   lastReturn = other.lastReturn;
   instructions = other.instructions;
   dependencies = other.dependencies;
+  // The bytecode is not copied, but recompiled when the copy is invoked.
 }
 
 Program &Program::operator=(const Program &other) {
@@ -22,6 +55,8 @@ Program &Program::operator=(const Program &other) {
     lastReturn = other.lastReturn;
     instructions = other.instructions;
     dependencies = other.dependencies;
+    bytecode.reset();
+    compiledEntryType.reset();
   }
   return *this;
 }
@@ -31,6 +66,8 @@ Program::Program(Program &&other) noexcept {
   std::swap(lastReturn, other.lastReturn);
   std::swap(instructions, other.instructions);
   std::swap(dependencies, other.dependencies);
+  std::swap(bytecode, other.bytecode);
+  std::swap(compiledEntryType, other.compiledEntryType);
 }
 
 Program &Program::operator=(Program &&other) noexcept {
@@ -41,6 +78,8 @@ Program &Program::operator=(Program &&other) noexcept {
     std::swap(lastReturn, other.lastReturn);
     std::swap(instructions, other.instructions);
     std::swap(dependencies, other.dependencies);
+    std::swap(bytecode, other.bytecode);
+    std::swap(compiledEntryType, other.compiledEntryType);
   }
   return *this;
 }
@@ -114,6 +153,28 @@ Program compile(pugi::xml_node node, const gui::Traits *traits) {
 
 ValueType Program::operator()() const {
   std::unique_lock lock{lastReturnMutex};
+
+  const std::size_t entryType{lastReturn ? lastReturn->index()
+                                         : std::variant_npos};
+  if (compiledEntryType != entryType) {
+    bytecode = compileBytecode(instructions, entryType);
+    compiledEntryType = entryType;
+  }
+
+  if (bytecode) {
+    if (auto result{execute(*bytecode, lastReturn)}) {
+      lastReturn = std::move(*result);
+      return *lastReturn;
+    }
+    // A trait has changed type, so the bytecode is no longer valid.
+    bytecode.reset();
+    compiledEntryType.reset();
+  }
+
+  return interpret();
+}
+
+ValueType Program::interpret() const {
   Stack stack{};
   if (lastReturn) stack.push_back(*lastReturn);
   for (const auto &instr : instructions) {
@@ -127,4 +188,19 @@ ValueType Program::operator()() const {
   return *lastReturn;
 }
 
-} // namespace gui::stack
\ No newline at end of file
+bool Program::isPure() const {
+  // Number of values on the stack above the working value carried over from
+  // the last invocation. Operators that pop more values than this read the
+  // working value, as do programs that leave no other value on the stack.
+  int height{0};
+
+  for (const auto &instr : instructions) {
+    const StackEffect effect{getStackEffect(instr)};
+    if (!effect.isPure || height < effect.pops) return false;
+    height += effect.pushes - effect.pops;
+  }
+
+  return height > 0;
+}
+
+} // namespace gui::stack
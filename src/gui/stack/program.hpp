@@ -1,11 +1,13 @@
 #ifndef OPENOBL_GUI_STACK_PROGRAM_HPP
 #define OPENOBL_GUI_STACK_PROGRAM_HPP
 
+#include "gui/stack/bytecode.hpp"
 #include "gui/stack/instructions.hpp"
 #include "gui/stack/types.hpp"
 #include <boost/fiber/mutex.hpp>
 #include <pugixml.hpp>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <random>
 #include <string>
@@ -95,11 +97,29 @@ class Traits;
 /// \addtogroup OpenOBLGuiStack
 namespace stack {
 
+/// A stack program. The first time the program is invoked, it is compiled to
+/// typed bytecode if possible, and interpreted otherwise.
+/// \see Bytecode
 class Program {
  private:
   mutable std::optional<ValueType> lastReturn{};
   mutable boost::fibers::mutex lastReturnMutex{};
+
+  /// Bytecode compiled from the `instructions`, or null if they could not be
+  /// compiled. Guarded by `lastReturnMutex`.
+  mutable std::unique_ptr<Bytecode> bytecode{};
+  /// Index in `ValueType` of the type of `lastReturn` that the `instructions`
+  /// were last compiled for, if any. The bytecode depends on the type of
+  /// `lastReturn`, which is only known after the first invocation.
+  mutable std::optional<std::size_t> compiledEntryType{};
+
+  /// Evaluate the `instructions` in the interpreter.
+  /// \pre `lastReturnMutex` is locked.
+  ValueType interpret() const;
+
  public:
+  /// \warning The instructions should not be modified after the program has
+  ///          been invoked, as they are not recompiled.
   std::vector<Instruction> instructions{};
   std::vector<std::string> dependencies{};
 
@@ -110,6 +130,14 @@ class Program {
   Program &operator=(Program &&other) noexcept;
 
   ValueType operator()() const;
+
+  /// Whether the value of the program depends only on the values of its
+  /// dependencies. This is not the case for programs that generate random
+  /// numbers, select traits by switch statement, or use the working value left
+  /// over from the previous invocation.
+  /// \remark This is a conservative check, so some pure programs may not be
+  ///         recognised as such.
+  bool isPure() const;
 };
 
 inline bool operator==(const Program &lhs, const Program &rhs) {
@@ -24,6 +24,29 @@ void Traits::sort() {
   boost::topological_sort(mGraph, std::back_inserter(mOrdering));
   std::reverse(mOrdering.begin(), mOrdering.end());
   mSorted = true;
+
+  // Resorting means that traits or edges have been added, so the last values
+  // of dependencies are no longer a reliable indicator of what has changed.
+  for (auto &[_, vertices] : mElementTraits) vertices.clear();
+  for (auto desc : mOrdering) {
+    auto &vertex{mGraph[desc]};
+    if (!vertex) continue;
+    vertex->isDirty = true;
+
+    const std::string name{std::visit([](const auto &trait) {
+      return trait.getName();
+    }, vertex->var)};
+    const auto it{mElementTraits.find(name.substr(0, name.rfind('.')))};
+    vertex->isElementState = it != mElementTraits.end()
+        && (gui::getUserTraitIndex(name) || mProvidedTraits.count(name) != 0);
+    if (vertex->isElementState) it->second.push_back(vertex);
+  }
+}
+
+void Traits::markElementDirty(const std::string &name) {
+  const auto it{mElementTraits.find(name)};
+  if (it == mElementTraits.end()) return;
+  for (auto &vertex : it->second) vertex->isDirty = true;
 }
 
 bool Traits::addAndBindImplementationTrait(pugi::xml_node node,
@@ -184,25 +207,29 @@ void Traits::addImplementationElementTraits() {
   }
 }
 
-void Traits::addProvidedTraits(const UiElement *uiElement) {
-  addTrait(uiElement->make_x());
-  addTrait(uiElement->make_y());
-  addTrait(uiElement->make_width());
-  addTrait(uiElement->make_height());
-  addTrait(uiElement->make_filewidth());
-  addTrait(uiElement->make_fileheight());
-  addTrait(uiElement->make_alpha());
-  addTrait(uiElement->make_locus());
-  addTrait(uiElement->make_visible());
-  addTrait(uiElement->make_menufade());
-  addTrait(uiElement->make_explorefade());
-  addTrait(uiElement->make_filename());
-  addTrait(uiElement->make_zoom());
-  addTrait(uiElement->make_clicked());
-  addTrait(uiElement->make_shiftclicked());
-  addTrait(uiElement->make_mouseover());
-  addTrait(uiElement->make_childcount());
-  addTrait(uiElement->make_child_count());
+void Traits::addProvidedTraits(UiElement *uiElement) {
+  const std::string name{uiElement->get_name()};
+  mElementTraits.try_emplace(name);
+  uiElement->setTraitListener([this, name]() { markElementDirty(name); });
+
+  addProvidedTrait(uiElement->make_x());
+  addProvidedTrait(uiElement->make_y());
+  addProvidedTrait(uiElement->make_width());
+  addProvidedTrait(uiElement->make_height());
+  addProvidedTrait(uiElement->make_filewidth());
+  addProvidedTrait(uiElement->make_fileheight());
+  addProvidedTrait(uiElement->make_alpha());
+  addProvidedTrait(uiElement->make_locus());
+  addProvidedTrait(uiElement->make_visible());
+  addProvidedTrait(uiElement->make_menufade());
+  addProvidedTrait(uiElement->make_explorefade());
+  addProvidedTrait(uiElement->make_filename());
+  addProvidedTrait(uiElement->make_zoom());
+  addProvidedTrait(uiElement->make_clicked());
+  addProvidedTrait(uiElement->make_shiftclicked());
+  addProvidedTrait(uiElement->make_mouseover());
+  addProvidedTrait(uiElement->make_childcount());
+  addProvidedTrait(uiElement->make_child_count());
 }
 
 void Traits::deduceAndAddTrait(DeferredTrait trait) {
@@ -349,42 +376,62 @@ void Traits::addTraitDependencies(TraitGraph::vertex_descriptor vIndex) {
 }
 
 void Traits::addTraitDependencies() {
+  mSorted = false;
   for (TraitGraph::vertex_descriptor vIndex : mGraph.vertex_set()) {
     addTraitDependencies(vIndex);
   }
 }
 
+bool Traits::updateVertex(TraitVertexBase &vertex) {
+  auto &cache{vertex.cache};
+  if (cache) {
+    return std::visit([](auto &trait, auto &c) {
+      if constexpr (std::is_same_v<decltype(trait.invoke()),
+                                   std::decay_t<decltype(c)>>) {
+        auto v{trait.invoke()};
+        if (c != v) {
+          c = v;
+          trait.update();
+          return true;
+        }
+      }
+      return false;
+    }, vertex.var, *cache);
+  } else {
+    std::visit([&cache](auto &&trait) {
+      cache.emplace(trait.invoke());
+      trait.update();
+    }, vertex.var);
+    return true;
+  }
+}
+
 void Traits::update() {
   // Make sure we've got a topological order, then iterate over the graph in
   // that order and call update. The ordering guarantees that updates are
-  // performed in the correct order wrt dependencies.
+  // performed in the correct order wrt dependencies, so a changed trait can
+  // mark its dependents dirty before they are reached.
   sort();
   for (const auto &desc : mOrdering) {
     auto &vertex{mGraph[desc]};
     if (!vertex) {
-      const std::string traitName{std::visit([](const auto &trait) {
-        return trait.getName();
-      }, vertex->var)};
-      gui::guiLogger()->error("Trait {} exists but is null", traitName);
+      gui::guiLogger()->error("Trait vertex {} is null", desc);
       throw std::runtime_error("nullptr vertex");
     }
-    auto &cache{vertex->cache};
-    if (cache) {
-      std::visit([](auto &trait, auto &c) {
-        if constexpr (std::is_same_v<decltype(trait.invoke()),
-                                     std::decay_t<decltype(c)>>) {
-          auto v{trait.invoke()};
-          if (c != v) {
-            c = v;
-            trait.update();
-          }
-        }
-      }, vertex->var, *cache);
-    } else {
-      std::visit([&cache](auto &&trait) {
-        cache.emplace(trait.invoke());
-        trait.update();
-      }, vertex->var);
+
+    // Impure traits that read state other than a listened to uiElement's
+    // cannot be notified when it changes, so must be polled.
+    const bool isPolled{!vertex->isElementState && !std::visit(
+        [](const auto &trait) { return trait.isPure(); }, vertex->var)};
+    if (!isPolled && !vertex->isDirty) continue;
+    vertex->isDirty = false;
+
+    if (!updateVertex(*vertex)) continue;
+    auto[eBegin, eEnd]{boost::out_edges(desc, mGraph)};
+    for (auto edge : boost::make_iterator_range(eBegin, eEnd)) {
+      if (auto &target{mGraph[boost::target(edge, mGraph)]}) {
+        target->isDirty = true;
+      }
     }
   }
 }
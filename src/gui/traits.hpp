@@ -16,6 +16,7 @@
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 
@@ -35,6 +36,12 @@ class Traits {
     /// The last value is cached so avoid updating every concrete representative
     /// every time update() is called.
     std::optional<std::variant<float, std::string, bool>> cache{};
+    /// Whether the trait must be reevaluated on the next update() because one
+    /// of its dependencies, or the uiElement state it reads, has changed.
+    bool isDirty{true};
+    /// Whether the trait is a user or provided trait of a uiElement that
+    /// notifies the graph when its state changes, so need not be polled.
+    bool isElementState{false};
     /*explicit*/ explicit TraitVertexBase(TraitVariant v) : var(std::move(v)) {}
     template<class ...Args>
     explicit TraitVertexBase(Args &&... args)
@@ -90,6 +97,16 @@ class Traits {
   /// implementation traits have been added.
   std::vector<DeferredTrait> mDeferredTraits{};
 
+  /// User and provided traits of each uiElement listened to by
+  /// `addProvidedTraits()`, keyed by the name of the uiElement.
+  /// \warning This is only rebuilt by `sort()`, so may refer to removed traits
+  ///          and miss new ones if not `isSorted()`. New traits are dirty
+  ///          anyway, so this is harmless.
+  std::unordered_map<std::string, std::vector<TraitVertex>> mElementTraits{};
+
+  /// Names of all the provided traits that have been added.
+  std::unordered_set<std::string> mProvidedTraits{};
+
   /// Implementation-defined element storing screen settings.
   ScreenElement mScreen{};
 
@@ -102,6 +119,7 @@ class Traits {
 
   /// Topologically sort the vertices in the dependency graph, store the result
   /// in `mOrdering`, and set `mSorted`. If already `isSorted()`, do nothing.
+  /// Otherwise, every vertex is marked dirty and `mElementTraits` is rebuilt.
   /// \throws boost::not_a_dag if the underlying depdency graph is not a DAG.
   void sort();
 
@@ -109,6 +127,14 @@ class Traits {
   /// existing trait in the dependency graph with the same name.
   template<class T> void addTrait(std::optional<Trait<T>> trait);
 
+  /// As `addTrait(std::optional<Trait<T>>)`, but remember that the trait is a
+  /// provided trait.
+  template<class T> void addProvidedTrait(std::optional<Trait<T>> trait);
+
+  /// Mark every user and provided trait of the uiElement with the given `name`
+  /// dirty.
+  void markElementDirty(const std::string &name);
+
   /// Convert a `DeferredTrait` to an actual `Trait<T>` and add it to the
   /// dependency graph by forwarding its name and program to `addTrait()`.
   template<class T> void addTrait(DeferredTrait trait);
@@ -126,6 +152,11 @@ class Traits {
   /// \param vIndex The vertex descriptor of the vertex `v`.
   void addTraitDependencies(TraitGraph::vertex_descriptor vIndex);
 
+  /// Reevaluate the trait in the `vertex`, notifying its concrete
+  /// representative if its value has changed.
+  /// \returns `true` iff the value of the trait has changed.
+  static bool updateVertex(TraitVertexBase &vertex);
+
   /// Construct a directed graph from the given iterator range of
   /// `DeferredTrait` vertices, with an edge from `u` to `v` iff `u` is a
   /// dependency of `v`.
@@ -143,6 +174,14 @@ class Traits {
   void addImplementationElementTrait(const std::string &dep);
 
  public:
+  Traits() = default;
+  ~Traits() = default;
+  // Listened to uiElements refer to the `Traits` that added them.
+  Traits(const Traits &) = delete;
+  Traits &operator=(const Traits &) = delete;
+  Traits(Traits &&) = delete;
+  Traits &operator=(Traits &&) = delete;
+
   /// Return a reference to the dynamic trait with the fully-qualified `name`.
   /// Use this method when the type of the trait is not known ahead of time,
   /// prefer getTrait(const std::string &) when it is.
@@ -192,8 +231,11 @@ class Traits {
   void addImplementationElementTraits();
 
   /// Add the `uiElement`'s provided traits, overriding any existing traits with
-  /// the same name.
-  void addProvidedTraits(const UiElement *uiElement);
+  /// the same name, and listen to the `uiElement` so that its user and provided
+  /// traits are only reevaluated when it reports that its state has changed.
+  /// \see UiElement::setTraitListener()
+  /// \pre The `uiElement` does not report changes after this is destroyed.
+  void addProvidedTraits(UiElement *uiElement);
 
   /// Deduce the return types of any queued custom traits and add them to the
   /// trait graph.
@@ -232,11 +274,17 @@ class Traits {
   /// \throws std::runtime_error if a trait has a nonexistent dependency.
   void addTraitDependencies();
 
-  /// Update every trait, notifying the concrete representation of the new
-  /// values.
+  /// Update every trait whose value may have changed, notifying the concrete
+  /// representation of the new values.
+  /// Pure traits are only reevaluated if the value of one of their dependencies
+  /// has changed since the last update, or if traits have been added since
+  /// then. User and provided traits of uiElements passed to
+  /// `addProvidedTraits()` are additionally reevaluated when their uiElement
+  /// reports a change. Any other impure traits, such as those using `rand`, are
+  /// reevaluated every update.
+  /// \see TraitFun
   /// \throws std::runtime_error if there are any null vertices.
   /// \throws boost::not_a_dag if the underlying depdency graph is not a DAG.
-  // TODO: Provide a method to update only a trait and its dependents
   void update();
 
   /// Load an XML document of localized strings.
@@ -251,9 +299,12 @@ class Traits {
 };
 
 /// Construct a TraitFun from a stack program, returning the given type `T`.
+/// The TraitFun is pure if the program is.
 template<class T>
 TraitFun<T> makeTraitFun(gui::stack::Program prog) {
+  const bool isPure{prog.isPure()};
   auto fun{TraitFun<T>([prog]() -> T { return std::get<T>(prog()); })};
+  fun.setPure(isPure);
   for (auto &dep : prog.dependencies) {
     fun.addDependency(std::move(dep));
   }
@@ -266,13 +317,12 @@ TraitFun<T> makeTraitFun(gui::stack::Program prog) {
 template<class T>
 TraitFun<T> getTraitFun(const Traits &traits, pugi::xml_node node) {
   if (node.text()) {
-    const auto value{gui::getXmlChildValue<T>(node)};
-    return TraitFun<T>{[value]() { return value; }};
+    return TraitFun<T>::constant(gui::getXmlChildValue<T>(node));
   } else if (!node.first_child()) {
     // This happens in particular when `node` contains an empty string, or only
     // whitespace, such as `<foo>  </foo>`. Because `xml_text` uses an empty
     // string for failure, such cases are not counted as strings.
-    return TraitFun<T>{[]() -> T { return {}; }};
+    return TraitFun<T>::constant(T{});
   } else {
     gui::stack::Program prog{gui::stack::compile(node, &traits)};
     return makeTraitFun<T>(std::move(prog));
@@ -307,6 +357,13 @@ template<class T> void Traits::addTrait(DeferredTrait trait) {
               gui::makeTraitFun<T>(std::move(trait.program)));
 }
 
+template<class T>
+void Traits::addProvidedTrait(std::optional<Trait<T>> trait) {
+  if (!trait) return;
+  mProvidedTraits.insert(trait->getName());
+  addTrait(std::move(trait));
+}
+
 template<class T, class ...Args>
 Trait<T> &Traits::addTrait(const std::string &name, Args &&... args) {
   mSorted = false;
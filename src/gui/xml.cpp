@@ -7,6 +7,8 @@
 #include <boost/convert.hpp>
 #include <pugixml.hpp>
 #include <cstdlib>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
 
@@ -41,6 +43,28 @@ pugi::xml_document readXmlDocument(const std::string &filename) {
   return doc;
 }
 
+XmlDocumentCache::XmlDocumentCache(Reader reader)
+    : mReader(std::move(reader)) {}
+
+pugi::xml_document XmlDocumentCache::get(const std::string &filename) {
+  std::scoped_lock lock{mMtx};
+  auto it{mDocuments.find(filename)};
+  if (it == mDocuments.end()) {
+    it = mDocuments.emplace(filename, mReader(filename)).first;
+  }
+
+  pugi::xml_document doc{};
+  doc.reset(it->second);
+  return doc;
+}
+
+pugi::xml_document readCachedXmlDocument(const std::string &filename) {
+  static XmlDocumentCache cache{[](const std::string &name) {
+    return gui::readXmlDocument(name);
+  }};
+  return cache.get(filename);
+}
+
 void processIncludes(pugi::xml_document &doc) {
   gui::preOrderDFS(doc, [](pugi::xml_node &node) -> bool {
     if (node.name() != std::string{"include"}) return true;
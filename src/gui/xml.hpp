@@ -3,6 +3,9 @@
 
 #include <boost/optional.hpp>
 #include <pugixml.hpp>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <set>
 #include <string>
 
@@ -23,6 +26,35 @@ pugi::xml_document readXmlDocument(std::istream &is);
 /// \throws std::runtime_error if the file could not be parsed as an XML file.
 pugi::xml_document readXmlDocument(const std::string &filename);
 
+/// Cache of parsed XML documents, keyed by filename.
+/// Each file is only read and parsed the first time it is requested, and later
+/// requests copy the parsed document, which is much cheaper. Changes to the
+/// file after it is first requested are therefore not seen.
+/// This class is thread-safe.
+class XmlDocumentCache {
+ public:
+  /// Function reading and parsing the XML document with the given filename.
+  using Reader = std::function<pugi::xml_document(const std::string &)>;
+
+  explicit XmlDocumentCache(Reader reader);
+
+  /// Return a copy of `reader(filename)`, calling `reader` only if the
+  /// document is not already cached.
+  /// \throws Anything thrown by `reader`, in which case nothing is cached.
+  pugi::xml_document get(const std::string &filename);
+
+ private:
+  Reader mReader;
+  std::mutex mMtx{};
+  std::map<std::string, pugi::xml_document, std::less<>> mDocuments{};
+};
+
+/// Return a copy of `gui::readXmlDocument(filename)`, using a global
+/// `gui::XmlDocumentCache`.
+/// \throws std::runtime_error if the file could not be loaded.
+/// \throws std::runtime_error if the file could not be parsed as an XML file.
+pugi::xml_document readCachedXmlDocument(const std::string &filename);
+
 /// Recursively process any `<include>` tags in the `doc`, modifying it in
 /// place. The `src` of the `<include>` is interpreted relative to the
 /// `menus/prefabs` directory, and is passed to
@@ -25,7 +25,8 @@ std::string io::readBString(std::istream &s) {
 }
 
 std::ostream &io::writeBzString(std::ostream &os, const std::string &s) {
-  os.put(static_cast<uint8_t>(s.length()));
+  // Like readBzString, the length includes the null-terminator.
+  os.put(static_cast<uint8_t>(s.length() + 1u));
   os.write(s.data(), s.length());
   os.put('\0');
   return os;
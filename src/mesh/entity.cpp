@@ -1,7 +1,12 @@
 #include "mesh/entity.hpp"
 #include "mesh/mesh_manager.hpp"
 #include "mesh/subentity.hpp"
+#include "mesh/submesh.hpp"
+#include "ogre/occlusion_culler.hpp"
+#include "ogre/texture_streamer.hpp"
 #include <boost/range/adaptor/indexed.hpp>
+#include <OgreAnimationState.h>
+#include <OgreCamera.h>
 #include <OgreLogManager.h>
 #include <OgreOptimisedUtil.h>
 #include <OgreRoot.h>
@@ -10,6 +15,10 @@
 #include <OgreSkeletonManager.h>
 #include <OgreTagPoint.h>
 #include <OgreSkeletonInstance.h>
+#include <OgreViewport.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace oo {
 
@@ -26,6 +35,16 @@ class SkeletonState {
   std::vector<Ogre::Affine3, oo::Affine3Allocator> mBoneMatrices{};
   /// The frame that animations were last updated.
   uint64_t mFrameLastUpdated{};
+  /// Binding pose of the skeleton, created with the first `oo::PoseJob`.
+  std::shared_ptr<const oo::BindPose> mBindPose{};
+  /// Pose of the skeleton relative to each bone's parent, as last evaluated
+  /// by an `oo::PoseJob`.
+  oo::Pose mLocalPose{};
+  /// Temporary storage for `oo::evaluatePose()`.
+  oo::Pose mScratchPose{};
+  /// Whether `mLocalPose` has been evaluated but not yet copied into the bones
+  /// of `mSkeleton`.
+  bool mIsPoseUnsynced{false};
 
   /// Utility method to copy a SkeletonInstance. Have to go the long way round
   /// as SkeletonInstance doesn't have a copy constructor.
@@ -47,7 +66,8 @@ class SkeletonState {
       : mSkeleton(getSkeletonByHandle(other.mSkeleton.getHandle())),
         mAnimationStateSet(other.mAnimationStateSet),
         mBoneMatrices(other.mBoneMatrices),
-        mFrameLastUpdated(other.mFrameLastUpdated) {
+        mFrameLastUpdated(other.mFrameLastUpdated),
+        mBindPose(other.mBindPose) {
     mSkeleton.load();
     mSkeleton._initAnimationState(&mAnimationStateSet);
   }
@@ -74,6 +94,20 @@ class SkeletonState {
     mSkeleton._getBoneMatrices(mBoneMatrices.data());
     mFrameLastUpdated = mAnimationStateSet.getDirtyFrameNumber();
   }
+
+  /// Copy the pose evaluated by an `oo::PoseJob` into the bones of the
+  /// skeleton, so that objects attached to the bones follow them.
+  void syncBones() {
+    for (uint16_t h = 0; h < mLocalPose.size(); ++h) {
+      auto *bone{mSkeleton.getBone(h)};
+      const auto &p{mLocalPose};
+      bone->setPosition(p.tx[h], p.ty[h], p.tz[h]);
+      bone->setOrientation(Ogre::Quaternion{p.rw[h], p.rx[h], p.ry[h],
+                                            p.rz[h]}.normalisedCopy());
+      bone->setScale(p.sx[h], p.sy[h], p.sz[h]);
+    }
+    mIsPoseUnsynced = false;
+  }
 };
 
 Entity::Entity(const std::string &name, oo::MeshPtr mesh)
@@ -194,11 +228,96 @@ void Entity::_notifyCurrentCamera(Ogre::Camera *camera) {
 
   if (mParentNode) {
     for (auto &subEntity : mSubEntityList) subEntity->_invalidateCameraCache();
+
+    // Choose the level of detail using the LOD camera, which differs from the
+    // current camera when rendering shadows, so that shadows match what is
+    // visible.
+    mLodIndex = mMesh->getNumLodLevels() > 1u
+                ? mMesh->getLodIndex(getScreenSize(*camera->getLodCamera()))
+                : 0u;
+
+    // Tell the streamer how much texture detail is visible, ignoring shadow
+    // cameras since they don't sample the textures.
+    auto *streamer{oo::TextureStreamer::getSingletonPtr()};
+    auto *viewport{camera->getViewport()};
+    if (streamer && viewport && camera->getLodCamera() == camera) {
+      const float pixels{getScreenSize(*camera)
+                             * static_cast<float>(viewport->getActualHeight())};
+      for (const auto &subEntity : mSubEntityList) {
+        if (const auto &material{subEntity->getMaterial()}) {
+          streamer->requestMaterial(*material, pixels);
+        }
+      }
+    }
+
+    updateOcclusion(*camera);
   }
 
   for (auto &[k, v] : mChildObjectList) v->_notifyCurrentCamera(camera);
 }
 
+void Entity::updateOcclusion(const Ogre::Camera &camera) {
+  mIsOccluded = false;
+  for (auto &subEntity : mSubEntityList) subEntity->mIsOccluded = false;
+
+  auto *culler{oo::OcclusionCuller::getSingletonPtr()};
+  if (!culler) return;
+
+  // The culler ignores both of these unless `camera` is the one it is culling
+  // for, so shadow cameras are never affected.
+  // The camera may be notified more than once a frame, such as by each
+  // visibility pass of the deferred pipeline, but the occluder only needs to
+  // be drawn once.
+  const auto &xform{_getParentNodeFullTransform()};
+  const auto frameNumber{Ogre::Root::getSingleton().getNextFrameNumber()};
+  if (!hasSkeleton() && frameNumber != mOccluderFrameNumber) {
+    const auto &triangles{mMesh->getOccluderTriangles()};
+    if (triangles && culler->addOccluder(camera, triangles, xform,
+                                         getScreenSize(camera))) {
+      mOccluderFrameNumber = frameNumber;
+    }
+  }
+
+  // Entities merged into a static batch or instanced geometry have no
+  // visibility flags and are never drawn themselves, so need not be tested.
+  if (getVisibilityFlags() == 0u) return;
+  mIsOccluded = culler->isOccluded(camera, getWorldBoundingBox(true));
+
+  // Submesh bounds are in the bind pose, so are no use for skinned entities.
+  if (mIsOccluded || hasSkeleton() || mSubEntityList.size() < 2u) return;
+  for (auto &subEntity : mSubEntityList) {
+    auto bounds{subEntity->getSubMesh()->bounds};
+    if (!bounds.isFinite()) continue;
+    bounds.transform(xform);
+    subEntity->mIsOccluded = culler->isOccluded(camera, bounds);
+  }
+}
+
+float Entity::getScreenSize(const Ogre::Camera &camera) const {
+  const auto &bounds{mMesh->getBounds()};
+  if (camera.getProjectionType() != Ogre::PT_PERSPECTIVE
+      || !bounds.isFinite()) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  const auto &xform{_getParentNodeFullTransform()};
+  const auto centre{xform * bounds.getCenter()};
+  const auto scale{mParentNode->_getDerivedScale()};
+  const float radius{mMesh->getBoundingSphereRadius()
+                         * std::max({std::abs(scale.x), std::abs(scale.y),
+                                     std::abs(scale.z)})};
+
+  const float dist{centre.distance(camera.getDerivedPosition())};
+  if (dist <= radius) return std::numeric_limits<float>::infinity();
+
+  const float tanHalfFovY{Ogre::Math::Tan(camera.getFOVy() * 0.5f)};
+  return radius / (dist * tanHalfFovY) * camera.getLodBias();
+}
+
+std::size_t Entity::getCurrentLodIndex() const noexcept {
+  return mLodIndex;
+}
+
 const Ogre::AxisAlignedBox &Entity::getBoundingBox() const {
   if (!mMesh->isLoaded()) {
     mFullAABB.setNull();
@@ -242,7 +361,7 @@ float Entity::getBoundingRadius() const {
 }
 
 void Entity::_updateRenderQueue(Ogre::RenderQueue *queue) {
-  if (!mIsInitialised) return;
+  if (!mIsInitialised || mIsOccluded) return;
   if (mMeshStateCount != mMesh->getStateCount()) _initialise(true);
 
   // This is subtly different to Ogre but I think easier to read; if rend has a
@@ -263,7 +382,7 @@ void Entity::_updateRenderQueue(Ogre::RenderQueue *queue) {
   };
 
   for (const auto &subEntity : mSubEntityList) {
-    if (!subEntity->isVisible()) continue;
+    if (!subEntity->isVisible() || subEntity->mIsOccluded) continue;
     auto *rend{subEntity.get()};
     queue->addRenderable(rend, getQueue(queue, rend), getPriority(queue, rend));
   }
@@ -303,6 +422,13 @@ void Entity::updateAnimation() {
   if (isAnimationDirty) {
     mSkeletonState->updateBoneMatrices();
     if (!mChildObjectList.empty()) mParentNode->needUpdate();
+  } else if (mSkeletonState && mSkeletonState->mIsPoseUnsynced
+      && !mChildObjectList.empty()) {
+    // The bone matrices were updated by an oo::PoseJob, but the bones were
+    // not since that would not be thread-safe. Only attached objects need the
+    // bones every frame; anything else gets them synced by getSkeleton().
+    mSkeletonState->syncBones();
+    mParentNode->needUpdate();
   }
 
   // If this entity shares its skeleton then it another entity might have
@@ -357,6 +483,50 @@ void Entity::_updateAnimation() {
   if (mSkeletonState) updateAnimation();
 }
 
+std::optional<oo::PoseJob> Entity::_createPoseJob() {
+  if (!mIsInitialised || !mSkeletonState) return std::nullopt;
+  auto &state{*mSkeletonState};
+  if (!state.isAnimationDirty() || state.mSkeleton.hasManualBones()) {
+    return std::nullopt;
+  }
+
+  const auto &skelName{state.mSkeleton.getName()};
+  oo::PoseJob job{};
+
+  float totalWeight{0.0f};
+  for (auto *animState : state.mAnimationStateSet.getEnabledAnimationStates()) {
+    if (animState->hasBlendMask()) return std::nullopt;
+    auto clip{oo::AnimationClipRegistry::get(skelName,
+                                             animState->getAnimationName())};
+    if (!clip) return std::nullopt;
+    job.mLayers.push_back({std::move(clip), animState->getTimePosition(),
+                           animState->getWeight()});
+    totalWeight += animState->getWeight();
+  }
+
+  // Same weight normalization as Ogre::Skeleton::setAnimationState().
+  if (state.mSkeleton.getBlendMode() == Ogre::ANIMBLEND_AVERAGE
+      && totalWeight > 1.0f) {
+    for (auto &layer : job.mLayers) layer.weight /= totalWeight;
+  }
+
+  if (!state.mBindPose) {
+    state.mBindPose = std::make_shared<const oo::BindPose>(state.mSkeleton);
+  }
+
+  job.mState = mSkeletonState;
+  job.mFrameNumber = state.mAnimationStateSet.getDirtyFrameNumber();
+  return job;
+}
+
+void PoseJob::run() {
+  auto &state{*mState};
+  oo::evaluatePose(*state.mBindPose, mLayers, state.mLocalPose,
+                   state.mScratchPose, state.mBoneMatrices.data());
+  state.mFrameLastUpdated = mFrameNumber;
+  state.mIsPoseUnsynced = true;
+}
+
 bool Entity::_isAnimated() const {
   return mSkeletonState && (mSkeletonState->mSkeleton.hasManualBones()
       || mSkeletonState->mAnimationStateSet.hasEnabledAnimationState());
@@ -372,6 +542,11 @@ bool Entity::hasSkeleton() const {
 }
 
 Ogre::SkeletonInstance *Entity::getSkeleton() const {
+  // Bones are only synced in updateAnimation() if objects are attached to
+  // them, so callers reading the bones need them synced here.
+  if (mSkeletonState && mSkeletonState->mIsPoseUnsynced) {
+    mSkeletonState->syncBones();
+  }
   return &mSkeletonState->mSkeleton;
 }
 
@@ -437,6 +612,10 @@ Entity::attachObjectToBone(const std::string &boneName,
                 "Entity::attachObjectToBone");
   }
 
+  // The tag point takes the transform of the bone, which may be behind the
+  // evaluated pose if nothing was attached before.
+  if (mSkeletonState->mIsPoseUnsynced) mSkeletonState->syncBones();
+
   auto *bone{mSkeletonState->getBone(boneName)};
   if (!bone) {
     OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS,
@@ -0,0 +1,513 @@
+#include "mesh/instanced_geometry.hpp"
+#include "mesh/subentity.hpp"
+#include <OgreCamera.h>
+#include <OgreHardwareBufferManager.h>
+#include <OgreMaterialManager.h>
+#include <OgrePass.h>
+#include <OgreRenderQueue.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <OgreTechnique.h>
+#include <algorithm>
+#include <cmath>
+
+namespace oo {
+
+namespace {
+
+/// Name of the vertex program used by the materials of static geometry.
+/// \see shaders.program
+constexpr const char *STATIC_VERTEX_PROGRAM{"genericMaterial_vs_glsl"};
+
+/// Name of the vertex program used to draw instanced static geometry, which
+/// reads the per-instance transformation from texture coordinates 1 through 3.
+/// \see shaders.program
+constexpr const char *INSTANCED_VERTEX_PROGRAM{
+    "genericInstancedMaterial_vs_glsl"
+};
+
+/// Suffix appended to the name of a material to get the name of its instanced
+/// counterpart.
+constexpr const char *INSTANCED_MATERIAL_SUFFIX{"/Instanced"};
+
+/// Vertex buffer source that the instance buffer is bound to.
+constexpr unsigned short INSTANCE_SOURCE{1u};
+
+/// Index of the first texture coordinate used to hold the per-instance
+/// transformation.
+constexpr unsigned short INSTANCE_TEXCOORD{1u};
+
+/// Number of floats of instance data per instance; the top three rows of the
+/// transformation matrix.
+constexpr std::size_t INSTANCE_FLOATS{12u};
+
+/// Return whether the vertex data of `subMesh` leaves room for the instance
+/// data, namely that it only uses a single buffer and does not use any of the
+/// texture coordinates needed by the instance buffer.
+bool hasRoomForInstanceData(const oo::SubMesh &subMesh) {
+  const auto &vertexData{*subMesh.vertexData};
+  if (vertexData.vertexBufferBinding->getBufferCount() != 1) return false;
+
+  const auto &elems{vertexData.vertexDeclaration->getElements()};
+  return std::none_of(elems.begin(), elems.end(), [](const auto &elem) {
+    return elem.getSource() == INSTANCE_SOURCE
+        || (elem.getSemantic() == Ogre::VES_TEXTURE_COORDINATES
+            && elem.getIndex() >= INSTANCE_TEXCOORD);
+  });
+}
+
+} // namespace
+
+InstancedGeometry::InstancedGeometry(const std::string &name)
+    : MovableObject(name) {}
+
+InstancedGeometry::~InstancedGeometry() = default;
+
+bool InstancedGeometry::isInstanceable(const oo::Entity &entity) {
+  if (!entity.isInitialised() || entity.hasSkeleton()) return false;
+
+  const auto &subEntities{entity.getSubEntities()};
+  return !subEntities.empty() && std::all_of(
+      subEntities.begin(), subEntities.end(), [](const auto &subEntity) {
+        const oo::SubMesh *subMesh{subEntity->getSubMesh()};
+        const auto &mat{subEntity->getMaterial()};
+        const auto op{subMesh->operationType};
+
+        return mat && !mat->isTransparent()
+            && subMesh->boneNames.empty()
+            && subMesh->vertexData && subMesh->indexData
+            && subMesh->indexData->indexCount > 0
+            && hasRoomForInstanceData(*subMesh)
+            && (op == Ogre::RenderOperation::OT_TRIANGLE_LIST
+                || op == Ogre::RenderOperation::OT_TRIANGLE_STRIP)
+            && getInstancedMaterial(mat);
+      });
+}
+
+Ogre::MaterialPtr
+InstancedGeometry::getInstancedMaterial(const Ogre::MaterialPtr &mat) {
+  if (!mat) return nullptr;
+
+  auto &matMgr{Ogre::MaterialManager::getSingleton()};
+  const std::string name{mat->getName() + INSTANCED_MATERIAL_SUFFIX};
+  const std::string &group{mat->getGroup()};
+  if (auto instancedMat{matMgr.getByName(name, group)}) return instancedMat;
+
+  // Every pass must use the static vertex shader, otherwise we don't know how
+  // to give it the instance data.
+  for (const auto *technique : mat->getTechniques()) {
+    for (const auto *pass : technique->getPasses()) {
+      if (!pass->hasVertexProgram()
+          || pass->getVertexProgramName() != STATIC_VERTEX_PROGRAM) {
+        return nullptr;
+      }
+    }
+  }
+
+  using AutoConst = Ogre::GpuProgramParameters::AutoConstantType;
+  auto instancedMat{mat->clone(name, /*changeGroup=*/true, group)};
+  for (auto *technique : instancedMat->getTechniques()) {
+    for (auto *pass : technique->getPasses()) {
+      pass->setVertexProgram(INSTANCED_VERTEX_PROGRAM, true);
+      auto vsParams{pass->getVertexProgramParameters()};
+      vsParams->setNamedAutoConstant("world",
+                                     AutoConst::ACT_WORLD_MATRIX);
+      vsParams->setNamedAutoConstant("viewProj",
+                                     AutoConst::ACT_VIEWPROJ_MATRIX);
+    }
+  }
+  instancedMat->load();
+
+  return instancedMat;
+}
+
+InstancedGeometry::BatchKey
+InstancedGeometry::getBatchKey(const oo::SubMesh *subMesh,
+                               const Ogre::Material *material,
+                               const Ogre::Affine3 &transform) const {
+  // Ogre is y-up, so the horizontal plane is the xz-plane.
+  const auto pos{transform.getTrans()};
+  const auto bx{static_cast<int>(std::floor(pos.x / mBucketSize))};
+  const auto bz{static_cast<int>(std::floor(pos.z / mBucketSize))};
+  return {subMesh, material, bx, bz};
+}
+
+bool InstancedGeometry::addEntity(const oo::Entity &entity,
+                                  const Ogre::Affine3 &transform,
+                                  OwnerId owner) {
+  if (!isInstanceable(entity)) return false;
+
+  for (const auto &subEntity : entity.getSubEntities()) {
+    if (!subEntity->isVisible()) continue;
+
+    oo::SubMesh *subMesh{subEntity->getSubMesh()};
+    auto material{getInstancedMaterial(subEntity->getMaterial())};
+    const auto key{getBatchKey(subMesh, material.get(), transform)};
+
+    auto it{mBatches.find(key)};
+    if (it == mBatches.end()) {
+      auto batch{std::make_unique<Batch>(this, entity.getMesh(), subMesh,
+                                         std::move(material))};
+      it = mBatches.emplace(key, std::move(batch)).first;
+    }
+
+    it->second->addInstance(transform, owner);
+  }
+
+  // Adding can only grow the bounds, so avoid recomputing them from scratch.
+  auto bounds{entity.getMesh()->getBounds()};
+  bounds.transform(transform);
+  mAABB.merge(bounds);
+  mBoundRadius = Ogre::Math::boundingRadiusFromAABB(mAABB);
+  if (mParentNode) getParentSceneNode()->needUpdate();
+
+  return true;
+}
+
+void InstancedGeometry::removeOwner(OwnerId owner) {
+  bool removed{false};
+  for (auto it{mBatches.begin()}; it != mBatches.end();) {
+    auto &batch{it->second};
+    if (batch->removeOwner(owner)) {
+      removed = true;
+      if (batch->getNumInstances() == 0) {
+        it = mBatches.erase(it);
+        continue;
+      }
+    }
+    ++it;
+  }
+
+  mDisabledOwners.erase(owner);
+  if (removed) updateBounds();
+}
+
+void InstancedGeometry::setOwnerEnabled(OwnerId owner, bool enabled) {
+  if (enabled == isOwnerEnabled(owner)) return;
+
+  if (enabled) mDisabledOwners.erase(owner);
+  else mDisabledOwners.insert(owner);
+
+  for (auto &[_, batch] : mBatches) {
+    if (batch->hasOwner(owner)) batch->markDirty();
+  }
+}
+
+bool InstancedGeometry::isOwnerEnabled(OwnerId owner) const {
+  //C++20: return !mDisabledOwners.contains(owner);
+  return mDisabledOwners.find(owner) == mDisabledOwners.end();
+}
+
+bool InstancedGeometry::hasMesh(const oo::Mesh &mesh) const {
+  return std::any_of(mBatches.begin(), mBatches.end(), [&](const auto &p) {
+    return p.second->mMesh.get() == &mesh;
+  });
+}
+
+void InstancedGeometry::setBucketSize(float bucketSize) {
+  if (bucketSize == mBucketSize) return;
+  mBucketSize = bucketSize;
+
+  BatchMap oldBatches{};
+  std::swap(oldBatches, mBatches);
+
+  for (auto &[_, oldBatch] : oldBatches) {
+    for (const auto &instance : oldBatch->mInstances) {
+      const auto key{getBatchKey(oldBatch->mSubMesh,
+                                 oldBatch->mMaterial.get(),
+                                 instance.mTransform)};
+      auto it{mBatches.find(key)};
+      if (it == mBatches.end()) {
+        auto batch{std::make_unique<Batch>(this, oldBatch->mMesh,
+                                           oldBatch->mSubMesh,
+                                           oldBatch->mMaterial)};
+        it = mBatches.emplace(key, std::move(batch)).first;
+      }
+      it->second->addInstance(instance.mTransform, instance.mOwner);
+    }
+  }
+}
+
+float InstancedGeometry::getBucketSize() const noexcept {
+  return mBucketSize;
+}
+
+void InstancedGeometry::updateBounds() {
+  // The bounds include disabled owners too, otherwise the object could be
+  // culled before its batches get the chance to be updated.
+  mAABB.setNull();
+  for (const auto &[_, batch] : mBatches) {
+    mAABB.merge(batch->getFullBoundingBox());
+  }
+  mBoundRadius = mAABB.isFinite() ? Ogre::Math::boundingRadiusFromAABB(mAABB)
+                                  : 0.0f;
+  if (mParentNode) getParentSceneNode()->needUpdate();
+}
+
+std::size_t InstancedGeometry::getNumBatches() const noexcept {
+  return mBatches.size();
+}
+
+std::size_t InstancedGeometry::getNumVisibleBatches() const noexcept {
+  return mNumVisibleBatches;
+}
+
+std::size_t InstancedGeometry::getNumInstances() const noexcept {
+  std::size_t numInstances{0u};
+  for (const auto &[_, batch] : mBatches) {
+    numInstances += batch->getNumInstances();
+  }
+  return numInstances;
+}
+
+//===----------------------------------------------------------------------===//
+// MovableObject overrides
+//===----------------------------------------------------------------------===//
+
+void InstancedGeometry::_notifyCurrentCamera(Ogre::Camera *camera) {
+  MovableObject::_notifyCurrentCamera(camera);
+  mCullCamera = camera;
+}
+
+const Ogre::AxisAlignedBox &InstancedGeometry::getBoundingBox() const {
+  return mAABB;
+}
+
+float InstancedGeometry::getBoundingRadius() const {
+  return mBoundRadius;
+}
+
+void InstancedGeometry::_updateRenderQueue(Ogre::RenderQueue *queue) {
+  const auto &xform{_getParentNodeFullTransform()};
+  mNumVisibleBatches = 0u;
+
+  for (const auto &[_, batch] : mBatches) {
+    batch->update();
+    if (batch->getNumEnabledInstances() == 0u) continue;
+
+    if (mCullCamera) {
+      auto bounds{batch->getBoundingBox()};
+      bounds.transform(xform);
+      if (!mCullCamera->isVisible(bounds)) continue;
+    }
+
+    ++mNumVisibleBatches;
+    if (mRenderQueueIDSet) {
+      if (mRenderQueuePrioritySet) {
+        queue->addRenderable(batch.get(), mRenderQueueID, mRenderQueuePriority);
+      } else {
+        queue->addRenderable(batch.get(), mRenderQueueID);
+      }
+    } else {
+      queue->addRenderable(batch.get());
+    }
+  }
+}
+
+const std::string &InstancedGeometry::getMovableType() const {
+  const static std::string
+      typeName{InstancedGeometryFactory::FACTORY_TYPE_NAME};
+  return typeName;
+}
+
+uint32_t InstancedGeometry::getTypeFlags() const {
+  return Ogre::SceneManager::STATICGEOMETRY_TYPE_MASK;
+}
+
+void InstancedGeometry::visitRenderables(Ogre::Renderable::Visitor *visitor,
+                                         bool) {
+  for (auto &[_, batch] : mBatches) visitor->visit(batch.get(), 0, false);
+}
+
+//===----------------------------------------------------------------------===//
+// Batch definitions
+//===----------------------------------------------------------------------===//
+
+InstancedGeometry::Batch::Batch(oo::InstancedGeometry *parent,
+                                oo::MeshPtr mesh,
+                                oo::SubMesh *subMesh,
+                                Ogre::MaterialPtr material)
+    : mParent(parent),
+      mMesh(std::move(mesh)),
+      mSubMesh(subMesh),
+      mMaterial(std::move(material)),
+      mVertexData(subMesh->vertexData->clone(/*copyData=*/false)) {
+  // The clone shares the submesh's vertex buffer, so we just need to describe
+  // the instance data; the buffer itself is created on the first update.
+  auto *decl{mVertexData->vertexDeclaration};
+  std::size_t offset{0u};
+  for (unsigned short i = 0; i < 3u; ++i) {
+    decl->addElement(INSTANCE_SOURCE, offset, Ogre::VET_FLOAT4,
+                     Ogre::VES_TEXTURE_COORDINATES, INSTANCE_TEXCOORD + i);
+    offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT4);
+  }
+}
+
+InstancedGeometry::Batch::~Batch() = default;
+
+void InstancedGeometry::Batch::addInstance(const Ogre::Affine3 &transform,
+                                           OwnerId owner) {
+  mInstances.push_back(Instance{transform, owner});
+
+  auto bounds{mMesh->getBounds()};
+  bounds.transform(transform);
+  mFullAABB.merge(bounds);
+
+  markDirty();
+}
+
+bool InstancedGeometry::Batch::removeOwner(OwnerId owner) {
+  auto it{std::remove_if(mInstances.begin(), mInstances.end(),
+                         [owner](const Instance &instance) {
+                           return instance.mOwner == owner;
+                         })};
+  if (it == mInstances.end()) return false;
+
+  mInstances.erase(it, mInstances.end());
+
+  mFullAABB.setNull();
+  const auto &meshBounds{mMesh->getBounds()};
+  for (const auto &instance : mInstances) {
+    auto bounds{meshBounds};
+    bounds.transform(instance.mTransform);
+    mFullAABB.merge(bounds);
+  }
+
+  markDirty();
+  return true;
+}
+
+bool InstancedGeometry::Batch::hasOwner(OwnerId owner) const {
+  return std::any_of(mInstances.begin(), mInstances.end(),
+                     [owner](const Instance &instance) {
+                       return instance.mOwner == owner;
+                     });
+}
+
+void InstancedGeometry::Batch::markDirty() noexcept {
+  mIsDirty = true;
+}
+
+void InstancedGeometry::Batch::update() {
+  if (!mIsDirty) return;
+  mIsDirty = false;
+
+  std::vector<float> data{};
+  data.reserve(mInstances.size() * INSTANCE_FLOATS);
+  mAABB.setNull();
+  const auto &meshBounds{mMesh->getBounds()};
+
+  for (const auto &instance : mInstances) {
+    if (!mParent->isOwnerEnabled(instance.mOwner)) continue;
+
+    const auto &m{instance.mTransform};
+    for (std::size_t row = 0; row < 3u; ++row) {
+      data.insert(data.end(), {m[row][0], m[row][1], m[row][2], m[row][3]});
+    }
+
+    auto bounds{meshBounds};
+    bounds.transform(m);
+    mAABB.merge(bounds);
+  }
+
+  mNumEnabledInstances = data.size() / INSTANCE_FLOATS;
+  if (mNumEnabledInstances == 0u) return;
+
+  // Grow the buffer geometrically so that cells streaming in one at a time
+  // don't cause a reallocation every time.
+  if (!mInstanceBuffer || mInstanceBuffer->getNumVertices()
+      < mNumEnabledInstances) {
+    std::size_t capacity{mInstanceBuffer ? mInstanceBuffer->getNumVertices()
+                                         : std::size_t{16u}};
+    while (capacity < mNumEnabledInstances) capacity *= 2u;
+
+    auto *hwBufMgr{Ogre::HardwareBufferManager::getSingletonPtr()};
+    mInstanceBuffer = hwBufMgr->createVertexBuffer(
+        INSTANCE_FLOATS * sizeof(float), capacity,
+        Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+    mInstanceBuffer->setIsInstanceData(true);
+    mInstanceBuffer->setInstanceDataStepRate(1u);
+    mVertexData->vertexBufferBinding->setBinding(INSTANCE_SOURCE,
+                                                 mInstanceBuffer);
+  }
+
+  mInstanceBuffer->writeData(0, data.size() * sizeof(float), data.data(),
+                             /*discardWholeBuffer=*/true);
+}
+
+std::size_t InstancedGeometry::Batch::getNumInstances() const noexcept {
+  return mInstances.size();
+}
+
+std::size_t InstancedGeometry::Batch::getNumEnabledInstances() const noexcept {
+  return mNumEnabledInstances;
+}
+
+const Ogre::AxisAlignedBox &
+InstancedGeometry::Batch::getBoundingBox() const noexcept {
+  return mAABB;
+}
+
+const Ogre::AxisAlignedBox &
+InstancedGeometry::Batch::getFullBoundingBox() const noexcept {
+  return mFullAABB;
+}
+
+const Ogre::MaterialPtr &InstancedGeometry::Batch::getMaterial() const {
+  return mMaterial;
+}
+
+Ogre::Technique *InstancedGeometry::Batch::getTechnique() const {
+  return mMaterial->getBestTechnique(0, this);
+}
+
+void InstancedGeometry::Batch::getRenderOperation(Ogre::RenderOperation &op) {
+  op.operationType = mSubMesh->operationType;
+  op.vertexData = mVertexData.get();
+  op.indexData = mSubMesh->indexData.get();
+  op.useIndexes = true;
+  op.numberOfInstances = mNumEnabledInstances;
+  op.srcRenderable = this;
+}
+
+void InstancedGeometry::Batch::getWorldTransforms(Ogre::Matrix4 *xform) const {
+  *xform = mParent->_getParentNodeFullTransform();
+}
+
+float InstancedGeometry::Batch::getSquaredViewDepth(
+    const Ogre::Camera *camera) const {
+  // Only opaque materials are instanced so sorting isn't important.
+  const auto &xform{mParent->_getParentNodeFullTransform()};
+  const Ogre::Vector3 centre{xform * mAABB.getCenter()};
+  return centre.squaredDistance(camera->getDerivedPosition());
+}
+
+const Ogre::LightList &InstancedGeometry::Batch::getLights() const {
+  return mParent->queryLights();
+}
+
+bool InstancedGeometry::Batch::getCastsShadows() const {
+  return mParent->getCastShadows();
+}
+
+//===----------------------------------------------------------------------===//
+// InstancedGeometryFactory definitions
+//===----------------------------------------------------------------------===//
+
+void InstancedGeometryFactory::destroyInstance(
+    gsl::owner<Ogre::MovableObject *> obj) {
+  OGRE_DELETE obj;
+}
+
+const std::string &InstancedGeometryFactory::getType() const {
+  const static std::string typeName{FACTORY_TYPE_NAME};
+  return typeName;
+}
+
+gsl::owner<Ogre::MovableObject *>
+InstancedGeometryFactory::createInstanceImpl(const std::string &name,
+                                             const Ogre::NameValuePairList *) {
+  return OGRE_NEW oo::InstancedGeometry(name);
+}
+
+} // namespace oo
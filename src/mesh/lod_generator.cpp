@@ -0,0 +1,389 @@
+#include "mesh/lod_generator.hpp"
+#include <OgreVector.h>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <queue>
+#include <tuple>
+
+namespace oo {
+
+namespace {
+
+/// Symmetric 4x4 matrix measuring the sum of squared distances from a point to
+/// a set of planes. Only the upper triangle is stored.
+class Quadric {
+ public:
+  Quadric() = default;
+
+  /// Quadric of the plane with unit normal `n` through the point `p`, scaled
+  /// by `weight`.
+  Quadric(const Ogre::Vector3 &n, const Ogre::Vector3 &p, double weight) {
+    const double a{n.x}, b{n.y}, c{n.z};
+    const double d{-n.dotProduct(p)};
+    mQ = {a * a, a * b, a * c, a * d,
+          b * b, b * c, b * d,
+          c * c, c * d,
+          d * d};
+    for (auto &q : mQ) q *= weight;
+  }
+
+  Quadric &operator+=(const Quadric &other) noexcept {
+    for (std::size_t i = 0; i < mQ.size(); ++i) mQ[i] += other.mQ[i];
+    return *this;
+  }
+
+  /// Return the sum of the weighted squared distances from `p` to the planes.
+  double evaluate(const Ogre::Vector3 &p) const noexcept {
+    const double x{p.x}, y{p.y}, z{p.z};
+    return mQ[0] * x * x + 2.0 * mQ[1] * x * y + 2.0 * mQ[2] * x * z
+        + 2.0 * mQ[3] * x + mQ[4] * y * y + 2.0 * mQ[5] * y * z
+        + 2.0 * mQ[6] * y + mQ[7] * z * z + 2.0 * mQ[8] * z + mQ[9];
+  }
+
+ private:
+  std::array<double, 10> mQ{};
+};
+
+/// Weight of the planes added along boundary edges, relative to the area
+/// weighting of the face planes. Boundary edges have no neighbouring face to
+/// stop them from being collapsed inwards, so without this the silhouettes of
+/// open meshes such as foliage are quickly eaten away.
+constexpr double BOUNDARY_WEIGHT{1000.0};
+
+/// Collapses that rotate a face normal by more than this are rejected, as the
+/// face would fold over its neighbours. This is the cosine of the angle.
+constexpr float MAX_FLIP_COSINE{0.2f};
+
+struct Triangle {
+  /// Original vertex indices.
+  std::array<uint16_t, 3> corners{};
+  /// Welded vertex indices, updated as edges are collapsed.
+  std::array<uint32_t, 3> welded{};
+  bool alive{true};
+};
+
+/// Candidate collapse of the welded vertex `from` onto the welded vertex `to`.
+struct Collapse {
+  double cost{};
+  uint32_t from{};
+  uint32_t to{};
+  /// Versions of `from` and `to` when the collapse was computed, so that
+  /// collapses made stale by other collapses can be discarded.
+  uint32_t fromVersion{};
+  uint32_t toVersion{};
+
+  friend bool operator>(const Collapse &a, const Collapse &b) noexcept {
+    return a.cost > b.cost;
+  }
+};
+
+class Simplifier {
+ public:
+  Simplifier(gsl::span<const float> vertices, std::size_t stride,
+             gsl::span<const uint16_t> indices);
+
+  std::vector<uint16_t> simplify(std::size_t targetTriangles);
+
+ private:
+  gsl::span<const float> mVertices;
+  std::size_t mStride;
+
+  /// Welded vertex of each original vertex.
+  std::vector<uint32_t> mWeldedIndex{};
+  /// Original vertices of each welded vertex.
+  std::vector<std::vector<uint16_t>> mOriginals{};
+  std::vector<Ogre::Vector3> mPositions{};
+  std::vector<Quadric> mQuadrics{};
+  /// Triangles incident to each welded vertex, possibly including triangles
+  /// that are no longer alive or no longer incident.
+  std::vector<std::vector<uint32_t>> mIncident{};
+  /// Welded vertex that each welded vertex has been collapsed onto, or itself.
+  std::vector<uint32_t> mCollapsedTo{};
+  std::vector<uint32_t> mVersions{};
+  std::vector<Triangle> mTriangles{};
+  std::size_t mNumAlive{};
+
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>>
+      mQueue{};
+
+  Ogre::Vector3 getPosition(uint16_t i) const;
+  Ogre::Vector3 getNormal(const Triangle &tri) const;
+
+  void computeQuadrics();
+  void pushCollapses(uint32_t v);
+  bool isValid(const Collapse &c) const;
+  bool flipsTriangle(uint32_t from, uint32_t to) const;
+  void collapse(uint32_t from, uint32_t to);
+
+  uint32_t findCollapsed(uint32_t v) const;
+  /// Return the original vertex of the welded vertex `v` whose attributes are
+  /// closest to those of the original vertex `i`.
+  uint16_t findClosestOriginal(uint32_t v, uint16_t i) const;
+};
+
+Simplifier::Simplifier(gsl::span<const float> vertices, std::size_t stride,
+                       gsl::span<const uint16_t> indices)
+    : mVertices(vertices), mStride(stride) {
+  const auto vertexCount{static_cast<std::size_t>(mVertices.size()) / mStride};
+
+  // Weld vertices with identical positions.
+  std::map<std::tuple<float, float, float>, uint32_t> weldMap{};
+  mWeldedIndex.resize(vertexCount);
+  for (std::size_t i = 0; i < vertexCount; ++i) {
+    const auto p{getPosition(static_cast<uint16_t>(i))};
+    auto[it, inserted]{weldMap.try_emplace(std::make_tuple(p.x, p.y, p.z),
+                                           mPositions.size())};
+    if (inserted) {
+      mPositions.push_back(p);
+      mOriginals.emplace_back();
+    }
+    mWeldedIndex[i] = it->second;
+    mOriginals[it->second].push_back(static_cast<uint16_t>(i));
+  }
+
+  const std::size_t weldedCount{mPositions.size()};
+  mIncident.resize(weldedCount);
+  mVersions.resize(weldedCount);
+  mCollapsedTo.resize(weldedCount);
+  for (uint32_t v = 0; v < weldedCount; ++v) mCollapsedTo[v] = v;
+
+  const auto numIndices{static_cast<std::size_t>(indices.size())};
+  mTriangles.reserve(numIndices / 3u);
+  for (std::size_t i = 0; i + 2u < numIndices; i += 3u) {
+    Triangle tri{};
+    for (std::size_t j = 0; j < 3u; ++j) {
+      tri.corners[j] = indices[i + j];
+      tri.welded[j] = mWeldedIndex[indices[i + j]];
+    }
+    // Triangles that are degenerate after welding contribute nothing.
+    if (tri.welded[0] == tri.welded[1] || tri.welded[1] == tri.welded[2]
+        || tri.welded[0] == tri.welded[2]) {
+      continue;
+    }
+    const auto t{static_cast<uint32_t>(mTriangles.size())};
+    for (auto v : tri.welded) mIncident[v].push_back(t);
+    mTriangles.push_back(tri);
+  }
+  mNumAlive = mTriangles.size();
+}
+
+Ogre::Vector3 Simplifier::getPosition(uint16_t i) const {
+  const auto *p{&mVertices[i * mStride]};
+  return {p[0], p[1], p[2]};
+}
+
+Ogre::Vector3 Simplifier::getNormal(const Triangle &tri) const {
+  const auto &p0{mPositions[tri.welded[0]]};
+  const auto &p1{mPositions[tri.welded[1]]};
+  const auto &p2{mPositions[tri.welded[2]]};
+  return (p1 - p0).crossProduct(p2 - p0);
+}
+
+void Simplifier::computeQuadrics() {
+  mQuadrics.assign(mPositions.size(), Quadric{});
+
+  // Number of triangles sharing each edge, to detect boundary edges.
+  std::map<std::pair<uint32_t, uint32_t>, int> edgeCounts{};
+  auto edgeKey = [](uint32_t a, uint32_t b) {
+    return std::make_pair(std::min(a, b), std::max(a, b));
+  };
+
+  for (const auto &tri : mTriangles) {
+    auto n{getNormal(tri)};
+    // The length of the cross product is twice the area.
+    const double area{0.5 * n.normalise()};
+    const Quadric q{n, mPositions[tri.welded[0]], area};
+    for (auto v : tri.welded) mQuadrics[v] += q;
+    for (std::size_t j = 0; j < 3u; ++j) {
+      ++edgeCounts[edgeKey(tri.welded[j], tri.welded[(j + 1u) % 3u])];
+    }
+  }
+
+  for (const auto &tri : mTriangles) {
+    const auto n{getNormal(tri).normalisedCopy()};
+    for (std::size_t j = 0; j < 3u; ++j) {
+      const auto a{tri.welded[j]}, b{tri.welded[(j + 1u) % 3u]};
+      if (edgeCounts[edgeKey(a, b)] != 1) continue;
+
+      // Plane containing the edge and perpendicular to the face.
+      const auto edge{mPositions[b] - mPositions[a]};
+      auto perp{edge.crossProduct(n)};
+      if (perp.normalise() == 0.0f) continue;
+      const Quadric q{perp, mPositions[a],
+                      BOUNDARY_WEIGHT * edge.squaredLength()};
+      mQuadrics[a] += q;
+      mQuadrics[b] += q;
+    }
+  }
+}
+
+void Simplifier::pushCollapses(uint32_t v) {
+  for (auto t : mIncident[v]) {
+    const auto &tri{mTriangles[t]};
+    if (!tri.alive) continue;
+    for (auto u : tri.welded) {
+      if (u == v) continue;
+      Quadric q{mQuadrics[u]};
+      q += mQuadrics[v];
+      // Collapse whichever way is cheaper.
+      const double costUV{q.evaluate(mPositions[v])};
+      const double costVU{q.evaluate(mPositions[u])};
+      if (costUV <= costVU) {
+        mQueue.push({costUV, u, v, mVersions[u], mVersions[v]});
+      } else {
+        mQueue.push({costVU, v, u, mVersions[v], mVersions[u]});
+      }
+    }
+  }
+}
+
+bool Simplifier::isValid(const Collapse &c) const {
+  return mCollapsedTo[c.from] == c.from && mCollapsedTo[c.to] == c.to
+      && mVersions[c.from] == c.fromVersion && mVersions[c.to] == c.toVersion;
+}
+
+bool Simplifier::flipsTriangle(uint32_t from, uint32_t to) const {
+  for (auto t : mIncident[from]) {
+    const auto &tri{mTriangles[t]};
+    if (!tri.alive) continue;
+    // Triangles containing both endpoints are removed by the collapse.
+    const auto end{tri.welded.end()};
+    if (std::find(tri.welded.begin(), end, to) != end) continue;
+
+    Triangle moved{tri};
+    std::replace(moved.welded.begin(), moved.welded.end(), from, to);
+    const auto before{getNormal(tri).normalisedCopy()};
+    const auto after{getNormal(moved).normalisedCopy()};
+    if (before.dotProduct(after) < MAX_FLIP_COSINE) return true;
+  }
+  return false;
+}
+
+void Simplifier::collapse(uint32_t from, uint32_t to) {
+  for (auto t : mIncident[from]) {
+    auto &tri{mTriangles[t]};
+    if (!tri.alive) continue;
+    std::replace(tri.welded.begin(), tri.welded.end(), from, to);
+    if (tri.welded[0] == tri.welded[1] || tri.welded[1] == tri.welded[2]
+        || tri.welded[0] == tri.welded[2]) {
+      tri.alive = false;
+      --mNumAlive;
+    } else {
+      mIncident[to].push_back(t);
+    }
+  }
+  mIncident[from].clear();
+
+  // Keep the incidence list of `to` from growing without bound.
+  auto &incident{mIncident[to]};
+  incident.erase(std::remove_if(incident.begin(), incident.end(), [&](auto t) {
+    return !mTriangles[t].alive;
+  }), incident.end());
+  std::sort(incident.begin(), incident.end());
+  incident.erase(std::unique(incident.begin(), incident.end()), incident.end());
+
+  mQuadrics[to] += mQuadrics[from];
+  mCollapsedTo[from] = to;
+  ++mVersions[to];
+}
+
+uint32_t Simplifier::findCollapsed(uint32_t v) const {
+  while (mCollapsedTo[v] != v) v = mCollapsedTo[v];
+  return v;
+}
+
+uint16_t Simplifier::findClosestOriginal(uint32_t v, uint16_t i) const {
+  // Compare every attribute other than the position, so that a vertex on the
+  // same side of a texture seam is preferred.
+  auto distance = [&](uint16_t j) {
+    float d{0.0f};
+    for (std::size_t k = 3u; k < mStride; ++k) {
+      const float delta{mVertices[j * mStride + k]
+                            - mVertices[i * mStride + k]};
+      d += delta * delta;
+    }
+    return d;
+  };
+
+  const auto &originals{mOriginals[v]};
+  return *std::min_element(originals.begin(), originals.end(),
+                           [&](auto a, auto b) {
+                             return distance(a) < distance(b);
+                           });
+}
+
+std::vector<uint16_t> Simplifier::simplify(std::size_t targetTriangles) {
+  computeQuadrics();
+  for (uint32_t v = 0; v < mPositions.size(); ++v) pushCollapses(v);
+
+  while (mNumAlive > targetTriangles && !mQueue.empty()) {
+    const auto c{mQueue.top()};
+    mQueue.pop();
+    if (!isValid(c) || flipsTriangle(c.from, c.to)) continue;
+    collapse(c.from, c.to);
+    pushCollapses(c.to);
+  }
+
+  std::vector<uint16_t> indices{};
+  indices.reserve(3u * mNumAlive);
+  for (const auto &tri : mTriangles) {
+    if (!tri.alive) continue;
+    for (auto i : tri.corners) {
+      const auto v{findCollapsed(mWeldedIndex[i])};
+      indices.push_back(v == mWeldedIndex[i] ? i : findClosestOriginal(v, i));
+    }
+  }
+
+  return indices;
+}
+
+/// \see oo::triangleStripToList()
+template<class Index>
+std::vector<Index> triangleStripToListImpl(gsl::span<const Index> indices) {
+  const auto numIndices{static_cast<std::size_t>(indices.size())};
+  std::vector<Index> list{};
+  if (numIndices < 3u) return list;
+  list.reserve(3u * (numIndices - 2u));
+
+  for (std::size_t i = 0; i + 2u < numIndices; ++i) {
+    const Index a{indices[i]}, b{indices[i + 1u]}, c{indices[i + 2u]};
+    if (a == b || b == c || a == c) continue;
+    // Every other triangle in a strip has reversed winding order.
+    if (i % 2u == 0u) list.insert(list.end(), {a, b, c});
+    else list.insert(list.end(), {b, a, c});
+  }
+
+  return list;
+}
+
+} // namespace
+
+std::vector<uint16_t>
+simplifyTriangleList(gsl::span<const float> vertices, std::size_t stride,
+                     gsl::span<const uint16_t> indices,
+                     std::size_t targetTriangles) {
+  if (stride < 3u || vertices.empty()) return {};
+
+  // Malformed meshes can have indices past the end of their vertices, which
+  // the simplifier would read out of bounds.
+  const auto numVertices{static_cast<std::size_t>(vertices.size()) / stride};
+  if (std::any_of(indices.begin(), indices.end(), [numVertices](auto i) {
+    return i >= numVertices;
+  })) {
+    return {};
+  }
+
+  Simplifier simplifier(vertices, stride, indices);
+  return simplifier.simplify(targetTriangles);
+}
+
+std::vector<uint16_t> triangleStripToList(gsl::span<const uint16_t> indices) {
+  return oo::triangleStripToListImpl(indices);
+}
+
+std::vector<uint32_t> triangleStripToList(gsl::span<const uint32_t> indices) {
+  return oo::triangleStripToListImpl(indices);
+}
+
+} // namespace oo
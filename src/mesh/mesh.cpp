@@ -2,6 +2,7 @@
 #include "mesh/mesh_manager.hpp"
 #include <OgreResourceManager.h>
 #include <OgreHardwareBufferManager.h>
+#include <algorithm>
 
 namespace oo {
 
@@ -24,6 +25,8 @@ void Mesh::loadImpl() {
 void Mesh::unloadImpl() {
   mSubMeshList.clear();
   mSubMeshNameMap.clear();
+  mLodScreenSizes.clear();
+  mOccluderTriangles.reset();
 }
 
 oo::SubMesh *Mesh::createSubMesh() {
@@ -101,6 +104,8 @@ oo::MeshPtr Mesh::clone(const std::string &newName,
   mesh->mBufMgr = mBufMgr;
   mesh->mAABB = mAABB;
   mesh->mBoundRadius = mBoundRadius;
+  mesh->mLodScreenSizes = mLodScreenSizes;
+  mesh->mOccluderTriangles = mOccluderTriangles;
 
   // Clone the submeshes, copying their names (if any).
   // Ogre does not appear to do this, it gives them all blank names.
@@ -152,4 +157,41 @@ Ogre::HardwareBufferManagerBase *Mesh::getHardwareBufferManager() const {
   return mBufMgr ? mBufMgr : Ogre::HardwareBufferManager::getSingletonPtr();
 }
 
+std::size_t Mesh::getNumLodLevels() const noexcept {
+  return mLodScreenSizes.size() + 1u;
+}
+
+const std::vector<float> &Mesh::getLodScreenSizes() const noexcept {
+  return mLodScreenSizes;
+}
+
+std::size_t Mesh::getLodIndex(float screenSize) const noexcept {
+  // Levels are ordered by decreasing screen size, so the number of levels
+  // whose screen size is greater than the given size is the index to use.
+  const auto it{std::find_if(mLodScreenSizes.begin(), mLodScreenSizes.end(),
+                             [&](float size) { return screenSize >= size; })};
+  return static_cast<std::size_t>(it - mLodScreenSizes.begin());
+}
+
+void Mesh::_setLodScreenSizes(std::vector<float> screenSizes) {
+  mLodScreenSizes = std::move(screenSizes);
+}
+
+const std::shared_ptr<const std::vector<Ogre::Vector3>> &
+Mesh::getOccluderTriangles() const noexcept {
+  return mOccluderTriangles;
+}
+
+void Mesh::_addOccluderTriangles(const std::vector<Ogre::Vector3> &triangles) {
+  if (triangles.empty()) return;
+  // The triangles may be shared with the occlusion culler, so never modify
+  // them in place.
+  using TriangleList = std::vector<Ogre::Vector3>;
+  auto merged{mOccluderTriangles
+              ? std::make_shared<TriangleList>(*mOccluderTriangles)
+              : std::make_shared<TriangleList>()};
+  merged->insert(merged->end(), triangles.begin(), triangles.end());
+  mOccluderTriangles = std::move(merged);
+}
+
 } // namespace oo
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "mesh/skeletal_animation.hpp"
+#include <OgreBone.h>
+#include <OgreSkeleton.h>
+#include <algorithm>
+#include <cmath>
+
+namespace oo {
+
+namespace {
+
+/// Return the index of the key that `time` comes before, and the fraction of
+/// the way from the previous key to that key. Times at or after the last key
+/// return the last key with a fraction of one, so that the last key is held
+/// instead of the one before it.
+/// \pre `times` is not empty.
+std::pair<std::size_t, float>
+findKey(const std::vector<float> &times, float time) {
+  auto it{std::upper_bound(times.begin(), times.end(), time)};
+  if (it == times.begin()) return {0u, 0.0f};
+  if (it == times.end()) return {times.size() - 1u, 1.0f};
+
+  const auto i{static_cast<std::size_t>(it - times.begin())};
+  const float t0{times[i - 1u]}, t1{times[i]};
+  return {i, (time - t0) / (t1 - t0)};
+}
+
+/// Insert `time` into the sorted `times`, after any equal times, and return
+/// the index it was inserted at. Keys are kept sorted in the same way as
+/// `Ogre::AnimationTrack::createKeyFrame()`, since they are not necessarily
+/// given in order.
+std::ptrdiff_t insertTime(std::vector<float> &times, float time) {
+  auto it{times.insert(std::upper_bound(times.begin(), times.end(), time),
+                       time)};
+  return it - times.begin();
+}
+
+float lerp(float a, float b, float t) noexcept {
+  return a + (b - a) * t;
+}
+
+} // namespace
+
+void Pose::setIdentity(std::size_t numBones) {
+  for (auto *v : {&tx, &ty, &tz, &rx, &ry, &rz}) v->assign(numBones, 0.0f);
+  for (auto *v : {&rw, &sx, &sy, &sz}) v->assign(numBones, 1.0f);
+}
+
+std::size_t Pose::size() const noexcept {
+  return tx.size();
+}
+
+void BoneTrack::addTranslationKey(float time, const Ogre::Vector3 &t) {
+  const auto i{oo::insertTime(translationTimes, time)};
+  tx.insert(tx.begin() + i, t.x);
+  ty.insert(ty.begin() + i, t.y);
+  tz.insert(tz.begin() + i, t.z);
+}
+
+void BoneTrack::addRotationKey(float time, const Ogre::Quaternion &r) {
+  const auto i{oo::insertTime(rotationTimes, time)};
+  rw.insert(rw.begin() + i, r.w);
+  rx.insert(rx.begin() + i, r.x);
+  ry.insert(ry.begin() + i, r.y);
+  rz.insert(rz.begin() + i, r.z);
+}
+
+void BoneTrack::addScaleKey(float time, const Ogre::Vector3 &s) {
+  const auto i{oo::insertTime(scaleTimes, time)};
+  sx.insert(sx.begin() + i, s.x);
+  sy.insert(sy.begin() + i, s.y);
+  sz.insert(sz.begin() + i, s.z);
+}
+
+float AnimationClip::getLength() const noexcept {
+  return mLength;
+}
+
+BoneTrack &AnimationClip::getTrack(uint16_t boneHandle) {
+  auto it{std::find_if(mTracks.begin(), mTracks.end(), [&](const auto &track) {
+    return track.boneHandle == boneHandle;
+  })};
+  if (it != mTracks.end()) return *it;
+
+  auto &track{mTracks.emplace_back()};
+  track.boneHandle = boneHandle;
+  return track;
+}
+
+const std::vector<BoneTrack> &AnimationClip::getTracks() const noexcept {
+  return mTracks;
+}
+
+void AnimationClip::sample(float time, Pose &pose) const {
+  // Ogre::Animation loops the time position in the same way.
+  if (mLength > 0.0f && time > mLength) time = std::fmod(time, mLength);
+
+  for (const auto &track : mTracks) {
+    const std::size_t h{track.boneHandle};
+    if (h >= pose.size()) continue;
+
+    if (!track.translationTimes.empty()) {
+      const auto[i, t]{oo::findKey(track.translationTimes, time)};
+      const std::size_t j{i > 0u ? i - 1u : 0u};
+      pose.tx[h] = oo::lerp(track.tx[j], track.tx[i], t);
+      pose.ty[h] = oo::lerp(track.ty[j], track.ty[i], t);
+      pose.tz[h] = oo::lerp(track.tz[j], track.tz[i], t);
+    }
+
+    if (!track.rotationTimes.empty()) {
+      const auto[i, t]{oo::findKey(track.rotationTimes, time)};
+      const std::size_t j{i > 0u ? i - 1u : 0u};
+      // Normalized linear interpolation along the shortest path.
+      const float dot{track.rw[j] * track.rw[i] + track.rx[j] * track.rx[i]
+                          + track.ry[j] * track.ry[i]
+                          + track.rz[j] * track.rz[i]};
+      const float sign{dot < 0.0f ? -1.0f : 1.0f};
+      Ogre::Quaternion q{oo::lerp(track.rw[j], sign * track.rw[i], t),
+                         oo::lerp(track.rx[j], sign * track.rx[i], t),
+                         oo::lerp(track.ry[j], sign * track.ry[i], t),
+                         oo::lerp(track.rz[j], sign * track.rz[i], t)};
+      q.normalise();
+      pose.rw[h] = q.w;
+      pose.rx[h] = q.x;
+      pose.ry[h] = q.y;
+      pose.rz[h] = q.z;
+    }
+
+    if (!track.scaleTimes.empty()) {
+      const auto[i, t]{oo::findKey(track.scaleTimes, time)};
+      const std::size_t j{i > 0u ? i - 1u : 0u};
+      pose.sx[h] = oo::lerp(track.sx[j], track.sx[i], t);
+      pose.sy[h] = oo::lerp(track.sy[j], track.sy[i], t);
+      pose.sz[h] = oo::lerp(track.sz[j], track.sz[i], t);
+    }
+  }
+}
+
+BindPose::BindPose(const Ogre::Skeleton &skeleton) {
+  const std::size_t numBones{skeleton.getNumBones()};
+  initial.setIdentity(numBones);
+  parents.assign(numBones, -1);
+  inversePositions.resize(numBones);
+  inverseOrientations.resize(numBones);
+  inverseScales.resize(numBones);
+
+  std::vector<int> depths(numBones, 0);
+
+  for (uint16_t h = 0; h < numBones; ++h) {
+    const auto *bone{skeleton.getBone(h)};
+
+    const auto &p{bone->getInitialPosition()};
+    const auto &r{bone->getInitialOrientation()};
+    const auto &s{bone->getInitialScale()};
+    initial.tx[h] = p.x;
+    initial.ty[h] = p.y;
+    initial.tz[h] = p.z;
+    initial.rw[h] = r.w;
+    initial.rx[h] = r.x;
+    initial.ry[h] = r.y;
+    initial.rz[h] = r.z;
+    initial.sx[h] = s.x;
+    initial.sy[h] = s.y;
+    initial.sz[h] = s.z;
+
+    if (const auto *parent{bone->getParent()}) {
+      parents[h] = static_cast<const Ogre::Bone *>(parent)->getHandle();
+    }
+    for (const Ogre::Node *n{bone->getParent()}; n; n = n->getParent()) {
+      ++depths[h];
+    }
+
+    inversePositions[h] = bone->_getBindingPoseInversePosition();
+    inverseOrientations[h] = bone->_getBindingPoseInverseOrientation();
+    inverseScales[h] = bone->_getBindingPoseInverseScale();
+  }
+
+  order.resize(numBones);
+  for (uint16_t h = 0; h < numBones; ++h) order[h] = h;
+  std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) {
+    return depths[a] < depths[b];
+  });
+}
+
+void evaluatePose(const BindPose &bindPose,
+                  gsl::span<const AnimationLayer> layers,
+                  Pose &localPose, Pose &scratch,
+                  Ogre::Affine3 *boneMatrices) {
+  const std::size_t n{bindPose.initial.size()};
+  Pose &acc{localPose};
+  acc.setIdentity(n);
+
+  // Blend the layers together, in the same way as Ogre::NodeAnimationTrack:
+  // translations are summed, rotations are composed after interpolating from
+  // the identity, and scales are multiplied after interpolating from one.
+  // Every loop below is over contiguous arrays with no dependencies between
+  // iterations, so they can be vectorized.
+  for (const auto &layer : layers) {
+    if (!layer.clip || layer.weight == 0.0f) continue;
+    const float w{layer.weight};
+
+    scratch.setIdentity(n);
+    layer.clip->sample(layer.time, scratch);
+
+    for (std::size_t i = 0; i < n; ++i) acc.tx[i] += w * scratch.tx[i];
+    for (std::size_t i = 0; i < n; ++i) acc.ty[i] += w * scratch.ty[i];
+    for (std::size_t i = 0; i < n; ++i) acc.tz[i] += w * scratch.tz[i];
+
+    for (std::size_t i = 0; i < n; ++i) {
+      // nlerp(w, IDENTITY, q) along the shortest path.
+      const float sign{std::copysign(1.0f, scratch.rw[i])};
+      float qw{1.0f - w + w * sign * scratch.rw[i]};
+      float qx{w * sign * scratch.rx[i]};
+      float qy{w * sign * scratch.ry[i]};
+      float qz{w * sign * scratch.rz[i]};
+      const float invLen{1.0f / std::sqrt(qw * qw + qx * qx + qy * qy
+                                              + qz * qz)};
+      qw *= invLen;
+      qx *= invLen;
+      qy *= invLen;
+      qz *= invLen;
+
+      const float aw{acc.rw[i]}, ax{acc.rx[i]}, ay{acc.ry[i]}, az{acc.rz[i]};
+      acc.rw[i] = aw * qw - ax * qx - ay * qy - az * qz;
+      acc.rx[i] = aw * qx + ax * qw + ay * qz - az * qy;
+      acc.ry[i] = aw * qy + ay * qw + az * qx - ax * qz;
+      acc.rz[i] = aw * qz + az * qw + ax * qy - ay * qx;
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+      acc.sx[i] *= 1.0f + (scratch.sx[i] - 1.0f) * w;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      acc.sy[i] *= 1.0f + (scratch.sy[i] - 1.0f) * w;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      acc.sz[i] *= 1.0f + (scratch.sz[i] - 1.0f) * w;
+    }
+  }
+
+  // Apply the blended animation on top of the binding pose.
+  const Pose &init{bindPose.initial};
+  for (std::size_t i = 0; i < n; ++i) acc.tx[i] += init.tx[i];
+  for (std::size_t i = 0; i < n; ++i) acc.ty[i] += init.ty[i];
+  for (std::size_t i = 0; i < n; ++i) acc.tz[i] += init.tz[i];
+  for (std::size_t i = 0; i < n; ++i) {
+    const float aw{acc.rw[i]}, ax{acc.rx[i]}, ay{acc.ry[i]}, az{acc.rz[i]};
+    const float bw{init.rw[i]}, bx{init.rx[i]}, by{init.ry[i]}, bz{init.rz[i]};
+    acc.rw[i] = bw * aw - bx * ax - by * ay - bz * az;
+    acc.rx[i] = bw * ax + bx * aw + by * az - bz * ay;
+    acc.ry[i] = bw * ay + by * aw + bz * ax - bx * az;
+    acc.rz[i] = bw * az + bz * aw + bx * ay - by * ax;
+  }
+  for (std::size_t i = 0; i < n; ++i) acc.sx[i] *= init.sx[i];
+  for (std::size_t i = 0; i < n; ++i) acc.sy[i] *= init.sy[i];
+  for (std::size_t i = 0; i < n; ++i) acc.sz[i] *= init.sz[i];
+
+  // Derive the transformations of each bone in model space. This depends on
+  // the parent of each bone so is done in hierarchy order, and is not
+  // vectorized.
+  thread_local std::vector<Ogre::Vector3> derivedPositions{};
+  thread_local std::vector<Ogre::Quaternion> derivedOrientations{};
+  thread_local std::vector<Ogre::Vector3> derivedScales{};
+  derivedPositions.resize(n);
+  derivedOrientations.resize(n);
+  derivedScales.resize(n);
+
+  for (auto h : bindPose.order) {
+    Ogre::Vector3 pos{acc.tx[h], acc.ty[h], acc.tz[h]};
+    Ogre::Quaternion rot{acc.rw[h], acc.rx[h], acc.ry[h], acc.rz[h]};
+    rot.normalise();
+    Ogre::Vector3 scale{acc.sx[h], acc.sy[h], acc.sz[h]};
+
+    if (const int p{bindPose.parents[h]}; p >= 0) {
+      const auto &parentRot{derivedOrientations[p]};
+      const auto &parentScale{derivedScales[p]};
+      pos = parentRot * (parentScale * pos) + derivedPositions[p];
+      rot = parentRot * rot;
+      scale = parentScale * scale;
+    }
+
+    derivedPositions[h] = pos;
+    derivedOrientations[h] = rot;
+    derivedScales[h] = scale;
+
+    // Same as Ogre::Bone::_getOffsetTransform().
+    const auto locScale{scale * bindPose.inverseScales[h]};
+    const auto locRot{rot * bindPose.inverseOrientations[h]};
+    const auto locPos{pos + locRot * (locScale * bindPose.inversePositions[h])};
+    boneMatrices[h].makeTransform(locPos, locScale, locRot);
+  }
+}
+
+} // namespace oo
@@ -0,0 +1,394 @@
+#include "mesh/lod_generator.hpp"
+#include "mesh/static_batch.hpp"
+#include "mesh/subentity.hpp"
+#include <OgreCamera.h>
+#include <OgreHardwareBufferManager.h>
+#include <OgreMaterialManager.h>
+#include <OgreRenderQueue.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <OgreTechnique.h>
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace oo {
+
+namespace {
+
+/// Maximum number of vertices in a single batch, so that 16-bit indices can
+/// always be used.
+constexpr std::size_t MAX_BATCH_VERTICES{std::numeric_limits<uint16_t>::max()};
+
+/// Return the indices of `subMesh` as a triangle list, converting from a
+/// triangle strip if necessary and dropping degenerate triangles.
+std::vector<uint32_t> readTriangleList(const oo::SubMesh &subMesh) {
+  const auto &staged{subMesh.stagedIndices};
+  std::vector<uint32_t> indices(staged.begin(), staged.end());
+
+  if (subMesh.operationType == Ogre::RenderOperation::OT_TRIANGLE_LIST) {
+    return indices;
+  }
+  return oo::triangleStripToList(indices);
+}
+
+/// Transform the vertices in `data`, laid out according to `decl`, from
+/// submesh space into batch space.
+void transformVertices(uint8_t *data, std::size_t vertexCount,
+                       const Ogre::VertexDeclaration &decl,
+                       const Ogre::Affine3 &transform) {
+  // Normals, tangents, and bitangents transform with the inverse transpose of
+  // the linear part of the transformation, and are not translated.
+  Ogre::Matrix3 linear{};
+  transform.extract3x3Matrix(linear);
+  const Ogre::Matrix3 normalTransform{linear.Inverse().Transpose()};
+
+  const std::size_t vertexSize{decl.getVertexSize(0)};
+
+  for (const auto &elem : decl.getElements()) {
+    if (elem.getSource() != 0 || elem.getType() != Ogre::VET_FLOAT3) continue;
+
+    const auto semantic{elem.getSemantic()};
+    const bool isPoint{semantic == Ogre::VES_POSITION};
+    const bool isDirection{semantic == Ogre::VES_NORMAL
+                               || semantic == Ogre::VES_BINORMAL
+                               || semantic == Ogre::VES_TANGENT};
+    if (!isPoint && !isDirection) continue;
+
+    uint8_t *vertex{data};
+    for (std::size_t i = 0; i < vertexCount; ++i, vertex += vertexSize) {
+      float *ptr{};
+      elem.baseVertexPointerToElement(vertex, &ptr);
+      const Ogre::Vector3 v{ptr[0], ptr[1], ptr[2]};
+      const Ogre::Vector3 w{isPoint ? transform * v
+                                    : (normalTransform * v).normalisedCopy()};
+      ptr[0] = w.x;
+      ptr[1] = w.y;
+      ptr[2] = w.z;
+    }
+  }
+}
+
+} // namespace
+
+StaticBatch::StaticBatch(const std::string &name) : MovableObject(name) {}
+
+StaticBatch::~StaticBatch() = default;
+
+bool StaticBatch::isBatchable(const oo::Entity &entity) {
+  if (!entity.isInitialised() || entity.hasSkeleton()) return false;
+
+  const auto &subEntities{entity.getSubEntities()};
+  return !subEntities.empty() && std::all_of(
+      subEntities.begin(), subEntities.end(), [](const auto &subEntity) {
+        const oo::SubMesh *subMesh{subEntity->getSubMesh()};
+        const auto &mat{subEntity->getMaterial()};
+        const auto op{subMesh->operationType};
+
+        return mat && !mat->isTransparent()
+            && subMesh->boneNames.empty()
+            && subMesh->vertexData && subMesh->indexData
+            && subMesh->indexData->indexCount > 0
+            && !subMesh->stagedVertices.empty()
+            && !subMesh->stagedIndices.empty()
+            && subMesh->vertexData->vertexBufferBinding->getBufferCount() == 1
+            && (op == Ogre::RenderOperation::OT_TRIANGLE_LIST
+                || op == Ogre::RenderOperation::OT_TRIANGLE_STRIP);
+      });
+}
+
+bool StaticBatch::addEntity(const oo::Entity &entity,
+                            const Ogre::Affine3 &transform,
+                            OwnerId owner) {
+  if (!isBatchable(entity)) return false;
+
+  for (const auto &subEntity : entity.getSubEntities()) {
+    if (!subEntity->isVisible()) continue;
+    mInstances.push_back(Instance{entity.getMesh(), subEntity->getSubMesh(),
+                                  subEntity->getMaterial(), transform, owner});
+  }
+
+  updateBounds();
+  mIsDirty = true;
+  return true;
+}
+
+void StaticBatch::removeOwner(OwnerId owner) {
+  auto it{std::remove_if(mInstances.begin(), mInstances.end(),
+                         [owner](const Instance &instance) {
+                           return instance.mOwner == owner;
+                         })};
+  if (it == mInstances.end()) return;
+
+  mInstances.erase(it, mInstances.end());
+  mDisabledOwners.erase(owner);
+  updateBounds();
+  mIsDirty = true;
+}
+
+void StaticBatch::setOwnerEnabled(OwnerId owner, bool enabled) {
+  if (enabled == isOwnerEnabled(owner)) return;
+
+  if (enabled) mDisabledOwners.erase(owner);
+  else mDisabledOwners.insert(owner);
+
+  if (hasOwner(owner)) mIsDirty = true;
+}
+
+bool StaticBatch::isOwnerEnabled(OwnerId owner) const {
+  //C++20: return !mDisabledOwners.contains(owner);
+  return mDisabledOwners.find(owner) == mDisabledOwners.end();
+}
+
+bool StaticBatch::hasOwner(OwnerId owner) const {
+  return std::any_of(mInstances.begin(), mInstances.end(),
+                     [owner](const Instance &instance) {
+                       return instance.mOwner == owner;
+                     });
+}
+
+void StaticBatch::build() {
+  mBatches.clear();
+
+  // Group the instances by material; each group is drawn with at least one
+  // draw call, but usually exactly one.
+  std::map<Ogre::Material *, std::vector<const Instance *>> groups{};
+  for (const auto &instance : mInstances) {
+    if (!isOwnerEnabled(instance.mOwner)) continue;
+    groups[instance.mMaterial.get()].push_back(&instance);
+  }
+
+  for (const auto &[_, instances] : groups) buildBatches(instances);
+
+  if (mParentNode) getParentSceneNode()->needUpdate();
+  mIsDirty = false;
+}
+
+void StaticBatch::updateBounds() {
+  // The bounds include disabled owners too, otherwise a batch whose owners are
+  // all disabled would be culled and never get the chance to be rebuilt when
+  // they are re-enabled.
+  mAABB.setNull();
+  for (const auto &instance : mInstances) {
+    auto bounds{instance.mMesh->getBounds()};
+    bounds.transform(instance.mTransform);
+    mAABB.merge(bounds);
+  }
+  mBoundRadius = mAABB.isFinite() ? Ogre::Math::boundingRadiusFromAABB(mAABB)
+                                  : 0.0f;
+  if (mParentNode) getParentSceneNode()->needUpdate();
+}
+
+void StaticBatch::buildBatches(const std::vector<const Instance *> &instances) {
+  if (instances.empty()) return;
+
+  auto *hwBufMgr{Ogre::HardwareBufferManager::getSingletonPtr()};
+  const auto &material{instances.front()->mMaterial};
+
+  std::vector<uint8_t> vertices{};
+  std::vector<uint16_t> indices{};
+  std::size_t vertexCount{0};
+  Ogre::AxisAlignedBox aabb{};
+  const Ogre::VertexDeclaration *decl{};
+
+  // Upload everything accumulated so far as a single batch.
+  auto flush = [&]() {
+    if (!decl || indices.empty()) return;
+
+    const std::size_t vertexSize{decl->getVertexSize(0)};
+    const auto usage{Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY};
+
+    auto vertexData{std::make_unique<Ogre::VertexData>()};
+    vertexData->vertexCount = vertexCount;
+    vertexData->vertexStart = 0;
+    // Ogre::VertexData owns its declaration, so we need a copy.
+    for (const auto &elem : decl->getElements()) {
+      vertexData->vertexDeclaration->addElement(
+          elem.getSource(), elem.getOffset(), elem.getType(),
+          elem.getSemantic(), elem.getIndex());
+    }
+    auto vertBuf{hwBufMgr->createVertexBuffer(vertexSize, vertexCount, usage)};
+    vertBuf->writeData(0, vertBuf->getSizeInBytes(), vertices.data(), true);
+    vertexData->vertexBufferBinding->setBinding(0, vertBuf);
+
+    auto indexData{std::make_unique<Ogre::IndexData>()};
+    const auto itype{Ogre::HardwareIndexBuffer::IT_16BIT};
+    auto indexBuf{hwBufMgr->createIndexBuffer(itype, indices.size(), usage)};
+    indexBuf->writeData(0, indexBuf->getSizeInBytes(), indices.data(), true);
+    indexData->indexBuffer = indexBuf;
+    indexData->indexCount = indices.size();
+    indexData->indexStart = 0;
+
+    mBatches.emplace_back(std::make_unique<Batch>(
+        this, material, std::move(vertexData), std::move(indexData), aabb));
+
+    vertices.clear();
+    indices.clear();
+    vertexCount = 0;
+    aabb.setNull();
+  };
+
+  for (const Instance *instance : instances) {
+    const oo::SubMesh *subMesh{instance->mSubMesh};
+    const Ogre::VertexData &srcVertexData{*subMesh->vertexData};
+    const Ogre::VertexDeclaration &srcDecl{*srcVertexData.vertexDeclaration};
+    const std::size_t srcCount{srcVertexData.vertexCount};
+    const std::size_t vertexSize{srcDecl.getVertexSize(0)};
+
+    // Geometry with a different vertex format cannot share a buffer.
+    if (decl && !(*decl == srcDecl)) flush();
+    if (vertexCount + srcCount > MAX_BATCH_VERTICES) flush();
+    decl = &srcDecl;
+
+    // A single submesh that is too big for a batch on its own shouldn't happen
+    // since the submeshes themselves use 16-bit indices.
+    if (srcCount > MAX_BATCH_VERTICES) continue;
+
+    const auto srcIndices{readTriangleList(*subMesh)};
+
+    // The hardware buffers are write-only, so the vertices are copied from the
+    // submesh's copy in main memory instead.
+    const auto *srcVertices{
+        reinterpret_cast<const uint8_t *>(subMesh->stagedVertices.data())};
+    const std::size_t offset{vertices.size()};
+    vertices.insert(vertices.end(), srcVertices,
+                    srcVertices + srcCount * vertexSize);
+    transformVertices(vertices.data() + offset, srcCount, srcDecl,
+                      instance->mTransform);
+
+    for (uint32_t index : srcIndices) {
+      indices.push_back(static_cast<uint16_t>(vertexCount + index));
+    }
+    vertexCount += srcCount;
+
+    auto bounds{instance->mMesh->getBounds()};
+    bounds.transform(instance->mTransform);
+    aabb.merge(bounds);
+  }
+
+  flush();
+}
+
+std::size_t StaticBatch::getNumBatches() const noexcept {
+  return mBatches.size();
+}
+
+std::size_t StaticBatch::getNumInstances() const noexcept {
+  return mInstances.size();
+}
+
+//===----------------------------------------------------------------------===//
+// MovableObject overrides
+//===----------------------------------------------------------------------===//
+
+const Ogre::AxisAlignedBox &StaticBatch::getBoundingBox() const {
+  return mAABB;
+}
+
+float StaticBatch::getBoundingRadius() const {
+  return mBoundRadius;
+}
+
+void StaticBatch::_updateRenderQueue(Ogre::RenderQueue *queue) {
+  if (mIsDirty) build();
+
+  for (const auto &batch : mBatches) {
+    if (mRenderQueueIDSet) {
+      if (mRenderQueuePrioritySet) {
+        queue->addRenderable(batch.get(), mRenderQueueID, mRenderQueuePriority);
+      } else {
+        queue->addRenderable(batch.get(), mRenderQueueID);
+      }
+    } else {
+      queue->addRenderable(batch.get());
+    }
+  }
+}
+
+const std::string &StaticBatch::getMovableType() const {
+  const static std::string typeName{StaticBatchFactory::FACTORY_TYPE_NAME};
+  return typeName;
+}
+
+uint32_t StaticBatch::getTypeFlags() const {
+  return Ogre::SceneManager::STATICGEOMETRY_TYPE_MASK;
+}
+
+void StaticBatch::visitRenderables(Ogre::Renderable::Visitor *visitor, bool) {
+  for (auto &batch : mBatches) visitor->visit(batch.get(), 0, false);
+}
+
+//===----------------------------------------------------------------------===//
+// Batch definitions
+//===----------------------------------------------------------------------===//
+
+StaticBatch::Batch::Batch(oo::StaticBatch *parent, Ogre::MaterialPtr material,
+                          std::unique_ptr<Ogre::VertexData> vertexData,
+                          std::unique_ptr<Ogre::IndexData> indexData,
+                          const Ogre::AxisAlignedBox &aabb)
+    : mParent(parent),
+      mMaterial(std::move(material)),
+      mVertexData(std::move(vertexData)),
+      mIndexData(std::move(indexData)),
+      mAABB(aabb) {}
+
+const Ogre::AxisAlignedBox &StaticBatch::Batch::getBoundingBox() const noexcept {
+  return mAABB;
+}
+
+const Ogre::MaterialPtr &StaticBatch::Batch::getMaterial() const {
+  return mMaterial;
+}
+
+Ogre::Technique *StaticBatch::Batch::getTechnique() const {
+  return mMaterial->getBestTechnique(0, this);
+}
+
+void StaticBatch::Batch::getRenderOperation(Ogre::RenderOperation &op) {
+  op.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+  op.vertexData = mVertexData.get();
+  op.indexData = mIndexData.get();
+  op.useIndexes = true;
+  op.srcRenderable = this;
+}
+
+void StaticBatch::Batch::getWorldTransforms(Ogre::Matrix4 *xform) const {
+  *xform = mParent->_getParentNodeFullTransform();
+}
+
+float StaticBatch::Batch::getSquaredViewDepth(const Ogre::Camera *camera) const {
+  // Sorting is only needed for transparent materials, which are never batched,
+  // so the distance to the centre of the batch is good enough.
+  const auto &xform{mParent->_getParentNodeFullTransform()};
+  const Ogre::Vector3 centre{xform * mAABB.getCenter()};
+  return centre.squaredDistance(camera->getDerivedPosition());
+}
+
+const Ogre::LightList &StaticBatch::Batch::getLights() const {
+  return mParent->queryLights();
+}
+
+bool StaticBatch::Batch::getCastsShadows() const {
+  return mParent->getCastShadows();
+}
+
+//===----------------------------------------------------------------------===//
+// StaticBatchFactory definitions
+//===----------------------------------------------------------------------===//
+
+void StaticBatchFactory::destroyInstance(gsl::owner<Ogre::MovableObject *> obj) {
+  OGRE_DELETE obj;
+}
+
+const std::string &StaticBatchFactory::getType() const {
+  const static std::string typeName{FACTORY_TYPE_NAME};
+  return typeName;
+}
+
+gsl::owner<Ogre::MovableObject *>
+StaticBatchFactory::createInstanceImpl(const std::string &name,
+                                       const Ogre::NameValuePairList *) {
+  return OGRE_NEW oo::StaticBatch(name);
+}
+
+} // namespace oo
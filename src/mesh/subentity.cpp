@@ -10,6 +10,7 @@ SubEntity::SubEntity(oo::Entity *parent, oo::SubMesh *subMesh) noexcept
     : mParent(parent),
       mSubMesh(subMesh),
       mIsVisible(true),
+      mIsOccluded(false),
       mUseCustomRenderQueueId(false),
       mUseCustomRenderQueuePriority(false) {}
 
@@ -101,7 +102,7 @@ Ogre::Technique *SubEntity::getTechnique() const {
 }
 
 void SubEntity::getRenderOperation(Ogre::RenderOperation &op) {
-  mSubMesh->_getRenderOperation(op);
+  mSubMesh->_getRenderOperation(op, mParent->mLodIndex);
 }
 
 void SubEntity::getWorldTransforms(Ogre::Matrix4 *xform) const {
@@ -1,5 +1,6 @@
 #include "mesh/mesh.hpp"
 #include "mesh/submesh.hpp"
+#include <algorithm>
 
 namespace oo {
 
@@ -22,11 +23,21 @@ bool SubMesh::isMatInitialised() const {
   return mMatInitialized;
 }
 
-void SubMesh::_getRenderOperation(Ogre::RenderOperation &rend) {
-  rend.indexData = indexData.get();
-  rend.useIndexes = indexData && indexData->indexCount != 0;
-  rend.operationType = operationType;
+void SubMesh::_getRenderOperation(Ogre::RenderOperation &rend,
+                                  std::size_t lodIndex) {
   rend.vertexData = vertexData.get();
+
+  if (lodIndex == 0 || lodIndexData.empty()) {
+    rend.indexData = indexData.get();
+    rend.useIndexes = indexData && indexData->indexCount != 0;
+    rend.operationType = operationType;
+    return;
+  }
+
+  const auto &lod{lodIndexData[std::min(lodIndex, lodIndexData.size()) - 1u]};
+  rend.indexData = lod.get();
+  rend.useIndexes = lod && lod->indexCount != 0;
+  rend.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
 }
 
 SubMesh *SubMesh::clone(const std::string &newName,
@@ -37,6 +48,9 @@ SubMesh *SubMesh::clone(const std::string &newName,
   auto *subMesh{parentMesh->createSubMesh(newName)};
   subMesh->operationType = operationType;
   subMesh->boneNames = boneNames;
+  subMesh->stagedVertices = stagedVertices;
+  subMesh->stagedIndices = stagedIndices;
+  subMesh->bounds = bounds;
   subMesh->parent = parentMesh;
   subMesh->mMatInitialized = mMatInitialized;
   subMesh->mMaterialName = mMaterialName;
@@ -46,6 +60,9 @@ SubMesh *SubMesh::clone(const std::string &newName,
   // we can assume that OGRE_NEW is just new.
   subMesh->vertexData.reset(vertexData->clone(true, bufMgr));
   subMesh->indexData.reset(indexData->clone(true, bufMgr));
+  for (const auto &lod : lodIndexData) {
+    subMesh->lodIndexData.emplace_back(lod->clone(true, bufMgr));
+  }
 
   return subMesh;
 }
@@ -2,11 +2,15 @@
 #include "mesh/entity.hpp"
 #include "modes/debug_draw_impl.hpp"
 #include "modes/game_mode.hpp"
+#include "ogre/occlusion_culler.hpp"
 #include "ogre/scene_manager.hpp"
+#include "ogre/sun_shadows.hpp"
+#include "ogre/texture_streamer.hpp"
 #include <imgui/imgui.h>
 #include <OgreBone.h>
 #include <OgreSceneNode.h>
 #include <OgreSkeletonInstance.h>
+#include <algorithm>
 
 namespace oo {
 
@@ -55,12 +59,93 @@ void DebugDrawImpl::drawFpsDisplay(float delta) {
 
   ImGui::Begin("Debug Display", nullptr, ImGuiWindowFlags_None);
   ImGui::Text("FPS: %f", 1.0f / delta);
+  ImGui::Text("Physics step: %.3f ms",
+              1000.0f * mGameMode->mPhysicsStepper->getLastStepTime());
   std::array<float, NUM_FPS_SAMPLES> frameTimes;
   std::copy(mFrameTimes.begin(), mFrameTimes.end(), frameTimes.begin());
   ImGui::PlotLines("Frame times", frameTimes.data(), mFrameTimes.size());
+  drawTextureStreamingDisplay();
+  drawOcclusionCullingDisplay();
+  drawSunShadowsDisplay();
   ImGui::End();
 }
 
+void DebugDrawImpl::drawOcclusionCullingDisplay() {
+  auto *culler{oo::OcclusionCuller::getSingletonPtr()};
+  if (!culler || !ImGui::CollapsingHeader("Occlusion culling")) return;
+
+  const auto stats{culler->getStats()};
+  ImGui::Text("Occluders: %zu (%zu triangles)",
+              stats.numOccluders, stats.numTriangles);
+  ImGui::Text("Occluded: %zu / %zu", stats.numOccluded, stats.numTested);
+  ImGui::Text("Rasterization: %.3f ms", stats.updateTime);
+}
+
+void DebugDrawImpl::drawSunShadowsDisplay() {
+  auto *shadows{oo::SunShadows::getSingletonPtr()};
+  if (!shadows || !ImGui::CollapsingHeader("Sun shadows")) return;
+
+  const auto stats{shadows->getStats()};
+  ImGui::Text("Redrawn cascades: %zu / %zu",
+              stats.numRedrawn, stats.numCascades);
+  ImGui::Text("Candidate casters: %zu", stats.numCandidates);
+  for (std::size_t i = 0; i < stats.numCascades; ++i) {
+    ImGui::Text("Cascade %zu casters: %zu", i, stats.numCasters[i]);
+  }
+  ImGui::Text("Culling: %.3f ms", stats.cullTime);
+}
+
+void DebugDrawImpl::drawTextureStreamingDisplay() {
+  auto *streamer{oo::TextureStreamer::getSingletonPtr()};
+  if (!streamer || !ImGui::CollapsingHeader("Texture streaming")) return;
+
+  constexpr float MiB{1024.0f * 1024.0f};
+  const auto stats{streamer->getStats()};
+  ImGui::Text("Resident: %.1f / %.1f MiB",
+              static_cast<float>(stats.residentBytes) / MiB,
+              static_cast<float>(stats.budgetBytes) / MiB);
+  ImGui::Text("Textures: %zu (%zu streamable), %zu pending",
+              stats.numTextures, stats.numStreamable, stats.numPending);
+  ImGui::Text("Upgrades: %zu, downgrades: %zu",
+              stats.numUpgrades, stats.numDowngrades);
+
+  // Only list the largest textures, there can be thousands of them.
+  auto textures{streamer->getTextureStats()};
+  const std::size_t numShown{std::min(textures.size(),
+                                      NUM_TEXTURE_STATS_SHOWN)};
+  std::partial_sort(textures.begin(), textures.begin() + numShown,
+                    textures.end(), [](const auto &a, const auto &b) {
+        return a.residentBytes > b.residentBytes;
+      });
+
+  ImGui::Columns(4, "TextureStats");
+  ImGui::Text("Texture");
+  ImGui::NextColumn();
+  ImGui::Text("Resident");
+  ImGui::NextColumn();
+  ImGui::Text("Wanted");
+  ImGui::NextColumn();
+  ImGui::Text("KiB");
+  ImGui::NextColumn();
+  ImGui::Separator();
+  for (std::size_t i = 0; i < numShown; ++i) {
+    const auto &tex{textures[i]};
+    const auto residentW{std::max(tex.width >> tex.residentMip, 1u)};
+    const auto residentH{std::max(tex.height >> tex.residentMip, 1u)};
+    const auto wantedW{std::max(tex.width >> tex.wantedMip, 1u)};
+    const auto wantedH{std::max(tex.height >> tex.wantedMip, 1u)};
+    ImGui::Text("%s%s", tex.name.c_str(), tex.isPending ? " *" : "");
+    ImGui::NextColumn();
+    ImGui::Text("%ux%u", residentW, residentH);
+    ImGui::NextColumn();
+    ImGui::Text("%ux%u", wantedW, wantedH);
+    ImGui::NextColumn();
+    ImGui::Text("%zu", tex.residentBytes / 1024u);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+}
+
 void DebugDrawImpl::drawDebug() {
   if (!mDebugDrawer) return;
   mDebugDrawer->clearLines();
@@ -2,9 +2,12 @@
 #include "config/game_settings.hpp"
 #include "config/globals.hpp"
 #include "gui/menu.hpp"
+#include "job/job.hpp"
 #include "modes/console_mode.hpp"
 #include "modes/debug_draw_impl.hpp"
 #include "modes/game_mode.hpp"
+#include "modes/instancing_stress_test.hpp"
+#include "modes/lighting_stress_test.hpp"
 #include "modes/loading_menu_mode.hpp"
 #include "modes/menu_mode.hpp"
 #include "ogre/scene_manager.hpp"
@@ -17,15 +20,21 @@
 #include <OgreBone.h>
 #include <OgreSkeletonInstance.h>
 #include <spdlog/fmt/ostr.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
 
 // wtf winuser.h
 #undef LoadMenu
 
 namespace oo {
 
-GameMode::GameMode(ApplicationContext &/*ctx*/, oo::CellPacket cellPacket)
+GameMode::GameMode(ApplicationContext &ctx, oo::CellPacket cellPacket)
     : mExteriorMgr(cellPacket),
-      mDebugDrawImpl(std::make_unique<oo::DebugDrawImpl>(this)) {
+      mDebugDrawImpl(std::make_unique<oo::DebugDrawImpl>(this)),
+      mScriptScheduler(&ctx.getScriptScheduler()),
+      mPhysicsStepper(std::make_unique<bullet::AsyncStepper>()) {
   mCell = std::move(cellPacket.mInteriorCell);
 
   mPlayerStartPos = cellPacket.mPlayerPosition;
@@ -45,9 +54,19 @@ GameMode::GameMode(GameMode &&other) noexcept
       mPlayerStartOrientation(other.mPlayerStartOrientation),
       mPlayer(std::move(other.mPlayer)),
       mCollisionCaller(std::move(other.mCollisionCaller)),
-      mDebugDrawImpl(std::make_unique<oo::DebugDrawImpl>(this)) {}
+      mDebugDrawImpl(std::make_unique<oo::DebugDrawImpl>(this)),
+      mInstancingStressTest(std::move(other.mInstancingStressTest)),
+      mLightingStressTest(std::move(other.mLightingStressTest)),
+      mBuildDistantObjects(other.mBuildDistantObjects),
+      mScriptScheduler(other.mScriptScheduler),
+      mPhysicsStepper(std::move(other.mPhysicsStepper)),
+      mPhysicsDelta(other.mPhysicsDelta) {}
 
 GameMode &GameMode::operator=(GameMode &&other) noexcept {
+  // Replace the stepper first, so that any step of the old world is finished
+  // before the old world is destroyed.
+  mPhysicsStepper = std::move(other.mPhysicsStepper);
+  mPhysicsDelta = other.mPhysicsDelta;
   mExteriorMgr = std::move(other.mExteriorMgr);
   mCell = std::move(other.mCell);
   mCenterCell = other.mCenterCell;
@@ -57,6 +76,10 @@ GameMode &GameMode::operator=(GameMode &&other) noexcept {
   mPlayer = std::move(other.mPlayer);
   mCollisionCaller = std::move(other.mCollisionCaller);
   mDebugDrawImpl = std::make_unique<oo::DebugDrawImpl>(this);
+  mInstancingStressTest = std::move(other.mInstancingStressTest);
+  mLightingStressTest = std::move(other.mLightingStressTest);
+  mBuildDistantObjects = other.mBuildDistantObjects;
+  mScriptScheduler = other.mScriptScheduler;
 
   return *this;
 }
@@ -138,9 +161,30 @@ GameMode::handleEvent(ApplicationContext &ctx, const sdl::Event &event) {
 }
 
 void GameMode::dispatchCollisions() {
-  auto *const btDispatcher{getPhysicsWorld()->getDispatcher()};
-  gsl::not_null dispatcher{dynamic_cast<btCollisionDispatcher *>(btDispatcher)};
-  mCollisionCaller.runCallbacks(dispatcher);
+  mCollisionCaller.runCallbacks(mPhysicsStepper->getCollisionEvents());
+}
+
+void GameMode::beginPhysicsStep() {
+  if (mPhysicsStepper->isStepping()) return;
+
+  // References enabled or disabled this frame are only reflected in the merged
+  // static collision now, so that it is rebuilt at most once per frame.
+  if (mInInterior) {
+    mCell->updateStaticCollision();
+  } else {
+    for (const auto &cell : mExteriorMgr.getNearCells()) {
+      cell->updateStaticCollision();
+    }
+  }
+
+  mPhysicsStepper->beginStep(getPhysicsWorld(), mPhysicsDelta, 4);
+  mPhysicsDelta = 0.0f;
+}
+
+void GameMode::waitForPhysics() {
+  if (!mPhysicsStepper->isStepping()) return;
+  mPhysicsStepper->wait();
+  dispatchCollisions();
 }
 
 RefId GameMode::getCrosshairRef() const {
@@ -153,11 +197,30 @@ RefId GameMode::getCrosshairRef() const {
   const auto rayLength{*iActivatePickLength * oo::metersPerUnit<btScalar>};
   const auto rayEnd{camPos + rayLength * camDir};
 
-  btCollisionWorld::ClosestRayResultCallback callback(rayStart, rayEnd);
+  // Merged static collision needs to know which part of the shape was hit to
+  // determine the reference, which the default callback does not record.
+  struct Callback : btCollisionWorld::ClosestRayResultCallback {
+    using ClosestRayResultCallback::ClosestRayResultCallback;
+    int mShapePart{-1};
+    int mTriangleIndex{-1};
+
+    btScalar addSingleResult(btCollisionWorld::LocalRayResult &result,
+                             bool normalInWorldSpace) override {
+      if (const auto *info{result.m_localShapeInfo}) {
+        mShapePart = info->m_shapePart;
+        mTriangleIndex = info->m_triangleIndex;
+      } else {
+        mShapePart = mTriangleIndex = -1;
+      }
+      return ClosestRayResultCallback::addSingleResult(result,
+                                                       normalInWorldSpace);
+    }
+  } callback(rayStart, rayEnd);
   getPhysicsWorld()->rayTest(rayStart, rayEnd, callback);
 
   if (callback.hasHit()) {
-    return RefId{decodeFormId(callback.m_collisionObject->getUserPointer())};
+    return oo::getRefId(gsl::make_not_null(callback.m_collisionObject),
+                        callback.mShapePart, callback.mTriangleIndex);
   } else {
     return RefId{};
   }
@@ -239,18 +302,75 @@ void GameMode::updateAnimation(float delta) {
   // Can't naively update the animation of every single entity since if two
   // entities share a skeleton then the update will be applied twice.
   std::set<const Ogre::AnimationStateSet *> animSets;
+  std::vector<oo::Entity *> animEntities;
   for (auto it{getSceneManager()->getMovableObjectIterator("oo::Entity")};
        it.hasMoreElements();) {
-    const auto *entity{static_cast<const oo::Entity *>(it.getNext())};
+    auto *entity{static_cast<oo::Entity *>(it.getNext())};
 
     const auto *anims{entity->getAllAnimationStates()};
-    if (anims) animSets.insert(anims);
+    if (anims && animSets.insert(anims).second) {
+      animEntities.push_back(entity);
+    }
   }
 
   for (const auto *animSet : animSets) {
     const auto &animStates{animSet->getEnabledAnimationStates()};
     for (auto state : animStates) state->addTime(delta);
   }
+
+  // Entities with one of the animation sets share the same skeleton state, so
+  // there is at most one pose job per skeleton. Entities whose pose cannot be
+  // evaluated by a job are updated by OGRE when they are rendered, as before.
+  std::vector<oo::PoseJob> jobs;
+  jobs.reserve(animEntities.size());
+  for (auto *entity : animEntities) {
+    if (auto job{entity->_createPoseJob()}) jobs.push_back(std::move(*job));
+  }
+  runPoseJobs(std::move(jobs));
+}
+
+void GameMode::runPoseJobs(std::vector<oo::PoseJob> jobs) {
+  // Number of pose jobs claimed at once, to amortize the cost of claiming.
+  constexpr std::size_t CHUNK_SIZE{4u};
+  const std::size_t numChunks{(jobs.size() + CHUNK_SIZE - 1u) / CHUNK_SIZE};
+  if (numChunks == 0u) return;
+
+  // Chunks are claimed by the render thread and by helper jobs on the worker
+  // threads. The worker threads may all be busy loading cells, so the render
+  // thread does not wait for the helpers to start, only for the chunks that
+  // they have claimed to finish. Helpers that start late find nothing left to
+  // do, but might still touch the shared state after we have returned.
+  struct SharedState {
+    std::vector<oo::PoseJob> jobs;
+    std::size_t numChunks;
+    std::atomic<std::size_t> nextChunk{0u};
+    oo::JobCounter chunksDone;
+
+    SharedState(std::vector<oo::PoseJob> jobs, std::size_t numChunks)
+        : jobs(std::move(jobs)), numChunks(numChunks),
+          chunksDone(static_cast<int>(numChunks)) {}
+
+    void work() {
+      for (std::size_t c{nextChunk++}; c < numChunks; c = nextChunk++) {
+        const std::size_t end{std::min(jobs.size(), (c + 1u) * CHUNK_SIZE)};
+        for (std::size_t i = c * CHUNK_SIZE; i < end; ++i) jobs[i].run();
+        chunksDone.decrement();
+      }
+    }
+  };
+
+  auto state{std::make_shared<SharedState>(std::move(jobs), numChunks)};
+  const auto numHelpers{std::min<std::size_t>(numChunks - 1u,
+                                              oo::JobManager::getNumWorkers())};
+  for (std::size_t i = 0; i < numHelpers; ++i) {
+    oo::JobManager::runJob([state]() { state->work(); });
+  }
+
+  state->work();
+  state->chunksDone.wait();
+
+  // Release the skeleton states here instead of on a worker thread.
+  state->jobs.clear();
 }
 
 void GameMode::enter(ApplicationContext &ctx) {
@@ -379,9 +499,11 @@ void GameMode::update(ApplicationContext &ctx, float delta) {
     }
   }
 
-  getPhysicsWorld()->stepSimulation(delta, 4);
-  dispatchCollisions();
+  // The world is stepped once the frame has been queued for rendering, see
+  // beginPhysicsStep().
+  mPhysicsDelta += delta;
   advanceGameClock(delta);
+  mScriptScheduler->run();
 
   if (!mInInterior && updateCenterCell(ctx)) {
     oo::JobManager::runJob([&]() {
@@ -389,8 +511,14 @@ void GameMode::update(ApplicationContext &ctx, float delta) {
     });
   }
 
+  if (std::exchange(mBuildDistantObjects, false) && !mInInterior) {
+    oo::buildDistantObjects(mExteriorMgr.getWorld(), ctx);
+  }
+
   mDebugDrawImpl->drawDebug();
   mDebugDrawImpl->drawFpsDisplay(delta);
+  if (mInstancingStressTest) mInstancingStressTest->update(delta);
+  if (mLightingStressTest) mLightingStressTest->update(delta);
 
   logRefUnderCursor(ctx);
 }
@@ -411,4 +539,105 @@ void GameMode::toggleFps() {
   mDebugDrawImpl->setDisplayFpsEnabled(!mDebugDrawImpl->getDisplayFpsEnabled());
 }
 
+void GameMode::runInstancingStressTest(std::size_t count, bool instanced) {
+  mInstancingStressTest.reset();
+  if (count == 0u) return;
+
+  // Find an entity belonging to the reference under the crosshair.
+  const oo::RefId refId{getCrosshairRef()};
+  auto scnMgr{getSceneManager()};
+  const std::string nodeName{refId.string()};
+  if (refId == oo::RefId{0} || !scnMgr->hasSceneNode(nodeName)) {
+    spdlog::get(oo::LOG)->warn("InstancingStressTest: No reference under the "
+                               "crosshair to copy");
+    return;
+  }
+
+  std::function<const oo::Entity *(Ogre::SceneNode *)> findEntity =
+      [&](Ogre::SceneNode *node) -> const oo::Entity * {
+        for (Ogre::MovableObject *obj : node->getAttachedObjects()) {
+          if (auto *entity{dynamic_cast<oo::Entity *>(obj)}) return entity;
+        }
+        for (Ogre::Node *child : node->getChildren()) {
+          auto *sceneChild{static_cast<Ogre::SceneNode *>(child)};
+          if (auto *entity{findEntity(sceneChild)}) return entity;
+        }
+        return nullptr;
+      };
+
+  const oo::Entity *source{findEntity(scnMgr->getSceneNode(nodeName))};
+  if (!source
+      || (instanced && !oo::InstancedGeometry::isInstanceable(*source))) {
+    spdlog::get(oo::LOG)->warn("InstancingStressTest: RefId {} has no "
+                               "suitable entity to copy", refId);
+    return;
+  }
+
+  // Put the grid on the ground in front of the player, far enough away that
+  // the player isn't standing in it.
+  const auto &controller{mPlayer->getController()};
+  auto forward{controller.getCamera()->getDerivedDirection()};
+  forward.y = 0.0f;
+  forward.normalise();
+  const float radius{source->getMesh()->getBoundingSphereRadius()};
+  const float extent{std::sqrt(static_cast<float>(count)) * radius};
+  const auto centre{controller.getPosition() + forward * (extent + radius)};
+
+  mInstancingStressTest = std::make_unique<oo::InstancingStressTest>(
+      scnMgr, *source, centre, count, instanced);
+}
+
+void GameMode::runLightingStressTest(std::size_t count, bool clustered) {
+  mLightingStressTest.reset();
+  if (count == 0u) return;
+
+  auto *scnMgr{dynamic_cast<oo::DeferredSceneManager *>(
+                   getSceneManager().get())};
+  if (!scnMgr) {
+    spdlog::get(oo::LOG)->warn("LightingStressTest: The current scene does "
+                               "not use deferred lighting");
+    return;
+  }
+
+  // Surround the player with lights.
+  const auto centre{mPlayer->getController().getPosition()};
+  mLightingStressTest = std::make_unique<oo::LightingStressTest>(
+      gsl::make_not_null(scnMgr), centre, count, clustered);
+}
+
+void GameMode::buildDistantObjects() {
+  mBuildDistantObjects = true;
+}
+
+oo::ScriptScheduler &GameMode::getScriptScheduler() noexcept {
+  return *mScriptScheduler;
+}
+
+void GameMode::printScriptProfile(std::size_t count) const {
+  using Millis = std::chrono::duration<double, std::milli>;
+
+  const auto profiles{mScriptScheduler->getProfiles()};
+  if (profiles.empty()) {
+    ConsoleMode::print("No scripted references have been loaded");
+    return;
+  }
+
+  ConsoleMode::print(fmt::format("{} scripts, slowest first:",
+                                 profiles.size()));
+
+  for (std::size_t i = 0; i < std::min(count, profiles.size()); ++i) {
+    const auto &p{profiles[i]};
+    const auto frames{std::max<uint64_t>(p.numFrames, 1u)};
+    ConsoleMode::print(fmt::format(
+        "{}: {} refs, {} frames, {:.3f} ms total, {:.3f} ms/frame avg, "
+        "{:.3f} ms/frame max", p.scriptName, p.numRefs, p.numFrames,
+        Millis(p.totalTime).count(), Millis(p.totalTime).count() / frames,
+        Millis(p.maxFrameTime).count()));
+  }
+}
+
+void GameMode::resetScriptProfile() {
+  mScriptScheduler->resetProfiles();
+}
+
 } // namespace oo
@@ -0,0 +1,94 @@
+#include "modes/instancing_stress_test.hpp"
+#include "util/settings.hpp"
+#include <OgreSceneNode.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace oo {
+
+InstancingStressTest::InstancingStressTest(
+    gsl::not_null<Ogre::SceneManager *> scnMgr,
+    const oo::Entity &source,
+    const Ogre::Vector3 &centre,
+    std::size_t count,
+    bool instanced) : mScnMgr(scnMgr), mCount(count), mInstanced(instanced) {
+  using Clock = std::chrono::high_resolution_clock;
+  const auto startTime{Clock::now()};
+
+  auto *root{mScnMgr->getRootSceneNode()};
+  mRootNode = root->createChildSceneNode(NODE_NAME, centre);
+
+  const auto &mesh{source.getMesh()};
+  const auto side{static_cast<std::size_t>(
+                      std::ceil(std::sqrt(static_cast<float>(count))))};
+  const float spacing{std::max(2.0f * mesh->getBoundingSphereRadius(), 1.0f)};
+  const float offset{0.5f * spacing * static_cast<float>(side - 1u)};
+
+  auto getPosition = [&](std::size_t i) {
+    const auto x{static_cast<float>(i % side)};
+    const auto z{static_cast<float>(i / side)};
+    return Ogre::Vector3{x * spacing - offset, 0.0f, z * spacing - offset};
+  };
+
+  if (mInstanced) {
+    mGeometry = static_cast<oo::InstancedGeometry *>(
+        mScnMgr->createMovableObject(
+            NODE_NAME, oo::InstancedGeometryFactory::FACTORY_TYPE_NAME));
+    mRootNode->attachObject(mGeometry);
+
+    for (std::size_t i = 0; i < mCount; ++i) {
+      const Ogre::Affine3 xform{getPosition(i), Ogre::Quaternion::IDENTITY};
+      mGeometry->addEntity(source, xform, /*owner=*/0u);
+    }
+  } else {
+    const Ogre::NameValuePairList params{
+        {"mesh", mesh->getName()},
+        {"resourceGroup", mesh->getGroup()}
+    };
+
+    mEntities.reserve(mCount);
+    for (std::size_t i = 0; i < mCount; ++i) {
+      const std::string name{std::string{NODE_NAME} + "/" + std::to_string(i)};
+      auto *entity{static_cast<oo::Entity *>(mScnMgr->createMovableObject(
+          name, oo::EntityFactory::FACTORY_TYPE_NAME, &params))};
+      mRootNode->createChildSceneNode(getPosition(i))->attachObject(entity);
+      mEntities.push_back(entity);
+    }
+  }
+
+  const std::chrono::duration<float, std::milli> setupTime{
+      Clock::now() - startTime};
+  spdlog::get(oo::LOG)->info("InstancingStressTest: Placed {} copies of {} "
+                             "({}) in {} ms",
+                             mCount, mesh->getName(),
+                             mInstanced ? "instanced" : "not instanced",
+                             setupTime.count());
+}
+
+InstancingStressTest::~InstancingStressTest() {
+  for (auto *entity : mEntities) mScnMgr->destroyMovableObject(entity);
+  if (mGeometry) mScnMgr->destroyMovableObject(mGeometry);
+  mRootNode->removeAndDestroyAllChildren();
+  mScnMgr->destroySceneNode(mRootNode);
+}
+
+void InstancingStressTest::update(float delta) {
+  const auto frameTime{mSampler.addFrame(delta)};
+  if (!frameTime) return;
+
+  if (mGeometry) {
+    spdlog::get(oo::LOG)->info("InstancingStressTest: {} copies (instanced), "
+                               "{:.3f} ms per frame, {} of {} batches drawn",
+                               mCount, *frameTime,
+                               mGeometry->getNumVisibleBatches(),
+                               mGeometry->getNumBatches());
+  } else {
+    spdlog::get(oo::LOG)->info("InstancingStressTest: {} copies "
+                               "(not instanced), {:.3f} ms per frame",
+                               mCount, *frameTime);
+  }
+}
+
+} // namespace oo
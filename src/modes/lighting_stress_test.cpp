@@ -0,0 +1,74 @@
+#include "modes/lighting_stress_test.hpp"
+#include "util/settings.hpp"
+#include <OgreSceneNode.h>
+#include <spdlog/spdlog.h>
+#include <cmath>
+#include <string>
+
+namespace oo {
+
+LightingStressTest::LightingStressTest(
+    gsl::not_null<oo::DeferredSceneManager *> scnMgr,
+    const Ogre::Vector3 &centre,
+    std::size_t count,
+    bool clustered) : mScnMgr(scnMgr), mCount(count), mClustered(clustered),
+                      mWasClustered(scnMgr->getClusteredLightingEnabled()) {
+  mScnMgr->setClusteredLightingEnabled(mClustered);
+
+  auto *root{mScnMgr->getRootSceneNode()};
+  mRootNode = root->createChildSceneNode(NODE_NAME, centre);
+
+  const auto side{static_cast<std::size_t>(
+                      std::ceil(std::sqrt(static_cast<float>(count))))};
+  const float offset{0.5f * SPACING * static_cast<float>(side - 1u)};
+
+  mLights.reserve(mCount);
+  for (std::size_t i = 0; i < mCount; ++i) {
+    const auto x{static_cast<float>(i % side)};
+    const auto z{static_cast<float>(i / side)};
+    const bool isTorch{(i % side + i / side) % 2u == 0u};
+
+    const Ogre::Vector3 pos{x * SPACING - offset,
+                            isTorch ? 2.0f : 1.0f,
+                            z * SPACING - offset};
+    const float radius{isTorch ? 6.0f : 2.0f};
+    const Ogre::ColourValue colour{isTorch
+                                   ? Ogre::ColourValue{1.0f, 0.55f, 0.25f}
+                                   : Ogre::ColourValue{1.0f, 0.8f, 0.5f}};
+
+    const std::string name{std::string{NODE_NAME} + "/" + std::to_string(i)};
+    auto *light{mScnMgr->createLight(name)};
+    light->setType(Ogre::Light::LightTypes::LT_POINT);
+    light->setDiffuseColour(colour);
+    light->setSpecularColour(colour);
+    // Falls to about 1% of its brightness at the edge of its range.
+    light->setAttenuation(radius, 1.0f, 4.5f / radius,
+                          75.0f / (radius * radius));
+    mRootNode->createChildSceneNode(pos)->attachObject(light);
+    mLights.push_back(light);
+  }
+
+  spdlog::get(oo::LOG)->info("LightingStressTest: Placed {} point lights "
+                             "({})", mCount,
+                             mClustered ? "clustered" : "not clustered");
+}
+
+LightingStressTest::~LightingStressTest() {
+  for (auto *light : mLights) mScnMgr->destroyMovableObject(light);
+  mRootNode->removeAndDestroyAllChildren();
+  mScnMgr->destroySceneNode(mRootNode);
+  mScnMgr->setClusteredLightingEnabled(mWasClustered);
+}
+
+void LightingStressTest::update(float delta) {
+  const auto frameTime{mSampler.addFrame(delta)};
+  if (!frameTime) return;
+
+  spdlog::get(oo::LOG)->info("LightingStressTest: {} point lights ({}), "
+                             "{} visible, {:.3f} ms per frame",
+                             mCount, mClustered ? "clustered" : "not clustered",
+                             mScnMgr->_getLightsAffectingFrustum().size(),
+                             *frameTime);
+}
+
+} // namespace oo
@@ -2,56 +2,36 @@
 #include "modes/loading_menu_mode.hpp"
 #include "modes/game_mode.hpp"
 #include "save_state.hpp"
-#include <boost/range/adaptor/indexed.hpp>
 #include <nostdx/functional.hpp>
 #include <spdlog/fmt/bundled/chrono.h>
 
 namespace oo {
 
-std::vector<LoadMenuMode::SaveEntry>
-LoadMenuMode::getSaveEntries() const {
-  namespace fs = std::filesystem;
-  auto saveDir{oo::getSaveDirectory()};
-  std::vector<fs::directory_entry> saves{};
-
-  fs::directory_iterator begin(saveDir), end{};
-  std::copy_if(begin, end, std::back_inserter(saves), [](const auto &entry) {
-    return entry.path().extension() == ".ess";
-  });
-
-  std::sort(saves.begin(), saves.end(), [](const auto &a, const auto &b) {
-    return a.last_write_time() > b.last_write_time();
-  });
-
-  return saves;
-}
-
-std::string LoadMenuMode::getSaveName(const SaveState &saveState) const {
+std::string LoadMenuMode::getSaveName(const SaveHeader &header) const {
   // Number of real-world milliseconds the player has played for.
-  chrono::milliseconds playDuration{saveState.mGameTicksPassed};
+  chrono::milliseconds playDuration{header.gameTicksPassed};
 
   // C++20: Use <format> instead of {fmt}.
   return fmt::format("Save {} - Level {}\n"
                      "Play Time: {:%T}",
-                     saveState.mSaveNumber, saveState.mPlayerLevel,
-                     playDuration);
+                     header.saveNumber, header.playerLevel, playDuration);
 }
 
-std::string LoadMenuMode::getSaveDescription(const SaveState &saveState) const {
+std::string LoadMenuMode::getSaveDescription(const SaveHeader &header) const {
   // Number of in-game days that have passed.
-  auto gameDaysPassed{static_cast<long>(saveState.mGameDaysPassed)};
+  auto gameDaysPassed{static_cast<long>(header.gameDaysPassed)};
 
   // C++20: Convert the SystemTime date with <chrono> to get localised output.
   // C++20: Use <format> instead of {fmt}.
-  const auto date{saveState.mSaveTime};
+  const auto date{header.saveTime};
   return fmt::format("{}\n"
                      "Level {}\n"
                      "{}\n"
                      "Day {}\n"
                      "{}/{}/{} {}:{}",
-                     saveState.mPlayerName,
-                     saveState.mPlayerLevel,
-                     saveState.mPlayerCellName,
+                     header.playerName,
+                     header.playerLevel,
+                     header.playerCellName,
                      gameDaysPassed,
                      date.month, date.day, date.year, date.hour, date.minute);
 }
@@ -66,26 +46,29 @@ MenuMode<gui::MenuType::LoadMenu>::MenuMode(ApplicationContext &ctx)
       loadText{getElementWithId(7)},
       listPane{getElementWithId(9)} {
   getMenuCtx()->registerTemplates();
-  auto entries{getSaveEntries()};
-  for (const auto &entry : entries | boost::adaptors::indexed()) {
-    // Get the required metadata from the save game header.
-    oo::SaveState saveState(ctx.getBaseResolvers());
-    std::ifstream saveStream(entry.value().path(), std::ios_base::binary);
-    oo::readSaveHeader(saveStream, saveState);
 
-    auto name{getSaveName(saveState)};
+  // Cached save games are usually available almost immediately, the rest are
+  // added in updateImpl() as their headers are read.
+  mIndex.scan();
+  appendSaveGames();
+
+  getMenuCtx()->update();
+}
+
+void LoadMenuMode::appendSaveGames() {
+  const bool wasEmpty{mSaveGames.empty()};
+
+  for (auto &header : mIndex.poll()) {
+    auto name{getSaveName(header)};
 
     auto *templ{getMenuCtx()->appendTemplate(listPane, "load_game_template")};
-    templ->set_user(0, static_cast<float>(entry.index()));
+    templ->set_user(0, static_cast<float>(mSaveGames.size()));
     templ->set_user(3, std::move(name));
 
-    mSaveGames.emplace_back(templ, std::move(saveState),
-                            std::move(entry.value()));
+    mSaveGames.emplace_back(templ, std::move(header));
   }
 
-  setCurrentSave(0u);
-
-  getMenuCtx()->update();
+  if (wasEmpty && !mSaveGames.empty()) setCurrentSave(0u);
 }
 
 void LoadMenuMode::setCurrentSave(std::size_t index) {
@@ -93,7 +76,7 @@ void LoadMenuMode::setCurrentSave(std::size_t index) {
   mSaveIndex = index % mSaveGames.size();
 
   const auto &saveGame{mSaveGames[mSaveIndex]};
-  auto desc{getSaveDescription(saveGame.state)};
+  auto desc{getSaveDescription(saveGame.header)};
   loadText->set_string(std::move(desc));
 }
 
@@ -114,18 +97,18 @@ LoadMenuMode::handleEventImpl(ApplicationContext &ctx,
       },
       [&](oo::event::SlideRight e) -> transition_t {
         if (e.down) {
-          auto &saveGame{mSaveGames[mSaveIndex]};
-          std::ifstream saveStream(saveGame.entry.path(),
-                                   std::ios_base::binary);
-          saveStream >> saveGame.state;
+          if (mSaveGames.empty()) return {};
+          const auto &saveGame{mSaveGames[mSaveIndex]};
+          oo::SaveState state(ctx.getBaseResolvers());
+          *oo::openSaveGame(saveGame.header.path) >> state;
 
-          std::vector<oo::Path> plugins(saveGame.state.mPlugins.begin(),
-                                        saveGame.state.mPlugins.end());
+          std::vector<oo::Path> plugins(state.mPlugins.begin(),
+                                        state.mPlugins.end());
           if (!ctx.getCoordinator().contains(plugins.begin(), plugins.end())) {
             ctx.getLogger()->warn("Plugins are not compatible");
             return {};
           }
-          auto request{saveGame.state.makeCellRequest()};
+          auto request{state.makeCellRequest()};
           return {true, oo::LoadingMenuMode(ctx, std::move(request))};
         }
 
@@ -135,6 +118,8 @@ LoadMenuMode::handleEventImpl(ApplicationContext &ctx,
   }, *keyEvent);
 }
 
-void LoadMenuMode::updateImpl(ApplicationContext &/*ctx*/, float /*delta*/) {}
+void LoadMenuMode::updateImpl(ApplicationContext &/*ctx*/, float /*delta*/) {
+  if (!mIndex.isFinished()) appendSaveGames();
+}
 
 } // namespace oo
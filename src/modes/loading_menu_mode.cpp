@@ -128,6 +128,8 @@ LoadingMenuMode::reifyInteriorCell(const record::CELL &cellRec,
                                    ApplicationContext &ctx) {
   auto intPtr{std::static_pointer_cast<oo::InteriorCell>(
       oo::reifyRecord(cellRec, nullptr, nullptr, getCellResolvers(ctx)))};
+  intPtr->setScriptScheduler(&ctx.getScriptScheduler());
+  intPtr->setResolver(&oo::getResolver<record::CELL>(ctx.getBaseResolvers()));
   ctx.getCellCache()->push_back(intPtr);
   return intPtr;
 }
@@ -141,12 +143,25 @@ LoadingMenuMode::reifyInteriorCell(oo::BaseId cellId, ApplicationContext &ctx) {
   loadInteriorCell(cellRec, ctx);
   boost::this_fiber::yield();
 
+  ctx.getLogger()->info("Preparing models of interior CELL {}", cellId);
+  prepareCell(cellRec, ctx);
+
   ctx.getLogger()->info("Reifying interior CELL {}", cellId);
   mInteriorCell = reifyInteriorCell(cellRec, ctx);
 
   ctx.getLogger()->info("Loaded interior CELL {}", cellId);
 }
 
+void LoadingMenuMode::prepareCell(const record::CELL &cellRec,
+                                  ApplicationContext &ctx) {
+  // oo::prepareCell waits on the render thread, so cannot be run on it.
+  oo::JobCounter prepared{1};
+  oo::JobManager::runJob([&cellRec, &ctx, this]() {
+    oo::prepareCell(cellRec, getCellResolvers(ctx));
+  }, &prepared);
+  prepared.wait();
+}
+
 void LoadingMenuMode::loadExteriorCell(const record::CELL &cellRec,
                                        ApplicationContext &ctx) {
   auto &cellRes{oo::getResolver<record::CELL>(ctx.getBaseResolvers())};
@@ -168,6 +183,8 @@ LoadingMenuMode::reifyExteriorCell(const record::CELL &cellRec,
   auto extPtr{std::static_pointer_cast<oo::ExteriorCell>(
       oo::reifyRecord(cellRec, mWrld->getSceneManager().get(),
                       mWrld->getPhysicsWorld().get(), getCellResolvers(ctx)))};
+  extPtr->setScriptScheduler(&ctx.getScriptScheduler());
+  extPtr->setResolver(&oo::getResolver<record::CELL>(ctx.getBaseResolvers()));
   ctx.getCellCache()->push_back(extPtr);
   return extPtr;
 }
@@ -181,6 +198,9 @@ LoadingMenuMode::reifyExteriorCell(oo::BaseId cellId, ApplicationContext &ctx) {
   loadExteriorCell(cellRec, ctx);
   boost::this_fiber::yield();
 
+  ctx.getLogger()->info("Preparing models of exterior CELL {}", cellId);
+  prepareCell(cellRec, ctx);
+
   ctx.getLogger()->info("Reifying exterior CELL {}", cellId);
   mExteriorCells.emplace_back(reifyExteriorCell(cellRec, ctx));
   boost::this_fiber::yield();
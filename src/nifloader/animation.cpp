@@ -1,10 +1,12 @@
 #include "math/conversions.hpp"
+#include "mesh/skeletal_animation.hpp"
 #include "nifloader/animation.hpp"
 #include "nifloader/nif_resource_manager.hpp"
 #include <OgreAnimation.h>
 #include <OgreKeyFrame.h>
 #include <OgreBone.h>
 #include <algorithm>
+#include <memory>
 #include <set>
 #include <utility>
 #include <vector>
@@ -169,6 +171,8 @@ Ogre::Animation *createAnimation(Ogre::Skeleton *skeleton,
   const float length{stopTime - startTime};
 
   auto *anim{skeleton->createAnimation(animationName, length)};
+  // Copy of the keyframes that can be sampled off the render thread.
+  auto clip{std::make_shared<oo::AnimationClip>(length)};
 
   // TODO: Support animation priority and weight
 
@@ -192,6 +196,8 @@ Ogre::Animation *createAnimation(Ogre::Skeleton *skeleton,
     auto *bone{skeleton->getBone(boneName)};
 
     if (const auto *data{oo::getTransformData(blockGraph, interpolator)}) {
+      auto &clipTrack{clip->getTrack(bone->getHandle())};
+
       // Keyframes are split up by rotation, translation, and scale. They should
       // be ordered by increasing time, but this is not necessary and most
       // (all?) of our data is already ordered so we don't bother with a sort.
@@ -204,6 +210,7 @@ Ogre::Animation *createAnimation(Ogre::Skeleton *skeleton,
             auto *kf{track->createScalingKeyFrame(key.time)};
             const Ogre::Vector3 s{key.value, key.value, key.value};
             kf->setScale(s / scale);
+            clipTrack.addScaleKey(key.time, s / scale);
           }
         }, data->scales.keys);
       }
@@ -216,6 +223,7 @@ Ogre::Animation *createAnimation(Ogre::Skeleton *skeleton,
             auto *kf{track->createTranslationKeyFrame(key.time)};
             const auto t{oo::fromBSCoordinates(key.value)};
             kf->setTranslate(t - translation);
+            clipTrack.addTranslationKey(key.time, t - translation);
           }
         }, data->translations.keys);
       }
@@ -230,6 +238,7 @@ Ogre::Animation *createAnimation(Ogre::Skeleton *skeleton,
               auto *kf{track->createRotationKeyFrame(key.time)};
               const auto r{oo::fromBSCoordinates(key.value)};
               kf->setRotation(inv * r);
+              clipTrack.addRotationKey(key.time, inv * r);
             }
           }, data->quaternionKeys);
         }
@@ -244,6 +253,9 @@ Ogre::Animation *createAnimation(Ogre::Skeleton *skeleton,
     }
   }
 
+  oo::AnimationClipRegistry::add(skeleton->getName(), animationName,
+                                 std::move(clip));
+
   return anim;
 }
 
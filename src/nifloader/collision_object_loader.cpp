@@ -7,6 +7,17 @@
 
 namespace oo {
 
+void CollisionObjectLoader::prepareResource(Ogre::Resource *resource) {
+  auto nifPtr{Ogre::NifResourceManager::getSingleton()
+                  .getByName(resource->getName(), resource->getGroup())};
+  if (!nifPtr) {
+    OGRE_EXCEPT(Ogre::Exception::ERR_ITEM_NOT_FOUND,
+                "Could not load nif resource backing this collision object",
+                "CollisionObjectLoader::prepareResource()");
+  }
+  nifPtr->prepare();
+}
+
 void CollisionObjectLoader::loadResource(Ogre::Resource *resource) {
   auto collisionObject = dynamic_cast<Ogre::CollisionShape *>(resource);
   // TODO: Handle this properly
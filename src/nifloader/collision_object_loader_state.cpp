@@ -2,6 +2,7 @@
 #include "math/conversions.hpp"
 #include "nifloader/collision_object_loader_state.hpp"
 #include "nifloader/logging.hpp"
+#include "ogrebullet/bvh_cache.hpp"
 #include "ogrebullet/conversions.hpp"
 #include <boost/graph/copy.hpp>
 #include <boost/graph/depth_first_search.hpp>
@@ -472,8 +473,29 @@ parseNiTriStripsData(const oo::BlockGraph &, Ogre::CollisionShape *rigidBody,
   rigidBody->_setMeshInterface(std::move(collisionMesh));
 
   CollisionShapeVector v;
-  v.emplace_back(std::make_unique<btBvhTriangleMeshShape>(collisionMeshPtr,
-                                                          true));
+
+  // Building the BVH dominates the cost of loading the mesh, so reuse the one
+  // built last time these triangles were loaded, if there is one.
+  const bool useCache{Ogre::BvhCache::isEnabled()};
+  const uint64_t checksum{useCache
+                          ? Ogre::BvhCache::getChecksum(*collisionMeshPtr)
+                          : 0u};
+  if (auto bvh{useCache ? Ogre::BvhCache::load(checksum, *collisionMeshPtr)
+                        : nullptr}) {
+    auto shape{std::make_unique<btBvhTriangleMeshShape>(collisionMeshPtr,
+                                                        true, false)};
+    shape->setOptimizedBvh(bvh.get());
+    rigidBody->_setOptimizedBvh(std::move(bvh));
+    v.emplace_back(std::move(shape));
+    return v;
+  }
+
+  auto shape{std::make_unique<btBvhTriangleMeshShape>(collisionMeshPtr, true)};
+  if (useCache) {
+    Ogre::BvhCache::save(checksum, *collisionMeshPtr,
+                         *shape->getOptimizedBvh());
+  }
+  v.emplace_back(std::move(shape));
   return v;
 
   // TODO: Support dynamic concave geometry
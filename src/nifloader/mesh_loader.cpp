@@ -7,6 +7,17 @@
 
 namespace oo {
 
+void MeshLoader::prepareResource(Ogre::Resource *resource) {
+  auto nifPtr{Ogre::NifResourceManager::getSingleton()
+                  .getByName(resource->getName(), resource->getGroup())};
+  if (!nifPtr) {
+    OGRE_EXCEPT(Ogre::Exception::ERR_ITEM_NOT_FOUND,
+                "Could not load nif resource backing this mesh",
+                "MeshLoader::prepareResource()");
+  }
+  nifPtr->prepare();
+}
+
 void MeshLoader::loadResource(Ogre::Resource *resource) {
   auto mesh = dynamic_cast<oo::Mesh *>(resource);
   // TODO: Handle this properly
@@ -1,5 +1,6 @@
 #include "fs/path.hpp"
 #include "math/conversions.hpp"
+#include "mesh/lod_generator.hpp"
 #include "nifloader/logging.hpp"
 #include "nifloader/mesh_loader_state.hpp"
 #include <boost/algorithm/string/predicate.hpp>
@@ -62,70 +63,125 @@ long numCCWTriangles(const nif::NiTriShapeData &block) {
   });
 }
 
-std::unique_ptr<Ogre::VertexData>
-generateVertexData(const nif::NiGeometryData &block,
-                   Ogre::Matrix4 transformation,
-                   std::vector<nif::compound::Vector3> *bitangents,
-                   std::vector<nif::compound::Vector3> *tangents,
-                   std::vector<BoneBinding> *boneBindings) {
-  // Ogre expects a heap allocated raw pointer, but to improve exception safety
-  // we construct an unique_ptr then relinquish control of it to Ogre.
-  auto vertexData{std::make_unique<Ogre::VertexData>()};
-  vertexData->vertexCount = block.numVertices;
-  auto vertDecl{vertexData->vertexDeclaration};
-  auto vertBind{vertexData->vertexBufferBinding};
-  auto *hwBufMgr{Ogre::HardwareBufferManager::getSingletonPtr()};
+namespace {
 
-  // Specify the order of data in the vertex buffer. This is per vertex,
-  // so the vertices, normals etc will have to be interleaved in the buffer.
-  std::ptrdiff_t offset{0};
-  std::size_t vertSize{0};
-  const unsigned short source{0};
+/// Number of floats in each vertex of the interleaved vertex buffer.
+/// This must agree with the vertex declaration built by `uploadVertexData()`.
+constexpr std::ptrdiff_t floatsPerVertex(bool hasBones) noexcept {
+  // Position, normal, colour, uv, bitangent, tangent, and optionally blend
+  // indices and blend weights.
+  return 3 + 3 + 3 + 2 + 3 + 3 + (hasBones ? 4 + 4 : 0);
+}
 
-  // Vertices
-  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
-  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-  offset += 3;
+/// Return the staged geometry of the given vertex, or nullptr if there is
+/// none.
+StagedGeometry *findStagedGeometry(StagedGeometryMap *staged,
+                                   oo::BlockGraph::vertex_descriptor v) {
+  if (!staged) return nullptr;
+  auto it{staged->find(v)};
+  return it != staged->end() ? &it->second : nullptr;
+}
 
-  if (boneBindings) {
-    // Blend indices
-    vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT4,
-                         Ogre::VES_BLEND_INDICES);
-    vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT4);
-    offset += 4;
+/// Generate simplified index data for each level of detail in
+/// `oo::DEFAULT_LOD_LEVELS`, stopping at the first level that would not be
+/// any simpler than the previous one. Skinned geometry is not simplified,
+/// since collapsing edges does not account for the vertices' bone weights.
+std::vector<StagedIndexData>
+stageLodIndexData(const StagedVertexData &vertexData,
+                  const StagedIndexData &indexData) {
+  std::vector<StagedIndexData> lods{};
+  if (vertexData.hasBones) return lods;
+
+  const auto opType{indexData.operationType};
+  if (opType != Ogre::RenderOperation::OT_TRIANGLE_LIST
+      && opType != Ogre::RenderOperation::OT_TRIANGLE_STRIP) {
+    return lods;
+  }
 
-    // Blend weights
-    vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT4,
-                         Ogre::VES_BLEND_WEIGHTS);
-    vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT4);
-    offset += 4;
+  const auto triangles{opType == Ogre::RenderOperation::OT_TRIANGLE_LIST
+                       ? indexData.buffer
+                       : oo::triangleStripToList(indexData.buffer)};
+  const std::size_t numTriangles{triangles.size() / 3u};
+  if (numTriangles < oo::MIN_LOD_TRIANGLES) return lods;
+
+  const auto stride{floatsPerVertex(vertexData.hasBones)};
+  std::size_t lastNumTriangles{numTriangles};
+
+  for (const auto &level : oo::DEFAULT_LOD_LEVELS) {
+    const auto target{static_cast<std::size_t>(level.reduction * numTriangles)};
+    auto simplified{oo::simplifyTriangleList(vertexData.buffer,
+                                             static_cast<std::size_t>(stride),
+                                             triangles, target)};
+    if (simplified.empty() || simplified.size() / 3u >= lastNumTriangles) {
+      break;
+    }
+    lastNumTriangles = simplified.size() / 3u;
+
+    StagedIndexData &lod{lods.emplace_back()};
+    lod.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+    lod.buffer = std::move(simplified);
   }
 
-  // Normals
-  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
-  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-  offset += 3;
+  return lods;
+}
 
-  // Vertex colours
-  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_DIFFUSE);
-  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-  offset += 3;
+/// Submeshes whose bounding sphere is smaller than this are too small to hide
+/// much behind them, so are not used as occluders.
+constexpr float MIN_OCCLUDER_RADIUS{1.0f};
+
+/// Return the vertex positions of the triangles of a submesh, three for each
+/// triangle, for use as an occluder. Returns nothing for skinned submeshes.
+///
+/// An occluder must never cover more of the screen than the submesh does, or
+/// objects seen through it will be culled. The simplified levels of detail do
+/// not have this property since simplification can close doorways, windows,
+/// and other small gaps, so the full detail geometry is used instead.
+std::vector<Ogre::Vector3>
+getOccluderTriangles(const StagedGeometry &staged) {
+  // Skinned geometry is deformed by its skeleton, so where it is drawn has
+  // little to do with its bind pose.
+  if (staged.vertexData.hasBones) return {};
+
+  const auto &indexData{staged.indexData};
+  const auto opType{indexData.operationType};
+  if (opType != Ogre::RenderOperation::OT_TRIANGLE_LIST
+      && opType != Ogre::RenderOperation::OT_TRIANGLE_STRIP) {
+    return {};
+  }
 
-  // UVs
-  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT2,
-                       Ogre::VES_TEXTURE_COORDINATES, 0);
-  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
-  offset += 2;
+  const auto triangles{opType == Ogre::RenderOperation::OT_TRIANGLE_LIST
+                       ? indexData.buffer
+                       : oo::triangleStripToList(indexData.buffer)};
+  const auto stride{floatsPerVertex(staged.vertexData.hasBones)};
+  const auto &vertices{staged.vertexData.buffer};
+
+  std::vector<Ogre::Vector3> positions;
+  positions.reserve(triangles.size());
+  for (uint16_t index : triangles) {
+    const auto offset{static_cast<std::size_t>(stride) * index};
+    if (offset + 3u > vertices.size()) return {};
+    positions.emplace_back(vertices[offset], vertices[offset + 1u],
+                           vertices[offset + 2u]);
+  }
 
-  // Bitangents
-  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_BINORMAL);
-  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-  offset += 3;
+  return positions;
+}
 
-  // Tangents
-  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_TANGENT);
-  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
-  offset += 3;
+} // namespace
+
+StagedVertexData
+stageVertexData(const nif::NiGeometryData &block,
+                Ogre::Matrix4 transformation,
+                std::vector<nif::compound::Vector3> *bitangents,
+                std::vector<nif::compound::Vector3> *tangents,
+                std::vector<BoneBinding> *boneBindings) {
+  StagedVertexData staged{};
+  staged.vertexCount = block.numVertices;
+  staged.hasBones = boneBindings != nullptr;
+
+  // The vertices, normals etc. are interleaved in the buffer, see
+  // uploadVertexData() for the order.
+  const std::ptrdiff_t offset{floatsPerVertex(staged.hasBones)};
 
   // Normal vectors are not translated and transform with the inverse
   // transpose of the transformation matrix. We will also need this for tangents
@@ -145,7 +201,8 @@ generateVertexData(const nif::NiGeometryData &block,
   // and so on with a row for each of the elements of the vertex
   // declaration.
   // TODO: Is there an efficient transpose algorithm to make this abstraction worthwhile?
-  std::vector<float> vertexBuffer(offset * block.numVertices);
+  auto &vertexBuffer{staged.buffer};
+  vertexBuffer.resize(offset * block.numVertices);
   std::size_t localOffset{0};
 
   // Vertices
@@ -285,59 +342,137 @@ generateVertexData(const nif::NiGeometryData &block,
     // TODO: Compute the tangents if they don't exist
   }
 
+  return staged;
+}
+
+std::unique_ptr<Ogre::VertexData>
+uploadVertexData(const StagedVertexData &staged) {
+  // Ogre expects a heap allocated raw pointer, but to improve exception safety
+  // we construct an unique_ptr then relinquish control of it to Ogre.
+  auto vertexData{std::make_unique<Ogre::VertexData>()};
+  vertexData->vertexCount = staged.vertexCount;
+  auto vertDecl{vertexData->vertexDeclaration};
+  auto vertBind{vertexData->vertexBufferBinding};
+  auto *hwBufMgr{Ogre::HardwareBufferManager::getSingletonPtr()};
+
+  // Specify the order of data in the vertex buffer. This is per vertex,
+  // so the vertices, normals etc will have to be interleaved in the buffer.
+  std::size_t vertSize{0};
+  const unsigned short source{0};
+
+  // Vertices
+  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+
+  if (staged.hasBones) {
+    // Blend indices
+    vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT4,
+                         Ogre::VES_BLEND_INDICES);
+    vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT4);
+
+    // Blend weights
+    vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT4,
+                         Ogre::VES_BLEND_WEIGHTS);
+    vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT4);
+  }
+
+  // Normals
+  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+
+  // Vertex colours
+  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_DIFFUSE);
+  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+
+  // UVs
+  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT2,
+                       Ogre::VES_TEXTURE_COORDINATES, 0);
+  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+
+  // Bitangents
+  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_BINORMAL);
+  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+
+  // Tangents
+  vertDecl->addElement(source, vertSize, Ogre::VET_FLOAT3, Ogre::VES_TANGENT);
+  vertSize += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+
+  assert(vertSize == static_cast<std::size_t>(floatsPerVertex(staged.hasBones))
+      * sizeof(float));
+
   // Copy the vertex buffer into a hardware buffer, and link the buffer to
   // the vertex declaration.
   const auto usage{Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY};
   const auto bpv{vertSize};
 
-  auto hwBuf{hwBufMgr->createVertexBuffer(bpv, block.numVertices, usage)};
-  hwBuf->writeData(0, hwBuf->getSizeInBytes(), vertexBuffer.data(), true);
+  auto hwBuf{hwBufMgr->createVertexBuffer(bpv, staged.vertexCount, usage)};
+  hwBuf->writeData(0, hwBuf->getSizeInBytes(), staged.buffer.data(), true);
 
   vertBind->setBinding(source, hwBuf);
 
   return vertexData;
 }
 
-std::unique_ptr<Ogre::IndexData>
-generateIndexData(const nif::NiTriShapeData &block) {
-  auto &hwBufMgr{Ogre::HardwareBufferManager::getSingleton()};
+std::unique_ptr<Ogre::VertexData>
+generateVertexData(const nif::NiGeometryData &block,
+                   Ogre::Matrix4 transformation,
+                   std::vector<nif::compound::Vector3> *bitangents,
+                   std::vector<nif::compound::Vector3> *tangents,
+                   std::vector<BoneBinding> *boneBindings) {
+  return oo::uploadVertexData(oo::stageVertexData(block, transformation,
+                                                  bitangents, tangents,
+                                                  boneBindings));
+}
 
+StagedIndexData stageIndexData(const nif::NiTriShapeData &block) {
   // We can assume that compound::Triangle has no padding and std::vector
-  // is sequential, so can avoid copying the faces.
+  // is sequential, so can copy the faces directly.
   auto indexBuffer{reinterpret_cast<const uint16_t *>(block.triangles.data())};
-
-  const auto usage{Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY};
-  const auto itype{Ogre::HardwareIndexBuffer::IT_16BIT};
   const std::size_t numIndices{3u * block.numTriangles};
 
-  // Copy the triangle (index) buffer into a hardware buffer.
-  auto hwBuf{hwBufMgr.createIndexBuffer(itype, numIndices, usage)};
-  hwBuf->writeData(0, hwBuf->getSizeInBytes(), indexBuffer, true);
-
-  auto indexData{std::make_unique<Ogre::IndexData>()};
-  indexData->indexBuffer = hwBuf;
-  indexData->indexCount = numIndices;
-  indexData->indexStart = 0;
-  return indexData;
+  StagedIndexData staged{};
+  staged.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+  staged.buffer.assign(indexBuffer, indexBuffer + numIndices);
+  return staged;
 }
 
-std::unique_ptr<Ogre::IndexData>
-generateIndexData(const nif::NiTriStripsData &block) {
-  auto &hwBufMgr = Ogre::HardwareBufferManager::getSingleton();
-
-  const auto usage{Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY};
-  const auto itype{Ogre::HardwareIndexBuffer::IT_16BIT};
+StagedIndexData stageIndexData(const nif::NiTriStripsData &block) {
   const std::size_t numIndices{std::accumulate(block.stripLengths.begin(),
                                                block.stripLengths.end(), 0u)};
 
-  std::vector<uint16_t> buf{};
-  buf.reserve(numIndices);
+  StagedIndexData staged{};
+  staged.operationType = Ogre::RenderOperation::OT_TRIANGLE_STRIP;
+  staged.buffer.reserve(numIndices);
   for (const auto &strip : block.points) {
-    buf.insert(buf.end(), strip.begin(), strip.end());
+    staged.buffer.insert(staged.buffer.end(), strip.begin(), strip.end());
   }
+  return staged;
+}
+
+StagedIndexData stageIndexData(const nif::NiGeometryData &block) {
+  if (dynamic_cast<const nif::NiTriShapeData *>(&block)) {
+    const auto &triShape{dynamic_cast<const nif::NiTriShapeData &>(block)};
+    return oo::stageIndexData(triShape);
+  } else if (dynamic_cast<const nif::NiTriStripsData *>(&block)) {
+    const auto &triStrips{dynamic_cast<const nif::NiTriStripsData &>(block)};
+    return oo::stageIndexData(triStrips);
+  }
+  return StagedIndexData{};
+}
+
+std::unique_ptr<Ogre::IndexData>
+uploadIndexData(const StagedIndexData &staged) {
+  if (staged.buffer.empty()) return std::unique_ptr<Ogre::IndexData>{};
+
+  auto &hwBufMgr{Ogre::HardwareBufferManager::getSingleton()};
 
+  const auto usage{Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY};
+  const auto itype{Ogre::HardwareIndexBuffer::IT_16BIT};
+  const std::size_t numIndices{staged.buffer.size()};
+
+  // Copy the triangle (index) buffer into a hardware buffer.
   auto hwBuf{hwBufMgr.createIndexBuffer(itype, numIndices, usage)};
-  hwBuf->writeData(0, hwBuf->getSizeInBytes(), buf.data(), true);
+  hwBuf->writeData(0, hwBuf->getSizeInBytes(), staged.buffer.data(), true);
 
   auto indexData{std::make_unique<Ogre::IndexData>()};
   indexData->indexBuffer = hwBuf;
@@ -346,18 +481,22 @@ generateIndexData(const nif::NiTriStripsData &block) {
   return indexData;
 }
 
+std::unique_ptr<Ogre::IndexData>
+generateIndexData(const nif::NiTriShapeData &block) {
+  return oo::uploadIndexData(oo::stageIndexData(block));
+}
+
+std::unique_ptr<Ogre::IndexData>
+generateIndexData(const nif::NiTriStripsData &block) {
+  return oo::uploadIndexData(oo::stageIndexData(block));
+}
+
 std::unique_ptr<Ogre::IndexData>
 generateIndexData(const nif::NiGeometryData &block, oo::SubMesh *submesh) {
-  if (dynamic_cast<const nif::NiTriShapeData *>(&block)) {
-    submesh->operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
-    const auto &triShape{dynamic_cast<const nif::NiTriShapeData &>(block)};
-    return oo::generateIndexData(triShape);
-  } else if (dynamic_cast<const nif::NiTriStripsData *>(&block)) {
-    submesh->operationType = Ogre::RenderOperation::OT_TRIANGLE_STRIP;
-    const auto &triStrips{dynamic_cast<const nif::NiTriStripsData &>(block)};
-    return oo::generateIndexData(triStrips);
-  }
-  return std::unique_ptr<Ogre::IndexData>{};
+  auto staged{oo::stageIndexData(block)};
+  if (staged.buffer.empty()) return std::unique_ptr<Ogre::IndexData>{};
+  submesh->operationType = staged.operationType;
+  return oo::uploadIndexData(staged);
 }
 
 std::vector<BoneBinding> getBoneBindings(const nif::NiSkinPartition &skin) {
@@ -974,10 +1113,50 @@ bool attachMaterialProperty(const oo::BlockGraph &g,
   return true;
 }
 
+StagedGeometry stageNiTriBasedGeom(const oo::BlockGraph &g,
+                                   const nif::NiTriBasedGeom &block,
+                                   const Ogre::Matrix4 &transform,
+                                   bool generateLods) {
+  auto boneAssignments{oo::getBoneAssignments(g, block)};
+  const auto hasBones{!boneAssignments.bindings.empty()};
+
+  const auto &geomData{oo::getBlock<nif::NiGeometryData>(g, block.data)};
+
+  // For normal mapping we need tangent and bitangent information given inside
+  // an NiBinaryExtraData block. For low versions, the extra data is arranged
+  // like a linked list, and for high versions it's an array.
+  auto[bitangents, tangents] = [&g, &block]() {
+    // TODO: Support the linked list version
+    return block.extraDataArray ? oo::parseTangentData(g, *block.extraDataArray)
+                                : TangentData{};
+  }();
+
+  // Ogre::SubMeshes cannot have transformations applied to them (that is
+  // reserved for Ogre::SceneNodes), so we will apply it to all the vertex
+  // information manually.
+  const auto totalTrans{transform * getTransform(block)};
+
+  StagedGeometry staged{};
+  staged.vertexData = oo::stageVertexData(geomData, totalTrans,
+                                          &bitangents, &tangents,
+                                          hasBones ? &boneAssignments.bindings
+                                                   : nullptr);
+  staged.indexData = oo::stageIndexData(geomData);
+  if (generateLods) {
+    staged.lodIndexData = oo::stageLodIndexData(staged.vertexData,
+                                                staged.indexData);
+  }
+  if (hasBones) staged.boneNames = std::move(boneAssignments.names);
+  staged.bounds = getBoundingBox(geomData, totalTrans);
+
+  return staged;
+}
+
 BoundedSubmesh parseNiTriBasedGeom(const oo::BlockGraph &g,
                                    oo::Mesh *mesh,
                                    const nif::NiTriBasedGeom &block,
-                                   const Ogre::Matrix4 &transform) {
+                                   const Ogre::Matrix4 &transform,
+                                   StagedGeometry *staged) {
   // If this submesh has already been loaded, return it.
   // Can return an empty bounding box because if the submesh has already been
   // loaded then its bbox has already been merged in; we don't need it again.
@@ -988,10 +1167,18 @@ BoundedSubmesh parseNiTriBasedGeom(const oo::BlockGraph &g,
     }
   }
 
+  // Read the geometry now if it was not staged ahead of time. This is on the
+  // render thread, so skip the expensive level of detail generation.
+  StagedGeometry localStaged{};
+  if (!staged) {
+    localStaged = oo::stageNiTriBasedGeom(g, block, transform, false);
+    staged = &localStaged;
+  }
+
   auto submesh{mesh->createSubMesh(block.name.str())};
 
-  auto boneAssignments{oo::getBoneAssignments(g, block)};
-  const auto hasBones{!boneAssignments.bindings.empty()};
+  const auto hasBones{staged->vertexData.hasBones};
+  bool isOpaque{false};
 
   if (oo::attachMaterialProperty(g, block.properties, submesh)) {
     auto &matMgr{Ogre::MaterialManager::getSingleton()};
@@ -1008,37 +1195,48 @@ BoundedSubmesh parseNiTriBasedGeom(const oo::BlockGraph &g,
       pass->getParent()->setSchemeName("NoGBuffer");
     } else {
       oo::addDeferredFragmentShader(pass);
+      isOpaque = true;
     }
     oo::attachStencilProperty(g, block.properties, pass);
   }
 
-  const auto &geomData{oo::getBlock<nif::NiGeometryData>(g, block.data)};
+  // Transfer ownership to Ogre
+  submesh->vertexData = oo::uploadVertexData(staged->vertexData);
+  submesh->indexData = oo::uploadIndexData(staged->indexData);
+  if (submesh->indexData) {
+    submesh->operationType = staged->indexData.operationType;
+  }
+  for (const auto &lod : staged->lodIndexData) {
+    submesh->lodIndexData.emplace_back(oo::uploadIndexData(lod));
+  }
 
-  // For normal mapping we need tangent and bitangent information given inside
-  // an NiBinaryExtraData block. For low versions, the extra data is arranged
-  // like a linked list, and for high versions it's an array.
-  auto[bitangents, tangents] = [&g, &block]() {
-    // TODO: Support the linked list version
-    return block.extraDataArray ? oo::parseTangentData(g, *block.extraDataArray)
-                                : TangentData{};
-  }();
+  // Every submesh is simplified using the same levels, though small submeshes
+  // may stop early and use their least detailed level instead.
+  const auto numLods{submesh->lodIndexData.size()};
+  if (mesh->getNumLodLevels() < numLods + 1u) {
+    std::vector<float> screenSizes(numLods);
+    std::transform(oo::DEFAULT_LOD_LEVELS.begin(),
+                   oo::DEFAULT_LOD_LEVELS.begin() + numLods,
+                   screenSizes.begin(),
+                   [](const auto &level) { return level.screenSize; });
+    mesh->_setLodScreenSizes(std::move(screenSizes));
+  }
+  if (hasBones) submesh->boneNames = std::move(staged->boneNames);
+  submesh->bounds = staged->bounds;
 
-  // Ogre::SubMeshes cannot have transformations applied to them (that is
-  // reserved for Ogre::SceneNodes), so we will apply it to all the vertex
-  // information manually.
-  const auto totalTrans{transform * getTransform(block)};
-  auto vertexData{oo::generateVertexData(geomData, totalTrans,
-                                         &bitangents, &tangents,
-                                         hasBones ? &boneAssignments.bindings
-                                                  : nullptr)};
-  auto indexData{oo::generateIndexData(geomData, submesh)};
+  if (isOpaque && staged->bounds.isFinite()
+      && staged->bounds.getHalfSize().length() >= MIN_OCCLUDER_RADIUS) {
+    mesh->_addOccluderTriangles(oo::getOccluderTriangles(*staged));
+  }
 
-  // Transfer ownership to Ogre
-  submesh->vertexData = std::move(vertexData);
-  submesh->indexData = std::move(indexData);
-  if (hasBones) submesh->boneNames = std::move(boneAssignments.names);
+  // Keep the geometry of submeshes that could be batched, since the hardware
+  // buffers cannot be read back. The staged geometry is not used again.
+  if (isOpaque && !hasBones && submesh->indexData) {
+    submesh->stagedVertices = std::move(staged->vertexData.buffer);
+    submesh->stagedIndices = std::move(staged->indexData.buffer);
+  }
 
-  return {submesh, getBoundingBox(geomData, totalTrans)};
+  return {submesh, staged->bounds};
 }
 
 MeshLoaderState::MeshLoaderState(oo::Mesh *mesh, Graph blocks)
@@ -1087,7 +1285,7 @@ void MeshLoaderState::finish_vertex(vertex_descriptor v, const Graph &g) {
 }
 
 void createMesh(oo::Mesh *mesh, oo::BlockGraph::vertex_descriptor start,
-                const oo::BlockGraph &g) {
+                const oo::BlockGraph &g, StagedGeometryMap *staged) {
   const auto &rootBlock{*g[start]};
   if (!dynamic_cast<const nif::NiNode *>(&rootBlock)) {
     OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS,
@@ -1107,7 +1305,9 @@ void createMesh(oo::Mesh *mesh, oo::BlockGraph::vertex_descriptor start,
     if (!dynamic_cast<const nif::NiTriBasedGeom *>(&block)) continue;
 
     const auto &geom{static_cast<const nif::NiTriBasedGeom &>(block)};
-    auto[submesh, subBounds]{oo::parseNiTriBasedGeom(g, mesh, geom, transform)};
+    auto *stagedGeom{oo::findStagedGeometry(staged, v)};
+    auto[submesh, subBounds]{oo::parseNiTriBasedGeom(g, mesh, geom, transform,
+                                                     stagedGeom)};
     auto bounds{mesh->getBounds()};
     bounds.merge(subBounds);
     mesh->_setBounds(bounds);
@@ -1117,7 +1317,7 @@ void createMesh(oo::Mesh *mesh, oo::BlockGraph::vertex_descriptor start,
 
 void createRawMesh(oo::Mesh *mesh, const Ogre::MaterialPtr &matPtr,
                    oo::BlockGraph::vertex_descriptor start,
-                   const oo::BlockGraph &g) {
+                   const oo::BlockGraph &g, StagedGeometryMap *staged) {
   const auto &rootBlock{*g[start]};
   if (!dynamic_cast<const nif::NiTriBasedGeom *>(&rootBlock)) {
     OGRE_EXCEPT(Ogre::Exception::ERR_INVALIDPARAMS,
@@ -1131,7 +1331,9 @@ void createRawMesh(oo::Mesh *mesh, const Ogre::MaterialPtr &matPtr,
   // There is no root node here, just a single NiTriBasedGeom submesh.
   const Ogre::Matrix4 transform{Ogre::Matrix4::IDENTITY};
   const auto &geom{static_cast<const nif::NiTriBasedGeom &>(rootBlock)};
-  auto[submesh, bounds]{oo::parseNiTriBasedGeom(g, mesh, geom, transform)};
+  auto *stagedGeom{oo::findStagedGeometry(staged, start)};
+  auto[submesh, bounds]{oo::parseNiTriBasedGeom(g, mesh, geom, transform,
+                                                stagedGeom)};
   submesh->setMaterialName(matPtr->getName(), matPtr->getGroup());
   mesh->_setBounds(bounds);
   mesh->_setBoundingSphereRadius(Ogre::Math::boundingRadiusFromAABB(bounds));
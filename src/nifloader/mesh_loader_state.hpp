@@ -4,6 +4,7 @@
 #include "mesh/mesh.hpp"
 #include "mesh/submesh.hpp"
 #include "nifloader/loader.hpp"
+#include "nifloader/staged_geometry.hpp"
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -77,8 +78,26 @@ struct BoneAssignments {
 BoneAssignments getBoneAssignments(const oo::BlockGraph &g,
                                    const nif::NiTriBasedGeom &block);
 
+/// Read vertex, normal, and texcoord data from `nif::NiGeometryData` and
+/// interleave it into a buffer in main memory.
+/// \remark This does not use any GPU resources, so can be called from any
+///         thread.
+StagedVertexData
+stageVertexData(const nif::NiGeometryData &block,
+                Ogre::Matrix4 transformation,
+                std::vector<nif::compound::Vector3> *bitangents,
+                std::vector<nif::compound::Vector3> *tangents,
+                std::vector<BoneBinding> *boneBindings);
+
+/// Copy staged vertex data into a hardware buffer and prepare it for
+/// rendering.
+/// \remark Must be called on the render thread.
+std::unique_ptr<Ogre::VertexData>
+uploadVertexData(const StagedVertexData &staged);
+
 /// Read vertex, normal, and texcoord data from `nif::NiGeometryData` and
 /// prepare it for rendering.
+/// Equivalent to `oo::uploadVertexData()` of `oo::stageVertexData()`.
 std::unique_ptr<Ogre::VertexData>
 generateVertexData(const nif::NiGeometryData &block,
                    Ogre::Matrix4 transformation,
@@ -86,6 +105,23 @@ generateVertexData(const nif::NiGeometryData &block,
                    std::vector<nif::compound::Vector3> *tangents,
                    std::vector<BoneBinding> *boneBindings);
 
+/// Read triangle data from `nif::NiTriShapeData` into a buffer in main memory.
+StagedIndexData stageIndexData(const nif::NiTriShapeData &block);
+
+/// Read triangle strip data from `nif::NiTriStripsData` into a buffer in main
+/// memory.
+StagedIndexData stageIndexData(const nif::NiTriStripsData &block);
+
+/// Dispatch to the appropriate overload of `oo::stageIndexData()` for the most
+/// derived type of `block`. Returns empty index data if `block` has no
+/// triangles.
+StagedIndexData stageIndexData(const nif::NiGeometryData &block);
+
+/// Copy staged index data into a hardware buffer and prepare it for rendering.
+/// Returns nullptr if there is no index data.
+/// \remark Must be called on the render thread.
+std::unique_ptr<Ogre::IndexData> uploadIndexData(const StagedIndexData &staged);
+
 /// Read triangle data from `nif::NiTriShapeData` and prepare it for rendering.
 std::unique_ptr<Ogre::IndexData>
 generateIndexData(const nif::NiTriShapeData &block);
@@ -169,13 +205,30 @@ bool attachMaterialProperty(const oo::BlockGraph &g,
                             const nif::NiPropertyArray &properties,
                             Ogre::SubMesh *submesh);
 
+/// Build the vertex and index data of the `oo::SubMesh` described by `block`
+/// in main memory, transformed by `transform` and the transformation of
+/// `block` itself. If `generateLods` is true then simplified index data is
+/// also built for each level of detail, which is slow so should only be done
+/// off the render thread.
+/// \remark This does not use any GPU resources, so can be called from any
+///         thread.
+StagedGeometry stageNiTriBasedGeom(const oo::BlockGraph &g,
+                                   const nif::NiTriBasedGeom &block,
+                                   const Ogre::Matrix4 &transform,
+                                   bool generateLods);
+
 /// \remark `nif::NiTriBasedGeom` blocks determine discrete pieces of geometry
 ///         with a single material and texture, and so translate to
 ///         `oo::SubMesh` objects.
+/// \remark If `staged` is not null then it must be the result of
+///         `oo::stageNiTriBasedGeom()` with the same `block` and `transform`,
+///         and is used instead of reading the geometry again. Its buffers may
+///         be moved from.
 BoundedSubmesh parseNiTriBasedGeom(const oo::BlockGraph &g,
                                    oo::Mesh *mesh,
                                    const nif::NiTriBasedGeom &block,
-                                   const Ogre::Matrix4 &transform);
+                                   const Ogre::Matrix4 &transform,
+                                   StagedGeometry *staged = nullptr);
 
 class MeshLoaderState {
  public:
@@ -202,14 +255,20 @@ class MeshLoaderState {
   Ogre::Matrix4 mTransform{Ogre::Matrix4::IDENTITY};
 };
 
+/// Populate `mesh` with a submesh for each `nif::NiTriBasedGeom` child of the
+/// `nif::NiNode` `start`.
+/// Geometry found in `staged`, which is keyed by the vertices of `g`, is used
+/// instead of reading it from the block graph again.
 void createMesh(oo::Mesh *mesh,
                 oo::BlockGraph::vertex_descriptor start,
-                const oo::BlockGraph &g);
+                const oo::BlockGraph &g,
+                StagedGeometryMap *staged = nullptr);
 
 void createRawMesh(oo::Mesh *mesh,
                    const Ogre::MaterialPtr &matPtr,
                    oo::BlockGraph::vertex_descriptor start,
-                   const oo::BlockGraph &g);
+                   const oo::BlockGraph &g,
+                   StagedGeometryMap *staged = nullptr);
 /// @}
 
 } // namespace oo
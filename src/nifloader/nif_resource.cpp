@@ -1,7 +1,12 @@
+#include "nifloader/collision_object_loader_state.hpp"
 #include "nifloader/logging.hpp"
+#include "nifloader/mesh_loader_state.hpp"
 #include "nifloader/nif_resource.hpp"
 #include "ogre/ogre_stream_wrappers.hpp"
+#include "ogrebullet/collision_shape_manager.hpp"
 #include <OgreResourceGroupManager.h>
+#include <gsl/gsl>
+#include <utility>
 
 namespace Ogre {
 
@@ -17,7 +22,37 @@ NifResource::BlockGraph NifResource::getBlockGraph() const {
   return mBlockGraph;
 }
 
-void NifResource::loadImpl() {
+namespace {
+
+/// Whether the resource being prepared on this thread, if any, is being
+/// prepared in the background. `Resource::prepare()` calls `prepareImpl()` on
+/// the calling thread, but does not pass it `backgroundThread`.
+thread_local bool tIsBackgroundPrepare{false};
+
+} // namespace
+
+void NifResource::prepare(bool backgroundThread) {
+  // Restore rather than clear, in case this is nested in another preparation.
+  const bool wasBackground{std::exchange(tIsBackgroundPrepare,
+                                         backgroundThread)};
+  auto reset{gsl::finally([wasBackground]() {
+    tIsBackgroundPrepare = wasBackground;
+  })};
+  Resource::prepare(backgroundThread);
+}
+
+void NifResource::load(bool backgroundThread) {
+  // Blocks until any concurrent preparation has finished.
+  prepare(backgroundThread);
+  Resource::load(backgroundThread);
+}
+
+oo::StagedGeometryMap NifResource::takeStagedGeometry() {
+  std::scoped_lock lock{mStagedGeometryMutex};
+  return std::exchange(mStagedGeometry, {});
+}
+
+void NifResource::prepareImpl() {
   auto &resGrpMgr{ResourceGroupManager::getSingleton()};
 
   oo::nifloaderLogger()->info("Nif: {}", getName());
@@ -27,10 +62,78 @@ void NifResource::loadImpl() {
   std::istream is{&dataStreamBuf};
 
   mBlockGraph = oo::createBlockGraph(is);
+
+  stageGeometry(tIsBackgroundPrepare);
+  createCollisionShapes();
+}
+
+void NifResource::unprepareImpl() {
+  mBlockGraph = oo::BlockGraph{};
+  takeStagedGeometry();
 }
 
+// Everything was done in prepareImpl(), which OGRE calls before this if the
+// resource has not been prepared already.
+void NifResource::loadImpl() {}
+
 void NifResource::unloadImpl() {
   mBlockGraph = oo::BlockGraph{};
+  takeStagedGeometry();
+}
+
+void NifResource::stageGeometry(bool generateLods) {
+  const auto &g{mBlockGraph};
+  oo::StagedGeometryMap staged{};
+
+  // It is assumed that the transformation of the parent node will be applied
+  // via its Ogre::Node transformation, as in oo::createMesh().
+  const Ogre::Matrix4 transform{Ogre::Matrix4::IDENTITY};
+
+  for (auto v : boost::make_iterator_range(boost::vertices(g))) {
+    const auto &block{*g[v]};
+    if (!dynamic_cast<const nif::NiTriBasedGeom *>(&block)) continue;
+
+    const auto &geom{static_cast<const nif::NiTriBasedGeom &>(block)};
+    // Malformed geometry is skipped so that the error is reported by
+    // oo::createMesh() in the same way as if it had not been staged.
+    try {
+      staged.emplace(v, oo::stageNiTriBasedGeom(g, geom, transform,
+                                                   generateLods));
+    } catch (const std::exception &e) {
+      oo::nifloaderLogger()->warn("Could not stage geometry of block {} of "
+                                  "{}: {}", v, getName(), e.what());
+    }
+  }
+
+  std::scoped_lock lock{mStagedGeometryMutex};
+  mStagedGeometry = std::move(staged);
+}
+
+void NifResource::createCollisionShapes() {
+  const auto &g{mBlockGraph};
+  auto &colObjMgr{CollisionShapeManager::getSingleton()};
+
+  for (auto v : boost::make_iterator_range(boost::vertices(g))) {
+    const auto &block{*g[v]};
+    if (!dynamic_cast<const nif::bhk::CollisionObject *>(&block)) continue;
+    if (boost::in_degree(v, g) == 0) continue;
+    const auto u{boost::in_edges(v, g).first->m_source};
+
+    // Must match the name used by oo::insertNif().
+    const std::string name{mName + '/' + std::to_string(v) + "/CollisionShape"};
+    auto[ptr, created]{colObjMgr.createOrRetrieve(name, mGroup, true, nullptr)};
+    if (!created) continue;
+
+    auto collisionShapePtr{std::static_pointer_cast<CollisionShape>(ptr)};
+    try {
+      oo::createCollisionObject(collisionShapePtr.get(), u, g);
+    } catch (const std::exception &e) {
+      // Leave it to oo::insertNif() to try again and report the error.
+      colObjMgr.remove(ptr);
+      oo::nifloaderLogger()->warn("Could not create collision shape {}: {}",
+                                  name, e.what());
+    }
+  }
 }
 
 } // namespace Ogre
@@ -22,6 +22,13 @@ namespace oo {
 
 namespace {
 
+/// Return the name of the `oo::Mesh` made from the children of the
+/// `nif::NiNode` `u` in the given NIF file.
+std::string getMeshName(const std::string &nifName,
+                        oo::BlockGraph::vertex_descriptor u) {
+  return nifName + '/' + std::to_string(u) + "/Mesh";
+}
+
 struct NifVisitorState {
   std::string mName;
   std::string mGroup;
@@ -30,6 +37,9 @@ struct NifVisitorState {
   /// Keep track of the NiNode blocks which have had their child geometry nodes
   /// processed.
   std::set<oo::BlockGraph::vertex_descriptor> mVisitedGeometry{};
+  /// Geometry staged when the NIF file was prepared, if it has not already
+  /// been used.
+  oo::StagedGeometryMap mStagedGeometry{};
 
   gsl::not_null<Ogre::SceneManager *> mScnMgr;
   gsl::not_null<btDiscreteDynamicsWorld *> mWorld;
@@ -270,11 +280,11 @@ void NifVisitor::discover_vertex(const nif::NiTriBasedGeom &,
   if (mState->mVisitedGeometry.count(u) > 0) return;
 
   auto &meshMgr{oo::MeshManager::getSingleton()};
-  const std::string name{mState->mName + '/' + std::to_string(u) + "/Mesh"};
+  const std::string name{oo::getMeshName(mState->mName, u)};
   const std::string &group{mState->mGroup};
   auto[ptr, created]{meshMgr.createOrRetrieve(name, group, true, nullptr)};
   auto meshPtr{std::static_pointer_cast<oo::Mesh>(ptr)};
-  if (created) oo::createMesh(meshPtr.get(), u, g);
+  if (created) oo::createMesh(meshPtr.get(), u, g, &mState->mStagedGeometry);
   // Record that this node and its siblings have been visited.
   mState->mVisitedGeometry.emplace(u);
 
@@ -388,6 +398,7 @@ Ogre::SceneNode *insertNif(const std::string &name, const std::string &group,
   const auto propertyMap{boost::make_iterator_property_map(
       colorMap.begin(), boost::get(boost::vertex_index, graph))};
   NifVisitorState state(name, group, scnMgr, world, nifRoot);
+  state.mStagedGeometry = nifPtr->takeStagedGeometry();
   boost::depth_first_search(graph, NifVisitor(&state), propertyMap);
 
   return state.mCurrentNode;
@@ -408,6 +419,43 @@ void attachRagdoll(const std::string &name, const std::string &group,
   boost::depth_first_search(graph, RagdollVisitor(&state), propertyMap);
 }
 
+void uploadNif(const std::string &name, const std::string &group,
+               const oo::BlockGraph &g) {
+  auto nifPtr{Ogre::NifResourceManager::getSingleton().getByName(name, group)};
+  if (!nifPtr) return;
+
+  // If there is no staged geometry then either the NIF file has not been
+  // prepared, or its meshes have already been created.
+  auto staged{nifPtr->takeStagedGeometry()};
+  if (staged.empty()) return;
+
+  // Create the same meshes as oo::insertNif() would, namely one for each
+  // parent of a geometry block.
+  auto &meshMgr{oo::MeshManager::getSingleton()};
+  std::set<oo::BlockGraph::vertex_descriptor> visited{};
+  for (const auto &entry : staged) {
+    const auto v{entry.first};
+    if (boost::in_degree(v, g) == 0) continue;
+    const auto u{boost::in_edges(v, g).first->m_source};
+    if (!visited.emplace(u).second) continue;
+
+    const std::string meshName{oo::getMeshName(name, u)};
+    auto[ptr, created]{meshMgr.createOrRetrieve(meshName, group, true,
+                                                nullptr)};
+    if (!created) continue;
+
+    auto meshPtr{std::static_pointer_cast<oo::Mesh>(ptr)};
+    try {
+      oo::createMesh(meshPtr.get(), u, g, &staged);
+    } catch (const std::exception &e) {
+      // Leave it to oo::insertNif() to try again and report the error.
+      meshMgr.remove(ptr);
+      oo::nifloaderLogger()->warn("Could not create mesh {}: {}",
+                                  meshName, e.what());
+    }
+  }
+}
+
 Ogre::SceneNode *insertRawNif(const std::string &name, const std::string &group,
                               const Ogre::MaterialPtr &matPtr,
                               gsl::not_null<Ogre::SceneManager *> scnMgr,
@@ -426,7 +474,10 @@ Ogre::SceneNode *insertRawNif(const std::string &name, const std::string &group,
   const std::string meshName{name + "/0/Mesh"};
   auto[ptr, created]{meshMgr.createOrRetrieve(meshName, group, true, nullptr)};
   auto meshPtr{std::static_pointer_cast<oo::Mesh>(std::move(ptr))};
-  if (created) oo::createRawMesh(meshPtr.get(), matPtr, 0, graph);
+  if (created) {
+    auto staged{nifPtr->takeStagedGeometry()};
+    oo::createRawMesh(meshPtr.get(), matPtr, 0, graph, &staged);
+  }
 
   Ogre::NameValuePairList params{
       {"mesh", meshPtr->getName()},
@@ -5,6 +5,17 @@
 #include <OgreException.h>
 #include <OgreSkeleton.h>
 
+void oo::SkeletonLoader::prepareResource(Ogre::Resource *resource) {
+  auto nifPtr{Ogre::NifResourceManager::getSingleton()
+                  .getByName(resource->getName(), resource->getGroup())};
+  if (!nifPtr) {
+    OGRE_EXCEPT(Ogre::Exception::ERR_ITEM_NOT_FOUND,
+                "Could not load nif resource backing this skeleton",
+                "SkeletonLoader::prepareResource()");
+  }
+  nifPtr->prepare();
+}
+
 void oo::SkeletonLoader::loadResource(Ogre::Resource *resource) {
   auto skeleton = dynamic_cast<Ogre::Skeleton *>(resource);
   // TODO: Handle this properly
@@ -1,6 +1,7 @@
 #include "math/conversions.hpp"
 #include "ogre/deferred_light_pass.hpp"
 #include "ogre/scene_manager.hpp"
+#include "ogre/sun_shadows.hpp"
 #include "util/settings.hpp"
 
 #include <OgreCamera.h>
@@ -10,9 +11,45 @@
 #include <OgreSceneManager.h>
 #include <OgreSceneNode.h>
 #include <OgreTechnique.h>
+#include <cstdint>
+#include <string>
 
 namespace oo {
 
+namespace {
+
+/// Fill `op` with a quad covering the whole screen, for lights that affect
+/// every pixel.
+void createFullscreenQuad(Ogre::RenderOperation &op) {
+  op.vertexData = OGRE_NEW Ogre::VertexData();
+  op.vertexData->vertexCount = 4u;
+  op.vertexData->vertexStart = 0u;
+  op.indexData = nullptr;
+
+  auto *vertDecl{op.vertexData->vertexDeclaration};
+  auto *vertBind{op.vertexData->vertexBufferBinding};
+
+  vertDecl->addElement(0, 0, Ogre::VET_FLOAT2, Ogre::VES_POSITION);
+
+  auto &hwBufMgr{Ogre::HardwareBufferManager::getSingleton()};
+  auto bufPtr{hwBufMgr.createVertexBuffer(
+      vertDecl->getVertexSize(0), 4u,
+      Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY)};
+  vertBind->setBinding(0, bufPtr);
+  std::array<float, 4u * 2u> vertices{
+      -1, -1,
+      1, -1,
+      -1, 1,
+      1, 1,
+  };
+  bufPtr->writeData(0, vertices.size() * sizeof(float), vertices.data(), true);
+
+  op.operationType = Ogre::RenderOperation::OT_TRIANGLE_STRIP;
+  op.useIndexes = false;
+}
+
+} // namespace
+
 DeferredLightRenderable::DeferredLightRenderable(Ogre::Light *parent)
     : mParent(parent),
       mLightType(parent->getType()),
@@ -276,30 +313,7 @@ void DeferredLightRenderable::createPointLight() {
 }
 
 void DeferredLightRenderable::createDirectionalLight() {
-  mRenderOp.vertexData = OGRE_NEW Ogre::VertexData();
-  mRenderOp.vertexData->vertexCount = 4u;
-  mRenderOp.vertexData->vertexStart = 0u;
-  mRenderOp.indexData = nullptr;
-
-  auto *vertDecl{mRenderOp.vertexData->vertexDeclaration};
-  auto *vertBind{mRenderOp.vertexData->vertexBufferBinding};
-
-  vertDecl->addElement(0, 0, Ogre::VET_FLOAT2, Ogre::VES_POSITION);
-
-  auto &hwBufMgr{Ogre::HardwareBufferManager::getSingleton()};
-  auto bufPtr{hwBufMgr.createVertexBuffer(vertDecl->getVertexSize(0), 4u,
-                                          Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY)};
-  vertBind->setBinding(0, bufPtr);
-  std::array<float, 4u * 2u> vertices{
-      -1, -1,
-      1, -1,
-      -1, 1,
-      1, 1,
-  };
-  bufPtr->writeData(0, vertices.size() * sizeof(float), vertices.data(), true);
-
-  mRenderOp.operationType = Ogre::RenderOperation::OT_TRIANGLE_STRIP;
-  mRenderOp.useIndexes = false;
+  oo::createFullscreenQuad(mRenderOp);
 }
 
 void DeferredLightRenderable::setPointLightMaterial() {
@@ -349,30 +363,7 @@ void DeferredLightRenderable::setDirectionalLightMaterial() {
 
 AmbientLight::AmbientLight() {
   setRenderQueueGroup(Ogre::RENDER_QUEUE_2);
-  mRenderOp.vertexData = OGRE_NEW Ogre::VertexData();
-  mRenderOp.vertexData->vertexCount = 4u;
-  mRenderOp.vertexData->vertexStart = 0u;
-  mRenderOp.indexData = nullptr;
-
-  auto *vertDecl{mRenderOp.vertexData->vertexDeclaration};
-  auto *vertBind{mRenderOp.vertexData->vertexBufferBinding};
-
-  vertDecl->addElement(0, 0, Ogre::VET_FLOAT2, Ogre::VES_POSITION);
-
-  auto &hwBufMgr{Ogre::HardwareBufferManager::getSingleton()};
-  auto bufPtr{hwBufMgr.createVertexBuffer(vertDecl->getVertexSize(0), 4u,
-                                          Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY)};
-  vertBind->setBinding(0, bufPtr);
-  std::array<float, 4u * 2u> vertices{
-      -1, -1,
-      1, -1,
-      -1, 1,
-      1, 1,
-  };
-  bufPtr->writeData(0, vertices.size() * sizeof(float), vertices.data(), true);
-
-  mRenderOp.operationType = Ogre::RenderOperation::OT_TRIANGLE_STRIP;
-  mRenderOp.useIndexes = false;
+  oo::createFullscreenQuad(mRenderOp);
 
   setBoundingBox(Ogre::AxisAlignedBox(-5000.0f, -5000.0f, -5000.0f,
                                       5000.0f, 5000.0f, 5000.0f));
@@ -400,6 +391,56 @@ void AmbientLight::getWorldTransforms(Ogre::Matrix4 *xform) const {
   *xform = Ogre::Matrix4::IDENTITY;
 }
 
+ClusteredLights::ClusteredLights(const std::string &name)
+    : mGrid(std::make_unique<oo::LightClusterGrid>(name)) {
+  oo::createFullscreenQuad(mRenderOp);
+
+  setBoundingBox(Ogre::AxisAlignedBox(-5000.0f, -5000.0f, -5000.0f,
+                                      5000.0f, 5000.0f, 5000.0f));
+  mRadius = 8000.0f;
+
+  // Each grid has its own textures, so needs its own material to bind them to.
+  auto &matMgr{Ogre::MaterialManager::getSingleton()};
+  auto baseMat{matMgr.getByName("DeferredClusteredLights")};
+  mMaterial = baseMat->clone(name + "/Material");
+  mMaterial->load();
+
+  auto *pass{mMaterial->getTechnique(0)->getPass(0)};
+  mGrid->bindTextures(pass, 3u);
+}
+
+ClusteredLights::~ClusteredLights() {
+  OGRE_DELETE mRenderOp.vertexData;
+  OGRE_DELETE mRenderOp.indexData;
+
+  if (auto *matMgr{Ogre::MaterialManager::getSingletonPtr()}) {
+    matMgr->remove(mMaterial);
+  }
+}
+
+Ogre::Real ClusteredLights::getBoundingRadius() const {
+  return mRadius;
+}
+
+Ogre::Real ClusteredLights::getSquaredViewDepth(const Ogre::Camera *) const {
+  return 0.0f;
+}
+
+void ClusteredLights::getWorldTransforms(Ogre::Matrix4 *xform) const {
+  *xform = Ogre::Matrix4::IDENTITY;
+}
+
+void ClusteredLights::update(const Ogre::Camera &camera,
+                             const Ogre::LightList &lights) {
+  mGrid->build(camera, lights);
+  mGrid->upload();
+  mGrid->setParameters(mMaterial->getTechnique(0)->getPass(0));
+}
+
+const oo::LightClusterGrid &ClusteredLights::getGrid() const noexcept {
+  return *mGrid;
+}
+
 DeferredLightRenderOperation::DeferredLightRenderOperation(Ogre::CompositorInstance *instance,
                                                            const Ogre::CompositionPass *pass)
     : mViewport(instance->getChain()->getViewport()),
@@ -419,6 +460,30 @@ void DeferredLightRenderOperation::executeAmbientLight(Ogre::SceneManager *scnMg
   }
 }
 
+std::size_t DeferredLightRenderOperation::executeClusteredLights(
+    Ogre::SceneManager *scnMgr,
+    const Ogre::Camera &camera,
+    const Ogre::LightList &lights) {
+  if (!mClusteredLights) {
+    const auto id{reinterpret_cast<std::uintptr_t>(this)};
+    mClusteredLights = std::make_unique<oo::ClusteredLights>(
+        "__ClusteredLights/" + std::to_string(id));
+  }
+
+  mClusteredLights->update(camera, lights);
+  const auto &grid{mClusteredLights->getGrid()};
+  if (grid.getNumLights() == 0u) return grid.getNumProcessedLights();
+
+  auto *technique{mClusteredLights->getMaterial()->getBestTechnique()};
+  if (!technique) return 0u;
+
+  for (auto *pass : technique->getPasses()) {
+    scnMgr->_injectRenderWithPass(pass, mClusteredLights.get(), false);
+  }
+
+  return grid.getNumProcessedLights();
+}
+
 void DeferredLightRenderOperation::execute(Ogre::SceneManager *scnMgr,
                                            Ogre::RenderSystem *) {
   executeAmbientLight(scnMgr);
@@ -429,19 +494,36 @@ void DeferredLightRenderOperation::execute(Ogre::SceneManager *scnMgr,
   Ogre::Camera *camera{mViewport->getCamera()};
   const Ogre::LightList &lights{dScnMgr->_getLightsAffectingFrustum()};
 
+  // Point lights are all drawn at once by the clustered pass, leaving only the
+  // directional lights, and any point lights that did not fit in the cluster
+  // grid, to be drawn individually.
+  const std::size_t numClusteredLights{
+      dScnMgr->getClusteredLightingEnabled()
+      ? executeClusteredLights(scnMgr, *camera, lights) : 0u};
+
   std::size_t lightCount{0u};
-  for (Ogre::Light *baseLight : lights) {
-    auto *light{dynamic_cast<oo::DeferredLight *>(baseLight)};
+  for (std::size_t i = 0; i < lights.size(); ++i) {
+    auto *light{dynamic_cast<oo::DeferredLight *>(lights[i])};
     if (!light) continue;
     auto *dLight{light->getRenderable()};
 
     if (light->getType() == Ogre::Light::LightTypes::LT_SPOTLIGHT) continue;
+    if (i < numClusteredLights
+        && light->getType() == Ogre::Light::LightTypes::LT_POINT) {
+      continue;
+    }
 
     // rebuildLightGeometry() may update material params so must do that before
     // getting the technique.
     dLight->rebuildLightGeometry();
 
-    auto *technique{dLight->getMaterial()->getBestTechnique()};
+    // The sun's shadows are drawn by a different material that reads the
+    // shadow maps.
+    const auto *shadows{oo::SunShadows::getSingletonPtr()};
+    const auto &material{shadows && shadows->getShadowedLight() == light
+                         ? shadows->getLightMaterial()
+                         : dLight->getMaterial()};
+    auto *technique{material->getBestTechnique()};
     if (!technique) continue;
 
     for (auto *pass : technique->getPasses()) {
@@ -0,0 +1,254 @@
+#include "ogre/light_clusters.hpp"
+#include "util/settings.hpp"
+#include <OgreCamera.h>
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreLight.h>
+#include <OgrePass.h>
+#include <OgreTextureManager.h>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+namespace oo {
+
+namespace {
+
+/// Return the range of tiles covered by the interval `[lo, hi]` of normalized
+/// device coordinates along an axis divided into `numTiles` tiles.
+std::pair<std::size_t, std::size_t>
+getTileRange(float lo, float hi, std::size_t numTiles) noexcept {
+  const auto n{static_cast<float>(numTiles)};
+  const auto toTile = [&](float ndc) {
+    const float t{std::floor((ndc * 0.5f + 0.5f) * n)};
+    return static_cast<std::size_t>(std::clamp(t, 0.0f, n - 1.0f));
+  };
+  return {toTile(lo), toTile(hi)};
+}
+
+} // namespace
+
+LightClusterGrid::LightClusterGrid(const std::string &name)
+    : mLightData(4u * MAX_LIGHTS * 3u),
+      mClusterData(2u * NUM_CLUSTERS),
+      mLightIndices(MAX_LIGHT_INDICES),
+      mClusterCounts(NUM_CLUSTERS) {
+  mLightRanges.reserve(MAX_LIGHTS);
+
+  auto &texMgr{Ogre::TextureManager::getSingleton()};
+  const auto usage{Ogre::TU_DYNAMIC_WRITE_ONLY_DISCARDABLE};
+
+  mLightTexture = texMgr.createManual(
+      name + "/Lights", oo::RESOURCE_GROUP, Ogre::TEX_TYPE_2D,
+      MAX_LIGHTS, 3u, 1u, 0, Ogre::PF_FLOAT32_RGBA, usage);
+  mClusterTexture = texMgr.createManual(
+      name + "/Clusters", oo::RESOURCE_GROUP, Ogre::TEX_TYPE_2D,
+      NUM_TILES_X * NUM_TILES_Y, NUM_SLICES, 1u, 0, Ogre::PF_FLOAT32_GR, usage);
+  mIndexTexture = texMgr.createManual(
+      name + "/Indices", oo::RESOURCE_GROUP, Ogre::TEX_TYPE_2D,
+      INDEX_TEXTURE_WIDTH, MAX_LIGHT_INDICES / INDEX_TEXTURE_WIDTH, 1u, 0,
+      Ogre::PF_FLOAT32_R, usage);
+}
+
+LightClusterGrid::~LightClusterGrid() {
+  // See ImGuiManager::removeFontTexture().
+  auto *texMgr{Ogre::TextureManager::getSingletonPtr()};
+  if (!texMgr) return;
+  texMgr->remove(mLightTexture);
+  texMgr->remove(mClusterTexture);
+  texMgr->remove(mIndexTexture);
+}
+
+std::size_t LightClusterGrid::getSlice(float depth) const noexcept {
+  const float z{std::floor(std::log(depth) * mSliceScale + mSliceBias)};
+  const auto maxSlice{static_cast<float>(NUM_SLICES - 1u)};
+  return static_cast<std::size_t>(std::clamp(z, 0.0f, maxSlice));
+}
+
+void LightClusterGrid::build(const Ogre::Camera &camera,
+                             const Ogre::LightList &lights) {
+  const Ogre::Affine3 &view{camera.getViewMatrix()};
+  for (std::size_t r = 0; r < 3u; ++r) {
+    for (std::size_t c = 0; c < 4u; ++c) mViewMatrix[r][c] = view[r][c];
+  }
+
+  const Ogre::Matrix4 &proj{camera.getProjectionMatrix()};
+  mProjParams = {proj[0][0], proj[1][1], proj[0][2], proj[1][2]};
+
+  const float nearDist{camera.getNearClipDistance()};
+  float farDist{camera.getFarClipDistance()};
+  if (farDist <= nearDist || farDist > MAX_SLICE_DEPTH) {
+    farDist = std::max(MAX_SLICE_DEPTH, 2.0f * nearDist);
+  }
+  mSliceScale = static_cast<float>(NUM_SLICES) / std::log(farDist / nearDist);
+  mSliceBias = -std::log(nearDist) * mSliceScale;
+
+  // Find the clusters intersected by each light, using the view space AABB of
+  // the light's bounding sphere to bound its projection.
+  mLightRanges.clear();
+  mNumProcessedLights = 0u;
+  for (Ogre::Light *light : lights) {
+    if (mLightRanges.size() == MAX_LIGHTS) break;
+    ++mNumProcessedLights;
+    if (light->getType() != Ogre::Light::LightTypes::LT_POINT) continue;
+
+    const Ogre::Vector3 &worldPos{light->getDerivedPosition()};
+    const float r{light->getAttenuationRange()};
+    const Ogre::Vector3 p{view * worldPos};
+    const float depth{-p.z};
+    if (depth + r < nearDist) continue;
+
+    ClusterRange range{0u, NUM_TILES_X - 1u, 0u, NUM_TILES_Y - 1u,
+                       getSlice(std::max(depth - r, nearDist)),
+                       getSlice(depth + r)};
+
+    // If the sphere crosses the near plane its projection is unbounded, so
+    // conservatively assume that it covers the whole screen.
+    if (depth - r >= nearDist) {
+      float xMin{1.0f}, xMax{-1.0f}, yMin{1.0f}, yMax{-1.0f};
+      for (float dx : {-r, r}) {
+        for (float dy : {-r, r}) {
+          for (float dz : {-r, r}) {
+            const float w{depth - dz};
+            const float z{p.z + dz};
+            const float x{(mProjParams.x * (p.x + dx) + mProjParams.z * z) / w};
+            const float y{(mProjParams.y * (p.y + dy) + mProjParams.w * z) / w};
+            xMin = std::min(xMin, x);
+            xMax = std::max(xMax, x);
+            yMin = std::min(yMin, y);
+            yMax = std::max(yMax, y);
+          }
+        }
+      }
+      if (xMax < -1.0f || xMin > 1.0f || yMax < -1.0f || yMin > 1.0f) {
+        continue;
+      }
+      std::tie(range.x0, range.x1) = oo::getTileRange(xMin, xMax, NUM_TILES_X);
+      std::tie(range.y0, range.y1) = oo::getTileRange(yMin, yMax, NUM_TILES_Y);
+    }
+
+    const std::size_t i{mLightRanges.size()};
+    mLightRanges.push_back(range);
+
+    const Ogre::ColourValue col{light->getDiffuseColour()};
+    float *texel{&mLightData[4u * i]};
+    texel[0] = worldPos.x;
+    texel[1] = worldPos.y;
+    texel[2] = worldPos.z;
+    texel[3] = r;
+    texel = &mLightData[4u * (MAX_LIGHTS + i)];
+    texel[0] = col.r;
+    texel[1] = col.g;
+    texel[2] = col.b;
+    texel[3] = 1.0f;
+    texel = &mLightData[4u * (2u * MAX_LIGHTS + i)];
+    texel[0] = light->getAttenuationConstant();
+    texel[1] = light->getAttenuationLinear();
+    texel[2] = light->getAttenuationQuadric();
+    texel[3] = 0.0f;
+  }
+
+  const auto forEachCluster = [](const ClusterRange &range, auto &&f) {
+    for (std::size_t z = range.z0; z <= range.z1; ++z) {
+      for (std::size_t y = range.y0; y <= range.y1; ++y) {
+        const std::size_t row{(z * NUM_TILES_Y + y) * NUM_TILES_X};
+        for (std::size_t x = range.x0; x <= range.x1; ++x) f(row + x);
+      }
+    }
+  };
+
+  // Count the lights in each cluster, then use the counts to reserve space
+  // for each cluster's indices, then write the indices.
+  std::fill(mClusterCounts.begin(), mClusterCounts.end(), 0u);
+  for (const auto &range : mLightRanges) {
+    forEachCluster(range, [&](std::size_t c) { ++mClusterCounts[c]; });
+  }
+
+  std::size_t offset{0u};
+  for (std::size_t c = 0; c < NUM_CLUSTERS; ++c) {
+    const std::size_t count{std::min<std::size_t>(mClusterCounts[c],
+                                                  MAX_LIGHT_INDICES - offset)};
+    mClusterData[2u * c] = static_cast<float>(offset);
+    mClusterData[2u * c + 1u] = static_cast<float>(count);
+    // From now on, this is the position of the next index in the cluster.
+    mClusterCounts[c] = static_cast<uint32_t>(offset);
+    offset += count;
+  }
+  mNumLightIndices = offset;
+
+  for (std::size_t i = 0; i < mLightRanges.size(); ++i) {
+    forEachCluster(mLightRanges[i], [&](std::size_t c) {
+      const auto end{static_cast<uint32_t>(mClusterData[2u * c]
+                                               + mClusterData[2u * c + 1u])};
+      if (mClusterCounts[c] < end) {
+        mLightIndices[mClusterCounts[c]++] = static_cast<float>(i);
+      }
+    });
+  }
+}
+
+void LightClusterGrid::upload() {
+  const auto numLights{static_cast<uint32_t>(mLightRanges.size())};
+  if (numLights > 0u) {
+    // Each row of the light texture is only partially used, so upload the
+    // used part of each row separately.
+    for (uint32_t row = 0; row < 3u; ++row) {
+      float *data{&mLightData[4u * MAX_LIGHTS * row]};
+      const Ogre::PixelBox src(numLights, 1u, 1u, Ogre::PF_FLOAT32_RGBA, data);
+      mLightTexture->getBuffer()->blitFromMemory(
+          src, Ogre::Box(0u, row, numLights, row + 1u));
+    }
+  }
+
+  {
+    const auto width{static_cast<uint32_t>(NUM_TILES_X * NUM_TILES_Y)};
+    const auto height{static_cast<uint32_t>(NUM_SLICES)};
+    const Ogre::PixelBox src(width, height, 1u, Ogre::PF_FLOAT32_GR,
+                             mClusterData.data());
+    mClusterTexture->getBuffer()->blitFromMemory(src);
+  }
+
+  if (mNumLightIndices > 0u) {
+    const auto width{static_cast<uint32_t>(INDEX_TEXTURE_WIDTH)};
+    const auto height{static_cast<uint32_t>(
+                          (mNumLightIndices + width - 1u) / width)};
+    const Ogre::PixelBox src(width, height, 1u, Ogre::PF_FLOAT32_R,
+                             mLightIndices.data());
+    mIndexTexture->getBuffer()->blitFromMemory(
+        src, Ogre::Box(0u, 0u, width, height));
+  }
+}
+
+void LightClusterGrid::bindTextures(Ogre::Pass *pass,
+                                    unsigned short firstUnit) const {
+  pass->getTextureUnitState(firstUnit)->setTexture(mLightTexture);
+  pass->getTextureUnitState(firstUnit + 1u)->setTexture(mClusterTexture);
+  pass->getTextureUnitState(firstUnit + 2u)->setTexture(mIndexTexture);
+}
+
+void LightClusterGrid::setParameters(Ogre::Pass *pass) const {
+  const auto &params{pass->getFragmentProgramParameters()};
+  params->setNamedConstant("clusterView", mViewMatrix);
+  params->setNamedConstant("clusterProj", mProjParams);
+  params->setNamedConstant("clusterDims", Ogre::Vector4{
+      static_cast<float>(NUM_TILES_X),
+      static_cast<float>(NUM_TILES_Y),
+      static_cast<float>(NUM_SLICES),
+      static_cast<float>(INDEX_TEXTURE_WIDTH)});
+  params->setNamedConstant("clusterSlice", Ogre::Vector4{
+      mSliceScale, mSliceBias, 0.0f, 0.0f});
+}
+
+std::size_t LightClusterGrid::getNumLights() const noexcept {
+  return mLightRanges.size();
+}
+
+std::size_t LightClusterGrid::getNumProcessedLights() const noexcept {
+  return mNumProcessedLights;
+}
+
+std::size_t LightClusterGrid::getNumLightIndices() const noexcept {
+  return mNumLightIndices;
+}
+
+} // namespace oo
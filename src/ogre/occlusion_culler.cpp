@@ -0,0 +1,320 @@
+#include "job/job.hpp"
+#include "ogre/occlusion_culler.hpp"
+#include <OgreCamera.h>
+#include <OgreRoot.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+template<> oo::OcclusionCuller *
+    Ogre::Singleton<oo::OcclusionCuller>::msSingleton = nullptr;
+
+namespace oo {
+
+namespace {
+
+constexpr float INFINITE_DEPTH{std::numeric_limits<float>::infinity()};
+
+Ogre::Matrix4 toMatrix4(const Ogre::Affine3 &xform) {
+  Ogre::Matrix4 m{Ogre::Matrix4::IDENTITY};
+  for (std::size_t r = 0; r < 3u; ++r) {
+    for (std::size_t c = 0; c < 4u; ++c) m[r][c] = xform[r][c];
+  }
+  return m;
+}
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height,
+                                 std::size_t maxOccluders)
+    : mWidth(std::max(width, 1u)), mHeight(std::max(height, 1u)),
+      mMaxOccluders(maxOccluders) {
+  uint32_t w{mWidth}, h{mHeight};
+  while (true) {
+    mLevelSizes.emplace_back(w, h);
+    mLevels.emplace_back(std::size_t{w} * h, INFINITE_DEPTH);
+    if (w == 1u && h == 1u) break;
+    w = (w + 1u) / 2u;
+    h = (h + 1u) / 2u;
+  }
+}
+
+OcclusionCuller &OcclusionCuller::getSingleton() {
+  assert(msSingleton);
+  return *msSingleton;
+}
+
+OcclusionCuller *OcclusionCuller::getSingletonPtr() {
+  return msSingleton;
+}
+
+void OcclusionCuller::update(const Ogre::Camera &camera) {
+  const auto frameNumber{Ogre::Root::getSingleton().getNextFrameNumber()};
+  if (&camera == mCamera && frameNumber == mFrameNumber) return;
+
+  using Clock = std::chrono::steady_clock;
+  using fMillisecond = std::chrono::duration<float, std::milli>;
+  const auto startTime{Clock::now()};
+
+  if (&camera != mCamera) mOccluders.clear();
+  mCamera = &camera;
+  mFrameNumber = frameNumber;
+
+  Ogre::Matrix4 view{toMatrix4(camera.getViewMatrix())};
+  mViewProj = camera.getProjectionMatrix() * view;
+  mNearDist = camera.getNearClipDistance();
+
+  // Keep the occluders covering the most of the screen.
+  if (mOccluders.size() > mMaxOccluders) {
+    std::nth_element(mOccluders.begin(), mOccluders.begin() + mMaxOccluders,
+                     mOccluders.end(), [](const auto &a, const auto &b) {
+          return a.screenSize > b.screenSize;
+        });
+    mOccluders.resize(mMaxOccluders);
+  }
+
+  const std::size_t numChunks{(mOccluders.size() + OCCLUDERS_PER_CHUNK - 1u)
+                                  / OCCLUDERS_PER_CHUNK};
+  std::vector<std::vector<ScreenTriangle>> triangles(numChunks);
+  oo::parallelFor(numChunks, [&](std::size_t c) {
+    const std::size_t end{std::min(mOccluders.size(),
+                                   (c + 1u) * OCCLUDERS_PER_CHUNK)};
+    for (std::size_t i = c * OCCLUDERS_PER_CHUNK; i < end; ++i) {
+      transformOccluder(mOccluders[i], triangles[c]);
+    }
+  });
+
+  std::size_t numTriangles{0u};
+  for (const auto &chunk : triangles) numTriangles += chunk.size();
+
+  std::fill(mLevels.front().begin(), mLevels.front().end(), INFINITE_DEPTH);
+  if (numTriangles > 0u) {
+    const std::size_t numBands{(mHeight + ROWS_PER_BAND - 1u) / ROWS_PER_BAND};
+    oo::parallelFor(numBands, [&](std::size_t b) {
+      const auto y0{static_cast<int>(b * ROWS_PER_BAND)};
+      const auto y1{static_cast<int>(std::min<std::size_t>(
+          (b + 1u) * ROWS_PER_BAND, mHeight))};
+      rasterizeBand(triangles, y0, y1);
+    });
+  }
+  buildMipChain();
+  mIsEmpty = numTriangles == 0u;
+
+  mStats.numOccluders = mOccluders.size();
+  mStats.numTriangles = numTriangles;
+  mStats.numTested = 0u;
+  mStats.numOccluded = 0u;
+  mStats.updateTime = fMillisecond(Clock::now() - startTime).count();
+
+  mOccluders.clear();
+}
+
+bool OcclusionCuller::addOccluder(const Ogre::Camera &camera,
+                                  std::shared_ptr<const TriangleList> triangles,
+                                  const Ogre::Affine3 &xform,
+                                  float screenSize) {
+  if (&camera != mCamera || !triangles || triangles->empty()) return false;
+  mOccluders.push_back(Occluder{std::move(triangles), xform, screenSize});
+  return true;
+}
+
+void
+OcclusionCuller::transformOccluder(const Occluder &occluder,
+                                   std::vector<ScreenTriangle> &out) const {
+  const Ogre::Matrix4 mvp{mViewProj * toMatrix4(occluder.xform)};
+  const auto w{static_cast<float>(mWidth)};
+  const auto h{static_cast<float>(mHeight)};
+
+  // Screen position of a clip space vertex in front of the near plane.
+  const auto toScreen = [&](const Ogre::Vector4 &p) {
+    const float invW{1.0f / p.w};
+    return Ogre::Vector3{(p.x * invW * 0.5f + 0.5f) * w,
+                         (0.5f - p.y * invW * 0.5f) * h,
+                         invW};
+  };
+
+  const auto &tris{*occluder.triangles};
+  for (std::size_t i = 0; i + 2u < tris.size(); i += 3u) {
+    const std::array<Ogre::Vector4, 3> clip{
+        mvp * Ogre::Vector4{tris[i].x, tris[i].y, tris[i].z, 1.0f},
+        mvp * Ogre::Vector4{tris[i + 1u].x, tris[i + 1u].y, tris[i + 1u].z,
+                            1.0f},
+        mvp * Ogre::Vector4{tris[i + 2u].x, tris[i + 2u].y, tris[i + 2u].z,
+                            1.0f}};
+
+    // Skip triangles entirely outside one of the side planes of the frustum.
+    const auto outside = [&](auto &&pred) {
+      return pred(clip[0]) && pred(clip[1]) && pred(clip[2]);
+    };
+    if (outside([](const auto &p) { return p.x > p.w; })
+        || outside([](const auto &p) { return p.x < -p.w; })
+        || outside([](const auto &p) { return p.y > p.w; })
+        || outside([](const auto &p) { return p.y < -p.w; })) {
+      continue;
+    }
+
+    // Clip against the near plane, which leaves a triangle or a quad.
+    std::array<Ogre::Vector4, 4> poly{};
+    std::size_t n{0u};
+    for (std::size_t j = 0; j < 3u; ++j) {
+      const auto &p{clip[j]};
+      const auto &q{clip[(j + 1u) % 3u]};
+      const float dp{p.w - mNearDist}, dq{q.w - mNearDist};
+      if (dp >= 0.0f) poly[n++] = p;
+      if ((dp >= 0.0f) != (dq >= 0.0f)) {
+        poly[n++] = p + (q - p) * (dp / (dp - dq));
+      }
+    }
+    if (n < 3u) continue;
+
+    std::array<Ogre::Vector3, 4> screen{};
+    for (std::size_t j = 0; j < n; ++j) screen[j] = toScreen(poly[j]);
+
+    for (std::size_t j = 1; j + 1u < n; ++j) {
+      ScreenTriangle tri{{screen[0], screen[j], screen[j + 1u]}};
+      const auto[yLo, yHi] = std::minmax({tri.v[0].y, tri.v[1].y, tri.v[2].y});
+      const auto[xLo, xHi] = std::minmax({tri.v[0].x, tri.v[1].x, tri.v[2].x});
+      // Rows whose centre is inside the vertical extent of the triangle.
+      tri.yMin = std::max(0, static_cast<int>(std::ceil(yLo - 0.5f)));
+      tri.yMax = std::min(static_cast<int>(mHeight) - 1,
+                          static_cast<int>(std::floor(yHi - 0.5f)));
+      if (tri.yMin > tri.yMax || xHi < 0.5f || xLo > w - 0.5f) continue;
+      out.push_back(tri);
+    }
+  }
+}
+
+void OcclusionCuller::rasterizeBand(
+    const std::vector<std::vector<ScreenTriangle>> &triangles, int y0, int y1) {
+  auto &depth{mLevels.front()};
+  const auto width{static_cast<int>(mWidth)};
+
+  for (const auto &chunk : triangles) {
+    for (const auto &tri : chunk) {
+      if (tri.yMax < y0 || tri.yMin >= y1) continue;
+      const auto &a{tri.v[0]}, &b{tri.v[1]}, &c{tri.v[2]};
+
+      // Reciprocal depth varies linearly in screen space, so find the plane
+      // through the vertices.
+      const float area{(b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y)};
+      if (std::abs(area) < 1e-6f) continue;
+      const float dzdx{((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y))
+                           / area};
+      const float dzdy{((b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z))
+                           / area};
+
+      const int yBegin{std::max(tri.yMin, y0)};
+      const int yEnd{std::min(tri.yMax + 1, y1)};
+      for (int y = yBegin; y < yEnd; ++y) {
+        // Find where the row of pixel centres crosses the edges.
+        const float yc{static_cast<float>(y) + 0.5f};
+        float xl{std::numeric_limits<float>::max()};
+        float xr{std::numeric_limits<float>::lowest()};
+        for (std::size_t e = 0; e < 3u; ++e) {
+          const auto &p{tri.v[e]};
+          const auto &q{tri.v[(e + 1u) % 3u]};
+          const auto[yLo, yHi] = std::minmax(p.y, q.y);
+          if (p.y == q.y || yc < yLo || yc > yHi) continue;
+          const float x{p.x + (yc - p.y) * (q.x - p.x) / (q.y - p.y)};
+          xl = std::min(xl, x);
+          xr = std::max(xr, x);
+        }
+        if (xl > xr) continue;
+
+        const int xBegin{std::max(0, static_cast<int>(std::ceil(xl - 0.5f)))};
+        const int xEnd{std::min(width - 1,
+                                static_cast<int>(std::floor(xr - 0.5f)))};
+        float *row{depth.data() + static_cast<std::size_t>(y) * mWidth};
+        for (int x = xBegin; x <= xEnd; ++x) {
+          const float xc{static_cast<float>(x) + 0.5f};
+          const float invW{a.z + (xc - a.x) * dzdx + (yc - a.y) * dzdy};
+          if (invW <= 0.0f) continue;
+          row[x] = std::min(row[x], 1.0f / invW);
+        }
+      }
+    }
+  }
+}
+
+void OcclusionCuller::buildMipChain() {
+  for (std::size_t i = 1; i < mLevels.size(); ++i) {
+    const auto[srcW, srcH] = mLevelSizes[i - 1u];
+    const auto[dstW, dstH] = mLevelSizes[i];
+    const auto &src{mLevels[i - 1u]};
+    auto &dst{mLevels[i]};
+    for (uint32_t y = 0; y < dstH; ++y) {
+      const uint32_t sy0{2u * y}, sy1{std::min(2u * y + 1u, srcH - 1u)};
+      for (uint32_t x = 0; x < dstW; ++x) {
+        const uint32_t sx0{2u * x}, sx1{std::min(2u * x + 1u, srcW - 1u)};
+        dst[y * dstW + x] = std::max({src[sy0 * srcW + sx0],
+                                      src[sy0 * srcW + sx1],
+                                      src[sy1 * srcW + sx0],
+                                      src[sy1 * srcW + sx1]});
+      }
+    }
+  }
+}
+
+bool OcclusionCuller::isOccluded(const Ogre::Camera &camera,
+                                 const Ogre::AxisAlignedBox &box) {
+  if (&camera != mCamera || mIsEmpty || !box.isFinite()) return false;
+  ++mStats.numTested;
+
+  const auto w{static_cast<float>(mWidth)};
+  const auto h{static_cast<float>(mHeight)};
+  const auto &lo{box.getMinimum()}, &hi{box.getMaximum()};
+
+  float minDepth{INFINITE_DEPTH};
+  float xLo{w}, xHi{0.0f}, yLo{h}, yHi{0.0f};
+  for (unsigned int i = 0; i < 8u; ++i) {
+    const Ogre::Vector4 p{mViewProj * Ogre::Vector4{
+        (i & 1u) ? hi.x : lo.x, (i & 2u) ? hi.y : lo.y,
+        (i & 4u) ? hi.z : lo.z, 1.0f}};
+    // If the box crosses the near plane then it is in front of everything.
+    if (p.w < mNearDist) return false;
+    minDepth = std::min(minDepth, p.w);
+    const float x{(p.x / p.w * 0.5f + 0.5f) * w};
+    const float y{(0.5f - p.y / p.w * 0.5f) * h};
+    xLo = std::min(xLo, x);
+    xHi = std::max(xHi, x);
+    yLo = std::min(yLo, y);
+    yHi = std::max(yHi, y);
+  }
+  if (xHi < 0.0f || xLo >= w || yHi < 0.0f || yLo >= h) return false;
+
+  // Every pixel touched by the box, not just those whose centre it covers.
+  uint32_t x0{static_cast<uint32_t>(std::max(xLo, 0.0f))};
+  uint32_t x1{static_cast<uint32_t>(std::min(xHi, w - 1.0f))};
+  uint32_t y0{static_cast<uint32_t>(std::max(yLo, 0.0f))};
+  uint32_t y1{static_cast<uint32_t>(std::min(yHi, h - 1.0f))};
+
+  // Go up the mip chain until the rectangle covers at most two texels in
+  // each direction.
+  std::size_t level{0u};
+  while ((x1 - x0 > 1u || y1 - y0 > 1u) && level + 1u < mLevels.size()) {
+    x0 /= 2u;
+    x1 /= 2u;
+    y0 /= 2u;
+    y1 /= 2u;
+    ++level;
+  }
+
+  const auto &depth{mLevels[level]};
+  const uint32_t levelW{mLevelSizes[level].first};
+  for (uint32_t y = y0; y <= y1; ++y) {
+    for (uint32_t x = x0; x <= x1; ++x) {
+      if (depth[y * levelW + x] >= minDepth) return false;
+    }
+  }
+
+  ++mStats.numOccluded;
+  return true;
+}
+
+OcclusionCuller::Stats OcclusionCuller::getStats() const noexcept {
+  return mStats;
+}
+
+} // namespace oo
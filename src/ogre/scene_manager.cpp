@@ -1,4 +1,6 @@
+#include "ogre/occlusion_culler.hpp"
 #include "ogre/scene_manager.hpp"
+#include "ogre/sun_shadows.hpp"
 #include <OgreCamera.h>
 #include <OgreRoot.h>
 
@@ -99,10 +101,38 @@ DeferredSceneManager::findLightsAffectingFrustum(const Ogre::Camera *camera) {
   }
 }
 
+void DeferredSceneManager::_findVisibleObjects(
+    Ogre::Camera *cam, Ogre::VisibleObjectsBoundsInfo *visibleBounds,
+    bool onlyShadowCasters) {
+  // Sun shadow cameras draw the casters already found for their cascade.
+  if (auto *shadows{oo::SunShadows::getSingletonPtr()};
+      shadows && shadows->queueCasters(*cam, *getRenderQueue())) {
+    return;
+  }
+
+  // Objects hidden from the camera can still cast visible shadows, so shadow
+  // cameras are not occlusion culled.
+  if (auto *culler{oo::OcclusionCuller::getSingletonPtr()};
+      culler && !onlyShadowCasters) {
+    culler->update(*cam);
+  }
+
+  Ogre::SceneManager::_findVisibleObjects(cam, visibleBounds,
+                                          onlyShadowCasters);
+}
+
 oo::DeferredFogListener *DeferredSceneManager::getFogListener() noexcept {
   return &mFogListener;
 }
 
+void DeferredSceneManager::setClusteredLightingEnabled(bool enabled) noexcept {
+  mClusteredLightingEnabled = enabled;
+}
+
+bool DeferredSceneManager::getClusteredLightingEnabled() const noexcept {
+  return mClusteredLightingEnabled;
+}
+
 //===----------------------------------------------------------------------===//
 // Scene Manager Factories
 //===----------------------------------------------------------------------===//
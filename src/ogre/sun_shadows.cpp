@@ -0,0 +1,548 @@
+#include "job/job.hpp"
+#include "ogre/scene_manager.hpp"
+#include "ogre/sun_shadows.hpp"
+#include "util/settings.hpp"
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreMaterialManager.h>
+#include <OgrePass.h>
+#include <OgreRenderTexture.h>
+#include <OgreRoot.h>
+#include <OgreSceneNode.h>
+#include <OgreTechnique.h>
+#include <OgreTextureManager.h>
+#include <OgreViewport.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+template<> oo::SunShadows *
+    Ogre::Singleton<oo::SunShadows>::msSingleton = nullptr;
+
+namespace oo {
+
+namespace {
+
+/// Name of the vertex program used by the materials of static geometry.
+/// \see shaders.program
+constexpr const char *STATIC_VERTEX_PROGRAM{"genericMaterial_vs_glsl"};
+
+/// Name of the vertex program used to draw instanced static geometry.
+/// \see shaders.program
+constexpr const char *INSTANCED_VERTEX_PROGRAM{
+    "genericInstancedMaterial_vs_glsl"
+};
+
+/// Near clip distance of the shadow cameras.
+constexpr float SHADOW_NEAR_CLIP{0.5f};
+
+Ogre::Matrix4 toMatrix4(const Ogre::Affine3 &xform) {
+  Ogre::Matrix4 m{Ogre::Matrix4::IDENTITY};
+  for (std::size_t r = 0; r < 3u; ++r) {
+    for (std::size_t c = 0; c < 4u; ++c) m[r][c] = xform[r][c];
+  }
+  return m;
+}
+
+template<class T> void hashCombine(std::size_t &seed, const T &v) {
+  seed ^= std::hash<T>{}(v) + 0x9e3779b9u + (seed << 6u) + (seed >> 2u);
+}
+
+} // namespace
+
+SunShadows::SunShadows(uint32_t numCascades, uint32_t mapSize, float distance,
+                       float splitLambda, bool budgetMode,
+                       uint32_t maxCascadeUpdates)
+    : mNumCascades(std::clamp(numCascades, 1u, MAX_CASCADES)),
+      mMapSize(std::max(mapSize, 1u)),
+      mDistance(distance),
+      mSplitLambda(std::clamp(splitLambda, 0.0f, 1.0f)),
+      mBudgetMode(budgetMode),
+      mMaxCascadeUpdates(maxCascadeUpdates) {
+  mStats.numCascades = mNumCascades;
+}
+
+SunShadows::~SunShadows() {
+  setCamera(nullptr);
+
+  // See ImGuiManager::removeFontTexture().
+  if (auto *texMgr{Ogre::TextureManager::getSingletonPtr()}; texMgr && mAtlas) {
+    mAtlas->getBuffer()->getRenderTarget()->removeListener(this);
+    texMgr->remove(mAtlas);
+  }
+}
+
+SunShadows &SunShadows::getSingleton() {
+  assert(msSingleton);
+  return *msSingleton;
+}
+
+SunShadows *SunShadows::getSingletonPtr() {
+  return msSingleton;
+}
+
+void SunShadows::addCasterType(std::string type) {
+  mCasterTypes.push_back(std::move(type));
+}
+
+void SunShadows::setCamera(Ogre::Camera *camera) {
+  if (camera && camera == mCamera) return;
+
+  if (mCamera) mCamera->removeListener(this);
+  mCamera = nullptr;
+  mLight = nullptr;
+
+  auto *scnMgr{camera ? camera->getSceneManager() : nullptr};
+  if (!dynamic_cast<oo::DeferredSceneManager *>(scnMgr)) scnMgr = nullptr;
+
+  if (scnMgr != mScnMgr) {
+    destroyCascades();
+    if (mScnMgr) mScnMgr->removeListener(this);
+    mScnMgr = scnMgr;
+    if (mScnMgr) {
+      mScnMgr->addListener(this);
+      createResources();
+      createCascades();
+    }
+  }
+
+  if (!mScnMgr) return;
+
+  mCamera = camera;
+  mCamera->addListener(this);
+  for (uint32_t i = 0; i < mNumCascades; ++i) {
+    auto &cascade{mCascades[i]};
+    // Shadows should match what is visible, so choose the level of detail of
+    // the casters as the main camera sees them.
+    cascade.camera->setLodCamera(mCamera);
+    cascade.isValid = false;
+  }
+}
+
+void SunShadows::createResources() {
+  if (mAtlas) return;
+
+  auto &texMgr{Ogre::TextureManager::getSingleton()};
+  mAtlas = texMgr.createManual(ATLAS_NAME, oo::RESOURCE_GROUP,
+                               Ogre::TEX_TYPE_2D, mMapSize * mNumCascades,
+                               mMapSize, 0, Ogre::PF_FLOAT32_R,
+                               Ogre::TU_RENDERTARGET);
+  auto *target{mAtlas->getBuffer()->getRenderTarget()};
+  target->setAutoUpdated(true);
+  target->addListener(this);
+
+  auto &matMgr{Ogre::MaterialManager::getSingleton()};
+  auto casterMat{matMgr.getByName(CASTER_MATERIAL, oo::SHADER_GROUP)};
+  casterMat->load();
+  mCasterTechnique = casterMat->getTechnique(0);
+
+  auto instancedMat{matMgr.getByName(INSTANCED_CASTER_MATERIAL,
+                                     oo::SHADER_GROUP)};
+  instancedMat->load();
+  mInstancedCasterTechnique = instancedMat->getTechnique(0);
+
+  mLightMaterial = matMgr.getByName(LIGHT_MATERIAL, oo::SHADER_GROUP);
+  mLightMaterial->load();
+  auto *pass{mLightMaterial->getTechnique(0)->getPass(0)};
+  pass->getTextureUnitState(3)->setTexture(mAtlas);
+}
+
+void SunShadows::createCascades() {
+  auto *target{mAtlas->getBuffer()->getRenderTarget()};
+  const float width{1.0f / static_cast<float>(mNumCascades)};
+
+  for (uint32_t i = 0; i < mNumCascades; ++i) {
+    auto &cascade{mCascades[i]};
+    const auto name{std::string{ATLAS_NAME} + "/" + std::to_string(i)};
+
+    cascade.camera = mScnMgr->createCamera(name);
+    cascade.camera->setProjectionType(Ogre::PT_ORTHOGRAPHIC);
+    cascade.camera->setNearClipDistance(SHADOW_NEAR_CLIP);
+    cascade.node = mScnMgr->getRootSceneNode()->createChildSceneNode();
+    cascade.node->attachObject(cascade.camera);
+
+    cascade.viewport = target->addViewport(cascade.camera, static_cast<int>(i),
+                                           width * static_cast<float>(i), 0.0f,
+                                           width, 1.0f);
+    cascade.viewport->setBackgroundColour(Ogre::ColourValue::White);
+    cascade.viewport->setClearEveryFrame(true);
+    cascade.viewport->setOverlaysEnabled(false);
+    cascade.viewport->setSkiesEnabled(false);
+    cascade.viewport->setShadowsEnabled(false);
+    cascade.viewport->setAutoUpdated(false);
+
+    cascade.isValid = false;
+  }
+}
+
+void SunShadows::destroyCascades() {
+  if (mAtlas) mAtlas->getBuffer()->getRenderTarget()->removeAllViewports();
+
+  for (auto &cascade : mCascades) {
+    if (mScnMgr) {
+      if (cascade.node) mScnMgr->destroySceneNode(cascade.node);
+      if (cascade.camera) mScnMgr->destroyCamera(cascade.camera);
+    }
+    cascade = Cascade{};
+  }
+}
+
+void SunShadows::sceneManagerDestroyed(Ogre::SceneManager *scnMgr) {
+  if (scnMgr != mScnMgr) return;
+  if (mCamera) mCamera->removeListener(this);
+  mCamera = nullptr;
+  mLight = nullptr;
+  destroyCascades();
+  mScnMgr->removeListener(this);
+  mScnMgr = nullptr;
+}
+
+void SunShadows::cameraDestroyed(Ogre::Camera *camera) {
+  if (camera != mCamera) return;
+  mCamera = nullptr;
+  mLight = nullptr;
+  for (auto &cascade : mCascades) {
+    if (cascade.camera) cascade.camera->setLodCamera(nullptr);
+    if (cascade.viewport) cascade.viewport->setAutoUpdated(false);
+  }
+}
+
+const Ogre::Light *SunShadows::getShadowedLight() const noexcept {
+  return mLight;
+}
+
+const Ogre::MaterialPtr &SunShadows::getLightMaterial() const noexcept {
+  return mLightMaterial;
+}
+
+SunShadows::Stats SunShadows::getStats() const noexcept {
+  return mStats;
+}
+
+Ogre::Light *SunShadows::findSunLight() const {
+  const auto &lights{mScnMgr->getMovableObjectCollection(
+      DeferredLightFactory::FACTORY_TYPE_NAME)->map};
+  for (const auto &[_, obj] : lights) {
+    auto *light{static_cast<Ogre::Light *>(obj)};
+    if (light->getType() == Ogre::Light::LT_DIRECTIONAL
+        && light->isVisible() && light->isInScene()) {
+      return light;
+    }
+  }
+
+  return nullptr;
+}
+
+std::array<float, SunShadows::MAX_CASCADES + 1u>
+SunShadows::getSplits() const {
+  const float n{mCamera->getNearClipDistance()};
+  const float farClip{mCamera->getFarClipDistance()};
+  // A far clip distance of zero means that the camera has no far plane.
+  const float f{std::max(farClip > 0.0f ? std::min(mDistance, farClip)
+                                        : mDistance, n * 2.0f)};
+
+  // Practical split scheme, blending the logarithmic splits that best match
+  // the perspective aliasing with uniform splits.
+  std::array<float, MAX_CASCADES + 1u> splits{};
+  splits[0] = n;
+  for (uint32_t i = 1; i <= mNumCascades; ++i) {
+    const float t{static_cast<float>(i) / static_cast<float>(mNumCascades)};
+    const float logSplit{n * std::pow(f / n, t)};
+    const float uniformSplit{n + (f - n) * t};
+    splits[i] = mSplitLambda * logSplit + (1.0f - mSplitLambda) * uniformSplit;
+  }
+
+  return splits;
+}
+
+std::pair<Ogre::Vector3, float>
+SunShadows::getSliceSphere(float nearDepth, float farDepth) const {
+  // The corners at view depth d are at a distance d * k from the view axis,
+  // so the smallest sphere containing both sets of corners has its centre on
+  // the view axis, equidistant from the near and far corners unless that
+  // would be beyond the far plane.
+  const float tanY{std::tan(mCamera->getFOVy().valueRadians() * 0.5f)};
+  const float tanX{tanY * mCamera->getAspectRatio()};
+  const float k2{tanX * tanX + tanY * tanY};
+
+  const float z{std::min(0.5f * (nearDepth + farDepth) * (1.0f + k2),
+                         farDepth)};
+  const float dz{z - nearDepth};
+  const float radius{std::max(std::sqrt(dz * dz + nearDepth * nearDepth * k2),
+                              std::sqrt(k2) * farDepth)};
+
+  const auto centre{mCamera->getDerivedPosition()
+                        + mCamera->getDerivedDirection() * z};
+  return {centre, radius};
+}
+
+std::vector<SunShadows::Caster> SunShadows::gatherCasters() const {
+  std::vector<Caster> casters;
+  const auto visibilityMask{mScnMgr->getVisibilityMask()};
+
+  for (const auto &type : mCasterTypes) {
+    const auto &objects{mScnMgr->getMovableObjectCollection(type)->map};
+    for (const auto &[_, obj] : objects) {
+      // Objects merged into static geometry have no visibility flags and are
+      // drawn by the geometry they were merged into.
+      if (!obj->isInScene() || !obj->isVisible() || !obj->getCastShadows()
+          || (obj->getVisibilityFlags() & visibilityMask) == 0u
+          || obj->getRenderQueueGroup() != Ogre::RENDER_QUEUE_MAIN) {
+        continue;
+      }
+
+      const auto &bounds{obj->getWorldBoundingBox(true)};
+      if (!bounds.isFinite()) continue;
+      casters.push_back(Caster{obj, bounds});
+    }
+  }
+
+  return casters;
+}
+
+void SunShadows::placeCascade(uint32_t index, Fit &fit,
+                              const Ogre::Quaternion &sunRot,
+                              const Ogre::Vector3 &sunDir) {
+  auto &cascade{mCascades[index]};
+  cascade.centre = fit.centre;
+  cascade.radius = fit.radius;
+  cascade.sunDir = sunDir;
+  cascade.casterHash = fit.casterHash;
+  cascade.casters = std::move(fit.casters);
+  cascade.lastDrawn = Ogre::Root::getSingleton().getNextFrameNumber();
+  cascade.isValid = true;
+
+  // Look along the sun's direction from far enough behind the sphere to see
+  // every caster, covering the sphere exactly.
+  const float diameter{2.0f * fit.radius};
+  auto *camera{cascade.camera};
+  camera->setOrthoWindow(diameter, diameter);
+  camera->setFarClipDistance(SHADOW_NEAR_CLIP + diameter + CASTER_DISTANCE);
+  cascade.node->setOrientation(sunRot);
+  cascade.node->setPosition(fit.centre - sunDir * (SHADOW_NEAR_CLIP
+      + fit.radius + CASTER_DISTANCE));
+
+  // Render textures are drawn upside down by some render systems, which flip
+  // the projection matrix to compensate; the lighting shader must do the same.
+  Ogre::Matrix4 proj{camera->getProjectionMatrix()};
+  if (mAtlas->getBuffer()->getRenderTarget()->requiresTextureFlipping()) {
+    for (std::size_t c = 0; c < 4u; ++c) proj[1][c] = -proj[1][c];
+  }
+  cascade.viewProj = proj * toMatrix4(camera->getViewMatrix());
+}
+
+void SunShadows::setLightParameters() {
+  std::array<Ogre::Matrix4, MAX_CASCADES> viewProjs{};
+  Ogre::Vector4 texelSizes{Ogre::Vector4::ZERO};
+  for (uint32_t i = 0; i < mNumCascades; ++i) {
+    const auto &cascade{mCascades[i]};
+    viewProjs[i] = cascade.viewProj;
+    // A texel size of zero tells the shader to skip the cascade.
+    texelSizes[i] = cascade.isValid ? 2.0f * cascade.radius
+        / static_cast<float>(mMapSize) : 0.0f;
+  }
+
+  auto *pass{mLightMaterial->getTechnique(0)->getPass(0)};
+  const auto &params{pass->getFragmentProgramParameters()};
+  params->setNamedConstant("shadowViewProj", viewProjs.data(), MAX_CASCADES);
+  params->setNamedConstant("shadowTexelSizes", texelSizes);
+  params->setNamedConstant("shadowParams", Ogre::Vector4{
+      static_cast<float>(mNumCascades),
+      1.0f / static_cast<float>(mMapSize),
+      mDistance,
+      0.0f
+  });
+}
+
+void SunShadows::update() {
+  using Clock = std::chrono::steady_clock;
+  using fMillisecond = std::chrono::duration<float, std::milli>;
+  const auto startTime{Clock::now()};
+
+  mLight = nullptr;
+  mStats.numRedrawn = 0u;
+  mStats.numCandidates = 0u;
+  mStats.numCasters.fill(0u);
+  for (auto &cascade : mCascades) {
+    if (cascade.viewport) cascade.viewport->setAutoUpdated(false);
+    cascade.casters.clear();
+  }
+
+  if (!mCamera || !mScnMgr) return;
+  auto *light{findSunLight()};
+  if (!light) return;
+
+  // Shadows are pointless once the sun has set.
+  const auto sunDir{light->getDerivedDirection().normalisedCopy()};
+  if (sunDir.y > -0.01f) return;
+
+  // Casters are tested against their world bounds, which must be up to date.
+  mScnMgr->_updateSceneGraph(mCamera);
+
+  // Basis of the shadow cameras, with the z-axis pointing towards the sun.
+  const Ogre::Vector3 zAxis{-sunDir};
+  const Ogre::Vector3 up{std::abs(zAxis.y) > 0.99f ? Ogre::Vector3::UNIT_Z
+                                                   : Ogre::Vector3::UNIT_Y};
+  const Ogre::Vector3 xAxis{up.crossProduct(zAxis).normalisedCopy()};
+  const Ogre::Vector3 yAxis{zAxis.crossProduct(xAxis)};
+  const Ogre::Quaternion sunRot(xAxis, yAxis, zAxis);
+  const float cosUpdateAngle{std::cos(SUN_UPDATE_ANGLE)};
+
+  const auto splits{getSplits()};
+  std::array<Fit, MAX_CASCADES> fits{};
+  for (uint32_t i = 0; i < mNumCascades; ++i) {
+    const auto &cascade{mCascades[i]};
+    auto &fit{fits[i]};
+    const auto[centre, radius]{getSliceSphere(splits[i], splits[i + 1u])};
+
+    // The outer cascades keep their sphere for as long as it covers their part
+    // of the frustum and the sun has not moved too far.
+    const bool isCached{mBudgetMode && i > 0u};
+    if (isCached && cascade.isValid
+        && cascade.centre.distance(centre) + radius <= cascade.radius
+        && cascade.sunDir.dotProduct(sunDir) >= cosUpdateAngle) {
+      fit.centre = cascade.centre;
+      fit.radius = cascade.radius;
+      fit.isRefit = false;
+      continue;
+    }
+
+    fit.radius = isCached ? radius * (1.0f + CASCADE_MARGIN) : radius;
+    fit.isRefit = true;
+
+    // Move in whole texels of the shadow map, in the plane facing the sun.
+    const float texel{2.0f * fit.radius / static_cast<float>(mMapSize)};
+    const float x{std::floor(centre.dotProduct(xAxis) / texel + 0.5f) * texel};
+    const float y{std::floor(centre.dotProduct(yAxis) / texel + 0.5f) * texel};
+    fit.centre = xAxis * x + yAxis * y + zAxis * centre.dotProduct(zAxis);
+  }
+
+  // Find the casters of every cascade in parallel. A caster is in a cascade if
+  // its bounds overlap the box around the cascade's sphere, extended towards
+  // the sun.
+  const auto casters{gatherCasters()};
+  mStats.numCandidates = casters.size();
+  oo::parallelFor(mNumCascades, [&](std::size_t i) {
+    auto &fit{fits[i]};
+    std::size_t hash{0u};
+    for (const auto &caster : casters) {
+      const auto d{caster.bounds.getCenter() - fit.centre};
+      const auto h{caster.bounds.getHalfSize()};
+      const auto extent = [&h](const Ogre::Vector3 &axis) {
+        return std::abs(axis.x) * h.x + std::abs(axis.y) * h.y
+            + std::abs(axis.z) * h.z;
+      };
+
+      const float ex{extent(xAxis)}, ey{extent(yAxis)}, ez{extent(zAxis)};
+      const float dz{d.dotProduct(zAxis)};
+      if (std::abs(d.dotProduct(xAxis)) > fit.radius + ex
+          || std::abs(d.dotProduct(yAxis)) > fit.radius + ey
+          || dz + ez < -fit.radius
+          || dz - ez > fit.radius + CASTER_DISTANCE) {
+        continue;
+      }
+
+      fit.casters.push_back(caster.object);
+      // Moving a caster changes its shadow, so the bounds are hashed too.
+      hashCombine(hash, static_cast<const void *>(caster.object));
+      hashCombine(hash, caster.bounds.getMinimum().x);
+      hashCombine(hash, caster.bounds.getMinimum().y);
+      hashCombine(hash, caster.bounds.getMinimum().z);
+      hashCombine(hash, caster.bounds.getMaximum().x);
+      hashCombine(hash, caster.bounds.getMaximum().y);
+      hashCombine(hash, caster.bounds.getMaximum().z);
+    }
+    fit.casterHash = hash;
+  });
+
+  // Choose which cascades to redraw. The finest is redrawn every frame, as is
+  // every cascade outside of budget mode.
+  std::vector<uint32_t> redraw{0u};
+  std::vector<uint32_t> stale;
+  for (uint32_t i = 1; i < mNumCascades; ++i) {
+    const auto &cascade{mCascades[i]};
+    const auto &fit{fits[i]};
+    if (!mBudgetMode) {
+      redraw.push_back(i);
+    } else if (!cascade.isValid || fit.isRefit
+        || fit.casterHash != cascade.casterHash) {
+      stale.push_back(i);
+    }
+  }
+
+  std::stable_sort(stale.begin(), stale.end(), [this](uint32_t a, uint32_t b) {
+    return mCascades[a].lastDrawn < mCascades[b].lastDrawn;
+  });
+  const auto numStale{std::min<std::size_t>(stale.size(), mMaxCascadeUpdates)};
+  redraw.insert(redraw.end(), stale.begin(), stale.begin() + numStale);
+
+  for (auto i : redraw) {
+    mStats.numCasters[i] = fits[i].casters.size();
+    placeCascade(i, fits[i], sunRot, sunDir);
+    mCascades[i].viewport->setAutoUpdated(true);
+  }
+  mStats.numRedrawn = redraw.size();
+
+  mLight = light;
+  setLightParameters();
+
+  mStats.cullTime = fMillisecond(Clock::now() - startTime).count();
+}
+
+bool SunShadows::queueCasters(Ogre::Camera &camera, Ogre::RenderQueue &queue) {
+  auto it{std::find_if(mCascades.begin(), mCascades.end(), [&](auto &c) {
+    return c.camera == &camera;
+  })};
+  if (it == mCascades.end()) return false;
+
+  // As in Ogre::SceneNode::_findVisibleObjects().
+  for (auto *obj : it->casters) {
+    obj->_notifyCurrentCamera(&camera);
+    if (obj->isVisible()) obj->_updateRenderQueue(&queue);
+  }
+
+  return true;
+}
+
+void SunShadows::preRenderTargetUpdate(const Ogre::RenderTargetEvent &) {
+  update();
+}
+
+void
+SunShadows::preViewportUpdate(const Ogre::RenderTargetViewportEvent &) {
+  if (mScnMgr) mScnMgr->getRenderQueue()->setRenderableListener(this);
+}
+
+void
+SunShadows::postViewportUpdate(const Ogre::RenderTargetViewportEvent &) {
+  if (mScnMgr) mScnMgr->getRenderQueue()->setRenderableListener(nullptr);
+}
+
+bool SunShadows::renderableQueued(Ogre::Renderable *, uint8_t,
+                                  unsigned short, Ogre::Technique **technique,
+                                  Ogre::RenderQueue *) {
+  auto *tech{*technique};
+  if (!tech || tech->getNumPasses() == 0u) return false;
+
+  const auto *pass{tech->getPass(0)};
+  if (pass->isTransparent()
+      || pass->getAlphaRejectFunction() != Ogre::CMPF_ALWAYS_PASS
+      || !pass->hasVertexProgram()) {
+    return false;
+  }
+
+  const auto &vertexProgram{pass->getVertexProgramName()};
+  if (vertexProgram == STATIC_VERTEX_PROGRAM) {
+    *technique = mCasterTechnique;
+  } else if (vertexProgram == INSTANCED_VERTEX_PROGRAM) {
+    *technique = mInstancedCasterTechnique;
+  } else {
+    // In particular skinned geometry, which would be drawn in its bind pose.
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace oo
\ No newline at end of file
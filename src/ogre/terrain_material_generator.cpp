@@ -1,4 +1,5 @@
 #include "ogre/terrain_material_generator.hpp"
+#include "ogre/terrain_texture_array.hpp"
 #include "util/settings.hpp"
 #include <OgreMaterialManager.h>
 #include <OgrePass.h>
@@ -238,6 +239,13 @@ void TerrainMaterialProfile::makeDiffuseCompositeTechnique(const Ogre::Terrain *
 
 Ogre::MaterialPtr
 TerrainMaterialProfile::generate(const Ogre::Terrain *terrain) {
+  // Every quad shares a single material when the layers are in texture arrays.
+  // The material has no low LOD technique since it is cheap enough to draw
+  // at any distance, so no composite map is required.
+  if (auto *textureArray{oo::TerrainTextureArray::getSingletonPtr()}) {
+    return textureArray->getMaterial(terrain->getWorldSize());
+  }
+
   auto matPtr{createOrRetrieveMaterial(terrain).first};
 
   Ogre::Material::LodValueList lodValues{
@@ -276,7 +284,8 @@ void TerrainMaterialProfile::requestOptions(Ogre::Terrain *terrain) {
   terrain->_setMorphRequired(false);
   terrain->_setNormalMapRequired(false);
   terrain->_setLightMapRequired(false);
-  terrain->_setCompositeMapRequired(terrain->isLoaded());
+  terrain->_setCompositeMapRequired(
+      terrain->isLoaded() && !oo::TerrainTextureArray::getSingletonPtr());
 }
 
 void TerrainMaterialProfile::setLightmapEnabled(bool) {
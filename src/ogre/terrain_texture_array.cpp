@@ -0,0 +1,457 @@
+#include "ogre/terrain_texture_array.hpp"
+#include "util/settings.hpp"
+#include <OgreHardwarePixelBuffer.h>
+#include <OgreMaterialManager.h>
+#include <OgrePass.h>
+#include <OgreResourceGroupManager.h>
+#include <OgreTechnique.h>
+#include <OgreTextureManager.h>
+#include <OgreTextureUnitState.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <utility>
+
+template<> oo::TerrainTextureArray *
+    Ogre::Singleton<oo::TerrainTextureArray>::msSingleton = nullptr;
+
+namespace oo {
+
+namespace {
+
+using Rgba = std::array<uint8_t, 4u>;
+using RgbaBlock = std::array<Rgba, 16u>;
+
+/// Names of the material cloned by `TerrainTextureArray::getMaterial()`, and
+/// of the clone.
+const char *const BASE_MATERIAL_NAME{"__LandscapeMaterialArray"};
+const char *const MATERIAL_NAME{"__LandscapeMaterialArrayInstance"};
+
+uint32_t getNumMipmaps(uint32_t size) noexcept {
+  uint32_t numMipmaps{0u};
+  while (size > 1u) {
+    size >>= 1u;
+    ++numMipmaps;
+  }
+  return numMipmaps;
+}
+
+Rgba unpack565(uint16_t c) noexcept {
+  const auto r{static_cast<uint32_t>((c >> 11u) & 0x1fu)};
+  const auto g{static_cast<uint32_t>((c >> 5u) & 0x3fu)};
+  const auto b{static_cast<uint32_t>(c & 0x1fu)};
+  return {static_cast<uint8_t>((r << 3u) | (r >> 2u)),
+          static_cast<uint8_t>((g << 2u) | (g >> 4u)),
+          static_cast<uint8_t>((b << 3u) | (b >> 2u)),
+          255u};
+}
+
+/// Return the weighted average `(wa * a + wb * b) / (wa + wb)` of two colours.
+Rgba mixColors(const Rgba &a, const Rgba &b,
+               uint32_t wa, uint32_t wb) noexcept {
+  Rgba out{};
+  for (std::size_t i = 0; i < 4u; ++i) {
+    out[i] = static_cast<uint8_t>((wa * a[i] + wb * b[i]) / (wa + wb));
+  }
+  return out;
+}
+
+/// Decode the 8 byte colour part of a BC1, BC2, or BC3 block. BC1 blocks may
+/// use their third palette entry for transparent black, the others may not.
+void decodeColorBlock(const uint8_t *src, bool isBc1, RgbaBlock &out) noexcept {
+  const auto c0{static_cast<uint16_t>(src[0] | (src[1] << 8u))};
+  const auto c1{static_cast<uint16_t>(src[2] | (src[3] << 8u))};
+
+  std::array<Rgba, 4u> palette{oo::unpack565(c0), oo::unpack565(c1)};
+  if (!isBc1 || c0 > c1) {
+    palette[2] = oo::mixColors(palette[0], palette[1], 2u, 1u);
+    palette[3] = oo::mixColors(palette[0], palette[1], 1u, 2u);
+  } else {
+    palette[2] = oo::mixColors(palette[0], palette[1], 1u, 1u);
+    palette[3] = Rgba{0u, 0u, 0u, 0u};
+  }
+
+  const uint32_t bits{src[4] | (src[5] << 8u) | (src[6] << 16u)
+                          | (static_cast<uint32_t>(src[7]) << 24u)};
+  for (uint32_t i = 0; i < 16u; ++i) {
+    out[i] = palette[(bits >> (2u * i)) & 0x3u];
+  }
+}
+
+/// Decode the 8 byte explicit alpha part of a BC2 block.
+void decodeExplicitAlpha(const uint8_t *src, RgbaBlock &out) noexcept {
+  for (uint32_t i = 0; i < 16u; ++i) {
+    const uint32_t alpha{(src[i / 2u] >> (4u * (i % 2u))) & 0xfu};
+    out[i][3] = static_cast<uint8_t>(alpha * 17u);
+  }
+}
+
+/// Decode the 8 byte interpolated alpha part of a BC3 block.
+void decodeInterpolatedAlpha(const uint8_t *src, RgbaBlock &out) noexcept {
+  const uint32_t a0{src[0]}, a1{src[1]};
+  std::array<uint8_t, 8u> palette{static_cast<uint8_t>(a0),
+                                  static_cast<uint8_t>(a1)};
+  if (a0 > a1) {
+    for (uint32_t i = 1; i < 7u; ++i) {
+      palette[i + 1u] = static_cast<uint8_t>(((7u - i) * a0 + i * a1) / 7u);
+    }
+  } else {
+    for (uint32_t i = 1; i < 5u; ++i) {
+      palette[i + 1u] = static_cast<uint8_t>(((5u - i) * a0 + i * a1) / 5u);
+    }
+    palette[6] = 0u;
+    palette[7] = 255u;
+  }
+
+  uint64_t bits{0u};
+  for (std::size_t i = 0; i < 6u; ++i) {
+    bits |= static_cast<uint64_t>(src[2u + i]) << (8u * i);
+  }
+  for (uint32_t i = 0; i < 16u; ++i) {
+    out[i][3] = palette[(bits >> (3u * i)) & 0x7u];
+  }
+}
+
+/// Decode a BC1, BC2, or BC3 compressed image into `dst`, which must be an
+/// `Ogre::PF_BYTE_RGBA` image of the same size.
+void decodeCompressedImage(const Ogre::PixelBox &src, Ogre::Image &dst) {
+  const auto format{src.format};
+  const bool isBc1{format == Ogre::PF_DXT1};
+  const bool isBc2{format == Ogre::PF_DXT2 || format == Ogre::PF_DXT3};
+  const std::size_t blockBytes{isBc1 ? 8u : 16u};
+
+  const uint32_t width{src.getWidth()}, height{src.getHeight()};
+  const uint32_t blocksWide{(width + 3u) / 4u};
+  const uint32_t blocksHigh{(height + 3u) / 4u};
+  const auto *blockPtr{static_cast<const uint8_t *>(src.data)};
+  uint8_t *dstData{dst.getData()};
+
+  RgbaBlock block{};
+  for (uint32_t by = 0; by < blocksHigh; ++by) {
+    for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+      if (isBc1) {
+        oo::decodeColorBlock(blockPtr, true, block);
+      } else {
+        oo::decodeColorBlock(blockPtr + 8u, false, block);
+        if (isBc2) oo::decodeExplicitAlpha(blockPtr, block);
+        else oo::decodeInterpolatedAlpha(blockPtr, block);
+      }
+      blockPtr += blockBytes;
+
+      for (uint32_t i = 0; i < 16u; ++i) {
+        const uint32_t x{bx * 4u + i % 4u}, y{by * 4u + i / 4u};
+        if (x >= width || y >= height) continue;
+        std::copy(block[i].begin(), block[i].end(),
+                  dstData + 4u * (y * width + x));
+      }
+    }
+  }
+}
+
+bool isDecodable(Ogre::PixelFormat format) noexcept {
+  switch (format) {
+    case Ogre::PF_DXT1:
+    case Ogre::PF_DXT2:
+    case Ogre::PF_DXT3:
+    case Ogre::PF_DXT4:
+    case Ogre::PF_DXT5: return true;
+    default: return !Ogre::PixelUtil::isCompressed(format);
+  }
+}
+
+std::string makeLayerKey(const std::string &diffuseName,
+                         const std::string &normalName) {
+  return diffuseName + '|' + normalName;
+}
+
+} // namespace
+
+TerrainTextureArray &TerrainTextureArray::getSingleton() {
+  assert(msSingleton);
+  return *msSingleton;
+}
+
+TerrainTextureArray *TerrainTextureArray::getSingletonPtr() {
+  return msSingleton;
+}
+
+uint32_t TerrainTextureArray::getAtlasQuads(uint32_t nearDiameter,
+                                            uint32_t farDiameter) noexcept {
+  // Each cell is two quads wide.
+  return 2u * (std::max(nearDiameter, farDiameter) + 2u);
+}
+
+uint32_t TerrainTextureArray::getAtlasBlock(long slot,
+                                            uint32_t atlasQuads) noexcept {
+  const long n{static_cast<long>(std::max(atlasQuads, 1u))};
+  return static_cast<uint32_t>(((slot % n) + n) % n);
+}
+
+TerrainTextureArray::TerrainTextureArray(uint32_t layerSize,
+                                         uint32_t maxLayers,
+                                         uint32_t atlasQuads)
+    : mLayerSize(std::max(layerSize, 4u)),
+      mMaxLayers(std::clamp(maxLayers, 1u, 256u)),
+      mAtlasQuads(std::max(atlasQuads, 1u)),
+      mLayers(mMaxLayers) {}
+
+TerrainTextureArray::~TerrainTextureArray() {
+  // Textures are owned by the TextureManager, which may already be gone.
+  auto *texMgr{Ogre::TextureManager::getSingletonPtr()};
+  if (!texMgr) return;
+
+  for (const auto &tex : {mDiffuseArray, mNormalArray, mLayerAtlas,
+                          mWeightAtlas, mNormalAtlas, mVertexColorAtlas}) {
+    if (tex) texMgr->remove(tex);
+  }
+}
+
+Ogre::TexturePtr
+TerrainTextureArray::createTexture(const std::string &name,
+                                   Ogre::TextureType type,
+                                   uint32_t size, uint32_t depth,
+                                   uint32_t numMipmaps,
+                                   Ogre::PixelFormat format) {
+  auto &texMgr{Ogre::TextureManager::getSingleton()};
+  return texMgr.createManual(name, oo::RESOURCE_GROUP, type, size, size, depth,
+                             static_cast<int>(numMipmaps), format,
+                             Ogre::TU_STATIC_WRITE_ONLY);
+}
+
+void TerrainTextureArray::createTextures() {
+  if (mDiffuseArray) return;
+
+  const auto numMipmaps{oo::getNumMipmaps(mLayerSize)};
+  mDiffuseArray = createTexture("__TerrainDiffuseArray",
+                                Ogre::TEX_TYPE_2D_ARRAY, mLayerSize,
+                                mMaxLayers, numMipmaps, Ogre::PF_BYTE_RGBA);
+  mNormalArray = createTexture("__TerrainNormalArray",
+                               Ogre::TEX_TYPE_2D_ARRAY, mLayerSize,
+                               mMaxLayers, numMipmaps, Ogre::PF_BYTE_RGBA);
+
+  const uint32_t atlasSize{mAtlasQuads * VERTICES_PER_QUAD};
+  mLayerAtlas = createTexture("__TerrainLayerAtlas", Ogre::TEX_TYPE_2D,
+                              atlasSize, 1u, 0u, Ogre::PF_BYTE_RGBA);
+  mWeightAtlas = createTexture("__TerrainWeightAtlas", Ogre::TEX_TYPE_2D,
+                               atlasSize, 1u, 0u, Ogre::PF_BYTE_RGBA);
+  mNormalAtlas = createTexture("__TerrainNormalAtlas", Ogre::TEX_TYPE_2D,
+                               atlasSize, 1u, 0u, Ogre::PF_BYTE_RGB);
+  mVertexColorAtlas = createTexture("__TerrainVertexColorAtlas",
+                                    Ogre::TEX_TYPE_2D, atlasSize, 1u, 0u,
+                                    Ogre::PF_BYTE_RGB);
+}
+
+uint32_t TerrainTextureArray::findFreeLayer() const {
+  uint32_t best{mMaxLayers};
+  for (uint32_t i = 0; i < mMaxLayers; ++i) {
+    const auto &layer{mLayers[i]};
+    if (!layer.isUsed) return i;
+    if (layer.refCount != 0u || layer.isPending) continue;
+    if (best == mMaxLayers || layer.lastAcquired < mLayers[best].lastAcquired) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+Ogre::Image
+TerrainTextureArray::readLayerTexture(const std::string &name) const {
+  Ogre::Image result{};
+  result.create(Ogre::PF_BYTE_RGBA, mLayerSize, mLayerSize, 1u, 1u,
+                oo::getNumMipmaps(mLayerSize));
+
+  Ogre::Image source{};
+  try {
+    auto &resGrpMgr{Ogre::ResourceGroupManager::getSingleton()};
+    auto stream{resGrpMgr.openResource(name, oo::RESOURCE_GROUP)};
+    const auto extPos{name.find_last_of('.')};
+    source.load(stream, extPos == std::string::npos ? Ogre::BLANKSTRING
+                                                    : name.substr(extPos + 1u));
+  } catch (const Ogre::Exception &e) {
+    spdlog::get(oo::LOG)->warn("Failed to read terrain texture {}: {}",
+                               name, e.getDescription());
+  }
+
+  if (source.getWidth() == 0u || !oo::isDecodable(source.getFormat())) {
+    std::fill(result.getData(), result.getData() + result.getSize(), 0u);
+    return result;
+  }
+
+  // Convert the smallest mip level that is still at least the layer size, to
+  // avoid decoding more than necessary.
+  uint32_t mip{0u};
+  while (mip < source.getNumMipmaps()
+      && (source.getWidth() >> (mip + 1u)) >= mLayerSize
+      && (source.getHeight() >> (mip + 1u)) >= mLayerSize) {
+    ++mip;
+  }
+
+  const auto srcBox{source.getPixelBox(0u, mip)};
+  Ogre::Image rgba{};
+  rgba.create(Ogre::PF_BYTE_RGBA, srcBox.getWidth(), srcBox.getHeight());
+  if (Ogre::PixelUtil::isCompressed(srcBox.format)) {
+    oo::decodeCompressedImage(srcBox, rgba);
+  } else {
+    Ogre::PixelUtil::bulkPixelConversion(srcBox, rgba.getPixelBox());
+  }
+
+  Ogre::Image::scale(rgba.getPixelBox(), result.getPixelBox(0u, 0u));
+  for (uint32_t i = 1; i <= result.getNumMipmaps(); ++i) {
+    Ogre::Image::scale(result.getPixelBox(0u, i - 1u),
+                       result.getPixelBox(0u, i));
+  }
+
+  return result;
+}
+
+TerrainTextureArray::LayerIndex
+TerrainTextureArray::acquireLayer(const std::string &diffuseName,
+                                  const std::string &normalName) {
+  const auto key{oo::makeLayerKey(diffuseName, normalName)};
+
+  // Only reserve a layer with the lock held, the textures are read without it.
+  // Reading opens the textures' archives, which may suspend the calling fiber
+  // while it waits for them, and the render thread should not have to wait
+  // for file reads in `releaseLayer()` or `uploadPendingLayers()`.
+  LayerIndex index{};
+  {
+    std::scoped_lock lock{mMutex};
+    ++mAcquireCount;
+
+    if (auto it{mLayerIndices.find(key)}; it != mLayerIndices.end()) {
+      auto &layer{mLayers[it->second]};
+      ++layer.refCount;
+      layer.lastAcquired = mAcquireCount;
+      return it->second;
+    }
+
+    const auto freeIndex{findFreeLayer()};
+    if (freeIndex == mMaxLayers) {
+      // Every layer is in use, so draw the textures with the wrong layer
+      // instead of not at all.
+      auto it{std::min_element(mLayers.begin(), mLayers.end(),
+                               [](const Layer &a, const Layer &b) {
+                                 return a.lastAcquired < b.lastAcquired;
+                               })};
+      spdlog::get(oo::LOG)->warn("Terrain texture array is full, {} will be "
+                                 "drawn with {}", diffuseName, it->diffuseName);
+      ++it->refCount;
+      it->lastAcquired = mAcquireCount;
+      return static_cast<LayerIndex>(std::distance(mLayers.begin(), it));
+    }
+
+    index = static_cast<LayerIndex>(freeIndex);
+    auto &layer{mLayers[index]};
+    if (layer.isUsed) {
+      mLayerIndices.erase(oo::makeLayerKey(layer.diffuseName,
+                                           layer.normalName));
+    }
+    layer = Layer{diffuseName, normalName, 1u, mAcquireCount, true, true};
+    mLayerIndices.emplace(key, index);
+  }
+
+  // The layer holds the reference taken by this call, so it cannot be
+  // reused by another layer while its textures are read. Other callers that
+  // acquire the same textures in the meantime are given the layer straight
+  // away, and draw with its previous contents until it is uploaded.
+  PendingLayer pending{index, readLayerTexture(diffuseName),
+                       readLayerTexture(normalName)};
+
+  std::scoped_lock lock{mMutex};
+  mLayers[index].isPending = false;
+  mPendingLayers.push_back(std::move(pending));
+
+  return index;
+}
+
+void TerrainTextureArray::releaseLayer(LayerIndex layer) {
+  std::scoped_lock lock{mMutex};
+  if (layer >= mLayers.size()) return;
+  if (mLayers[layer].refCount > 0u) --mLayers[layer].refCount;
+}
+
+void TerrainTextureArray::uploadPendingLayers() {
+  std::vector<PendingLayer> pending{};
+  {
+    std::scoped_lock lock{mMutex};
+    pending.swap(mPendingLayers);
+  }
+  if (pending.empty()) return;
+
+  createTextures();
+
+  // Pending layers are in the order they were read, so if a layer was reused
+  // before being uploaded then its most recent textures win.
+  for (const auto &layer : pending) {
+    const uint32_t z{layer.index};
+    for (uint32_t mip = 0; mip <= mDiffuseArray->getNumMipmaps(); ++mip) {
+      const uint32_t size{std::max(mLayerSize >> mip, 1u)};
+      const Ogre::Box box(0u, 0u, z, size, size, z + 1u);
+      mDiffuseArray->getBuffer(0, mip)->blitFromMemory(
+          layer.diffuse.getPixelBox(0u, mip), box);
+      mNormalArray->getBuffer(0, mip)->blitFromMemory(
+          layer.normal.getPixelBox(0u, mip), box);
+    }
+  }
+}
+
+void TerrainTextureArray::writeQuad(long slotX, long slotY,
+                                    const Ogre::PixelBox &layers,
+                                    const Ogre::PixelBox &weights,
+                                    const Ogre::PixelBox &normals,
+                                    const Ogre::PixelBox &vertexColors) {
+  createTextures();
+
+  // Must match the block lookup in landscape_array_fs.glsl.
+  const uint32_t left{getAtlasBlock(slotX, mAtlasQuads) * VERTICES_PER_QUAD};
+  const uint32_t top{getAtlasBlock(slotY, mAtlasQuads) * VERTICES_PER_QUAD};
+  const Ogre::Box box(left, top, left + VERTICES_PER_QUAD,
+                      top + VERTICES_PER_QUAD);
+
+  mLayerAtlas->getBuffer()->blitFromMemory(layers, box);
+  mWeightAtlas->getBuffer()->blitFromMemory(weights, box);
+  mNormalAtlas->getBuffer()->blitFromMemory(normals, box);
+  mVertexColorAtlas->getBuffer()->blitFromMemory(vertexColors, box);
+}
+
+Ogre::MaterialPtr TerrainTextureArray::getMaterial(Ogre::Real quadWorldSize) {
+  auto &matMgr{Ogre::MaterialManager::getSingleton()};
+  if (auto matPtr{matMgr.getByName(MATERIAL_NAME, oo::RESOURCE_GROUP)}) {
+    return matPtr;
+  }
+
+  createTextures();
+
+  auto baseMat{matMgr.getByName(BASE_MATERIAL_NAME, oo::SHADER_GROUP)};
+  auto matPtr{baseMat->clone(MATERIAL_NAME, true, oo::RESOURCE_GROUP)};
+  auto *pass{matPtr->getTechnique(0)->getPass(0)};
+  pass->removeAllTextureUnitStates();
+
+  constexpr auto CLAMP{Ogre::TextureAddressingMode::TAM_CLAMP};
+  constexpr auto WRAP{Ogre::TextureAddressingMode::TAM_WRAP};
+
+  // Order must match the sampler indices in __LandscapeMaterialArray.
+  const std::array<std::pair<Ogre::TexturePtr, Ogre::TextureAddressingMode>,
+                   6u> units{{
+      {mDiffuseArray, WRAP},
+      {mNormalArray, WRAP},
+      {mLayerAtlas, CLAMP},
+      {mWeightAtlas, CLAMP},
+      {mNormalAtlas, CLAMP},
+      {mVertexColorAtlas, CLAMP}
+  }};
+  for (const auto &[tex, addressing] : units) {
+    auto *unit{pass->createTextureUnitState()};
+    unit->setTexture(tex);
+    unit->setTextureAddressingMode(addressing);
+  }
+
+  auto params{pass->getFragmentProgramParameters()};
+  params->setNamedConstant("quadWorldSize", quadWorldSize);
+  params->setNamedConstant("atlasQuads", static_cast<int>(mAtlasQuads));
+
+  return matPtr;
+}
+
+} // namespace oo
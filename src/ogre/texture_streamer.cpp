@@ -0,0 +1,516 @@
+#include "job/job.hpp"
+#include "job/upload_queue.hpp"
+#include "ogre/texture_streamer.hpp"
+#include <OgrePass.h>
+#include <OgreStringConverter.h>
+#include <OgreTechnique.h>
+#include <OgreTextureManager.h>
+#include <OgreTextureUnitState.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+template<> oo::TextureStreamer *
+    Ogre::Singleton<oo::TextureStreamer>::msSingleton = nullptr;
+
+namespace oo {
+
+namespace {
+
+/// Byte offsets into a DDS file, including the four byte magic number.
+/// See the documentation of `DDS_HEADER` and `DDS_PIXELFORMAT`.
+struct DdsOffsets {
+  constexpr static std::size_t FLAGS{8u};
+  constexpr static std::size_t HEIGHT{12u};
+  constexpr static std::size_t WIDTH{16u};
+  constexpr static std::size_t PITCH_OR_LINEAR_SIZE{20u};
+  constexpr static std::size_t MIP_MAP_COUNT{28u};
+  constexpr static std::size_t PF_FLAGS{80u};
+  constexpr static std::size_t PF_FOURCC{84u};
+  constexpr static std::size_t PF_RGB_BIT_COUNT{88u};
+  constexpr static std::size_t CAPS2{112u};
+  constexpr static std::size_t DATA{128u};
+};
+
+constexpr uint32_t DDSD_PITCH{0x8u};
+constexpr uint32_t DDSD_LINEARSIZE{0x80000u};
+constexpr uint32_t DDPF_FOURCC{0x4u};
+constexpr uint32_t DDSCAPS2_CUBEMAP{0x200u};
+constexpr uint32_t DDSCAPS2_VOLUME{0x200000u};
+
+constexpr uint32_t makeFourCC(char a, char b, char c, char d) noexcept {
+  return static_cast<uint32_t>(static_cast<unsigned char>(a))
+      | static_cast<uint32_t>(static_cast<unsigned char>(b)) << 8u
+      | static_cast<uint32_t>(static_cast<unsigned char>(c)) << 16u
+      | static_cast<uint32_t>(static_cast<unsigned char>(d)) << 24u;
+}
+
+uint32_t readU32(const unsigned char *data, std::size_t offset) noexcept {
+  uint32_t value{};
+  std::memcpy(&value, data + offset, sizeof(value));
+  return value;
+}
+
+void writeU32(unsigned char *data, std::size_t offset,
+              uint32_t value) noexcept {
+  std::memcpy(data + offset, &value, sizeof(value));
+}
+
+/// Return the number of bytes in each 4x4 block of a block-compressed format,
+/// or zero if the format is not one that we know.
+uint32_t getBlockSize(uint32_t fourCC) noexcept {
+  switch (fourCC) {
+    case makeFourCC('D', 'X', 'T', '1'): [[fallthrough]];
+    case makeFourCC('A', 'T', 'I', '1'): [[fallthrough]];
+    case makeFourCC('B', 'C', '4', 'U'): return 8u;
+    case makeFourCC('D', 'X', 'T', '2'): [[fallthrough]];
+    case makeFourCC('D', 'X', 'T', '3'): [[fallthrough]];
+    case makeFourCC('D', 'X', 'T', '4'): [[fallthrough]];
+    case makeFourCC('D', 'X', 'T', '5'): [[fallthrough]];
+    case makeFourCC('A', 'T', 'I', '2'): [[fallthrough]];
+    case makeFourCC('B', 'C', '5', 'U'): return 16u;
+    default: return 0u;
+  }
+}
+
+bool isDdsName(const std::string &name) {
+  return Ogre::StringUtil::endsWith(name, ".dds", true);
+}
+
+} // namespace
+
+TextureStreamer &TextureStreamer::getSingleton() {
+  assert(msSingleton);
+  return *msSingleton;
+}
+
+TextureStreamer *TextureStreamer::getSingletonPtr() {
+  return msSingleton;
+}
+
+TextureStreamer::TextureStreamer(std::size_t budgetBytes, uint32_t minSize)
+    : mBudgetBytes(budgetBytes), mMinSize(std::max(minSize, 1u)) {}
+
+std::size_t TextureStreamer::getResidentBytes(const Entry &entry,
+                                              uint32_t mip) {
+  if (!entry.isStreamable) return entry.residentBytes;
+  return entry.mipOffsets.back() - entry.mipOffsets[mip];
+}
+
+uint32_t TextureStreamer::getMipForSize(const Entry &entry,
+                                        float pixels) const {
+  if (!entry.isStreamable) return 0u;
+
+  const auto maxMip{static_cast<uint32_t>(entry.mipOffsets.size() - 2u)};
+  const float target{std::max(pixels, static_cast<float>(mMinSize))};
+  const uint32_t longest{std::max(entry.width, entry.height)};
+
+  uint32_t mip{0u};
+  while (mip < maxMip && static_cast<float>(longest >> (mip + 1u)) >= target) {
+    ++mip;
+  }
+  return mip;
+}
+
+Ogre::MemoryDataStreamPtr
+TextureStreamer::readTexture(const Ogre::String &name,
+                             const Ogre::String &group,
+                             Entry &entry) {
+  // Passing no resource stops this listener from being asked for the stream.
+  auto &resGrpMgr{Ogre::ResourceGroupManager::getSingleton()};
+  auto stream{resGrpMgr.openResource(name, group, nullptr, false)};
+  if (!stream) return nullptr;
+
+  auto file{std::make_shared<Ogre::MemoryDataStream>(name, stream)};
+  entry.name = name;
+  entry.group = group;
+  entry.isStreamable = false;
+  entry.mipOffsets.clear();
+
+  const std::size_t size{file->size()};
+  const auto *data{file->getPtr()};
+  entry.residentBytes = size;
+
+  if (size < DdsOffsets::DATA
+      || readU32(data, 0u) != makeFourCC('D', 'D', 'S', ' ')) {
+    return file;
+  }
+
+  entry.width = readU32(data, DdsOffsets::WIDTH);
+  entry.height = readU32(data, DdsOffsets::HEIGHT);
+  entry.residentBytes = size - DdsOffsets::DATA;
+  const uint32_t numMipmaps{readU32(data, DdsOffsets::MIP_MAP_COUNT)};
+  const uint32_t caps2{readU32(data, DdsOffsets::CAPS2)};
+
+  if (numMipmaps <= 1u || entry.width == 0u || entry.height == 0u
+      || (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0u) {
+    return file;
+  }
+
+  // Compressed formats are stored in 4x4 blocks, everything else by pixel.
+  const uint32_t pfFlags{readU32(data, DdsOffsets::PF_FLAGS)};
+  const bool isCompressed{(pfFlags & DDPF_FOURCC) != 0u};
+  const uint32_t blockSize{isCompressed
+                           ? getBlockSize(readU32(data, DdsOffsets::PF_FOURCC))
+                           : 0u};
+  const uint32_t pixelSize{isCompressed
+                           ? 0u
+                           : readU32(data, DdsOffsets::PF_RGB_BIT_COUNT) / 8u};
+  if (blockSize == 0u && pixelSize == 0u) return file;
+
+  entry.mipOffsets.reserve(numMipmaps + 1u);
+  std::size_t offset{DdsOffsets::DATA};
+  for (uint32_t mip = 0; mip < numMipmaps; ++mip) {
+    const std::size_t w{std::max(entry.width >> mip, 1u)};
+    const std::size_t h{std::max(entry.height >> mip, 1u)};
+    entry.mipOffsets.push_back(offset);
+    offset += isCompressed ? ((w + 3u) / 4u) * ((h + 3u) / 4u) * blockSize
+                           : w * h * pixelSize;
+  }
+  entry.mipOffsets.push_back(offset);
+
+  if (offset > size) {
+    entry.mipOffsets.clear();
+    return file;
+  }
+
+  entry.isStreamable = true;
+  entry.residentBytes = getResidentBytes(entry, 0u);
+  return file;
+}
+
+Ogre::DataStreamPtr
+TextureStreamer::rewriteTexture(Ogre::MemoryDataStream &file,
+                                const Entry &entry, uint32_t mip) {
+  const auto *src{file.getPtr()};
+  const std::size_t dataSize{entry.mipOffsets.back() - entry.mipOffsets[mip]};
+
+  auto out{std::make_shared<Ogre::MemoryDataStream>(
+      file.getName(), DdsOffsets::DATA + dataSize)};
+  auto *dst{out->getPtr()};
+  std::memcpy(dst, src, DdsOffsets::DATA);
+  std::memcpy(dst + DdsOffsets::DATA, src + entry.mipOffsets[mip], dataSize);
+
+  const uint32_t width{std::max(entry.width >> mip, 1u)};
+  const uint32_t height{std::max(entry.height >> mip, 1u)};
+  const auto numMipmaps{static_cast<uint32_t>(entry.mipOffsets.size() - 1u)};
+  writeU32(dst, DdsOffsets::WIDTH, width);
+  writeU32(dst, DdsOffsets::HEIGHT, height);
+  writeU32(dst, DdsOffsets::MIP_MAP_COUNT, numMipmaps - mip);
+
+  const uint32_t flags{readU32(src, DdsOffsets::FLAGS)};
+  const auto topSize{static_cast<uint32_t>(entry.mipOffsets[mip + 1u]
+                                               - entry.mipOffsets[mip])};
+  if (flags & DDSD_LINEARSIZE) {
+    writeU32(dst, DdsOffsets::PITCH_OR_LINEAR_SIZE, topSize);
+  } else if (flags & DDSD_PITCH) {
+    writeU32(dst, DdsOffsets::PITCH_OR_LINEAR_SIZE, topSize / height);
+  }
+
+  return out;
+}
+
+Ogre::DataStreamPtr
+TextureStreamer::resourceLoading(const Ogre::String &name,
+                                 const Ogre::String &group,
+                                 Ogre::Resource *resource) {
+  auto *texture{dynamic_cast<Ogre::Texture *>(resource)};
+  if (!texture || !isDdsName(name)) return nullptr;
+
+  // If the texture is being reloaded by the streamer, then its file is ready.
+  {
+    std::scoped_lock lock{mMutex};
+    if (auto it{mEntries.find(texture)}; it != mEntries.end()) {
+      auto &entry{it->second};
+      if (entry.prepared && entry.name == name) {
+        entry.residentMip = entry.preparedMip;
+        entry.residentBytes = getResidentBytes(entry, entry.residentMip);
+        return std::move(entry.prepared);
+      }
+    }
+  }
+
+  // Otherwise Ogre is loading the texture itself, either for the first time or
+  // because it was unloaded behind our back.
+  Entry layout{};
+  auto file{readTexture(name, group, layout)};
+  if (!file) return nullptr;
+
+  std::scoped_lock lock{mMutex};
+  auto [it, inserted]{mEntries.try_emplace(texture)};
+  auto &entry{it->second};
+  const bool isNew{inserted || entry.name != name};
+
+  // Textures that nothing has asked for are loaded in full, since they might
+  // be drawn at any size.
+  layout.isRequested = !isNew && entry.isRequested;
+  const uint32_t residentMip{layout.isRequested ? entry.residentMip : 0u};
+  layout.residentMip = std::min(residentMip, getMipForSize(layout, 0.0f));
+  layout.wantedMip = isNew ? layout.residentMip : entry.wantedMip;
+  layout.requestedPixels = isNew ? 0.0f : entry.requestedPixels;
+  layout.lastRequestFrame = isNew ? 0u : entry.lastRequestFrame;
+  layout.isPending = !isNew && entry.isPending;
+  layout.preparedMip = isNew ? 0u : entry.preparedMip;
+  entry = std::move(layout);
+
+  if (!entry.isStreamable) return file;
+  entry.residentBytes = getResidentBytes(entry, entry.residentMip);
+  if (entry.residentMip == 0u) return file;
+  return rewriteTexture(*file, entry, entry.residentMip);
+}
+
+void TextureStreamer::resourceStreamOpened(const Ogre::String &/*name*/,
+                                           const Ogre::String &/*group*/,
+                                           Ogre::Resource */*resource*/,
+                                           Ogre::DataStreamPtr &/*stream*/) {}
+
+bool TextureStreamer::resourceCollision(Ogre::Resource */*resource*/,
+                                        Ogre::ResourceManager */*resMgr*/) {
+  return false;
+}
+
+void TextureStreamer::requestMaterial(const Ogre::Material &material,
+                                      float pixels) {
+  for (const auto *technique : material.getTechniques()) {
+    for (const auto *pass : technique->getPasses()) {
+      for (const auto *unit : pass->getTextureUnitStates()) {
+        if (const auto &texture{unit->_getTexturePtr()}) {
+          requestTexture(*texture, pixels);
+        }
+      }
+    }
+  }
+}
+
+void TextureStreamer::requestTexture(const Ogre::Texture &texture,
+                                     float pixels) {
+  std::scoped_lock lock{mMutex};
+  auto it{mEntries.find(&texture)};
+  if (it == mEntries.end()) return;
+
+  auto &entry{it->second};
+  entry.isRequested = true;
+  if (entry.lastRequestFrame != mFrame) {
+    entry.lastRequestFrame = mFrame;
+    entry.requestedPixels = pixels;
+  } else {
+    entry.requestedPixels = std::max(entry.requestedPixels, pixels);
+  }
+}
+
+void TextureStreamer::update() {
+  if (mFrame % PRUNE_INTERVAL == 0u) pruneEntries();
+  std::scoped_lock lock{mMutex};
+
+  std::size_t totalBytes{0u};
+  std::vector<Entry *> upgrades{};
+  std::vector<Entry *> downgrades{};
+
+  for (auto &[_, entry] : mEntries) {
+    const bool isSeen{mFrame - entry.lastRequestFrame < REQUEST_LIFETIME};
+    entry.wantedMip = entry.isRequested
+                      ? getMipForSize(entry, isSeen ? entry.requestedPixels
+                                                    : 0.0f)
+                      : 0u;
+
+    // Count pending textures as if they had already finished loading, so that
+    // an upgrade is not started twice over the budget.
+    totalBytes += entry.isPending
+                  ? std::max(entry.residentBytes,
+                             getResidentBytes(entry, entry.preparedMip))
+                  : entry.residentBytes;
+
+    if (!entry.isStreamable || !entry.isRequested || entry.isPending) continue;
+    if (entry.wantedMip < entry.residentMip) upgrades.push_back(&entry);
+    else if (entry.residentMip + 2u < entry.mipOffsets.size()) {
+      downgrades.push_back(&entry);
+    }
+  }
+
+  // Evict the mip levels of the textures that have gone unseen the longest, and
+  // that are the smallest on screen if they are all still being seen.
+  if (totalBytes > mBudgetBytes) {
+    std::sort(downgrades.begin(), downgrades.end(), [](auto *a, auto *b) {
+      return a->lastRequestFrame != b->lastRequestFrame
+             ? a->lastRequestFrame < b->lastRequestFrame
+             : a->requestedPixels < b->requestedPixels;
+    });
+
+    for (auto *entry : downgrades) {
+      if (totalBytes <= mBudgetBytes || mNumInFlight >= MAX_IN_FLIGHT) break;
+      const uint32_t mip{std::max(entry->wantedMip, entry->residentMip + 1u)};
+      totalBytes -= entry->residentBytes - getResidentBytes(*entry, mip);
+      beginStreaming(*entry, mip);
+      ++mNumDowngrades;
+    }
+  }
+
+  // Upgrade the textures that are the furthest from what they need first.
+  std::sort(upgrades.begin(), upgrades.end(), [](auto *a, auto *b) {
+    const auto aShortfall{a->residentMip - a->wantedMip};
+    const auto bShortfall{b->residentMip - b->wantedMip};
+    return aShortfall != bShortfall
+           ? aShortfall > bShortfall
+           : a->requestedPixels > b->requestedPixels;
+  });
+
+  for (auto *entry : upgrades) {
+    if (mNumInFlight >= MAX_IN_FLIGHT) break;
+    const std::size_t bytes{getResidentBytes(*entry, entry->wantedMip)};
+    if (totalBytes + bytes - entry->residentBytes > mBudgetBytes) continue;
+    totalBytes += bytes - entry->residentBytes;
+    beginStreaming(*entry, entry->wantedMip);
+    ++mNumUpgrades;
+  }
+
+  ++mFrame;
+}
+
+void TextureStreamer::pruneEntries() {
+  auto *texMgr{Ogre::TextureManager::getSingletonPtr()};
+  if (!texMgr) return;
+
+  struct Candidate {
+    const Ogre::Texture *key{};
+    std::string name{};
+    std::string group{};
+    /// The texture if it still exists, otherwise null.
+    Ogre::TexturePtr texture{};
+  };
+
+  std::vector<Candidate> candidates{};
+  {
+    std::scoped_lock lock{mMutex};
+    candidates.reserve(mEntries.size());
+    for (const auto &[key, entry] : mEntries) {
+      candidates.push_back(Candidate{key, entry.name, entry.group});
+    }
+  }
+
+  // The texture manager is searched without holding the mutex, since Ogre can
+  // call `resourceLoading()` while holding its own locks.
+  std::vector<Candidate> stale{};
+  for (auto &c : candidates) {
+    c.texture = texMgr->getByName(c.name, c.group);
+    if (c.texture.get() != c.key) c.texture.reset();
+    if (!c.texture || c.texture->getLoadingState()
+        == Ogre::Resource::LOADSTATE_UNLOADED) {
+      stale.push_back(std::move(c));
+    }
+  }
+
+  std::scoped_lock lock{mMutex};
+  for (const auto &c : stale) {
+    auto it{mEntries.find(c.key)};
+    if (it == mEntries.end() || it->second.name != c.name) continue;
+    // Leave textures that are streaming, or that began loading again since
+    // they were looked up.
+    if (it->second.isPending) continue;
+    if (c.texture && c.texture->getLoadingState()
+        != Ogre::Resource::LOADSTATE_UNLOADED) {
+      continue;
+    }
+    mEntries.erase(it);
+  }
+}
+
+void TextureStreamer::beginStreaming(Entry &entry, uint32_t mip) {
+  entry.isPending = true;
+  entry.preparedMip = mip;
+  ++mNumInFlight;
+
+  oo::JobManager::runJob([name = entry.name, group = entry.group, mip]() {
+    Entry layout{};
+    DataStreamPtr stream{};
+    if (auto file{readTexture(name, group, layout)}; file) {
+      if (layout.isStreamable && mip + 1u < layout.mipOffsets.size()) {
+        if (mip == 0u) stream = std::move(file);
+        else stream = rewriteTexture(*file, layout, mip);
+      }
+    }
+
+    oo::UploadQueue::push([name, group, mip, stream]() {
+      if (auto *streamer{TextureStreamer::getSingletonPtr()}) {
+        streamer->finishStreaming(name, group, mip, stream);
+      }
+    });
+  });
+}
+
+void TextureStreamer::finishStreaming(const std::string &name,
+                                      const std::string &group,
+                                      uint32_t mip,
+                                      DataStreamPtr stream) {
+  auto &texMgr{Ogre::TextureManager::getSingleton()};
+  auto texture{texMgr.getByName(name, group)};
+
+  {
+    std::scoped_lock lock{mMutex};
+    --mNumInFlight;
+    auto it{mEntries.find(texture.get())};
+    if (it == mEntries.end() || it->second.name != name) {
+      // The texture was removed while streaming, and possibly replaced by
+      // another with the same name. Its entry is keyed by the old texture so
+      // was not found, and would otherwise be pending and never pruned.
+      for (auto jt{mEntries.begin()}; jt != mEntries.end();) {
+        const auto &entry{jt->second};
+        if (jt->first != texture.get() && entry.isPending
+            && entry.name == name && entry.group == group) {
+          jt = mEntries.erase(jt);
+        } else {
+          ++jt;
+        }
+      }
+      return;
+    }
+
+    auto &entry{it->second};
+    entry.isPending = false;
+    if (!stream) return;
+    entry.prepared = std::move(stream);
+    entry.preparedMip = mip;
+  }
+
+  // If the texture is not loaded then the prepared file will be used when it
+  // is next loaded.
+  if (texture->isLoaded()) texture->reload();
+}
+
+TextureStreamer::Stats TextureStreamer::getStats() const {
+  std::scoped_lock lock{mMutex};
+  Stats stats{};
+  stats.numTextures = mEntries.size();
+  stats.numPending = mNumInFlight;
+  stats.budgetBytes = mBudgetBytes;
+  stats.numUpgrades = mNumUpgrades;
+  stats.numDowngrades = mNumDowngrades;
+  for (const auto &[_, entry] : mEntries) {
+    if (entry.isStreamable) ++stats.numStreamable;
+    stats.residentBytes += entry.residentBytes;
+  }
+  return stats;
+}
+
+std::vector<TextureStreamer::TextureStats>
+TextureStreamer::getTextureStats() const {
+  std::scoped_lock lock{mMutex};
+  std::vector<TextureStats> stats{};
+  stats.reserve(mEntries.size());
+  for (const auto &[_, entry] : mEntries) {
+    TextureStats &s{stats.emplace_back()};
+    s.name = entry.name;
+    s.width = entry.width;
+    s.height = entry.height;
+    s.numMipmaps = entry.isStreamable
+                   ? static_cast<uint32_t>(entry.mipOffsets.size() - 1u)
+                   : 1u;
+    s.residentMip = entry.residentMip;
+    s.wantedMip = entry.wantedMip;
+    s.residentBytes = entry.residentBytes;
+    s.isStreamable = entry.isStreamable;
+    s.isPending = entry.isPending;
+  }
+  return stats;
+}
+
+} // namespace oo
@@ -0,0 +1,285 @@
+#include "ogrebullet/bvh_cache.hpp"
+#include "util/atomic_file.hpp"
+#include <gsl/gsl>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Ogre {
+
+namespace {
+
+/// Header at the start of every cache file, followed by `size` bytes of
+/// serialized BVH.
+struct BvhCacheHeader {
+  std::array<char, 4> magic{'O', 'B', 'V', 'H'};
+  uint32_t version{2u};
+  /// Serialized BVHs contain `btScalar`s so cannot be shared between single
+  /// and double precision builds.
+  uint32_t scalarSize{sizeof(btScalar)};
+  uint32_t size{0u};
+  /// Total number of vertices in the mesh.
+  uint32_t numVertices{0u};
+  /// Total number of triangles in the mesh.
+  uint32_t numTriangles{0u};
+  /// Number of nodes in the BVH.
+  uint32_t numNodes{0u};
+  /// Number of subtree headers in the BVH.
+  uint32_t numSubtrees{0u};
+
+  bool isCompatibleWith(const BvhCacheHeader &other) const noexcept {
+    return magic == other.magic && version == other.version
+        && scalarSize == other.scalarSize;
+  }
+};
+
+/// Number of vertices and triangles of a mesh.
+struct MeshCounts {
+  uint32_t numVertices{0u};
+  uint32_t numTriangles{0u};
+  /// Number of triangles in each subpart.
+  std::vector<int> numPartTriangles{};
+};
+
+/// Alignment required by `btQuantizedBvh::deSerializeInPlace`.
+constexpr std::size_t BVH_ALIGNMENT{16u};
+
+std::mutex &getDirectoryMutex() {
+  static std::mutex mutex{};
+  return mutex;
+}
+
+std::filesystem::path &getDirectory() {
+  static std::filesystem::path directory{};
+  return directory;
+}
+
+/// Return the path of the cache entry with the given checksum, or an empty
+/// path if the cache is disabled.
+std::filesystem::path getEntryPath(uint64_t checksum) {
+  std::scoped_lock lock{getDirectoryMutex()};
+  const auto &directory{getDirectory()};
+  if (directory.empty()) return {};
+
+  std::array<char, 21> name{};
+  std::snprintf(name.data(), name.size(), "%016llx.bvh",
+                static_cast<unsigned long long>(checksum));
+  return directory / name.data();
+}
+
+/// Add `bytes` to a 64-bit FNV-1a hash.
+uint64_t fnv1a(uint64_t hash, gsl::span<const unsigned char> bytes) noexcept {
+  for (auto byte : bytes) {
+    hash ^= byte;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+template<class T>
+uint64_t fnv1a(uint64_t hash, const T &value) noexcept {
+  const auto *ptr{reinterpret_cast<const unsigned char *>(&value)};
+  return fnv1a(hash, gsl::make_span(ptr, sizeof(T)));
+}
+
+MeshCounts getMeshCounts(const btStridingMeshInterface &mesh) {
+  MeshCounts counts{};
+  const int numParts{mesh.getNumSubParts()};
+  counts.numPartTriangles.reserve(static_cast<std::size_t>(numParts));
+  for (int i = 0; i < numParts; ++i) {
+    const unsigned char *vertexBase{};
+    int numVerts{};
+    PHY_ScalarType vertexType{};
+    int vertexStride{};
+    const unsigned char *indexBase{};
+    int indexStride{};
+    int numFaces{};
+    PHY_ScalarType indexType{};
+    mesh.getLockedReadOnlyVertexIndexBase(&vertexBase, numVerts, vertexType,
+                                          vertexStride, &indexBase, indexStride,
+                                          numFaces, indexType, i);
+    mesh.unLockReadOnlyVertexBase(i);
+
+    counts.numVertices += static_cast<uint32_t>(numVerts);
+    counts.numTriangles += static_cast<uint32_t>(numFaces);
+    counts.numPartTriangles.push_back(numFaces);
+  }
+  return counts;
+}
+
+/// Return whether `bvh` has the shape recorded in `header`, and whether every
+/// node refers to a triangle of the mesh and every subtree lies within the
+/// tree, so that it is safe to traverse.
+bool isValidBvh(btQuantizedBvh &bvh, const BvhCacheHeader &header,
+                const MeshCounts &counts) {
+  if (!bvh.isQuantized()) return false;
+
+  const auto &nodes{bvh.getQuantizedNodeArray()};
+  const auto &subtrees{bvh.getSubtreeInfoArray()};
+  if (static_cast<uint32_t>(nodes.size()) != header.numNodes
+      || static_cast<uint32_t>(subtrees.size()) != header.numSubtrees) {
+    return false;
+  }
+
+  const int numNodes{nodes.size()};
+  const int numParts{static_cast<int>(counts.numPartTriangles.size())};
+  for (int i = 0; i < numNodes; ++i) {
+    const auto &node{nodes[i]};
+    if (node.isLeafNode()) {
+      const int part{node.getPartId()};
+      if (part < 0 || part >= numParts) return false;
+      const int triangle{node.getTriangleIndex()};
+      if (triangle < 0 || triangle >= counts.numPartTriangles[part]) {
+        return false;
+      }
+    } else {
+      const int escape{node.getEscapeIndex()};
+      if (escape <= 0 || escape > numNodes - i) return false;
+    }
+  }
+
+  for (int i = 0; i < subtrees.size(); ++i) {
+    const auto &subtree{subtrees[i]};
+    if (subtree.m_rootNodeIndex < 0 || subtree.m_subtreeSize < 0
+        || subtree.m_rootNodeIndex > numNodes - subtree.m_subtreeSize) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+void BvhCache::setDirectory(const std::string &directory) {
+  std::filesystem::path path{directory};
+  if (!path.empty()) {
+    std::error_code ec{};
+    std::filesystem::create_directories(path, ec);
+    if (ec) path.clear();
+  }
+
+  std::scoped_lock lock{getDirectoryMutex()};
+  getDirectory() = std::move(path);
+}
+
+bool BvhCache::isEnabled() {
+  std::scoped_lock lock{getDirectoryMutex()};
+  return !getDirectory().empty();
+}
+
+uint64_t BvhCache::getChecksum(const btStridingMeshInterface &mesh) {
+  uint64_t hash{0xcbf29ce484222325ull};
+
+  const int numParts{mesh.getNumSubParts()};
+  hash = Ogre::fnv1a(hash, numParts);
+  for (int i = 0; i < numParts; ++i) {
+    const unsigned char *vertexBase{};
+    int numVerts{};
+    PHY_ScalarType vertexType{};
+    int vertexStride{};
+    const unsigned char *indexBase{};
+    int indexStride{};
+    int numFaces{};
+    PHY_ScalarType indexType{};
+    mesh.getLockedReadOnlyVertexIndexBase(&vertexBase, numVerts, vertexType,
+                                          vertexStride, &indexBase, indexStride,
+                                          numFaces, indexType, i);
+
+    hash = Ogre::fnv1a(hash, numVerts);
+    hash = Ogre::fnv1a(hash, numFaces);
+    hash = Ogre::fnv1a(hash, vertexType);
+    hash = Ogre::fnv1a(hash, indexType);
+    hash = Ogre::fnv1a(hash,
+                       gsl::make_span(vertexBase, numVerts * vertexStride));
+    hash = Ogre::fnv1a(hash,
+                       gsl::make_span(indexBase, numFaces * indexStride));
+
+    mesh.unLockReadOnlyVertexBase(i);
+  }
+
+  return hash;
+}
+
+std::unique_ptr<btOptimizedBvh>
+BvhCache::load(uint64_t checksum, const btStridingMeshInterface &mesh) {
+  const auto path{Ogre::getEntryPath(checksum)};
+  if (path.empty()) return nullptr;
+
+  std::ifstream is{path, std::ios::binary};
+  if (!is) return nullptr;
+
+  BvhCacheHeader header{};
+  is.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!is || !header.isCompatibleWith(BvhCacheHeader{}) || header.size == 0u) {
+    return nullptr;
+  }
+
+  const auto counts{Ogre::getMeshCounts(mesh)};
+  if (header.numVertices != counts.numVertices
+      || header.numTriangles != counts.numTriangles) {
+    return nullptr;
+  }
+
+  void *buffer{btAlignedAlloc(header.size, BVH_ALIGNMENT)};
+  if (!buffer) return nullptr;
+  const auto freeBuffer{gsl::finally([buffer]() { btAlignedFree(buffer); })};
+
+  is.read(static_cast<char *>(buffer), header.size);
+  if (!is || is.gcount() != static_cast<std::streamsize>(header.size)) {
+    return nullptr;
+  }
+
+  // Bullet stores the endianness of the serialized BVH with its contents, but
+  // only ever writes native data, so there is nothing to swap.
+  auto *inPlace{btQuantizedBvh::deSerializeInPlace(buffer, header.size, false)};
+  if (!inPlace) return nullptr;
+  // The deserialized object lives at the start of the buffer and does not own
+  // any of the memory that it points to.
+  const auto destroyInPlace{gsl::finally([inPlace]() {
+    inPlace->~btQuantizedBvh();
+  })};
+
+  if (!Ogre::isValidBvh(*inPlace, header, counts)) return nullptr;
+
+  // The deserialized object is only a btQuantizedBvh, but
+  // btBvhTriangleMeshShape wants a btOptimizedBvh. The latter adds no data
+  // members, so assigning the base copies every node into a BVH of the right
+  // type that owns its memory.
+  auto bvh{std::make_unique<btOptimizedBvh>()};
+  static_cast<btQuantizedBvh &>(*bvh) = *inPlace;
+  return bvh;
+}
+
+void BvhCache::save(uint64_t checksum, const btStridingMeshInterface &mesh,
+                    btOptimizedBvh &bvh) {
+  const auto path{Ogre::getEntryPath(checksum)};
+  if (path.empty()) return;
+
+  const auto counts{Ogre::getMeshCounts(mesh)};
+  BvhCacheHeader header{};
+  header.size = bvh.calculateSerializeBufferSize();
+  header.numVertices = counts.numVertices;
+  header.numTriangles = counts.numTriangles;
+  header.numNodes = static_cast<uint32_t>(bvh.getQuantizedNodeArray().size());
+  header.numSubtrees = static_cast<uint32_t>(bvh.getSubtreeInfoArray().size());
+  if (header.size == 0u) return;
+
+  void *buffer{btAlignedAlloc(header.size, BVH_ALIGNMENT)};
+  if (!buffer) return;
+  const auto freeBuffer{gsl::finally([buffer]() { btAlignedFree(buffer); })};
+
+  if (!bvh.serializeInPlace(buffer, header.size, false)) return;
+
+  // Another thread or process must never see a partially written entry.
+  oo::writeFileAtomically(path, [&](std::ostream &os) {
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os.write(static_cast<const char *>(buffer), header.size);
+  });
+}
+
+} // namespace Ogre
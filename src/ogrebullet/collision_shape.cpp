@@ -1,6 +1,7 @@
 #include "ogrebullet/collision_shape.hpp"
 #include <btBulletDynamicsCommon.h>
 #include <OgreResourceGroupManager.h>
+#include <gsl/gsl>
 
 namespace Ogre {
 
@@ -60,9 +61,50 @@ void CollisionShape::loadImpl() {
               "CollisionShape::load()");
 }
 
+btCollisionShape *
+CollisionShape::getScaledCollisionShape(const btVector3 &scale) {
+  std::scoped_lock lock{mScaledShapesMutex};
+
+  const std::array<btScalar, 3> key{scale.x(), scale.y(), scale.z()};
+  if (auto it{mScaledShapes.find(key)}; it != mScaledShapes.end()) {
+    return it->second.get();
+  }
+
+  btCollisionShape *base{mCollisionShape.get()};
+  BulletCollisionShapePtr scaled{};
+
+  // We can't copy the base in general
+  if (auto *triMesh{dynamic_cast<btBvhTriangleMeshShape *>(base)}) {
+    // Bullet Bug(?): btScaledBvhTriangleMeshShape stores a non-const pointer
+    //                though it only needs a const one.
+    scaled = std::make_unique<btScaledBvhTriangleMeshShape>(triMesh, scale);
+  } else if (auto *convexHull{dynamic_cast<const btConvexHullShape *>(base)}) {
+    auto copy{std::make_unique<btConvexHullShape>()};
+    auto points{gsl::make_span(convexHull->getUnscaledPoints(),
+                               convexHull->getNumPoints())};
+    const btMatrix3x3 transform{scale.x(), 0.0f, 0.0f,
+                                0.0f, scale.y(), 0.0f,
+                                0.0f, 0.0f, scale.z()};
+    for (const auto &point : points) copy->addPoint(transform * point, false);
+    copy->recalcLocalAabb();
+    scaled = std::move(copy);
+  } else {
+    // TODO: Scale other collision shapes
+    return nullptr;
+  }
+
+  return mScaledShapes.emplace(key, std::move(scaled)).first->second.get();
+}
+
 void CollisionShape::unloadImpl() {
   mInfo.reset();
+  {
+    std::scoped_lock lock{mScaledShapesMutex};
+    mScaledShapes.clear();
+  }
   mCollisionShape.reset();
+  mIndirectShapes.clear();
+  mOptimizedBvh.reset();
   mIndexBuffer.clear();
   mIndexBuffer.shrink_to_fit();
   mVertexBuffer.clear();
@@ -94,6 +136,11 @@ void CollisionShape::_setMeshInterface(
   mMeshInterface = std::move(mesh);
 }
 
+void CollisionShape::_setOptimizedBvh(
+    std::unique_ptr<btOptimizedBvh> bvh) noexcept {
+  mOptimizedBvh = std::move(bvh);
+}
+
 std::vector<uint16_t> &CollisionShape::_getIndexBuffer() noexcept {
   return mIndexBuffer;
 }
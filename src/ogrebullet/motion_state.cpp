@@ -13,6 +13,7 @@ MotionState::MotionState(MotionState &&other) noexcept {
   swap(other.mNode, mNode);
   swap(other.mPosition, mPosition);
   swap(other.mOrientation, mOrientation);
+  swap(other.mDirty, mDirty);
   // other.mNode should be nullptr as this->mNode has been default initialized
   // to nullptr already, but just to be sure
   other.mNode = nullptr;
@@ -33,13 +34,20 @@ void MotionState::getWorldTransform(btTransform &worldTrans) const {
 void MotionState::setWorldTransform(const btTransform &worldTrans) {
   mPosition = Ogre::fromBullet(worldTrans.getOrigin());
   mOrientation = Ogre::fromBullet(worldTrans.getRotation());
-  mNode->_setDerivedPosition(mPosition);
-  mNode->_setDerivedOrientation(mOrientation);
+  mDirty = true;
 }
 
 void MotionState::notify() {
   mPosition = mNode->_getDerivedPosition();
   mOrientation = mNode->_getDerivedOrientation();
+  mDirty = false;
+}
+
+void MotionState::publish() {
+  if (!mDirty) return;
+  mNode->_setDerivedPosition(mPosition);
+  mNode->_setDerivedOrientation(mOrientation);
+  mDirty = false;
 }
 
 } // namespace Ogre
@@ -188,38 +188,17 @@ void RigidBody::notify() {
 }
 
 void RigidBody::setScale(const Vector3 &scale) {
-  const auto localScale{Ogre::toBullet(scale)};
-
-  if (mCollisionShapeOverride) {
-    mCollisionShapeOverride->setLocalScaling(localScale);
+  if (scale == Vector3::UNIT_SCALE) {
+    mScaledCollisionShape = nullptr;
+    mRigidBody->setCollisionShape(mCollisionShape->_getCollisionShape());
     return;
   }
 
-  btCollisionShape *base{mCollisionShape->_getCollisionShape()};
-
-  // We can't copy the base in general
-  if (auto *triMesh{dynamic_cast<btBvhTriangleMeshShape *>(base)}) {
-    // Bullet Bug(?): btScaledBvhTriangleMeshShape stores a non-const pointer
-    //                though it only needs a const one.
-    mCollisionShapeOverride =
-        std::make_unique<btScaledBvhTriangleMeshShape>(triMesh, localScale);
-  } else if (auto *convexHull{dynamic_cast<const btConvexHullShape *>(base)}) {
-    auto override{std::make_unique<btConvexHullShape>()};
-    auto points{gsl::make_span(convexHull->getUnscaledPoints(),
-                               convexHull->getNumPoints())};
-    const btMatrix3x3 transform{localScale.x(), 0.0f, 0.0f,
-                                0.0f, localScale.y(), 0.0f,
-                                0.0f, 0.0f, localScale.z()};
-    for (const auto &point : points) override->addPoint(transform * point);
-
-    mCollisionShapeOverride = std::move(override);
-  } else {
-    // TODO: Scale other collision shapes
-  }
+  auto *shape{mCollisionShape->getScaledCollisionShape(Ogre::toBullet(scale))};
+  if (!shape || shape == mScaledCollisionShape) return;
 
-  if (mCollisionShapeOverride) {
-    mRigidBody->setCollisionShape(mCollisionShapeOverride.get());
-  }
+  mScaledCollisionShape = shape;
+  mRigidBody->setCollisionShape(mScaledCollisionShape);
 }
 
 void RigidBodyFactory::destroyInstance(gsl::owner<MovableObject *> obj) {
@@ -1,12 +1,18 @@
+#include "config/game_settings.hpp"
 #include "esp/esp.hpp"
+#include "job/upload_queue.hpp"
 #include "math/conversions.hpp"
 #include "nifloader/animation.hpp"
 #include "nifloader/scene.hpp"
 #include "resolvers/cell_resolver.hpp"
+#include "nifloader/nif_resource_manager.hpp"
+#include "scripting/script_scheduler.hpp"
 #include <OgreRoot.h>
 #include <OgreSceneNode.h>
 #include <spdlog/fmt/ostr.h>
+#include <map>
 #include <mutex>
+#include <set>
 
 namespace oo {
 
@@ -14,6 +20,7 @@ Resolver<record::CELL, oo::BaseId>::Resolver(Resolver &&other) noexcept
     : mBulletConf(other.mBulletConf) {
   std::scoped_lock lock{other.mMtx};
   mRecords = std::move(other.mRecords);
+  mChanges = std::move(other.mChanges);
 }
 
 CellResolver &
@@ -23,6 +30,7 @@ Resolver<record::CELL, oo::BaseId>::operator=(Resolver &&other) noexcept {
     std::scoped_lock lock{mMtx, other.mMtx};
     using std::swap;
     swap(mRecords, other.mRecords);
+    swap(mChanges, other.mChanges);
   }
 
   return *this;
@@ -35,7 +43,7 @@ CellResolver::insertOrAppend(oo::BaseId baseId,
                              bool isExterior) {
   std::scoped_lock lock{mMtx};
   RecordEntry entry{std::make_pair(rec, tl::nullopt)};
-  Metadata meta{0, isExterior, {accessor}, {}, tl::nullopt};
+  Metadata meta{0, isExterior, {accessor}, {}, tl::nullopt, {}};
   auto[it, inserted]{mRecords.try_emplace(baseId, entry, meta)};
   if (inserted) return {it, inserted};
 
@@ -74,6 +82,7 @@ void CellResolver::setDetachTime(oo::BaseId baseId, int detachTime) {
   auto it{mRecords.find(baseId)};
   if (it == mRecords.end()) return;
   it->second.second.mDetachTime = detachTime;
+  mChanges.try_emplace(baseId);
 }
 
 int CellResolver::getDetachTime(oo::BaseId baseId) const {
@@ -138,6 +147,38 @@ void CellResolver::insertReferenceRecord(oo::BaseId cellId, oo::RefId refId) {
   it->second.second.mReferences.insert(refId);
 }
 
+void CellResolver::setReferenceEnabled(oo::BaseId cellId, oo::RefId refId,
+                                       bool enabled) {
+  std::scoped_lock lock{mMtx};
+  auto it{mRecords.find(cellId)};
+  if (it == mRecords.end()) return;
+  it->second.second.mEnabledReferences.insert_or_assign(refId, enabled);
+  mChanges[cellId].flags |= CHANGE_REFERENCES_ENABLED;
+}
+
+tl::optional<bool>
+CellResolver::isReferenceEnabled(oo::BaseId cellId, oo::RefId refId) const {
+  std::scoped_lock lock{mMtx};
+  auto it{mRecords.find(cellId)};
+  if (it == mRecords.end()) return tl::nullopt;
+  const auto &enabledRefs{it->second.second.mEnabledReferences};
+  auto jt{enabledRefs.find(refId)};
+  if (jt == enabledRefs.end()) return tl::nullopt;
+  return jt->second;
+}
+
+void CellResolver::markChanged(oo::BaseId baseId, uint32_t flags) {
+  std::scoped_lock lock{mMtx};
+  if (mRecords.find(baseId) == mRecords.end()) return;
+  mChanges[baseId].flags |= flags;
+}
+
+std::vector<std::pair<oo::BaseId, CellResolver::Change>>
+CellResolver::getChanges() const {
+  std::scoped_lock lock{mMtx};
+  return {mChanges.begin(), mChanges.end()};
+}
+
 template<> void
 CellResolver::CellVisitor::readRecord<record::REFR>(oo::EspAccessor &accessor) {
   const BaseId baseId{accessor.peekBaseId()};
@@ -267,7 +308,9 @@ void Cell::showNode(gsl::not_null<Ogre::SceneNode *> root) {
   root->setVisible(true, /*cascade=*/false);
   auto &objects{root->getAttachedObjects()};
   for (Ogre::MovableObject *obj : objects) {
-    if (auto *rigidBody{dynamic_cast<Ogre::RigidBody *>(obj)}) {
+    auto *rigidBody{dynamic_cast<Ogre::RigidBody *>(obj)};
+    //C++20: if (rigidBody && !mMergedRigidBodies.contains(rigidBody)) {
+    if (rigidBody && mMergedRigidBodies.count(rigidBody) == 0) {
       bullet::addRigidBody(getPhysicsWorld(), gsl::make_not_null(rigidBody));
     }
   }
@@ -277,40 +320,336 @@ void Cell::hideNode(gsl::not_null<Ogre::SceneNode *> root) {
   root->setVisible(false, /*cascade=*/false);
   auto &objects{root->getAttachedObjects()};
   for (Ogre::MovableObject *obj : objects) {
-    if (auto *rigidBody{dynamic_cast<Ogre::RigidBody *>(obj)}) {
+    auto *rigidBody{dynamic_cast<Ogre::RigidBody *>(obj)};
+    //C++20: if (rigidBody && !mMergedRigidBodies.contains(rigidBody)) {
+    if (rigidBody && mMergedRigidBodies.count(rigidBody) == 0) {
       bullet::removeRigidBody(getPhysicsWorld(), gsl::make_not_null(rigidBody));
     }
   }
 }
 
-void Cell::setVisible(bool visible) {
-  if (visible == isVisible()) return;
+void Cell::setTreeVisible(gsl::not_null<Ogre::SceneNode *> root,
+                          bool visible) {
+  // Disabled references stay hidden regardless of the visibility of the cell.
+  std::set<Ogre::SceneNode *> skip{};
+  if (visible) {
+    for (auto refId : mDisabledReferences) {
+      if (auto *node{getReferenceNode(refId)}) skip.insert(node);
+    }
+  }
 
-  std::function<void(Ogre::SceneNode *)> show = [&](Ogre::SceneNode *root) {
-    showNode(gsl::make_not_null(root));
-    for (Ogre::Node *node : root->getChildren()) {
-      show(static_cast<Ogre::SceneNode *>(node));
+  std::function<void(Ogre::SceneNode *)> show = [&](Ogre::SceneNode *node) {
+    //C++20: if (skip.contains(node)) return;
+    if (skip.count(node) > 0) return;
+    showNode(gsl::make_not_null(node));
+    for (Ogre::Node *child : node->getChildren()) {
+      show(static_cast<Ogre::SceneNode *>(child));
     }
   };
 
-  std::function<void(Ogre::SceneNode *)> hide = [&](Ogre::SceneNode *root) {
-    hideNode(gsl::make_not_null(root));
-    for (Ogre::Node *node : root->getChildren()) {
-      hide(static_cast<Ogre::SceneNode *>(node));
+  std::function<void(Ogre::SceneNode *)> hide = [&](Ogre::SceneNode *node) {
+    hideNode(gsl::make_not_null(node));
+    for (Ogre::Node *child : node->getChildren()) {
+      hide(static_cast<Ogre::SceneNode *>(child));
     }
   };
 
-  if (visible) {
-    mIsVisible = true;
-    show(getRootSceneNode());
-    setVisibleImpl(true);
-  } else {
-    mIsVisible = false;
-    hide(getRootSceneNode());
-    setVisibleImpl(false);
+  if (visible) show(root);
+  else hide(root);
+}
+
+Ogre::SceneNode *Cell::getReferenceNode(oo::RefId refId) const {
+  // Can't use getChild() since that throws.
+  const std::string name{refId.string()};
+  for (Ogre::Node *child : getRootSceneNode()->getChildren()) {
+    if (child->getName() == name) return static_cast<Ogre::SceneNode *>(child);
+  }
+  return nullptr;
+}
+
+void Cell::setVisible(bool visible) {
+  if (visible == isVisible()) return;
+
+  if (!visible) setScriptsAttached(false);
+  mIsVisible = visible;
+  if (visible) setScriptsAttached(true);
+  setTreeVisible(getRootSceneNode(), visible);
+  // Instanced geometry is shared with other cells so is not attached to the
+  // root node of this cell, and must be hidden separately.
+  for (auto refId : mInstancedReferences) updateInstancedReference(refId);
+  if (mStaticCollision) mStaticCollision->setEnabled(visible);
+  setVisibleImpl(visible);
+}
+
+void Cell::setReferenceEnabled(oo::RefId refId, bool enabled) {
+  if (enabled == isReferenceEnabled(refId)) return;
+
+  if (enabled) mDisabledReferences.erase(refId);
+  else mDisabledReferences.insert(refId);
+  if (mResolver) mResolver->setReferenceEnabled(getBaseId(), refId, enabled);
+
+  if (isVisible()) setReferenceScriptAttached(refId, enabled);
+
+  if (mStaticBatch) {
+    const auto formId{static_cast<oo::FormId>(refId)};
+    mStaticBatch->setOwnerEnabled(formId, enabled);
+  }
+  if (mStaticCollision) {
+    const auto formId{static_cast<oo::FormId>(refId)};
+    mStaticCollision->setOwnerEnabled(formId, enabled);
+  }
+  updateInstancedReference(refId);
+
+  // If the cell is hidden then the reference will be shown or hidden along
+  // with the cell.
+  if (!isVisible()) return;
+  if (auto *node{getReferenceNode(refId)}) {
+    setTreeVisible(gsl::make_not_null(node), enabled);
   }
 }
 
+bool Cell::isReferenceEnabled(oo::RefId refId) const noexcept {
+  //C++20: return !mDisabledReferences.contains(refId);
+  return mDisabledReferences.find(refId) == mDisabledReferences.end();
+}
+
+void Cell::setScriptScheduler(oo::ScriptScheduler *scheduler) {
+  if (scheduler == mScriptScheduler) return;
+
+  setScriptsAttached(false);
+  mScriptScheduler = scheduler;
+  setScriptsAttached(true);
+}
+
+void Cell::setResolver(oo::CellResolver *resolver) noexcept {
+  mResolver = resolver;
+}
+
+void Cell::addReferenceScript(oo::RefId refId, oo::BaseId scriptId) {
+  mReferenceScripts.insert_or_assign(refId, scriptId);
+  if (isVisible() && isReferenceEnabled(refId)) {
+    setReferenceScriptAttached(refId, true);
+  }
+}
+
+void Cell::setReferenceScriptAttached(oo::RefId refId, bool attached) {
+  if (!mScriptScheduler) return;
+
+  auto it{mReferenceScripts.find(refId)};
+  if (it == mReferenceScripts.end()) return;
+
+  const auto scriptName{it->second.string()};
+  const auto ref{static_cast<oo::FormId>(refId)};
+  if (attached) mScriptScheduler->attach(scriptName, ref);
+  else mScriptScheduler->detach(scriptName, ref);
+}
+
+void Cell::setScriptsAttached(bool attached) {
+  if (!mScriptScheduler || !isVisible()) return;
+
+  for (const auto &[refId, scriptId] : mReferenceScripts) {
+    if (isReferenceEnabled(refId)) setReferenceScriptAttached(refId, attached);
+  }
+}
+
+void Cell::batchStaticGeometry(const std::vector<oo::RefId> &refIds) {
+  auto *root{getRootSceneNode().get()};
+
+  if (!mStaticBatch) {
+    mStaticBatch = static_cast<oo::StaticBatch *>(
+        getSceneManager()->createMovableObject(
+            getBaseId().string() + "/StaticBatch",
+            oo::StaticBatchFactory::FACTORY_TYPE_NAME));
+    root->attachObject(mStaticBatch);
+  }
+
+  // The batch lives in the local space of the cell's root node.
+  const Ogre::Affine3 rootInverse{root->_getFullTransform().inverse()};
+  std::size_t numBatched{0u};
+
+  std::function<void(Ogre::SceneNode *, oo::FormId)> dfs =
+      [&](Ogre::SceneNode *node, oo::FormId owner) {
+        for (Ogre::MovableObject *obj : node->getAttachedObjects()) {
+          auto *entity{dynamic_cast<oo::Entity *>(obj)};
+          if (!entity) continue;
+          // Entities with no visibility flags are already being drawn by the
+          // instanced geometry.
+          if (entity->getVisibilityFlags() == 0u) continue;
+
+          const auto xform{rootInverse * entity->_getParentNodeFullTransform()};
+          if (!mStaticBatch->addEntity(*entity, xform, owner)) continue;
+
+          // Don't use setVisible(false) since showing the node would make the
+          // entity visible again; no viewport will ever match these flags.
+          entity->setVisibilityFlags(0u);
+          ++numBatched;
+        }
+
+        for (Ogre::Node *child : node->getChildren()) {
+          dfs(static_cast<Ogre::SceneNode *>(child), owner);
+        }
+      };
+
+  for (auto refId : refIds) {
+    if (auto *node{getReferenceNode(refId)}) {
+      const auto formId{static_cast<oo::FormId>(refId)};
+      dfs(node, formId);
+      mStaticBatch->setOwnerEnabled(formId, isReferenceEnabled(refId));
+    }
+  }
+
+  mStaticBatch->build();
+  spdlog::get(oo::LOG)->info("CELL {}: Batched {} entities into {} batches",
+                             getBaseId(), numBatched,
+                             mStaticBatch->getNumBatches());
+}
+
+void Cell::instanceStaticGeometry(const std::vector<oo::RefId> &refIds,
+                                  std::size_t threshold) {
+  // Find every entity that could be instanced, and how often each mesh is used.
+  std::vector<std::pair<oo::Entity *, oo::RefId>> candidates{};
+  std::map<const oo::Mesh *, std::size_t> meshCounts{};
+
+  std::function<void(Ogre::SceneNode *, oo::RefId)> dfs =
+      [&](Ogre::SceneNode *node, oo::RefId refId) {
+        for (Ogre::MovableObject *obj : node->getAttachedObjects()) {
+          auto *entity{dynamic_cast<oo::Entity *>(obj)};
+          if (!entity || !oo::InstancedGeometry::isInstanceable(*entity)) {
+            continue;
+          }
+
+          candidates.emplace_back(entity, refId);
+          ++meshCounts[entity->getMesh().get()];
+        }
+
+        for (Ogre::Node *child : node->getChildren()) {
+          dfs(static_cast<Ogre::SceneNode *>(child), refId);
+        }
+      };
+
+  for (auto refId : refIds) {
+    if (auto *node{getReferenceNode(refId)}) dfs(node, refId);
+  }
+
+  if (candidates.empty()) return;
+
+  auto scnMgr{getSceneManager()};
+  if (!mInstancedGeometry) {
+    const auto type{oo::InstancedGeometryFactory::FACTORY_TYPE_NAME};
+    if (scnMgr->hasMovableObject(INSTANCED_GEOMETRY_NAME, type)) {
+      mInstancedGeometry = static_cast<oo::InstancedGeometry *>(
+          scnMgr->getMovableObject(INSTANCED_GEOMETRY_NAME, type));
+    } else {
+      mInstancedGeometry = static_cast<oo::InstancedGeometry *>(
+          scnMgr->createMovableObject(INSTANCED_GEOMETRY_NAME, type));
+      scnMgr->getRootSceneNode()->attachObject(mInstancedGeometry);
+    }
+  }
+
+  // Decide which meshes to instance up front, otherwise whether a mesh is
+  // already instanced would depend on the order of the references.
+  std::set<const oo::Mesh *> instancedMeshes{};
+  for (const auto &[mesh, count] : meshCounts) {
+    if (count >= threshold || mInstancedGeometry->hasMesh(*mesh)) {
+      instancedMeshes.insert(mesh);
+    }
+  }
+
+  auto *parent{mInstancedGeometry->getParentSceneNode()};
+  const Ogre::Affine3 parentInverse{parent->_getFullTransform().inverse()};
+  std::size_t numInstanced{0u};
+
+  for (const auto &[entity, refId] : candidates) {
+    //C++20: if (!instancedMeshes.contains(entity->getMesh().get())) continue;
+    if (instancedMeshes.count(entity->getMesh().get()) == 0) continue;
+
+    const auto formId{static_cast<oo::FormId>(refId)};
+    const auto xform{parentInverse * entity->_getParentNodeFullTransform()};
+    if (!mInstancedGeometry->addEntity(*entity, xform, formId)) continue;
+
+    // As with batching, hide the entity without using setVisible(false).
+    entity->setVisibilityFlags(0u);
+    mInstancedReferences.insert(refId);
+    ++numInstanced;
+  }
+
+  for (auto refId : mInstancedReferences) updateInstancedReference(refId);
+
+  spdlog::get(oo::LOG)->info("CELL {}: Instanced {} entities using {} meshes",
+                             getBaseId(), numInstanced, instancedMeshes.size());
+}
+
+void Cell::mergeStaticCollision(const std::vector<oo::RefId> &refIds) {
+  if (!mStaticCollision) {
+    mStaticCollision = std::make_unique<bullet::StaticCollision>(
+        getPhysicsWorld());
+  }
+
+  std::function<void(Ogre::SceneNode *, oo::FormId)> dfs =
+      [&](Ogre::SceneNode *node, oo::FormId owner) {
+        for (Ogre::MovableObject *obj : node->getAttachedObjects()) {
+          auto *rigidBody{dynamic_cast<Ogre::RigidBody *>(obj)};
+          if (!rigidBody) continue;
+          //C++20: if (mMergedRigidBodies.contains(rigidBody)) continue;
+          if (mMergedRigidBodies.count(rigidBody) > 0) continue;
+          if (!mStaticCollision->addRigidBody(*rigidBody, owner)) continue;
+
+          // The body is only in the world if it is currently shown.
+          bullet::removeRigidBody(getPhysicsWorld(),
+                                  gsl::make_not_null(rigidBody));
+          mMergedRigidBodies.insert(rigidBody);
+        }
+
+        for (Ogre::Node *child : node->getChildren()) {
+          dfs(static_cast<Ogre::SceneNode *>(child), owner);
+        }
+      };
+
+  for (auto refId : refIds) {
+    if (auto *node{getReferenceNode(refId)}) {
+      const auto formId{static_cast<oo::FormId>(refId)};
+      dfs(node, formId);
+      mStaticCollision->setOwnerEnabled(formId, isReferenceEnabled(refId));
+    }
+  }
+
+  mStaticCollision->build();
+  mStaticCollision->setEnabled(isVisible());
+  spdlog::get(oo::LOG)->info("CELL {}: Merged {} rigid bodies into {} "
+                             "collision objects", getBaseId(),
+                             mStaticCollision->getNumBodies(),
+                             mStaticCollision->getNumObjects());
+}
+
+void Cell::updateStaticCollision() {
+  if (mStaticCollision) mStaticCollision->update();
+}
+
+void Cell::updateInstancedReference(oo::RefId refId) {
+  if (!mInstancedGeometry) return;
+  //C++20: if (!mInstancedReferences.contains(refId)) return;
+  if (mInstancedReferences.count(refId) == 0) return;
+
+  const auto formId{static_cast<oo::FormId>(refId)};
+  const bool enabled{isVisible() && isReferenceEnabled(refId)};
+  mInstancedGeometry->setOwnerEnabled(formId, enabled);
+}
+
+void Cell::releaseInstancedGeometry() {
+  if (!mInstancedGeometry) return;
+
+  for (auto refId : mInstancedReferences) {
+    mInstancedGeometry->removeOwner(static_cast<oo::FormId>(refId));
+  }
+
+  mInstancedReferences.clear();
+  mInstancedGeometry = nullptr;
+}
+
+void Cell::releaseStaticCollision() {
+  mStaticCollision.reset();
+}
+
 InteriorCell::InteriorCell(oo::BaseId baseId, std::string name,
                            std::unique_ptr<PhysicsWorld> physicsWorld)
     : Cell(baseId, std::move(name)),
@@ -336,6 +675,7 @@ std::vector<std::unique_ptr<oo::Character>> &InteriorCell::getCharacters() {
 
 InteriorCell::~InteriorCell() {
   mCharacters.clear();
+  releaseStaticCollision();
   // Destruct physics world to unregister all existing rigid bodies and free
   // their broadphase proxies, while they are still alive.
   mPhysicsWorld.reset();
@@ -356,12 +696,16 @@ ExteriorCell::ExteriorCell(oo::BaseId baseId, std::string name,
               getBaseId().string()))) {}
 
 ExteriorCell::~ExteriorCell() {
+  // Showing the cell below should not run the scripts of its references.
+  setScriptScheduler(nullptr);
   // TODO: If the cell is hidden then rigid bodies have already been removed so
   //       destroyMovableObjects cannot be used; we can improve performance by
   //       changing destroyMovableObjects instead of showing the cell before
   //       destruction then removing its terrain collision object (which is
   //       re-added by setVisible if previously removed).
   setVisible(true);
+  releaseInstancedGeometry();
+  releaseStaticCollision();
   if (mTerrainCollisionObject) {
     mPhysicsWorld->removeCollisionObject(mTerrainCollisionObject.get());
   }
@@ -537,31 +881,162 @@ populateCell(std::shared_ptr<oo::Cell> cell, const record::CELL &refRec,
   const auto &refrFurnRes{oo::getRefrResolver<record::REFR_FURN>(resolvers)};
   const auto &refrNpc_Res{oo::getRefrResolver<record::REFR_NPC_>(resolvers)};
 
+  // Static references that are candidates for batching.
+  std::vector<oo::RefId> staticRefs{};
+  // References that start disabled, usually to be enabled later by a script.
+  std::vector<oo::RefId> disabledRefs{};
+  const oo::BaseId cellId{refRec.mFormId};
+
   for (auto refId : *refs) {
+    const auto attach = [&](const auto &ref, auto res) {
+      cell->attach(ref, res);
+      // A reference enabled or disabled since the game started stays that
+      // way, otherwise it starts as its record flags say.
+      using record::RecordFlag;
+      const bool initiallyDisabled{
+          (ref.mRecordFlags & RecordFlag::InitiallyDisabled)
+              != RecordFlag::None};
+      const auto enabled{cellRes.isReferenceEnabled(cellId, refId)};
+      if (!enabled.value_or(!initiallyDisabled)) disabledRefs.push_back(refId);
+    };
+
     if (auto acti{refrActiRes.get(refId)}; acti) {
-      cell->attach(*acti, std::forward_as_tuple(actiRes));
+      attach(*acti, std::forward_as_tuple(actiRes));
     } else if (auto cont{refrContRes.get(refId)}; cont) {
-      cell->attach(*cont, std::forward_as_tuple(contRes));
+      attach(*cont, std::forward_as_tuple(contRes));
     } else if (auto door{refrDoorRes.get(refId)}; door) {
-      cell->attach(*door, std::forward_as_tuple(doorRes));
+      attach(*door, std::forward_as_tuple(doorRes));
     } else if (auto ligh{refrLighRes.get(refId)}; ligh) {
-      cell->attach(*ligh, std::forward_as_tuple(lighRes));
+      attach(*ligh, std::forward_as_tuple(lighRes));
     } else if (auto misc{refrMiscRes.get(refId)}; misc) {
-      cell->attach(*misc, std::forward_as_tuple(miscRes));
+      attach(*misc, std::forward_as_tuple(miscRes));
     } else if (auto stat{refrStatRes.get(refId)}; stat) {
-      cell->attach(*stat, std::forward_as_tuple(statRes));
+      attach(*stat, std::forward_as_tuple(statRes));
+      staticRefs.push_back(refId);
     } else if (auto flor{refrFlorRes.get(refId)}; flor) {
-      cell->attach(*flor, std::forward_as_tuple(florRes));
+      attach(*flor, std::forward_as_tuple(florRes));
     } else if (auto furn{refrFurnRes.get(refId)}; furn) {
-      cell->attach(*furn, std::forward_as_tuple(furnRes));
+      attach(*furn, std::forward_as_tuple(furnRes));
     } else if (auto npc{refrNpc_Res.get(refId)}; npc) {
-      cell->attach(*npc, std::forward_as_tuple(npc_Res, raceRes));
+      attach(*npc, std::forward_as_tuple(npc_Res, raceRes));
     }
   }
 
+  // Disable the references before their geometry is merged, so that it is
+  // merged without them.
+  for (auto refId : disabledRefs) cell->setReferenceEnabled(refId, false);
+
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  if (gameSettings.get("Display.bUseInstancing", true)) {
+    const auto threshold{
+        gameSettings.get<unsigned>("Display.uInstancingThreshold", 4u)};
+    cell->instanceStaticGeometry(staticRefs, threshold);
+  }
+
+  const bool isExterior{dynamic_cast<oo::ExteriorCell *>(cell.get())};
+  if (isExterior && gameSettings.get("Display.bBatchStaticGeometry", true)) {
+    cell->batchStaticGeometry(staticRefs);
+  }
+
+  if (gameSettings.get("General.bMergeStaticCollision", true)) {
+    cell->mergeStaticCollision(staticRefs);
+  }
+
   return cell;
 }
 
+void prepareCell(const record::CELL &refRec,
+                 ReifyRecordImpl<record::CELL>::resolvers resolvers) {
+  const auto &gameSettings{oo::GameSettings::getSingleton()};
+  if (!gameSettings.get("General.bPrepareModelsInBackground", true)) return;
+
+  const auto &cellRes{std::get<const oo::Resolver<record::CELL> &>(resolvers)};
+  const auto refs{cellRes.getReferences(BaseId{refRec.mFormId})};
+  if (!refs) return;
+
+  // Models of the references, without duplicates.
+  std::set<std::string> names{};
+
+  // Add the model of the reference refId to the names if it is a reference to
+  // a base record in baseRes, returning whether it is.
+  auto addModel = [&](const auto &refrRes, const auto &baseRes,
+                      oo::RefId refId) -> bool {
+    const auto ref{refrRes.get(refId)};
+    if (!ref) return false;
+    if (auto baseRec{baseRes.get(ref->baseId.data)}; baseRec) {
+      if (auto name{oo::getModelPath(*baseRec)}; name) {
+        names.emplace(name->c_str());
+      }
+    }
+    return true;
+  };
+
+  const auto &actiRes{oo::getResolver<record::ACTI>(resolvers)};
+  const auto &contRes{oo::getResolver<record::CONT>(resolvers)};
+  const auto &doorRes{oo::getResolver<record::DOOR>(resolvers)};
+  const auto &lighRes{oo::getResolver<record::LIGH>(resolvers)};
+  const auto &miscRes{oo::getResolver<record::MISC>(resolvers)};
+  const auto &statRes{oo::getResolver<record::STAT>(resolvers)};
+  const auto &florRes{oo::getResolver<record::FLOR>(resolvers)};
+  const auto &furnRes{oo::getResolver<record::FURN>(resolvers)};
+
+  const auto &refrActiRes{oo::getRefrResolver<record::REFR_ACTI>(resolvers)};
+  const auto &refrContRes{oo::getRefrResolver<record::REFR_CONT>(resolvers)};
+  const auto &refrDoorRes{oo::getRefrResolver<record::REFR_DOOR>(resolvers)};
+  const auto &refrLighRes{oo::getRefrResolver<record::REFR_LIGH>(resolvers)};
+  const auto &refrMiscRes{oo::getRefrResolver<record::REFR_MISC>(resolvers)};
+  const auto &refrStatRes{oo::getRefrResolver<record::REFR_STAT>(resolvers)};
+  const auto &refrFlorRes{oo::getRefrResolver<record::REFR_FLOR>(resolvers)};
+  const auto &refrFurnRes{oo::getRefrResolver<record::REFR_FURN>(resolvers)};
+
+  // NPCs are skipped because their models depend on their race and equipment.
+  for (auto refId : *refs) {
+    addModel(refrActiRes, actiRes, refId)
+        || addModel(refrContRes, contRes, refId)
+        || addModel(refrDoorRes, doorRes, refId)
+        || addModel(refrLighRes, lighRes, refId)
+        || addModel(refrMiscRes, miscRes, refId)
+        || addModel(refrStatRes, statRes, refId)
+        || addModel(refrFlorRes, florRes, refId)
+        || addModel(refrFurnRes, furnRes, refId);
+  }
+
+  auto &nifMgr{oo::NifResourceManager::getSingleton()};
+  auto logger{spdlog::get(oo::LOG)};
+  oo::JobCounter uploaded{static_cast<int>(names.size())};
+
+  // Parsing is done on this fiber instead of in separate jobs, since waiting on
+  // worker jobs from a worker job can exhaust the fibers available to run them.
+  // Each upload is queued as soon as its model is ready, so the render thread
+  // can upload one model while the next is being parsed.
+  for (const auto &name : names) {
+    try {
+      auto nifPtr{nifMgr.getByName(name, oo::RESOURCE_GROUP)};
+      if (!nifPtr) {
+        logger->warn("Cannot prepare {}, it does not exist", name);
+        uploaded.decrement();
+        continue;
+      }
+      // This is a worker thread, so it is worth generating levels of detail.
+      nifPtr->prepare(true);
+      // Copy the block graph here so that the render thread doesn't have to.
+      auto g{std::make_shared<oo::BlockGraph>(nifPtr->getBlockGraph())};
+      oo::UploadQueue::push([name, g = std::move(g)]() {
+        try {
+          oo::uploadNif(name, oo::RESOURCE_GROUP, *g);
+        } catch (const std::exception &e) {
+          spdlog::get(oo::LOG)->warn("Failed to upload {}: {}", name, e.what());
+        }
+      }, &uploaded);
+    } catch (const std::exception &e) {
+      logger->warn("Failed to prepare {}: {}", name, e.what());
+      uploaded.decrement();
+    }
+  }
+
+  uploaded.wait();
+}
+
 void Cell::setNodeTransform(gsl::not_null<Ogre::SceneNode *> node,
                             const record::raw::REFRTransformation &transform) {
   const auto &data{transform.positionRotation.data};
@@ -24,4 +24,13 @@ void setRefId(gsl::not_null<Ogre::SceneNode *> node, RefId refId) {
   dfs(node);
 }
 
+RefId getRefId(gsl::not_null<const btCollisionObject *> object,
+               int shapePart, int triangleIndex) {
+  using StaticObject = bullet::StaticCollision::Object;
+  if (auto *merged{dynamic_cast<const StaticObject *>(object.get())}) {
+    return RefId{merged->getOwner(shapePart, triangleIndex)};
+  }
+  return RefId{oo::decodeFormId(object->getUserPointer())};
+}
+
 } // namespace oo
@@ -14,6 +14,8 @@
 #include <OgreTextureManager.h>
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
+#include <cmath>
+#include <limits>
 
 namespace oo {
 
@@ -174,6 +176,68 @@ void blitTerrainTextures(Ogre::Terrain *quad,
   quad->_setCompositeMapRequired(true);
 }
 
+ArrayLayers acquireArrayLayers(const Ogre::Terrain *quad) {
+  auto &textureArray{oo::TerrainTextureArray::getSingleton()};
+  ArrayLayers arrayLayers{};
+  arrayLayers.reserve(quad->getLayerCount());
+  for (uint8_t i = 0; i < quad->getLayerCount(); ++i) {
+    arrayLayers.push_back(textureArray.acquireLayer(
+        quad->getLayerTextureName(i, 0), quad->getLayerTextureName(i, 1)));
+  }
+  return arrayLayers;
+}
+
+void writeLayerWeights(Ogre::PixelBox layers,
+                       Ogre::PixelBox weights,
+                       LayerMap &layerMap,
+                       const LayerOrder &layerOrder,
+                       const ArrayLayers &arrayLayers) {
+  constexpr auto vpq{oo::verticesPerQuad<std::size_t>};
+  constexpr std::size_t MAX_VERTEX_LAYERS{4u};
+
+  auto *layersData{static_cast<uint8_t *>(layers.data)};
+  auto *weightsData{static_cast<uint8_t *>(weights.data)};
+  std::fill(layersData, layersData + vpq * vpq * 4u, 0u);
+  std::fill(weightsData, weightsData + vpq * vpq * 4u, 0u);
+
+  const std::size_t numLayers{std::min(layerOrder.size(), arrayLayers.size())};
+  if (numLayers == 0) return;
+
+  std::vector<const QuadrantBlendMap *> blendMaps(numLayers);
+  for (std::size_t i = 1; i < numLayers; ++i) {
+    blendMaps[i] = &layerMap[layerOrder[i]];
+  }
+
+  const std::size_t numKept{std::min(MAX_VERTEX_LAYERS, numLayers)};
+  std::vector<std::pair<float, uint8_t>> vertexWeights(numLayers);
+
+  for (std::size_t v = 0; v < vpq * vpq; ++v) {
+    // Each layer is drawn over the ones before it, so whatever of a layer is
+    // not covered by the layers after it shows through.
+    float remaining{1.0f};
+    for (std::size_t i = numLayers - 1u; i > 0; --i) {
+      const float opacity{(*blendMaps[i])[v] / 255.0f};
+      vertexWeights[i] = {opacity * remaining, arrayLayers[i]};
+      remaining *= 1.0f - opacity;
+    }
+    vertexWeights[0] = {remaining, arrayLayers[0]};
+
+    std::partial_sort(vertexWeights.begin(), vertexWeights.begin() + numKept,
+                      vertexWeights.end(), std::greater<>{});
+
+    float total{0.0f};
+    for (std::size_t k = 0; k < numKept; ++k) total += vertexWeights[k].first;
+    total = std::max(total, std::numeric_limits<float>::min());
+
+    for (std::size_t k = 0; k < numKept; ++k) {
+      const auto[weight, layer]{vertexWeights[k]};
+      layersData[4u * v + k] = layer;
+      weightsData[4u * v + k] = static_cast<uint8_t>(
+          std::lround(weight / total * 255.0f));
+    }
+  }
+}
+
 void emplaceTerrainTexture(Ogre::StringVector &list, std::string texName) {
   std::string fullName{"textures/landscape/" + std::move(texName)};
   list.emplace_back(fullName);
@@ -287,6 +351,7 @@ World::WorldImpl::WorldImpl(oo::BaseId baseId,
 }
 
 World::WorldImpl::~WorldImpl() {
+  while (!mArrayLayers.empty()) releaseArrayLayers(mArrayLayers.begin()->first);
   mTerrainGroup.removeAllTerrains();
 }
 
@@ -310,13 +375,8 @@ gsl::not_null<World::PhysicsWorld *> World::WorldImpl::getPhysicsWorld() const {
   return gsl::make_not_null(mPhysicsWorld.get());
 }
 
-std::shared_ptr<oo::JobCounter>
-World::WorldImpl::loadTerrain(CellIndex index, bool async) {
-  return async ? loadTerrainAsyncImpl(index) : loadTerrainSyncImpl(index);
-}
-
 void World::WorldImpl::loadTerrain(oo::ExteriorCell &cell) {
-  loadTerrain(cell.getBaseId(), false);
+  loadTerrain(cell.getBaseId());
 
   const auto cellRec{getCell(cell.getBaseId())};
   if (!cellRec) return;
@@ -332,7 +392,7 @@ void World::WorldImpl::unloadTerrain(oo::ExteriorCell &cell) {
   unloadTerrain(cell.getBaseId());
 }
 
-void World::WorldImpl::loadTerrain(oo::BaseId cellId, bool async) {
+void World::WorldImpl::loadTerrain(oo::BaseId cellId) {
   auto logger{spdlog::get(oo::LOG)};
   const auto fiberId{boost::this_fiber::get_id()};
 
@@ -341,26 +401,33 @@ void World::WorldImpl::loadTerrain(oo::BaseId cellId, bool async) {
 
   CellIndex pos{cellRec->grid->data.x, cellRec->grid->data.y};
 
-  if (isTerrainLoaded(pos)) {
-    logger->info("[{}]: CELL {} terrain is already loaded", fiberId, cellId);
-    return;
-  }
-
-  auto terrainCounter{loadTerrain(pos, async)};
-  if (terrainCounter) {
-    logger->info("[{}]: CELL {} terrain load started", fiberId, cellId);
-  }
-
   const auto landIdOpt{getLandId(cellId)};
   if (!landIdOpt) {
-    // No LAND for this cell or any of its parents. Wait for the Ogre::Terrain
-    // to finish loading then delete it and return.
-    if (terrainCounter) terrainCounter->wait();
-    unloadTerrain(pos);
+    // No LAND for this cell or any of its parents, so there is nothing to draw.
     logger->warn("[{}]: CELL {} and its ancestors have no LAND record",
                  fiberId, cellId);
     return;
   }
+
+  // The terrain group is only touched on the render thread, so whether the
+  // terrain is already loaded is checked there too. Many cells loading at once
+  // can share the same frame on the render thread.
+  logger->info("[{}]: CELL {} terrain load started", fiberId, cellId);
+  bool wasLoaded{false};
+  std::array<Ogre::Terrain *, 4u> terrain{};
+  oo::UploadQueue::submit([this, pos, &wasLoaded, &terrain]() {
+    wasLoaded = this->isTerrainLoaded(pos);
+    if (wasLoaded) return;
+    this->loadTerrainImpl(pos);
+    terrain = this->getTerrainQuads(pos);
+  }).get();
+
+  if (wasLoaded) {
+    logger->info("[{}]: CELL {} terrain is already loaded", fiberId, cellId);
+    return;
+  }
+  logger->info("[{}]: CELL {} terrain load finished", fiberId, cellId);
+
   auto &landRes{oo::getResolver<record::LAND>(mResolvers)};
   const record::LAND &landRec{*landRes.get(*landIdOpt)};
 
@@ -392,13 +459,6 @@ void World::WorldImpl::loadTerrain(oo::BaseId cellId, bool async) {
   oo::applyFineLayers(layerMaps, landRec);
   oo::applyFineLayers(layerOrders, landRec);
 
-  if (terrainCounter) {
-    logger->info("[{}]: CELL {} terrain load waiting", fiberId, cellId);
-    oo::RenderJobManager::waitOn(terrainCounter.get());
-    logger->info("[{}]: CELL {} terrain load finished", fiberId, cellId);
-  }
-
-  std::array<Ogre::Terrain *, 4u> terrain{getTerrainQuads(pos)};
   if (std::any_of(terrain.begin(), terrain.end(), std::logical_not<>{})) {
     logger->error("Null terrain at ({}, {})", qvm::X(pos), qvm::Y(pos));
     throw std::runtime_error("Null terrain");
@@ -411,24 +471,58 @@ void World::WorldImpl::loadTerrain(oo::BaseId cellId, bool async) {
       Ogre::Box(vpq - 1u, vpq - 1u, vpc, vpc)
   };
 
-  logger->info("[{}]: CELL {} terrain blit started", fiberId, cellId);
-  oo::JobCounter blitCounter{1};
-  oo::RenderJobManager::runJob([&]() {
+  // If the layers are drawn from texture arrays then each quad needs the array
+  // layers and weights of its most significant layers at each vertex instead
+  // of a blend map for each layer. The layer textures are read here, off the
+  // render thread, and uploaded along with the maps.
+  auto *textureArray{oo::TerrainTextureArray::getSingletonPtr()};
+  constexpr std::size_t arrayMapSize{vpq * vpq * 4u};
+  std::vector<uint8_t> arrayLayersData(textureArray ? 4u * arrayMapSize : 0u);
+  std::vector<uint8_t> arrayWeightsData(textureArray ? 4u * arrayMapSize : 0u);
+  std::array<Ogre::PixelBox, 4u> arrayLayerMaps{};
+  std::array<Ogre::PixelBox, 4u> arrayWeightMaps{};
+  std::array<ArrayLayers, 4u> arrayLayers{};
+  if (textureArray) {
     for (std::size_t i = 0; i < 4; ++i) {
-      oo::blitTerrainTextures(terrain[i], layerMaps[i], layerOrders[i],
-                              normals, vertexCols, regions[i]);
+      arrayLayerMaps[i] = Ogre::PixelBox(vpq, vpq, 1, Ogre::PF_BYTE_RGBA,
+                                         &arrayLayersData[i * arrayMapSize]);
+      arrayWeightMaps[i] = Ogre::PixelBox(vpq, vpq, 1, Ogre::PF_BYTE_RGBA,
+                                          &arrayWeightsData[i * arrayMapSize]);
+      arrayLayers[i] = oo::acquireArrayLayers(terrain[i]);
+      oo::writeLayerWeights(arrayLayerMaps[i], arrayWeightMaps[i],
+                            layerMaps[i], layerOrders[i], arrayLayers[i]);
     }
-  }, &blitCounter);
-  blitCounter.wait();
-  logger->info("[{}]: CELL {} terrain blit finished", fiberId, cellId);
+  }
 
-  logger->info("[{}]: CELL {} water creation started", fiberId, cellId);
-  oo::JobCounter waterCounter{1};
-  oo::RenderJobManager::runJob([&]() {
+  // Blit the textures and create the water in one trip to the render thread.
+  logger->info("[{}]: CELL {} terrain blit started", fiberId, cellId);
+  oo::RenderCommandBuffer commands{};
+  commands.record([&]() {
+    if (!textureArray) {
+      for (std::size_t i = 0; i < 4; ++i) {
+        oo::blitTerrainTextures(terrain[i], layerMaps[i], layerOrders[i],
+                                normals, vertexCols, regions[i]);
+      }
+      return;
+    }
+
+    textureArray->uploadPendingLayers();
+    for (std::size_t i = 0; i < 4; ++i) {
+      const long slotX{2 * qvm::X(pos) + static_cast<long>(i % 2u)};
+      const long slotY{2 * qvm::Y(pos) + static_cast<long>(i / 2u)};
+      textureArray->writeQuad(slotX, slotY,
+                              arrayLayerMaps[i], arrayWeightMaps[i],
+                              normals.getSubVolume(regions[i], true),
+                              vertexCols.getSubVolume(regions[i], true));
+    }
+    this->releaseArrayLayers(pos);
+    mArrayLayers.emplace(pos, std::move(arrayLayers));
+  });
+  commands.record([&]() {
     this->loadWaterPlane(pos, *cellRec);
-  }, &waterCounter);
-  waterCounter.wait();
-  logger->info("[{}]: CELL {} water creation finished", fiberId, cellId);
+  });
+  oo::UploadQueue::submit(std::move(commands)).get();
+  logger->info("[{}]: CELL {} terrain blit finished", fiberId, cellId);
 }
 
 void World::WorldImpl::unloadTerrain(oo::BaseId cellId) {
@@ -436,11 +530,9 @@ void World::WorldImpl::unloadTerrain(oo::BaseId cellId) {
   if (!cellRec) return;
 
   CellIndex pos{cellRec->grid->data.x, cellRec->grid->data.y};
-  oo::JobCounter unloadDone{1};
-  oo::RenderJobManager::runJob([this, pos]() {
+  oo::UploadQueue::submit([this, pos]() {
     this->unloadTerrain(pos);
-  }, &unloadDone);
-  unloadDone.wait();
+  }).get();
 }
 
 void World::WorldImpl::unloadTerrain(CellIndex index) {
@@ -451,6 +543,19 @@ void World::WorldImpl::unloadTerrain(CellIndex index) {
   mTerrainGroup.unloadTerrain(2 * x + 0, 2 * y + 1);
   mTerrainGroup.unloadTerrain(2 * x + 1, 2 * y + 1);
   unloadWaterPlane(index);
+  releaseArrayLayers(index);
+}
+
+void World::WorldImpl::releaseArrayLayers(CellIndex index) {
+  auto it{mArrayLayers.find(index)};
+  if (it == mArrayLayers.end()) return;
+
+  if (auto *textureArray{oo::TerrainTextureArray::getSingletonPtr()}) {
+    for (const auto &quadLayers : it->second) {
+      for (auto layer : quadLayers) textureArray->releaseLayer(layer);
+    }
+  }
+  mArrayLayers.erase(it);
 }
 
 void World::WorldImpl::updateAtmosphere(const oo::chrono::minutes &time) {
@@ -463,48 +568,12 @@ World::WorldImpl::getCell(oo::BaseId cellId) const {
   return cellRes.get(cellId);
 }
 
-std::shared_ptr<oo::JobCounter>
-World::WorldImpl::loadTerrainAsyncImpl(CellIndex index) {
-  auto x{qvm::X(index)}, y{qvm::Y(index)};
-  auto jc{std::make_shared<oo::JobCounter>(4)};
-  auto logger{spdlog::get(oo::LOG)};
-
-  oo::RenderJobManager::runJob([&group = mTerrainGroup, x, y, logger]() {
-    logger->info("[{}]: Loading ({}, {}) terrain quad 0",
-                 boost::this_fiber::get_id(), x, y);
-    group.loadTerrain(2 * x + 0, 2 * y + 0, true);
-  }, jc.get());
-
-  oo::RenderJobManager::runJob([&group = mTerrainGroup, x, y, logger]() {
-    logger->info("[{}]: Loading ({}, {}) terrain quad 1",
-                 boost::this_fiber::get_id(), x, y);
-    group.loadTerrain(2 * x + 1, 2 * y + 0, true);
-  }, jc.get());
-
-  oo::RenderJobManager::runJob([&group = mTerrainGroup, x, y, logger]() {
-    logger->info("[{}]: Loading ({}, {}) terrain quad 2",
-                 boost::this_fiber::get_id(), x, y);
-    group.loadTerrain(2 * x + 0, 2 * y + 1, true);
-  }, jc.get());
-
-  oo::RenderJobManager::runJob([&group = mTerrainGroup, x, y, logger]() {
-    logger->info("[{}]: Loading ({}, {}) terrain quad 3",
-                 boost::this_fiber::get_id(), x, y);
-    group.loadTerrain(2 * x + 1, 2 * y + 1, true);
-  }, jc.get());
-
-  return jc;
-}
-
-std::shared_ptr<oo::JobCounter>
-World::WorldImpl::loadTerrainSyncImpl(CellIndex index) {
+void World::WorldImpl::loadTerrainImpl(CellIndex index) {
   auto x{qvm::X(index)}, y{qvm::Y(index)};
   mTerrainGroup.loadTerrain(2 * x + 0, 2 * y + 0, true);
   mTerrainGroup.loadTerrain(2 * x + 1, 2 * y + 0, true);
   mTerrainGroup.loadTerrain(2 * x + 0, 2 * y + 1, true);
   mTerrainGroup.loadTerrain(2 * x + 1, 2 * y + 1, true);
-
-  return nullptr;
 }
 
 std::array<Ogre::Terrain *, 4u>
@@ -3,7 +3,9 @@
 
 #include "atmosphere.hpp"
 #include "job/job.hpp"
+#include "job/upload_queue.hpp"
 #include "math/conversions.hpp"
+#include "ogre/terrain_texture_array.hpp"
 #include "resolvers/wrld_resolver.hpp"
 #include <OgrePrerequisites.h>
 #include <Terrain/OgreTerrainGroup.h>
@@ -57,6 +59,10 @@ using LayerMaps = std::array<LayerMap, 4u>;
 /// `oo::LayerOrder`s for each quadrant of a cell.
 using LayerOrders = std::array<LayerOrder, 4u>;
 
+/// Layers of the `oo::TerrainTextureArray` used by each layer of a quadrant, in
+/// the same order as the quadrant's `oo::LayerOrder`.
+using ArrayLayers = std::vector<oo::TerrainTextureArray::LayerIndex>;
+
 /// `Ogre::Terrain::ImportData` for each quadrant of a cell.
 using ImportDataArray = std::array<Ogre::Terrain::ImportData, 4u>;
 
@@ -133,6 +139,26 @@ void blitTerrainTextures(Ogre::Terrain *quad,
                          Ogre::PixelBox vertexColors,
                          Ogre::Box region);
 
+/// Acquire a layer of the `oo::TerrainTextureArray` for the diffuse and normal
+/// textures of each layer of the given terrain quadrant.
+/// \pre An `oo::TerrainTextureArray` exists.
+ArrayLayers acquireArrayLayers(const Ogre::Terrain *quad);
+
+/// Write the array layers and weights of the (up to) four layers that
+/// contribute the most to each vertex of a quadrant, for use with an
+/// `oo::TerrainTextureArray`.
+/// The weight of a layer is its opacity multiplied by the transparency of every
+/// layer after it, so that blending with the weights gives the same result as
+/// applying the layers in order. The four weights at each vertex are scaled to
+/// sum to one.
+/// \param layers `Ogre::PF_BYTE_RGBA` map to write the array layers into.
+/// \param weights `Ogre::PF_BYTE_RGBA` map to write the weights into.
+void writeLayerWeights(Ogre::PixelBox layers,
+                       Ogre::PixelBox weights,
+                       LayerMap &layerMap,
+                       const LayerOrder &layerOrder,
+                       const ArrayLayers &arrayLayers);
+
 /// Append the landscape texture name and its normal map to the list of texture
 /// names.
 /// Specifically, append a string equal to `"textures/landscape/" + texName` to
@@ -160,21 +186,21 @@ class World::WorldImpl {
   std::string getName() const;
   void setName(std::string name);
 
-  /// Load the OGRE terrain at the given coordinates.
-  /// If `async` is true then this returns immediately with an `oo::JobCounter`
-  /// which will reach zero when the terrain is loaded, otherwise the terrain is
-  /// loaded synchronously and this function returns `nullptr` when the loading
-  /// is complete.
-  std::shared_ptr<oo::JobCounter>
-  loadTerrain(CellIndex index, bool async = true);
-
   /// Unload the OGRE terrain at the given coordinates.
   void unloadTerrain(CellIndex index);
 
   void loadTerrain(oo::ExteriorCell &cell);
   void unloadTerrain(oo::ExteriorCell &cell);
 
-  void loadTerrain(oo::BaseId cellId, bool async = true);
+  /// Load the terrain and water of the cell with the given id.
+  /// Everything that must be done on the render thread is submitted to the
+  /// `oo::UploadQueue`, so this can be called from any thread. From a
+  /// worker thread, the blend maps are built on the worker and the render
+  /// thread is only waited on twice: to load the terrain, and to upload its
+  /// textures and create its water.
+  void loadTerrain(oo::BaseId cellId);
+  /// Unload the terrain and water of the cell with the given id.
+  /// This can be called from any thread.
   void unloadTerrain(oo::BaseId cellId);
 
   void updateAtmosphere(const oo::chrono::minutes &time);
@@ -197,11 +223,14 @@ class World::WorldImpl {
 
   using DistantChunkMap = std::map<ChunkIndex, DistantChunk, ChunkIndexCmp>;
   using WaterEntryMap = std::map<CellIndex, WaterEntry, CellIndexCmp>;
+  using ArrayLayersMap = std::map<CellIndex, std::array<ArrayLayers, 4u>,
+                                  CellIndexCmp>;
 
   tl::optional<const record::CELL &> getCell(oo::BaseId cellId) const;
 
-  std::shared_ptr<oo::JobCounter> loadTerrainAsyncImpl(CellIndex index);
-  std::shared_ptr<oo::JobCounter> loadTerrainSyncImpl(CellIndex index);
+  /// Load the OGRE terrain quads of the given cell.
+  /// \pre Called on render thread
+  void loadTerrainImpl(CellIndex index);
 
   std::array<Ogre::Terrain *, 4u> getTerrainQuads(CellIndex index) const;
 
@@ -230,6 +259,11 @@ class World::WorldImpl {
   Ogre::MaterialPtr makeWaterMaterial() const;
   void makeWaterInstanceManager() const;
 
+  /// Release the `oo::TerrainTextureArray` layers used by the terrain of the
+  /// given cell, if any.
+  /// \pre Called on render thread
+  void releaseArrayLayers(CellIndex index);
+
   void loadWaterPlane(CellIndex index, const record::CELL &cellRec);
   void unloadWaterPlane(CellIndex index);
 
@@ -248,6 +282,9 @@ class World::WorldImpl {
   oo::Atmosphere mAtmosphere;
   DistantChunkMap mDistantChunks{ChunkIndexCmp{}};
   WaterEntryMap mWaterPlanes{CellIndexCmp{}};
+  /// Texture array layers used by each loaded cell's terrain, if terrain
+  /// texture arrays are enabled. Only accessed on the render thread.
+  ArrayLayersMap mArrayLayers{CellIndexCmp{}};
 };
 
 } // namespace oo
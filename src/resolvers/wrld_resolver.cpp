@@ -15,6 +15,7 @@ namespace oo {
 Resolver<record::WRLD, oo::BaseId>::Resolver(Resolver &&other) noexcept {
   std::scoped_lock lock{other.mMtx};
   mRecords = std::move(other.mRecords);
+  mChanges = std::move(other.mChanges);
 }
 
 WrldResolver &
@@ -23,6 +24,7 @@ Resolver<record::WRLD, oo::BaseId>::operator=(Resolver &&other) noexcept {
     std::scoped_lock lock{mMtx, other.mMtx};
     using std::swap;
     swap(mRecords, other.mRecords);
+    swap(mChanges, other.mChanges);
   }
 
   return *this;
@@ -169,6 +171,18 @@ std::unordered_set<oo::BaseId> WrldResolver::getWorlds() const {
   return ids;
 }
 
+void WrldResolver::markChanged(oo::BaseId baseId, uint32_t flags) {
+  std::scoped_lock lock{mMtx};
+  if (mRecords.find(baseId) == mRecords.end()) return;
+  mChanges[baseId].flags |= flags;
+}
+
+std::vector<std::pair<oo::BaseId, WrldResolver::Change>>
+WrldResolver::getChanges() const {
+  std::scoped_lock lock{mMtx};
+  return {mChanges.begin(), mChanges.end()};
+}
+
 template<> void
 WrldResolver::WrldVisitor::readRecord<record::CELL>(oo::EspAccessor &accessor) {
   auto &cellRes{oo::getResolver<record::CELL>(mBaseCtx)};
@@ -223,8 +237,8 @@ void World::loadTerrain(oo::ExteriorCell &cell) {
   mImpl->loadTerrain(cell);
 }
 
-void World::loadTerrainOnly(oo::BaseId cellId, bool async) {
-  mImpl->loadTerrain(cellId, async);
+void World::loadTerrainOnly(oo::BaseId cellId) {
+  mImpl->loadTerrain(cellId);
 }
 
 void World::unloadTerrain(oo::ExteriorCell &cell) {
@@ -0,0 +1,169 @@
+#include "io/io.hpp"
+#include "record/io.hpp"
+#include "save_file.hpp"
+#include "util/atomic_file.hpp"
+#include <zlib.h>
+#include <array>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <vector>
+
+namespace oo {
+
+namespace {
+
+/// Signature of save games compressed by `writeSaveFile()`, in place of the
+/// usual `TES4SAVEGAME`.
+constexpr const char *COMPRESSED_SAVE_SIGNATURE{"OOSAVEZ"};
+
+/// Upper bound on the uncompressed size of a compressed save game, so that a
+/// corrupt save does not cause a huge allocation.
+constexpr uint64_t MAX_UNCOMPRESSED_SAVE_SIZE{1ull << 30u};
+
+/// Read the signature of the save game `is` and, if it was compressed by
+/// `writeSaveFile()`, return its uncompressed size and leave `is` at the start
+/// of the compressed bytes. Otherwise, rewind `is` and return nothing.
+/// \throws std::runtime_error if the uncompressed size is invalid.
+std::optional<uint64_t> readCompressedSaveSize(std::istream &is) {
+  std::string signature{};
+  std::getline(is, signature, '\0');
+  if (signature != COMPRESSED_SAVE_SIGNATURE) {
+    is.clear();
+    is.seekg(0);
+    return std::nullopt;
+  }
+
+  uint64_t uncompressedSize{};
+  io::readBytes(is, uncompressedSize);
+  if (uncompressedSize > MAX_UNCOMPRESSED_SAVE_SIZE) {
+    throw std::runtime_error("Invalid uncompressed save size");
+  }
+
+  return uncompressedSize;
+}
+
+/// Stream buffer decompressing a zlib stream a chunk at a time as it is read.
+/// Corrupt or truncated compressed data is treated as the end of the stream.
+class InflateStreambuf : public std::streambuf {
+ public:
+  explicit InflateStreambuf(std::unique_ptr<std::istream> is)
+      : mIs(std::move(is)) {
+    if (::inflateInit(&mZs) != Z_OK) {
+      throw std::runtime_error("Failed to initialize decompression");
+    }
+  }
+
+  ~InflateStreambuf() override {
+    ::inflateEnd(&mZs);
+  }
+
+  InflateStreambuf(const InflateStreambuf &) = delete;
+  InflateStreambuf &operator=(const InflateStreambuf &) = delete;
+  InflateStreambuf(InflateStreambuf &&) = delete;
+  InflateStreambuf &operator=(InflateStreambuf &&) = delete;
+
+ protected:
+  int_type underflow() override;
+
+ private:
+  static constexpr std::size_t CHUNK_SIZE{1u << 16u};
+
+  std::unique_ptr<std::istream> mIs;
+  ::z_stream mZs{};
+  std::array<char, CHUNK_SIZE> mIn{};
+  std::array<char, CHUNK_SIZE> mOut{};
+  bool mIsEnd{false};
+};
+
+InflateStreambuf::int_type InflateStreambuf::underflow() {
+  if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+  mZs.next_out = reinterpret_cast<Bytef *>(mOut.data());
+  mZs.avail_out = static_cast<uInt>(mOut.size());
+
+  while (!mIsEnd && mZs.avail_out == mOut.size()) {
+    if (mZs.avail_in == 0u) {
+      mIs->read(mIn.data(), mIn.size());
+      mZs.next_in = reinterpret_cast<Bytef *>(mIn.data());
+      mZs.avail_in = static_cast<uInt>(mIs->gcount());
+      if (mZs.avail_in == 0u) {
+        mIsEnd = true;
+        break;
+      }
+    }
+
+    if (::inflate(&mZs, Z_NO_FLUSH) != Z_OK) mIsEnd = true;
+  }
+
+  const auto numRead{mOut.size() - mZs.avail_out};
+  if (numRead == 0u) return traits_type::eof();
+
+  setg(mOut.data(), mOut.data(), mOut.data() + numRead);
+  return traits_type::to_int_type(*gptr());
+}
+
+/// Input stream owning an `InflateStreambuf`.
+class InflateStream : public std::istream {
+ public:
+  explicit InflateStream(std::unique_ptr<std::istream> is)
+      : std::istream(nullptr), mBuf(std::move(is)) {
+    rdbuf(&mBuf);
+  }
+
+ private:
+  InflateStreambuf mBuf;
+};
+
+} // namespace
+
+void writeSaveFile(const std::string &bytes, const std::filesystem::path &path,
+                   bool compress) {
+  const auto write = [&bytes, compress](std::ostream &os) {
+    if (compress) {
+      const auto compressed{record::compressBytes(
+          std::vector<uint8_t>(bytes.begin(), bytes.end()))};
+      io::writeBytes(os, std::string{COMPRESSED_SAVE_SIGNATURE});
+      io::writeBytes(os, static_cast<uint64_t>(bytes.size()));
+      io::writeBytes(os, compressed);
+    } else {
+      os.write(bytes.data(), bytes.size());
+    }
+  };
+
+  if (!oo::writeFileAtomically(path, write)) {
+    throw std::runtime_error("Failed to write to file");
+  }
+}
+
+std::unique_ptr<std::istream> openSaveGame(const std::filesystem::path &path) {
+  auto is{std::make_unique<std::ifstream>(path, std::ios_base::binary)};
+
+  const auto uncompressedSize{readCompressedSaveSize(*is)};
+  if (!uncompressedSize) return is;
+
+  const auto start{is->tellg()};
+  is->seekg(0, std::ios_base::end);
+  const auto compressedSize{static_cast<std::size_t>(is->tellg() - start)};
+  is->seekg(start);
+
+  std::vector<uint8_t> compressed{};
+  io::readBytes(*is, compressed, compressedSize);
+  if (!*is) throw io::IOReadError(is->rdstate());
+
+  const auto bytes{record::uncompressBytes(compressed, *uncompressedSize)};
+  return std::make_unique<std::istringstream>(
+      std::string(bytes.begin(), bytes.end()), std::ios_base::binary);
+}
+
+std::unique_ptr<std::istream>
+streamSaveGame(const std::filesystem::path &path) {
+  auto is{std::make_unique<std::ifstream>(path, std::ios_base::binary)};
+  if (!readCompressedSaveSize(*is)) return is;
+
+  return std::make_unique<InflateStream>(std::move(is));
+}
+
+} // namespace oo
@@ -0,0 +1,500 @@
+#include "io/io.hpp"
+#include "io/string.hpp"
+#include "job/job.hpp"
+#include "save_file.hpp"
+#include "save_index.hpp"
+#include "util/atomic_file.hpp"
+#include "util/settings.hpp"
+#include <boost/fiber/mutex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace oo {
+
+//===----------------------------------------------------------------------===//
+// Header reading
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Largest width or height of a screenshot, so that a corrupt header does not
+/// cause a huge allocation.
+constexpr uint32_t MAX_SCREENSHOT_DIMENSION{4096u};
+
+/// Downscale an `PF_BYTE_RGB` image by averaging each `factor` by `factor`
+/// block of pixels, discarding any partial blocks on the right and bottom.
+std::vector<uint8_t> downscale(const std::vector<uint8_t> &pixels,
+                               uint32_t width, uint32_t factor,
+                               uint32_t dstWidth, uint32_t dstHeight) {
+  std::vector<uint8_t> dst(dstWidth * dstHeight * 3u);
+  const uint32_t area{factor * factor};
+
+  for (uint32_t y = 0; y < dstHeight; ++y) {
+    for (uint32_t x = 0; x < dstWidth; ++x) {
+      uint32_t sum[3]{};
+      for (uint32_t dy = 0; dy < factor; ++dy) {
+        const auto row{(y * factor + dy) * width};
+        for (uint32_t dx = 0; dx < factor; ++dx) {
+          const auto *src{&pixels[(row + x * factor + dx) * 3u]};
+          sum[0] += src[0];
+          sum[1] += src[1];
+          sum[2] += src[2];
+        }
+      }
+
+      auto *out{&dst[(y * dstWidth + x) * 3u]};
+      out[0] = static_cast<uint8_t>(sum[0] / area);
+      out[1] = static_cast<uint8_t>(sum[1] / area);
+      out[2] = static_cast<uint8_t>(sum[2] / area);
+    }
+  }
+
+  return dst;
+}
+
+} // namespace
+
+std::istream &readSaveHeader(std::istream &is, SaveHeader &header,
+                             SaveScreenshot *screenshot) {
+  // UESP says this is a 12 byte string without a null-terminator, followed by
+  // a major version number byte, which is conveniently always zero. Might it
+  // simply be a null-terminator? It is safe to assume so regardless.
+  std::string headerStr{};
+  io::readBytes(is, headerStr);
+  if (headerStr != "TES4SAVEGAME") {
+    throw std::runtime_error("Invalid file signature");
+  }
+
+  io::readBytes(is, header.version);
+  io::readBytes(is, header.exeTime);
+  io::readBytes(is, header.headerVersion);
+
+  // Size in bytes of the remaining save game header. This is not needed.
+  uint32_t headerSize{};
+  io::readBytes(is, headerSize);
+
+  io::readBytes(is, header.saveNumber);
+  header.playerName = io::readBzString(is);
+  io::readBytes(is, header.playerLevel);
+  header.playerCellName = io::readBzString(is);
+  io::readBytes(is, header.gameDaysPassed);
+  io::readBytes(is, header.gameTicksPassed);
+  io::readBytes(is, header.saveTime);
+
+  // Entire size of the screenshot, *including* the width and height.
+  uint32_t screenshotSize{0};
+  io::readBytes(is, screenshotSize);
+  uint32_t width{0};
+  io::readBytes(is, width);
+  uint32_t height{0};
+  io::readBytes(is, height);
+
+  const std::size_t numBytes{std::size_t{width} * height * 3u};
+  if (width > MAX_SCREENSHOT_DIMENSION || height > MAX_SCREENSHOT_DIMENSION
+      || screenshotSize < 8u || screenshotSize - 8u < numBytes) {
+    throw std::runtime_error("Invalid screenshot size");
+  }
+
+  // Only the pixels are needed, any padding after them is skipped.
+  std::vector<uint8_t> pixels(numBytes);
+  is.read(reinterpret_cast<char *>(pixels.data()), pixels.size());
+  is.ignore(screenshotSize - 8u - numBytes);
+  if (!is) throw io::IOReadError(is.rdstate());
+
+  const uint32_t factor{std::max(1u, (width + SaveIndex::THUMBNAIL_WIDTH - 1u)
+      / SaveIndex::THUMBNAIL_WIDTH)};
+  header.thumbnailWidth = width / factor;
+  header.thumbnailHeight = height / factor;
+  header.thumbnail = factor == 1u
+                     ? pixels
+                     : downscale(pixels, width, factor, header.thumbnailWidth,
+                                 header.thumbnailHeight);
+
+  if (screenshot) {
+    screenshot->width = width;
+    screenshot->height = height;
+    screenshot->pixels = std::move(pixels);
+  }
+
+  return is;
+}
+
+std::ostream &writeSaveHeader(std::ostream &os, const SaveHeader &header,
+                              const SaveScreenshot &screenshot) {
+  io::writeBytes(os, std::string{"TES4SAVEGAME"});
+  io::writeBytes(os, header.version);
+  io::writeBytes(os, header.exeTime);
+  io::writeBytes(os, header.headerVersion);
+
+  // Each bzstring has a length byte and a null-terminator, and the screenshot
+  // is preceded by its size and dimensions.
+  const std::size_t screenshotSize{8u + screenshot.pixels.size()};
+  const auto headerSize{sizeof(header.saveNumber)
+                            + (2u + header.playerName.size())
+                            + sizeof(header.playerLevel)
+                            + (2u + header.playerCellName.size())
+                            + sizeof(header.gameDaysPassed)
+                            + sizeof(header.gameTicksPassed)
+                            + sizeof(header.saveTime)
+                            + (4u + screenshotSize)};
+  io::writeBytes(os, static_cast<uint32_t>(headerSize));
+
+  io::writeBytes(os, header.saveNumber);
+  io::writeBzString(os, header.playerName);
+  io::writeBytes(os, header.playerLevel);
+  io::writeBzString(os, header.playerCellName);
+  io::writeBytes(os, header.gameDaysPassed);
+  io::writeBytes(os, header.gameTicksPassed);
+  io::writeBytes(os, header.saveTime);
+
+  // Entire size of the screenshot, *including* the width and height.
+  io::writeBytes(os, static_cast<uint32_t>(screenshotSize));
+  io::writeBytes(os, screenshot.width);
+  io::writeBytes(os, screenshot.height);
+  os.write(reinterpret_cast<const char *>(screenshot.pixels.data()),
+           screenshot.pixels.size());
+
+  return os;
+}
+
+//===----------------------------------------------------------------------===//
+// Index file
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// Version of the index file format, to be incremented whenever it changes.
+constexpr uint32_t INDEX_VERSION{2u};
+
+/// Size and modification time of a save game, used to tell whether its cached
+/// header is out of date.
+struct SaveStamp {
+  int64_t mtime{};
+  uint64_t size{};
+
+  bool operator==(const SaveStamp &other) const noexcept {
+    return mtime == other.mtime && size == other.size;
+  }
+};
+
+struct IndexEntry {
+  SaveStamp stamp{};
+  SaveHeader header{};
+};
+
+/// Cached headers, keyed by the filename of their save game.
+using IndexMap = std::map<std::string, IndexEntry>;
+
+void writeIndexEntry(std::ostream &os, const std::string &filename,
+                     const IndexEntry &entry) {
+  const auto &header{entry.header};
+  io::writeBytes(os, filename);
+  io::writeBytes(os, entry.stamp.mtime);
+  io::writeBytes(os, entry.stamp.size);
+  io::writeBytes(os, header.version);
+  io::writeBytes(os, header.exeTime);
+  io::writeBytes(os, header.headerVersion);
+  io::writeBytes(os, header.saveNumber);
+  io::writeBytes(os, header.playerName);
+  io::writeBytes(os, header.playerLevel);
+  io::writeBytes(os, header.playerCellName);
+  io::writeBytes(os, header.gameDaysPassed);
+  io::writeBytes(os, header.gameTicksPassed);
+  io::writeBytes(os, header.saveTime);
+  io::writeBytes(os, header.thumbnailWidth);
+  io::writeBytes(os, header.thumbnailHeight);
+  io::writeBytes(os, header.thumbnail);
+}
+
+std::string readIndexEntry(std::istream &is, IndexEntry &entry) {
+  auto &header{entry.header};
+  std::string filename{};
+  io::readBytes(is, filename);
+  io::readBytes(is, entry.stamp.mtime);
+  io::readBytes(is, entry.stamp.size);
+  io::readBytes(is, header.version);
+  io::readBytes(is, header.exeTime);
+  io::readBytes(is, header.headerVersion);
+  io::readBytes(is, header.saveNumber);
+  io::readBytes(is, header.playerName);
+  io::readBytes(is, header.playerLevel);
+  io::readBytes(is, header.playerCellName);
+  io::readBytes(is, header.gameDaysPassed);
+  io::readBytes(is, header.gameTicksPassed);
+  io::readBytes(is, header.saveTime);
+  io::readBytes(is, header.thumbnailWidth);
+  io::readBytes(is, header.thumbnailHeight);
+
+  // Screenshots are never much taller than they are wide, so anything larger
+  // is a corrupt index that would otherwise cause a huge allocation.
+  const std::size_t numBytes{std::size_t{header.thumbnailWidth}
+                                 * header.thumbnailHeight * 3u};
+  if (header.thumbnailWidth > SaveIndex::THUMBNAIL_WIDTH
+      || header.thumbnailHeight > SaveIndex::THUMBNAIL_WIDTH * 4u) {
+    throw std::runtime_error("Invalid thumbnail size");
+  }
+  io::readBytes(is, header.thumbnail, numBytes);
+  if (!is) throw io::IOReadError(is.rdstate());
+
+  return filename;
+}
+
+/// Read the index file, returning an empty index if it does not exist or
+/// cannot be read.
+IndexMap readIndex(const std::filesystem::path &indexPath) {
+  IndexMap index{};
+  std::ifstream is(indexPath, std::ios_base::binary);
+  if (!is) return index;
+
+  try {
+    uint32_t version{};
+    io::readBytes(is, version);
+    if (version != INDEX_VERSION) return index;
+
+    uint32_t numEntries{};
+    io::readBytes(is, numEntries);
+    for (uint32_t i = 0; i < numEntries; ++i) {
+      IndexEntry entry{};
+      auto filename{readIndexEntry(is, entry)};
+      index.insert_or_assign(std::move(filename), std::move(entry));
+    }
+  } catch (const std::exception &e) {
+    spdlog::get(oo::LOG)->warn("Ignoring save index {}: {}",
+                               indexPath.string(), e.what());
+    index.clear();
+  }
+
+  return index;
+}
+
+void writeIndex(const std::filesystem::path &indexPath, const IndexMap &index) {
+  const auto write = [&index](std::ostream &os) {
+    io::writeBytes(os, INDEX_VERSION);
+    io::writeBytes(os, static_cast<uint32_t>(index.size()));
+    for (const auto &[filename, entry] : index) {
+      writeIndexEntry(os, filename, entry);
+    }
+  };
+
+  if (!oo::writeFileAtomically(indexPath, write)) {
+    spdlog::get(oo::LOG)->warn("Failed to write save index {}",
+                               indexPath.string());
+  }
+}
+
+} // namespace
+
+//===----------------------------------------------------------------------===//
+// SaveIndex
+//===----------------------------------------------------------------------===//
+
+/// State of a scan, shared between the `SaveIndex` and the jobs reading
+/// headers so that the index can be destroyed before the jobs finish.
+struct SaveIndex::ScanState {
+  struct Slot {
+    std::filesystem::path path{};
+    SaveStamp stamp{};
+    std::optional<SaveHeader> header{};
+    /// Whether the header has been read, or failed to be read.
+    bool isDone{false};
+  };
+
+  std::filesystem::path indexPath;
+  /// The save games in order of modification time, most recent first. The
+  /// number of slots is fixed once the scan has started, but `header` and
+  /// `isDone` must only be accessed while holding `mutex`.
+  std::vector<Slot> slots{};
+  boost::fibers::mutex mutex{};
+
+  /// Indices of the slots whose headers are not cached.
+  std::vector<std::size_t> pending{};
+  std::atomic<std::size_t> nextPending{0u};
+  std::atomic<std::size_t> numRemaining{0u};
+  /// Whether the index file is out of date.
+  std::atomic<bool> isIndexDirty{false};
+  std::atomic<bool> isCancelled{false};
+
+  explicit ScanState(std::filesystem::path pIndexPath)
+      : indexPath(std::move(pIndexPath)) {}
+
+  /// Fill the slots of any cached headers from the index file, and start
+  /// jobs to read the others.
+  void start(const std::shared_ptr<ScanState> &self);
+
+  /// Read pending headers until there are none left.
+  void work();
+
+  void finishSlot(std::size_t i, std::optional<SaveHeader> header);
+
+  void updateIndex();
+};
+
+void SaveIndex::ScanState::start(const std::shared_ptr<ScanState> &self) {
+  auto index{readIndex(indexPath)};
+  std::size_t numCached{0u};
+
+  for (std::size_t i = 0; i < slots.size(); ++i) {
+    auto &slot{slots[i]};
+    auto it{index.find(slot.path.filename().string())};
+    if (it == index.end() || !(it->second.stamp == slot.stamp)) {
+      pending.push_back(i);
+      continue;
+    }
+
+    it->second.header.path = slot.path;
+    finishSlot(i, std::move(it->second.header));
+    ++numCached;
+  }
+
+  // Saves may have been deleted, in which case the index should shrink.
+  isIndexDirty = numCached != index.size();
+  numRemaining = pending.size();
+  if (pending.empty()) {
+    if (isIndexDirty) updateIndex();
+    return;
+  }
+
+  // Like parallelFor(), but without waiting for the jobs to finish.
+  const auto numJobs{std::min<std::size_t>(pending.size(),
+                                           JobManager::getNumWorkers())};
+  for (std::size_t i = 1; i < numJobs; ++i) {
+    JobManager::runJob([self]() { self->work(); });
+  }
+  work();
+}
+
+void SaveIndex::ScanState::work() {
+  for (std::size_t i{nextPending++}; i < pending.size(); i = nextPending++) {
+    const auto slotIndex{pending[i]};
+    std::optional<SaveHeader> header{};
+
+    if (!isCancelled) {
+      const auto &path{slots[slotIndex].path};
+      try {
+        // Only the header is needed, so avoid decompressing the whole save.
+        auto is{oo::streamSaveGame(path)};
+        header.emplace();
+        header->path = path;
+        oo::readSaveHeader(*is, *header);
+        isIndexDirty = true;
+      } catch (const std::exception &e) {
+        spdlog::get(oo::LOG)->warn("Failed to read save game {}: {}",
+                                   path.string(), e.what());
+        header.reset();
+      }
+    }
+
+    finishSlot(slotIndex, std::move(header));
+    if (--numRemaining == 0u && isIndexDirty && !isCancelled) updateIndex();
+  }
+}
+
+void SaveIndex::ScanState::finishSlot(std::size_t i,
+                                      std::optional<SaveHeader> header) {
+  std::unique_lock lock{mutex};
+  slots[i].header = std::move(header);
+  slots[i].isDone = true;
+}
+
+void SaveIndex::ScanState::updateIndex() {
+  IndexMap index{};
+  {
+    std::unique_lock lock{mutex};
+    for (const auto &slot : slots) {
+      if (!slot.header) continue;
+      index.emplace(slot.path.filename().string(),
+                    IndexEntry{slot.stamp, *slot.header});
+    }
+  }
+
+  writeIndex(indexPath, index);
+}
+
+SaveIndex::SaveIndex(std::filesystem::path saveDir)
+    : mSaveDir(std::move(saveDir)) {}
+
+SaveIndex::~SaveIndex() {
+  if (mState) mState->isCancelled = true;
+}
+
+SaveIndex::SaveIndex(SaveIndex &&) noexcept = default;
+
+SaveIndex &SaveIndex::operator=(SaveIndex &&other) noexcept {
+  if (this != &other) {
+    if (mState) mState->isCancelled = true;
+    mSaveDir = std::move(other.mSaveDir);
+    mState = std::move(other.mState);
+    mNumPolled = other.mNumPolled;
+  }
+  return *this;
+}
+
+void SaveIndex::scan() {
+  namespace fs = std::filesystem;
+  if (mState) mState->isCancelled = true;
+
+  mState = std::make_shared<ScanState>(mSaveDir / INDEX_FILENAME);
+  mNumPolled = 0u;
+
+  struct SaveFile {
+    fs::path path{};
+    fs::file_time_type mtime{};
+    std::uintmax_t size{};
+  };
+
+  // Saves can be deleted while scanning, so use the non-throwing overloads and
+  // skip any that disappear.
+  std::vector<SaveFile> saves{};
+  std::error_code ec{};
+  for (fs::directory_iterator it(mSaveDir, ec), end{}; !ec && it != end;
+       it.increment(ec)) {
+    if (it->path().extension() != ".ess") continue;
+
+    std::error_code entryEc{};
+    SaveFile save{it->path(), it->last_write_time(entryEc), 0u};
+    if (entryEc) continue;
+    save.size = it->file_size(entryEc);
+    if (entryEc) continue;
+    saves.push_back(std::move(save));
+  }
+
+  std::sort(saves.begin(), saves.end(), [](const auto &a, const auto &b) {
+    return a.mtime > b.mtime;
+  });
+
+  auto &slots{mState->slots};
+  slots.resize(saves.size());
+  for (std::size_t i = 0; i < saves.size(); ++i) {
+    slots[i].path = std::move(saves[i].path);
+    slots[i].stamp = SaveStamp{
+        static_cast<int64_t>(saves[i].mtime.time_since_epoch().count()),
+        static_cast<uint64_t>(saves[i].size)
+    };
+  }
+
+  // Reading the index file and any uncached headers happens off this thread.
+  JobManager::runJob([state = mState]() { state->start(state); });
+}
+
+std::vector<SaveHeader> SaveIndex::poll() {
+  std::vector<SaveHeader> headers{};
+  if (!mState) return headers;
+
+  std::unique_lock lock{mState->mutex};
+  auto &slots{mState->slots};
+  for (; mNumPolled < slots.size() && slots[mNumPolled].isDone; ++mNumPolled) {
+    auto &header{slots[mNumPolled].header};
+    if (header) headers.push_back(*header);
+  }
+
+  return headers;
+}
+
+bool SaveIndex::isFinished() const {
+  return !mState || mNumPolled == mState->slots.size();
+}
+
+} // namespace oo
@@ -2,10 +2,14 @@
 #include "io/io.hpp"
 #include "io/memstream.hpp"
 #include "io/string.hpp"
+#include "job/job.hpp"
 #include "record/formid.hpp"
+#include "record/io.hpp"
 #include "record/record.hpp"
 #include "record/records.hpp"
+#include "save_index.hpp"
 #include "save_state.hpp"
+#include "util/settings.hpp"
 #include <OgreDataStream.h>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -16,8 +20,11 @@
 #include <ShlObj.h>
 #endif
 
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 
 namespace oo {
 
@@ -137,10 +144,52 @@ EssVisitor::readRecord<record::NPC_>(oo::EssAccessor &accessor) {
 
 } // namespace
 
+//===----------------------------------------------------------------------===//
+// EssSnapshot
+//===----------------------------------------------------------------------===//
+
+/// Copies of the ess records of the types that can be created records, which
+/// are the types that `EssVisitor` reads.
+struct EssSnapshot {
+  std::vector<std::pair<oo::BaseId, record::LIGH>> ligh{};
+  std::vector<std::pair<oo::BaseId, record::MISC>> misc{};
+  std::vector<std::pair<oo::BaseId, record::NPC_>> npc_{};
+};
+
+namespace {
+
+template<class R> uint32_t
+countCreatedRecords(const std::unordered_set<oo::BaseId> &createdRecords,
+                    const std::vector<std::pair<oo::BaseId, R>> &records) {
+  return static_cast<uint32_t>(std::count_if(
+      records.begin(), records.end(), [&](const auto &pair) {
+        return createdRecords.count(pair.first) != 0;
+      }));
+}
+
+template<class R>
+void writeCreatedRecords(std::ostream &os,
+                         const std::unordered_set<oo::BaseId> &createdRecords,
+                         const std::vector<std::pair<oo::BaseId, R>> &records) {
+  for (const auto &[baseId, rec] : records) {
+    if (createdRecords.count(baseId) != 0) record::writeRecord(os, rec);
+  }
+}
+
+} // namespace
+
 //===----------------------------------------------------------------------===//
 // SaveState implementations
 //===----------------------------------------------------------------------===//
 
+void SaveState::takeSnapshot() {
+  auto snapshot{std::make_shared<EssSnapshot>()};
+  snapshot->ligh = oo::getResolver<record::LIGH>(mBaseCtx).getEssRecords();
+  snapshot->misc = oo::getResolver<record::MISC>(mBaseCtx).getEssRecords();
+  snapshot->npc_ = oo::getResolver<record::NPC_>(mBaseCtx).getEssRecords();
+  mSnapshot = std::move(snapshot);
+}
+
 oo::CellRequest SaveState::makeCellRequest() const {
   // Exterior cell information is present even if the player is in an interior
   // cell, so we can only find out whether the cell is an interior or exterior
@@ -271,36 +320,25 @@ std::istream &operator>>(std::istream &is, oo::SaveState &sv) {
 }
 
 std::ostream &operator<<(std::ostream &os, const oo::SaveState &sv) {
-  io::writeBytes(os, "TES4SAVEGAME");
-  io::writeBytes(os, sv.mVersion);
-  io::writeBytes(os, sv.mExeTime);
-  io::writeBytes(os, sv.mHeaderVersion);
-
-  const auto headerSize{sizeof(sv.mSaveNumber)
-                            + (1u + sv.mPlayerName.size())
-                            + sizeof(sv.mPlayerLevel)
-                            + (1u + sv.mPlayerCellName.size())
-                            + sizeof(sv.mGameDaysPassed)
-                            + sizeof(sv.mGameTicksPassed)
-                            + sizeof(sv.mSaveTime)
-                            + (12u + sv.mScreenshot.getSize())};
-  io::writeBytes(os, static_cast<uint32_t>(headerSize));
-
-  io::writeBytes(os, sv.mSaveNumber);
-
-  io::writeBzString(os, sv.mPlayerName);
-  io::writeBytes(os, sv.mPlayerLevel);
-  io::writeBzString(os, sv.mPlayerCellName);
-
-  io::writeBytes(os, sv.mGameDaysPassed);
-  io::writeBytes(os, sv.mGameTicksPassed);
-  io::writeBytes(os, sv.mSaveTime);
-
-  io::writeBytes(os, static_cast<uint32_t>(sv.mScreenshot.getSize()));
-  io::writeBytes(os, static_cast<uint32_t>(sv.mScreenshot.getWidth()));
-  io::writeBytes(os, static_cast<uint32_t>(sv.mScreenshot.getHeight()));
-  os.write(reinterpret_cast<const char *>(sv.mScreenshot.getData()),
-           sv.mScreenshot.getSize());
+  oo::SaveHeader header{};
+  header.version = sv.mVersion;
+  header.exeTime = sv.mExeTime;
+  header.headerVersion = sv.mHeaderVersion;
+  header.saveNumber = sv.mSaveNumber;
+  header.playerName = sv.mPlayerName;
+  header.playerLevel = sv.mPlayerLevel;
+  header.playerCellName = sv.mPlayerCellName;
+  header.gameDaysPassed = sv.mGameDaysPassed;
+  header.gameTicksPassed = sv.mGameTicksPassed;
+  header.saveTime = sv.mSaveTime;
+
+  oo::SaveScreenshot screenshot{};
+  screenshot.width = static_cast<uint32_t>(sv.mScreenshot.getWidth());
+  screenshot.height = static_cast<uint32_t>(sv.mScreenshot.getHeight());
+  const auto *pixels{sv.mScreenshot.getData()};
+  screenshot.pixels.assign(pixels, pixels + sv.mScreenshot.getSize());
+
+  oo::writeSaveHeader(os, header, screenshot);
 
   io::writeBytes(os, sv.mNumPlugins);
   for (const auto &plugin : sv.mPlugins) io::writeBString(os, plugin);
@@ -341,9 +379,20 @@ std::ostream &operator<<(std::ostream &os, const oo::SaveState &sv) {
   io::writeBytes(os, sv.mPlayerCombatCount);
 
 
-  // TODO: Write the save state created records.
-  //io::writeBytes(os, sv.mNumCreatedRecords);
-  io::writeBytes(os, static_cast<uint32_t>(0u));
+  if (sv.mSnapshot) {
+    const std::unordered_set<oo::BaseId> createdRecords(
+        sv.mCreatedRecords.begin(), sv.mCreatedRecords.end());
+    const auto &snapshot{*sv.mSnapshot};
+    io::writeBytes(os, countCreatedRecords(createdRecords, snapshot.ligh)
+        + countCreatedRecords(createdRecords, snapshot.misc)
+        + countCreatedRecords(createdRecords, snapshot.npc_));
+
+    writeCreatedRecords(os, createdRecords, snapshot.ligh);
+    writeCreatedRecords(os, createdRecords, snapshot.misc);
+    writeCreatedRecords(os, createdRecords, snapshot.npc_);
+  } else {
+    io::writeBytes(os, static_cast<uint32_t>(0u));
+  }
 
   const auto quickKeysSize{std::accumulate(
       sv.mQuickKeys.begin(), sv.mQuickKeys.end(), 0u,
@@ -382,53 +431,52 @@ std::ostream &operator<<(std::ostream &os, const oo::SaveState &sv) {
 //===----------------------------------------------------------------------===//
 
 std::istream &readSaveHeader(std::istream &is, SaveState &sv) {
-  // UESP says this is a 12 byte string without a null-terminator, followed by
-  // a major version number byte, which is conveniently always zero. Might it
-  // simply be a null-terminator? It is safe to assume so regardless.
-  std::string headerStr{};
-  io::readBytes(is, headerStr);
-  if (headerStr != "TES4SAVEGAME") {
-    throw std::runtime_error("Invalid file signature");
-  }
-  io::readBytes(is, sv.mVersion);
-  io::readBytes(is, sv.mExeTime);
-
-  io::readBytes(is, sv.mHeaderVersion);
-
-  // Size in bytes of the remaining save game header. This is not needed.
-  uint32_t headerSize{};
-  io::readBytes(is, headerSize);
-
-  io::readBytes(is, sv.mSaveNumber);
-
-  sv.mPlayerName = io::readBzString(is);
-  io::readBytes(is, sv.mPlayerLevel);
-  sv.mPlayerCellName = io::readBzString(is);
+  SaveHeader header{};
+  SaveScreenshot screenshot{};
+  oo::readSaveHeader(is, header, &screenshot);
+
+  sv.mVersion = header.version;
+  sv.mExeTime = header.exeTime;
+  sv.mHeaderVersion = header.headerVersion;
+  sv.mSaveNumber = header.saveNumber;
+  sv.mPlayerName = std::move(header.playerName);
+  sv.mPlayerLevel = header.playerLevel;
+  sv.mPlayerCellName = std::move(header.playerCellName);
+  sv.mGameDaysPassed = header.gameDaysPassed;
+  sv.mGameTicksPassed = header.gameTicksPassed;
+  sv.mSaveTime = header.saveTime;
 
-  io::readBytes(is, sv.mGameDaysPassed);
-  io::readBytes(is, sv.mGameTicksPassed);
-  io::readBytes(is, sv.mSaveTime);
-
-  // Entire size of the screenshot, *including* the width and height.
-  uint32_t screenshotSize{0};
-  io::readBytes(is, screenshotSize);
-
-  uint32_t screenshotWidth{0};
-  io::readBytes(is, screenshotWidth);
-
-  uint32_t screenshotHeight{0};
-  io::readBytes(is, screenshotHeight);
-
-  std::vector<uint8_t> pixels(screenshotSize - 8u);
-  is.read(reinterpret_cast<char *>(pixels.data()), pixels.size());
   auto stream{std::make_shared<Ogre::MemoryDataStream>(
-      pixels.data(), pixels.size())};
+      screenshot.pixels.data(), screenshot.pixels.size())};
 
   const uint32_t screenshotDepth{1u};
-  sv.mScreenshot.loadRawData(stream, screenshotWidth, screenshotHeight,
+  sv.mScreenshot.loadRawData(stream, screenshot.width, screenshot.height,
                              screenshotDepth, Ogre::PixelFormat::PF_BYTE_RGB);
 
   return is;
 }
 
+void writeSaveGame(SaveState sv, std::filesystem::path path,
+                   oo::JobCounter *counter) {
+  sv.takeSnapshot();
+  const bool compress{oo::GameSettings::getSingleton()
+                          .get("General.bCompressSaves", true)};
+
+  // Jobs must be copyable, but there is no need to copy the screenshot again.
+  auto state{std::make_shared<const SaveState>(std::move(sv))};
+
+  JobManager::runJob([state, path = std::move(path), compress]() {
+    // Exceptions must not escape the job, otherwise the counter would never be
+    // decremented.
+    try {
+      std::ostringstream ss(std::ios_base::binary);
+      ss << *state;
+      writeSaveFile(ss.str(), path, compress);
+    } catch (const std::exception &e) {
+      spdlog::get(oo::LOG)->error("Failed to write save game {}: {}",
+                                  path.string(), e.what());
+    }
+  }, counter);
+}
+
 } // namespace oo
@@ -0,0 +1,766 @@
+#include "bytecode.hpp"
+#include <llvm/ADT/SmallVector.h>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+namespace oo {
+
+namespace {
+
+[[nodiscard]] bool isInteger(ValueType type) noexcept {
+  return type == ValueType::Bool || type == ValueType::Short
+      || type == ValueType::Long;
+}
+
+/// Parse the content of an integer or reference literal, truncating it to 32
+/// bits like `llvm::APInt` would.
+[[nodiscard]] int32_t parseLiteral(const std::string &content, int base) {
+  const auto value{std::strtoull(content.c_str(), nullptr, base)};
+  return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+[[nodiscard]] int32_t floatToLong(float value) noexcept {
+  // Out of range conversions are undefined, give what x86 does.
+  constexpr float lowest{-2147483648.0f};
+  constexpr float highest{2147483648.0f};
+  if (!(value >= lowest && value < highest)) {
+    return std::numeric_limits<int32_t>::min();
+  }
+  return static_cast<int32_t>(value);
+}
+
+[[nodiscard]] int32_t divideLong(int32_t lhs, int32_t rhs) noexcept {
+  // Division by zero and overflow are undefined; do not trap on them.
+  if (rhs == 0) return 0;
+  if (rhs == -1) return static_cast<int32_t>(0u - static_cast<uint32_t>(lhs));
+  return lhs / rhs;
+}
+
+} // namespace
+
+BytecodeCompiler::BytecodeCompiler(
+    const llvm::StringMap<BytecodeFunction> &functions,
+    std::optional<uint32_t> calleeRef)
+    : mFunctions(functions), mCalleeRef(calleeRef) {}
+
+BytecodeScript BytecodeCompiler::compile(const AstNode &root) {
+  visit(root);
+  return std::move(mScript);
+}
+
+ValueType BytecodeCompiler::visit(const AstNode &node) {
+  auto visitor = [this, &node](auto t) -> ValueType {
+    using T = decltype(t);
+    if constexpr(has_type_v<T>) {
+      return visitImpl<typename T::type>(node);
+    } else {
+      return ValueType::Void;
+    }
+  };
+
+  if (node.is_root()) {
+    for (const auto &child : node.children) {
+      visit(*child);
+    }
+    return ValueType::Void;
+  }
+
+  return node.visit(visitor);
+}
+
+ValueType BytecodeCompiler::visitValue(const AstNode &node) {
+  const ValueType type{visit(node)};
+  if (type == ValueType::Void) {
+    throw std::runtime_error("Expression does not have a value");
+  }
+  return type;
+}
+
+void BytecodeCompiler::visitStatement(const AstNode &node) {
+  if (visit(node) != ValueType::Void) emit(OpCode::Pop);
+}
+
+std::size_t BytecodeCompiler::emit(OpCode op, int32_t operand) {
+  if (!mBlock) throw std::runtime_error("Statement is outside of a block");
+
+  switch (op) {
+    case OpCode::Push:
+    case OpCode::LoadLocal:
+    case OpCode::LoadGlobal:
+      ++mStackSize;
+      break;
+    case OpCode::Call: {
+      const auto &fun{mScript.functions[static_cast<std::size_t>(operand)]};
+      mStackSize -= static_cast<uint32_t>(fun.argTypes.size());
+      if (fun.returnType != ValueType::Void) ++mStackSize;
+      break;
+    }
+    case OpCode::Pop:
+    case OpCode::StoreLocal:
+    case OpCode::StoreGlobal:
+    case OpCode::AddInt:
+    case OpCode::SubInt:
+    case OpCode::MulInt:
+    case OpCode::DivInt:
+    case OpCode::AddFloat:
+    case OpCode::SubFloat:
+    case OpCode::MulFloat:
+    case OpCode::DivFloat:
+    case OpCode::LtInt:
+    case OpCode::LeInt:
+    case OpCode::GtInt:
+    case OpCode::GeInt:
+    case OpCode::EqInt:
+    case OpCode::NeInt:
+    case OpCode::LtFloat:
+    case OpCode::LeFloat:
+    case OpCode::GtFloat:
+    case OpCode::GeFloat:
+    case OpCode::EqFloat:
+    case OpCode::NeFloat:
+    case OpCode::And:
+    case OpCode::Or:
+    case OpCode::JumpIfFalse:
+    case OpCode::Return:
+      --mStackSize;
+      break;
+    default:
+      break;
+  }
+
+  mBlock->maxStackSize = std::max(mBlock->maxStackSize, mStackSize);
+  mBlock->code.push_back(Instruction{op, operand});
+  return mBlock->code.size() - 1u;
+}
+
+std::optional<int32_t>
+BytecodeCompiler::getFunctionIndex(const std::string &funName) {
+  if (auto it{mFunctionIndices.find(funName)}; it != mFunctionIndices.end()) {
+    return static_cast<int32_t>(it->second);
+  }
+
+  auto it{mFunctions.find(funName)};
+  if (it == mFunctions.end()) return std::nullopt;
+
+  const auto index{static_cast<uint32_t>(mScript.functions.size())};
+  mScript.functions.push_back(it->second);
+  mFunctionIndices[funName] = index;
+  return static_cast<int32_t>(index);
+}
+
+void BytecodeCompiler::emitConversion(ValueType from, ValueType to,
+                                      int32_t depth) {
+  if (from == to || to == ValueType::Void) return;
+
+  // Bools are zero extended and shorts sign extended when stored, so widening
+  // one integer type to another is free.
+  switch (to) {
+    case ValueType::Float:
+      emit(OpCode::IntToFloat, depth);
+      break;
+    case ValueType::Long:
+      if (from == ValueType::Float) emit(OpCode::FloatToLong, depth);
+      break;
+    case ValueType::Short:
+      if (from == ValueType::Float) emit(OpCode::FloatToShort, depth);
+      else if (from == ValueType::Long) emit(OpCode::TruncShort, depth);
+      break;
+    case ValueType::Bool:
+      if (from == ValueType::Float) emit(OpCode::FloatToLong, depth);
+      emit(OpCode::TruncBool, depth);
+      break;
+    default:
+      break;
+  }
+}
+
+ValueType BytecodeCompiler::promoteArithmeticOperands(ValueType lhs,
+                                                      ValueType rhs) {
+  if (lhs == rhs) return lhs;
+
+  // If either operand is float then the other is converted to float
+  if (lhs == ValueType::Float) {
+    emitConversion(rhs, ValueType::Float, 0);
+    return ValueType::Float;
+  } else if (rhs == ValueType::Float) {
+    emitConversion(lhs, ValueType::Float, 1);
+    return ValueType::Float;
+  }
+
+  // Promote i1 -> i16 or i32
+  if (rhs == ValueType::Bool) return lhs;
+  if (lhs == ValueType::Bool) return rhs;
+
+  // Promote i16 -> i32
+  return ValueType::Long;
+}
+
+void BytecodeCompiler::convertToBool(ValueType type, int32_t depth) {
+  if (type == ValueType::Float) emit(OpCode::FloatToBool, depth);
+  else if (type != ValueType::Bool) emit(OpCode::IntToBool, depth);
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RawScriptnameStatement>(
+    const AstNode &node) {
+  if (node.children.size() == 2) mScript.name = node.children[1]->content();
+  return ValueType::Void;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RawIdentifier>(const AstNode &node) {
+  const std::string name{node.content()};
+
+  if (auto it{mLocals.find(name)}; it != mLocals.end()) {
+    emit(OpCode::LoadLocal, static_cast<int32_t>(it->second.index));
+    return it->second.type;
+  }
+
+  if (auto it{mGlobals.find(name)}; it != mGlobals.end()) {
+    emit(OpCode::LoadGlobal, static_cast<int32_t>(it->second.index));
+    return it->second.type;
+  }
+
+  const auto index{getFunctionIndex(name)};
+  if (!index) {
+    throw std::runtime_error("Variable does not exist");
+  }
+
+  const auto &fun{mScript.functions[static_cast<std::size_t>(*index)]};
+  if (fun.argTypes.size() == 1 && mCalleeRef) {
+    if (fun.argTypes[0] != ValueType::Long) {
+      throw std::runtime_error("Argument type mismatch");
+    }
+    emit(OpCode::Push, static_cast<int32_t>(*mCalleeRef));
+  } else if (!fun.argTypes.empty()) {
+    throw std::runtime_error("Incorrect number of arguments");
+  }
+
+  emit(OpCode::Call, *index);
+  return fun.returnType;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::BlockStatement>(const AstNode &node) {
+  if (node.children.empty()) return ValueType::Void;
+
+  auto blockStart{node.children.begin() + 1};
+  std::string blockName{node.children[0]->content()};
+
+  if (node.children.size() > 1
+      && node.children[1]->is<grammar::IntegerLiteral>()) {
+    blockName = node.children[0]->content() + node.children[1]->content();
+    ++blockStart;
+  }
+
+  BytecodeBlock block{};
+  block.name = blockName;
+  if (blockName == "TestLong") block.returnType = ValueType::Long;
+  else if (blockName == "TestShort") block.returnType = ValueType::Short;
+  else if (blockName == "TestFloat") block.returnType = ValueType::Float;
+
+  mBlock = &block;
+  mStackSize = 0u;
+
+  const auto locals{mLocals};
+  for (auto it{blockStart}; it != node.children.end(); ++it) {
+    visitStatement(**it);
+  }
+  mLocals = locals;
+
+  emit(OpCode::ReturnZero);
+
+  mBlock = nullptr;
+  mScript.blocks.push_back(std::move(block));
+  return ValueType::Void;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::IntegerLiteral>(const AstNode &node) {
+  emit(OpCode::Push, parseLiteral(node.content(), 10));
+  return ValueType::Long;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::FloatLiteral>(const AstNode &node) {
+  const std::string sVal{node.content()};
+  const float fVal{std::strtof(sVal.c_str(), nullptr)};
+  emit(OpCode::Push, static_cast<int32_t>(toScriptWord(fVal)));
+  return ValueType::Float;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RefLiteralContents>(const AstNode &node) {
+  emit(OpCode::Push, parseLiteral(node.content(), 16));
+  return ValueType::Long;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::DeclarationStatement>(
+    const AstNode &node) {
+  const std::string varName{node.children[1]->content()};
+  const auto &declType{node.children[0]};
+
+  // TODO: Handle reference variables correctly
+  ValueType type{ValueType::Void};
+  if (declType->is<grammar::RawShort>()) type = ValueType::Short;
+  else if (declType->is<grammar::RawLong>()) type = ValueType::Long;
+  else if (declType->is<grammar::RawRef>()) type = ValueType::Long;
+  else if (declType->is<grammar::RawFloat>()) type = ValueType::Float;
+
+  // Global variable
+  if (!mBlock) {
+    if (type == ValueType::Void) {
+      throw std::runtime_error("Unknown variable type");
+    }
+
+    // Redeclaring a global refers to the same variable.
+    if (mGlobals.find(varName) == mGlobals.end()) {
+      const auto index{static_cast<uint32_t>(mScript.globals.size())};
+      mScript.globals.push_back(BytecodeScript::Global{varName, type});
+      mGlobals[varName] = Variable{index, type};
+    }
+
+    return ValueType::Void;
+  }
+
+  if (type == ValueType::Void) return ValueType::Void;
+
+  // Keep track of it in the local function table and store an initial value
+  const uint32_t index{mBlock->numLocals++};
+  mLocals[varName] = Variable{index, type};
+  emit(OpCode::Push, 0);
+  emit(OpCode::StoreLocal, static_cast<int32_t>(index));
+
+  return ValueType::Void;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::SetStatement>(const AstNode &node) {
+  const ValueType srcType{visit(*node.children[1])};
+  if (srcType == ValueType::Void) {
+    throw std::runtime_error("Ill-formed RHS");
+  }
+
+  const std::string destName{node.children[0]->content()};
+  OpCode store{OpCode::StoreLocal};
+  Variable dest{};
+  if (auto it{mLocals.find(destName)}; it != mLocals.end()) {
+    dest = it->second;
+  } else if (auto jt{mGlobals.find(destName)}; jt != mGlobals.end()) {
+    dest = jt->second;
+    store = OpCode::StoreGlobal;
+  } else {
+    throw std::runtime_error("Variable does not exist");
+  }
+
+  emitConversion(srcType, dest.type);
+  emit(store, static_cast<int32_t>(dest.index));
+
+  return ValueType::Void;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::ReturnStatement>(const AstNode &node) {
+  if (node.children.empty()) {
+    emit(OpCode::ReturnZero);
+    return ValueType::Void;
+  }
+
+  const ValueType type{visit(*node.children[0])};
+  if (type == ValueType::Void) return ValueType::Void;
+
+  if (type != mBlock->returnType) {
+    // TODO: Try to convert the return type here
+    throw std::runtime_error("Return type mismatch");
+  }
+
+  emit(OpCode::Return);
+  return ValueType::Void;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::IfStatement>(const AstNode &node) {
+  if (node.children.empty()) {
+    throw std::runtime_error("If statement is missing condition");
+  } else if (node.children.size() == 1) {
+    throw std::runtime_error("If statement has no body");
+  }
+
+  const auto isElse = [](const std::unique_ptr<AstNode> &pNode) {
+    return pNode->is<grammar::ElseifStatement>()
+        || pNode->is<grammar::ElseStatement>();
+  };
+
+  const auto beginOfThen{node.children.begin() + 1};
+  const auto endOfThen{std::find_if(node.children.begin(), node.children.end(),
+                                    isElse)};
+
+  // Visit a body in a new scope.
+  const auto visitBody = [this](auto begin, auto end) {
+    const auto locals{mLocals};
+    for (auto it{begin}; it != end; ++it) visitStatement(**it);
+    mLocals = locals;
+  };
+
+  const ValueType condType{visit(*node.children[0])};
+  if (condType == ValueType::Void) return ValueType::Void;
+  convertToBool(condType);
+
+  // Each body ends with a jump to the end of the whole statement, and each
+  // condition jumps to the next condition, or the else body, if it fails.
+  std::vector<std::size_t> jumpsToEnd{};
+  std::optional<std::size_t> jumpToNext{emit(OpCode::JumpIfFalse)};
+  visitBody(beginOfThen, endOfThen);
+  jumpsToEnd.push_back(emit(OpCode::Jump));
+
+  for (auto it{endOfThen}; it != node.children.end(); ++it) {
+    const auto &elseIfStatement{*it};
+    mBlock->code[*jumpToNext].operand = static_cast<int32_t>(
+        mBlock->code.size());
+    jumpToNext.reset();
+
+    if (elseIfStatement->is<grammar::ElseStatement>()) {
+      // There cannot be an elseif or else following this statement, so the
+      // body just falls through to the end.
+      visitBody(elseIfStatement->children.begin(),
+                elseIfStatement->children.end());
+      break;
+    }
+
+    if (elseIfStatement->children.empty()) {
+      throw std::runtime_error("Elseif statement is missing conditition");
+    }
+
+    convertToBool(visitValue(*elseIfStatement->children[0]));
+    jumpToNext = emit(OpCode::JumpIfFalse);
+    visitBody(elseIfStatement->children.begin() + 1,
+              elseIfStatement->children.end());
+    jumpsToEnd.push_back(emit(OpCode::Jump));
+  }
+
+  const auto end{static_cast<int32_t>(mBlock->code.size())};
+  if (jumpToNext) mBlock->code[*jumpToNext].operand = end;
+  for (const auto jump : jumpsToEnd) mBlock->code[jump].operand = end;
+
+  return ValueType::Void;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::CallStatement>(const AstNode &node) {
+  return visit(*node.children[0]);
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RawCall>(const AstNode &node) {
+  const std::string funName{node.getValue()};
+  const auto index{getFunctionIndex(funName)};
+
+  if (!index) {
+    throw std::runtime_error("No such function exists");
+  }
+
+  // Copied, since visiting the arguments can add to the function table.
+  const auto fun{mScript.functions[static_cast<std::size_t>(*index)]};
+  auto argIt{fun.argTypes.begin()};
+
+  if (node.children.size() != fun.argTypes.size()) {
+    if (!mCalleeRef || node.children.size() + 1 != fun.argTypes.size()) {
+      throw std::runtime_error("Incorrect number of arguments");
+    }
+
+    // We have a callee ref and one argument missing so add in the callee ref
+    // as the first argument and try again.
+    if (*argIt != ValueType::Long) {
+      throw std::runtime_error("Argument type mismatch");
+    }
+    emit(OpCode::Push, static_cast<int32_t>(*mCalleeRef));
+    ++argIt;
+  }
+
+  for (const auto &child : node.children) {
+    if (visit(*child) != *argIt++) {
+      throw std::runtime_error("Argument type mismatch");
+    }
+  }
+
+  emit(OpCode::Call, *index);
+  return fun.returnType;
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::BinaryOperator>(const AstNode &node) {
+  if (node.children.size() != 2) {
+    throw std::runtime_error("Binary operator needs two operands");
+  }
+  const ValueType lhs{visitValue(*node.children[0])};
+  const ValueType rhs{visitValue(*node.children[1])};
+
+  std::string_view op{node.getValue()};
+
+  // Both operands of logical operators are evaluated and converted to bool.
+  if (op == "&&" || op == "||") {
+    convertToBool(lhs, 1);
+    convertToBool(rhs, 0);
+    emit(op == "&&" ? OpCode::And : OpCode::Or);
+    return ValueType::Bool;
+  }
+
+  const ValueType type{promoteArithmeticOperands(lhs, rhs)};
+
+  if (type == ValueType::Float) {
+    const auto arith = [&](OpCode code) {
+      emit(code);
+      return ValueType::Float;
+    };
+    const auto cmp = [&](OpCode code) {
+      emit(code);
+      return ValueType::Bool;
+    };
+
+    if (op == "+") return arith(OpCode::AddFloat);
+    else if (op == "-") return arith(OpCode::SubFloat);
+    else if (op == "*") return arith(OpCode::MulFloat);
+    else if (op == "/") return arith(OpCode::DivFloat);
+    else if (op == "<=") return cmp(OpCode::LeFloat);
+    else if (op == ">=") return cmp(OpCode::GeFloat);
+    else if (op == "<") return cmp(OpCode::LtFloat);
+    else if (op == ">") return cmp(OpCode::GtFloat);
+    else if (op == "==") return cmp(OpCode::EqFloat);
+    else if (op == "!=") return cmp(OpCode::NeFloat);
+  } else if (isInteger(type)) {
+    // Arithmetic is done on 32 bits, then truncated to the operand type.
+    const auto arith = [&](OpCode code) {
+      emit(code);
+      if (type == ValueType::Short) emit(OpCode::TruncShort);
+      else if (type == ValueType::Bool) emit(OpCode::TruncBool);
+      return type;
+    };
+    // As a signed i1, true is -1, so comparing bools reverses the order.
+    const bool reverse{type == ValueType::Bool};
+    const auto cmp = [&](OpCode code, OpCode reverseCode) {
+      emit(reverse ? reverseCode : code);
+      return ValueType::Bool;
+    };
+
+    if (op == "+") return arith(OpCode::AddInt);
+    else if (op == "-") return arith(OpCode::SubInt);
+    else if (op == "*") return arith(OpCode::MulInt);
+    else if (op == "/") return arith(OpCode::DivInt);
+    else if (op == "<=") return cmp(OpCode::LeInt, OpCode::GeInt);
+    else if (op == ">=") return cmp(OpCode::GeInt, OpCode::LeInt);
+    else if (op == "<") return cmp(OpCode::LtInt, OpCode::GtInt);
+    else if (op == ">") return cmp(OpCode::GtInt, OpCode::LtInt);
+    else if (op == "==") return cmp(OpCode::EqInt, OpCode::EqInt);
+    else if (op == "!=") return cmp(OpCode::NeInt, OpCode::NeInt);
+  }
+
+  throw std::runtime_error("Unknown binary operator");
+}
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::UnaryOperator>(const AstNode &node) {
+  if (node.children.size() != 1) {
+    throw std::runtime_error("Unary operator needs one operand");
+  }
+  const ValueType rhs{visitValue(*node.children[0])};
+
+  std::string_view op{node.getValue()};
+  if (op == "+") {
+    return rhs;
+  } else if (op == "-") {
+    if (rhs == ValueType::Float) {
+      emit(OpCode::NegFloat);
+      return rhs;
+    }
+    emit(OpCode::NegInt);
+    if (rhs == ValueType::Short) emit(OpCode::TruncShort);
+    else if (rhs == ValueType::Bool) emit(OpCode::TruncBool);
+    return rhs;
+  }
+
+  throw std::runtime_error("Unknown unary operator");
+}
+
+uint32_t interpret(const BytecodeScript &script, const BytecodeBlock &block,
+                   uint32_t *globals) {
+  llvm::SmallVector<uint32_t, 16> locals(block.numLocals, 0u);
+  llvm::SmallVector<uint32_t, 16> stack(block.maxStackSize + 1u, 0u);
+
+  // One past the top of the stack
+  uint32_t *sp{stack.data()};
+
+  const auto asInt = [](uint32_t word) { return static_cast<int32_t>(word); };
+  const auto asFloat = [](uint32_t word) {
+    return fromScriptWord<float>(word);
+  };
+  const auto fromBool = [](bool value) { return value ? 1u : 0u; };
+
+  // Replace the top two values with the result of `f` applied to them.
+  const auto binary = [&sp](auto &&f) {
+    --sp;
+    sp[-1] = f(sp[-1], sp[0]);
+  };
+
+  const Instruction *code{block.code.data()};
+  for (std::size_t pc{0u};;) {
+    const Instruction &ins{code[pc++]};
+    // Value that conversions are applied to
+    const auto operand{ins.operand};
+    const auto at = [&sp, operand]() -> uint32_t & {
+      return sp[-1 - operand];
+    };
+
+    switch (ins.op) {
+      case OpCode::Push: *sp++ = static_cast<uint32_t>(operand); break;
+      case OpCode::Pop: --sp; break;
+      case OpCode::LoadLocal: *sp++ = locals[operand]; break;
+      case OpCode::StoreLocal: locals[operand] = *--sp; break;
+      case OpCode::LoadGlobal: *sp++ = globals[operand]; break;
+      case OpCode::StoreGlobal: globals[operand] = *--sp; break;
+
+      case OpCode::TruncShort:
+        at() = toScriptWord(static_cast<int16_t>(at() & 0xffffu));
+        break;
+      case OpCode::TruncBool: at() &= 1u; break;
+      case OpCode::IntToFloat:
+        at() = toScriptWord(static_cast<float>(asInt(at())));
+        break;
+      case OpCode::FloatToLong:
+        at() = toScriptWord(floatToLong(asFloat(at())));
+        break;
+      case OpCode::FloatToShort:
+        at() = toScriptWord(static_cast<int16_t>(
+            static_cast<uint32_t>(floatToLong(asFloat(at()))) & 0xffffu));
+        break;
+      case OpCode::IntToBool: at() = fromBool(at() != 0u); break;
+      case OpCode::FloatToBool:
+        at() = fromBool(!(asFloat(at()) == 0.0f));
+        break;
+
+      case OpCode::AddInt:
+        binary([](uint32_t a, uint32_t b) { return a + b; });
+        break;
+      case OpCode::SubInt:
+        binary([](uint32_t a, uint32_t b) { return a - b; });
+        break;
+      case OpCode::MulInt:
+        binary([](uint32_t a, uint32_t b) { return a * b; });
+        break;
+      case OpCode::DivInt:
+        binary([&](uint32_t a, uint32_t b) {
+          return static_cast<uint32_t>(divideLong(asInt(a), asInt(b)));
+        });
+        break;
+      case OpCode::NegInt: sp[-1] = 0u - sp[-1]; break;
+
+      case OpCode::AddFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return toScriptWord(asFloat(a) + asFloat(b));
+        });
+        break;
+      case OpCode::SubFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return toScriptWord(asFloat(a) - asFloat(b));
+        });
+        break;
+      case OpCode::MulFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return toScriptWord(asFloat(a) * asFloat(b));
+        });
+        break;
+      case OpCode::DivFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return toScriptWord(asFloat(a) / asFloat(b));
+        });
+        break;
+      case OpCode::NegFloat: sp[-1] ^= 0x80000000u; break;
+
+      case OpCode::LtInt:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asInt(a) < asInt(b));
+        });
+        break;
+      case OpCode::LeInt:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asInt(a) <= asInt(b));
+        });
+        break;
+      case OpCode::GtInt:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asInt(a) > asInt(b));
+        });
+        break;
+      case OpCode::GeInt:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asInt(a) >= asInt(b));
+        });
+        break;
+      case OpCode::EqInt:
+        binary([&](uint32_t a, uint32_t b) { return fromBool(a == b); });
+        break;
+      case OpCode::NeInt:
+        binary([&](uint32_t a, uint32_t b) { return fromBool(a != b); });
+        break;
+
+      case OpCode::LtFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asFloat(a) < asFloat(b));
+        });
+        break;
+      case OpCode::LeFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asFloat(a) <= asFloat(b));
+        });
+        break;
+      case OpCode::GtFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asFloat(a) > asFloat(b));
+        });
+        break;
+      case OpCode::GeFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asFloat(a) >= asFloat(b));
+        });
+        break;
+      case OpCode::EqFloat:
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asFloat(a) == asFloat(b));
+        });
+        break;
+      case OpCode::NeFloat:
+        // Ordered, so false if either operand is NaN.
+        binary([&](uint32_t a, uint32_t b) {
+          return fromBool(asFloat(a) < asFloat(b) || asFloat(a) > asFloat(b));
+        });
+        break;
+
+      case OpCode::And:
+        binary([](uint32_t a, uint32_t b) { return a & b; });
+        break;
+      case OpCode::Or:
+        binary([](uint32_t a, uint32_t b) { return a | b; });
+        break;
+
+      case OpCode::Jump: pc = static_cast<std::size_t>(operand); break;
+      case OpCode::JumpIfFalse:
+        if (*--sp == 0u) pc = static_cast<std::size_t>(operand);
+        break;
+
+      case OpCode::Call: {
+        const auto &fun{script.functions[static_cast<std::size_t>(operand)]};
+        sp -= fun.argTypes.size();
+        const uint32_t result{fun.invoke(fun.addr, sp)};
+        if (fun.returnType != ValueType::Void) *sp++ = result;
+        break;
+      }
+
+      case OpCode::Return: return sp[-1];
+      case OpCode::ReturnZero: return 0u;
+    }
+  }
+}
+
+} // namespace oo
@@ -0,0 +1,237 @@
+#ifndef OPENOBL_SCRIPTING_BYTECODE_HPP
+#define OPENOBL_SCRIPTING_BYTECODE_HPP
+
+#include "ast.hpp"
+#include "grammar.hpp"
+#include "scripting/script_engine_base.hpp"
+#include <llvm/ADT/StringMap.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace oo {
+
+/// Type of a value in the bytecode, matching the LLVM type that
+/// `oo::LLVMVisitor` uses for the same value.
+enum class ValueType : uint8_t {
+  Void,
+  /// `i1`, stored as 0 or 1.
+  Bool,
+  /// `i16`, stored sign extended to 32 bits.
+  Short,
+  /// `i32`, used for both longs and references.
+  Long,
+  /// `float`, stored bit for bit.
+  Float
+};
+
+/// Instructions of the bytecode interpreter.
+/// The interpreter is a stack machine whose values are 32-bit words, see
+/// `oo::ValueType`. Instructions take a single operand; conversions use it as
+/// the depth of the value to convert, so that the left operand of a binary
+/// operator can be converted after the right operand has been pushed.
+enum class OpCode : uint8_t {
+  /// Push the operand.
+  Push,
+  /// Discard the top value.
+  Pop,
+  /// Push the local variable with the given index.
+  LoadLocal,
+  /// Pop a value into the local variable with the given index.
+  StoreLocal,
+  /// Push the script variable with the given index.
+  LoadGlobal,
+  /// Pop a value into the script variable with the given index.
+  StoreGlobal,
+  /// `sext i16 (trunc i32 x to i16) to i32`
+  TruncShort,
+  /// `zext i1 (trunc i32 x to i1) to i32`
+  TruncBool,
+  /// `sitofp i32 x to float`, also used for `uitofp i1`.
+  IntToFloat,
+  /// `fptosi float x to i32`
+  FloatToLong,
+  /// `fptosi float x to i16`
+  FloatToShort,
+  /// `icmp ne i32 x, 0`
+  IntToBool,
+  /// `fcmp une float x, 0.0`
+  FloatToBool,
+  AddInt, SubInt, MulInt, DivInt, NegInt,
+  AddFloat, SubFloat, MulFloat, DivFloat, NegFloat,
+  /// Signed integer comparisons.
+  LtInt, LeInt, GtInt, GeInt, EqInt, NeInt,
+  /// Ordered float comparisons.
+  LtFloat, LeFloat, GtFloat, GeFloat, EqFloat, NeFloat,
+  And, Or,
+  /// Jump to the instruction with the given index.
+  Jump,
+  /// Pop a value and jump to the instruction with the given index if it is
+  /// zero.
+  JumpIfFalse,
+  /// Call the function with the given index in the script's function table.
+  Call,
+  /// Return the top value.
+  Return,
+  /// Return zero.
+  ReturnZero
+};
+
+struct Instruction {
+  OpCode op{};
+  int32_t operand{};
+};
+
+/// An external function callable from bytecode.
+struct BytecodeFunction {
+  ValueType returnType{ValueType::Void};
+  std::vector<ValueType> argTypes{};
+  ScriptEngineBase::Invoker invoke{};
+  llvm::JITTargetAddress addr{};
+};
+
+/// A block of a script, compiled to bytecode.
+struct BytecodeBlock {
+  /// Name of the block, which is the name of the function `oo::LLVMVisitor`
+  /// would compile it into.
+  std::string name{};
+  ValueType returnType{ValueType::Void};
+  std::vector<Instruction> code{};
+  uint32_t numLocals{};
+  /// Maximum number of values on the stack at once.
+  uint32_t maxStackSize{};
+};
+
+/// A script compiled to bytecode.
+struct BytecodeScript {
+  struct Global {
+    std::string name{};
+    ValueType type{ValueType::Void};
+  };
+
+  std::string name{};
+  std::vector<BytecodeBlock> blocks{};
+  /// Script variables, indexed by the operands of `LoadGlobal` and
+  /// `StoreGlobal`.
+  std::vector<Global> globals{};
+  /// External functions, indexed by the operands of `Call`.
+  std::vector<BytecodeFunction> functions{};
+};
+
+/// Compiles the AST of a script into bytecode, with the same semantics as
+/// `oo::LLVMVisitor`: values have the same types, are converted in the same
+/// way, and the same errors are thrown for ill-formed scripts.
+/// Compiling to bytecode is much cheaper than generating machine code, which
+/// makes it suitable for scripts that are only run a few times.
+class BytecodeCompiler {
+ private:
+  const llvm::StringMap<BytecodeFunction> &mFunctions;
+  std::optional<uint32_t> mCalleeRef{};
+
+  BytecodeScript mScript{};
+  /// Block being compiled, if any.
+  BytecodeBlock *mBlock{};
+  uint32_t mStackSize{};
+
+  struct Variable {
+    uint32_t index{};
+    ValueType type{ValueType::Void};
+  };
+
+  llvm::StringMap<Variable> mLocals{};
+  llvm::StringMap<Variable> mGlobals{};
+  llvm::StringMap<uint32_t> mFunctionIndices{};
+
+  template<class NodeType> ValueType visitImpl(const AstNode &/*node*/) {
+    return ValueType::Void;
+  }
+
+  /// Append an instruction to the current block, returning its index.
+  std::size_t emit(OpCode op, int32_t operand = 0);
+
+  /// Visit a node that must produce a value.
+  ValueType visitValue(const AstNode &node);
+
+  /// Visit a statement, discarding any value it produces.
+  void visitStatement(const AstNode &node);
+
+  /// Return the index of the named function in the script's function table,
+  /// adding it if necessary, or `std::nullopt` if there is no such function.
+  std::optional<int32_t> getFunctionIndex(const std::string &funName);
+
+  /// Convert the value at the given depth from one type to another, as
+  /// `oo::LLVMVisitor` would when storing it into a variable.
+  void emitConversion(ValueType from, ValueType to, int32_t depth = 0);
+
+  /// Convert the top two values to a common type as in
+  /// `oo::LLVMVisitor::promoteArithmeticOperands()`, returning it.
+  ValueType promoteArithmeticOperands(ValueType lhs, ValueType rhs);
+
+  /// Convert the value at the given depth to a bool as in
+  /// `oo::LLVMVisitor::convertToBool()`.
+  void convertToBool(ValueType type, int32_t depth = 0);
+
+ public:
+  explicit BytecodeCompiler(const llvm::StringMap<BytecodeFunction> &functions,
+                            std::optional<uint32_t> calleeRef = std::nullopt);
+
+  /// Compile the root of a script's AST.
+  /// \throws std::runtime_error if the script is ill-formed.
+  [[nodiscard]] BytecodeScript compile(const AstNode &root);
+
+  ValueType visit(const AstNode &node);
+};
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RawScriptnameStatement>(
+    const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RawIdentifier>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::BlockStatement>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::IntegerLiteral>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::FloatLiteral>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RefLiteralContents>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::DeclarationStatement>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::SetStatement>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::ReturnStatement>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::IfStatement>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::CallStatement>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::RawCall>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::UnaryOperator>(const AstNode &node);
+
+template<> ValueType
+BytecodeCompiler::visitImpl<grammar::BinaryOperator>(const AstNode &node);
+
+/// Run a block of a script in the interpreter, returning its return value, or
+/// zero if it does not return one.
+/// \param globals The values of the script's variables.
+uint32_t interpret(const BytecodeScript &script, const BytecodeBlock &block,
+                   uint32_t *globals);
+
+} // namespace oo
+
+#endif // OPENOBL_SCRIPTING_BYTECODE_HPP
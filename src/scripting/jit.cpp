@@ -47,7 +47,8 @@ Jit::Jit() : mResolver{makeResolver(mSession, mLookupHelper)},
              mTarget{llvm::EngineBuilder{}.selectTarget()},
              mDataLayout{mTarget->createDataLayout()},
              mObjectLayer(mSession, mResourceHelper),
-             mCompileLayer(mObjectLayer, llvm::orc::SimpleCompiler(*mTarget)),
+             mCompileLayer(mObjectLayer,
+                           llvm::orc::SimpleCompiler(*mTarget, &mCache)),
              mOptimizeLayer(mCompileLayer, mOptimizeHelper) {
   // Load the containing process as a library, making all its exported symbols
   // available for calling in JIT'd code.
@@ -64,6 +65,26 @@ llvm::orc::VModuleKey Jit::addModule(std::unique_ptr<llvm::Module> module) {
   return key;
 }
 
+llvm::orc::VModuleKey
+Jit::addOptimizedModule(std::unique_ptr<llvm::Module> module) {
+  const auto key{mSession.allocateVModule()};
+  llvm::cantFail(mCompileLayer.addModule(key, std::move(module)));
+  return key;
+}
+
+llvm::Expected<llvm::orc::VModuleKey>
+Jit::addObject(std::unique_ptr<llvm::MemoryBuffer> object) {
+  const auto key{mSession.allocateVModule()};
+  if (auto err{mObjectLayer.addObject(key, std::move(object))}) {
+    return std::move(err);
+  }
+  return key;
+}
+
+oo::ScriptCache &Jit::getCache() noexcept {
+  return mCache;
+}
+
 llvm::JITSymbol Jit::findSymbol(llvm::StringRef name) noexcept {
   std::string mangledName{};
   llvm::raw_string_ostream mangledNameStream(mangledName);
@@ -1,6 +1,7 @@
 #ifndef OPENOBL_SCRIPTING_JIT_HPP
 #define OPENOBL_SCRIPTING_JIT_HPP
 
+#include "script_cache.hpp"
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/Core.h>
@@ -14,6 +15,7 @@
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Mangler.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Target/TargetMachine.h>
 #include <memory>
 
@@ -70,15 +72,13 @@ class Jit {
   std::shared_ptr<llvm::orc::SymbolResolver> mResolver;
   std::unique_ptr<llvm::TargetMachine> mTarget;
   llvm::DataLayout mDataLayout;
+  /// Cache that the compile layer saves the object code of modules into.
+  /// Declared before the compile layer, which keeps a pointer to it.
+  oo::ScriptCache mCache{};
   ObjectLayer mObjectLayer;
   CompileLayer mCompileLayer;
   OptimizeLayer mOptimizeLayer;
 
-  /// Take the given module, run a bunch of optimization passes on it, and
-  /// return the now-optimized module.
-  std::unique_ptr<llvm::Module>
-  optimizeModule(std::unique_ptr<llvm::Module> module);
-
   /// Symbol lookup function for the llvm::orc::SymbolResolver.
   /// Looks for the symbol in the JIT'd modules first, then in the current
   /// process if one wasn't found. This makes it possible for scripts to
@@ -92,10 +92,32 @@ class Jit {
   /// Return the target (host, in this case) machine.
   [[nodiscard]] llvm::TargetMachine &getTargetMachine() const noexcept;
 
+  /// Take the given module, run a bunch of optimization passes on it, and
+  /// return the now-optimized module.
+  /// This does not depend on the JIT, so can be called on any thread for
+  /// modules in a context that is not being used by another thread.
+  static std::unique_ptr<llvm::Module>
+  optimizeModule(std::unique_ptr<llvm::Module> module);
+
   /// Take ownership of the given module and immediately compile it, returning a
   /// handle to the JIT'd module.
   llvm::orc::VModuleKey addModule(std::unique_ptr<llvm::Module> module);
 
+  /// Take ownership of the given module, which has already been passed through
+  /// `optimizeModule()`, and immediately compile it without optimizing it
+  /// again, returning a handle to the JIT'd module.
+  llvm::orc::VModuleKey
+  addOptimizedModule(std::unique_ptr<llvm::Module> module);
+
+  /// Take ownership of the given object code, previously compiled from a
+  /// module by this JIT, and add it without compiling anything, returning a
+  /// handle to it that can be used like the handle to a JIT'd module.
+  llvm::Expected<llvm::orc::VModuleKey>
+  addObject(std::unique_ptr<llvm::MemoryBuffer> object);
+
+  /// Return the cache of compiled object code.
+  [[nodiscard]] oo::ScriptCache &getCache() noexcept;
+
   /// Get a (possible null) handle to the named symbol, across all JIT'd
   /// modules. If multiple JIT'd modules contain a symbol with the given name,
   /// it is undefined which one is returned.
@@ -0,0 +1,153 @@
+#include "script_cache.hpp"
+#include "util/atomic_file.hpp"
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/MD5.h>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <system_error>
+
+namespace oo {
+
+namespace {
+
+/// Header at the start of every cache file, followed by `nameSize` bytes of
+/// script name and `objectSize` bytes of object code.
+struct ScriptCacheHeader {
+  std::array<char, 4> magic{'O', 'S', 'C', 'R'};
+  uint32_t version{1u};
+  uint32_t nameSize{0u};
+  uint32_t objectSize{0u};
+
+  bool isCompatibleWith(const ScriptCacheHeader &other) const noexcept {
+    return magic == other.magic && version == other.version;
+  }
+};
+
+} // namespace
+
+void ScriptCache::setDirectory(const std::string &directory) {
+  std::filesystem::path path{directory};
+  if (!path.empty()) {
+    std::error_code ec{};
+    std::filesystem::create_directories(path, ec);
+    if (ec) path.clear();
+  }
+
+  mDirectory = std::move(path);
+}
+
+bool ScriptCache::isEnabled() const noexcept {
+  return !mDirectory.empty();
+}
+
+std::string ScriptCache::makeKey(const KeySource &source) {
+  // Each field is terminated so that text cannot move between adjacent fields
+  // without changing the hash.
+  llvm::MD5 hash{};
+  const auto update = [&hash](llvm::StringRef field) {
+    hash.update(field);
+    hash.update(llvm::StringRef("\0", 1));
+  };
+
+  update(source.compilerVersion);
+  update(source.targetTriple);
+  update(source.targetCpu);
+  update(source.targetFeatures);
+  update(source.externalFunctions);
+  update(source.calleeRef ? std::to_string(*source.calleeRef) : "-");
+  update(source.script);
+
+  llvm::MD5::MD5Result result{};
+  hash.final(result);
+  return std::string(result.digest().str());
+}
+
+void ScriptCache::setKey(llvm::Module &module, llvm::StringRef key) {
+  module.setSourceFileName((llvm::Twine(KEY_PREFIX) + key).str());
+}
+
+llvm::StringRef ScriptCache::getKey(const llvm::Module &module) {
+  llvm::StringRef sourceName{module.getSourceFileName()};
+  if (!sourceName.consume_front(KEY_PREFIX)) return "";
+  return sourceName;
+}
+
+std::filesystem::path ScriptCache::getEntryPath(llvm::StringRef key) const {
+  if (mDirectory.empty() || key.empty()) return {};
+  return mDirectory / (key.str() + ".obj");
+}
+
+bool ScriptCache::contains(llvm::StringRef key) const {
+  const auto path{getEntryPath(key)};
+  std::error_code ec{};
+  return !path.empty() && std::filesystem::exists(path, ec);
+}
+
+std::optional<ScriptCache::Entry> ScriptCache::load(llvm::StringRef key) const {
+  const auto path{getEntryPath(key)};
+  if (path.empty()) return std::nullopt;
+
+  std::ifstream is{path, std::ios::binary};
+  if (!is) return std::nullopt;
+
+  ScriptCacheHeader header{};
+  is.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!is || !header.isCompatibleWith(ScriptCacheHeader{})
+      || header.nameSize == 0u || header.objectSize == 0u) {
+    return std::nullopt;
+  }
+
+  Entry entry{};
+  entry.name.resize(header.nameSize);
+  is.read(entry.name.data(), header.nameSize);
+  if (!is) return std::nullopt;
+
+  // The object layer parses the object in place, so it must be suitably
+  // aligned, which a new memory buffer is.
+  auto object{llvm::WritableMemoryBuffer::getNewUninitMemBuffer(
+      header.objectSize, path.string())};
+  if (!object) return std::nullopt;
+
+  is.read(object->getBufferStart(), header.objectSize);
+  if (!is || is.gcount() != static_cast<std::streamsize>(header.objectSize)) {
+    return std::nullopt;
+  }
+
+  entry.object = std::move(object);
+  return entry;
+}
+
+void ScriptCache::save(llvm::StringRef key, llvm::StringRef name,
+                       llvm::MemoryBufferRef object) const {
+  const auto path{getEntryPath(key)};
+  if (path.empty() || name.empty()) return;
+
+  ScriptCacheHeader header{};
+  header.nameSize = static_cast<uint32_t>(name.size());
+  header.objectSize = static_cast<uint32_t>(object.getBufferSize());
+  if (header.objectSize == 0u) return;
+
+  // Another thread or process must never see a partially written entry.
+  oo::writeFileAtomically(path, [&](std::ostream &os) {
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os.write(name.data(), header.nameSize);
+    os.write(object.getBufferStart(), header.objectSize);
+  });
+}
+
+void ScriptCache::notifyObjectCompiled(const llvm::Module *module,
+                                       llvm::MemoryBufferRef object) {
+  if (!module) return;
+  save(getKey(*module), module->getName(), object);
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+ScriptCache::getObject(const llvm::Module *module) {
+  if (!module) return nullptr;
+  auto entry{load(getKey(*module))};
+  if (!entry || entry->name != module->getName()) return nullptr;
+  return std::move(entry->object);
+}
+
+} // namespace oo
@@ -0,0 +1,122 @@
+#ifndef OPENOBL_SCRIPTING_SCRIPT_CACHE_HPP
+#define OPENOBL_SCRIPTING_SCRIPT_CACHE_HPP
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace oo {
+
+/// On-disk cache of the native object code of compiled scripts.
+///
+/// Parsing a script, lowering it to IR, optimizing it, and generating machine
+/// code is slow enough that compiling every script in a plugin would add
+/// noticeably to the load time. The object code produced for a script only
+/// depends on the script's source text, on the external functions that it can
+/// call, and on the compiler, so it is written to disk and loaded straight
+/// into the JIT's object layer the next time the same script is compiled,
+/// skipping every other step.
+///
+/// Entries are keyed by a hash of everything the object code depends on; see
+/// `makeKey()`. The cache is told about new object code by
+/// the JIT's compiler, which passes it every module it compiles. Only modules
+/// whose source file name has been set to a cache key with `setKey()` are
+/// saved, so modules that are not worth caching, such as console commands, can
+/// go through the same compiler.
+///
+/// The cache is disabled until `setDirectory()` is called with a nonempty path.
+class ScriptCache : public llvm::ObjectCache {
+ public:
+  /// A cached script.
+  struct Entry {
+    /// Name of the script, which is the name of its module.
+    std::string name{};
+    /// Object code of the script.
+    std::unique_ptr<llvm::MemoryBuffer> object{};
+  };
+
+  /// Everything that the object code of a script depends on.
+  struct KeySource {
+    /// Version of the compiler, which determines the optimization passes and
+    /// code generator used.
+    llvm::StringRef compilerVersion{};
+    llvm::StringRef targetTriple{};
+    llvm::StringRef targetCpu{};
+    llvm::StringRef targetFeatures{};
+    /// Signatures of the external functions that the script can call.
+    llvm::StringRef externalFunctions{};
+    /// Reference of the object that the script is attached to, if any.
+    std::optional<uint32_t> calleeRef{};
+    /// Source text of the script.
+    llvm::StringRef script{};
+  };
+
+  ScriptCache() = default;
+  ~ScriptCache() override = default;
+  ScriptCache(const ScriptCache &) = delete;
+  ScriptCache &operator=(const ScriptCache &) = delete;
+  ScriptCache(ScriptCache &&) = delete;
+  ScriptCache &operator=(ScriptCache &&) = delete;
+
+  /// Set the directory that cache entries are stored in, creating it if
+  /// necessary. An empty path disables the cache.
+  void setDirectory(const std::string &directory);
+
+  /// Whether `setDirectory()` has been called with a usable directory.
+  bool isEnabled() const noexcept;
+
+  /// Return the key of the script whose object code depends on `source`.
+  /// Keys of sources differing in any field are different, barring hash
+  /// collisions.
+  static std::string makeKey(const KeySource &source);
+
+  /// Mark `module` to be saved in the cache under the given key when it is
+  /// compiled.
+  static void setKey(llvm::Module &module, llvm::StringRef key);
+
+  /// Whether there is an entry with the given key in the cache. The entry is
+  /// not checked to be usable.
+  bool contains(llvm::StringRef key) const;
+
+  /// Load the entry with the given key from the cache.
+  /// \returns `std::nullopt` if the cache is disabled or there is no usable
+  ///          entry.
+  std::optional<Entry> load(llvm::StringRef key) const;
+
+  /// Write `object` into the cache under the given key. Failures are not
+  /// reported, the script will just be compiled again next time.
+  void save(llvm::StringRef key, llvm::StringRef name,
+            llvm::MemoryBufferRef object) const;
+
+  /// \name ObjectCache overrides
+  /// @{
+  void notifyObjectCompiled(const llvm::Module *module,
+                            llvm::MemoryBufferRef object) override;
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module *module) override;
+  /// @}
+
+ private:
+  /// Prefix of the source file name of modules marked with `setKey()`.
+  constexpr static const char *KEY_PREFIX{"oo-script-cache:"};
+
+  std::filesystem::path mDirectory{};
+
+  /// Return the key that `module` was marked with, or an empty string if it
+  /// was not marked.
+  static llvm::StringRef getKey(const llvm::Module &module);
+
+  /// Return the path of the entry with the given key, or an empty path if the
+  /// cache is disabled.
+  std::filesystem::path getEntryPath(llvm::StringRef key) const;
+};
+
+} // namespace oo
+
+#endif // OPENOBL_SCRIPTING_SCRIPT_CACHE_HPP
@@ -1,25 +1,173 @@
 #include "ast.hpp"
+#include "bytecode.hpp"
 #include "jit.hpp"
 #include "llvm.hpp"
 #include "scripting/logging.hpp"
 #include "scripting/script_engine.hpp"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
 
 namespace oo {
 
+namespace {
+
+/// Return the `llvm::LLVMContext` of the calling thread. Contexts are not
+/// thread-safe, so each thread that prepares scripts needs its own. The
+/// modules only live in it until they are written out as bitcode.
+llvm::LLVMContext &getThreadContext() {
+  thread_local llvm::LLVMContext ctx{};
+  return ctx;
+}
+
+/// Return the bytecode type of the given LLVM type, if it has one.
+std::optional<ValueType> toValueType(llvm::Type *type) {
+  if (type->isVoidTy()) return ValueType::Void;
+  if (type->isIntegerTy(1)) return ValueType::Bool;
+  if (type->isIntegerTy(16)) return ValueType::Short;
+  if (type->isIntegerTy(32)) return ValueType::Long;
+  if (type->isFloatTy()) return ValueType::Float;
+  return std::nullopt;
+}
+
+} // namespace
+
+/// A script compiled with a JIT threshold, which is interpreted until it is
+/// called often enough to be worth compiling to machine code.
+struct ScriptEngine::TieredScript {
+  std::string source{};
+  std::optional<uint32_t> calleeRef{};
+  BytecodeScript bytecode{};
+
+  /// Guards `globals` and `numCalls`, and serializes the interpreter with
+  /// the switch to machine code.
+  std::mutex mutex{};
+  /// Values of the script's variables while it is being interpreted.
+  std::vector<uint32_t> globals{};
+  /// Number of times each block has been interpreted.
+  std::vector<uint32_t> numCalls{};
+
+  /// Address of the machine code of each block, or zero while the script is
+  /// being interpreted. Every block is switched over at once.
+  std::unique_ptr<std::atomic<llvm::JITTargetAddress>[]> entries{};
+  /// Addresses of the machine code of each block and the script's variables,
+  /// written by the background compilation before it sets `isCompiled`.
+  std::vector<llvm::JITTargetAddress> blockAddrs{};
+  std::vector<llvm::JITTargetAddress> globalAddrs{};
+
+  std::atomic<bool> isPromoting{false};
+  std::atomic<bool> isCompiled{false};
+
+  /// Background compilation of the script. Declared last so that it is
+  /// waited on before anything it uses is destroyed.
+  std::future<void> promotion{};
+};
+
 class ScriptEngine::Impl {
  private:
   nostdx::propagate_const<ScriptEngine *> mParent;
 
+  std::once_flag mBytecodeFunctionsFlag{};
+  llvm::StringMap<BytecodeFunction> mBytecodeFunctions{};
+
  public:
+  /// Guards the JIT and `mPending`, which the second stage of compilation and
+  /// calls to scripts can touch from different threads.
+  std::mutex mMutex{};
+
+  /// Scripts that have been added but whose machine code has not yet been
+  /// generated, indexed by name.
+  llvm::StringMap<PreparedScript> mPending{};
+
+  uint32_t mJitThreshold{0u};
+
+  /// Guards `mTiered`. When taken along with `mMutex`, both must be taken at
+  /// once with `std::scoped_lock`.
+  std::mutex mTieredMutex{};
+
+  /// Scripts that are interpreted until they are called often enough, indexed
+  /// by name. Declared last so that background compilations finish while the
+  /// rest of the engine is still alive.
+  /// \remark A `TieredScript` waits for its background compilation when it is
+  ///         destroyed, which takes `mMutex`, so the last reference to one must
+  ///         never be released while `mMutex` is held.
+  llvm::StringMap<std::shared_ptr<TieredScript>> mTiered{};
+
   /// Get the scriptname from a RawScriptnameStatement.
   /// If `node` does not represent a RawScriptnameStatement, then an empty
   /// string is returned.template<class T> T
   [[nodiscard]] std::string getScriptname(const AstNode &node) const;
 
-  /// Compile an entire AST into LLVM IR.
+  /// Return the key of the given script in the cache, or an empty string if
+  /// the cache is disabled.
+  [[nodiscard]] std::string getCacheKey(std::string_view script,
+                                        std::optional<uint32_t> calleeRef,
+                                        llvm::LLVMContext &ctx);
+
+  /// Compile an entire AST into LLVM IR in the given context.
   /// \remark The returned module must still be JIT'd before it can be called.
   [[nodiscard]] std::unique_ptr<llvm::Module>
-  compileAst(const AstNode &root, std::optional<uint32_t> calleeRef = {});
+  compileAst(const AstNode &root, llvm::LLVMContext &ctx,
+             std::optional<uint32_t> calleeRef = {});
+
+  /// Generate the machine code of the pending script with the given name, if
+  /// there is one.
+  /// \remark `mMutex` must be held by the caller.
+  void materialize(llvm::StringRef scriptName);
+
+  /// Generate the machine code of a prepared script.
+  /// \returns `std::nullopt` if the script could not be loaded into the JIT.
+  /// \remark `mMutex` must be held by the caller.
+  std::optional<llvm::orc::VModuleKey> jitPrepared(PreparedScript script);
+
+  /// Return the address of the given function of the given script,
+  /// generating the script's machine code if it is pending.
+  /// \remark `mMutex` must be held by the caller.
+  [[nodiscard]] std::optional<llvm::JITTargetAddress>
+  getFunctionAddr(llvm::StringRef scriptName, llvm::StringRef funName);
+
+  /// Return the address of the named symbol in the given module.
+  /// \remark `mMutex` must be held by the caller.
+  [[nodiscard]] std::optional<llvm::JITTargetAddress>
+  findSymbol(llvm::StringRef name, llvm::orc::VModuleKey key);
+
+  /// Return the external functions in the form used by the bytecode
+  /// compiler, skipping any whose types the interpreter cannot represent.
+  [[nodiscard]] const llvm::StringMap<BytecodeFunction> &getBytecodeFunctions();
+
+  /// Whether the object code of the given script is in the cache.
+  [[nodiscard]] bool isCached(std::string_view script,
+                              std::optional<uint32_t> calleeRef);
+
+  /// Parse a script and compile it to bytecode.
+  /// \returns `nullptr` if the script could not be compiled, in which case it
+  ///          should be compiled to machine code to report the error.
+  [[nodiscard]] std::shared_ptr<TieredScript>
+  makeTieredScript(std::string_view script, std::optional<uint32_t> calleeRef);
+
+  /// Return the index of the named block of the given script.
+  [[nodiscard]] std::optional<std::size_t>
+  findBlock(const TieredScript &script, llvm::StringRef funName) const;
+
+  /// Call the given block of the given script in the interpreter or in its
+  /// machine code, starting a background compilation if it is hot enough.
+  [[nodiscard]] ScriptEngine::Dispatch
+  run(TieredScript &script, std::size_t index);
+
+  /// Compile a script to machine code and record the addresses of its blocks
+  /// and variables. Run on a background thread.
+  void promote(TieredScript &script);
+
+  /// Copy the interpreter's values of a script's variables into its machine
+  /// code, then switch its blocks over to the machine code.
+  /// \remark `script.mutex` must be held by the caller.
+  void finishPromotion(TieredScript &script);
 
   explicit Impl(ScriptEngine *parent) noexcept : mParent(parent) {}
 };
@@ -37,8 +185,30 @@ std::string ScriptEngine::Impl::getScriptname(const AstNode &node) const {
   return node.children[1]->content();
 }
 
+std::string
+ScriptEngine::Impl::getCacheKey(std::string_view script,
+                                std::optional<uint32_t> calleeRef,
+                                llvm::LLVMContext &ctx) {
+  auto *jit{mParent->getJit()};
+  if (!jit->getCache().isEnabled()) return "";
+
+  const auto &target{jit->getTargetMachine()};
+  const auto triple{target.getTargetTriple().str()};
+  const auto externals{mParent->getExternalFunsSignature(ctx)};
+
+  oo::ScriptCache::KeySource source{};
+  source.compilerVersion = LLVM_VERSION_STRING;
+  source.targetTriple = triple;
+  source.targetCpu = target.getTargetCPU();
+  source.targetFeatures = target.getTargetFeatureString();
+  source.externalFunctions = externals;
+  source.calleeRef = calleeRef;
+  source.script = llvm::StringRef(script.data(), script.size());
+  return oo::ScriptCache::makeKey(source);
+}
+
 std::unique_ptr<llvm::Module>
-ScriptEngine::Impl::compileAst(const AstNode &root,
+ScriptEngine::Impl::compileAst(const AstNode &root, llvm::LLVMContext &ctx,
                                std::optional<uint32_t> calleeRef) {
   if (!root.is_root() || root.children.empty()) {
     // TODO: Cannot compile a partial AST, throw
@@ -51,7 +221,7 @@ ScriptEngine::Impl::compileAst(const AstNode &root,
     return nullptr;
   }
 
-  auto module{mParent->makeModule(moduleName)};
+  auto module{mParent->makeModule(moduleName, ctx)};
   mParent->addExternalFunsToModule(module.get());
   auto visitor{calleeRef ? mParent->makeVisitor(module.get(), *calleeRef)
                          : mParent->makeVisitor(module.get())};
@@ -60,53 +230,378 @@ ScriptEngine::Impl::compileAst(const AstNode &root,
   return module;
 }
 
+void ScriptEngine::Impl::materialize(llvm::StringRef scriptName) {
+  const auto it{mPending.find(scriptName)};
+  if (it == mPending.end()) return;
+  auto script{std::move(it->second)};
+  mPending.erase(it);
+
+  (void) jitPrepared(std::move(script));
+}
+
+std::optional<llvm::orc::VModuleKey>
+ScriptEngine::Impl::jitPrepared(PreparedScript script) {
+  if (script.object) {
+    if (!mParent->jitObject(script.name, std::move(script.object))) {
+      oo::scriptingLogger()->warn("Ignoring invalid cached script '{}'",
+                                  script.name);
+      return std::nullopt;
+    }
+    return mParent->getModules().lookup(script.name);
+  }
+
+  // The bitcode keeps the cache key in the module's source file name, so the
+  // JIT's compiler still passes the object code to the cache.
+  auto moduleOrErr{llvm::parseBitcodeFile(
+      llvm::MemoryBufferRef(script.bitcode, script.name),
+      mParent->getContext())};
+  if (llvm::Error err = moduleOrErr.takeError()) {
+    llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase &e) {
+      oo::scriptingLogger()->warn("JIT error: {}", e.message());
+    });
+    return std::nullopt;
+  }
+
+  return mParent->jitOptimizedModule(std::move(*moduleOrErr));
+}
+
 std::optional<llvm::JITTargetAddress>
-ScriptEngine::getFunctionAddr(const std::string &scriptName,
-                              const std::string &funName) {
+ScriptEngine::Impl::findSymbol(llvm::StringRef name,
+                               llvm::orc::VModuleKey key) {
+  auto symbol{mParent->getJit()->findSymbolIn(name, key)};
+  if (!symbol) return std::nullopt;
+
+  auto addrOrErr{symbol.getAddress()};
+  if (llvm::Error err = addrOrErr.takeError()) {
+    llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase &e) {
+      oo::scriptingLogger()->warn("JIT error: {}", e.message());
+    });
+    return std::nullopt;
+  }
+
+  return *addrOrErr;
+}
+
+std::optional<llvm::JITTargetAddress>
+ScriptEngine::Impl::getFunctionAddr(llvm::StringRef scriptName,
+                                    llvm::StringRef funName) {
+  materialize(scriptName);
+
   // Find the module containing the script
-  const auto keyIt{getModules().find(scriptName)};
-  if (keyIt == getModules().end()) {
+  const auto &modules{mParent->getModules()};
+  const auto keyIt{modules.find(scriptName)};
+  if (keyIt == modules.end()) {
     oo::scriptingLogger()->warn("Script '{}' does not exist", scriptName);
     return std::nullopt;
   }
 
   // Find the function in the module
-  auto entrySymbol{getJit()->findSymbolIn(funName, keyIt->second)};
-  if (!entrySymbol) {
+  auto addr{findSymbol(funName, keyIt->second)};
+  if (!addr) {
     oo::scriptingLogger()->warn("No function '{}' in script '{}'",
                                 funName, scriptName);
+  }
+
+  return addr;
+}
+
+const llvm::StringMap<BytecodeFunction> &
+ScriptEngine::Impl::getBytecodeFunctions() {
+  std::call_once(mBytecodeFunctionsFlag, [this]() {
+    for (const auto &fun : mParent->getExternalFuns(getThreadContext())) {
+      const auto returnType{toValueType(fun.proto->getReturnType())};
+      if (!returnType || !fun.addr) continue;
+
+      BytecodeFunction bytecodeFun{*returnType, {}, fun.invoke, fun.addr};
+      for (auto *paramType : fun.proto->params()) {
+        const auto argType{toValueType(paramType)};
+        if (!argType || *argType == ValueType::Void) {
+          bytecodeFun.invoke = nullptr;
+          break;
+        }
+        bytecodeFun.argTypes.push_back(*argType);
+      }
+
+      if (bytecodeFun.invoke) mBytecodeFunctions[fun.name] = bytecodeFun;
+    }
+  });
+
+  return mBytecodeFunctions;
+}
+
+bool ScriptEngine::Impl::isCached(std::string_view script,
+                                  std::optional<uint32_t> calleeRef) {
+  const auto key{getCacheKey(script, calleeRef, getThreadContext())};
+  return !key.empty() && mParent->getJit()->getCache().contains(key);
+}
+
+std::shared_ptr<ScriptEngine::TieredScript>
+ScriptEngine::Impl::makeTieredScript(std::string_view script,
+                                     std::optional<uint32_t> calleeRef) {
+  pegtl::memory_input in(script, "");
+  const auto root{oo::parseScript(in)};
+  if (!root) return nullptr;
+
+  auto tiered{std::make_shared<TieredScript>()};
+  try {
+    BytecodeCompiler compiler(getBytecodeFunctions(), calleeRef);
+    tiered->bytecode = compiler.compile(*root);
+  } catch (const std::runtime_error &) {
+    return nullptr;
+  }
+  if (tiered->bytecode.name.empty()) return nullptr;
+
+  const auto numBlocks{tiered->bytecode.blocks.size()};
+  tiered->source = std::string(script);
+  tiered->calleeRef = calleeRef;
+  tiered->globals.resize(tiered->bytecode.globals.size());
+  tiered->numCalls.resize(numBlocks);
+  tiered->entries =
+      std::make_unique<std::atomic<llvm::JITTargetAddress>[]>(numBlocks);
+  for (std::size_t i = 0; i < numBlocks; ++i) tiered->entries[i] = 0u;
+
+  return tiered;
+}
+
+std::optional<std::size_t>
+ScriptEngine::Impl::findBlock(const TieredScript &script,
+                              llvm::StringRef funName) const {
+  const auto &blocks{script.bytecode.blocks};
+  const auto blockIt{std::find_if(blocks.begin(), blocks.end(),
+                                  [&](const BytecodeBlock &block) {
+                                    return block.name == funName;
+                                  })};
+  if (blockIt == blocks.end()) {
+    oo::scriptingLogger()->warn("No function '{}' in script '{}'",
+                                funName, script.bytecode.name);
     return std::nullopt;
   }
 
-  // Get the function's address
-  auto entryOrErr{entrySymbol.getAddress()};
-  if (llvm::Error err = entryOrErr.takeError()) {
-    llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase &e) {
-      oo::scriptingLogger()->warn("JIT error: {}", e.message());
+  return static_cast<std::size_t>(blockIt - blocks.begin());
+}
+
+ScriptEngine::Dispatch
+ScriptEngine::Impl::run(TieredScript &script, std::size_t index) {
+  if (auto addr{script.entries[index].load(std::memory_order_acquire)}) {
+    return addr;
+  }
+
+  std::scoped_lock lock{script.mutex};
+  if (script.isCompiled.load(std::memory_order_acquire)) {
+    finishPromotion(script);
+    return script.entries[index].load(std::memory_order_relaxed);
+  }
+
+  // Any block being hot enough promotes the whole script, since the blocks
+  // share the script's variables.
+  if (++script.numCalls[index] == mJitThreshold
+      && !script.isPromoting.exchange(true)) {
+    script.promotion = std::async(std::launch::async, [this, &script]() {
+      promote(script);
     });
-    return std::nullopt;
   }
 
-  return *entryOrErr;
+  return InterpretedResult{interpret(script.bytecode,
+                                     script.bytecode.blocks[index],
+                                     script.globals.data())};
+}
+
+void ScriptEngine::Impl::promote(TieredScript &script) {
+  const auto &bytecode{script.bytecode};
+
+  std::optional<PreparedScript> prepared{};
+  try {
+    prepared = mParent->prepare(script.source, script.calleeRef);
+  } catch (const std::exception &e) {
+    oo::scriptingLogger()->warn("Failed to compile script '{}': {}",
+                                bytecode.name, e.what());
+  }
+  if (!prepared) return;
+
+  std::scoped_lock lock{mMutex};
+  const auto key{jitPrepared(std::move(*prepared))};
+  if (!key) return;
+
+  // The script keeps being interpreted unless every block and variable can be
+  // found, so that the two are never mixed.
+  std::vector<llvm::JITTargetAddress> blockAddrs{};
+  for (const auto &block : bytecode.blocks) {
+    const auto addr{findSymbol(block.name, *key)};
+    if (!addr) return;
+    blockAddrs.push_back(*addr);
+  }
+
+  std::vector<llvm::JITTargetAddress> globalAddrs{};
+  for (const auto &global : bytecode.globals) {
+    const auto addr{findSymbol(global.name, *key)};
+    if (!addr) return;
+    globalAddrs.push_back(*addr);
+  }
+
+  script.blockAddrs = std::move(blockAddrs);
+  script.globalAddrs = std::move(globalAddrs);
+  script.isCompiled.store(true, std::memory_order_release);
+}
+
+void ScriptEngine::Impl::finishPromotion(TieredScript &script) {
+  const auto &globals{script.bytecode.globals};
+  for (std::size_t i = 0; i < globals.size(); ++i) {
+    auto *ptr{reinterpret_cast<void *>(
+        static_cast<std::uintptr_t>(script.globalAddrs[i]))};
+    const uint32_t word{script.globals[i]};
+
+    switch (globals[i].type) {
+      case ValueType::Short: {
+        const auto value{fromScriptWord<int16_t>(word)};
+        std::memcpy(ptr, &value, sizeof(value));
+        break;
+      }
+      case ValueType::Long: {
+        const auto value{fromScriptWord<int32_t>(word)};
+        std::memcpy(ptr, &value, sizeof(value));
+        break;
+      }
+      case ValueType::Float: {
+        const auto value{fromScriptWord<float>(word)};
+        std::memcpy(ptr, &value, sizeof(value));
+        break;
+      }
+      default: break;
+    }
+  }
+
+  for (std::size_t i = 0; i < script.blockAddrs.size(); ++i) {
+    script.entries[i].store(script.blockAddrs[i], std::memory_order_release);
+  }
+}
+
+bool ScriptEngine::Handle::isNative() const noexcept {
+  if (mAddr) return true;
+  return mTiered
+      && mTiered->entries[mBlock].load(std::memory_order_acquire) != 0u;
+}
+
+ScriptEngine::Dispatch
+ScriptEngine::dispatch(const std::string &scriptName,
+                       const std::string &funName) {
+  return dispatch(resolve(scriptName, funName));
+}
+
+ScriptEngine::Dispatch ScriptEngine::dispatch(const Handle &handle) {
+  if (handle.mAddr) return handle.mAddr;
+  if (handle.mTiered) return mImpl->run(*handle.mTiered, handle.mBlock);
+  return std::monostate{};
+}
+
+ScriptEngine::Handle
+ScriptEngine::resolve(const std::string &scriptName,
+                      const std::string &funName) {
+  Handle handle{};
+  {
+    std::scoped_lock lock{mImpl->mTieredMutex};
+    handle.mTiered = mImpl->mTiered.lookup(scriptName);
+  }
+
+  if (handle.mTiered) {
+    if (const auto index{mImpl->findBlock(*handle.mTiered, funName)}) {
+      handle.mBlock = *index;
+    } else {
+      handle.mTiered.reset();
+    }
+    return handle;
+  }
+
+  std::scoped_lock lock{mImpl->mMutex};
+  if (auto addr{mImpl->getFunctionAddr(scriptName, funName)}) {
+    handle.mAddr = *addr;
+  }
+  return handle;
 }
 
 void ScriptEngine::compile(std::string_view script,
                            std::optional<uint32_t> calleeRef) {
+  // Scripts in the cache are cheaper to load than to interpret.
+  if (mImpl->mJitThreshold > 0u && !mImpl->isCached(script, calleeRef)) {
+    if (auto tiered{mImpl->makeTieredScript(script, calleeRef)}) {
+      std::shared_ptr<TieredScript> replaced{};
+      std::scoped_lock lock{mImpl->mMutex, mImpl->mTieredMutex};
+      auto &entry{mImpl->mTiered[tiered->bytecode.name]};
+      mImpl->mPending.erase(tiered->bytecode.name);
+      replaced = std::exchange(entry, std::move(tiered));
+      return;
+    }
+  }
+
+  if (auto prepared{prepare(script, calleeRef)}) add(std::move(*prepared));
+}
+
+std::optional<ScriptEngine::PreparedScript>
+ScriptEngine::prepare(std::string_view script,
+                      std::optional<uint32_t> calleeRef) {
+  auto &ctx{getThreadContext()};
+
+  const auto cacheKey{mImpl->getCacheKey(script, calleeRef, ctx)};
+  if (!cacheKey.empty()) {
+    if (auto entry{getJit()->getCache().load(cacheKey)}) {
+      return PreparedScript{std::move(entry->name), cacheKey, "",
+                            std::move(entry->object)};
+    }
+  }
+
   pegtl::memory_input in(script, "");
 
   const auto root{oo::parseScript(in)};
   if (!root) {
     // TODO: Script could not be parsed, throw
-    return;
+    return std::nullopt;
   }
 
-  auto module{mImpl->compileAst(*root, calleeRef)};
+  auto module{mImpl->compileAst(*root, ctx, calleeRef)};
   if (!module) {
     // TODO: Failed to compile module, throw
+    return std::nullopt;
+  }
+
+  module = oo::Jit::optimizeModule(std::move(module));
+  if (!cacheKey.empty()) oo::ScriptCache::setKey(*module, cacheKey);
+
+  PreparedScript prepared{module->getName().str(), cacheKey, "", nullptr};
+  llvm::raw_string_ostream os{prepared.bitcode};
+  llvm::WriteBitcodeToFile(*module, os);
+  os.flush();
+
+  return prepared;
+}
+
+void ScriptEngine::add(PreparedScript script) {
+  // Declared before the lock so that a replaced script is destroyed after it is
+  // released, see `Impl::mTiered`.
+  std::shared_ptr<TieredScript> replaced{};
+  std::scoped_lock lock{mImpl->mMutex, mImpl->mTieredMutex};
+
+  if (const auto it{mImpl->mTiered.find(script.name)};
+      it != mImpl->mTiered.end()) {
+    replaced = std::move(it->second);
+    mImpl->mTiered.erase(it);
+  }
+
+  if (!script.object) {
+    auto name{script.name};
+    mImpl->mPending[name] = std::move(script);
     return;
   }
 
-  jitModule(std::move(module));
+  // A script added again replaces any earlier version that is still pending.
+  mImpl->mPending.erase(script.name);
+  (void) mImpl->jitPrepared(std::move(script));
+}
+
+void ScriptEngine::setCacheDirectory(const std::string &directory) {
+  getJit()->getCache().setDirectory(directory);
+}
+
+void ScriptEngine::setJitThreshold(uint32_t threshold) noexcept {
+  mImpl->mJitThreshold = threshold;
 }
 
 } // namespace oo
@@ -2,7 +2,11 @@
 #include "llvm.hpp"
 #include "pegtl.hpp"
 #include "scripting/script_engine_base.hpp"
+#include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <vector>
 
 namespace oo {
 
@@ -22,6 +26,7 @@ ScriptEngineBase::ScriptEngineBase(ScriptEngineBase &&other) noexcept {
   swap(mCtx, other.mCtx);
   swap(mJit, other.mJit);
   swap(mExternFuns, other.mExternFuns);
+  swap(mExternInvokers, other.mExternInvokers);
   swap(mModules, other.mModules);
 }
 
@@ -32,6 +37,7 @@ ScriptEngineBase::operator=(ScriptEngineBase &&other) noexcept {
     swap(mCtx, other.mCtx);
     swap(mJit, other.mJit);
     swap(mExternFuns, other.mExternFuns);
+    swap(mExternInvokers, other.mExternInvokers);
     swap(mModules, other.mModules);
   }
   return *this;
@@ -41,11 +47,11 @@ llvm::LLVMContext &ScriptEngineBase::getContext() noexcept {
   return *mCtx;
 }
 
-void ScriptEngineBase::addExternalFunsToModule(llvm::Module *module) {
+void ScriptEngineBase::addExternalFunsToModule(llvm::Module *module) const {
   const auto linkage{llvm::Function::ExternalLinkage};
   for (const auto &entry : mExternFuns) {
     std::string funName{entry.getKey()};
-    llvm::FunctionType *funType{entry.second};
+    llvm::FunctionType *funType{entry.second(module->getContext())};
     llvm::Function::Create(funType, linkage, funName, module);
   }
 }
@@ -61,7 +67,13 @@ ScriptEngineBase::getModules() const noexcept {
 
 std::unique_ptr<llvm::Module>
 ScriptEngineBase::makeModule(llvm::StringRef moduleName) {
-  auto module{std::make_unique<llvm::Module>(moduleName, *mCtx)};
+  return makeModule(moduleName, *mCtx);
+}
+
+std::unique_ptr<llvm::Module>
+ScriptEngineBase::makeModule(llvm::StringRef moduleName,
+                             llvm::LLVMContext &ctx) const {
+  auto module{std::make_unique<llvm::Module>(moduleName, ctx)};
   module->setDataLayout(mJit->getTargetMachine().createDataLayout());
   return module;
 }
@@ -72,24 +84,76 @@ ScriptEngineBase::jitModule(std::unique_ptr<llvm::Module> module) {
   return (mModules[moduleName] = jit(std::move(module)));
 }
 
+llvm::orc::VModuleKey
+ScriptEngineBase::jitOptimizedModule(std::unique_ptr<llvm::Module> module) {
+  std::string moduleName{module->getName()};
+  return (mModules[moduleName] = mJit->addOptimizedModule(std::move(module)));
+}
+
+bool ScriptEngineBase::jitObject(llvm::StringRef moduleName,
+                                 std::unique_ptr<llvm::MemoryBuffer> object) {
+  auto keyOrErr{mJit->addObject(std::move(object))};
+  if (!keyOrErr) {
+    llvm::consumeError(keyOrErr.takeError());
+    return false;
+  }
+
+  mModules[moduleName] = *keyOrErr;
+  return true;
+}
+
+std::string
+ScriptEngineBase::getExternalFunsSignature(llvm::LLVMContext &ctx) const {
+  std::vector<llvm::StringRef> names{};
+  names.reserve(mExternFuns.size());
+  for (const auto &entry : mExternFuns) names.push_back(entry.getKey());
+  std::sort(names.begin(), names.end());
+
+  std::string signature{};
+  llvm::raw_string_ostream os{signature};
+  for (const auto &name : names) {
+    os << name << ": " << *mExternFuns.lookup(name)(ctx) << '\n';
+  }
+
+  return os.str();
+}
+
+std::vector<ScriptEngineBase::ExternalFun>
+ScriptEngineBase::getExternalFuns(llvm::LLVMContext &ctx) const {
+  std::vector<ExternalFun> funs{};
+  funs.reserve(mExternFuns.size());
+
+  for (const auto &entry : mExternFuns) {
+    std::string name{entry.getKey()};
+    auto *addr{llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(name)};
+    funs.push_back(ExternalFun{
+        name, entry.second(ctx), mExternInvokers.lookup(name),
+        static_cast<llvm::JITTargetAddress>(
+            reinterpret_cast<std::uintptr_t>(addr))});
+  }
+
+  return funs;
+}
+
 oo::LLVMVisitor ScriptEngineBase::makeVisitor(llvm::Module *module) {
-  return LLVMVisitor(module, *mCtx);
+  return LLVMVisitor(module, module->getContext());
 }
 
 oo::LLVMVisitor ScriptEngineBase::makeVisitor(llvm::Module *module,
                                               llvm::IRBuilder<> builder) {
-  return LLVMVisitor(module, *mCtx, std::move(builder));
+  return LLVMVisitor(module, module->getContext(), std::move(builder));
 }
 
 oo::LLVMVisitor ScriptEngineBase::makeVisitor(llvm::Module *module,
                                               uint32_t calleeRef) {
-  return LLVMVisitor(module, *mCtx, {}, calleeRef);
+  return LLVMVisitor(module, module->getContext(), {}, calleeRef);
 }
 
 oo::LLVMVisitor ScriptEngineBase::makeVisitor(llvm::Module *module,
                                               llvm::IRBuilder<> builder,
                                               uint32_t calleeRef) {
-  return LLVMVisitor(module, *mCtx, std::move(builder), calleeRef);
+  return LLVMVisitor(module, module->getContext(), std::move(builder),
+                     calleeRef);
 }
 
 llvm::orc::VModuleKey
@@ -0,0 +1,103 @@
+#include "scripting/script_scheduler.hpp"
+#include <algorithm>
+
+namespace oo {
+
+ScriptScheduler::ScriptScheduler(oo::ScriptEngine &engine,
+                                 std::string blockName)
+    : mEngine(engine), mBlockName(std::move(blockName)) {}
+
+ScriptScheduler::Group *
+ScriptScheduler::findGroup(const std::string &scriptName) noexcept {
+  auto it{std::find_if(mGroups.begin(), mGroups.end(), [&](const Group &g) {
+    return g.profile.scriptName == scriptName;
+  })};
+  return it == mGroups.end() ? nullptr : &*it;
+}
+
+bool ScriptScheduler::attach(const std::string &scriptName, uint32_t ref) {
+  auto *group{findGroup(scriptName)};
+  if (!group) {
+    group = &mGroups.emplace_back();
+    group->profile.scriptName = scriptName;
+  }
+
+  auto &refs{group->refs};
+  if (std::find(refs.begin(), refs.end(), ref) != refs.end()) return false;
+
+  refs.push_back(ref);
+  group->profile.numRefs = refs.size();
+  return true;
+}
+
+void ScriptScheduler::detach(const std::string &scriptName, uint32_t ref) {
+  auto *group{findGroup(scriptName)};
+  if (!group) return;
+
+  auto &refs{group->refs};
+  if (auto it{std::find(refs.begin(), refs.end(), ref)}; it != refs.end()) {
+    // The order that references are run in is unspecified.
+    *it = refs.back();
+    refs.pop_back();
+  }
+  group->profile.numRefs = refs.size();
+}
+
+void ScriptScheduler::detachAll() {
+  for (auto &group : mGroups) {
+    group.refs.clear();
+    group.profile.numRefs = 0u;
+  }
+}
+
+void ScriptScheduler::invalidate() noexcept {
+  for (auto &group : mGroups) {
+    group.handle = ScriptEngine::Handle{};
+    group.isResolved = false;
+  }
+}
+
+void ScriptScheduler::run() {
+  using Clock = std::chrono::steady_clock;
+
+  for (auto &group : mGroups) {
+    if (group.refs.empty()) continue;
+
+    if (!group.isResolved) {
+      group.handle = mEngine.resolve(group.profile.scriptName, mBlockName);
+      group.isResolved = true;
+    }
+    if (!group.handle) continue;
+
+    const auto start{Clock::now()};
+    mEngine.call<void>(group.handle);
+    const std::chrono::nanoseconds time{Clock::now() - start};
+
+    auto &profile{group.profile};
+    ++profile.numFrames;
+    profile.totalTime += time;
+    profile.maxFrameTime = std::max(profile.maxFrameTime, time);
+  }
+}
+
+std::vector<ScriptScheduler::Profile> ScriptScheduler::getProfiles() const {
+  std::vector<Profile> profiles{};
+  profiles.reserve(mGroups.size());
+  for (const auto &group : mGroups) profiles.push_back(group.profile);
+
+  std::sort(profiles.begin(), profiles.end(), [](const auto &a, const auto &b) {
+    return a.totalTime > b.totalTime;
+  });
+
+  return profiles;
+}
+
+void ScriptScheduler::resetProfiles() noexcept {
+  for (auto &group : mGroups) {
+    group.profile.numFrames = 0u;
+    group.profile.totalTime = std::chrono::nanoseconds::zero();
+    group.profile.maxFrameTime = std::chrono::nanoseconds::zero();
+  }
+}
+
+} // namespace oo
@@ -1,9 +1,11 @@
+#include "gui/stack/bytecode.hpp"
 #include "gui/stack/instructions.hpp"
 #include "gui/stack/program.hpp"
 #include "gui/stack/types.hpp"
 #include "util/meta.hpp"
 #include <catch2/catch.hpp>
 #include <pugixml.hpp>
+#include <chrono>
 #include <cmath>
 #include <sstream>
 #include <string>
@@ -655,4 +657,142 @@ TEST_CASE("empty programs throw on execution", "[gui][gui/stack]") {
   REQUIRE_THROWS_AS(program(), std::runtime_error);
 }
 
+TEST_CASE("can detect pure programs", "[gui][gui/stack]") {
+  auto compile = [](const char *xml) {
+    std::istringstream is{xml};
+    pugi::xml_document doc{};
+    REQUIRE(doc.load(is));
+    return stack::compile(doc.root());
+  };
+
+  SECTION("programs that overwrite the working value are pure") {
+    REQUIRE(compile("<copy>1</copy>").isPure());
+    REQUIRE(compile("<copy>1</copy><add>2</add><div>3</div>").isPure());
+    REQUIRE(compile(R"xml(
+<copy>0</copy>
+<copy>3</copy>
+<onlyif>
+  <copy>5</copy>
+  <eq>5</eq>
+</onlyif>
+    )xml").isPure());
+  }
+
+  SECTION("programs that use the working value are impure") {
+    REQUIRE_FALSE(compile("<add>1</add>").isPure());
+    REQUIRE_FALSE(compile(R"xml(
+<copy>3</copy>
+<onlyif>
+  <copy>5</copy>
+  <eq>5</eq>
+</onlyif>
+    )xml").isPure());
+  }
+
+  SECTION("programs that generate random numbers are impure") {
+    REQUIRE_FALSE(compile("<copy>0</copy><add><rand>5</rand></add>").isPure());
+  }
+}
+
+TEST_CASE("can compile programs to bytecode", "[gui][gui/stack]") {
+  SECTION("constant operations are folded") {
+    const std::vector<stack::Instruction> instructions{
+        stack::push_t{3.0f},
+        stack::push_t{4.0f},
+        stack::mul_t{},
+        stack::push_t{2.0f},
+        stack::sub_t{}
+    };
+    auto bytecode{stack::compileBytecode(instructions, std::variant_npos)};
+    REQUIRE(bytecode);
+    REQUIRE(bytecode->code.size() == 1u);
+
+    const auto ret{stack::execute(*bytecode, std::nullopt)};
+    REQUIRE(ret);
+    REQUIRE(std::get<float>(*ret) == 10.0f);
+  }
+
+  SECTION("the working value is used") {
+    const std::vector<stack::Instruction> instructions{
+        stack::push_t{std::string{"bar"}},
+        stack::add_t{},
+        stack::push_t{std::string{"foobar"}},
+        stack::eq_t{}
+    };
+    const auto type{stack::ValueType{std::string{}}.index()};
+    auto bytecode{stack::compileBytecode(instructions, type)};
+    REQUIRE(bytecode);
+
+    const auto foo{stack::execute(*bytecode, std::string{"foo"})};
+    REQUIRE(foo);
+    REQUIRE(std::get<bool>(*foo));
+
+    const auto baz{stack::execute(*bytecode, std::string{"baz"})};
+    REQUIRE(baz);
+    REQUIRE_FALSE(std::get<bool>(*baz));
+  }
+
+  SECTION("ill-typed programs are not compiled") {
+    const std::vector<stack::Instruction> instructions{
+        stack::push_t{1.0f},
+        stack::push_t{true},
+        stack::add_t{}
+    };
+    REQUIRE_FALSE(stack::compileBytecode(instructions, std::variant_npos));
+  }
+
+  SECTION("programs branching on non-constant values are not compiled") {
+    const std::vector<stack::Instruction> instructions{
+        stack::push_t{1},
+        stack::push_t{10},
+        stack::rand_t{},
+        stack::push_t{5},
+        stack::gt_t{},
+        stack::onlyif_t{}
+    };
+    REQUIRE_FALSE(stack::compileBytecode(instructions, std::variant_npos));
+  }
+}
+
+TEST_CASE("benchmark program evaluation", "[.][benchmark][gui][gui/stack]") {
+  std::istringstream is{R"xml(
+<add>1</add>
+<mul>0.5</mul>
+<min>
+  <copy>1000</copy>
+  <sub>1</sub>
+</min>
+<max>10</max>
+  )xml"};
+  pugi::xml_document doc{};
+  REQUIRE(doc.load(is));
+  const auto program{stack::compile(doc.root())};
+  constexpr int numIterations{1'000'000};
+
+  std::optional<stack::ValueType> working{};
+  const auto interpretStart{std::chrono::steady_clock::now()};
+  for (int i = 0; i < numIterations; ++i) {
+    stack::Stack stack{};
+    if (working) stack.push_back(*working);
+    for (const auto &instr : program.instructions) {
+      std::visit([&stack](auto &&op) { op(stack); }, instr);
+    }
+    working = stack.back();
+  }
+  const auto interpretEnd{std::chrono::steady_clock::now()};
+
+  stack::ValueType ret{};
+  for (int i = 0; i < numIterations; ++i) ret = program();
+  const auto compiledEnd{std::chrono::steady_clock::now()};
+  REQUIRE(ret == *working);
+
+  const std::chrono::duration<double, std::milli>
+      interpretTime{interpretEnd - interpretStart};
+  const std::chrono::duration<double, std::milli>
+      compiledTime{compiledEnd - interpretEnd};
+  WARN(numIterations << " evaluations: interpreted in "
+                     << interpretTime.count() << " ms, compiled in "
+                     << compiledTime.count() << " ms");
+}
+
 } // namespace gui
@@ -35,6 +35,7 @@ class TestUiElement : public gui::UiElement {
     if (index == 0 && std::holds_alternative<float>(value)) {
       mScale = std::get<float>(value);
     }
+    notifyTraitsChanged();
   }
 };
 
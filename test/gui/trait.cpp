@@ -477,4 +477,113 @@ TEST_CASE("can create traits from XML and bind them", "[gui]") {
     traits.update();
     REQUIRE(uiElement.getArea() == 50);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Traits only reevaluates pure traits when they may have changed",
+          "[gui]") {
+  gui::Traits traits{};
+
+  // src is impure because it reads a variable outside of the graph, and must
+  // be polled. dst and constant are pure.
+  float src{1};
+  auto &tSrc{traits.addTrait<float>("src", gui::TraitFun<float>{[&src]() {
+    return src;
+  }})};
+  REQUIRE_FALSE(tSrc.isPure());
+
+  int numEvaluations{0};
+  gui::TraitFun<float> dstFun{[&traits, &numEvaluations]() {
+    ++numEvaluations;
+    return 2 * traits.getTrait<float>("src").invoke();
+  }};
+  dstFun.addDependency("src");
+  dstFun.setPure(true);
+  auto &tDst{traits.addTrait<float>("dst", std::move(dstFun))};
+
+  auto &tConstant{traits.addTrait<float>("constant", 3.0f)};
+  REQUIRE(tConstant.isPure());
+
+  gui::TestUiElement uiElement{};
+  tDst.bind(&uiElement, &gui::UiElement::set_width);
+  tConstant.bind(&uiElement, &gui::UiElement::set_height);
+
+  traits.addTraitDependencies();
+  traits.update();
+  REQUIRE(uiElement.getArea() == 6);
+  const int initialEvaluations{numEvaluations};
+  REQUIRE(initialEvaluations > 0);
+
+  SECTION("pure traits are not reevaluated if nothing has changed") {
+    traits.update();
+    traits.update();
+    REQUIRE(numEvaluations == initialEvaluations);
+    REQUIRE(uiElement.getArea() == 6);
+  }
+
+  SECTION("pure traits are reevaluated when a dependency changes") {
+    src = 5;
+    traits.update();
+    REQUIRE(numEvaluations > initialEvaluations);
+    REQUIRE(uiElement.getArea() == 30);
+
+    const int changedEvaluations{numEvaluations};
+    traits.update();
+    REQUIRE(numEvaluations == changedEvaluations);
+  }
+
+  SECTION("every trait is reevaluated after adding dependencies") {
+    traits.addTraitDependencies();
+    traits.update();
+    REQUIRE(numEvaluations > initialEvaluations);
+    REQUIRE(uiElement.getArea() == 6);
+  }
+}
+
+TEST_CASE("Traits only reevaluates user traits when their uiElement changes",
+          "[gui]") {
+  gui::TestUiElement uiElement{};
+  uiElement.set_name("test");
+
+  gui::Traits traits{};
+
+  // The user trait reads a variable outside of the graph, like a user trait
+  // reading the output user trait interface of its uiElement would.
+  float user0{2};
+  int numEvaluations{0};
+  auto &tUser0{traits.addTrait<float>("test.user0", gui::TraitFun<float>{
+      [&user0, &numEvaluations]() {
+        ++numEvaluations;
+        return user0;
+      }})};
+  REQUIRE_FALSE(tUser0.isPure());
+  tUser0.bind(&uiElement, &gui::UiElement::set_width);
+
+  auto &tHeight{traits.addTrait<float>("test.height", 10.0f)};
+  tHeight.bind(&uiElement, &gui::UiElement::set_height);
+
+  traits.addProvidedTraits(&uiElement);
+  traits.addTraitDependencies();
+  traits.update();
+  REQUIRE(uiElement.getArea() == 20);
+  const int initialEvaluations{numEvaluations};
+  REQUIRE(initialEvaluations > 0);
+
+  SECTION("user traits are not polled") {
+    user0 = 3;
+    traits.update();
+    traits.update();
+    REQUIRE(numEvaluations == initialEvaluations);
+    REQUIRE(uiElement.getArea() == 20);
+  }
+
+  SECTION("user traits are reevaluated when their uiElement changes") {
+    user0 = 3;
+    uiElement.set_user(0, 1.0f);
+    traits.update();
+    REQUIRE(numEvaluations == initialEvaluations + 1);
+    REQUIRE(uiElement.getArea() == 30);
+
+    traits.update();
+    REQUIRE(numEvaluations == initialEvaluations + 1);
+  }
+}
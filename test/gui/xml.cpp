@@ -104,3 +104,51 @@ TEST_CASE("can find closest node", "[gui]") {
     REQUIRE(!node);
   }
 }
+
+TEST_CASE("can cache XML documents", "[gui]") {
+  int numReads{0};
+  gui::XmlDocumentCache cache{[&numReads](const std::string &filename) {
+    ++numReads;
+    std::istringstream is{"<menu><name>" + filename + "</name></menu>"};
+    return gui::readXmlDocument(is);
+  }};
+
+  auto getName = [](const pugi::xml_document &doc) -> std::string {
+    return doc.child("menu").child_value("name");
+  };
+
+  SECTION("by reading each file only once") {
+    const auto first{cache.get("load_menu.xml")};
+    const auto second{cache.get("load_menu.xml")};
+    REQUIRE(numReads == 1);
+    REQUIRE(getName(first) == "load_menu.xml");
+    REQUIRE(getName(second) == "load_menu.xml");
+
+    const auto other{cache.get("inventory_menu.xml")};
+    REQUIRE(numReads == 2);
+    REQUIRE(getName(other) == "inventory_menu.xml");
+  }
+
+  SECTION("by returning independent copies") {
+    auto first{cache.get("load_menu.xml")};
+    first.child("menu").child("name").text().set("changed");
+    first.child("menu").append_child("extra");
+    REQUIRE(getName(first) == "changed");
+
+    const auto second{cache.get("load_menu.xml")};
+    REQUIRE(numReads == 1);
+    REQUIRE(getName(second) == "load_menu.xml");
+    REQUIRE(!second.child("menu").child("extra"));
+  }
+
+  SECTION("by not caching documents that fail to load") {
+    gui::XmlDocumentCache failing{[&numReads](const std::string &) {
+      ++numReads;
+      std::istringstream is{"<menu>"};
+      return gui::readXmlDocument(is);
+    }};
+    REQUIRE_THROWS(failing.get("broken.xml"));
+    REQUIRE_THROWS(failing.get("broken.xml"));
+    REQUIRE(numReads == 2);
+  }
+}
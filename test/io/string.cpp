@@ -73,4 +73,22 @@ TEST_CASE("can read bzstring", "[io]") {
     REQUIRE(s == "Hello\0World"s);
     REQUIRE(is.peek() == 'x');
   }
-}
\ No newline at end of file
+}
+TEST_CASE("can write bzstring", "[io]") {
+  {
+    std::ostringstream os(std::ios_base::binary);
+    io::writeBzString(os, "Hello world");
+    // The length includes the null-terminator.
+    REQUIRE(os.str() == "\x0cHello world\0"s);
+
+    std::istringstream is(os.str() + "x"s, std::ios_base::binary);
+    REQUIRE(io::readBzString(is) == "Hello world");
+    REQUIRE(is.peek() == 'x');
+  }
+
+  {
+    std::ostringstream os(std::ios_base::binary);
+    io::writeBzString(os, "");
+    REQUIRE(os.str() == "\x01\0"s);
+  }
+}
@@ -0,0 +1,203 @@
+#include "mesh/lod_generator.hpp"
+#include <catch2/catch.hpp>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+/// Vertices are a position followed by a normal, like the meshes that are
+/// actually simplified.
+constexpr std::size_t STRIDE{6u};
+
+struct TestMesh {
+  std::vector<float> vertices{};
+  std::vector<uint16_t> indices{};
+
+  std::size_t numVertices() const { return vertices.size() / STRIDE; }
+  std::size_t numTriangles() const { return indices.size() / 3u; }
+};
+
+using Position = std::tuple<float, float, float>;
+
+Position getPosition(const TestMesh &mesh, uint16_t i) {
+  const auto *p{&mesh.vertices[i * STRIDE]};
+  return {p[0], p[1], p[2]};
+}
+
+/// Append an `n` by `n` grid of quads spanning the unit square, mapped into 3D
+/// by `toWorld`, which is given the coordinates in the square. `normal` should
+/// be the normal of the mapped square, whose triangles are wound anticlockwise
+/// when viewed from the side that it points towards.
+template<class F>
+void addGrid(TestMesh &mesh, std::size_t n, const std::array<float, 3> &normal,
+             F &&toWorld) {
+  const auto base{static_cast<uint16_t>(mesh.numVertices())};
+  for (std::size_t j = 0; j <= n; ++j) {
+    for (std::size_t i = 0; i <= n; ++i) {
+      const auto p{toWorld(static_cast<float>(i) / n,
+                           static_cast<float>(j) / n)};
+      mesh.vertices.insert(mesh.vertices.end(), p.begin(), p.end());
+      mesh.vertices.insert(mesh.vertices.end(), normal.begin(), normal.end());
+    }
+  }
+
+  auto index = [&](std::size_t i, std::size_t j) {
+    return static_cast<uint16_t>(base + j * (n + 1u) + i);
+  };
+  for (std::size_t j = 0; j < n; ++j) {
+    for (std::size_t i = 0; i < n; ++i) {
+      mesh.indices.insert(mesh.indices.end(), {
+          index(i, j), index(i + 1u, j), index(i + 1u, j + 1u),
+          index(i, j), index(i + 1u, j + 1u), index(i, j + 1u)});
+    }
+  }
+}
+
+/// A unit cube made of six separate grids, so that the vertices along each
+/// edge of the cube are duplicated with different normals.
+TestMesh makeCube(std::size_t n) {
+  using Point = std::array<float, 3>;
+  TestMesh mesh{};
+  addGrid(mesh, n, {0, 0, 1}, [](float u, float v) { return Point{u, v, 1}; });
+  addGrid(mesh, n, {0, 0, -1}, [](float u, float v) { return Point{v, u, 0}; });
+  addGrid(mesh, n, {1, 0, 0}, [](float u, float v) { return Point{1, u, v}; });
+  addGrid(mesh, n, {-1, 0, 0}, [](float u, float v) { return Point{0, v, u}; });
+  addGrid(mesh, n, {0, 1, 0}, [](float u, float v) { return Point{v, 1, u}; });
+  addGrid(mesh, n, {0, -1, 0}, [](float u, float v) { return Point{u, 0, v}; });
+  return mesh;
+}
+
+/// Return the area of the triangles projected onto the xy-plane, counting
+/// triangles wound clockwise as negative.
+float getSignedAreaXY(const TestMesh &mesh,
+                      const std::vector<uint16_t> &indices) {
+  float area{0.0f};
+  for (std::size_t t = 0; t + 2u < indices.size(); t += 3u) {
+    const auto[x0, y0, z0]{getPosition(mesh, indices[t])};
+    const auto[x1, y1, z1]{getPosition(mesh, indices[t + 1u])};
+    const auto[x2, y2, z2]{getPosition(mesh, indices[t + 2u])};
+    area += 0.5f * ((x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0));
+  }
+  return area;
+}
+
+/// Return the number of times each edge is used by the triangles, comparing
+/// vertices by position and ignoring the direction of the edge.
+std::map<std::pair<Position, Position>, int>
+countEdges(const TestMesh &mesh, const std::vector<uint16_t> &indices) {
+  std::map<std::pair<Position, Position>, int> counts{};
+  for (std::size_t t = 0; t + 2u < indices.size(); t += 3u) {
+    for (std::size_t j = 0; j < 3u; ++j) {
+      auto a{getPosition(mesh, indices[t + j])};
+      auto b{getPosition(mesh, indices[t + (j + 1u) % 3u])};
+      if (b < a) std::swap(a, b);
+      ++counts[{a, b}];
+    }
+  }
+  return counts;
+}
+
+} // namespace
+
+TEST_CASE("can simplify triangle lists", "[mesh]") {
+  SECTION("of closed meshes") {
+    const auto cube{makeCube(8u)};
+    REQUIRE(cube.numTriangles() == 768u);
+    const std::size_t target{96u};
+
+    const auto indices{oo::simplifyTriangleList(cube.vertices, STRIDE,
+                                                cube.indices, target)};
+    REQUIRE(indices.size() % 3u == 0u);
+    REQUIRE(indices.size() / 3u <= target);
+    // Each collapse of a closed mesh removes two triangles.
+    REQUIRE(indices.size() / 3u >= target - 2u);
+
+    for (auto i : indices) REQUIRE(i < cube.numVertices());
+
+    // The mesh is still closed, with every edge shared by two triangles.
+    for (const auto &[edge, count] : countEdges(cube, indices)) {
+      REQUIRE(count == 2);
+    }
+  }
+
+  SECTION("of open meshes without moving their boundary") {
+    TestMesh grid{};
+    addGrid(grid, 10u, {0, 0, 1}, [](float u, float v) {
+      return std::array<float, 3>{u, v, 0};
+    });
+    REQUIRE(grid.numTriangles() == 200u);
+
+    const auto indices{oo::simplifyTriangleList(grid.vertices, STRIDE,
+                                                grid.indices, 20u)};
+    REQUIRE(indices.size() % 3u == 0u);
+    REQUIRE(!indices.empty());
+    REQUIRE(indices.size() / 3u < grid.numTriangles());
+
+    for (auto i : indices) REQUIRE(i < grid.numVertices());
+
+    // The triangles still exactly cover the unit square without folding over
+    // each other, so the boundary has not been collapsed inwards.
+    REQUIRE(getSignedAreaXY(grid, indices) == Approx(1.0f));
+    float unsignedArea{0.0f};
+    for (std::size_t t = 0; t < indices.size(); t += 3u) {
+      const std::vector<uint16_t> tri(indices.begin() + t,
+                                      indices.begin() + t + 3u);
+      const float area{getSignedAreaXY(grid, tri)};
+      REQUIRE(area > 0.0f);
+      unsignedArea += area;
+    }
+    REQUIRE(unsignedArea == Approx(1.0f));
+
+    // Every corner of the square is kept.
+    for (const Position &corner : {Position{0, 0, 0}, Position{1, 0, 0},
+                                   Position{0, 1, 0}, Position{1, 1, 0}}) {
+      bool isKept{false};
+      for (auto i : indices) isKept |= getPosition(grid, i) == corner;
+      REQUIRE(isKept);
+    }
+  }
+
+  SECTION("by leaving small meshes alone if the target is not smaller") {
+    const auto cube{makeCube(1u)};
+    const auto indices{oo::simplifyTriangleList(cube.vertices, STRIDE,
+                                                cube.indices,
+                                                cube.numTriangles())};
+    REQUIRE(indices == cube.indices);
+  }
+
+  SECTION("by rejecting indices past the end of the vertices") {
+    auto cube{makeCube(4u)};
+    cube.indices.back() = static_cast<uint16_t>(cube.numVertices());
+    const auto indices{oo::simplifyTriangleList(cube.vertices, STRIDE,
+                                                cube.indices,
+                                                cube.numTriangles() / 2u)};
+    REQUIRE(indices.empty());
+  }
+}
+
+TEST_CASE("can convert triangle strips to triangle lists", "[mesh]") {
+  SECTION("with 16-bit indices") {
+    const std::vector<uint16_t> strip{0, 1, 2, 3, 4};
+    const std::vector<uint16_t> list{0, 1, 2, 2, 1, 3, 2, 3, 4};
+    REQUIRE(oo::triangleStripToList(strip) == list);
+  }
+
+  SECTION("with 32-bit indices") {
+    const std::vector<uint32_t> strip{0, 70000, 2, 3};
+    const std::vector<uint32_t> list{0, 70000, 2, 2, 70000, 3};
+    REQUIRE(oo::triangleStripToList(strip) == list);
+  }
+
+  SECTION("by dropping degenerate triangles") {
+    const std::vector<uint16_t> strip{0, 1, 2, 2, 3, 4};
+    const std::vector<uint16_t> list{0, 1, 2, 3, 2, 4};
+    REQUIRE(oo::triangleStripToList(strip) == list);
+  }
+
+  SECTION("by returning nothing for short strips") {
+    REQUIRE(oo::triangleStripToList(std::vector<uint16_t>{0, 1}).empty());
+  }
+}
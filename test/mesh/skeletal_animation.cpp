@@ -0,0 +1,79 @@
+#include "mesh/skeletal_animation.hpp"
+#include <catch2/catch.hpp>
+
+TEST_CASE("can sample animation clips", "[mesh]") {
+  // A single bone translated along x, with keys that do not start at zero and
+  // end before the clip does.
+  oo::AnimationClip clip{4.0f};
+  auto &track{clip.getTrack(0u)};
+  track.addTranslationKey(0.5f, Ogre::Vector3{0.0f, 1.0f, 0.0f});
+  track.addTranslationKey(1.5f, Ogre::Vector3{10.0f, 1.0f, 0.0f});
+  track.addTranslationKey(2.5f, Ogre::Vector3{30.0f, 1.0f, 0.0f});
+  track.addScaleKey(0.5f, Ogre::Vector3{1.0f, 1.0f, 1.0f});
+  track.addScaleKey(2.5f, Ogre::Vector3{3.0f, 3.0f, 3.0f});
+
+  oo::Pose pose{};
+  pose.setIdentity(1u);
+
+  SECTION("at the keys") {
+    clip.sample(0.5f, pose);
+    REQUIRE(pose.tx[0] == Approx(0.0f));
+    clip.sample(1.5f, pose);
+    REQUIRE(pose.tx[0] == Approx(10.0f));
+    clip.sample(2.5f, pose);
+    REQUIRE(pose.tx[0] == Approx(30.0f));
+    REQUIRE(pose.ty[0] == Approx(1.0f));
+    REQUIRE(pose.sx[0] == Approx(3.0f));
+  }
+
+  SECTION("between the keys") {
+    clip.sample(1.0f, pose);
+    REQUIRE(pose.tx[0] == Approx(5.0f));
+    clip.sample(2.0f, pose);
+    REQUIRE(pose.tx[0] == Approx(20.0f));
+    REQUIRE(pose.sx[0] == Approx(2.5f));
+  }
+
+  SECTION("before the first key") {
+    clip.sample(0.0f, pose);
+    REQUIRE(pose.tx[0] == Approx(0.0f));
+    REQUIRE(pose.sx[0] == Approx(1.0f));
+  }
+
+  SECTION("by holding the last key past the end of the track") {
+    clip.sample(3.0f, pose);
+    REQUIRE(pose.tx[0] == Approx(30.0f));
+    REQUIRE(pose.sx[0] == Approx(3.0f));
+
+    clip.sample(clip.getLength(), pose);
+    REQUIRE(pose.tx[0] == Approx(30.0f));
+    REQUIRE(pose.sx[0] == Approx(3.0f));
+  }
+}
+
+TEST_CASE("can sample animation rotations", "[mesh]") {
+  oo::AnimationClip clip{1.0f};
+  auto &track{clip.getTrack(0u)};
+  const Ogre::Quaternion start{Ogre::Quaternion::IDENTITY};
+  const Ogre::Quaternion end{Ogre::Degree(90.0f), Ogre::Vector3::UNIT_Z};
+  track.addRotationKey(0.0f, start);
+  track.addRotationKey(1.0f, end);
+
+  oo::Pose pose{};
+  pose.setIdentity(1u);
+
+  SECTION("halfway between the keys") {
+    clip.sample(0.5f, pose);
+    const Ogre::Quaternion half{Ogre::Degree(45.0f), Ogre::Vector3::UNIT_Z};
+    REQUIRE(pose.rw[0] == Approx(half.w));
+    REQUIRE(pose.rz[0] == Approx(half.z));
+  }
+
+  SECTION("at the end of the clip") {
+    clip.sample(clip.getLength(), pose);
+    REQUIRE(pose.rw[0] == Approx(end.w));
+    REQUIRE(pose.rx[0] == Approx(end.x).margin(1e-6));
+    REQUIRE(pose.ry[0] == Approx(end.y).margin(1e-6));
+    REQUIRE(pose.rz[0] == Approx(end.z));
+  }
+}
@@ -0,0 +1,73 @@
+#include "ogre/terrain_texture_array.hpp"
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <set>
+#include <utility>
+
+namespace {
+
+using Block = std::pair<uint32_t, uint32_t>;
+
+/// Return the lowest cell index of a neighbourhood of the given diameter, with
+/// the same bounds as `oo::WrldResolver::getNeighbourhood()`.
+long getNeighborhoodStart(long center, long diameter) {
+  return 1 + center - diameter / 2 - (diameter % 2 == 0 ? 0 : 1);
+}
+
+/// Return whether every quad of the cells loaded while moving from the cell
+/// `(cx, cy)` to `(cx + 1, cy + 1)` owns a different block of the atlases.
+/// Both neighbourhoods are loaded at once, as they can be mid-crossing.
+bool hasDistinctBlocks(long cx, long cy, long diameter, uint32_t atlasQuads) {
+  const long x0{getNeighborhoodStart(cx, diameter)};
+  const long y0{getNeighborhoodStart(cy, diameter)};
+
+  std::set<Block> blocks{};
+  std::size_t numQuads{0u};
+  for (long x = x0; x < x0 + diameter + 1; ++x) {
+    for (long y = y0; y < y0 + diameter + 1; ++y) {
+      for (long i = 0; i < 4; ++i) {
+        const long slotX{2 * x + i % 2}, slotY{2 * y + i / 2};
+        blocks.emplace(oo::TerrainTextureArray::getAtlasBlock(slotX,
+                                                              atlasQuads),
+                       oo::TerrainTextureArray::getAtlasBlock(slotY,
+                                                              atlasQuads));
+        ++numQuads;
+      }
+    }
+  }
+
+  return blocks.size() == numQuads;
+}
+
+} // namespace
+
+TEST_CASE("terrain atlases hold every loaded quad", "[ogre]") {
+  constexpr uint32_t nearDiameter{5u};
+  constexpr uint32_t farDiameter{9u};
+  const auto atlasQuads{oo::TerrainTextureArray::getAtlasQuads(nearDiameter,
+                                                                farDiameter)};
+
+  SECTION("when the far neighbourhood is larger than the near one") {
+    for (long c : {-37L, -1L, 0L, 1L, 12L}) {
+      REQUIRE(hasDistinctBlocks(c, -c, farDiameter, atlasQuads));
+      REQUIRE(hasDistinctBlocks(c, -c, nearDiameter, atlasQuads));
+    }
+  }
+
+  SECTION("but not when sized from the near neighbourhood alone") {
+    const auto nearQuads{oo::TerrainTextureArray::getAtlasQuads(nearDiameter,
+                                                                 0u)};
+    REQUIRE_FALSE(hasDistinctBlocks(0, 0, farDiameter, nearQuads));
+  }
+
+  SECTION("when the near neighbourhood is larger than the far one") {
+    REQUIRE(oo::TerrainTextureArray::getAtlasQuads(farDiameter, nearDiameter)
+                == atlasQuads);
+  }
+}
+
+TEST_CASE("terrain atlas blocks wrap negative slots", "[ogre]") {
+  REQUIRE(oo::TerrainTextureArray::getAtlasBlock(-1, 8u) == 7u);
+  REQUIRE(oo::TerrainTextureArray::getAtlasBlock(-8, 8u) == 0u);
+  REQUIRE(oo::TerrainTextureArray::getAtlasBlock(9, 8u) == 1u);
+}
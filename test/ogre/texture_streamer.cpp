@@ -0,0 +1,107 @@
+#include "ogre/texture_streamer.hpp"
+#include <catch2/catch.hpp>
+#include <OgreLogManager.h>
+#include <OgreRoot.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t TEXTURE_SIZE{16u};
+constexpr uint32_t NUM_MIPMAPS{5u};
+constexpr std::size_t HEADER_SIZE{128u};
+
+/// Write an uncompressed 32-bit DDS file with a full mip chain, returning the
+/// size of the file.
+std::size_t writeDds(const std::filesystem::path &path) {
+  std::array<uint32_t, HEADER_SIZE / 4u> header{};
+  std::memcpy(&header[0], "DDS ", 4u);
+  header[1] = 124u;
+  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT
+  header[2] = 0x1u | 0x2u | 0x4u | 0x1000u | 0x20000u;
+  header[3] = TEXTURE_SIZE;
+  header[4] = TEXTURE_SIZE;
+  header[7] = NUM_MIPMAPS;
+  header[19] = 32u;
+  // DDPF_ALPHAPIXELS | DDPF_RGB, with an ARGB bit layout
+  header[20] = 0x1u | 0x40u;
+  header[22] = 32u;
+  header[23] = 0x00ff0000u;
+  header[24] = 0x0000ff00u;
+  header[25] = 0x000000ffu;
+  header[26] = 0xff000000u;
+  // DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP
+  header[27] = 0x8u | 0x1000u | 0x400000u;
+
+  std::size_t dataSize{0u};
+  for (uint32_t mip = 0; mip < NUM_MIPMAPS; ++mip) {
+    const uint32_t size{TEXTURE_SIZE >> mip};
+    dataSize += size * size * 4u;
+  }
+  const std::vector<char> data(dataSize, '\x7f');
+
+  std::ofstream os{path, std::ios::binary};
+  os.write(reinterpret_cast<const char *>(header.data()), HEADER_SIZE);
+  os.write(data.data(), data.size());
+  return HEADER_SIZE + dataSize;
+}
+
+/// Texture that is never loaded by Ogre, only passed to the streamer.
+class TestTexture : public Ogre::Texture {
+ public:
+  TestTexture(const Ogre::String &name, const Ogre::String &group)
+      : Ogre::Texture(nullptr, name, 0, group) {}
+
+ protected:
+  void createInternalResourcesImpl() override {}
+  void freeInternalResourcesImpl() override {}
+};
+
+} // namespace
+
+TEST_CASE("only streams textures that have been requested", "[ogre]") {
+  const auto directory{std::filesystem::temp_directory_path()
+                           / "openobl_texture_streamer"};
+  std::filesystem::create_directories(directory);
+  const std::size_t fileSize{writeDds(directory / "texture.dds")};
+
+  // Ogre's root does not own a log manager that already exists.
+  auto logMgr{std::make_unique<Ogre::LogManager>()};
+  logMgr->createLog("", true, false, true);
+  Ogre::Root root("", "", "");
+
+  const std::string group{"TextureStreamerTest"};
+  auto &resGrpMgr{Ogre::ResourceGroupManager::getSingleton()};
+  resGrpMgr.addResourceLocation(directory.string(), "FileSystem", group);
+
+  // The budget is too small for anything, so any texture that is streamed
+  // would be downgraded as far as the minimum size allows.
+  oo::TextureStreamer streamer(0u, 4u);
+  TestTexture texture("texture.dds", group);
+
+  auto stream{streamer.resourceLoading("texture.dds", group, &texture)};
+  REQUIRE(stream);
+  REQUIRE(stream->size() == fileSize);
+
+  std::array<uint32_t, HEADER_SIZE / 4u> header{};
+  stream->read(header.data(), HEADER_SIZE);
+  REQUIRE(header[3] == TEXTURE_SIZE);
+  REQUIRE(header[4] == TEXTURE_SIZE);
+  REQUIRE(header[7] == NUM_MIPMAPS);
+
+  streamer.update();
+  const auto stats{streamer.getTextureStats()};
+  REQUIRE(stats.size() == 1u);
+  REQUIRE(stats[0].isStreamable);
+  REQUIRE(stats[0].residentMip == 0u);
+  REQUIRE(stats[0].wantedMip == 0u);
+  REQUIRE(streamer.getStats().numDowngrades == 0u);
+
+  resGrpMgr.destroyResourceGroup(group);
+  std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,126 @@
+#include "record/records.hpp"
+#include "resolvers/resolvers.hpp"
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+namespace {
+
+using GlobResolver = oo::Resolver<record::GLOB>;
+
+record::GLOB makeGlob(float value) {
+  record::GLOB rec{};
+  rec.value.data = value;
+  return rec;
+}
+
+std::optional<GlobResolver::Change>
+findChange(const GlobResolver &resolver, oo::BaseId baseId) {
+  const auto changes{resolver.getChanges()};
+  const auto it{std::find_if(changes.begin(), changes.end(),
+                             [&](const auto &pair) {
+                               return pair.first == baseId;
+                             })};
+  if (it == changes.end()) return std::nullopt;
+  return it->second;
+}
+
+} // namespace
+
+TEST_CASE("Resolver records ess records in the change journal",
+          "[resolvers]") {
+  const oo::BaseId espId{0x01u}, otherEspId{0x02u}, essId{0xff000001u};
+
+  GlobResolver resolver{};
+  resolver.insertEspRecord(espId, makeGlob(1.0f));
+  resolver.insertEspRecord(otherEspId, makeGlob(2.0f));
+  REQUIRE(resolver.getChanges().empty());
+
+  SECTION("when they are inserted") {
+    REQUIRE(resolver.insert(essId, makeGlob(3.0f)));
+    const auto change{findChange(resolver, essId)};
+    REQUIRE(change);
+    REQUIRE(change->isCreated);
+    REQUIRE(change->flags == 0u);
+
+    // Inserting over an existing esp record does nothing.
+    REQUIRE_FALSE(resolver.insert(espId, makeGlob(4.0f)));
+    REQUIRE_FALSE(findChange(resolver, espId));
+    REQUIRE(resolver.getChanges().size() == 1u);
+  }
+
+  SECTION("when they are inserted or assigned") {
+    REQUIRE(resolver.insertOrAssign(essId, makeGlob(3.0f)));
+    REQUIRE(findChange(resolver, essId)->isCreated);
+
+    // Assigning over an esp record modifies it instead of creating a record.
+    REQUIRE(resolver.insertOrAssign(espId, makeGlob(4.0f)));
+    const auto change{findChange(resolver, espId)};
+    REQUIRE(change);
+    REQUIRE_FALSE(change->isCreated);
+
+    REQUIRE_FALSE(findChange(resolver, otherEspId));
+  }
+
+  SECTION("when they are accessed for writing") {
+    resolver.insert(essId, makeGlob(3.0f));
+    REQUIRE(resolver.get(essId));
+    REQUIRE(findChange(resolver, essId)->isCreated);
+
+    REQUIRE(resolver.get(espId));
+    const auto change{findChange(resolver, espId)};
+    REQUIRE(change);
+    REQUIRE_FALSE(change->isCreated);
+
+    REQUIRE_FALSE(resolver.get(oo::BaseId{0x03u}));
+    REQUIRE(resolver.getChanges().size() == 2u);
+  }
+
+  SECTION("but not when they are only read") {
+    REQUIRE(std::as_const(resolver).get(espId));
+    REQUIRE(resolver.getChanges().empty());
+  }
+
+  SECTION("with any change flags that are marked") {
+    resolver.markChanged(espId, 0b0001u);
+    resolver.markChanged(espId, 0b0100u);
+    resolver.markChanged(espId);
+    const auto change{findChange(resolver, espId)};
+    REQUIRE(change);
+    REQUIRE(change->flags == 0b0101u);
+    REQUIRE_FALSE(change->isCreated);
+
+    // Marking a record that does not exist does nothing.
+    resolver.markChanged(oo::BaseId{0x03u}, 0b0001u);
+    REQUIRE(resolver.getChanges().size() == 1u);
+  }
+}
+
+TEST_CASE("Resolver returns only modified records as ess records",
+          "[resolvers]") {
+  const oo::BaseId espId{0x01u}, otherEspId{0x02u}, essId{0xff000001u};
+
+  GlobResolver resolver{};
+  resolver.insertEspRecord(espId, makeGlob(1.0f));
+  resolver.insertEspRecord(otherEspId, makeGlob(2.0f));
+  REQUIRE(resolver.getEssRecords().empty());
+
+  resolver.insert(essId, makeGlob(3.0f));
+  resolver.get(espId)->value.data = 4.0f;
+  // Marking a record without modifying it does not give it an ess record.
+  resolver.markChanged(otherEspId, 0b0001u);
+
+  auto records{resolver.getEssRecords()};
+  std::sort(records.begin(), records.end(), [](const auto &a, const auto &b) {
+    return a.first < b.first;
+  });
+  REQUIRE(records.size() == 2u);
+  REQUIRE(records[0].first == espId);
+  REQUIRE(records[0].second.value.data == 4.0f);
+  REQUIRE(records[1].first == essId);
+  REQUIRE(records[1].second.value.data == 3.0f);
+
+  // The esp record is kept, only the ess record was modified.
+  REQUIRE(std::as_const(resolver).get(otherEspId)->value.data == 2.0f);
+}
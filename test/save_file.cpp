@@ -0,0 +1,115 @@
+#include "save_file.hpp"
+#include "save_index.hpp"
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace {
+
+/// Return the header written for a save game with a 2x2 screenshot.
+oo::SaveHeader makeHeader() {
+  oo::SaveHeader header{};
+  header.version = 125u;
+  header.exeTime.year = 2006u;
+  header.headerVersion = 125u;
+  header.saveNumber = 7u;
+  header.playerName = "Player";
+  header.playerLevel = 12u;
+  header.playerCellName = "Imperial City";
+  header.gameDaysPassed = 3.5f;
+  header.gameTicksPassed = 1234u;
+  header.saveTime.minute = 42u;
+  return header;
+}
+
+oo::SaveScreenshot makeScreenshot() {
+  oo::SaveScreenshot screenshot{};
+  screenshot.width = 2u;
+  screenshot.height = 2u;
+  for (uint8_t i = 0; i < 12u; ++i) screenshot.pixels.push_back(i);
+  return screenshot;
+}
+
+/// Return the bytes of a save game as `operator<<(std::ostream &, SaveState)`
+/// writes them, with some filler in place of everything after the header.
+std::string makeSaveBytes() {
+  std::ostringstream os(std::ios_base::binary);
+  oo::writeSaveHeader(os, makeHeader(), makeScreenshot());
+  os << std::string(4096u, 'x');
+  return os.str();
+}
+
+} // namespace
+
+TEST_CASE("can write and read save games", "[save]") {
+  const auto bytes{makeSaveBytes()};
+  const auto path{std::filesystem::temp_directory_path()
+                      / "openobl_save_file.ess"};
+
+  const auto readSave = [&path](auto openFn) {
+    auto is{openFn(path)};
+    REQUIRE(is);
+    return std::string(std::istreambuf_iterator<char>(*is), {});
+  };
+
+  const auto checkHeader = [&path](auto openFn) {
+    auto is{openFn(path)};
+    oo::SaveHeader header{};
+    oo::SaveScreenshot screenshot{};
+    oo::readSaveHeader(*is, header, &screenshot);
+    REQUIRE(header.version == 125u);
+    REQUIRE(header.exeTime.year == 2006u);
+    REQUIRE(header.headerVersion == 125u);
+    REQUIRE(header.saveNumber == 7u);
+    REQUIRE(header.playerName == "Player");
+    REQUIRE(header.playerLevel == 12u);
+    REQUIRE(header.playerCellName == "Imperial City");
+    REQUIRE(header.gameDaysPassed == 3.5f);
+    REQUIRE(header.gameTicksPassed == 1234u);
+    REQUIRE(header.saveTime.minute == 42u);
+    REQUIRE(header.thumbnailWidth == 2u);
+    REQUIRE(header.thumbnailHeight == 2u);
+    REQUIRE(header.thumbnail == makeScreenshot().pixels);
+    REQUIRE(screenshot.width == 2u);
+    REQUIRE(screenshot.height == 2u);
+    REQUIRE(screenshot.pixels == makeScreenshot().pixels);
+
+    // The header is followed by the rest of the save.
+    REQUIRE(is->get() == 'x');
+  };
+
+  SECTION("with compression") {
+    oo::writeSaveFile(bytes, path, true);
+    REQUIRE(std::filesystem::file_size(path) < bytes.size());
+    REQUIRE(readSave(oo::openSaveGame) == bytes);
+    REQUIRE(readSave(oo::streamSaveGame) == bytes);
+    checkHeader(oo::openSaveGame);
+    checkHeader(oo::streamSaveGame);
+  }
+
+  SECTION("without compression") {
+    oo::writeSaveFile(bytes, path, false);
+    REQUIRE(std::filesystem::file_size(path) == bytes.size());
+    REQUIRE(readSave(oo::openSaveGame) == bytes);
+    REQUIRE(readSave(oo::streamSaveGame) == bytes);
+    checkHeader(oo::openSaveGame);
+    checkHeader(oo::streamSaveGame);
+  }
+
+  SECTION("that were written by the original game") {
+    {
+      std::ofstream os(path, std::ios_base::binary);
+      os.write(bytes.data(), bytes.size());
+    }
+    REQUIRE(readSave(oo::openSaveGame) == bytes);
+    REQUIRE(readSave(oo::streamSaveGame) == bytes);
+    checkHeader(oo::openSaveGame);
+    checkHeader(oo::streamSaveGame);
+  }
+
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,129 @@
+#include "helpers.hpp"
+#include "scripting/script_engine.hpp"
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// Return the source text of every uncompressed SCPT record in the given
+/// esm/esp file, without going through the record library.
+std::vector<std::string> readScriptSources(const std::string &path) {
+  std::ifstream is{path, std::ios::binary};
+  const std::vector<char> file{std::istreambuf_iterator<char>(is),
+                               std::istreambuf_iterator<char>()};
+
+  const auto readU32 = [&file](std::size_t pos) {
+    uint32_t val{};
+    std::memcpy(&val, file.data() + pos, sizeof(val));
+    return val;
+  };
+  const auto readU16 = [&file](std::size_t pos) {
+    uint16_t val{};
+    std::memcpy(&val, file.data() + pos, sizeof(val));
+    return val;
+  };
+  const auto isType = [&file](std::size_t pos, const char *type) {
+    return std::memcmp(file.data() + pos, type, 4) == 0;
+  };
+
+  constexpr std::size_t headerSize{20u};
+  constexpr uint32_t compressedFlag{0x00040000u};
+  std::vector<std::string> sources{};
+
+  // Scan each SCPT record in [begin, end) for an SCTX subrecord.
+  const auto readGroup = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t pos{begin}; pos + headerSize <= end;) {
+      const std::size_t dataSize{readU32(pos + 4u)};
+      const std::size_t next{pos + headerSize + dataSize};
+      if (!isType(pos, "SCPT") || (readU32(pos + 8u) & compressedFlag)) {
+        pos = next;
+        continue;
+      }
+
+      std::size_t subPos{pos + headerSize};
+      std::size_t extSize{0u};
+      while (subPos + 6u <= std::min(next, end)) {
+        std::size_t size{extSize ? extSize : readU16(subPos + 4u)};
+        extSize = 0u;
+        if (isType(subPos, "XXXX")) {
+          extSize = readU32(subPos + 6u);
+        } else if (isType(subPos, "SCTX")) {
+          sources.emplace_back(file.data() + subPos + 6u, size);
+        }
+        subPos += 6u + size;
+      }
+
+      pos = next;
+    }
+  };
+
+  for (std::size_t pos{0u}; pos + headerSize <= file.size();) {
+    if (!isType(pos, "GRUP")) {
+      pos += headerSize + readU32(pos + 4u);
+      continue;
+    }
+
+    const std::size_t groupSize{readU32(pos + 4u)};
+    if (groupSize < headerSize) break;
+    if (isType(pos + 8u, "SCPT")) {
+      readGroup(pos + headerSize, std::min(pos + groupSize, file.size()));
+    }
+    pos += groupSize;
+  }
+
+  return sources;
+}
+
+} // namespace
+
+TEST_CASE("benchmark script preparation", "[.][benchmark][scripting]") {
+  const char *esmPath{std::getenv("OO_BENCHMARK_ESM")};
+  if (!esmPath) {
+    WARN("Set OO_BENCHMARK_ESM to the path of an esm to run this benchmark");
+    return;
+  }
+
+  const auto sources{readScriptSources(esmPath)};
+  REQUIRE_FALSE(sources.empty());
+
+  auto &se{oo::getScriptEngine()};
+  const unsigned maxThreads{std::max(1u, std::thread::hardware_concurrency())};
+
+  for (unsigned numThreads{1u}; numThreads <= maxThreads; numThreads *= 2u) {
+    std::atomic<std::size_t> nextIndex{0u};
+    std::atomic<std::size_t> numPrepared{0u};
+    std::atomic<std::size_t> numFailed{0u};
+
+    const auto worker = [&]() {
+      for (auto i{nextIndex++}; i < sources.size(); i = nextIndex++) {
+        try {
+          if (se.prepare(sources[i])) ++numPrepared;
+          else ++numFailed;
+        } catch (const std::exception &) {
+          ++numFailed;
+        }
+      }
+    };
+
+    const auto start{std::chrono::steady_clock::now()};
+    std::vector<std::thread> threads{};
+    for (unsigned t{0u}; t < numThreads; ++t) threads.emplace_back(worker);
+    for (auto &thread : threads) thread.join();
+    const auto end{std::chrono::steady_clock::now()};
+
+    const std::chrono::duration<double, std::milli> time{end - start};
+    WARN(numThreads << " threads: prepared " << numPrepared << " scripts ("
+                    << numFailed << " failed) of " << sources.size() << " in "
+                    << time.count() << " ms");
+  }
+}
@@ -0,0 +1,169 @@
+#include "helpers.hpp"
+#include "scripting/script_engine.hpp"
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+void setUpScriptEngine(oo::ScriptEngine &se, uint32_t jitThreshold) {
+  se.registerFunction<decltype(Func)>("Func");
+  se.registerFunction<decltype(MemberFunc)>("MemberFunc");
+  se.registerFunction<decltype(NoArgFunc)>("NoArgFunc");
+  se.setJitThreshold(jitThreshold);
+}
+
+} // namespace
+
+TEST_CASE("can interpret scripts", "[scripting]") {
+  // Never hot enough to be compiled to machine code.
+  oo::ScriptEngine se{};
+  setUpScriptEngine(se, 1'000'000u);
+
+  SECTION("with branches and function calls") {
+    std::string_view script = R"script(
+scn MyScript
+
+begin TestLong
+  long foo
+  set foo to 1
+  long bar
+  set bar to 0
+
+  if foo < 1
+    return 1
+  elseif foo == 1
+    if bar == 0
+      set bar to Func 1
+      return bar
+    else
+      return 10
+    endif
+  else
+    return 2
+  endif
+end
+)script";
+
+    se.compile(script);
+    const auto result{se.call<int>("MyScript", "TestLong")};
+    REQUIRE(result);
+    REQUIRE(*result == 9);
+  }
+
+  SECTION("with implicit callee") {
+    std::string_view script = R"script(
+scn MyScript
+begin TestLong
+  return MemberFunc 3
+end
+)script";
+
+    se.compile(script, 10u);
+    const auto result{se.call<int>("MyScript", "TestLong")};
+    REQUIRE(result);
+    REQUIRE(*result == 30);
+  }
+
+  SECTION("with implicit conversions") {
+    std::string_view script = R"script(
+scn MyScript
+
+begin TestShort
+  short x
+  set x to 32767
+  set x to x + 1
+  return x
+end
+
+begin TestFloat
+  float f
+  set f to 7 / 2.0
+  return f + NoArgFunc
+end
+
+begin TestLong
+  long l
+  set l to 7.9
+  return l
+end
+)script";
+
+    se.compile(script);
+
+    const auto shortResult{se.call<int16_t>("MyScript", "TestShort")};
+    REQUIRE(shortResult);
+    REQUIRE(*shortResult == -32768);
+
+    const auto floatResult{se.call<float>("MyScript", "TestFloat")};
+    REQUIRE(floatResult);
+    REQUIRE(*floatResult == Approx(13.5f));
+
+    const auto longResult{se.call<int>("MyScript", "TestLong")};
+    REQUIRE(longResult);
+    REQUIRE(*longResult == 7);
+  }
+
+  SECTION("unless they do not exist") {
+    std::string_view script = R"script(
+scn MyScript
+begin TestLong
+  return 1
+end
+)script";
+
+    se.compile(script);
+    REQUIRE_FALSE(se.call<int>("MyScript", "TestShort"));
+    REQUIRE_FALSE(se.call<int>("MyOtherScript", "TestLong"));
+  }
+}
+
+TEST_CASE("can compile hot interpreted scripts", "[scripting]") {
+  oo::ScriptEngine se{};
+  setUpScriptEngine(se, 4u);
+
+  std::string_view script = R"script(
+scn MyScript
+
+short count
+float total
+
+begin TestLong
+  set count to count + 1
+  set total to total + 0.5
+  return count
+end
+
+begin TestFloat
+  return total
+end
+)script";
+
+  se.compile(script);
+
+  const auto handle{se.resolve("MyScript", "TestLong")};
+  REQUIRE(handle);
+  REQUIRE_FALSE(handle.isNative());
+
+  // The script's variables must carry over from the interpreter to the machine
+  // code whenever the switch happens, so keep calling while it is compiled,
+  // and for a while after.
+  const auto deadline{std::chrono::steady_clock::now()
+                          + std::chrono::seconds(30)};
+  int numCalls{0};
+  while (numCalls < 200 || !handle.isNative()) {
+    const auto count{se.call<int>(handle)};
+    REQUIRE(count);
+    REQUIRE(*count == ++numCalls);
+    if (std::chrono::steady_clock::now() > deadline) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Quietly failing to promote the script would leave it interpreted.
+  REQUIRE(handle.isNative());
+  REQUIRE(se.resolve("MyScript", "TestFloat").isNative());
+
+  const auto total{se.call<float>("MyScript", "TestFloat")};
+  REQUIRE(total);
+  REQUIRE(*total == Approx(0.5f * numCalls));
+}
@@ -3,6 +3,10 @@
 #include "scripting/script_engine.hpp"
 #include <catch2/catch.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
 #include <string_view>
 
 TEST_CASE("can compile empty blocks", "[scripting]") {
@@ -255,4 +259,97 @@ end
     REQUIRE(result);
     REQUIRE(*result == 9);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("can load compiled scripts from the cache", "[scripting]") {
+  // Make sure the scripting logger exists.
+  oo::getScriptEngine();
+
+  const auto cacheDir{std::filesystem::temp_directory_path()
+                          / "openobl_script_cache_test"};
+  std::filesystem::remove_all(cacheDir);
+
+  std::string_view script = R"script(
+scn MyCachedScript
+
+begin TestLong
+  long foo
+  set foo to Func 3
+  return foo
+end
+  )script";
+
+  const auto numEntries = [&cacheDir]() {
+    const std::filesystem::directory_iterator it{cacheDir};
+    return std::distance(begin(it), end(it));
+  };
+
+  const auto readFile = [](const std::filesystem::path &path) {
+    std::ifstream is{path, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{is}, {}};
+  };
+
+  std::filesystem::path entryPath{};
+  std::filesystem::file_time_type entryTime{};
+  std::string entryContents{};
+
+  {
+    oo::ScriptEngine se{};
+    se.registerFunction<decltype(Func)>("Func");
+    se.setCacheDirectory(cacheDir.string());
+    auto prepared{se.prepare(script)};
+    REQUIRE(prepared);
+    // Nothing is cached yet, so the script has to be compiled.
+    REQUIRE_FALSE(prepared->object);
+    REQUIRE_FALSE(prepared->bitcode.empty());
+    se.add(std::move(*prepared));
+    const auto result{se.call<int>("MyCachedScript", "TestLong")};
+    REQUIRE(result);
+    REQUIRE(*result == 27);
+    REQUIRE(numEntries() == 1);
+
+    entryPath = std::filesystem::directory_iterator{cacheDir}->path();
+    entryTime = std::filesystem::last_write_time(entryPath);
+    entryContents = readFile(entryPath);
+    REQUIRE_FALSE(entryContents.empty());
+  }
+
+  {
+    oo::ScriptEngine se{};
+    se.registerFunction<decltype(Func)>("Func");
+    se.setCacheDirectory(cacheDir.string());
+    auto prepared{se.prepare(script)};
+    REQUIRE(prepared);
+    // The object code comes from the cache instead of the compiler.
+    REQUIRE(prepared->object);
+    REQUIRE(prepared->bitcode.empty());
+    se.add(std::move(*prepared));
+    const auto result{se.call<int>("MyCachedScript", "TestLong")};
+    REQUIRE(result);
+    REQUIRE(*result == 27);
+
+    // The entry was read, not written again.
+    REQUIRE(numEntries() == 1);
+    REQUIRE(std::filesystem::last_write_time(entryPath) == entryTime);
+    REQUIRE(readFile(entryPath) == entryContents);
+  }
+
+  {
+    // Registering another function changes the key, so the script is compiled
+    // again instead of picking up the old object code.
+    oo::ScriptEngine se{};
+    se.registerFunction<decltype(Func)>("Func");
+    se.registerFunction<decltype(NoArgFunc)>("NoArgFunc");
+    se.setCacheDirectory(cacheDir.string());
+    auto prepared{se.prepare(script)};
+    REQUIRE(prepared);
+    REQUIRE_FALSE(prepared->object);
+    se.add(std::move(*prepared));
+    const auto result{se.call<int>("MyCachedScript", "TestLong")};
+    REQUIRE(result);
+    REQUIRE(*result == 27);
+    REQUIRE(numEntries() == 2);
+  }
+
+  std::filesystem::remove_all(cacheDir);
+}
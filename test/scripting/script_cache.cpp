@@ -0,0 +1,63 @@
+#include "scripting/script_cache.hpp"
+#include <catch2/catch.hpp>
+#include <string>
+
+TEST_CASE("script cache keys depend on everything the object code does",
+          "[scripting]") {
+  oo::ScriptCache::KeySource source{};
+  source.compilerVersion = "7.1.0";
+  source.targetTriple = "x86_64-pc-linux-gnu";
+  source.targetCpu = "skylake";
+  source.targetFeatures = "+avx2";
+  source.externalFunctions = "i32 Func(i32)";
+  source.script = "scn MyScript";
+
+  const auto key{oo::ScriptCache::makeKey(source)};
+  REQUIRE_FALSE(key.empty());
+  REQUIRE(oo::ScriptCache::makeKey(source) == key);
+
+  SECTION("including the compiler version") {
+    source.compilerVersion = "7.1.1";
+    REQUIRE(oo::ScriptCache::makeKey(source) != key);
+  }
+
+  SECTION("including the target CPU and its features") {
+    auto other{source};
+    other.targetCpu = "znver1";
+    REQUIRE(oo::ScriptCache::makeKey(other) != key);
+
+    other = source;
+    other.targetFeatures = "+avx2,+avx512f";
+    REQUIRE(oo::ScriptCache::makeKey(other) != key);
+
+    other = source;
+    other.targetTriple = "x86_64-pc-windows-msvc";
+    REQUIRE(oo::ScriptCache::makeKey(other) != key);
+  }
+
+  SECTION("including the signatures of external functions") {
+    source.externalFunctions = "i32 Func(float)";
+    REQUIRE(oo::ScriptCache::makeKey(source) != key);
+  }
+
+  SECTION("including the callee and the script") {
+    auto other{source};
+    other.calleeRef = 0u;
+    REQUIRE(oo::ScriptCache::makeKey(other) != key);
+    other.calleeRef = 1u;
+    REQUIRE(oo::ScriptCache::makeKey(other) != key);
+
+    other = source;
+    other.script = "scn MyOtherScript";
+    REQUIRE(oo::ScriptCache::makeKey(other) != key);
+  }
+
+  SECTION("without fields running into each other") {
+    auto a{source}, b{source};
+    a.targetCpu = "skylake+";
+    a.targetFeatures = "avx2";
+    b.targetCpu = "skylake";
+    b.targetFeatures = "+avx2";
+    REQUIRE(oo::ScriptCache::makeKey(a) != oo::ScriptCache::makeKey(b));
+  }
+}
@@ -0,0 +1,103 @@
+#include "helpers.hpp"
+#include "scripting/script_scheduler.hpp"
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <string>
+
+TEST_CASE("can schedule scripts", "[scripting]") {
+  // Each reference gets its own copy of the script, compiled with it as the
+  // implicit callee, so that it has its own variables.
+  const auto makeScript = [](const std::string &scriptName) {
+    return "scn " + scriptName + R"script(
+
+long count
+
+begin GameMode
+  set count to count + MemberFunc 1
+end
+
+begin TestLong
+  return count
+end
+)script";
+  };
+
+  auto &se{oo::getScriptEngine()};
+  se.compile(makeScript("MyScheduledScript1"), 1u);
+  se.compile(makeScript("MyScheduledScript2"), 2u);
+
+  oo::ScriptScheduler scheduler{se};
+  scheduler.attach("MyScheduledScript1", 1u);
+  scheduler.attach("MyScheduledScript2", 2u);
+  scheduler.attach("MyMissingScript", 3u);
+
+  const auto getProfile = [&scheduler](const std::string &scriptName) {
+    const auto profiles{scheduler.getProfiles()};
+    const auto it{std::find_if(profiles.begin(), profiles.end(),
+                               [&](const auto &p) {
+                                 return p.scriptName == scriptName;
+                               })};
+    REQUIRE(it != profiles.end());
+    return *it;
+  };
+
+  // The scripts are compiled again for each section, so only count what the
+  // section adds.
+  const auto getCount = [&se](const std::string &scriptName) {
+    const auto count{se.call<int>(scriptName, "TestLong")};
+    REQUIRE(count);
+    return *count;
+  };
+  const int start1{getCount("MyScheduledScript1")};
+  const int start2{getCount("MyScheduledScript2")};
+
+  SECTION("for every attached reference") {
+    for (int i = 0; i < 3; ++i) scheduler.run();
+
+    REQUIRE(getCount("MyScheduledScript1") - start1 == 3);
+    REQUIRE(getCount("MyScheduledScript2") - start2 == 6);
+
+    REQUIRE(scheduler.getProfiles().size() == 3u);
+    const auto profile{getProfile("MyScheduledScript1")};
+    REQUIRE(profile.numRefs == 1u);
+    REQUIRE(profile.numFrames == 3u);
+    REQUIRE(profile.maxFrameTime <= profile.totalTime);
+    REQUIRE(getProfile("MyMissingScript").numFrames == 0u);
+  }
+
+  SECTION("once per frame however many references share a script") {
+    REQUIRE(scheduler.attach("MyScheduledScript1", 4u));
+    for (int i = 0; i < 3; ++i) scheduler.run();
+
+    REQUIRE(getCount("MyScheduledScript1") - start1 == 3);
+    const auto profile{getProfile("MyScheduledScript1")};
+    REQUIRE(profile.numRefs == 2u);
+    REQUIRE(profile.numFrames == 3u);
+  }
+
+  SECTION("without attaching a reference twice") {
+    REQUIRE_FALSE(scheduler.attach("MyScheduledScript1", 1u));
+    REQUIRE(getProfile("MyScheduledScript1").numRefs == 1u);
+
+    scheduler.detach("MyScheduledScript1", 1u);
+    REQUIRE(getProfile("MyScheduledScript1").numRefs == 0u);
+  }
+
+  SECTION("until references are detached") {
+    scheduler.run();
+    scheduler.detach("MyScheduledScript1", 1u);
+    scheduler.run();
+    scheduler.detachAll();
+    scheduler.run();
+
+    REQUIRE(getCount("MyScheduledScript1") - start1 == 1);
+    REQUIRE(getCount("MyScheduledScript2") - start2 == 4);
+
+    const auto profile{getProfile("MyScheduledScript2")};
+    REQUIRE(profile.numRefs == 0u);
+    REQUIRE(profile.numFrames == 2u);
+
+    scheduler.resetProfiles();
+    REQUIRE(getProfile("MyScheduledScript2").numFrames == 0u);
+  }
+}
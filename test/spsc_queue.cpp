@@ -0,0 +1,73 @@
+#include "job/spsc_queue.hpp"
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("SpscQueue is first in first out", "[job]") {
+  oo::SpscQueue<int, 4u> queue{};
+  int value{-1};
+
+  SECTION("and starts empty") {
+    REQUIRE(queue.empty());
+    REQUIRE_FALSE(queue.pop(value));
+    REQUIRE(value == -1);
+  }
+
+  SECTION("and rejects values when full") {
+    for (int i = 0; i < 4; ++i) REQUIRE(queue.push(i));
+    REQUIRE_FALSE(queue.push(4));
+    REQUIRE_FALSE(queue.empty());
+
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(queue.pop(value));
+      REQUIRE(value == i);
+    }
+    REQUIRE(queue.empty());
+    REQUIRE_FALSE(queue.pop(value));
+  }
+
+  SECTION("and wraps around the end of the buffer") {
+    // Keep the queue partially full so that the indices pass the end of the
+    // buffer many times.
+    int next{0};
+    int expected{0};
+    for (int round = 0; round < 10; ++round) {
+      REQUIRE(queue.push(next++));
+      REQUIRE(queue.push(next++));
+      REQUIRE(queue.push(next++));
+      REQUIRE(queue.pop(value));
+      REQUIRE(value == expected++);
+      REQUIRE(queue.pop(value));
+      REQUIRE(value == expected++);
+      REQUIRE(queue.pop(value));
+      REQUIRE(value == expected++);
+    }
+    REQUIRE(queue.empty());
+  }
+}
+
+TEST_CASE("SpscQueue passes values between threads", "[job]") {
+  constexpr int numValues{100'000};
+  oo::SpscQueue<int, 64u> queue{};
+
+  std::thread producer([&queue]() {
+    for (int i = 0; i < numValues;) {
+      if (queue.push(i)) ++i;
+      else std::this_thread::yield();
+    }
+  });
+
+  std::vector<int> received{};
+  received.reserve(numValues);
+  while (received.size() < static_cast<std::size_t>(numValues)) {
+    int value{};
+    if (queue.pop(value)) received.push_back(value);
+    else std::this_thread::yield();
+  }
+  producer.join();
+
+  REQUIRE(queue.empty());
+  bool isInOrder{true};
+  for (int i = 0; i < numValues; ++i) isInOrder &= received[i] == i;
+  REQUIRE(isInOrder);
+}